@@ -50,6 +50,13 @@ PJ_BEGIN_DECL
  */
 typedef struct pj_activesock_t pj_activesock_t;
 
+/**
+ * This opaque structure describes a pool of read buffers which can be
+ * shared by many stream oriented active sockets. See
+ * #pj_activesock_slab_create() and pj_activesock_cfg.read_slab.
+ */
+typedef struct pj_activesock_slab pj_activesock_slab;
+
 /**
  * This structure contains the callbacks to be called by the active socket.
  */
@@ -247,6 +254,33 @@ typedef struct pj_activesock_cfg
      */
     pj_bool_t whole_data;
 
+    /**
+     * Optional read buffer slab, to be shared among many stream oriented
+     * active sockets. When this is set, #pj_activesock_start_read() on a
+     * stream socket does not allocate a read buffer for the socket.
+     * Instead, the active socket waits until the socket becomes readable,
+     * then borrows a buffer from the slab, reads and reports the data, and
+     * returns the buffer to the slab as soon as the \a on_data_read()
+     * callback has consumed all of it (i.e. sets zero remainder). Idle
+     * connections thus hold no read buffer at all, which considerably
+     * reduces memory usage for servers with many mostly idle connections.
+     *
+     * Note that in this mode \a async_cnt is treated as 1, and the data
+     * pointer given to \a on_data_read() is only valid during the callback
+     * (the buffer may be a different one in the next callback, although
+     * the remainder is always preserved at its start). The \a buff_size
+     * given to #pj_activesock_start_read() must not exceed the data size
+     * of the slab buffers, and #pj_activesock_start_read2() can not be
+     * used. The \a on_data_read() callback must only return PJ_FALSE
+     * after the active socket has been closed.
+     *
+     * The active socket keeps a reference to the slab until it is closed
+     * and its borrowed buffer, if any, has been returned.
+     *
+     * Default value is NULL (each socket owns its read buffers).
+     */
+    pj_activesock_slab *read_slab;
+
 } pj_activesock_cfg;
 
 
@@ -392,6 +426,83 @@ PJ_DECL(pj_status_t) pj_activesock_set_user_data(pj_activesock_t *asock,
 PJ_DECL(void*) pj_activesock_get_user_data(pj_activesock_t *asock);
 
 
+/**
+ * Information about a read buffer slab, see #pj_activesock_slab_get_info().
+ */
+typedef struct pj_activesock_slab_info
+{
+    unsigned	buf_size;   /**< Size of each buffer, in bytes.		    */
+    unsigned	data_offset;/**< Offset of the read data in the buffer.	    */
+    unsigned	total_cnt;  /**< Number of buffers allocated by the slab.   */
+    unsigned	used_cnt;   /**< Number of buffers currently borrowed.	    */
+    unsigned	peak_cnt;   /**< Highest number of buffers borrowed at the
+				 same time.				    */
+} pj_activesock_slab_info;
+
+/**
+ * Create a read buffer slab to be shared by stream oriented active sockets
+ * (see pj_activesock_cfg.read_slab). Buffers are allocated on demand, and
+ * the number of buffers grows to the number of sockets which have data
+ * being processed at the same time rather than the number of sockets.
+ *
+ * @param pf	    Pool factory to create the slab's pool.
+ * @param buf_size  The size of each buffer, in bytes.
+ * @param p_slab    Pointer to receive the slab.
+ *
+ * @return	    PJ_SUCCESS if the operation has been successful,
+ *		    or the appropriate error code on failure.
+ */
+PJ_DECL(pj_status_t) pj_activesock_slab_create(pj_pool_factory *pf,
+					       unsigned buf_size,
+					       pj_activesock_slab **p_slab);
+
+/**
+ * Same as #pj_activesock_slab_create(), except that the data is read at
+ * \a data_offset of each buffer rather than at its start, and the data
+ * pointer given to \a on_data_read() points there. The first
+ * \a data_offset bytes (and anything after the read data) belong to the
+ * application, so a buffer can be a structure which embeds the data being
+ * read, such as a receive data structure with its packet array. Such
+ * application data is not preserved when the buffer goes back to the
+ * slab.
+ *
+ * @param pf	      Pool factory to create the slab's pool.
+ * @param buf_size    The size of each buffer, in bytes.
+ * @param data_offset Offset of the read data in each buffer, in bytes.
+ * @param p_slab      Pointer to receive the slab.
+ *
+ * @return	      PJ_SUCCESS if the operation has been successful,
+ *		      or the appropriate error code on failure.
+ */
+PJ_DECL(pj_status_t) pj_activesock_slab_create2(pj_pool_factory *pf,
+						unsigned buf_size,
+						unsigned data_offset,
+						pj_activesock_slab **p_slab);
+
+/**
+ * Get the buffer usage of the slab.
+ *
+ * @param slab	    The slab.
+ * @param info	    Structure to receive the information.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_activesock_slab_get_info(pj_activesock_slab *slab,
+						 pj_activesock_slab_info *info);
+
+/**
+ * Destroy the slab. Active sockets which still use the slab keep it
+ * alive, and it is actually destroyed when the last of them has been
+ * closed. No new active socket may be created with the slab after this
+ * function is called.
+ *
+ * @param slab	    The slab.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_activesock_slab_destroy(pj_activesock_slab *slab);
+
+
 /**
  * Starts read operation on this active socket. This function will create
  * \a async_cnt number of buffers (the \a async_cnt parameter was given
@@ -406,6 +517,11 @@ PJ_DECL(void*) pj_activesock_get_user_data(pj_activesock_t *asock);
  * operations. Further read operations will be done automatically by the
  * active socket when \a on_data_read() callback returns non-zero. 
  *
+ * If the active socket is stream oriented and was created with
+ * pj_activesock_cfg.read_slab set, no buffer is allocated here; buffers
+ * are borrowed from the slab only while there is data to process, and
+ * \a buff_size must not exceed the data size of the slab buffers.
+ *
  * @param asock	    The active socket.
  * @param pool	    Pool used to allocate buffers for incoming data.
  * @param buff_size The size of each buffer, in bytes.
@@ -422,7 +538,8 @@ PJ_DECL(pj_status_t) pj_activesock_start_read(pj_activesock_t *asock,
 /**
  * Same as #pj_activesock_start_read(), except that the application
  * supplies the buffers for the read operation so that the acive socket
- * does not have to allocate the buffers.
+ * does not have to allocate the buffers. This can not be used with an
+ * active socket which was created with pj_activesock_cfg.read_slab.
  *
  * @param asock	    The active socket.
  * @param pool	    Pool used to allocate buffers for incoming data.
@@ -0,0 +1,138 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_ATOMIC_H__
+#define __PJ_ATOMIC_H__
+
+/**
+ * @file atomic.h
+ * @brief Acquire and release memory accesses.
+ */
+
+#include <pj/types.h>
+
+/**
+ * @defgroup PJ_ATOMIC_ACCESS Acquire and Release Accesses
+ * @ingroup PJ_OS
+ * @{
+ *
+ * These macros are for lock-free structures where one thread publishes
+ * data by storing an index or a pointer, and another thread picks the
+ * data up by loading it, for example the indexes of a single producer,
+ * single consumer ring. The data written before a release store is
+ * visible to the thread which loads the stored value with an acquire
+ * load.
+ *
+ * The operands must be naturally aligned variables of type unsigned int
+ * (#PJ_ATOMIC_LOAD_ACQUIRE(), #PJ_ATOMIC_STORE_RELEASE()) or of a pointer
+ * type (the _PTR variants).
+ *
+ * Unlike #pj_atomic_t, these don't need to be created and they compile
+ * to plain instructions. Where the compiler doesn't provide such
+ * accesses, #PJ_HAS_ATOMIC_ACQ_REL is zero, the macros fall back to
+ * plain accesses and the caller must protect the data with a lock.
+ */
+
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+#   define PJ_HAS_ATOMIC_ACQ_REL		1
+#   define PJ_ATOMIC_LOAD_ACQUIRE(p)	__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#   define PJ_ATOMIC_STORE_RELEASE(p,v)	__atomic_store_n(p, v, \
+							 __ATOMIC_RELEASE)
+#   define PJ_ATOMIC_LOAD_ACQUIRE_PTR(p)	PJ_ATOMIC_LOAD_ACQUIRE(p)
+#   define PJ_ATOMIC_STORE_RELEASE_PTR(p,v) PJ_ATOMIC_STORE_RELEASE(p,v)
+#   define PJ_ATOMIC_EXCHANGE_PTR(p,v)	__atomic_exchange_n(p, v, \
+							    __ATOMIC_ACQ_REL)
+
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    /* Volatile accesses have acquire/release semantics here */
+#   include <intrin.h>
+#   define PJ_HAS_ATOMIC_ACQ_REL		1
+#   define PJ_ATOMIC_LOAD_ACQUIRE(p)	(*(volatile unsigned*)(p))
+#   define PJ_ATOMIC_STORE_RELEASE(p,v)	(*(volatile unsigned*)(p) = (v))
+#   define PJ_ATOMIC_LOAD_ACQUIRE_PTR(p)	(*(void* volatile*)(p))
+#   define PJ_ATOMIC_STORE_RELEASE_PTR(p,v) (*(void* volatile*)(p) = (v))
+#   define PJ_ATOMIC_EXCHANGE_PTR(p,v)	_InterlockedExchangePointer( \
+					    (void* volatile*)(p), v)
+
+#else
+#   define PJ_HAS_ATOMIC_ACQ_REL		0
+#   define PJ_ATOMIC_LOAD_ACQUIRE(p)	(*(p))
+#   define PJ_ATOMIC_STORE_RELEASE(p,v)	(*(p) = (v))
+#   define PJ_ATOMIC_LOAD_ACQUIRE_PTR(p)	(*(p))
+#   define PJ_ATOMIC_STORE_RELEASE_PTR(p,v) (*(p) = (v))
+    /* PJ_ATOMIC_EXCHANGE_PTR() is not available */
+#endif
+
+#ifdef DOXYGEN
+/**
+ * Non-zero if the compiler provides acquire and release accesses. If
+ * zero, the macros below are plain accesses and
+ * #PJ_ATOMIC_EXCHANGE_PTR() is not defined.
+ */
+#   define PJ_HAS_ATOMIC_ACQ_REL
+
+/**
+ * Load an unsigned int with acquire semantics.
+ *
+ * @param p	Pointer to the variable.
+ * @return	The value.
+ */
+#   define PJ_ATOMIC_LOAD_ACQUIRE(p)
+
+/**
+ * Store an unsigned int with release semantics.
+ *
+ * @param p	Pointer to the variable.
+ * @param v	The value.
+ */
+#   define PJ_ATOMIC_STORE_RELEASE(p,v)
+
+/**
+ * Load a pointer with acquire semantics. With some compilers the value
+ * is returned as void pointer.
+ *
+ * @param p	Pointer to the pointer variable.
+ * @return	The value.
+ */
+#   define PJ_ATOMIC_LOAD_ACQUIRE_PTR(p)
+
+/**
+ * Store a pointer with release semantics.
+ *
+ * @param p	Pointer to the pointer variable.
+ * @param v	The value.
+ */
+#   define PJ_ATOMIC_STORE_RELEASE_PTR(p,v)
+
+/**
+ * Atomically replace a pointer, with acquire and release semantics.
+ * With some compilers the old value is returned as void pointer.
+ *
+ * @param p	Pointer to the pointer variable.
+ * @param v	The new value.
+ * @return	The old value.
+ */
+#   define PJ_ATOMIC_EXCHANGE_PTR(p,v)
+#endif
+
+/**
+ * @}
+ */
+
+#endif	/* __PJ_ATOMIC_H__ */
@@ -75,6 +75,10 @@
 
 #define PJ_ALIGN_DATA(declaration, alignment) declaration __attribute__((aligned (alignment)))
 
+#define PJ_THREAD_LOCAL_SPECIFIER	__thread
+
+#define PJ_RETURN_ADDRESS()		__builtin_return_address(0)
+
 
 #endif	/* __PJ_COMPAT_CC_GCC_H__ */
 
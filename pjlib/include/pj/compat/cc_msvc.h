@@ -83,6 +83,12 @@ typedef unsigned __int64 pj_uint64_t;
 
 #define PJ_ALIGN_DATA(declaration, alignment) __declspec(align(alignment)) declaration
 
+#define PJ_THREAD_LOCAL_SPECIFIER	__declspec(thread)
+
+#include <intrin.h>
+#pragma intrinsic(_ReturnAddress)
+#define PJ_RETURN_ADDRESS()		_ReturnAddress()
+
 
 #endif	/* __PJ_COMPAT_CC_MSVC_H__ */
 
@@ -50,6 +50,19 @@
 #  error "PJ_ALIGN_DATA is not defined!"
 #endif
 
+/* PJ_THREAD_LOCAL_SPECIFIER is the compiler specific storage class for
+ * thread local variables. It is optional; when it is not defined, code
+ * which would use it falls back to shared state or pj_thread_local_get().
+ */
+
+/* PJ_RETURN_ADDRESS() gives the return address of the current function,
+ * and is used to identify call sites in diagnostics. It yields NULL when
+ * the compiler does not support it.
+ */
+#ifndef PJ_RETURN_ADDRESS
+#  define PJ_RETURN_ADDRESS()	((void*)0)
+#endif
+
 /********************************************************************
  * Include target OS specific configuration.
  */
@@ -492,6 +505,112 @@
 #   define PJ_LOG_THREAD_WIDTH	    12
 #endif
 
+/**
+ * Default size of the ring buffer of each thread in asynchronous logging
+ * mode, in bytes. Must be a power of two. See #pj_log_async_start().
+ *
+ * Default: 64 KB
+ */
+#ifndef PJ_LOG_ASYNC_RING_SIZE
+#   define PJ_LOG_ASYNC_RING_SIZE   (64 * 1024)
+#endif
+
+/**
+ * Maximum number of threads which get their own ring buffer in
+ * asynchronous logging mode. Other threads share a single ring which is
+ * protected by a mutex.
+ *
+ * Default: 32
+ */
+#ifndef PJ_LOG_ASYNC_MAX_THREADS
+#   define PJ_LOG_ASYNC_MAX_THREADS 32
+#endif
+
+/**
+ * Default interval of the asynchronous log writer thread to write the
+ * queued messages, in milliseconds.
+ *
+ * Default: 20
+ */
+#ifndef PJ_LOG_ASYNC_FLUSH_INTERVAL
+#   define PJ_LOG_ASYNC_FLUSH_INTERVAL 20
+#endif
+
+/**
+ * Maximum size of a deferred log record, i.e. the format string, the
+ * arguments and the copied string arguments. Larger messages are formatted
+ * by the calling thread. The record is built on the stack of the calling
+ * thread.
+ *
+ * Default: 1024
+ */
+#ifndef PJ_LOG_DEFERRED_MAX_SIZE
+#   define PJ_LOG_DEFERRED_MAX_SIZE 1024
+#endif
+
+/**
+ * Maximum average number of entries per bucket of resizable hash table
+ * (see #pj_hash_create_resizable()) before the table is resized.
+ *
+ * Default: 2
+ */
+#ifndef PJ_HASH_MAX_LOAD
+#   define PJ_HASH_MAX_LOAD	    2
+#endif
+
+/**
+ * Default number of objects carved from each memory chunk of a slab
+ * allocator (see #pj_slab_create()).
+ *
+ * Default: 16
+ */
+#ifndef PJ_SLAB_OBJ_PER_CHUNK
+#   define PJ_SLAB_OBJ_PER_CHUNK    16
+#endif
+
+/**
+ * Maximum number of freed objects which each thread keeps for each slab
+ * allocator, so that allocation and release normally do not need to take
+ * the slab lock. The thread cache needs PJ_THREAD_LOCAL_SPECIFIER and
+ * destructor support in pj_thread_local_alloc2(), otherwise it is disabled
+ * at run time; set this to zero to disable it.
+ *
+ * Default: 8
+ */
+#ifndef PJ_SLAB_THREAD_CACHE_SIZE
+#   define PJ_SLAB_THREAD_CACHE_SIZE 8
+#endif
+
+/**
+ * Number of slab allocators which can have a thread cache in the same
+ * thread at the same time. Other slabs go through the slab lock.
+ *
+ * Default: 8
+ */
+#ifndef PJ_SLAB_THREAD_CACHE_SLOTS
+#   define PJ_SLAB_THREAD_CACHE_SLOTS 8
+#endif
+
+/**
+ * Maximum number of pool name prefixes tracked by the pool profiler (see
+ * #pj_caching_pool_prof_start()). Pools with other prefixes are counted
+ * together as "(other)".
+ *
+ * Default: 64
+ */
+#ifndef PJ_POOL_PROF_MAX_CLASSES
+#   define PJ_POOL_PROF_MAX_CLASSES 64
+#endif
+
+/**
+ * Maximum number of allocation sites tracked by the pool profiler.
+ *
+ * Default: 256
+ */
+#ifndef PJ_POOL_PROF_MAX_SITES
+#   define PJ_POOL_PROF_MAX_SITES   256
+#endif
+
 /**
  * Colorfull terminal (for logging etc).
  *
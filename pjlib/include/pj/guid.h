@@ -71,6 +71,12 @@ PJ_DECL(unsigned) pj_GUID_STRING_LENGTH(void);
  */
 #define PJ_GUID_MAX_LENGTH  36
 
+/**
+ * PJ_GUID_MIN_LENGTH specifies the minimum length of GUID string,
+ * regardless of which algorithm to use.
+ */
+#define PJ_GUID_MIN_LENGTH  32
+
 /**
  * Create a globally unique string, which length is PJ_GUID_STRING_LENGTH
  * characters. Caller is responsible for preallocating the storage used
@@ -110,6 +116,32 @@ PJ_DECL(void) pj_create_unique_string(pj_pool_t *pool, pj_str_t *str);
 PJ_DECL(void) pj_create_unique_string_lower(pj_pool_t *pool, pj_str_t *str);
 
 
+/**
+ * Create a unique string quickly, without locking and, except for the
+ * first call in each thread, without calling the GUID generator. The
+ * string consists of a random prefix specific to the calling thread, a
+ * counter and at least 32 bits of randomness from pj_rand(), in lowercase
+ * hexadecimal digits. Its length is PJ_GUID_STRING_LENGTH characters, so
+ * it can replace pj_generate_unique_string() where uniqueness is needed
+ * but unpredictability is not, such as SIP branch parameters and tags.
+ * It must not be used where the value has to be unguessable.
+ *
+ * @param str       The string to store the result. The caller must have
+ *		    allocated PJ_GUID_STRING_LENGTH characters.
+ *
+ * @return          The string.
+ */
+PJ_DECL(pj_str_t*) pj_generate_unique_string_fast(pj_str_t *str);
+
+/**
+ * Generate a unique string with pj_generate_unique_string_fast().
+ *
+ * @param pool	    Pool to allocate memory from.
+ * @param str	    The string.
+ */
+PJ_DECL(void) pj_create_unique_string_fast(pj_pool_t *pool, pj_str_t *str);
+
+
 /**
  * @}
  */
@@ -96,6 +96,28 @@ PJ_DECL(pj_uint32_t) pj_hash_calc_tolower(pj_uint32_t hval,
 PJ_DECL(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size);
 
 
+/**
+ * Create a hash table which doubles its bucket size when the number of
+ * entries exceeds PJ_HASH_MAX_LOAD entries per bucket. The entries are
+ * moved to the larger table incrementally, a few buckets on each insertion,
+ * so there's no latency spike when the table grows. The larger bucket
+ * arrays are allocated from the same pool, so the pool must remain valid
+ * for the lifetime of the table and must be protected by the same lock as
+ * the hash table.
+ *
+ * Note that inserting new entries while iterating the table may cause the
+ * iteration to skip or to revisit entries. Deleting entries is safe.
+ *
+ * @param pool	the pool from which the hash table will be allocated from.
+ * @param size	the initial bucket size, which will be round-up to the
+ *		nearest 2^n-1
+ *
+ * @return the hash table.
+ */
+PJ_DECL(pj_hash_table_t*) pj_hash_create_resizable(pj_pool_t *pool,
+						   unsigned size);
+
+
 /**
  * Get the value associated with the specified key.
  *
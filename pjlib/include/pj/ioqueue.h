@@ -325,6 +325,18 @@ typedef enum pj_ioqueue_operation_e
 #endif
 
 
+/**
+ * This macro specifies the maximum number of posted callbacks (see
+ * #pj_ioqueue_post()) to be called on a single poll cycle. The rest are
+ * called on the next poll cycles, so that socket events are not delayed
+ * for too long. The value is only meaningfull when specified during PJLIB
+ * build.
+ */
+#ifndef PJ_IOQUEUE_MAX_POST_IN_SINGLE_POLL
+#   define PJ_IOQUEUE_MAX_POST_IN_SINGLE_POLL	(64)
+#endif
+
+
 /**
  * When this flag is specified in ioqueue's recv() or send() operations,
  * the ioqueue will always mark the operation as asynchronous.
@@ -589,6 +601,38 @@ PJ_DECL(pj_status_t) pj_ioqueue_post_completion( pj_ioqueue_key_t *key,
                                                  pj_ssize_t bytes_status );
 
 
+/**
+ * Type of the callback to be called by #pj_ioqueue_post().
+ *
+ * @param arg		The argument given to #pj_ioqueue_post().
+ */
+typedef void pj_ioqueue_post_cb(void *arg);
+
+/**
+ * Schedule a callback to be called by the thread polling the ioqueue.
+ * This function may be called from any thread, and is a cheap way to
+ * hand work over to the ioqueue thread without taking any lock there.
+ *
+ * Posted callbacks are called in the order they are posted, from
+ * #pj_ioqueue_poll(), in batches of at most
+ * #PJ_IOQUEUE_MAX_POST_IN_SINGLE_POLL callbacks per poll. The ioqueue is
+ * woken up when it is waiting for events. Callbacks which are still
+ * pending when the ioqueue is destroyed are not called.
+ *
+ * This is currently supported by the select and epoll ioqueues.
+ *
+ * @param ioque		The I/O Queue.
+ * @param cb		The callback.
+ * @param arg		Argument to be given to the callback.
+ *
+ * @return		PJ_SUCCESS, or PJ_ENOTSUP if the ioqueue does not
+ *			support it, or other error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_post( pj_ioqueue_t *ioque,
+				      pj_ioqueue_post_cb *cb,
+				      void *arg );
+
+
 
 #if defined(PJ_HAS_TCP) && PJ_HAS_TCP != 0
 /**
@@ -181,13 +181,31 @@ PJ_DECL(pj_status_t) pj_lock_destroy( pj_lock_t *lock );
  * Please see https://trac.pjsip.org/repos/wiki/Group_Lock for more info.
  */
 
+/**
+ * Group lock creation flags, to be set in pj_grp_lock_config.
+ */
+typedef enum pj_grp_lock_flag
+{
+    /**
+     * Enable the shared (reader) mode of the group lock. When this flag is
+     * set, pj_grp_lock_acquire_shared() lets several threads hold the lock
+     * at the same time as long as nobody holds it exclusively. Exclusive
+     * acquisitions become slightly more expensive, since they have to wait
+     * for the current readers to leave. See pj_grp_lock_acquire_shared().
+     */
+    PJ_GRP_LOCK_SHARED = 1
+
+} pj_grp_lock_flag;
+
 /**
  * Settings for creating the group lock.
  */
 typedef struct pj_grp_lock_config
 {
     /**
-     * Creation flags, currently must be zero.
+     * Creation flags, bitmask of #pj_grp_lock_flag.
+     *
+     * Default: 0
      */
     unsigned	flags;
 
@@ -270,11 +288,14 @@ PJ_DECL(pj_status_t) pj_grp_lock_acquire( pj_grp_lock_t *grp_lock);
 
 /**
  * Acquire lock on the specified group lock if it is available, otherwise
- * return immediately wihout waiting.
+ * return immediately wihout waiting. If the group lock is held in shared
+ * mode (see pj_grp_lock_acquire_shared()), the function returns PJ_EBUSY
+ * rather than waiting for the readers to release it.
  *
  * @param grp_lock	The group lock.
  *
- * @return		PJ_SUCCESS or the appropriate error code.
+ * @return		PJ_SUCCESS, PJ_EBUSY if the lock is held in shared
+ *			mode, or the appropriate error code.
  */
 PJ_DECL(pj_status_t) pj_grp_lock_tryacquire( pj_grp_lock_t *grp_lock);
 
@@ -289,6 +310,43 @@ PJ_DECL(pj_status_t) pj_grp_lock_tryacquire( pj_grp_lock_t *grp_lock);
  */
 PJ_DECL(pj_status_t) pj_grp_lock_release( pj_grp_lock_t *grp_lock);
 
+/**
+ * Acquire the group lock in shared (reader) mode. Several threads may hold
+ * the lock in shared mode at the same time, while an exclusive acquisition
+ * with pj_grp_lock_acquire() waits until all readers have released it, and
+ * new readers wait while the lock is held exclusively. The reference
+ * counter is incremented as with pj_grp_lock_acquire(), so the group lock
+ * will not be destroyed while it is held.
+ *
+ * Shared mode must be enabled with PJ_GRP_LOCK_SHARED when creating the
+ * group lock, otherwise this function is the same as pj_grp_lock_acquire().
+ * Only the group lock's own lock is shared; chained locks (see
+ * pj_grp_lock_chain_lock()) are not acquired by readers.
+ *
+ * If the calling thread already holds the lock exclusively, the lock is
+ * acquired exclusively again (recursively). Note however that a thread
+ * which holds the lock in shared mode must not acquire it again, neither
+ * in shared nor in exclusive mode, as this may deadlock with a waiting
+ * writer.
+ *
+ * @param grp_lock	The group lock.
+ *
+ * @return		PJ_SUCCESS or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_grp_lock_acquire_shared( pj_grp_lock_t *grp_lock);
+
+/**
+ * Release the lock previously acquired with pj_grp_lock_acquire_shared().
+ * This may cause the group lock to be destroyed if it is the last one to
+ * hold the reference counter. In that case, the function will return
+ * PJ_EGONE.
+ *
+ * @param grp_lock	The group lock.
+ *
+ * @return		PJ_SUCCESS or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_grp_lock_release_shared( pj_grp_lock_t *grp_lock);
+
 /**
  * Add a destructor handler, to be called by the group lock when it is
  * about to be destroyed.
@@ -133,6 +133,73 @@ typedef void pj_log_func(int level, const char *data, int len);
 PJ_DECL(void) pj_log_write(int level, const char *buffer, int len);
 
 
+/**
+ * Asynchronous logging settings, to be specified with
+ * #pj_log_async_start().
+ */
+typedef struct pj_log_async_param
+{
+    /**
+     * Size of the ring buffer of each thread, in bytes. Must be a power
+     * of two.
+     *
+     * Default: PJ_LOG_ASYNC_RING_SIZE
+     */
+    unsigned	ring_size;
+
+    /**
+     * Interval of the writer thread to write the queued messages, in
+     * milliseconds.
+     *
+     * Default: PJ_LOG_ASYNC_FLUSH_INTERVAL
+     */
+    unsigned	flush_interval;
+
+    /**
+     * Defer the formatting of the messages to the writer thread. The
+     * calling thread only copies the format string and the arguments into
+     * the ring, so the cost of logging doesn't depend on the complexity of
+     * the message. Messages with arguments that can't be copied (such as
+     * %n, wide characters or positional arguments), or which are too
+     * large (see PJ_LOG_DEFERRED_MAX_SIZE), are formatted by the calling
+     * thread as usual.
+     *
+     * Note that the strings passed as "%s" argument are copied, but
+     * anything referred to by a "%p" argument is not, and the time of
+     * the message is taken from the high resolution timestamp.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t	deferred;
+
+    /**
+     * If set, the messages are not formatted at all but written as binary
+     * records to this file, to be decoded later with #pj_log_decode_file()
+     * (for example with the pjsip-apps/src/samples/logdecode.c tool). This
+     * implies deferred formatting. The file is in host byte order and
+     * structure layout, so it must be decoded by a program built with the
+     * same library and configuration. The file is overwritten.
+     */
+    pj_str_t	binary_file;
+
+} pj_log_async_param;
+
+/**
+ * Asynchronous logging statistics.
+ */
+typedef struct pj_log_async_stat
+{
+    /** Number of messages queued. */
+    pj_uint32_t	queued;
+
+    /** Number of messages passed to the log output function. */
+    pj_uint32_t	written;
+
+    /** Number of messages dropped because the ring was full. */
+    pj_uint32_t	dropped;
+
+} pj_log_async_stat;
+
 #if PJ_LOG_MAX_LEVEL >= 1
 
 /**
@@ -242,11 +309,105 @@ PJ_DECL(void) pj_log_set_color(int level, pj_color_t color);
  */
 PJ_DECL(pj_color_t) pj_log_get_color(int level);
 
+/**
+ * Initialize asynchronous logging settings with default values.
+ *
+ * @param param	    The settings.
+ */
+PJ_DECL(void) pj_log_async_param_default(pj_log_async_param *param);
+
+/**
+ * Start asynchronous logging. In this mode the messages are still
+ * formatted by the calling thread, but instead of calling the log output
+ * function they are copied into a ring buffer owned by the calling thread,
+ * without taking any lock. A writer thread periodically collects the
+ * messages of all rings in time order and passes them to the log output
+ * function (see #pj_log_set_log_func()), joining consecutive messages of
+ * the same level into one call to reduce the number of writes.
+ *
+ * When a ring is full the message is dropped instead of blocking the
+ * caller, and the number of dropped messages is reported in the log.
+ *
+ * @param pf	    Pool factory to allocate the ring buffers.
+ * @param param	    Settings, or NULL to use default settings.
+ *
+ * @return	    PJ_SUCCESS on success, PJ_EEXISTS if asynchronous
+ *		    logging is already started, or the appropriate error
+ *		    code.
+ */
+PJ_DECL(pj_status_t) pj_log_async_start(pj_pool_factory *pf,
+					const pj_log_async_param *param);
+
+/**
+ * Write the queued messages now, from the calling thread.
+ */
+PJ_DECL(void) pj_log_async_flush(void);
+
+/**
+ * Get asynchronous logging statistics.
+ *
+ * @param stat	    Buffer to receive the statistics.
+ */
+PJ_DECL(void) pj_log_async_get_stat(pj_log_async_stat *stat);
+
+/**
+ * Stop asynchronous logging, after writing all queued messages. This
+ * function must not be called while other threads may still be logging,
+ * e.g. call it during application shutdown after the worker threads have
+ * been stopped.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_log_async_stop(void);
+
+/**
+ * Decode binary log file written by asynchronous logging with
+ * \a binary_file setting, and pass the formatted messages to the
+ * specified writer, one message at a time. The messages are decorated
+ * according to the decor flags in effect when the file was written.
+ *
+ * @param path	    The binary log file.
+ * @param writer    The function to receive the formatted messages.
+ *
+ * @return	    PJ_SUCCESS on success, PJ_EINVAL if the file is not a
+ *		    valid binary log file, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_log_decode_file(const char *path,
+					pj_log_func *writer);
+
 /**
  * Internal function to be called by pj_init()
  */
 pj_status_t pj_log_init(void);
 
+/**
+ * Internal function to queue a formatted message in asynchronous mode.
+ *
+ * @return	    PJ_TRUE if the message has been queued or dropped, or
+ *		    PJ_FALSE if asynchronous logging is not active.
+ */
+pj_bool_t pj_log_async_put(int level, const char *data, int len);
+
+/**
+ * Internal function to queue the format and arguments of a message in
+ * deferred mode.
+ *
+ * @return	    PJ_TRUE if the message has been queued or dropped, or
+ *		    PJ_FALSE if it must be formatted by the caller.
+ */
+pj_bool_t pj_log_async_put_fmt(const char *sender, int level, int indent,
+			       const char *format, va_list marker);
+
+/**
+ * Internal function to build the decoration of a message.
+ *
+ * @return	    The length of the decoration.
+ */
+int pj_log_format_prefix(char *buf, unsigned decor, int level,
+			 const char *sender, const pj_parsed_time *ptime,
+			 const char *thread_name, pj_bool_t thread_switched,
+			 int indent);
+
 #else	/* #if PJ_LOG_MAX_LEVEL >= 1 */
 
 /**
@@ -344,6 +505,36 @@ pj_status_t pj_log_init(void);
 #  define pj_log_get_color(level) 0
 
 
+/**
+ * Start asynchronous logging.
+ */
+#  define pj_log_async_start(pf, param)	PJ_SUCCESS
+
+/**
+ * Initialize asynchronous logging settings.
+ */
+#  define pj_log_async_param_default(param)
+
+/**
+ * Write the queued messages.
+ */
+#  define pj_log_async_flush()
+
+/**
+ * Get asynchronous logging statistics.
+ */
+#  define pj_log_async_get_stat(stat)
+
+/**
+ * Stop asynchronous logging.
+ */
+#  define pj_log_async_stop()		PJ_SUCCESS
+
+/**
+ * Decode binary log file.
+ */
+#  define pj_log_decode_file(path, writer)	PJ_ENOTSUP
+
 /**
  * Internal.
  */
@@ -0,0 +1,115 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_MPSC_QUEUE_H__
+#define __PJ_MPSC_QUEUE_H__
+
+/**
+ * @file mpsc_queue.h
+ * @brief Multiple producer, single consumer queue.
+ */
+
+#include <pj/types.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_MPSC_QUEUE Multiple Producer Single Consumer Queue
+ * @ingroup PJ_DS
+ * @{
+ *
+ * This is a FIFO queue which any number of threads may push to, while
+ * only one thread at a time pops from it. It is meant to hand work over
+ * to another thread, for example to the thread polling the ioqueue (see
+ * #pj_ioqueue_post()).
+ *
+ * Like the linked list, the queue is intrusive: the application embeds
+ * a #pj_mpsc_node in its own structure, so the queue never allocates
+ * memory. A node can only be in one queue at a time.
+ *
+ * Where the compiler provides atomic operations, pushing takes a single
+ * atomic exchange and popping takes no lock at all. Otherwise the queue
+ * falls back to a mutex.
+ */
+
+/**
+ * Queue node. Declare it as the first member of the structure to be
+ * queued, so that the popped node can be cast back to the structure.
+ */
+typedef struct pj_mpsc_node
+{
+    /** Next node, used internally by the queue. */
+    struct pj_mpsc_node *next;
+} pj_mpsc_node;
+
+/**
+ * Opaque declaration of the queue.
+ */
+typedef struct pj_mpsc_queue pj_mpsc_queue;
+
+
+/**
+ * Create an empty queue.
+ *
+ * @param pool		Pool to allocate the queue.
+ * @param p_queue	Pointer to receive the queue.
+ *
+ * @return		PJ_SUCCESS or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_mpsc_queue_create(pj_pool_t *pool,
+					  pj_mpsc_queue **p_queue);
+
+/**
+ * Push a node to the end of the queue. This function may be called by
+ * several threads at once.
+ *
+ * @param queue		The queue.
+ * @param node		The node, which must not be in any queue.
+ */
+PJ_DECL(void) pj_mpsc_queue_push(pj_mpsc_queue *queue, pj_mpsc_node *node);
+
+/**
+ * Pop the node at the front of the queue. Only one thread at a time may
+ * call this function. If a producer is in the middle of pushing the
+ * front node, this function waits for the push to complete.
+ *
+ * @param queue		The queue.
+ *
+ * @return		The node, or NULL if the queue is empty.
+ */
+PJ_DECL(pj_mpsc_node*) pj_mpsc_queue_pop(pj_mpsc_queue *queue);
+
+/**
+ * Destroy the queue. Nodes still in the queue are not touched.
+ *
+ * @param queue		The queue.
+ *
+ * @return		PJ_SUCCESS.
+ */
+PJ_DECL(pj_status_t) pj_mpsc_queue_destroy(pj_mpsc_queue *queue);
+
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif	/* __PJ_MPSC_QUEUE_H__ */
+
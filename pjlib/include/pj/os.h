@@ -271,6 +271,92 @@ PJ_DECL(int) pj_thread_get_prio_min(pj_thread_t *thread);
 PJ_DECL(int) pj_thread_get_prio_max(pj_thread_t *thread);
 
 
+/**
+ * Thread scheduling policy, to be used with #pj_thread_set_sched().
+ */
+typedef enum pj_thread_sched_policy
+{
+    /**
+     * Keep the current scheduling policy of the thread, and only set its
+     * priority, as #pj_thread_set_prio() does.
+     */
+    PJ_THREAD_SCHED_DEFAULT,
+
+    /**
+     * Normal time sharing policy (SCHED_OTHER).
+     */
+    PJ_THREAD_SCHED_NORMAL,
+
+    /**
+     * Real-time first in, first out policy (SCHED_FIFO).
+     */
+    PJ_THREAD_SCHED_FIFO,
+
+    /**
+     * Real-time round robin policy (SCHED_RR).
+     */
+    PJ_THREAD_SCHED_RR
+
+} pj_thread_sched_policy;
+
+
+/**
+ * Set the scheduling policy and priority of the thread. Real-time
+ * policies normally need elevated privileges, in which case the function
+ * returns the OS error. Windows only supports #PJ_THREAD_SCHED_DEFAULT.
+ *
+ * @param thread	Thread handle.
+ * @param policy	The scheduling policy.
+ * @param prio		Priority in the range of the policy. For example,
+ *			on Linux real-time priorities are from 1 to 99,
+ *			while the normal policy only accepts zero.
+ *
+ * @return		PJ_SUCCESS on success, PJ_ENOTSUP if the policy is
+ *			not supported, or the error code.
+ */
+PJ_DECL(pj_status_t) pj_thread_set_sched(pj_thread_t *thread,
+					 pj_thread_sched_policy policy,
+					 int prio);
+
+
+/**
+ * Restrict the thread to run only on the specified CPUs, so that it is
+ * not migrated to other CPUs by the OS scheduler. This is supported on
+ * Linux and Windows; on Windows only the first 64 CPUs can be specified.
+ *
+ * @param thread	Thread handle.
+ * @param cpu_cnt	Number of CPUs in the array. Zero allows the thread
+ *			to run on all CPUs again.
+ * @param cpu		Array of zero based CPU indexes.
+ *
+ * @return		PJ_SUCCESS on success, PJ_ENOTSUP if the platform
+ *			does not support it, or the error code.
+ */
+PJ_DECL(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread,
+					    unsigned cpu_cnt,
+					    const unsigned cpu[]);
+
+
+/**
+ * Get the CPUs which belong to a NUMA node. To place a thread in a NUMA
+ * node, give the CPUs to #pj_thread_set_affinity(). Memory allocated by
+ * the thread afterwards will normally be taken from the node too. This
+ * is currently only supported on Linux.
+ *
+ * @param node		Zero based NUMA node index.
+ * @param cpu_cnt	On input, the size of the array. On output, the
+ *			number of CPUs returned.
+ * @param cpu		Array to receive the CPU indexes.
+ *
+ * @return		PJ_SUCCESS on success, PJ_ENOTFOUND if there is no
+ *			such node, PJ_ENOTSUP if the platform does not
+ *			support it, or the error code.
+ */
+PJ_DECL(pj_status_t) pj_get_numa_node_cpus(unsigned node,
+					   unsigned *cpu_cnt,
+					   unsigned cpu[]);
+
+
 /**
  * Return native handle from pj_thread_t for manipulation using native
  * OS APIs.
@@ -328,6 +414,10 @@ PJ_DECL(pj_status_t) pj_thread_join(pj_thread_t *thread);
  * However, the memory allocated for the pj_thread_t itself will only be released
  * when the pool used to create the thread is destroyed.
  *
+ * A thread registered with #pj_thread_register() may call this with its
+ * own handle when it is done with pjlib, to have the destructors of its
+ * thread local variables called (see #pj_thread_local_alloc2()).
+ *
  * @param thread    The thread handle.
  *
  * @return zero on success.
@@ -523,6 +613,24 @@ PJ_DECL(void) pj_symbianos_set_connection_status(pj_bool_t up);
  */
 PJ_DECL(pj_status_t) pj_thread_local_alloc(long *index);
 
+/**
+ * Allocate thread local storage index, with a destructor. When the value
+ * of the variable is not NULL, the destructor is called with the value by
+ * a thread created with #pj_thread_create() when its entry function
+ * returns, and by a thread which calls #pj_thread_destroy() with its own
+ * handle. The thread is still registered then, so the destructor may use
+ * pjlib functions such as mutexes. It is not called for other threads
+ * which simply exit, once the index has been freed with
+ * #pj_thread_local_free(), nor for the main thread when the process exits.
+ *
+ * @param index	    Pointer to hold the return value.
+ * @param dtor	    The destructor, or NULL.
+ * @return	    PJ_SUCCESS on success, PJ_ENOTSUP if the platform can't
+ *		    call destructors, or the error code.
+ */
+PJ_DECL(pj_status_t) pj_thread_local_alloc2(long *index,
+					    void (*dtor)(void *value));
+
 /**
  * Deallocate thread local variable.
  *
@@ -1179,6 +1287,64 @@ PJ_DECL(pj_color_t) pj_term_get_color(void);
  */
 PJ_DECL(pj_status_t) pj_gettickcount(pj_time_val *tv);
 
+/**
+ * Get monotonic time with coarse resolution. This is the same clock as
+ * pj_gettickcount(), but on platforms which support it (e.g. Linux with
+ * CLOCK_MONOTONIC_COARSE), the value is read without accessing the
+ * hardware clock source, which makes it several times cheaper.
+ *
+ * The resolution is the system tick, typically 1 to 4 msec on Linux.
+ * The returned value is never ahead of pj_gettickcount(), and it lags
+ * behind by at most one system tick. On other platforms this is the same
+ * as pj_gettickcount().
+ *
+ * @param tv	Variable to store the result.
+ *
+ * @return PJ_SUCCESS if successful.
+ */
+PJ_DECL(pj_status_t) pj_gettickcount_coarse(pj_time_val *tv);
+
+/**
+ * Get the cached monotonic time, i.e. the most recent value stored with
+ * pj_gettickcount_update_cache(). The cache is updated by
+ * pj_ioqueue_poll() (select and epoll backends) whenever it returns with
+ * events, and by pj_timer_heap_poll(), so reading it costs only a memory
+ * load.
+ *
+ * The value is never ahead of pj_gettickcount(). It lags behind by the
+ * time elapsed since the last update by any thread, plus the resolution
+ * of pj_gettickcount_coarse(). Hence it is suitable for code which runs
+ * in ioqueue or timer callbacks (the lag is then bounded by the time spent
+ * dispatching the current batch of events) and needs no more than
+ * millisecond-level accuracy, such as activity tracking and keep-alive
+ * scheduling. Threads which don't poll may see a value which is as old
+ * as the polling timeout, and should use pj_gettickcount() instead.
+ *
+ * If the cache has never been updated, this function updates it first.
+ *
+ * There is one cache for the process rather than one per ioqueue. The
+ * monotonic clock is the same for every thread and the cache never goes
+ * backwards, so an update from any ioqueue is valid for all of them, and
+ * callbacks of a mostly idle ioqueue get a fresher value from the busy
+ * ones. The cost of sharing is bounded too: an update which doesn't
+ * advance the cached millisecond is only a load, so the cache is written
+ * at most once per millisecond, whatever the number of polling threads.
+ *
+ * @param tv	Variable to store the result.
+ */
+PJ_DECL(void) pj_gettickcount_cached(pj_time_val *tv);
+
+/**
+ * Update the cached monotonic time returned by pj_gettickcount_cached().
+ * The cache never goes backwards, so a stale value from a slower thread
+ * is ignored.
+ *
+ * @param now	The current time as returned by pj_gettickcount() or
+ *		pj_gettickcount_coarse(), or NULL to read the current time
+ *		with pj_gettickcount_coarse().
+ */
+PJ_DECL(void) pj_gettickcount_update_cache(const pj_time_val *now);
+
 /**
  * Acquire high resolution timer value. The time value are stored
  * in cycles.
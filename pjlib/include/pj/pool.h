@@ -335,6 +335,9 @@ struct pj_pool_t
     /** The callback to be called when the pool is unable to allocate memory. */
     pj_pool_callback *callback;
 
+    /** Pool profiler class of this pool, or NULL when it is not profiled. */
+    struct pj_pool_prof_class *prof;
+
 };
 
 
@@ -769,6 +772,29 @@ PJ_DECL(void) pj_pool_init_int( pj_pool_t *pool,
  */
 PJ_DECL(void) pj_pool_destroy_int( pj_pool_t *pool );
 
+/**
+ * This function is intended to be used by pool implementors, to report
+ * the change of the pool capacity to the pool profiler. It must only be
+ * called when pool->prof is set.
+ *
+ * @param pool		    The memory pool.
+ * @param old_capacity	    The capacity before the change.
+ */
+PJ_DECL(void) pj_pool_prof_on_resize( pj_pool_t *pool,
+				      pj_size_t old_capacity );
+
+/**
+ * This function is intended to be used by pool implementors, to report
+ * an allocation to the pool profiler. It must only be called when
+ * pool->prof is set.
+ *
+ * @param pool		    The memory pool.
+ * @param size		    The size of the allocation.
+ * @param site		    The allocation site, or NULL.
+ */
+PJ_DECL(void) pj_pool_prof_on_alloc( pj_pool_t *pool, pj_size_t size,
+				     void *site );
+
 
 /**
  * Dump pool factory state.
@@ -871,6 +897,11 @@ struct pj_caching_pool
      * Mutex.
      */
     pj_lock_t	   *lock;
+
+    /**
+     * Pool profiler state, see #pj_caching_pool_prof_start().
+     */
+    struct pj_pool_prof *prof;
 };
 
 
@@ -898,6 +929,124 @@ PJ_DECL(void) pj_caching_pool_init( pj_caching_pool *ch_pool,
  */
 PJ_DECL(void) pj_caching_pool_destroy( pj_caching_pool *ch_pool );
 
+
+/**
+ * Maximum length of pool name prefix in the pool profiler.
+ */
+#define PJ_POOL_PROF_NAME_LEN	16
+
+/**
+ * Pool profiler statistic of the pools whose names share the same prefix.
+ * The prefix is the leading part of the pool name up to the first digit
+ * or '%' character, so for example "tsx", "dlg0x1f2e" and "dlg%p" are
+ * counted as "tsx" and "dlg".
+ */
+typedef struct pj_pool_prof_stat
+{
+    char	name[PJ_POOL_PROF_NAME_LEN]; /**< Pool name prefix.	    */
+    unsigned	pool_cnt;	    /**< Number of pools alive.		    */
+    unsigned	peak_pool_cnt;	    /**< Highest number of pools alive.	    */
+    unsigned	created;	    /**< Number of pools created.	    */
+    pj_size_t	capacity;	    /**< Bytes allocated to the pools.	    */
+    pj_size_t	used;		    /**< Bytes used in the pools.	    */
+    pj_size_t	peak_capacity;	    /**< Highest total capacity.	    */
+    pj_size_t	max_pool_capacity;  /**< Highest capacity of one pool.	    */
+    pj_size_t	max_pool_used;	    /**< Highest used size of one pool.	    */
+    unsigned	alloc_cnt;	    /**< Number of allocations, only counted
+					 when sites are profiled.	    */
+    pj_size_t	alloc_size;	    /**< Bytes allocated, only counted when
+					 sites are profiled.		    */
+} pj_pool_prof_stat;
+
+/**
+ * Pool profiler statistic of an allocation site.
+ */
+typedef struct pj_pool_prof_site
+{
+    void       *addr;		    /**< Return address of the allocation
+					 call, resolve with addr2line. See
+					 pj_caching_pool_prof_start() for
+					 inlined builds.		    */
+    char	name[PJ_POOL_PROF_NAME_LEN]; /**< Pool name prefix.	    */
+    unsigned	cnt;		    /**< Number of allocations.		    */
+    pj_size_t	size;		    /**< Total bytes allocated.		    */
+} pj_pool_prof_site;
+
+/**
+ * Start the pool profiler of the caching pool. Pools which are created
+ * after this call are accounted by their name prefix: number of pools,
+ * bytes allocated (capacity), used and wasted, and their high-water marks.
+ * The profiler adds no overhead to the pools while it is stopped.
+ *
+ * When \a sites is set, every allocation is also counted by its call site
+ * and size. This serializes allocations on the caching pool lock, so it
+ * should only be enabled for a short while. The call site is the return
+ * address of #pj_pool_alloc() or #pj_pool_calloc(). When
+ * PJ_FUNCTIONS_ARE_INLINED is set, these are inlined into the caller, so
+ * the recorded site is where the function which allocates was called
+ * from, one level up. Build without PJ_FUNCTIONS_ARE_INLINED to get the
+ * allocation call itself.
+ *
+ * Starting the profiler again clears the statistic.
+ *
+ * @param cp		The caching pool.
+ * @param sites		Also profile allocation sites.
+ *
+ * @return		PJ_SUCCESS or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_caching_pool_prof_start( pj_caching_pool *cp,
+						 pj_bool_t sites );
+
+/**
+ * Stop the pool profiler. The statistic is kept and can still be
+ * retrieved.
+ *
+ * @param cp		The caching pool.
+ */
+PJ_DECL(void) pj_caching_pool_prof_stop( pj_caching_pool *cp );
+
+/**
+ * Get the pool profiler statistic, sorted by capacity in descending
+ * order. The capacity and used size of the pools alive are sampled when
+ * this function is called.
+ *
+ * @param cp		The caching pool.
+ * @param stat		Array to receive the statistic.
+ * @param count		On input, the number of elements in the array. On
+ *			output, the number of elements filled in.
+ *
+ * @return		PJ_SUCCESS, or PJ_EINVALIDOP if the profiler has
+ *			never been started.
+ */
+PJ_DECL(pj_status_t) pj_caching_pool_prof_get_stat( pj_caching_pool *cp,
+						    pj_pool_prof_stat stat[],
+						    unsigned *count );
+
+/**
+ * Get the allocation sites profiled, sorted by the bytes allocated in
+ * descending order.
+ *
+ * @param cp		The caching pool.
+ * @param site		Array to receive the sites.
+ * @param count		On input, the number of elements in the array. On
+ *			output, the number of elements filled in.
+ *
+ * @return		PJ_SUCCESS, or PJ_EINVALIDOP if the profiler has
+ *			never been started.
+ */
+PJ_DECL(pj_status_t) pj_caching_pool_prof_get_sites( pj_caching_pool *cp,
+						     pj_pool_prof_site site[],
+						     unsigned *count );
+
+/**
+ * Dump the pool profiler statistic to log.
+ *
+ * @param cp		The caching pool.
+ * @param detail	Also dump the allocation sites.
+ */
+PJ_DECL(void) pj_caching_pool_prof_dump( pj_caching_pool *cp,
+					 pj_bool_t detail );
+
 /**
  * @}	// PJ_CACHING_POOL
  */
@@ -194,6 +194,9 @@ typedef struct pj_pool_block
 #define pj_caching_pool_init( cp, pol, mac)
 #define pj_caching_pool_destroy(cp)
 #define pj_pool_factory_dump(pf, detail)
+#define pj_caching_pool_prof_start(cp, sites)	PJ_ENOTSUP
+#define pj_caching_pool_prof_stop(cp)
+#define pj_caching_pool_prof_dump(cp, detail)
 
 PJ_END_DECL
 
@@ -55,18 +55,28 @@ PJ_IDEF(void*) pj_pool_alloc_from_block( pj_pool_block *block, pj_size_t size )
     return NULL;
 }
 
+/* With PJ_FUNCTIONS_ARE_INLINED, PJ_RETURN_ADDRESS() below is the return
+ * address of the function these are inlined into, see
+ * pj_caching_pool_prof_start().
+ */
 PJ_IDEF(void*) pj_pool_alloc( pj_pool_t *pool, pj_size_t size)
 {
     void *ptr = pj_pool_alloc_from_block(pool->block_list.next, size);
     if (!ptr)
 	ptr = pj_pool_allocate_find(pool, size);
+    if (pool->prof)
+	pj_pool_prof_on_alloc(pool, size, PJ_RETURN_ADDRESS());
     return ptr;
 }
 
 
 PJ_IDEF(void*) pj_pool_calloc( pj_pool_t *pool, pj_size_t count, pj_size_t size)
 {
-    void *buf = pj_pool_alloc( pool, size*count);
+    void *buf = pj_pool_alloc_from_block(pool->block_list.next, size*count);
+    if (!buf)
+	buf = pj_pool_allocate_find(pool, size*count);
+    if (pool->prof)
+	pj_pool_prof_on_alloc(pool, size*count, PJ_RETURN_ADDRESS());
     if (buf)
 	pj_bzero(buf, size * count);
     return buf;
@@ -38,10 +38,24 @@ PJ_BEGIN_DECL
  * This abstraction is needed not only because not all platforms have
  * \a rand() and \a srand(), but also on some platforms \a rand()
  * only has 16-bit randomness, which is not good enough.
+ *
+ * Where the compiler supports thread local variables, the generator is
+ * xoshiro256** with a separate state for each thread, so it needs no
+ * locking. It is fast and has good statistical quality, but it must not
+ * be used for cryptographic purposes.
  */
 
 /**
- * Put in seed to random number generator.
+ * Put in seed to random number generator. The calling thread will get a
+ * sequence of numbers which only depends on the seed, while other threads
+ * reinitialize their generator from the seed and their own identity.
+ *
+ * Note that with the per-thread generator, only the calling thread is
+ * reseeded to a reproducible sequence. The sequences of the other threads
+ * change, but they can't be reproduced with the seed, so an application
+ * which needs a repeatable sequence must draw the numbers from the thread
+ * which called this function. Without thread local variables, there is a
+ * single generator for the process as with \a srand().
  *
  * @param seed	    Seed value.
  */
@@ -0,0 +1,148 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_SLAB_H__
+#define __PJ_SLAB_H__
+
+/**
+ * @file slab.h
+ * @brief Slab allocator for fixed-size objects.
+ */
+
+#include <pj/pool.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_SLAB Slab Allocator
+ * @ingroup PJ_POOL_GROUP
+ * @{
+ *
+ * Memory pool can not release individual allocations, so objects with
+ * their own lifetime are usually given their own pool, which costs a pool
+ * header and the unused space of the pool block for every object.
+ *
+ * A slab allocator serves objects of a single size class. Objects are
+ * carved from memory chunks which are taken from a pool, and freed objects
+ * are kept in a free list to be reused by the next allocation. The memory
+ * chunks are only returned to the pool factory when the slab is destroyed.
+ *
+ * Each thread keeps a small cache of freed objects for each slab (see
+ * #PJ_SLAB_THREAD_CACHE_SIZE), so that allocation and release normally do
+ * not need to take the slab lock. An object may be freed by a different
+ * thread than the one which allocated it. The objects cached by a thread
+ * go back to the slab when the thread is done with pjlib (see
+ * #pj_thread_local_alloc2()), or when another slab takes over the cache
+ * slot. They stay in the cache of a thread registered with
+ * #pj_thread_register() which exits without calling #pj_thread_destroy()
+ * on itself.
+ */
+
+/**
+ * Opaque declaration of slab allocator.
+ */
+typedef struct pj_slab_t pj_slab_t;
+
+/**
+ * Slab allocator statistic, see #pj_slab_get_stat().
+ */
+typedef struct pj_slab_stat
+{
+    pj_size_t	obj_size;	/**< Object size after alignment.	    */
+    unsigned	in_use;		/**< Number of allocated objects.	    */
+    unsigned	peak;		/**< Highest number of allocated objects.   */
+    unsigned	capacity;	/**< Number of objects in all chunks.	    */
+    pj_size_t	mem_used;	/**< Memory taken from the pool factory.    */
+} pj_slab_stat;
+
+
+/**
+ * Create a slab allocator.
+ *
+ * @param factory	The pool factory to get the memory from.
+ * @param name		Name to identify the slab in the log, or NULL.
+ * @param obj_size	Size of each object.
+ * @param obj_per_chunk	Number of objects in each memory chunk, or zero
+ *			to use #PJ_SLAB_OBJ_PER_CHUNK.
+ * @param p_slab	Pointer to receive the slab allocator.
+ *
+ * @return		PJ_SUCCESS or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_slab_create(pj_pool_factory *factory,
+				    const char *name,
+				    pj_size_t obj_size,
+				    unsigned obj_per_chunk,
+				    pj_slab_t **p_slab);
+
+/**
+ * Allocate an object from the slab. The content of the object is
+ * undefined.
+ *
+ * @param slab		The slab allocator.
+ *
+ * @return		The object, or NULL if there is not enough memory.
+ */
+PJ_DECL(void*) pj_slab_alloc(pj_slab_t *slab);
+
+/**
+ * Allocate an object from the slab and zero it.
+ *
+ * @param slab		The slab allocator.
+ *
+ * @return		The object, or NULL if there is not enough memory.
+ */
+PJ_DECL(void*) pj_slab_zalloc(pj_slab_t *slab);
+
+/**
+ * Return an object to the slab. If the slab has been destroyed and this
+ * is its last object, the memory of the slab is released.
+ *
+ * @param slab		The slab allocator.
+ * @param obj		The object which was allocated from this slab.
+ */
+PJ_DECL(void) pj_slab_free(pj_slab_t *slab, void *obj);
+
+/**
+ * Get the statistic of the slab.
+ *
+ * @param slab		The slab allocator.
+ * @param stat		Pointer to receive the statistic.
+ */
+PJ_DECL(void) pj_slab_get_stat(pj_slab_t *slab, pj_slab_stat *stat);
+
+/**
+ * Destroy the slab. No objects may be allocated from the slab after this
+ * function is called. Objects which are still allocated remain valid, and
+ * the memory of the slab is released when the last of them is freed.
+ *
+ * @param slab		The slab allocator.
+ *
+ * @return		PJ_SUCCESS.
+ */
+PJ_DECL(pj_status_t) pj_slab_destroy(pj_slab_t *slab);
+
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif	/* __PJ_SLAB_H__ */
+
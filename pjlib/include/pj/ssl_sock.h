@@ -24,6 +24,7 @@
  * @brief Secure socket
  */
 
+#include <pj/activesock.h>
 #include <pj/ioqueue.h>
 #include <pj/sock.h>
 #include <pj/sock_qos.h>
@@ -997,6 +998,20 @@ typedef struct pj_ssl_sock_param
      */
     pj_bool_t sockopt_ignore_error;
 
+    /**
+     * Optional read buffer slab for the connections, see
+     * pj_activesock_cfg.read_slab. The secure socket then holds no read
+     * buffer while the connection is idle: received data is decrypted in
+     * place in the buffer borrowed from the slab, which is given back once
+     * the application has consumed all data, and #pj_ssl_sock_start_read()
+     * does not allocate buffers. The \a read_buffer_size, rounded up to
+     * a multiple of 8, must not exceed the data size of the slab buffers,
+     * and #pj_ssl_sock_start_read2() can not be used.
+     *
+     * Default: NULL
+     */
+    pj_activesock_slab *read_slab;
+
 } pj_ssl_sock_param;
 
 
@@ -1119,6 +1134,10 @@ PJ_DECL(pj_status_t) pj_ssl_sock_get_info(pj_ssl_sock_t *ssock,
  * operations. Further read operations will be done automatically by the
  * secure socket when \a on_data_read() callback returns non-zero. 
  *
+ * If the secure socket was created with pj_ssl_sock_param.read_slab set,
+ * no buffer is allocated here, and \a buff_size must not exceed the
+ * \a read_buffer_size setting.
+ *
  * @param ssock		The secure socket.
  * @param pool		Pool used to allocate buffers for incoming data.
  * @param buff_size	The size of each buffer, in bytes.
@@ -30,6 +30,7 @@
 #include <pj/addr_resolv.h>
 #include <pj/array.h>
 #include <pj/assert.h>
+#include <pj/atomic.h>
 #include <pj/ctype.h>
 #include <pj/errno.h>
 #include <pj/except.h>
@@ -44,11 +45,13 @@
 #include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/math.h>
+#include <pj/mpsc_queue.h>
 #include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/pool_buf.h>
 #include <pj/rand.h>
 #include <pj/rbtree.h>
+#include <pj/slab.h>
 #include <pj/sock.h>
 #include <pj/sock_qos.h>
 #include <pj/sock_select.h>
@@ -21,6 +21,7 @@
 #include <pj/compat/socket.h>
 #include <pj/assert.h>
 #include <pj/errno.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/pool.h>
 #include <pj/sock.h>
@@ -58,6 +59,7 @@ struct read_op
     pj_size_t		 size;
     pj_sockaddr		 src_addr;
     int			 src_addr_len;
+    pj_uint8_t		 peek;
 };
 
 struct accept_op
@@ -76,6 +78,25 @@ struct send_data
     unsigned		 flags;
 };
 
+/* Free buffer in the read slab. */
+struct slab_buf
+{
+    struct slab_buf	*next;
+};
+
+struct pj_activesock_slab
+{
+    pj_pool_t		*pool;
+    pj_lock_t		*lock;
+    unsigned		 buf_size;
+    unsigned		 data_offset;
+    struct slab_buf	*free_list;
+    unsigned		 ref_cnt;
+    unsigned		 total_cnt;
+    unsigned		 used_cnt;
+    unsigned		 peak_cnt;
+};
+
 struct pj_activesock_t
 {
     pj_ioqueue_key_t	*key;
@@ -103,6 +124,16 @@ struct pj_activesock_t
     pj_uint32_t		 read_flags;
     enum read_type	 read_type;
 
+    /* With read slab: read_busy is set while the read callback runs, and
+     * the borrowed buffer then belongs to the callback even if the socket
+     * is closed meanwhile. slab_released is set once the buffer and the
+     * reference to the slab have been given back. Both are protected by
+     * the slab lock.
+     */
+    pj_activesock_slab	*read_slab;
+    pj_bool_t		 read_busy;
+    pj_bool_t		 slab_released;
+
     struct accept_op	*accept_op;
 };
 
@@ -130,6 +161,216 @@ PJ_DEF(void) pj_activesock_cfg_default(pj_activesock_cfg *cfg)
     cfg->whole_data = PJ_TRUE;
 }
 
+
+PJ_DEF(pj_status_t) pj_activesock_slab_create(pj_pool_factory *pf,
+					      unsigned buf_size,
+					      pj_activesock_slab **p_slab)
+{
+    return pj_activesock_slab_create2(pf, buf_size, 0, p_slab);
+}
+
+
+PJ_DEF(pj_status_t) pj_activesock_slab_create2(pj_pool_factory *pf,
+					       unsigned buf_size,
+					       unsigned data_offset,
+					       pj_activesock_slab **p_slab)
+{
+    pj_pool_t *pool;
+    pj_activesock_slab *slab;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pf && buf_size && p_slab, PJ_EINVAL);
+    PJ_ASSERT_RETURN(data_offset < buf_size, PJ_EINVAL);
+
+    if (buf_size < sizeof(struct slab_buf))
+	buf_size = sizeof(struct slab_buf);
+
+    pool = pj_pool_create(pf, "asockslab%p", 512, 16 * buf_size, NULL);
+    PJ_ASSERT_RETURN(pool, PJ_ENOMEM);
+
+    slab = PJ_POOL_ZALLOC_T(pool, pj_activesock_slab);
+    slab->pool = pool;
+    slab->buf_size = buf_size;
+    slab->data_offset = data_offset;
+    slab->ref_cnt = 1;
+
+    status = pj_lock_create_simple_mutex(pool, pool->obj_name, &slab->lock);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+
+    *p_slab = slab;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_activesock_slab_get_info(pj_activesock_slab *slab,
+						pj_activesock_slab_info *info)
+{
+    PJ_ASSERT_RETURN(slab && info, PJ_EINVAL);
+
+    pj_lock_acquire(slab->lock);
+    info->buf_size = slab->buf_size;
+    info->data_offset = slab->data_offset;
+    info->total_cnt = slab->total_cnt;
+    info->used_cnt = slab->used_cnt;
+    info->peak_cnt = slab->peak_cnt;
+    pj_lock_release(slab->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Return a buffer to the slab, with the slab lock held. The data
+ * pointer is the one returned by slab_get().
+ */
+static void slab_put_buf(pj_activesock_slab *slab, void *data)
+{
+    struct slab_buf *buf;
+
+    buf = (struct slab_buf*)((pj_uint8_t*)data - slab->data_offset);
+    buf->next = slab->free_list;
+    slab->free_list = buf;
+    --slab->used_cnt;
+}
+
+
+/* Return a buffer (if any) and release a reference to the slab. The slab
+ * is destroyed when this was the last reference.
+ */
+static void slab_release(pj_activesock_slab *slab, void *data)
+{
+    pj_bool_t last;
+
+    pj_lock_acquire(slab->lock);
+    if (data)
+	slab_put_buf(slab, data);
+    last = (--slab->ref_cnt == 0);
+    pj_lock_release(slab->lock);
+
+    if (last) {
+	pj_assert(slab->used_cnt == 0);
+	pj_lock_destroy(slab->lock);
+	pj_pool_release(slab->pool);
+    }
+}
+
+
+PJ_DEF(pj_status_t) pj_activesock_slab_destroy(pj_activesock_slab *slab)
+{
+    PJ_ASSERT_RETURN(slab, PJ_EINVAL);
+
+    slab_release(slab, NULL);
+    return PJ_SUCCESS;
+}
+
+
+/* Borrow a buffer from the slab, returns pointer to its data area. */
+static pj_uint8_t *slab_get(pj_activesock_slab *slab)
+{
+    struct slab_buf *buf;
+
+    pj_lock_acquire(slab->lock);
+    buf = slab->free_list;
+    if (buf) {
+	slab->free_list = buf->next;
+    } else {
+	buf = (struct slab_buf*) pj_pool_alloc(slab->pool, slab->buf_size);
+	++slab->total_cnt;
+    }
+    if (++slab->used_cnt > slab->peak_cnt)
+	slab->peak_cnt = slab->used_cnt;
+    pj_lock_release(slab->lock);
+
+    return (pj_uint8_t*)buf + slab->data_offset;
+}
+
+
+/* Return a buffer to the slab. */
+static void slab_put(pj_activesock_slab *slab, void *data)
+{
+    pj_lock_acquire(slab->lock);
+    slab_put_buf(slab, data);
+    pj_lock_release(slab->lock);
+}
+
+
+/* Called when the read callback starts. Returns PJ_FALSE if the socket has
+ * been closed, otherwise the borrowed buffer belongs to the callback until
+ * slab_read_end() is called.
+ */
+static pj_bool_t slab_read_begin(pj_activesock_t *asock)
+{
+    pj_activesock_slab *slab = asock->read_slab;
+    pj_bool_t ok;
+
+    pj_lock_acquire(slab->lock);
+    ok = !(asock->shutdown & SHUT_RX);
+    if (ok)
+	asock->read_busy = PJ_TRUE;
+    pj_lock_release(slab->lock);
+
+    return ok;
+}
+
+
+/* Called when the read callback returns (unless the socket has been
+ * destroyed in the callback). If the socket has been closed meanwhile,
+ * pj_activesock_close() has left the buffer and the slab reference to us.
+ * If drop_buf is set, the read won't complete so the buffer is returned.
+ */
+static void slab_read_end(pj_activesock_t *asock, struct read_op *r,
+			  pj_bool_t drop_buf)
+{
+    pj_activesock_slab *slab = asock->read_slab;
+    void *pkt = NULL;
+    pj_bool_t release = PJ_FALSE;
+
+    pj_lock_acquire(slab->lock);
+    asock->read_busy = PJ_FALSE;
+    if ((asock->shutdown & SHUT_RX) && !asock->slab_released) {
+	asock->slab_released = PJ_TRUE;
+	release = PJ_TRUE;
+	pkt = r->pkt;
+	r->pkt = NULL;
+    } else if (drop_buf && r->pkt) {
+	slab_put_buf(slab, r->pkt);
+	r->pkt = NULL;
+	r->size = 0;
+    }
+    pj_lock_release(slab->lock);
+
+    if (release)
+	slab_release(slab, pkt);
+}
+
+
+/* Called by pj_activesock_close() once the key has been unregistered, so
+ * that no recv() into the borrowed buffer can be in progress anymore.
+ * If the read callback is running, it will give the buffer back instead.
+ */
+static void slab_on_close(pj_activesock_t *asock)
+{
+    pj_activesock_slab *slab = asock->read_slab;
+    void *pkt = NULL;
+    pj_bool_t release = PJ_FALSE;
+
+    pj_lock_acquire(slab->lock);
+    if (!asock->read_busy && !asock->slab_released) {
+	asock->slab_released = PJ_TRUE;
+	release = PJ_TRUE;
+	if (asock->read_op) {
+	    pkt = asock->read_op->pkt;
+	    asock->read_op->pkt = NULL;
+	}
+    }
+    pj_lock_release(slab->lock);
+
+    if (release)
+	slab_release(slab, pkt);
+}
+
 #if defined(PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT) && \
     PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT!=0
 static void activesock_destroy_iphone_os_stream(pj_activesock_t *asock)
@@ -226,6 +467,15 @@ PJ_DEF(pj_status_t) pj_activesock_create( pj_pool_t *pool,
 	pj_activesock_close(asock);
 	return status;
     }
+
+    if (opt && opt->read_slab && asock->stream_oriented) {
+	asock->read_slab = opt->read_slab;
+	asock->async_count = 1;
+
+	pj_lock_acquire(asock->read_slab->lock);
+	++asock->read_slab->ref_cnt;
+	pj_lock_release(asock->read_slab->lock);
+    }
     
     if (asock->whole_data) {
 	/* Must disable concurrency otherwise there is a race condition */
@@ -314,6 +564,12 @@ PJ_DEF(pj_status_t) pj_activesock_close(pj_activesock_t *asock)
     if (unregister) {
 	pj_ioqueue_unregister(key);
 
+	/* Return the borrowed read buffer only now that the key has been
+	 * unregistered.
+	 */
+	if (asock->read_slab)
+	    slab_on_close(asock);
+
 #if defined(PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT) && \
     PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT!=0
 	activesock_destroy_iphone_os_stream(asock);
@@ -339,6 +595,29 @@ PJ_DEF(void*) pj_activesock_get_user_data(pj_activesock_t *asock)
 }
 
 
+/* With read slab: give the (empty) read buffer back to the slab, and queue
+ * a one byte MSG_PEEK read which only completes when the socket becomes
+ * readable, without consuming anything from the socket.
+ */
+static pj_status_t wait_readable(pj_activesock_t *asock,
+				 pj_ioqueue_key_t *key,
+				 struct read_op *r,
+				 unsigned flags,
+				 pj_ssize_t *size)
+{
+    pj_assert(r->size == 0);
+
+    if (r->pkt) {
+	slab_put(asock->read_slab, r->pkt);
+	r->pkt = NULL;
+    }
+
+    *size = 1;
+    return pj_ioqueue_recv(key, &r->op_key, &r->peek, size,
+			   flags | asock->read_flags | pj_MSG_PEEK());
+}
+
+
 PJ_DEF(pj_status_t) pj_activesock_start_read(pj_activesock_t *asock,
 					     pj_pool_t *pool,
 					     unsigned buff_size,
@@ -349,6 +628,29 @@ PJ_DEF(pj_status_t) pj_activesock_start_read(pj_activesock_t *asock,
 
     PJ_ASSERT_RETURN(asock && pool && buff_size, PJ_EINVAL);
 
+    if (asock->read_slab) {
+	struct read_op *r;
+	pj_ssize_t size_to_read = 1;
+	pj_status_t status;
+
+	PJ_ASSERT_RETURN(buff_size <= asock->read_slab->buf_size -
+				      asock->read_slab->data_offset,
+			 PJ_ETOOBIG);
+	PJ_ASSERT_RETURN(asock->read_type == TYPE_NONE, PJ_EINVALIDOP);
+
+	r = asock->read_op = PJ_POOL_ZALLOC_T(pool, struct read_op);
+	asock->read_type = TYPE_RECV;
+	asock->read_flags = flags;
+	r->max_size = buff_size;
+
+	/* No buffer until there is something to read */
+	status = wait_readable(asock, asock->key, r, PJ_IOQUEUE_ALWAYS_ASYNC,
+			       &size_to_read);
+	PJ_ASSERT_RETURN(status != PJ_SUCCESS, PJ_EBUG);
+
+	return (status == PJ_EPENDING) ? PJ_SUCCESS : status;
+    }
+
     readbuf = (void**) pj_pool_calloc(pool, asock->async_count, 
 				      sizeof(void*));
 
@@ -373,6 +675,9 @@ PJ_DEF(pj_status_t) pj_activesock_start_read2( pj_activesock_t *asock,
     PJ_ASSERT_RETURN(asock->read_type == TYPE_NONE, PJ_EINVALIDOP);
     PJ_ASSERT_RETURN(asock->read_op == NULL, PJ_EINVALIDOP);
 
+    /* Application supplied buffers can't be lent to the read slab */
+    PJ_ASSERT_RETURN(asock->read_slab == NULL, PJ_EINVALIDOP);
+
     asock->read_op = (struct read_op*)
 		     pj_pool_calloc(pool, asock->async_count, 
 				    sizeof(struct read_op));
@@ -466,6 +771,9 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 {
     pj_activesock_t *asock;
     struct read_op *r = (struct read_op*)op_key;
+    pj_activesock_slab *slab;
+    pj_uint8_t *pkt = NULL;
+    pj_bool_t cancelled = PJ_FALSE;
     unsigned loop = 0;
     pj_status_t status;
 
@@ -475,9 +783,36 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
     if (asock->shutdown & SHUT_RX)
 	return;
 
+    slab = asock->read_slab;
+    if (slab && !slab_read_begin(asock))
+	return;
+
     do {
 	unsigned flags;
 
+	if (r->pkt == NULL && bytes_read > 0) {
+	    /* Read slab is used and the socket has become readable (the
+	     * peeked data is still in the socket). Borrow a buffer and read.
+	     */
+	    r->pkt = slab_get(slab);
+	    bytes_read = r->max_size;
+	    status = pj_ioqueue_recv(key, op_key, r->pkt, &bytes_read,
+				     asock->read_flags);
+	    if (status == PJ_EPENDING) {
+		break;
+	    } else if (status == PJ_ECANCELLED) {
+		cancelled = PJ_TRUE;
+		break;
+	    } else if (status != PJ_SUCCESS) {
+		bytes_read = -status;
+	    }
+	}
+
+	/* The buffer given to the callback, to be returned to the slab if
+	 * the socket is destroyed in the callback.
+	 */
+	pkt = r->pkt;
+
 	if (bytes_read > 0) {
 	    /*
 	     * We've got new data.
@@ -514,7 +849,11 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 
 	    /* If callback returns false, we have been destroyed! */
 	    if (!ret)
-		return;
+		goto on_destroyed;
+
+	    /* Stop if we've been closed in the callback */
+	    if (slab && (asock->shutdown & SHUT_RX))
+		goto on_return;
 
 	    /* Only stream oriented socket may leave data in the packet */
 	    if (asock->stream_oriented) {
@@ -570,8 +909,9 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 		 */
 		//ret = (*asock->cb.on_data_read)(asock, (r->size? r->pkt:NULL),
 		//				r->size, status, &remainder);
-		ret = (*asock->cb.on_data_read)(asock, r->pkt, r->size,
-						status, &remainder);
+		ret = (*asock->cb.on_data_read)(asock,
+						(r->pkt? r->pkt : &r->peek),
+						r->size, status, &remainder);
 
 	    } else if (asock->read_type == TYPE_RECV_FROM && 
 		       asock->cb.on_data_recvfrom) 
@@ -594,11 +934,11 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 
 	    /* If callback returns false, we have been destroyed! */
 	    if (!ret)
-		return;
+		goto on_destroyed;
 
 	    /* Also stop further read if we've been shutdown */
 	    if (asock->shutdown & SHUT_RX)
-		return;
+		goto on_return;
 
 	    /* Only stream oriented socket may leave data in the packet */
 	    if (asock->stream_oriented) {
@@ -618,7 +958,12 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 	if (++loop >= asock->max_loop)
 	    flags |= PJ_IOQUEUE_ALWAYS_ASYNC;
 
-	if (asock->read_type == TYPE_RECV) {
+	if (asock->read_slab && r->size == 0) {
+	    /* Everything has been consumed, release the buffer until the
+	     * socket is readable again.
+	     */
+	    status = wait_readable(asock, key, r, flags, &bytes_read);
+	} else if (asock->read_type == TYPE_RECV) {
 	    status = pj_ioqueue_recv(key, op_key, r->pkt + r->size, 
 				     &bytes_read, flags);
 	} else {
@@ -635,10 +980,22 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 	    /* Error */
 	    bytes_read = -status;
 	} else {
+	    cancelled = (status == PJ_ECANCELLED);
 	    break;
 	}
     } while (1);
 
+on_return:
+    if (slab)
+	slab_read_end(asock, r, cancelled);
+    return;
+
+on_destroyed:
+    /* The socket has been closed in the callback and can't be accessed
+     * anymore, and pj_activesock_close() has left the buffer to us.
+     */
+    if (slab)
+	slab_release(slab, pkt);
 }
 
 
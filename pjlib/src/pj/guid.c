@@ -17,9 +17,13 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
  */
+#include <pj/assert.h>
 #include <pj/ctype.h>
 #include <pj/guid.h>
+#include <pj/os.h>
 #include <pj/pool.h>
+#include <pj/rand.h>
+#include <pj/string.h>
 
 PJ_DEF(pj_str_t*) pj_generate_unique_string_lower(pj_str_t *str)
 {
@@ -46,3 +50,110 @@ PJ_DEF(void) pj_create_unique_string_lower(pj_pool_t *pool, pj_str_t *str)
     for (i = 0; i < str->slen; i++)
 	str->ptr[i] = (char)pj_tolower(str->ptr[i]);
 }
+
+
+#if defined(PJ_THREAD_LOCAL_SPECIFIER) && defined(PJ_HAS_INT64) && \
+    PJ_HAS_INT64!=0
+
+/*
+ * Fast unique string: a per-thread prefix made from a real GUID, followed
+ * by a per-thread counter and random digits, all in lowercase hex.
+ */
+enum
+{
+    PREFIX_LEN	= 16,
+    COUNTER_LEN	= 8
+};
+
+/* The prefix, the counter and 32 random bits must fit in the shortest
+ * GUID string.
+ */
+typedef char fast_guid_len_check[(PREFIX_LEN + COUNTER_LEN + 8 <=
+				  PJ_GUID_MIN_LENGTH) ? 1 : -1];
+
+typedef struct fast_guid_state
+{
+    char	prefix[PREFIX_LEN];
+    pj_uint32_t	counter;
+    pj_bool_t	initialized;
+} fast_guid_state;
+
+static PJ_THREAD_LOCAL_SPECIFIER fast_guid_state tls_guid;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static void put_hex(char *p, pj_uint64_t val, unsigned len)
+{
+    while (len--) {
+	p[len] = hex_digits[val & 15];
+	val >>= 4;
+    }
+}
+
+/* Derive a new thread prefix from a GUID */
+static void init_prefix(fast_guid_state *st)
+{
+    char buf[PJ_GUID_MAX_LENGTH];
+    pj_str_t guid;
+    pj_uint64_t h = PJ_UINT64(0xCBF29CE484222325);
+    int i;
+
+    guid.ptr = buf;
+    pj_generate_unique_string(&guid);
+
+    /* FNV-1a over the GUID, mixed with the state address which is unique
+     * among the running threads.
+     */
+    for (i=0; i<guid.slen; ++i) {
+	h ^= (pj_uint8_t)guid.ptr[i];
+	h *= PJ_UINT64(0x100000001B3);
+    }
+    h ^= (pj_uint64_t)(pj_size_t)st;
+    h ^= h >> 33;
+    h *= PJ_UINT64(0xFF51AFD7ED558CCD);
+    h ^= h >> 33;
+
+    put_hex(st->prefix, h, PREFIX_LEN);
+    st->counter = 0;
+    st->initialized = PJ_TRUE;
+}
+
+PJ_DEF(pj_str_t*) pj_generate_unique_string_fast(pj_str_t *str)
+{
+    fast_guid_state *st = &tls_guid;
+    unsigned len = PJ_GUID_STRING_LENGTH;
+    pj_uint64_t rnd;
+    char *p = str->ptr;
+
+    PJ_CHECK_STACK();
+    pj_assert(len >= PJ_GUID_MIN_LENGTH);
+
+    /* A new prefix once the counter wraps, so strings never repeat */
+    if (!st->initialized || st->counter == 0xFFFFFFFF)
+	init_prefix(st);
+
+    pj_memcpy(p, st->prefix, PREFIX_LEN);
+    put_hex(p + PREFIX_LEN, ++st->counter, COUNTER_LEN);
+
+    /* The rest (8 to 12 digits) is random */
+    rnd = ((pj_uint64_t)pj_rand() << 31) | (pj_uint64_t)pj_rand();
+    put_hex(p + PREFIX_LEN + COUNTER_LEN, rnd, len - PREFIX_LEN - COUNTER_LEN);
+
+    str->slen = len;
+    return str;
+}
+
+#else
+
+PJ_DEF(pj_str_t*) pj_generate_unique_string_fast(pj_str_t *str)
+{
+    return pj_generate_unique_string_lower(str);
+}
+
+#endif	/* PJ_THREAD_LOCAL_SPECIFIER */
+
+PJ_DEF(void) pj_create_unique_string_fast(pj_pool_t *pool, pj_str_t *str)
+{
+    str->ptr = (char*)pj_pool_alloc(pool, PJ_GUID_STRING_LENGTH);
+    pj_generate_unique_string_fast(str);
+}
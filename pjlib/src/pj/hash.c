@@ -22,13 +22,14 @@
 #include <pj/string.h>
 #include <pj/pool.h>
 #include <pj/os.h>
-#include <pj/ctype.h>
 #include <pj/assert.h>
 
-/**
- * The hash multiplier used to calculate hash value.
- */
-#define PJ_HASH_MULTIPLIER	33
+/* Multipliers to mix the key words into the hash value */
+#define HASH_M1			PJ_UINT64(0x9E3779B97F4A7C15)
+#define HASH_M2			PJ_UINT64(0xC2B2AE3D27D4EB4F)
+
+/* Number of buckets to migrate on each insertion while resizing */
+#define REHASH_STEP		4
 
 
 struct pj_hash_entry
@@ -46,45 +47,92 @@ struct pj_hash_table_t
     pj_hash_entry     **table;
     unsigned		count, rows;
     pj_hash_iterator_t	iterator;
-};
 
+    /* Resizable table. While resizing, the entries of old table are
+     * migrated to the new table a few buckets at a time, and the buckets
+     * of the old table below migrate_idx are empty.
+     */
+    pj_pool_t	       *pool;	    /* Pool for larger table, or NULL */
+    pj_hash_entry     **old_table;  /* Table being migrated, or NULL */
+    unsigned		old_rows;
+    unsigned		migrate_idx;
+};
 
 
-PJ_DEF(pj_uint32_t) pj_hash_calc(pj_uint32_t hash, const void *key, 
-				 unsigned keylen)
+/* Convert upper case ASCII letters in all bytes of the word to lower case,
+ * which gives the same result as pj_tolower() on each byte.
+ */
+static pj_uint64_t lower_word(pj_uint64_t w)
 {
-    PJ_CHECK_STACK();
+    const pj_uint64_t ones = PJ_UINT64(0x0101010101010101);
+    pj_uint64_t heptets = w & (ones * 0x7F);
+    pj_uint64_t gt_z = heptets + ones * (0x7F - 'Z');
+    pj_uint64_t ge_a = heptets + ones * (0x80 - 'A');
+    pj_uint64_t upper = (ge_a ^ gt_z) & ~w & (ones * 0x80);
 
-    if (keylen==PJ_HASH_KEY_STRING) {
-	const pj_uint8_t *p = (const pj_uint8_t*)key;
-	for ( ; *p; ++p ) {
-	    hash = (hash * PJ_HASH_MULTIPLIER) + *p;
+    return w | (upper >> 2);
+}
+
+/* Mix the next word of the key into the hash value */
+#define HASH_MIX(h, w)	(h = ((h) ^ (w)) * HASH_M1, h ^= h >> 32)
+
+/* Hash the key a word at a time. If lower is set, the key is converted to
+ * lower case, and the converted key is written to result if it's not NULL.
+ */
+static pj_uint32_t hash_key(pj_uint32_t hval, const void *key,
+			    unsigned keylen, pj_bool_t lower, char *result)
+{
+    const pj_uint8_t *p = (const pj_uint8_t*)key;
+    pj_uint64_t h = hval, w;
+    unsigned i, tail = keylen & 7;
+
+    if (!lower) {
+	for (i=0; i<keylen-tail; i+=8) {
+	    pj_memcpy(&w, p + i, 8);
+	    HASH_MIX(h, w);
 	}
     } else {
-	const pj_uint8_t *p = (const pj_uint8_t*)key,
-			      *end = p + keylen;
-	for ( ; p!=end; ++p) {
-	    hash = (hash * PJ_HASH_MULTIPLIER) + *p;
+	for (i=0; i<keylen-tail; i+=8) {
+	    pj_memcpy(&w, p + i, 8);
+	    w = lower_word(w);
+	    if (result)
+		pj_memcpy(result + i, &w, 8);
+	    HASH_MIX(h, w);
+	}
+    }
+
+    if (tail) {
+	w = 0;
+	pj_memcpy(&w, p + i, tail);
+	if (lower) {
+	    w = lower_word(w);
+	    if (result)
+		pj_memcpy(result + i, &w, tail);
 	}
+	HASH_MIX(h, w);
     }
-    return hash;
+
+    h = (h ^ keylen) * HASH_M2;
+    h ^= h >> 29;
+    return (pj_uint32_t)(h ^ (h >> 32));
 }
 
-PJ_DEF(pj_uint32_t) pj_hash_calc_tolower( pj_uint32_t hval,
-                                          char *result,
-                                          const pj_str_t *key)
+PJ_DEF(pj_uint32_t) pj_hash_calc(pj_uint32_t hash, const void *key, 
+				 unsigned keylen)
 {
-    long i;
+    PJ_CHECK_STACK();
 
-    for (i=0; i<key->slen; ++i) {
-        int lower = pj_tolower(key->ptr[i]);
-	if (result)
-	    result[i] = (char)lower;
+    if (keylen==PJ_HASH_KEY_STRING)
+	keylen = (unsigned)pj_ansi_strlen((const char*)key);
 
-	hval = hval * PJ_HASH_MULTIPLIER + lower;
-    }
+    return hash_key(hash, key, keylen, PJ_FALSE, NULL);
+}
 
-    return hval;
+PJ_DEF(pj_uint32_t) pj_hash_calc_tolower( pj_uint32_t hval,
+                                          char *result,
+                                          const pj_str_t *key)
+{
+    return hash_key(hval, key->ptr, (unsigned)key->slen, PJ_TRUE, result);
 }
 
 
@@ -96,8 +144,7 @@ PJ_DEF(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size)
     /* Check that PJ_HASH_ENTRY_BUF_SIZE is correct. */
     PJ_ASSERT_RETURN(sizeof(pj_hash_entry)<=PJ_HASH_ENTRY_BUF_SIZE, NULL);
 
-    h = PJ_POOL_ALLOC_T(pool, pj_hash_table_t);
-    h->count = 0;
+    h = PJ_POOL_ZALLOC_T(pool, pj_hash_table_t);
 
     PJ_LOG( 6, ("hashtbl", "hash table %p created from pool %s", h, pj_pool_getobjname(pool)));
 
@@ -117,6 +164,68 @@ PJ_DEF(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size)
     return h;
 }
 
+PJ_DEF(pj_hash_table_t*) pj_hash_create_resizable(pj_pool_t *pool,
+						  unsigned size)
+{
+    pj_hash_table_t *h;
+
+    h = pj_hash_create(pool, size);
+    if (h)
+	h->pool = pool;
+
+    return h;
+}
+
+/* Get the bucket of the hash value */
+static pj_hash_entry **get_bucket(pj_hash_table_t *ht, pj_uint32_t hash)
+{
+    if (ht->old_table && (hash & ht->old_rows) >= ht->migrate_idx)
+	return &ht->old_table[hash & ht->old_rows];
+
+    return &ht->table[hash & ht->rows];
+}
+
+/* Called after new entry is added to resizable table. Start resizing when
+ * the load factor is exceeded, and migrate some buckets of the old table.
+ */
+static void rehash_step(pj_hash_table_t *ht)
+{
+    unsigned i;
+
+    if (!ht->old_table) {
+	if (ht->count <= (ht->rows + 1) * PJ_HASH_MAX_LOAD)
+	    return;
+
+	ht->old_table = ht->table;
+	ht->old_rows = ht->rows;
+	ht->migrate_idx = 0;
+	ht->rows = ht->rows * 2 + 1;
+	ht->table = (pj_hash_entry**)
+		    pj_pool_calloc(ht->pool, ht->rows+1,
+				   sizeof(pj_hash_entry*));
+
+	PJ_LOG(5, ("hashtbl", "%p: resizing to %u rows, count=%u", ht,
+		   ht->rows + 1, ht->count));
+    }
+
+    for (i=0; i<REHASH_STEP && ht->migrate_idx <= ht->old_rows; ++i) {
+	pj_hash_entry *entry = ht->old_table[ht->migrate_idx];
+
+	ht->old_table[ht->migrate_idx++] = NULL;
+	while (entry) {
+	    pj_hash_entry *next = entry->next;
+	    pj_hash_entry **bucket = &ht->table[entry->hash & ht->rows];
+
+	    entry->next = *bucket;
+	    *bucket = entry;
+	    entry = next;
+	}
+    }
+
+    if (ht->migrate_idx > ht->old_rows)
+	ht->old_table = NULL;
+}
+
 static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht, 
 				   const void *key, unsigned keylen,
 				   void *val, pj_uint32_t *hval,
@@ -125,35 +234,14 @@ static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht,
     pj_uint32_t hash;
     pj_hash_entry **p_entry, *entry;
 
+    if (keylen==PJ_HASH_KEY_STRING) {
+	keylen = (unsigned)pj_ansi_strlen((const char*)key);
+    }
+
     if (hval && *hval != 0) {
 	hash = *hval;
-	if (keylen==PJ_HASH_KEY_STRING) {
-	    keylen = (unsigned)pj_ansi_strlen((const char*)key);
-	}
     } else {
-	/* This slightly differs with pj_hash_calc() because we need 
-	 * to get the keylen when keylen is PJ_HASH_KEY_STRING.
-	 */
-	hash=0;
-	if (keylen==PJ_HASH_KEY_STRING) {
-	    const pj_uint8_t *p = (const pj_uint8_t*)key;
-	    for ( ; *p; ++p ) {
-                if (lower)
-                    hash = hash * PJ_HASH_MULTIPLIER + pj_tolower(*p);
-                else 
-		    hash = hash * PJ_HASH_MULTIPLIER + *p;
-	    }
-	    keylen = (unsigned)(p - (const unsigned char*)key);
-	} else {
-	    const pj_uint8_t *p = (const pj_uint8_t*)key,
-				  *end = p + keylen;
-	    for ( ; p!=end; ++p) {
-		if (lower)
-                    hash = hash * PJ_HASH_MULTIPLIER + pj_tolower(*p);
-                else
-                    hash = hash * PJ_HASH_MULTIPLIER + *p;
-	    }
-	}
+	hash = hash_key(0, key, keylen, lower, NULL);
 
 	/* Report back the computed hash. */
 	if (hval)
@@ -161,7 +249,7 @@ static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht,
     }
 
     /* scan the linked list */
-    for (p_entry = &ht->table[hash & ht->rows], entry=*p_entry; 
+    for (p_entry = get_bucket(ht, hash), entry=*p_entry; 
 	 entry; 
 	 p_entry = &entry->next, entry = *p_entry)
     {
@@ -232,6 +320,7 @@ static void hash_set( pj_pool_t *pool, pj_hash_table_t *ht,
 		      void *value, void *entry_buf, pj_bool_t lower )
 {
     pj_hash_entry **p_entry;
+    unsigned count = ht->count;
 
     p_entry = find_entry( pool, ht, key, keylen, value, &hval, entry_buf,
                           lower);
@@ -249,6 +338,9 @@ static void hash_set( pj_pool_t *pool, pj_hash_table_t *ht,
 		       *p_entry, value));
 	}
     }
+
+    if (ht->pool && ht->count > count)
+	rehash_step(ht);
 }
 
 PJ_DEF(void) pj_hash_set( pj_pool_t *pool, pj_hash_table_t *ht,
@@ -287,14 +379,26 @@ PJ_DEF(unsigned) pj_hash_count( pj_hash_table_t *ht )
     return ht->count;
 }
 
+/* Number of buckets, including the buckets of the table being migrated */
+static unsigned bucket_count(pj_hash_table_t *ht)
+{
+    return ht->rows + 1 + (ht->old_table ? ht->old_rows + 1 : 0);
+}
+
+static pj_hash_entry *bucket_head(pj_hash_table_t *ht, unsigned index)
+{
+    return (index <= ht->rows) ? ht->table[index] :
+				 ht->old_table[index - ht->rows - 1];
+}
+
 PJ_DEF(pj_hash_iterator_t*) pj_hash_first( pj_hash_table_t *ht,
 					   pj_hash_iterator_t *it )
 {
     it->index = 0;
     it->entry = NULL;
 
-    for (; it->index <= ht->rows; ++it->index) {
-	it->entry = ht->table[it->index];
+    for (; it->index < bucket_count(ht); ++it->index) {
+	it->entry = bucket_head(ht, it->index);
 	if (it->entry) {
 	    break;
 	}
@@ -311,8 +415,8 @@ PJ_DEF(pj_hash_iterator_t*) pj_hash_next( pj_hash_table_t *ht,
 	return it;
     }
 
-    for (++it->index; it->index <= ht->rows; ++it->index) {
-	it->entry = ht->table[it->index];
+    for (++it->index; it->index < bucket_count(ht); ++it->index) {
+	it->entry = bucket_head(ht, it->index);
 	if (it->entry) {
 	    break;
 	}
@@ -30,15 +30,32 @@
 
 #define PENDING_RETRY	2
 
+/* Callback posted with pj_ioqueue_post() */
+typedef struct post_item
+{
+    pj_mpsc_node	 node;
+    pj_ioqueue_post_cb	*cb;
+    void		*arg;
+} post_item;
+
+static void ioqueue_destroy_post( pj_ioqueue_t *ioqueue );
+
 static void ioqueue_init( pj_ioqueue_t *ioqueue )
 {
     ioqueue->lock = NULL;
     ioqueue->auto_delete_lock = 0;
     ioqueue->default_concurrency = PJ_IOQUEUE_DEFAULT_ALLOW_CONCURRENCY;
+    ioqueue->post_queue = NULL;
+    ioqueue->post_slab = NULL;
+    ioqueue->post_lock = NULL;
+    ioqueue->post_signaled = NULL;
+    ioqueue->post_fd = PJ_INVALID_SOCKET;
 }
 
 static pj_status_t ioqueue_destroy(pj_ioqueue_t *ioqueue)
 {
+    ioqueue_destroy_post(ioqueue);
+
     if (ioqueue->auto_delete_lock && ioqueue->lock ) {
 	pj_lock_release(ioqueue->lock);
         return pj_lock_destroy(ioqueue->lock);
@@ -129,6 +146,221 @@ static pj_status_t ioqueue_init_key( pj_pool_t *pool,
     return PJ_SUCCESS;
 }
 
+/*
+ * Create the queue of posted callbacks and the socket to wake up the poll.
+ * The socket is to be added to the polled set by the ioqueue backend.
+ */
+static pj_status_t ioqueue_init_post( pj_pool_t *pool, pj_ioqueue_t *ioqueue )
+{
+    pj_status_t rc;
+
+    rc = pj_mpsc_queue_create(pool, &ioqueue->post_queue);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_slab_create(pool->factory, "ioqpost%p", sizeof(post_item), 0,
+			&ioqueue->post_slab);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_lock_create_recursive_mutex(pool, "ioqpost%p",
+					&ioqueue->post_lock);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_atomic_create(pool, 0, &ioqueue->post_signaled);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+#if IOQUEUE_HAS_EVENTFD
+    ioqueue->post_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ioqueue->post_fd < 0) {
+	ioqueue->post_fd = PJ_INVALID_SOCKET;
+	rc = PJ_RETURN_OS_ERROR(pj_get_native_os_error());
+	goto on_error;
+    }
+#else
+    {
+	pj_sockaddr_in addr;
+	int addr_len = sizeof(addr);
+#   if defined(PJ_WIN32) && PJ_WIN32!=0 || \
+       defined(PJ_WIN64) && PJ_WIN64 != 0 || \
+       defined(PJ_WIN32_WINCE) && PJ_WIN32_WINCE!=0
+	u_long value = 1;
+#   else
+	pj_uint32_t value = 1;
+#   endif
+
+	rc = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0,
+			    &ioqueue->post_fd);
+	if (rc != PJ_SUCCESS)
+	    goto on_error;
+
+	/* Bind to loopback and connect to itself */
+	pj_sockaddr_in_init(&addr, NULL, 0);
+	addr.sin_addr.s_addr = pj_htonl(0x7f000001);
+	rc = pj_sock_bind(ioqueue->post_fd, &addr, sizeof(addr));
+	if (rc == PJ_SUCCESS)
+	    rc = pj_sock_getsockname(ioqueue->post_fd, &addr, &addr_len);
+	if (rc == PJ_SUCCESS)
+	    rc = pj_sock_connect(ioqueue->post_fd, &addr, addr_len);
+	if (rc != PJ_SUCCESS)
+	    goto on_error;
+
+#   if defined(PJ_WIN32) && PJ_WIN32!=0 || \
+       defined(PJ_WIN64) && PJ_WIN64 != 0 || \
+       defined(PJ_WIN32_WINCE) && PJ_WIN32_WINCE!=0
+	if (ioctlsocket(ioqueue->post_fd, FIONBIO, &value)) {
+#   else
+	if (ioctl(ioqueue->post_fd, FIONBIO, &value)) {
+#   endif
+	    rc = pj_get_netos_error();
+	    goto on_error;
+	}
+    }
+#endif
+
+    return PJ_SUCCESS;
+
+on_error:
+    ioqueue_destroy_post(ioqueue);
+    return rc;
+}
+
+static void ioqueue_destroy_post( pj_ioqueue_t *ioqueue )
+{
+    if (ioqueue->post_queue) {
+	pj_mpsc_node *node;
+
+	/* Pending callbacks are discarded */
+	while ((node = pj_mpsc_queue_pop(ioqueue->post_queue)) != NULL)
+	    pj_slab_free(ioqueue->post_slab, node);
+
+	pj_mpsc_queue_destroy(ioqueue->post_queue);
+	ioqueue->post_queue = NULL;
+    }
+    if (ioqueue->post_slab) {
+	pj_slab_destroy(ioqueue->post_slab);
+	ioqueue->post_slab = NULL;
+    }
+    if (ioqueue->post_lock) {
+	pj_lock_destroy(ioqueue->post_lock);
+	ioqueue->post_lock = NULL;
+    }
+    if (ioqueue->post_signaled) {
+	pj_atomic_destroy(ioqueue->post_signaled);
+	ioqueue->post_signaled = NULL;
+    }
+    if (ioqueue->post_fd != PJ_INVALID_SOCKET) {
+#if IOQUEUE_HAS_EVENTFD
+	close((int)ioqueue->post_fd);
+#else
+	pj_sock_close(ioqueue->post_fd);
+#endif
+	ioqueue->post_fd = PJ_INVALID_SOCKET;
+    }
+}
+
+/* Make the post socket readable */
+static void post_signal( pj_ioqueue_t *ioqueue )
+{
+#if IOQUEUE_HAS_EVENTFD
+    pj_uint64_t value = 1;
+
+    if (write((int)ioqueue->post_fd, &value, sizeof(value)) < 0) {
+	/* The counter can only overflow, and then it is still readable */
+    }
+#else
+    pj_ssize_t len = 1;
+
+    pj_sock_send(ioqueue->post_fd, "", &len, 0);
+#endif
+}
+
+/*
+ * Call the posted callbacks. This is called by the backend when the post
+ * socket is readable.
+ */
+static int ioqueue_dispatch_post( pj_ioqueue_t *ioqueue )
+{
+#if IOQUEUE_HAS_EVENTFD
+    pj_uint64_t value;
+#else
+    char buf[4];
+    pj_ssize_t len = sizeof(buf);
+#endif
+    int count = 0;
+
+    /* Consume the wakeup. This may fail when another polling thread has
+     * consumed it, in which case the queue is drained by both.
+     */
+#if IOQUEUE_HAS_EVENTFD
+    if (read((int)ioqueue->post_fd, &value, sizeof(value)) < 0) {
+	/* Already consumed */
+    }
+#else
+    pj_sock_recv(ioqueue->post_fd, buf, &len, 0);
+#endif
+
+    /* Callbacks posted after this point signal the socket again */
+    pj_atomic_set(ioqueue->post_signaled, 0);
+
+    /* Only one thread may pop from the queue */
+    pj_lock_acquire(ioqueue->post_lock);
+
+    while (count < PJ_IOQUEUE_MAX_POST_IN_SINGLE_POLL) {
+	post_item *item;
+
+	item = (post_item*) pj_mpsc_queue_pop(ioqueue->post_queue);
+	if (!item)
+	    break;
+
+	(*item->cb)(item->arg);
+	pj_slab_free(ioqueue->post_slab, item);
+	++count;
+    }
+
+    pj_lock_release(ioqueue->post_lock);
+
+    /* Leave the rest for the next poll */
+    if (count == PJ_IOQUEUE_MAX_POST_IN_SINGLE_POLL &&
+	pj_atomic_inc_and_get(ioqueue->post_signaled) == 1)
+    {
+	post_signal(ioqueue);
+    }
+
+    return count;
+}
+
+/*
+ * pj_ioqueue_post()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_post( pj_ioqueue_t *ioqueue,
+				     pj_ioqueue_post_cb *cb,
+				     void *arg )
+{
+    post_item *item;
+
+    PJ_ASSERT_RETURN(ioqueue && cb, PJ_EINVAL);
+    PJ_ASSERT_RETURN(ioqueue->post_queue, PJ_EINVALIDOP);
+
+    item = (post_item*) pj_slab_alloc(ioqueue->post_slab);
+    if (!item)
+	return PJ_ENOMEM;
+
+    item->cb = cb;
+    item->arg = arg;
+    pj_mpsc_queue_push(ioqueue->post_queue, &item->node);
+
+    /* Only the first post after the poll has consumed the wakeup needs
+     * to signal the socket.
+     */
+    if (pj_atomic_inc_and_get(ioqueue->post_signaled) == 1)
+	post_signal(ioqueue);
+
+    return PJ_SUCCESS;
+}
+
 /*
  * pj_ioqueue_get_user_data()
  *
@@ -26,6 +26,20 @@
  */
 
 #include <pj/list.h>
+#include <pj/mpsc_queue.h>
+#include <pj/slab.h>
+
+/*
+ * Posted callbacks wake the poll up with an eventfd where available,
+ * otherwise with a UDP socket which sends to itself.
+ */
+#if defined(PJ_LINUX) && PJ_LINUX!=0
+#   define IOQUEUE_HAS_EVENTFD	1
+#   include <sys/eventfd.h>
+#   include <unistd.h>
+#else
+#   define IOQUEUE_HAS_EVENTFD	0
+#endif
 
 /*
  * The select ioqueue relies on socket functions (pj_sock_xxx()) to return
@@ -120,7 +134,12 @@ union operation_key
 #define DECLARE_COMMON_IOQUEUE                      \
     pj_lock_t          *lock;                       \
     pj_bool_t           auto_delete_lock;	    \
-    pj_bool_t		default_concurrency;
+    pj_bool_t		default_concurrency;	    \
+    pj_mpsc_queue      *post_queue;		    \
+    pj_slab_t	       *post_slab;		    \
+    pj_lock_t	       *post_lock;		    \
+    pj_atomic_t	       *post_signaled;		    \
+    pj_sock_t		post_fd;
 
 
 enum ioqueue_event_type
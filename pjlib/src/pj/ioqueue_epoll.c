@@ -199,6 +199,29 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
 	ioqueue_destroy(ioqueue);
 	return PJ_RETURN_OS_ERROR(pj_get_native_os_error());
     }
+
+    /* Add the eventfd which is signaled by pj_ioqueue_post(). It is
+     * registered with NULL data, as no key has that.
+     */
+    rc = ioqueue_init_post(pool, ioqueue);
+    if (rc == PJ_SUCCESS) {
+	struct epoll_event ev;
+
+	pj_bzero(&ev, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.epoll_data = (epoll_data_type)NULL;
+	if (os_epoll_ctl(ioqueue->epfd, EPOLL_CTL_ADD, ioqueue->post_fd,
+			 &ev) < 0)
+	{
+	    rc = PJ_RETURN_OS_ERROR(pj_get_native_os_error());
+	}
+    }
+    if (rc != PJ_SUCCESS) {
+	os_close(ioqueue->epfd);
+	pj_lock_acquire(ioqueue->lock);
+	ioqueue_destroy(ioqueue);
+	return rc;
+    }
     
     /*ioqueue->events = pj_pool_calloc(pool, max_fd, sizeof(struct epoll_event));
     PJ_ASSERT_RETURN(ioqueue->events != NULL, PJ_ENOMEM);
@@ -577,6 +600,7 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 {
     int i, count, event_cnt, processed_cnt;
     int msec;
+    pj_bool_t has_post = PJ_FALSE;
     //struct epoll_event *events = ioqueue->events;
     //struct queue *queue = ioqueue->queue;
     enum { MAX_EVENTS = PJ_IOQUEUE_MAX_CAND_EVENTS };
@@ -616,6 +640,9 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
     TRACE_((THIS_FILE, "os_epoll_wait returns %d, time=%d usec",
 		       count, pj_elapsed_usec(&t1, &t2)));
 
+    /* Refresh the cached clock for the callbacks below */
+    pj_gettickcount_update_cache(NULL);
+
     /* Lock ioqueue. */
     pj_lock_acquire(ioqueue->lock);
 
@@ -625,6 +652,12 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 
 	TRACE_((THIS_FILE, "event %d: events=%d", i, events[i].events));
 
+	/* The eventfd of pj_ioqueue_post() */
+	if (h == NULL) {
+	    has_post = PJ_TRUE;
+	    continue;
+	}
+
 	/*
 	 * Check readability.
 	 */
@@ -743,10 +776,14 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 	                            "ioqueue", 0);
     }
 
+    /* Call the posted callbacks */
+    if (has_post)
+	processed_cnt += ioqueue_dispatch_post(ioqueue);
+
     /* Special case:
      * When epoll returns > 0 but no descriptors are actually set!
      */
-    if (count > 0 && !event_cnt && msec > 0) {
+    if (count > 0 && !event_cnt && !has_post && msec > 0) {
 	pj_thread_sleep(msec);
     }
 
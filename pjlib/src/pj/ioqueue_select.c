@@ -159,6 +159,9 @@ static void rescan_fdset(pj_ioqueue_t *ioqueue)
     pj_ioqueue_key_t *key = ioqueue->active_list.next;
     int max = 0;
 
+    if (ioqueue->post_fd != PJ_INVALID_SOCKET)
+	max = (int)ioqueue->post_fd;
+
     while (key != &ioqueue->active_list) {
 	if (key->fd > max)
 	    max = key->fd;
@@ -253,19 +256,47 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
     }
 #endif
 
+    /* Add the socket which is signaled by pj_ioqueue_post(). It takes one
+     * of the FD_SETSIZE slots, so clamp the number of keys accordingly.
+     */
+    rc = ioqueue_init_post(pool, ioqueue);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+    PJ_FD_SET(ioqueue->post_fd, &ioqueue->rfdset);
+    if (ioqueue->max > FD_SETSIZE - 1)
+	ioqueue->max = FD_SETSIZE - 1;
+    rescan_fdset(ioqueue);
+
     /* Create and init ioqueue mutex */
     rc = pj_lock_create_simple_mutex(pool, "ioq%p", &lock);
     if (rc != PJ_SUCCESS)
-	return rc;
+	goto on_error;
 
     rc = pj_ioqueue_set_lock(ioqueue, lock, PJ_TRUE);
-    if (rc != PJ_SUCCESS)
-        return rc;
+    if (rc != PJ_SUCCESS) {
+	pj_lock_destroy(lock);
+	goto on_error;
+    }
 
     PJ_LOG(4, ("pjlib", "select() I/O Queue created (%p)", ioqueue));
 
     *p_ioqueue = ioqueue;
     return PJ_SUCCESS;
+
+on_error:
+    /* Release the post socket/queue and the pre-created keys. */
+    ioqueue_destroy_post(ioqueue);
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+    {
+	pj_ioqueue_key_t *key = ioqueue->free_list.next;
+	while (key != &ioqueue->free_list) {
+	    pj_lock_destroy(key->lock);
+	    key = key->next;
+	}
+	pj_mutex_destroy(ioqueue->ref_cnt_mutex);
+    }
+#endif
+    return rc;
 }
 
 /*
@@ -971,6 +1002,9 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
     else if (count < 0)
 	return -pj_get_netos_error();
 
+    /* Refresh the cached clock for the callbacks below */
+    pj_gettickcount_update_cache(NULL);
+
     /* Scan descriptor sets for event and add the events in the event
      * array to be processed later in this function. We do this so that
      * events can be processed in parallel without holding ioqueue lock.
@@ -1073,6 +1107,10 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 	                            "ioqueue", 0);
     }
 
+    /* Call the posted callbacks */
+    if (PJ_FD_ISSET(ioqueue->post_fd, &rfdset))
+	processed_cnt += ioqueue_dispatch_post(ioqueue);
+
     TRACE__((THIS_FILE, "     poll: count=%d events=%d processed=%d",
 	     count, event_cnt, processed_cnt));
 
@@ -628,6 +628,19 @@ PJ_DEF(pj_status_t) pj_ioqueue_post_completion( pj_ioqueue_key_t *key,
     return PJ_SUCCESS;
 }
 
+/*
+ * pj_ioqueue_post()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_post( pj_ioqueue_t *ioqueue,
+				     pj_ioqueue_post_cb *cb,
+				     void *arg )
+{
+    PJ_UNUSED_ARG(ioqueue);
+    PJ_UNUSED_ARG(cb);
+    PJ_UNUSED_ARG(arg);
+    return PJ_ENOTSUP;
+}
+
 
 #if defined(PJ_HAS_TCP) && PJ_HAS_TCP != 0
 /**
@@ -1409,6 +1409,19 @@ PJ_DEF(pj_status_t) pj_ioqueue_post_completion( pj_ioqueue_key_t *key,
     return PJ_SUCCESS;
 }
 
+/*
+ * pj_ioqueue_post()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_post( pj_ioqueue_t *ioqueue,
+				     pj_ioqueue_post_cb *cb,
+				     void *arg )
+{
+    PJ_UNUSED_ARG(ioqueue);
+    PJ_UNUSED_ARG(cb);
+    PJ_UNUSED_ARG(arg);
+    return PJ_ENOTSUP;
+}
+
 PJ_DEF(pj_status_t) pj_ioqueue_set_concurrency(pj_ioqueue_key_t *key,
 					       pj_bool_t allow)
 {
@@ -24,6 +24,7 @@
 #include <pj/pool.h>
 #include <pj/string.h>
 #include <pj/errno.h>
+#include <pj/limits.h>
 
 #define THIS_FILE	"lock.c"
 
@@ -242,6 +243,13 @@ struct pj_grp_lock_t
     pj_thread_t		*owner;
     int			 owner_cnt;
 
+    /* Shared mode, only created with PJ_GRP_LOCK_SHARED */
+    pj_atomic_t		*readers;
+    pj_atomic_t		*writer;
+#if PJ_HAS_SEMAPHORE
+    pj_sem_t		*readers_left;
+#endif
+
     grp_lock_item	 lock_list;
     grp_destroy_callback destroy_list;
 
@@ -278,6 +286,35 @@ static void grp_lock_unset_owner_thread(pj_grp_lock_t *glock)
     }
 }
 
+/* Called by the (outermost) exclusive owner to keep new readers out and
+ * wait until the current readers have left. The last reader to leave
+ * posts the semaphore; a post left over from an earlier writer only
+ * costs another check of the readers count.
+ */
+static void grp_lock_exclude_readers(pj_grp_lock_t *glock)
+{
+    pj_atomic_set(glock->writer, 1);
+    while (pj_atomic_get(glock->readers) > 0) {
+#if PJ_HAS_SEMAPHORE
+	pj_sem_wait(glock->readers_left);
+#else
+	pj_thread_sleep(0);
+#endif
+    }
+}
+
+/* Called when a reader leaves, to wake up a waiting writer. */
+static void grp_lock_reader_left(pj_grp_lock_t *glock)
+{
+    if (pj_atomic_dec_and_get(glock->readers) == 0 &&
+	pj_atomic_get(glock->writer) != 0)
+    {
+#if PJ_HAS_SEMAPHORE
+	pj_sem_post(glock->readers_left);
+#endif
+    }
+}
+
 static pj_status_t grp_lock_acquire(LOCK_OBJ *p)
 {
     pj_grp_lock_t *glock = (pj_grp_lock_t*)p;
@@ -291,6 +328,8 @@ static pj_status_t grp_lock_acquire(LOCK_OBJ *p)
 	lck = lck->next;
     }
     grp_lock_set_owner_thread(glock);
+    if (glock->readers && glock->owner_cnt == 1)
+	grp_lock_exclude_readers(glock);
     pj_grp_lock_add_ref(glock);
     return PJ_SUCCESS;
 }
@@ -316,6 +355,20 @@ static pj_status_t grp_lock_tryacquire(LOCK_OBJ *p)
 	lck = lck->next;
     }
     grp_lock_set_owner_thread(glock);
+    if (glock->readers && glock->owner_cnt == 1) {
+	/* Don't wait for the readers to leave */
+	pj_atomic_set(glock->writer, 1);
+	if (pj_atomic_get(glock->readers) > 0) {
+	    pj_atomic_set(glock->writer, 0);
+	    grp_lock_unset_owner_thread(glock);
+	    lck = glock->lock_list.prev;
+	    while (lck != &glock->lock_list) {
+		pj_lock_release(lck->lock);
+		lck = lck->prev;
+	    }
+	    return PJ_EBUSY;
+	}
+    }
     pj_grp_lock_add_ref(glock);
     return PJ_SUCCESS;
 }
@@ -325,6 +378,8 @@ static pj_status_t grp_lock_release(LOCK_OBJ *p)
     pj_grp_lock_t *glock = (pj_grp_lock_t*)p;
     grp_lock_item *lck;
 
+    if (glock->readers && glock->owner_cnt == 1)
+	pj_atomic_set(glock->writer, 0);
     grp_lock_unset_owner_thread(glock);
 
     lck = glock->lock_list.prev;
@@ -393,6 +448,14 @@ static pj_status_t grp_lock_destroy(LOCK_OBJ *p)
 
     pj_lock_destroy(glock->own_lock);
     pj_atomic_destroy(glock->ref_cnt);
+    if (glock->readers) {
+	pj_atomic_destroy(glock->readers);
+	pj_atomic_destroy(glock->writer);
+    }
+#if PJ_HAS_SEMAPHORE
+    if (glock->readers_left)
+	pj_sem_destroy(glock->readers_left);
+#endif
     glock->pool = NULL;
     pj_pool_release(pool);
 
@@ -410,8 +473,6 @@ PJ_DEF(pj_status_t) pj_grp_lock_create( pj_pool_t *pool,
 
     PJ_ASSERT_RETURN(pool && p_grp_lock, PJ_EINVAL);
 
-    PJ_UNUSED_ARG(cfg);
-
     pool = pj_pool_create(pool->factory, "glck%p", 512, 512, NULL);
     if (!pool)
 	return PJ_ENOMEM;
@@ -440,6 +501,23 @@ PJ_DEF(pj_status_t) pj_grp_lock_create( pj_pool_t *pool,
     if (status != PJ_SUCCESS)
 	goto on_error;
 
+    if (cfg && (cfg->flags & PJ_GRP_LOCK_SHARED)) {
+	status = pj_atomic_create(pool, 0, &glock->writer);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	status = pj_atomic_create(pool, 0, &glock->readers);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+#if PJ_HAS_SEMAPHORE
+	status = pj_sem_create(pool, pool->obj_name, 0, PJ_MAXINT32,
+			       &glock->readers_left);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+#endif
+    }
+
     own_lock = PJ_POOL_ZALLOC_T(pool, grp_lock_item);
     own_lock->lock = glock->own_lock;
     pj_list_push_back(&glock->lock_list, own_lock);
@@ -488,6 +566,40 @@ PJ_DEF(pj_status_t) pj_grp_lock_release( pj_grp_lock_t *grp_lock)
     return grp_lock_release(grp_lock);
 }
 
+PJ_DEF(pj_status_t) pj_grp_lock_acquire_shared( pj_grp_lock_t *grp_lock)
+{
+    pj_assert(pj_atomic_get(grp_lock->ref_cnt) > 0);
+
+    /* Recursive acquisition by the exclusive owner stays exclusive */
+    if (!grp_lock->readers || grp_lock->owner == pj_thread_this())
+	return grp_lock_acquire(grp_lock);
+
+    for (;;) {
+	pj_atomic_inc(grp_lock->readers);
+	if (pj_atomic_get(grp_lock->writer) == 0)
+	    break;
+
+	/* A writer holds or is waiting for the lock. Back off and wait
+	 * on the own lock until the writer is done.
+	 */
+	grp_lock_reader_left(grp_lock);
+	pj_lock_acquire(grp_lock->own_lock);
+	pj_lock_release(grp_lock->own_lock);
+    }
+
+    pj_grp_lock_add_ref(grp_lock);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_grp_lock_release_shared( pj_grp_lock_t *grp_lock)
+{
+    if (!grp_lock->readers || grp_lock->owner == pj_thread_this())
+	return grp_lock_release(grp_lock);
+
+    grp_lock_reader_left(grp_lock);
+    return pj_grp_lock_dec_ref(grp_lock);
+}
+
 PJ_DEF(pj_status_t) pj_grp_lock_replace( pj_grp_lock_t *old_lock,
                                          pj_grp_lock_t *new_lock)
 {
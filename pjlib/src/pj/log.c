@@ -313,76 +313,56 @@ static pj_bool_t is_logging_suspended(void)
     }
 }
 
-PJ_DEF(void) pj_log( const char *sender, int level, 
-		     const char *format, va_list marker)
+/* Build the decoration of a message according to the decor flags. This is
+ * also used to format deferred messages, see log_async.c.
+ */
+int pj_log_format_prefix(char *buf, unsigned decor, int level,
+			 const char *sender, const pj_parsed_time *ptime,
+			 const char *thread_name, pj_bool_t thread_switched,
+			 int indent)
 {
-    pj_time_val now;
-    pj_parsed_time ptime;
-    char *pre;
-#if PJ_LOG_USE_STACK_BUFFER
-    char log_buffer[PJ_LOG_MAX_SIZE];
-#endif
-    int saved_level, len, print_len, indent;
-
-    PJ_CHECK_STACK();
+    char *pre = buf;
 
-    if (level > pj_log_max_level)
-	return;
-
-    if (is_logging_suspended())
-	return;
-
-    /* Temporarily disable logging for this thread. Some of PJLIB APIs that
-     * this function calls below will recursively call the logging function 
-     * back, hence it will cause infinite recursive calls if we allow that.
-     */
-    suspend_logging(&saved_level);
-
-    /* Get current date/time. */
-    pj_gettimeofday(&now);
-    pj_time_decode(&now, &ptime);
-
-    pre = log_buffer;
-    if (log_decor & PJ_LOG_HAS_LEVEL_TEXT) {
+    if (decor & PJ_LOG_HAS_LEVEL_TEXT) {
 	static const char *ltexts[] = { "FATAL:", "ERROR:", " WARN:", 
 			      " INFO:", "DEBUG:", "TRACE:", "DETRC:"};
 	pj_ansi_strcpy(pre, ltexts[level]);
 	pre += 6;
     }
-    if (log_decor & PJ_LOG_HAS_DAY_NAME) {
+    if (decor & PJ_LOG_HAS_DAY_NAME) {
 	static const char *wdays[] = { "Sun", "Mon", "Tue", "Wed",
 				       "Thu", "Fri", "Sat"};
-	pj_ansi_strcpy(pre, wdays[ptime.wday]);
+	pj_ansi_strcpy(pre, wdays[ptime->wday]);
 	pre += 3;
     }
-    if (log_decor & PJ_LOG_HAS_YEAR) {
-	if (pre!=log_buffer) *pre++ = ' ';
-	pre += pj_utoa(ptime.year, pre);
+    if (decor & PJ_LOG_HAS_YEAR) {
+	if (pre!=buf) *pre++ = ' ';
+	pre += pj_utoa(ptime->year, pre);
     }
-    if (log_decor & PJ_LOG_HAS_MONTH) {
+    if (decor & PJ_LOG_HAS_MONTH) {
 	*pre++ = '-';
-	pre += pj_utoa_pad(ptime.mon+1, pre, 2, '0');
+	pre += pj_utoa_pad(ptime->mon+1, pre, 2, '0');
     }
-    if (log_decor & PJ_LOG_HAS_DAY_OF_MON) {
+    if (decor & PJ_LOG_HAS_DAY_OF_MON) {
 	*pre++ = '-';
-	pre += pj_utoa_pad(ptime.day, pre, 2, '0');
+	pre += pj_utoa_pad(ptime->day, pre, 2, '0');
     }
-    if (log_decor & PJ_LOG_HAS_TIME) {
-	if (pre!=log_buffer) *pre++ = ' ';
-	pre += pj_utoa_pad(ptime.hour, pre, 2, '0');
+    if (decor & PJ_LOG_HAS_TIME) {
+	if (pre!=buf) *pre++ = ' ';
+	pre += pj_utoa_pad(ptime->hour, pre, 2, '0');
 	*pre++ = ':';
-	pre += pj_utoa_pad(ptime.min, pre, 2, '0');
+	pre += pj_utoa_pad(ptime->min, pre, 2, '0');
 	*pre++ = ':';
-	pre += pj_utoa_pad(ptime.sec, pre, 2, '0');
+	pre += pj_utoa_pad(ptime->sec, pre, 2, '0');
     }
-    if (log_decor & PJ_LOG_HAS_MICRO_SEC) {
+    if (decor & PJ_LOG_HAS_MICRO_SEC) {
 	*pre++ = '.';
-	pre += pj_utoa_pad(ptime.msec, pre, 3, '0');
+	pre += pj_utoa_pad(ptime->msec, pre, 3, '0');
     }
-    if (log_decor & PJ_LOG_HAS_SENDER) {
+    if (decor & PJ_LOG_HAS_SENDER) {
 	enum { SENDER_WIDTH = PJ_LOG_SENDER_WIDTH };
 	pj_size_t sender_len = strlen(sender);
-	if (pre!=log_buffer) *pre++ = ' ';
+	if (pre!=buf) *pre++ = ' ';
 	if (sender_len <= SENDER_WIDTH) {
 	    while (sender_len < SENDER_WIDTH)
 		*pre++ = ' ', ++sender_len;
@@ -394,9 +374,8 @@ PJ_DEF(void) pj_log( const char *sender, int level,
 		*pre++ = *sender++;
 	}
     }
-    if (log_decor & PJ_LOG_HAS_THREAD_ID) {
+    if (decor & PJ_LOG_HAS_THREAD_ID) {
 	enum { THREAD_WIDTH = PJ_LOG_THREAD_WIDTH };
-	const char *thread_name = pj_thread_get_name(pj_thread_this());
 	pj_size_t thread_len = strlen(thread_name);
 	*pre++ = ' ';
 	if (thread_len <= THREAD_WIDTH) {
@@ -411,30 +390,83 @@ PJ_DEF(void) pj_log( const char *sender, int level,
 	}
     }
 
-    if (log_decor != 0 && log_decor != PJ_LOG_HAS_NEWLINE)
+    if (decor != 0 && decor != PJ_LOG_HAS_NEWLINE)
 	*pre++ = ' ';
 
-    if (log_decor & PJ_LOG_HAS_THREAD_SWC) {
-	void *current_thread = (void*)pj_thread_this();
-	if (current_thread != g_last_thread) {
-	    *pre++ = '!';
-	    g_last_thread = current_thread;
-	} else {
-	    *pre++ = ' ';
-	}
-    } else if (log_decor & PJ_LOG_HAS_SPACE) {
+    if (decor & PJ_LOG_HAS_THREAD_SWC) {
+	*pre++ = thread_switched ? '!' : ' ';
+    } else if (decor & PJ_LOG_HAS_SPACE) {
 	*pre++ = ' ';
     }
 
 #if PJ_LOG_ENABLE_INDENT
-    if (log_decor & PJ_LOG_HAS_INDENT) {
+    if ((decor & PJ_LOG_HAS_INDENT) && indent > 0) {
+	pj_memset(pre, PJ_LOG_INDENT_CHAR, indent);
+	pre += indent;
+    }
+#else
+    PJ_UNUSED_ARG(indent);
+#endif
+
+    return (int)(pre - buf);
+}
+
+PJ_DEF(void) pj_log( const char *sender, int level, 
+		     const char *format, va_list marker)
+{
+    pj_time_val now;
+    pj_parsed_time ptime;
+    char *pre;
+#if PJ_LOG_USE_STACK_BUFFER
+    char log_buffer[PJ_LOG_MAX_SIZE];
+#endif
+    int saved_level, len, print_len, indent = 0;
+    pj_bool_t thread_switched = PJ_FALSE;
+
+    PJ_CHECK_STACK();
+
+    if (level > pj_log_max_level)
+	return;
+
+    if (is_logging_suspended())
+	return;
+
+    /* Temporarily disable logging for this thread. Some of PJLIB APIs that
+     * this function calls below will recursively call the logging function 
+     * back, hence it will cause infinite recursive calls if we allow that.
+     */
+    suspend_logging(&saved_level);
+
+#if PJ_LOG_ENABLE_INDENT
+    if (log_decor & PJ_LOG_HAS_INDENT)
 	indent = log_get_indent();
-	if (indent > 0) {
-	    pj_memset(pre, PJ_LOG_INDENT_CHAR, indent);
-	    pre += indent;
+#endif
+
+    /* In deferred mode only the arguments are queued, the message is
+     * formatted later by the writer thread.
+     */
+    if (pj_log_async_put_fmt(sender, level, indent, format, marker)) {
+	resume_logging(&saved_level);
+	return;
+    }
+
+    /* Get current date/time. */
+    pj_gettimeofday(&now);
+    pj_time_decode(&now, &ptime);
+
+    if (log_decor & PJ_LOG_HAS_THREAD_SWC) {
+	void *current_thread = (void*)pj_thread_this();
+	if (current_thread != g_last_thread) {
+	    thread_switched = PJ_TRUE;
+	    g_last_thread = current_thread;
 	}
     }
-#endif
+
+    pre = log_buffer;
+    pre += pj_log_format_prefix(log_buffer, log_decor, level, sender, &ptime,
+				(log_decor & PJ_LOG_HAS_THREAD_ID) ?
+				  pj_thread_get_name(pj_thread_this()) : NULL,
+				thread_switched, indent);
 
     len = (int)(pre - log_buffer);
 
@@ -469,6 +501,15 @@ PJ_DEF(void) pj_log( const char *sender, int level,
 	log_buffer[sizeof(log_buffer)-1] = '\0';
     }
 
+    /* In asynchronous mode, queue the message for the writer thread. This
+     * is done before resuming logging, since registering the thread's ring
+     * may log.
+     */
+    if (pj_log_async_put(level, log_buffer, len)) {
+	resume_logging(&saved_level);
+	return;
+    }
+
     /* It should be safe to resume logging at this point. Application can
      * recursively call the logging function inside the callback.
      */
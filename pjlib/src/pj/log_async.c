@@ -0,0 +1,1279 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/log.h>
+#include <pj/assert.h>
+#include <pj/atomic.h>
+#include <pj/errno.h>
+#include <pj/file_io.h>
+#include <pj/lock.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+#define THIS_FILE	"log_async.c"
+
+#if PJ_LOG_MAX_LEVEL >= 1
+
+#ifndef va_copy
+#   define va_copy(dst, src)	((dst) = (src))
+#endif
+
+#define LOG_FILE_VERSION	1
+#define FILE_BUF_SIZE		(PJ_LOG_MAX_SIZE + PJ_LOG_DEFERRED_MAX_SIZE)
+
+/* Record types, in the rings and in the binary log file */
+enum rec_type
+{
+    REC_TEXT,	    /* Formatted message */
+    REC_PAD,	    /* Padding until the end of the ring */
+    REC_FMT	    /* Deferred message */
+};
+
+/* Deferred message, followed by the format string (including the NUL
+ * terminator) and the copied arguments.
+ */
+typedef struct fmt_rec
+{
+    void	   *thread;	/* For thread switch decoration */
+    pj_uint16_t	    fmt_len;
+    pj_uint16_t	    arg_len;
+    pj_int32_t	    indent;
+    char	    sender[PJ_LOG_SENDER_WIDTH + 1];
+    char	    thread_name[PJ_LOG_THREAD_WIDTH + 1];
+} fmt_rec;
+
+/* Binary log file header */
+typedef struct file_hdr
+{
+    char	    magic[4];
+    pj_uint32_t	    version;
+    pj_uint32_t	    decor;
+    pj_uint16_t	    sender_width;
+    pj_uint16_t	    thread_width;
+} file_hdr;
+
+/* Record in binary log file, followed by the message (REC_TEXT) or the
+ * deferred message (REC_FMT).
+ */
+typedef struct file_rec
+{
+    pj_uint32_t	    size;	/* Size of the record, including header */
+    pj_uint8_t	    type;
+    pj_uint8_t	    level;
+    pj_uint8_t	    thread_switched;
+    pj_uint8_t	    reserved;
+    pj_uint32_t	    sec;
+    pj_uint32_t	    msec;
+} file_rec;
+
+/* Copied argument. Integers are widened to 64bit, so the conversion is
+ * rebuilt with "ll" length modifier when formatting.
+ */
+typedef union arg_val
+{
+    pj_int64_t	    i;
+    pj_uint64_t	    u;
+    double	    d;
+} arg_val;
+
+enum arg_type
+{
+    ARG_NONE,	    /* "%%" */
+    ARG_INT,
+    ARG_UINT,
+    ARG_CHAR,
+    ARG_DOUBLE,
+    ARG_PTR,
+    ARG_STR
+};
+
+enum arg_len
+{
+    LEN_NONE,
+    LEN_HH,
+    LEN_H,
+    LEN_L,
+    LEN_LL,
+    LEN_SIZE	    /* 'z' and 't' */
+};
+
+/* Parsed conversion specification */
+typedef struct fmt_spec
+{
+    const char	   *prec;	/* The '.' of the precision, or NULL */
+    const char	   *mod;	/* Length modifier */
+    const char	   *end;	/* Past the conversion character */
+    unsigned	    star_cnt;	/* Number of '*' width and precision */
+    pj_bool_t	    star_prec;	/* Precision is '*' */
+    int		    prec_val;	/* Precision if given as number, or -1 */
+    enum arg_type   type;
+    enum arg_len    len;
+} fmt_spec;
+
+
+/* Parse the conversion specification starting at '%'. Returns PJ_FALSE if
+ * the arguments of the specification can't be copied.
+ */
+static pj_bool_t parse_spec(const char *p, fmt_spec *spec)
+{
+    const char *start = p++;
+
+    pj_bzero(spec, sizeof(*spec));
+    spec->prec_val = -1;
+
+    while (*p=='-' || *p=='+' || *p==' ' || *p=='#' || *p=='0')
+	++p;
+
+    if (*p == '*') {
+	++spec->star_cnt;
+	++p;
+    } else {
+	while (*p >= '0' && *p <= '9')
+	    ++p;
+	/* Positional arguments */
+	if (*p == '$')
+	    return PJ_FALSE;
+    }
+
+    if (*p == '.') {
+	spec->prec = p++;
+	if (*p == '*') {
+	    ++spec->star_cnt;
+	    spec->star_prec = PJ_TRUE;
+	    ++p;
+	} else {
+	    spec->prec_val = 0;
+	    while (*p >= '0' && *p <= '9')
+		spec->prec_val = spec->prec_val * 10 + (*p++ - '0');
+	}
+    }
+
+    spec->mod = p;
+    if (p[0]=='h' && p[1]=='h') {
+	spec->len = LEN_HH, p += 2;
+    } else if (p[0]=='l' && p[1]=='l') {
+	spec->len = LEN_LL, p += 2;
+    } else if (*p=='h') {
+	spec->len = LEN_H, ++p;
+    } else if (*p=='l') {
+	spec->len = LEN_L, ++p;
+    } else if (*p=='q') {
+	spec->len = LEN_LL, ++p;
+    } else if (*p=='z' || *p=='t') {
+	spec->len = LEN_SIZE, ++p;
+    }
+    spec->end = p + 1;
+
+    /* The specification is rebuilt when formatting */
+    if (spec->end - start > 24)
+	return PJ_FALSE;
+
+    switch (*p) {
+    case 'd': case 'i':
+	spec->type = ARG_INT;
+	break;
+    case 'o': case 'u': case 'x': case 'X':
+	spec->type = ARG_UINT;
+	break;
+    case 'e': case 'E': case 'f': case 'F':
+    case 'g': case 'G': case 'a': case 'A':
+	spec->type = ARG_DOUBLE;
+	return spec->len == LEN_NONE || spec->len == LEN_L;
+    case 'c':
+	spec->type = ARG_CHAR;
+	return spec->len == LEN_NONE;
+    case 'p':
+	spec->type = ARG_PTR;
+	return spec->len == LEN_NONE;
+    case 's':
+	spec->type = ARG_STR;
+	return spec->len == LEN_NONE;
+    case '%':
+	spec->type = ARG_NONE;
+	return spec->end - start == 2;
+    default:
+	return PJ_FALSE;
+    }
+
+    return PJ_TRUE;
+}
+
+/* Format deferred message to buf. Returns the length of the message. */
+static int expand_args(char *buf, int size, const char *format,
+		       const char *arg, unsigned arg_len)
+{
+    const char *f = format, *arg_end = arg + arg_len;
+    char *p = buf, *end = buf + size - 1;
+
+    while (*f && p < end) {
+	const char *pct;
+	fmt_spec spec;
+	char sfmt[32], *s;
+	arg_val star[2], val;
+	int st[2], nstar = 0, len;
+	pj_uint16_t str_len = 0;
+	unsigned i;
+
+	/* Copy the text until the next conversion */
+	pct = strchr(f, '%');
+	len = pct ? (int)(pct - f) : (int)strlen(f);
+	if (len > end - p)
+	    len = (int)(end - p);
+	pj_memcpy(p, f, len);
+	p += len;
+	if (!pct || p == end || !parse_spec(pct, &spec))
+	    break;
+	f = spec.end;
+
+	if (spec.type == ARG_NONE) {
+	    *p++ = '%';
+	    continue;
+	}
+
+	/* Get the copied arguments */
+	if (arg_end - arg < (int)(sizeof(arg_val) * spec.star_cnt +
+				  (spec.type == ARG_STR ? sizeof(str_len) :
+							  sizeof(arg_val))))
+	{
+	    break;
+	}
+	for (i=0; i<spec.star_cnt; ++i) {
+	    pj_memcpy(&star[i], arg, sizeof(arg_val));
+	    arg += sizeof(arg_val);
+	}
+	if (spec.type == ARG_STR) {
+	    pj_memcpy(&str_len, arg, sizeof(str_len));
+	    arg += sizeof(str_len);
+	    if (arg_end - arg < str_len)
+		break;
+	} else {
+	    pj_memcpy(&val, arg, sizeof(arg_val));
+	    arg += sizeof(arg_val);
+	}
+
+	/* Rebuild the specification. Strings are printed with the length
+	 * of the copied string as precision, since they are not terminated.
+	 */
+	s = sfmt;
+	if (spec.type == ARG_STR) {
+	    const char *prefix_end = spec.prec ? spec.prec : spec.mod;
+
+	    pj_memcpy(s, pct, prefix_end - pct);
+	    s += prefix_end - pct;
+	    *s++ = '.';
+	    *s++ = '*';
+	    if (spec.star_cnt > (unsigned)spec.star_prec)
+		st[nstar++] = (int)star[0].i;
+	    st[nstar++] = str_len;
+	} else {
+	    pj_memcpy(s, pct, spec.mod - pct);
+	    s += spec.mod - pct;
+	    if (spec.type == ARG_INT || spec.type == ARG_UINT) {
+		*s++ = 'l';
+		*s++ = 'l';
+	    }
+	    for (i=0; i<spec.star_cnt; ++i)
+		st[nstar++] = (int)star[i].i;
+	}
+	*s++ = spec.end[-1];
+	*s = '\0';
+
+#define PRINT_ARG(v) \
+	(nstar == 0 ? pj_ansi_snprintf(p, end - p + 1, sfmt, v) : \
+	 nstar == 1 ? pj_ansi_snprintf(p, end - p + 1, sfmt, st[0], v) : \
+		      pj_ansi_snprintf(p, end - p + 1, sfmt, st[0], st[1], v))
+
+	switch (spec.type) {
+	case ARG_INT:
+	    len = PRINT_ARG(val.i);
+	    break;
+	case ARG_UINT:
+	    len = PRINT_ARG(val.u);
+	    break;
+	case ARG_CHAR:
+	    len = PRINT_ARG((int)val.i);
+	    break;
+	case ARG_DOUBLE:
+	    len = PRINT_ARG(val.d);
+	    break;
+	case ARG_PTR:
+	    len = PRINT_ARG((void*)(pj_size_t)val.u);
+	    break;
+	default:
+	    len = PRINT_ARG(arg);
+	    arg += str_len;
+	    break;
+	}
+
+#undef PRINT_ARG
+
+	if (len < 0 || len > end - p) {
+	    p = end;
+	    break;
+	}
+	p += len;
+    }
+
+    *p = '\0';
+    return (int)(p - buf);
+}
+
+/* Format deferred message with decoration. The buffer must be at least
+ * PJ_LOG_MAX_SIZE bytes long.
+ */
+static int format_rec(char *buf, unsigned decor, int level,
+		      const pj_time_val *tv, pj_bool_t thread_switched,
+		      const fmt_rec *fr)
+{
+    const char *format = (const char*)fr + sizeof(fmt_rec);
+    pj_parsed_time ptime;
+    int len;
+
+    pj_time_decode(tv, &ptime);
+    len = pj_log_format_prefix(buf, decor, level, fr->sender, &ptime,
+			       fr->thread_name, thread_switched, fr->indent);
+
+    /* Leave room for line ending */
+    len += expand_args(buf + len, PJ_LOG_MAX_SIZE - len - 2, format,
+		       format + fr->fmt_len, fr->arg_len);
+    if (decor & PJ_LOG_HAS_CR)
+	buf[len++] = '\r';
+    if (decor & PJ_LOG_HAS_NEWLINE)
+	buf[len++] = '\n';
+    buf[len] = '\0';
+
+    return len;
+}
+
+/* Check deferred message read from file */
+static pj_bool_t fmt_rec_valid(const fmt_rec *fr, pj_size_t size)
+{
+    const char *format = (const char*)fr + sizeof(fmt_rec);
+
+    return size >= sizeof(fmt_rec) &&
+	   sizeof(fmt_rec) + fr->fmt_len + fr->arg_len == size &&
+	   fr->fmt_len > 0 && format[fr->fmt_len - 1] == '\0' &&
+	   fr->indent >= 0 && fr->indent <= PJ_LOG_MAX_SIZE / 4 &&
+	   fr->sender[PJ_LOG_SENDER_WIDTH] == '\0' &&
+	   fr->thread_name[PJ_LOG_THREAD_WIDTH] == '\0';
+}
+
+PJ_DEF(pj_status_t) pj_log_decode_file(const char *path,
+				       pj_log_func *writer)
+{
+    pj_oshandle_t fd;
+    file_hdr hdr;
+    union {
+	fmt_rec	fr;
+	char	buf[FILE_BUF_SIZE];
+    } rec;
+    char msg[PJ_LOG_MAX_SIZE];
+    pj_ssize_t size;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(path && writer, PJ_EINVAL);
+
+    status = pj_file_open(NULL, path, PJ_O_RDONLY, &fd);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    size = sizeof(hdr);
+    status = pj_file_read(fd, &hdr, &size);
+    if (status == PJ_SUCCESS) {
+	if (size != sizeof(hdr) || pj_memcmp(hdr.magic, "PJLB", 4) != 0) {
+	    status = PJ_EINVAL;
+	} else if (hdr.version != LOG_FILE_VERSION ||
+		   hdr.sender_width != PJ_LOG_SENDER_WIDTH ||
+		   hdr.thread_width != PJ_LOG_THREAD_WIDTH)
+	{
+	    status = PJ_ENOTSUP;
+	}
+    }
+
+    while (status == PJ_SUCCESS) {
+	file_rec frec;
+	pj_time_val tv;
+	int len;
+
+	size = sizeof(frec);
+	status = pj_file_read(fd, &frec, &size);
+	if (status != PJ_SUCCESS || size == 0)
+	    break;
+
+	if (size != sizeof(frec) || frec.size < sizeof(frec) ||
+	    frec.size - sizeof(frec) > sizeof(rec.buf) || frec.level > 6)
+	{
+	    status = PJ_EINVAL;
+	    break;
+	}
+
+	size = frec.size - sizeof(frec);
+	status = pj_file_read(fd, rec.buf, &size);
+	if (status != PJ_SUCCESS)
+	    break;
+	if (size != (pj_ssize_t)(frec.size - sizeof(frec))) {
+	    status = PJ_EINVAL;
+	    break;
+	}
+
+	if (frec.type == REC_TEXT) {
+	    len = (size < (pj_ssize_t)sizeof(msg)) ? (int)size :
+						     (int)sizeof(msg) - 1;
+	    pj_memcpy(msg, rec.buf, len);
+	    msg[len] = '\0';
+	} else if (frec.type == REC_FMT && fmt_rec_valid(&rec.fr, size)) {
+	    tv.sec = frec.sec;
+	    tv.msec = frec.msec;
+	    len = format_rec(msg, hdr.decor, frec.level, &tv,
+			     frec.thread_switched, &rec.fr);
+	} else {
+	    status = PJ_EINVAL;
+	    break;
+	}
+
+	(*writer)(frec.level, msg, len);
+    }
+
+    pj_file_close(fd);
+    return status;
+}
+
+#if PJ_HAS_THREADS
+
+/* The ring indexes are shared between the thread which owns the ring
+ * (producer) and the writer thread (consumer). Where the compiler doesn't
+ * provide acquire/release accesses, the rings are protected by a mutex.
+ */
+#define RING_NEEDS_LOCK	(!PJ_HAS_ATOMIC_ACQ_REL)
+
+#define REC_ALIGN	8
+#define BATCH_SIZE	(PJ_LOG_MAX_SIZE * 4)
+#define SHARED_IDX	PJ_LOG_ASYNC_MAX_THREADS
+
+/* Record in the ring, followed by the message or deferred message. */
+typedef struct log_rec
+{
+    pj_uint32_t	    size;	/* Size of the record, including padding */
+    pj_uint16_t	    len;	/* Length of the message */
+    pj_uint8_t	    level;
+    pj_uint8_t	    type;	/* rec_type */
+    pj_timestamp    ts;		/* To merge the rings in time order */
+} log_rec;
+
+#define REC_HDR_LEN	((sizeof(log_rec) + REC_ALIGN-1) & ~(REC_ALIGN-1))
+
+/* Single producer, single consumer ring. The indexes are free running and
+ * only masked when accessing the buffer.
+ */
+typedef struct log_ring
+{
+    unsigned	    head;	/* Written by producer only */
+    char	    pad1[64];	/* Keep the indexes in separate cache lines */
+    unsigned	    tail;	/* Written by consumer only */
+    char	    pad2[64];
+    unsigned	    size;
+    char	   *buf;
+    pj_lock_t	   *lock;	/* Only for shared ring, or if required */
+    pj_uint32_t	    queued;
+    pj_uint32_t	    dropped;
+} log_ring;
+
+/* Asynchronous logging state */
+static struct log_async
+{
+    unsigned		active;
+    unsigned		gen;	    /* Incremented on each start */
+    long		tls_id;
+    pj_pool_t	       *pool;
+    pj_log_async_param	param;
+
+    pj_lock_t	       *lock;	    /* Protects ring registration */
+    unsigned		ring_cnt;
+    log_ring	       *ring[PJ_LOG_ASYNC_MAX_THREADS];
+    log_ring	       *shared;
+
+    pj_thread_t	       *thread;
+    pj_bool_t		quit;
+
+    pj_lock_t	       *drain_lock; /* There's only one consumer at a time */
+    char	       *batch;
+    unsigned		batch_len;
+    int			batch_level;
+    pj_uint32_t		written;
+    pj_uint32_t		reported_drop;
+
+    /* Deferred formatting */
+    pj_bool_t		deferred;
+    pj_oshandle_t	file;	    /* Binary log file, if any */
+    char	       *msg;	    /* Formatted deferred message */
+    void	       *last_thread;
+    pj_timestamp	base_ts;    /* To convert timestamp to time */
+    pj_time_val		base_tv;
+} async = { 0, 0, -1 };
+
+
+/* Create ring */
+static log_ring *ring_create(pj_bool_t shared)
+{
+    log_ring *r;
+
+    r = PJ_POOL_ZALLOC_T(async.pool, log_ring);
+    r->size = async.param.ring_size;
+    r->buf = (char*) pj_pool_alloc(async.pool, r->size);
+
+    if (shared || RING_NEEDS_LOCK) {
+	if (pj_lock_create_simple_mutex(async.pool, "logring",
+					&r->lock) != PJ_SUCCESS)
+	{
+	    return NULL;
+	}
+    }
+
+    return r;
+}
+
+/* Get the ring of the calling thread. The thread local value holds the
+ * ring index and the generation, so that values left from a previous
+ * start are not mistaken for valid rings.
+ */
+static log_ring *get_ring(void)
+{
+    pj_size_t val;
+    unsigned idx;
+    log_ring *r = NULL;
+
+    val = (pj_size_t)pj_thread_local_get(async.tls_id);
+    if ((val >> 16) == async.gen && (val & 0xFFFF)) {
+	idx = (unsigned)(val & 0xFFFF) - 1;
+	return (idx == SHARED_IDX) ? async.shared : async.ring[idx];
+    }
+
+    pj_lock_acquire(async.lock);
+    if (async.ring_cnt < PJ_LOG_ASYNC_MAX_THREADS)
+	r = ring_create(PJ_FALSE);
+    if (r) {
+	idx = async.ring_cnt;
+	async.ring[idx] = r;
+	PJ_ATOMIC_STORE_RELEASE(&async.ring_cnt, idx + 1);
+    } else {
+	idx = SHARED_IDX;
+	r = async.shared;
+    }
+    pj_lock_release(async.lock);
+
+    val = ((pj_size_t)async.gen << 16) | (idx + 1);
+    pj_thread_local_set(async.tls_id, (void*)val);
+    return r;
+}
+
+static unsigned ring_get_head(log_ring *r)
+{
+    unsigned head;
+
+    if (r->lock)
+	pj_lock_acquire(r->lock);
+    head = PJ_ATOMIC_LOAD_ACQUIRE(&r->head);
+    if (r->lock)
+	pj_lock_release(r->lock);
+
+    return head;
+}
+
+static void ring_set_tail(log_ring *r, unsigned tail)
+{
+    if (r->lock)
+	pj_lock_acquire(r->lock);
+    PJ_ATOMIC_STORE_RELEASE(&r->tail, tail);
+    if (r->lock)
+	pj_lock_release(r->lock);
+}
+
+/* Reserve a record in the ring. On success the ring stays locked, if it
+ * has a lock, until the record is committed.
+ */
+static log_rec *ring_reserve(log_ring *r, unsigned len)
+{
+    unsigned head, tail, off, need, contig;
+    log_rec *rec;
+
+    if (r->lock)
+	pj_lock_acquire(r->lock);
+
+    need = (unsigned)((REC_HDR_LEN + len + REC_ALIGN-1) & ~(REC_ALIGN-1));
+    head = r->head;
+    tail = PJ_ATOMIC_LOAD_ACQUIRE(&r->tail);
+    off = head & (r->size - 1);
+    contig = r->size - off;
+
+    /* Records don't wrap, pad the rest of the ring if necessary */
+    if (need > r->size / 2 ||
+	r->size - (head - tail) < (contig < need ? contig + need : need))
+    {
+	++r->dropped;
+	if (r->lock)
+	    pj_lock_release(r->lock);
+	return NULL;
+    }
+
+    if (contig < need) {
+	rec = (log_rec*)(r->buf + off);
+	rec->size = contig;
+	rec->type = REC_PAD;
+	head += contig;
+	PJ_ATOMIC_STORE_RELEASE(&r->head, head);
+	off = 0;
+    }
+
+    rec = (log_rec*)(r->buf + off);
+    rec->size = need;
+    rec->len = (pj_uint16_t)len;
+    return rec;
+}
+
+/* Publish the reserved record */
+static void ring_commit(log_ring *r, log_rec *rec, int type, int level)
+{
+    rec->level = (pj_uint8_t)level;
+    rec->type = (pj_uint8_t)type;
+    pj_get_timestamp(&rec->ts);
+
+    PJ_ATOMIC_STORE_RELEASE(&r->head, r->head + rec->size);
+    ++r->queued;
+
+    if (r->lock)
+	pj_lock_release(r->lock);
+}
+
+pj_bool_t pj_log_async_put(int level, const char *data, int len)
+{
+    log_ring *r;
+    log_rec *rec;
+
+    if (!PJ_ATOMIC_LOAD_ACQUIRE(&async.active))
+	return PJ_FALSE;
+
+    r = get_ring();
+    if (r && (rec = ring_reserve(r, len)) != NULL) {
+	pj_memcpy((char*)rec + REC_HDR_LEN, data, len);
+	ring_commit(r, rec, REC_TEXT, level);
+    }
+
+    return PJ_TRUE;
+}
+
+/* Copy the arguments of the format to buf. Returns the length of the
+ * arguments, or -1 if they can't be copied.
+ */
+static int copy_args(char *buf, unsigned size, const char *format,
+		     va_list ap)
+{
+    char *p = buf, *end = buf + size;
+    const char *f = format;
+    fmt_spec spec;
+
+    while ((f = strchr(f, '%')) != NULL) {
+	arg_val star[2], val;
+	unsigned i;
+
+	if (!parse_spec(f, &spec))
+	    return -1;
+	f = spec.end;
+	if (spec.type == ARG_NONE)
+	    continue;
+
+	if (end - p < (int)(sizeof(arg_val) * spec.star_cnt +
+			    (spec.type == ARG_STR ? sizeof(pj_uint16_t) :
+						    sizeof(arg_val))))
+	{
+	    return -1;
+	}
+
+	for (i=0; i<spec.star_cnt; ++i) {
+	    star[i].i = va_arg(ap, int);
+	    pj_memcpy(p, &star[i], sizeof(arg_val));
+	    p += sizeof(arg_val);
+	}
+
+	switch (spec.type) {
+	case ARG_INT:
+	    switch (spec.len) {
+	    case LEN_HH: val.i = (signed char)va_arg(ap, int); break;
+	    case LEN_H:	 val.i = (short)va_arg(ap, int); break;
+	    case LEN_L:	 val.i = va_arg(ap, long); break;
+	    case LEN_LL: val.i = va_arg(ap, pj_int64_t); break;
+	    case LEN_SIZE: val.i = va_arg(ap, pj_ssize_t); break;
+	    default:	 val.i = va_arg(ap, int); break;
+	    }
+	    break;
+	case ARG_UINT:
+	    switch (spec.len) {
+	    case LEN_HH: val.u = (unsigned char)va_arg(ap, unsigned); break;
+	    case LEN_H:	 val.u = (unsigned short)va_arg(ap, unsigned); break;
+	    case LEN_L:	 val.u = va_arg(ap, unsigned long); break;
+	    case LEN_LL: val.u = va_arg(ap, pj_uint64_t); break;
+	    case LEN_SIZE: val.u = va_arg(ap, pj_size_t); break;
+	    default:	 val.u = va_arg(ap, unsigned); break;
+	    }
+	    break;
+	case ARG_CHAR:
+	    val.i = va_arg(ap, int);
+	    break;
+	case ARG_DOUBLE:
+	    val.d = va_arg(ap, double);
+	    break;
+	case ARG_PTR:
+	    val.u = (pj_size_t)va_arg(ap, void*);
+	    break;
+	default:
+	    {
+		const char *str = va_arg(ap, const char*);
+		int prec = spec.star_prec ? (int)star[spec.star_cnt-1].i :
+					    spec.prec_val;
+		pj_uint16_t str_len;
+		pj_size_t len;
+
+		if (!str)
+		    str = "(null)";
+		if (prec >= 0) {
+		    const char *nul = (const char*)memchr(str, 0, prec);
+		    len = nul ? (pj_size_t)(nul - str) : (pj_size_t)prec;
+		} else {
+		    len = strlen(str);
+		}
+
+		if (len + sizeof(str_len) > (pj_size_t)(end - p))
+		    return -1;
+		str_len = (pj_uint16_t)len;
+		pj_memcpy(p, &str_len, sizeof(str_len));
+		pj_memcpy(p + sizeof(str_len), str, len);
+		p += sizeof(str_len) + len;
+	    }
+	    continue;
+	}
+
+	pj_memcpy(p, &val, sizeof(arg_val));
+	p += sizeof(arg_val);
+    }
+
+    return (int)(p - buf);
+}
+
+/* Copy name, truncated to the decoration width */
+static void copy_name(char *dst, const char *src, unsigned width)
+{
+    unsigned i;
+
+    for (i=0; i<width && src[i]; ++i)
+	dst[i] = src[i];
+    dst[i] = '\0';
+}
+
+pj_bool_t pj_log_async_put_fmt(const char *sender, int level, int indent,
+			       const char *format, va_list marker)
+{
+    union {
+	fmt_rec	fr;
+	char	buf[PJ_LOG_DEFERRED_MAX_SIZE];
+    } rec;
+    pj_thread_t *thread;
+    pj_size_t fmt_len;
+    unsigned len;
+    int arg_len;
+    va_list ap;
+    log_ring *r;
+    log_rec *lr;
+
+    if (!PJ_ATOMIC_LOAD_ACQUIRE(&async.active) || !async.deferred)
+	return PJ_FALSE;
+
+    fmt_len = strlen(format) + 1;
+    if (sizeof(fmt_rec) + fmt_len >= sizeof(rec))
+	return PJ_FALSE;
+
+    /* The caller formats the message if the arguments can't be copied */
+    va_copy(ap, marker);
+    arg_len = copy_args(rec.buf + sizeof(fmt_rec) + fmt_len,
+			(unsigned)(sizeof(rec) - sizeof(fmt_rec) - fmt_len),
+			format, ap);
+    va_end(ap);
+    if (arg_len < 0)
+	return PJ_FALSE;
+
+    /* The format is copied too, as it's not necessarily a literal */
+    pj_memcpy(rec.buf + sizeof(fmt_rec), format, fmt_len);
+
+    thread = pj_thread_this();
+    rec.fr.thread = thread;
+    rec.fr.fmt_len = (pj_uint16_t)fmt_len;
+    rec.fr.arg_len = (pj_uint16_t)arg_len;
+    rec.fr.indent = indent;
+    copy_name(rec.fr.sender, sender, PJ_LOG_SENDER_WIDTH);
+    copy_name(rec.fr.thread_name, pj_thread_get_name(thread),
+	      PJ_LOG_THREAD_WIDTH);
+
+    len = (unsigned)(sizeof(fmt_rec) + fmt_len + arg_len);
+    r = get_ring();
+    if (r && (lr = ring_reserve(r, len)) != NULL) {
+	pj_memcpy((char*)lr + REC_HDR_LEN, rec.buf, len);
+	ring_commit(r, lr, REC_FMT, level);
+    }
+
+    return PJ_TRUE;
+}
+
+/* Pass the batched messages to the log writer, or write the batched
+ * records to the binary log file.
+ */
+static void flush_batch(void)
+{
+    pj_log_func *writer = pj_log_get_log_func();
+
+    if (async.batch_len == 0)
+	return;
+
+    if (async.file) {
+	pj_ssize_t size = async.batch_len;
+	pj_file_write(async.file, async.batch, &size);
+    } else {
+	async.batch[async.batch_len] = '\0';
+	if (writer)
+	    (*writer)(async.batch_level, async.batch, async.batch_len);
+    }
+    async.batch_len = 0;
+}
+
+/* Get the time of the record */
+static void get_rec_time(const log_rec *rec, pj_time_val *tv)
+{
+    pj_time_val elapsed = pj_elapsed_time(&async.base_ts, &rec->ts);
+
+    *tv = async.base_tv;
+    PJ_TIME_VAL_ADD(*tv, elapsed);
+}
+
+/* Check if the deferred message is from different thread than the
+ * previous one.
+ */
+static pj_bool_t check_thread_switch(const log_rec *rec)
+{
+    const fmt_rec *fr = (const fmt_rec*)((const char*)rec + REC_HDR_LEN);
+
+    if (fr->thread == async.last_thread)
+	return PJ_FALSE;
+
+    async.last_thread = fr->thread;
+    return PJ_TRUE;
+}
+
+/* Add the record to the binary log file batch */
+static void write_file_rec(const log_rec *rec)
+{
+    file_rec frec;
+    pj_time_val tv;
+
+    frec.size = (pj_uint32_t)(sizeof(frec) + rec->len);
+    if (async.batch_len + frec.size > BATCH_SIZE)
+	flush_batch();
+
+    get_rec_time(rec, &tv);
+    frec.type = rec->type;
+    frec.level = rec->level;
+    frec.thread_switched = (pj_uint8_t)
+	(rec->type == REC_FMT ? check_thread_switch(rec) : PJ_FALSE);
+    frec.reserved = 0;
+    frec.sec = (pj_uint32_t)tv.sec;
+    frec.msec = (pj_uint32_t)tv.msec;
+
+    pj_memcpy(async.batch + async.batch_len, &frec, sizeof(frec));
+    pj_memcpy(async.batch + async.batch_len + sizeof(frec),
+	      (const char*)rec + REC_HDR_LEN, rec->len);
+    async.batch_len += frec.size;
+}
+
+/* Add a message to the batch. Consecutive messages with the same level are
+ * written with one call to the log writer.
+ */
+static void write_rec(const log_rec *rec)
+{
+    const char *msg = (const char*)rec + REC_HDR_LEN;
+    unsigned len = rec->len;
+
+    ++async.written;
+
+    if (async.file) {
+	write_file_rec(rec);
+	return;
+    }
+
+    if (rec->type == REC_FMT) {
+	pj_time_val tv;
+
+	get_rec_time(rec, &tv);
+	len = format_rec(async.msg, pj_log_get_decor(), rec->level, &tv,
+			 check_thread_switch(rec), (const fmt_rec*)msg);
+	msg = async.msg;
+    }
+
+    if (async.batch_len &&
+	(rec->level != async.batch_level ||
+	 async.batch_len + len >= BATCH_SIZE))
+    {
+	flush_batch();
+    }
+
+    pj_memcpy(async.batch + async.batch_len, msg, len);
+    async.batch_len += len;
+    async.batch_level = rec->level;
+}
+
+/* Write the queued messages of all rings, oldest first */
+static void drain(void)
+{
+    log_ring *ring[PJ_LOG_ASYNC_MAX_THREADS + 1];
+    unsigned head[PJ_LOG_ASYNC_MAX_THREADS + 1];
+    unsigned tail[PJ_LOG_ASYNC_MAX_THREADS + 1];
+    unsigned i, cnt;
+    pj_uint32_t dropped = 0, new_drop;
+
+    pj_lock_acquire(async.drain_lock);
+
+    cnt = PJ_ATOMIC_LOAD_ACQUIRE(&async.ring_cnt);
+    for (i=0; i<cnt; ++i)
+	ring[i] = async.ring[i];
+    ring[cnt++] = async.shared;
+
+    for (i=0; i<cnt; ++i) {
+	head[i] = ring_get_head(ring[i]);
+	tail[i] = ring[i]->tail;
+    }
+
+    for (;;) {
+	const log_rec *oldest = NULL;
+	unsigned oldest_idx = 0;
+
+	for (i=0; i<cnt; ++i) {
+	    const log_rec *rec;
+
+	    if (tail[i] == head[i])
+		continue;
+
+	    rec = (log_rec*)(ring[i]->buf + (tail[i] & (ring[i]->size - 1)));
+	    if (rec->type == REC_PAD) {
+		tail[i] += rec->size;
+		if (tail[i] == head[i])
+		    continue;
+		rec = (log_rec*)(ring[i]->buf);
+	    }
+
+	    if (!oldest || pj_cmp_timestamp(&rec->ts, &oldest->ts) < 0) {
+		oldest = rec;
+		oldest_idx = i;
+	    }
+	}
+
+	if (!oldest)
+	    break;
+
+	write_rec(oldest);
+	tail[oldest_idx] += oldest->size;
+	ring_set_tail(ring[oldest_idx], tail[oldest_idx]);
+    }
+
+    for (i=0; i<cnt; ++i) {
+	ring_set_tail(ring[i], tail[i]);
+	dropped += ring[i]->dropped;
+    }
+
+    flush_batch();
+
+    new_drop = dropped - async.reported_drop;
+    async.reported_drop = dropped;
+
+    pj_lock_release(async.drain_lock);
+
+    if (new_drop) {
+	PJ_LOG(2,(THIS_FILE, "%u log messages were dropped", new_drop));
+    }
+}
+
+static int writer_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    while (!async.quit) {
+	pj_thread_sleep(async.param.flush_interval);
+	drain();
+    }
+
+    return 0;
+}
+
+/* Release resources */
+static void async_release(void)
+{
+    unsigned i;
+
+    for (i=0; i<async.ring_cnt; ++i) {
+	if (async.ring[i]->lock)
+	    pj_lock_destroy(async.ring[i]->lock);
+    }
+    async.ring_cnt = 0;
+    if (async.shared && async.shared->lock)
+	pj_lock_destroy(async.shared->lock);
+    async.shared = NULL;
+    if (async.file) {
+	pj_file_close(async.file);
+	async.file = NULL;
+    }
+    if (async.drain_lock) {
+	pj_lock_destroy(async.drain_lock);
+	async.drain_lock = NULL;
+    }
+    if (async.lock) {
+	pj_lock_destroy(async.lock);
+	async.lock = NULL;
+    }
+    if (async.pool) {
+	pj_pool_release(async.pool);
+	async.pool = NULL;
+    }
+}
+
+/* Called by pj_shutdown() */
+static void async_shutdown(void)
+{
+    pj_log_async_stop();
+
+    if (async.tls_id != -1) {
+	pj_thread_local_free(async.tls_id);
+	async.tls_id = -1;
+    }
+}
+
+PJ_DEF(void) pj_log_async_param_default(pj_log_async_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->ring_size = PJ_LOG_ASYNC_RING_SIZE;
+    param->flush_interval = PJ_LOG_ASYNC_FLUSH_INTERVAL;
+}
+
+PJ_DEF(pj_status_t) pj_log_async_start(pj_pool_factory *pf,
+				       const pj_log_async_param *param)
+{
+    pj_log_async_param default_param;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pf, PJ_EINVAL);
+
+    if (!param) {
+	pj_log_async_param_default(&default_param);
+	param = &default_param;
+    }
+
+    /* Ring size must be power of two */
+    PJ_ASSERT_RETURN(param->ring_size >= 4096 &&
+		     (param->ring_size & (param->ring_size-1)) == 0,
+		     PJ_EINVAL);
+
+    if (async.active)
+	return PJ_EEXISTS;
+
+    if (async.tls_id == -1) {
+	status = pj_thread_local_alloc(&async.tls_id);
+	if (status != PJ_SUCCESS)
+	    return status;
+	pj_atexit(&async_shutdown);
+    }
+
+    async.pool = pj_pool_create(pf, "logasync", 4000, 4000, NULL);
+    if (!async.pool)
+	return PJ_ENOMEM;
+
+    pj_memcpy(&async.param, param, sizeof(*param));
+    if (async.param.flush_interval == 0)
+	async.param.flush_interval = PJ_LOG_ASYNC_FLUSH_INTERVAL;
+
+    /* Generation zero is reserved for unset thread local value */
+    if (++async.gen > 0xFFFF)
+	async.gen = 1;
+
+    async.ring_cnt = 0;
+    async.quit = PJ_FALSE;
+    async.batch_len = 0;
+    async.written = 0;
+    async.reported_drop = 0;
+    async.deferred = param->deferred || param->binary_file.slen;
+    async.last_thread = NULL;
+    pj_gettimeofday(&async.base_tv);
+    pj_get_timestamp(&async.base_ts);
+
+    status = pj_lock_create_simple_mutex(async.pool, "logasync",
+					 &async.lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = pj_lock_create_simple_mutex(async.pool, "logdrain",
+					 &async.drain_lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    async.shared = ring_create(PJ_TRUE);
+    if (!async.shared) {
+	status = PJ_ENOMEM;
+	goto on_error;
+    }
+
+    async.batch = (char*) pj_pool_alloc(async.pool, BATCH_SIZE + 1);
+    async.msg = (char*) pj_pool_alloc(async.pool, PJ_LOG_MAX_SIZE);
+
+    if (param->binary_file.slen) {
+	file_hdr hdr;
+	pj_str_t path;
+	pj_ssize_t size = sizeof(hdr);
+
+	pj_strdup_with_null(async.pool, &path, &param->binary_file);
+	status = pj_file_open(async.pool, path.ptr, PJ_O_WRONLY,
+			      &async.file);
+	if (status != PJ_SUCCESS) {
+	    async.file = NULL;
+	    goto on_error;
+	}
+
+	pj_bzero(&hdr, sizeof(hdr));
+	pj_memcpy(hdr.magic, "PJLB", 4);
+	hdr.version = LOG_FILE_VERSION;
+	hdr.decor = pj_log_get_decor();
+	hdr.sender_width = PJ_LOG_SENDER_WIDTH;
+	hdr.thread_width = PJ_LOG_THREAD_WIDTH;
+	status = pj_file_write(async.file, &hdr, &size);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
+    status = pj_thread_create(async.pool, "logwriter", &writer_thread, NULL,
+			      0, 0, &async.thread);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    PJ_ATOMIC_STORE_RELEASE(&async.active, 1);
+
+    return PJ_SUCCESS;
+
+on_error:
+    async_release();
+    return status;
+}
+
+PJ_DEF(void) pj_log_async_flush(void)
+{
+    if (PJ_ATOMIC_LOAD_ACQUIRE(&async.active))
+	drain();
+}
+
+PJ_DEF(void) pj_log_async_get_stat(pj_log_async_stat *stat)
+{
+    unsigned i, cnt;
+
+    pj_bzero(stat, sizeof(*stat));
+    if (!PJ_ATOMIC_LOAD_ACQUIRE(&async.active))
+	return;
+
+    cnt = PJ_ATOMIC_LOAD_ACQUIRE(&async.ring_cnt);
+    for (i=0; i<cnt; ++i) {
+	stat->queued += async.ring[i]->queued;
+	stat->dropped += async.ring[i]->dropped;
+    }
+    stat->queued += async.shared->queued;
+    stat->dropped += async.shared->dropped;
+    stat->written = async.written;
+}
+
+PJ_DEF(pj_status_t) pj_log_async_stop(void)
+{
+    if (!async.active)
+	return PJ_SUCCESS;
+
+    async.quit = PJ_TRUE;
+    pj_thread_join(async.thread);
+    pj_thread_destroy(async.thread);
+    async.thread = NULL;
+
+    /* Messages logged from now on are written directly */
+    PJ_ATOMIC_STORE_RELEASE(&async.active, 0);
+
+    drain();
+    async_release();
+
+    return PJ_SUCCESS;
+}
+
+#else	/* PJ_HAS_THREADS */
+
+pj_bool_t pj_log_async_put(int level, const char *data, int len)
+{
+    PJ_UNUSED_ARG(level);
+    PJ_UNUSED_ARG(data);
+    PJ_UNUSED_ARG(len);
+    return PJ_FALSE;
+}
+
+pj_bool_t pj_log_async_put_fmt(const char *sender, int level, int indent,
+			       const char *format, va_list marker)
+{
+    PJ_UNUSED_ARG(sender);
+    PJ_UNUSED_ARG(level);
+    PJ_UNUSED_ARG(indent);
+    PJ_UNUSED_ARG(format);
+    PJ_UNUSED_ARG(marker);
+    return PJ_FALSE;
+}
+
+PJ_DEF(void) pj_log_async_param_default(pj_log_async_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->ring_size = PJ_LOG_ASYNC_RING_SIZE;
+    param->flush_interval = PJ_LOG_ASYNC_FLUSH_INTERVAL;
+}
+
+PJ_DEF(pj_status_t) pj_log_async_start(pj_pool_factory *pf,
+				       const pj_log_async_param *param)
+{
+    PJ_UNUSED_ARG(pf);
+    PJ_UNUSED_ARG(param);
+    return PJ_EINVALIDOP;
+}
+
+PJ_DEF(void) pj_log_async_flush(void)
+{
+}
+
+PJ_DEF(void) pj_log_async_get_stat(pj_log_async_stat *stat)
+{
+    pj_bzero(stat, sizeof(*stat));
+}
+
+PJ_DEF(pj_status_t) pj_log_async_stop(void)
+{
+    return PJ_SUCCESS;
+}
+
+#endif	/* PJ_HAS_THREADS */
+
+#endif	/* PJ_LOG_MAX_LEVEL >= 1 */
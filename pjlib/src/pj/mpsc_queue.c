@@ -0,0 +1,174 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/mpsc_queue.h>
+#include <pj/assert.h>
+#include <pj/atomic.h>
+#include <pj/errno.h>
+#include <pj/lock.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+
+/*
+ * The queue is a linked list where producers swap themselves in as the
+ * tail, then link the previous tail to the new node. The consumer owns
+ * the head. A stub node is kept in the list so that the last node can be
+ * taken out while producers keep appending to it.
+ */
+#define QUEUE_NEEDS_LOCK	(!PJ_HAS_ATOMIC_ACQ_REL)
+
+struct pj_mpsc_queue
+{
+    pj_mpsc_node     *tail;	/* Swapped by producers */
+    char	      pad[64];	/* Keep tail and head in separate cache lines */
+    pj_mpsc_node     *head;	/* Owned by the consumer */
+    pj_mpsc_node      stub;
+#if QUEUE_NEEDS_LOCK
+    pj_lock_t	     *lock;
+#endif
+};
+
+
+PJ_DEF(pj_status_t) pj_mpsc_queue_create(pj_pool_t *pool,
+					 pj_mpsc_queue **p_queue)
+{
+    pj_mpsc_queue *q;
+
+    PJ_ASSERT_RETURN(pool && p_queue, PJ_EINVAL);
+
+    q = PJ_POOL_ZALLOC_T(pool, pj_mpsc_queue);
+    q->stub.next = NULL;
+    q->head = q->tail = &q->stub;
+
+#if QUEUE_NEEDS_LOCK
+    {
+	pj_status_t status;
+
+	status = pj_lock_create_simple_mutex(pool, "mpsc%p", &q->lock);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+#endif
+
+    *p_queue = q;
+    return PJ_SUCCESS;
+}
+
+
+static void push(pj_mpsc_queue *q, pj_mpsc_node *node)
+{
+    pj_mpsc_node *prev;
+
+    node->next = NULL;
+#if QUEUE_NEEDS_LOCK
+    prev = q->tail;
+    q->tail = node;
+#else
+    prev = (pj_mpsc_node*) PJ_ATOMIC_EXCHANGE_PTR(&q->tail, node);
+#endif
+    /* Between the exchange and this store the node is not reachable from
+     * the head yet, see wait_next().
+     */
+    PJ_ATOMIC_STORE_RELEASE_PTR(&prev->next, node);
+}
+
+
+/* Get the successor of the node. If a producer has already swapped the
+ * node out as the tail but has not linked its own node yet, wait for it.
+ */
+static pj_mpsc_node *wait_next(pj_mpsc_queue *q, pj_mpsc_node *node)
+{
+    pj_mpsc_node *next = (pj_mpsc_node*)
+			 PJ_ATOMIC_LOAD_ACQUIRE_PTR(&node->next);
+
+    while (next == NULL &&
+	   (pj_mpsc_node*) PJ_ATOMIC_LOAD_ACQUIRE_PTR(&q->tail) != node)
+    {
+	pj_thread_sleep(0);
+	next = (pj_mpsc_node*) PJ_ATOMIC_LOAD_ACQUIRE_PTR(&node->next);
+    }
+    return next;
+}
+
+
+PJ_DEF(void) pj_mpsc_queue_push(pj_mpsc_queue *q, pj_mpsc_node *node)
+{
+    PJ_ASSERT_ON_FAIL(q && node, return);
+
+#if QUEUE_NEEDS_LOCK
+    pj_lock_acquire(q->lock);
+    push(q, node);
+    pj_lock_release(q->lock);
+#else
+    push(q, node);
+#endif
+}
+
+
+PJ_DEF(pj_mpsc_node*) pj_mpsc_queue_pop(pj_mpsc_queue *q)
+{
+    pj_mpsc_node *node, *next;
+
+    PJ_ASSERT_RETURN(q, NULL);
+
+#if QUEUE_NEEDS_LOCK
+    pj_lock_acquire(q->lock);
+#endif
+
+    node = q->head;
+    next = wait_next(q, node);
+
+    /* Skip the stub */
+    if (node == &q->stub) {
+	if (next == NULL) {
+	    node = NULL;
+	    goto on_return;
+	}
+	q->head = node = next;
+	next = wait_next(q, node);
+    }
+
+    if (next == NULL) {
+	/* This is the last node. Put the stub behind it, so that the
+	 * node can be taken out while producers append to the stub.
+	 */
+	push(q, &q->stub);
+	next = wait_next(q, node);
+    }
+
+    q->head = next;
+
+on_return:
+#if QUEUE_NEEDS_LOCK
+    pj_lock_release(q->lock);
+#endif
+    return node;
+}
+
+
+PJ_DEF(pj_status_t) pj_mpsc_queue_destroy(pj_mpsc_queue *q)
+{
+    PJ_ASSERT_RETURN(q, PJ_EINVAL);
+
+#if QUEUE_NEEDS_LOCK
+    pj_lock_destroy(q->lock);
+#endif
+    return PJ_SUCCESS;
+}
+
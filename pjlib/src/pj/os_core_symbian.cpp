@@ -563,6 +563,48 @@ PJ_DEF(int) pj_thread_get_prio_max(pj_thread_t *thread)
 }
 
 
+/*
+ * Set the thread scheduling policy and priority.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_sched(pj_thread_t *thread,
+					pj_thread_sched_policy policy,
+					int prio)
+{
+    if (policy != PJ_THREAD_SCHED_DEFAULT)
+	return PJ_ENOTSUP;
+
+    return pj_thread_set_prio(thread, prio);
+}
+
+
+/*
+ * Set the CPUs the thread may run on.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread,
+					   unsigned cpu_cnt,
+					   const unsigned cpu[])
+{
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(cpu_cnt);
+    PJ_UNUSED_ARG(cpu);
+    return PJ_ENOTSUP;
+}
+
+
+/*
+ * Get the CPUs of a NUMA node.
+ */
+PJ_DEF(pj_status_t) pj_get_numa_node_cpus(unsigned node,
+					  unsigned *cpu_cnt,
+					  unsigned cpu[])
+{
+    PJ_UNUSED_ARG(node);
+    PJ_UNUSED_ARG(cpu);
+    *cpu_cnt = 0;
+    return PJ_ENOTSUP;
+}
+
+
 /*
  * pj_thread_get_os_handle()
  */
@@ -688,6 +730,19 @@ PJ_DEF(pj_status_t) pj_thread_local_alloc(long *index)
     return PJ_SUCCESS;
 }
 
+/*
+ * pj_thread_local_alloc2()
+ */
+PJ_DEF(pj_status_t) pj_thread_local_alloc2(long *index,
+					   void (*dtor)(void *value))
+{
+    /* Destructor is not supported */
+    if (dtor)
+	return PJ_ENOTSUP;
+
+    return pj_thread_local_alloc(index);
+}
+
 /*
  * pj_thread_local_free()
  */
@@ -41,6 +41,8 @@
 
 #include <unistd.h>	    // getpid()
 #include <errno.h>	    // errno
+#include <stdio.h>	    // fopen()
+#include <stdlib.h>	    // strtoul()
 
 #include <pthread.h>
 
@@ -137,9 +139,19 @@ struct pj_event_t
 static int initialized;
 
 #if PJ_HAS_THREADS
-    static pj_thread_t main_thread;
+    static pj_thread_desc main_thread;
     static long thread_tls_id;
     static pj_mutex_t critical_section;
+
+    /* Destructors of thread local variables, see pj_thread_local_alloc2() */
+#   define MAX_TLS_DTOR 16
+    typedef struct tls_dtor
+    {
+	long	  index;
+	void	(*dtor)(void *value);
+    } tls_dtor;
+    static tls_dtor tls_dtors[MAX_TLS_DTOR];
+    static unsigned tls_dtor_cnt;
 #else
 #   define MAX_THREADS 32
     static int tls_flag[MAX_THREADS];
@@ -255,6 +267,7 @@ PJ_DEF(void) pj_shutdown()
 
 #if PJ_HAS_THREADS
     /* Destroy PJLIB critical section */
+    tls_dtor_cnt = 0;
     pj_mutex_destroy(&critical_section);
 
     /* Free PJLIB TLS */
@@ -397,6 +410,156 @@ PJ_DEF(int) pj_thread_get_prio_max(pj_thread_t *thread)
 }
 
 
+/*
+ * Set the thread scheduling policy and priority.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_sched(pj_thread_t *thread,
+					pj_thread_sched_policy policy,
+					int prio)
+{
+#if PJ_HAS_THREADS
+    struct sched_param param;
+    int os_policy;
+    int rc;
+
+    PJ_ASSERT_RETURN(thread, PJ_EINVAL);
+
+    rc = pthread_getschedparam(thread->thread, &os_policy, &param);
+    if (rc != 0)
+	return PJ_RETURN_OS_ERROR(rc);
+
+    switch (policy) {
+    case PJ_THREAD_SCHED_DEFAULT:
+	break;
+    case PJ_THREAD_SCHED_NORMAL:
+	os_policy = SCHED_OTHER;
+	break;
+    case PJ_THREAD_SCHED_FIFO:
+	os_policy = SCHED_FIFO;
+	break;
+    case PJ_THREAD_SCHED_RR:
+	os_policy = SCHED_RR;
+	break;
+    default:
+	return PJ_EINVAL;
+    }
+
+    param.sched_priority = prio;
+
+    rc = pthread_setschedparam(thread->thread, os_policy, &param);
+    if (rc != 0)
+	return PJ_RETURN_OS_ERROR(rc);
+
+    return PJ_SUCCESS;
+#else
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(policy);
+    PJ_UNUSED_ARG(prio);
+    pj_assert("pj_thread_set_sched() called in non-threading mode!");
+    return PJ_EINVALIDOP;
+#endif
+}
+
+
+/*
+ * Set the CPUs the thread may run on.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread,
+					   unsigned cpu_cnt,
+					   const unsigned cpu[])
+{
+    PJ_ASSERT_RETURN(thread && (cpu_cnt == 0 || cpu), PJ_EINVAL);
+
+#if PJ_HAS_THREADS && defined(PJ_LINUX) && PJ_LINUX!=0 && \
+    !(defined(PJ_ANDROID) && PJ_ANDROID!=0)
+    {
+	cpu_set_t set;
+	unsigned i;
+	int rc;
+
+	CPU_ZERO(&set);
+	if (cpu_cnt == 0) {
+	    long n = sysconf(_SC_NPROCESSORS_CONF);
+
+	    for (i=0; i<(unsigned)n && i<CPU_SETSIZE; ++i)
+		CPU_SET(i, &set);
+	} else {
+	    for (i=0; i<cpu_cnt; ++i) {
+		PJ_ASSERT_RETURN(cpu[i] < CPU_SETSIZE, PJ_EINVAL);
+		CPU_SET(cpu[i], &set);
+	    }
+	}
+
+	rc = pthread_setaffinity_np(thread->thread, sizeof(set), &set);
+	if (rc != 0)
+	    return PJ_RETURN_OS_ERROR(rc);
+
+	return PJ_SUCCESS;
+    }
+#else
+    PJ_UNUSED_ARG(cpu_cnt);
+    PJ_UNUSED_ARG(cpu);
+    return PJ_ENOTSUP;
+#endif
+}
+
+
+/*
+ * Get the CPUs of a NUMA node.
+ */
+PJ_DEF(pj_status_t) pj_get_numa_node_cpus(unsigned node,
+					  unsigned *cpu_cnt,
+					  unsigned cpu[])
+{
+    PJ_ASSERT_RETURN(cpu_cnt && cpu, PJ_EINVAL);
+
+#if defined(PJ_LINUX) && PJ_LINUX!=0
+    {
+	char path[80];
+	char list[1024];
+	char *p;
+	FILE *f;
+	unsigned cnt = 0;
+
+	pj_ansi_snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%u/cpulist", node);
+	f = fopen(path, "r");
+	if (!f) {
+	    *cpu_cnt = 0;
+	    return (errno == ENOENT) ? PJ_ENOTFOUND :
+				       PJ_RETURN_OS_ERROR(errno);
+	}
+	if (fgets(list, sizeof(list), f) == NULL)
+	    list[0] = '\0';
+	fclose(f);
+
+	/* The list looks like "0-3,8-11" */
+	p = list;
+	while (*p >= '0' && *p <= '9') {
+	    unsigned first, last;
+
+	    first = last = (unsigned) strtoul(p, &p, 10);
+	    if (*p == '-')
+		last = (unsigned) strtoul(p+1, &p, 10);
+
+	    for (; first <= last && cnt < *cpu_cnt; ++first)
+		cpu[cnt++] = first;
+
+	    if (*p == ',')
+		++p;
+	}
+
+	*cpu_cnt = cnt;
+	return PJ_SUCCESS;
+    }
+#else
+    PJ_UNUSED_ARG(node);
+    *cpu_cnt = 0;
+    return PJ_ENOTSUP;
+#endif
+}
+
+
 /*
  * Get native thread handle
  */
@@ -487,20 +650,51 @@ PJ_DEF(pj_status_t) pj_thread_register ( const char *cstr_thread_name,
 #endif
 }
 
+#if PJ_HAS_THREADS
+/*
+ * Called by a thread which is done with pjlib, while it is still
+ * registered: calls the destructors of its thread local variables (see
+ * pj_thread_local_alloc2()). These are not given to pthread, as the
+ * thread may already be unregistered from pjlib when pthread calls them.
+ */
+static void thread_exit_hook(void)
+{
+    tls_dtor dtors[MAX_TLS_DTOR];
+    unsigned i, cnt;
+
+    if (tls_dtor_cnt == 0)
+	return;
+
+    pj_enter_critical_section();
+    cnt = tls_dtor_cnt;
+    pj_memcpy(dtors, tls_dtors, cnt * sizeof(dtors[0]));
+    pj_leave_critical_section();
+
+    for (i=0; i<cnt; ++i) {
+	void *val = pthread_getspecific(dtors[i].index);
+	if (val) {
+	    pthread_setspecific(dtors[i].index, NULL);
+	    (*dtors[i].dtor)(val);
+	}
+    }
+}
+#endif
+
 /*
  * pj_thread_init(void)
  */
 pj_status_t pj_thread_init(void)
 {
 #if PJ_HAS_THREADS
-    pj_status_t rc;
+    pthread_key_t key;
     pj_thread_t *dummy;
+    int rc;
 
-    rc = pj_thread_local_alloc(&thread_tls_id );
-    if (rc != PJ_SUCCESS) {
-	return rc;
-    }
-    return pj_thread_register("thr%p", (long*)&main_thread, &dummy);
+    if ((rc=pthread_key_create(&key, NULL)) != 0)
+	return PJ_RETURN_OS_ERROR(rc);
+
+    thread_tls_id = key;
+    return pj_thread_register("thr%p", main_thread, &dummy);
 #else
     PJ_LOG(2,(THIS_FILE, "Thread init error. Threading is not enabled!"));
     return PJ_EINVALIDOP;
@@ -542,6 +736,7 @@ static void *thread_main(void *param)
 
     /* Done. */
     PJ_LOG(6,(rec->obj_name, "Thread quitting"));
+    thread_exit_hook();
 
     return result;
 }
@@ -746,6 +941,12 @@ PJ_DEF(pj_status_t) pj_thread_destroy(pj_thread_t *p)
 {
     PJ_CHECK_STACK();
 
+#if PJ_HAS_THREADS
+    /* A thread destroying its own record is done with pjlib */
+    if (pthread_getspecific(thread_tls_id) == p)
+	thread_exit_hook();
+#endif
+
     /* Destroy mutex used to suspend thread */
     if (p->suspended_mutex) {
 	pj_mutex_destroy(p->suspended_mutex);
@@ -849,6 +1050,16 @@ PJ_DEF(pj_status_t) pj_thread_get_stack_info( pj_thread_t *thread,
 #endif	/* PJ_OS_HAS_CHECK_STACK */
 
 ///////////////////////////////////////////////////////////////////////////////
+/* Where the compiler provides atomic builtins, atomic variables don't need
+ * a mutex. This makes reference counting (e.g. pj_grp_lock_add_ref() and
+ * pj_grp_lock_dec_ref()) lock free.
+ */
+#if PJ_HAS_THREADS && defined(__GNUC__) && defined(__ATOMIC_SEQ_CST)
+#   define ATOMIC_HAS_BUILTINS	1
+#else
+#   define ATOMIC_HAS_BUILTINS	0
+#endif
+
 /*
  * pj_atomic_create()
  */
@@ -856,17 +1067,21 @@ PJ_DEF(pj_status_t) pj_atomic_create( pj_pool_t *pool,
 				      pj_atomic_value_t initial,
 				      pj_atomic_t **ptr_atomic)
 {
-    pj_status_t rc;
     pj_atomic_t *atomic_var;
 
     atomic_var = PJ_POOL_ZALLOC_T(pool, pj_atomic_t);
 
     PJ_ASSERT_RETURN(atomic_var, PJ_ENOMEM);
 
-#if PJ_HAS_THREADS
-    rc = pj_mutex_create(pool, "atm%p", PJ_MUTEX_SIMPLE, &atomic_var->mutex);
-    if (rc != PJ_SUCCESS)
-	return rc;
+#if PJ_HAS_THREADS && !ATOMIC_HAS_BUILTINS
+    {
+	pj_status_t rc;
+
+	rc = pj_mutex_create(pool, "atm%p", PJ_MUTEX_SIMPLE,
+			     &atomic_var->mutex);
+	if (rc != PJ_SUCCESS)
+	    return rc;
+    }
 #endif
     atomic_var->value = initial;
 
@@ -880,7 +1095,7 @@ PJ_DEF(pj_status_t) pj_atomic_create( pj_pool_t *pool,
 PJ_DEF(pj_status_t) pj_atomic_destroy( pj_atomic_t *atomic_var )
 {
     PJ_ASSERT_RETURN(atomic_var, PJ_EINVAL);
-#if PJ_HAS_THREADS
+#if PJ_HAS_THREADS && !ATOMIC_HAS_BUILTINS
     return pj_mutex_destroy( atomic_var->mutex );
 #else
     return 0;
@@ -894,6 +1109,9 @@ PJ_DEF(void) pj_atomic_set(pj_atomic_t *atomic_var, pj_atomic_value_t value)
 {
     PJ_CHECK_STACK();
 
+#if ATOMIC_HAS_BUILTINS
+    __atomic_store_n(&atomic_var->value, value, __ATOMIC_SEQ_CST);
+#else
 #if PJ_HAS_THREADS
     pj_mutex_lock( atomic_var->mutex );
 #endif
@@ -901,6 +1119,7 @@ PJ_DEF(void) pj_atomic_set(pj_atomic_t *atomic_var, pj_atomic_value_t value)
 #if PJ_HAS_THREADS
     pj_mutex_unlock( atomic_var->mutex);
 #endif
+#endif	/* ATOMIC_HAS_BUILTINS */
 }
 
 /*
@@ -912,6 +1131,9 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_get(pj_atomic_t *atomic_var)
 
     PJ_CHECK_STACK();
 
+#if ATOMIC_HAS_BUILTINS
+    oldval = __atomic_load_n(&atomic_var->value, __ATOMIC_SEQ_CST);
+#else
 #if PJ_HAS_THREADS
     pj_mutex_lock( atomic_var->mutex );
 #endif
@@ -919,6 +1141,7 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_get(pj_atomic_t *atomic_var)
 #if PJ_HAS_THREADS
     pj_mutex_unlock( atomic_var->mutex);
 #endif
+#endif	/* ATOMIC_HAS_BUILTINS */
     return oldval;
 }
 
@@ -927,19 +1150,9 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_get(pj_atomic_t *atomic_var)
  */
 PJ_DEF(pj_atomic_value_t) pj_atomic_inc_and_get(pj_atomic_t *atomic_var)
 {
-    pj_atomic_value_t new_value;
-
     PJ_CHECK_STACK();
 
-#if PJ_HAS_THREADS
-    pj_mutex_lock( atomic_var->mutex );
-#endif
-    new_value = ++atomic_var->value;
-#if PJ_HAS_THREADS
-    pj_mutex_unlock( atomic_var->mutex);
-#endif
-
-    return new_value;
+    return pj_atomic_add_and_get(atomic_var, 1);
 }
 /*
  * pj_atomic_inc()
@@ -954,19 +1167,9 @@ PJ_DEF(void) pj_atomic_inc(pj_atomic_t *atomic_var)
  */
 PJ_DEF(pj_atomic_value_t) pj_atomic_dec_and_get(pj_atomic_t *atomic_var)
 {
-    pj_atomic_value_t new_value;
-
     PJ_CHECK_STACK();
 
-#if PJ_HAS_THREADS
-    pj_mutex_lock( atomic_var->mutex );
-#endif
-    new_value = --atomic_var->value;
-#if PJ_HAS_THREADS
-    pj_mutex_unlock( atomic_var->mutex);
-#endif
-
-    return new_value;
+    return pj_atomic_add_and_get(atomic_var, -1);
 }
 
 /*
@@ -985,6 +1188,10 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_add_and_get( pj_atomic_t *atomic_var,
 {
     pj_atomic_value_t new_value;
 
+#if ATOMIC_HAS_BUILTINS
+    new_value = __atomic_add_fetch(&atomic_var->value, value,
+				   __ATOMIC_SEQ_CST);
+#else
 #if PJ_HAS_THREADS
     pj_mutex_lock(atomic_var->mutex);
 #endif
@@ -995,6 +1202,7 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_add_and_get( pj_atomic_t *atomic_var,
 #if PJ_HAS_THREADS
     pj_mutex_unlock(atomic_var->mutex);
 #endif
+#endif	/* ATOMIC_HAS_BUILTINS */
 
     return new_value;
 }
@@ -1013,6 +1221,15 @@ PJ_DEF(void) pj_atomic_add( pj_atomic_t *atomic_var,
  * pj_thread_local_alloc()
  */
 PJ_DEF(pj_status_t) pj_thread_local_alloc(long *p_index)
+{
+    return pj_thread_local_alloc2(p_index, NULL);
+}
+
+/*
+ * pj_thread_local_alloc2()
+ */
+PJ_DEF(pj_status_t) pj_thread_local_alloc2(long *p_index,
+					   void (*dtor)(void *value))
 {
 #if PJ_HAS_THREADS
     pthread_key_t key;
@@ -1024,10 +1241,28 @@ PJ_DEF(pj_status_t) pj_thread_local_alloc(long *p_index)
     if ((rc=pthread_key_create(&key, NULL)) != 0)
 	return PJ_RETURN_OS_ERROR(rc);
 
+    if (dtor) {
+	/* Called by thread_exit_hook() */
+	pj_enter_critical_section();
+	if (tls_dtor_cnt == MAX_TLS_DTOR) {
+	    pj_leave_critical_section();
+	    pthread_key_delete(key);
+	    return PJ_ETOOMANY;
+	}
+	tls_dtors[tls_dtor_cnt].index = key;
+	tls_dtors[tls_dtor_cnt].dtor = dtor;
+	++tls_dtor_cnt;
+	pj_leave_critical_section();
+    }
+
     *p_index = key;
     return PJ_SUCCESS;
 #else
     int i;
+
+    /* There are no other threads to exit */
+    PJ_UNUSED_ARG(dtor);
+
     for (i=0; i<MAX_THREADS; ++i) {
 	if (tls_flag[i] == 0)
 	    break;
@@ -1050,6 +1285,18 @@ PJ_DEF(void) pj_thread_local_free(long index)
 {
     PJ_CHECK_STACK();
 #if PJ_HAS_THREADS
+    if (tls_dtor_cnt) {
+	unsigned i;
+
+	pj_enter_critical_section();
+	for (i=0; i<tls_dtor_cnt; ++i) {
+	    if (tls_dtors[i].index == index) {
+		tls_dtors[i] = tls_dtors[--tls_dtor_cnt];
+		break;
+	    }
+	}
+	pj_leave_critical_section();
+    }
     pthread_key_delete(index);
 #else
     tls_flag[index] = 0;
@@ -359,6 +359,79 @@ PJ_DEF(int) pj_thread_get_prio_max(pj_thread_t *thread)
 }
 
 
+/*
+ * Set the thread scheduling policy and priority.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_sched(pj_thread_t *thread,
+					pj_thread_sched_policy policy,
+					int prio)
+{
+    /* Windows has no scheduling policies */
+    if (policy != PJ_THREAD_SCHED_DEFAULT)
+	return PJ_ENOTSUP;
+
+    return pj_thread_set_prio(thread, prio);
+}
+
+
+/*
+ * Set the CPUs the thread may run on.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread,
+					   unsigned cpu_cnt,
+					   const unsigned cpu[])
+{
+    PJ_ASSERT_RETURN(thread && (cpu_cnt == 0 || cpu), PJ_EINVAL);
+
+#if PJ_HAS_THREADS && !(defined(PJ_WIN32_WINCE) && PJ_WIN32_WINCE) && \
+    !(defined(PJ_WIN32_WINPHONE8) && PJ_WIN32_WINPHONE8)
+    {
+	DWORD_PTR mask = 0;
+	unsigned i;
+
+	if (cpu_cnt == 0) {
+	    DWORD_PTR sys_mask;
+
+	    if (!GetProcessAffinityMask(GetCurrentProcess(), &mask,
+					&sys_mask))
+	    {
+		return PJ_RETURN_OS_ERROR(GetLastError());
+	    }
+	} else {
+	    for (i=0; i<cpu_cnt; ++i) {
+		PJ_ASSERT_RETURN(cpu[i] < sizeof(mask) * 8, PJ_EINVAL);
+		mask |= ((DWORD_PTR)1) << cpu[i];
+	    }
+	}
+
+	if (SetThreadAffinityMask(thread->hthread, mask) == 0)
+	    return PJ_RETURN_OS_ERROR(GetLastError());
+
+	return PJ_SUCCESS;
+    }
+#else
+    PJ_UNUSED_ARG(cpu_cnt);
+    PJ_UNUSED_ARG(cpu);
+    return PJ_ENOTSUP;
+#endif
+}
+
+
+/*
+ * Get the CPUs of a NUMA node.
+ */
+PJ_DEF(pj_status_t) pj_get_numa_node_cpus(unsigned node,
+					  unsigned *cpu_cnt,
+					  unsigned cpu[])
+{
+    PJ_ASSERT_RETURN(cpu_cnt && cpu, PJ_EINVAL);
+    PJ_UNUSED_ARG(node);
+
+    *cpu_cnt = 0;
+    return PJ_ENOTSUP;
+}
+
+
 /*
  * Get native thread handle
  */
@@ -861,6 +934,19 @@ PJ_DEF(pj_status_t) pj_thread_local_alloc(long *index)
         return PJ_SUCCESS;
 }
 
+/*
+ * pj_thread_local_alloc2()
+ */
+PJ_DEF(pj_status_t) pj_thread_local_alloc2(long *index,
+					   void (*dtor)(void *value))
+{
+    /* Destructor is not supported */
+    if (dtor)
+	return PJ_ENOTSUP;
+
+    return pj_thread_local_alloc(index);
+}
+
 /*
  * pj_thread_local_free()
  */
@@ -202,5 +202,76 @@ PJ_DEF(pj_status_t) pj_gettickcount(pj_time_val *tv)
     return PJ_SUCCESS;
 }
 
+/* Cached tick count in msec plus one, zero if it has not been set. The
+ * compiler builtins are used where available, so that the 64bit accesses
+ * are atomic on 32bit platforms as well.
+ *
+ * This is deliberately process-wide (see pj_gettickcount_cached()): the
+ * value is only written when it advances, so polling threads of several
+ * ioqueues don't fight over the cache line.
+ */
+#if defined(PJ_HAS_INT64) && PJ_HAS_INT64!=0
+
+static pj_uint64_t cached_tick;
+
+#if defined(__GNUC__) && defined(__ATOMIC_RELAXED)
+#   define LOAD_TICK()		__atomic_load_n(&cached_tick, __ATOMIC_RELAXED)
+#   define CAS_TICK(pold,new)	__atomic_compare_exchange_n(&cached_tick, \
+					pold, new, 1, __ATOMIC_RELAXED, \
+					__ATOMIC_RELAXED)
+#else
+#   define LOAD_TICK()		(*(volatile pj_uint64_t*)&cached_tick)
+#   define CAS_TICK(pold,new)	(cached_tick = new, 1)
+#endif
+
+PJ_DEF(void) pj_gettickcount_update_cache(const pj_time_val *now)
+{
+    pj_time_val tv;
+    pj_uint64_t msec, old;
+
+    if (!now) {
+	pj_gettickcount_coarse(&tv);
+	now = &tv;
+    }
+
+    /* Add one so that time zero is distinguishable from an unset cache */
+    msec = (pj_uint64_t)now->sec * MSEC + now->msec + 1;
+
+    old = LOAD_TICK();
+    while (msec > old) {
+	if (CAS_TICK(&old, msec))
+	    break;
+    }
+}
+
+PJ_DEF(void) pj_gettickcount_cached(pj_time_val *tv)
+{
+    pj_uint64_t msec = LOAD_TICK();
+
+    if (msec == 0) {
+	pj_gettickcount_coarse(tv);
+	pj_gettickcount_update_cache(tv);
+	return;
+    }
+
+    --msec;
+    tv->sec = (long)(msec / MSEC);
+    tv->msec = (long)(msec % MSEC);
+}
+
+#else
+
+PJ_DEF(void) pj_gettickcount_update_cache(const pj_time_val *now)
+{
+    PJ_UNUSED_ARG(now);
+}
+
+PJ_DEF(void) pj_gettickcount_cached(pj_time_val *tv)
+{
+    pj_gettickcount_coarse(tv);
+}
+
+#endif	/* PJ_HAS_INT64 */
+
 #endif  /* PJ_HAS_HIGH_RES_TIMER */
 
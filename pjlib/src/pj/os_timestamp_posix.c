@@ -239,6 +239,11 @@ PJ_DEF(pj_status_t) pj_get_timestamp_freq(pj_timestamp *freq)
 
 #define NSEC_PER_SEC	1000000000
 
+/* Same clock as CLOCK_MONOTONIC, read from the vDSO at tick resolution */
+#if defined(CLOCK_MONOTONIC_COARSE)
+#   define HAS_MONOTONIC_COARSE	1
+#endif
+
 PJ_DEF(pj_status_t) pj_get_timestamp(pj_timestamp *ts)
 {
     struct timespec tp;
@@ -292,3 +297,23 @@ PJ_DEF(pj_status_t) pj_get_timestamp_freq(pj_timestamp *freq)
 }
 
 #endif
+
+
+#if defined(HAS_MONOTONIC_COARSE)
+PJ_DEF(pj_status_t) pj_gettickcount_coarse(pj_time_val *tv)
+{
+    struct timespec tp;
+
+    if (clock_gettime(CLOCK_MONOTONIC_COARSE, &tp) != 0)
+	return pj_gettickcount(tv);
+
+    tv->sec = tp.tv_sec;
+    tv->msec = tp.tv_nsec / 1000000;
+    return PJ_SUCCESS;
+}
+#else
+PJ_DEF(pj_status_t) pj_gettickcount_coarse(pj_time_val *tv)
+{
+    return pj_gettickcount(tv);
+}
+#endif
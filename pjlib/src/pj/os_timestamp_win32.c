@@ -293,3 +293,8 @@ PJ_DEF(pj_status_t) pj_get_timestamp_freq(pj_timestamp *freq)
 
 #endif	/* PJ_TIMESTAMP_USE_RDTSC */
 
+
+PJ_DEF(pj_status_t) pj_gettickcount_coarse(pj_time_val *tv)
+{
+    return pj_gettickcount(tv);
+}
@@ -139,6 +139,9 @@ PJ_DEF(void*) pj_pool_allocate_find(pj_pool_t *pool, pj_size_t size)
     if (!block)
 	return NULL;
 
+    if (pool->prof)
+	pj_pool_prof_on_resize(pool, pool->capacity - block_size);
+
     p = pj_pool_alloc_from_block(block, size);
     pj_assert(p != NULL);
 #if PJ_DEBUG
@@ -161,6 +164,7 @@ PJ_DEF(void) pj_pool_init_int(  pj_pool_t *pool,
 
     pool->increment_size = increment_size;
     pool->callback = callback;
+    pool->prof = NULL;
 
     if (name) {
 	if (strchr(name, '%') != NULL) {
@@ -273,7 +277,13 @@ PJ_DEF(void) pj_pool_reset(pj_pool_t *pool)
 	pool->capacity, pj_pool_get_used_size(pool), 
 	pj_pool_get_used_size(pool)*100/pool->capacity));
 
-    reset_pool(pool);
+    if (pool->prof) {
+	pj_size_t old_capacity = pool->capacity;
+	reset_pool(pool);
+	pj_pool_prof_on_resize(pool, old_capacity);
+    } else {
+	reset_pool(pool);
+    }
 }
 
 /*
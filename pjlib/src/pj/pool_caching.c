@@ -24,6 +24,8 @@
 #include <pj/lock.h>
 #include <pj/os.h>
 #include <pj/pool_buf.h>
+#include <pj/ctype.h>
+#include <pj/errno.h>
 
 #if !PJ_HAS_POOL_ALT_API
 
@@ -36,6 +38,33 @@ static void cpool_release_pool(pj_pool_factory *pf, pj_pool_t *pool);
 static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail );
 static pj_bool_t cpool_on_block_alloc(pj_pool_factory *f, pj_size_t sz);
 static void cpool_on_block_free(pj_pool_factory *f, pj_size_t sz);
+static void prof_on_create(struct pj_pool_prof *prof, pj_pool_t *pool);
+static void prof_on_release(pj_pool_t *pool);
+
+/* Pool profiler, see pj_caching_pool_prof_start() */
+struct pj_pool_prof_class
+{
+    pj_pool_prof_stat	stat;
+};
+
+typedef struct prof_site
+{
+    void			*addr;
+    struct pj_pool_prof_class	*cls;
+    unsigned			 cnt;
+    pj_size_t			 size;
+} prof_site;
+
+struct pj_pool_prof
+{
+    pj_bool_t			 running;
+    pj_bool_t			 sites;
+    unsigned			 class_cnt;
+    struct pj_pool_prof_class	 cls[PJ_POOL_PROF_MAX_CLASSES];
+    unsigned			 site_cnt;
+    unsigned			 site_dropped;
+    prof_site			 site[PJ_POOL_PROF_MAX_SITES];
+};
 
 
 static pj_size_t pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE] = 
@@ -114,6 +143,12 @@ PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
 	pj_lock_destroy(cp->lock);
 	pj_lock_create_null_mutex(NULL, "cachingpool", &cp->lock);
     }
+
+    if (cp->prof) {
+	(*cp->factory.policy.block_free)(&cp->factory, cp->prof,
+					 sizeof(*cp->prof));
+	cp->prof = NULL;
+    }
 }
 
 static pj_pool_t* cpool_create_pool(pj_pool_factory *pf, 
@@ -193,6 +228,10 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
     /* Mark factory data */
     pool->factory_data = (void*) (pj_ssize_t) idx;
 
+    /* Account the pool in the profiler */
+    if (cp->prof && cp->prof->running)
+	prof_on_create(cp->prof, pool);
+
     /* Increment used count. */
     ++cp->used_count;
 
@@ -223,6 +262,11 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
     /* Erase from the used list. */
     pj_list_erase(pool);
 
+    if (pool->prof) {
+	prof_on_release(pool);
+	pool->prof = NULL;
+    }
+
     /* Decrement used count. */
     --cp->used_count;
 
@@ -334,5 +378,378 @@ static void cpool_on_block_free(pj_pool_factory *f, pj_size_t sz)
 }
 
 
+/*
+ * Pool profiler.
+ */
+
+/* Find or add the class for the pool name. Caching pool lock is held. */
+static struct pj_pool_prof_class *prof_get_class(struct pj_pool_prof *prof,
+						 const char *name)
+{
+    char prefix[PJ_POOL_PROF_NAME_LEN];
+    unsigned i, len;
+
+    for (len=0; len < sizeof(prefix)-1 && name[len] &&
+		!pj_isdigit(name[len]) && name[len] != '%'; ++len)
+    {
+	prefix[len] = name[len];
+    }
+    prefix[len] = '\0';
+    if (len == 0)
+	pj_ansi_strcpy(prefix, "(none)");
+
+    for (i=0; i<prof->class_cnt; ++i) {
+	if (pj_ansi_strcmp(prof->cls[i].stat.name, prefix) == 0)
+	    return &prof->cls[i];
+    }
+
+    if (prof->class_cnt < PJ_POOL_PROF_MAX_CLASSES - 1) {
+	struct pj_pool_prof_class *cls = &prof->cls[prof->class_cnt++];
+	pj_ansi_strcpy(cls->stat.name, prefix);
+	return cls;
+    }
+
+    /* The last class collects the rest */
+    if (prof->class_cnt == PJ_POOL_PROF_MAX_CLASSES - 1) {
+	pj_ansi_strcpy(prof->cls[prof->class_cnt].stat.name, "(other)");
+	++prof->class_cnt;
+    }
+    return &prof->cls[PJ_POOL_PROF_MAX_CLASSES - 1];
+}
+
+/* Add capacity to the class. Caching pool lock is held. */
+static void prof_add_capacity(struct pj_pool_prof_class *cls,
+			      pj_size_t added, pj_size_t removed)
+{
+    cls->stat.capacity += added;
+    cls->stat.capacity -= removed;
+    if (cls->stat.capacity > cls->stat.peak_capacity)
+	cls->stat.peak_capacity = cls->stat.capacity;
+}
+
+/* New pool is created. Caching pool lock is held. */
+static void prof_on_create(struct pj_pool_prof *prof, pj_pool_t *pool)
+{
+    struct pj_pool_prof_class *cls;
+
+    cls = prof_get_class(prof, pool->obj_name);
+    ++cls->stat.created;
+    if (++cls->stat.pool_cnt > cls->stat.peak_pool_cnt)
+	cls->stat.peak_pool_cnt = cls->stat.pool_cnt;
+    prof_add_capacity(cls, pool->capacity, 0);
+
+    pool->prof = cls;
+}
+
+/* Pool is released. Caching pool lock is held. */
+static void prof_on_release(pj_pool_t *pool)
+{
+    struct pj_pool_prof_class *cls = pool->prof;
+    pj_size_t used = pj_pool_get_used_size(pool);
+
+    --cls->stat.pool_cnt;
+    prof_add_capacity(cls, 0, pool->capacity);
+    if (pool->capacity > cls->stat.max_pool_capacity)
+	cls->stat.max_pool_capacity = pool->capacity;
+    if (used > cls->stat.max_pool_used)
+	cls->stat.max_pool_used = used;
+}
+
+/* Sample the used size of the pools alive. Caching pool lock is held. */
+static void prof_sample(pj_caching_pool *cp)
+{
+    struct pj_pool_prof *prof = cp->prof;
+    pj_pool_t *pool;
+    unsigned i;
+
+    for (i=0; i<prof->class_cnt; ++i)
+	prof->cls[i].stat.used = 0;
+
+    pool = (pj_pool_t*) cp->used_list.next;
+    for (; pool != (void*)&cp->used_list; pool = pool->next) {
+	struct pj_pool_prof_class *cls = pool->prof;
+	pj_size_t used;
+
+	if (!cls)
+	    continue;
+
+	used = pj_pool_get_used_size(pool);
+	cls->stat.used += used;
+	if (pool->capacity > cls->stat.max_pool_capacity)
+	    cls->stat.max_pool_capacity = pool->capacity;
+	if (used > cls->stat.max_pool_used)
+	    cls->stat.max_pool_used = used;
+    }
+}
+
+/* Stop the profiler. Caching pool lock is held. */
+static void prof_stop(pj_caching_pool *cp)
+{
+    pj_pool_t *pool;
+
+    /* Keep the last sample of the pools alive and detach them */
+    prof_sample(cp);
+    pool = (pj_pool_t*) cp->used_list.next;
+    for (; pool != (void*)&cp->used_list; pool = pool->next)
+	pool->prof = NULL;
+
+    cp->prof->running = PJ_FALSE;
+    cp->prof->sites = PJ_FALSE;
+}
+
+PJ_DEF(void) pj_pool_prof_on_resize( pj_pool_t *pool,
+				     pj_size_t old_capacity )
+{
+    pj_caching_pool *cp = (pj_caching_pool*) pool->factory;
+
+    pj_lock_acquire(cp->lock);
+    /* Profiler may have been stopped in the mean time */
+    if (pool->prof)
+	prof_add_capacity(pool->prof, pool->capacity, old_capacity);
+    pj_lock_release(cp->lock);
+}
+
+PJ_DEF(void) pj_pool_prof_on_alloc( pj_pool_t *pool, pj_size_t size,
+				    void *site )
+{
+    pj_caching_pool *cp = (pj_caching_pool*) pool->factory;
+    struct pj_pool_prof *prof = cp->prof;
+    struct pj_pool_prof_class *cls;
+    unsigned i, n;
+
+    if (!prof->sites)
+	return;
+
+    pj_lock_acquire(cp->lock);
+
+    cls = pool->prof;
+    if (!cls || !prof->sites) {
+	pj_lock_release(cp->lock);
+	return;
+    }
+
+    ++cls->stat.alloc_cnt;
+    cls->stat.alloc_size += size;
+
+    /* Open addressing on the site address and class */
+    i = (unsigned)(((pj_size_t)site >> 2) ^ (pj_size_t)(cls - prof->cls)) %
+	PJ_POOL_PROF_MAX_SITES;
+    for (n=0; n<PJ_POOL_PROF_MAX_SITES; ++n) {
+	prof_site *ps = &prof->site[i];
+
+	if (ps->cls == NULL) {
+	    ps->addr = site;
+	    ps->cls = cls;
+	    ++prof->site_cnt;
+	}
+	if (ps->addr == site && ps->cls == cls) {
+	    ++ps->cnt;
+	    ps->size += size;
+	    break;
+	}
+	i = (i + 1) % PJ_POOL_PROF_MAX_SITES;
+    }
+    if (n == PJ_POOL_PROF_MAX_SITES)
+	++prof->site_dropped;
+
+    pj_lock_release(cp->lock);
+}
+
+PJ_DEF(pj_status_t) pj_caching_pool_prof_start( pj_caching_pool *cp,
+						pj_bool_t sites )
+{
+    PJ_ASSERT_RETURN(cp, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cp->factory.create_pool == &cpool_create_pool,
+		     PJ_EINVALIDOP);
+
+    pj_lock_acquire(cp->lock);
+
+    if (cp->prof == NULL) {
+	cp->prof = (struct pj_pool_prof*)
+		   (*cp->factory.policy.block_alloc)(&cp->factory,
+						     sizeof(*cp->prof));
+	if (cp->prof == NULL) {
+	    pj_lock_release(cp->lock);
+	    return PJ_ENOMEM;
+	}
+    } else if (cp->prof->running) {
+	prof_stop(cp);
+    }
+
+    /* Pools which are still linked to the old classes are not profiled
+     * anymore, as the profiler has been stopped above.
+     */
+    pj_bzero(cp->prof, sizeof(*cp->prof));
+    cp->prof->sites = sites;
+    cp->prof->running = PJ_TRUE;
+
+    pj_lock_release(cp->lock);
+
+    PJ_LOG(4,("cachpool", "Pool profiler started%s",
+	      (sites ? " with allocation sites" : "")));
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_caching_pool_prof_stop( pj_caching_pool *cp )
+{
+    PJ_ASSERT_ON_FAIL(cp, return);
+
+    pj_lock_acquire(cp->lock);
+    if (cp->prof && cp->prof->running)
+	prof_stop(cp);
+    pj_lock_release(cp->lock);
+}
+
+PJ_DEF(pj_status_t) pj_caching_pool_prof_get_stat( pj_caching_pool *cp,
+						   pj_pool_prof_stat stat[],
+						   unsigned *count )
+{
+    struct pj_pool_prof *prof;
+    unsigned i, j, n = 0;
+
+    PJ_ASSERT_RETURN(cp && stat && count, PJ_EINVAL);
+
+    pj_lock_acquire(cp->lock);
+
+    prof = cp->prof;
+    if (!prof) {
+	pj_lock_release(cp->lock);
+	*count = 0;
+	return PJ_EINVALIDOP;
+    }
+
+    if (prof->running)
+	prof_sample(cp);
+
+    /* Insertion sort by capacity, then by peak capacity */
+    for (i=0; i<prof->class_cnt; ++i) {
+	const pj_pool_prof_stat *st = &prof->cls[i].stat;
+
+	for (j=n; j>0; --j) {
+	    if (stat[j-1].capacity > st->capacity ||
+		(stat[j-1].capacity == st->capacity &&
+		 stat[j-1].peak_capacity >= st->peak_capacity))
+	    {
+		break;
+	    }
+	    if (j < *count)
+		stat[j] = stat[j-1];
+	}
+	if (j < *count) {
+	    stat[j] = *st;
+	    if (n < *count)
+		++n;
+	}
+    }
+
+    pj_lock_release(cp->lock);
+
+    *count = n;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_caching_pool_prof_get_sites( pj_caching_pool *cp,
+						    pj_pool_prof_site site[],
+						    unsigned *count )
+{
+    struct pj_pool_prof *prof;
+    unsigned i, j, n = 0;
+
+    PJ_ASSERT_RETURN(cp && site && count, PJ_EINVAL);
+
+    pj_lock_acquire(cp->lock);
+
+    prof = cp->prof;
+    if (!prof) {
+	pj_lock_release(cp->lock);
+	*count = 0;
+	return PJ_EINVALIDOP;
+    }
+
+    /* Insertion sort by total size */
+    for (i=0; i<PJ_POOL_PROF_MAX_SITES; ++i) {
+	const prof_site *ps = &prof->site[i];
+
+	if (!ps->cls)
+	    continue;
+
+	for (j=n; j>0 && site[j-1].size < ps->size; --j) {
+	    if (j < *count)
+		site[j] = site[j-1];
+	}
+	if (j < *count) {
+	    site[j].addr = ps->addr;
+	    pj_ansi_strcpy(site[j].name, ps->cls->stat.name);
+	    site[j].cnt = ps->cnt;
+	    site[j].size = ps->size;
+	    if (n < *count)
+		++n;
+	}
+    }
+
+    pj_lock_release(cp->lock);
+
+    *count = n;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_caching_pool_prof_dump( pj_caching_pool *cp,
+					pj_bool_t detail )
+{
+#if PJ_LOG_MAX_LEVEL >= 3
+    pj_pool_prof_stat stat[PJ_POOL_PROF_MAX_CLASSES];
+    pj_pool_prof_site site[20];
+    unsigned i, cnt = PJ_ARRAY_SIZE(stat);
+
+    PJ_ASSERT_ON_FAIL(cp, return);
+
+    if (pj_caching_pool_prof_get_stat(cp, stat, &cnt) != PJ_SUCCESS) {
+	PJ_LOG(3,("cachpool", " Pool profiler has not been started"));
+	return;
+    }
+
+    PJ_LOG(3,("cachpool", " Pool profiler (%s), sizes in bytes:",
+	      (cp->prof->running ? "running" : "stopped")));
+    PJ_LOG(3,("cachpool", "  %-15s %6s %6s %8s %9s %9s %9s %9s %8s %8s",
+	      "prefix", "pools", "peak", "created", "capacity", "used",
+	      "wasted", "peak_cap", "max_cap", "max_used"));
+    for (i=0; i<cnt; ++i) {
+	PJ_LOG(3,("cachpool", "  %-15s %6u %6u %8u %9u %9u %9u %9u %8u %8u",
+		  stat[i].name, stat[i].pool_cnt, stat[i].peak_pool_cnt,
+		  stat[i].created, (unsigned)stat[i].capacity,
+		  (unsigned)stat[i].used,
+		  (unsigned)(stat[i].capacity > stat[i].used ?
+			     stat[i].capacity - stat[i].used : 0),
+		  (unsigned)stat[i].peak_capacity,
+		  (unsigned)stat[i].max_pool_capacity,
+		  (unsigned)stat[i].max_pool_used));
+    }
+
+    if (!detail)
+	return;
+
+    cnt = PJ_ARRAY_SIZE(site);
+    pj_caching_pool_prof_get_sites(cp, site, &cnt);
+    if (cnt == 0) {
+	PJ_LOG(3,("cachpool", "  No allocation sites recorded"));
+	return;
+    }
+
+    PJ_LOG(3,("cachpool", "  Top allocation sites:"));
+    for (i=0; i<cnt; ++i) {
+	PJ_LOG(3,("cachpool", "   %-18p %-15s %8u allocs %10u bytes",
+		  site[i].addr, site[i].name, site[i].cnt,
+		  (unsigned)site[i].size));
+    }
+    if (cp->prof->site_dropped) {
+	PJ_LOG(3,("cachpool", "  %u allocations not recorded, site table "
+		  "is full", cp->prof->site_dropped));
+    }
+#else
+    PJ_UNUSED_ARG(cp);
+    PJ_UNUSED_ARG(detail);
+#endif
+}
+
 #endif	/* PJ_HAS_POOL_ALT_API */
 
@@ -21,6 +21,112 @@
 #include <pj/os.h>
 #include <pj/compat/rand.h>
 
+#if defined(PJ_THREAD_LOCAL_SPECIFIER) && defined(PJ_HAS_INT64) && \
+    PJ_HAS_INT64!=0 && defined(PJ_HAS_HIGH_RES_TIMER) && \
+    PJ_HAS_HIGH_RES_TIMER!=0
+
+/*
+ * Per-thread xoshiro256** generator (by David Blackman and Sebastiano
+ * Vigna, public domain). It is not suitable for cryptographic purposes,
+ * but it's fast, has good statistical quality, and since each thread has
+ * its own state, it needs no locking.
+ */
+typedef struct rand_state
+{
+    pj_uint64_t	s[4];
+    unsigned	gen;	    /* Seed generation of the state	*/
+} rand_state;
+
+static PJ_THREAD_LOCAL_SPECIFIER rand_state tls_state;
+
+/* Seed and seed generation, updated by pj_srand(). Threads reinitialize
+ * their state when the generation changes.
+ */
+static pj_uint64_t global_seed;
+static volatile unsigned seed_gen = 1;
+
+static pj_uint64_t splitmix64(pj_uint64_t *x)
+{
+    pj_uint64_t z = (*x += PJ_UINT64(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * PJ_UINT64(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * PJ_UINT64(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+static void seed_state(rand_state *st, pj_uint64_t seed)
+{
+    st->s[0] = splitmix64(&seed);
+    st->s[1] = splitmix64(&seed);
+    st->s[2] = splitmix64(&seed);
+    st->s[3] = splitmix64(&seed);
+}
+
+#define ROTL(x,k)	(((x) << (k)) | ((x) >> (64 - (k))))
+
+static pj_uint64_t next_rand(rand_state *st)
+{
+    const pj_uint64_t result = ROTL(st->s[1] * 5, 7) * 9;
+    const pj_uint64_t t = st->s[1] << 17;
+
+    st->s[2] ^= st->s[0];
+    st->s[3] ^= st->s[1];
+    st->s[1] ^= st->s[2];
+    st->s[0] ^= st->s[3];
+    st->s[2] ^= t;
+    st->s[3] = ROTL(st->s[3], 45);
+
+    return result;
+}
+
+static rand_state *get_state(void)
+{
+    rand_state *st = &tls_state;
+
+    if (st->gen != seed_gen) {
+	/* First use in this thread or the generator has been reseeded.
+	 * The address of the state is unique among the running threads,
+	 * and the timestamp separates threads which reuse the address.
+	 */
+	pj_timestamp ts;
+	pj_uint64_t seed = (pj_uint64_t)(pj_size_t)st;
+
+	pj_get_timestamp(&ts);
+	seed = splitmix64(&seed) ^ ts.u64 ^ global_seed;
+	st->gen = seed_gen;
+	seed_state(st, seed);
+    }
+
+    return st;
+}
+
+PJ_DEF(void) pj_srand(unsigned int seed)
+{
+    rand_state *st = &tls_state;
+
+    PJ_CHECK_STACK();
+
+    global_seed = seed;
+    ++seed_gen;
+    if (seed_gen == 0)
+	++seed_gen;
+
+    /* The calling thread gets a sequence which only depends on the seed */
+    st->gen = seed_gen;
+    seed_state(st, seed);
+}
+
+PJ_DEF(int) pj_rand(void)
+{
+    PJ_CHECK_STACK();
+
+    /* Use the high bits, which are the best ones, and keep the result
+     * positive like rand() does.
+     */
+    return (int)(next_rand(get_state()) >> 33);
+}
+
+#else
+
 PJ_DEF(void) pj_srand(unsigned int seed)
 {
     PJ_CHECK_STACK();
@@ -33,3 +139,4 @@ PJ_DEF(int) pj_rand(void)
     return platform_rand();
 }
 
+#endif	/* PJ_THREAD_LOCAL_SPECIFIER */
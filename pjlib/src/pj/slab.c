@@ -0,0 +1,435 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/slab.h>
+#include <pj/assert.h>
+#include <pj/atomic.h>
+#include <pj/errno.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/string.h>
+
+#define THIS_FILE	"slab.c"
+
+/* Alignment of the objects */
+#define SLAB_ALIGN	8
+
+#if defined(PJ_THREAD_LOCAL_SPECIFIER) && PJ_HAS_THREADS && \
+    PJ_SLAB_THREAD_CACHE_SIZE > 0
+#   define HAS_THREAD_CACHE	1
+#else
+#   define HAS_THREAD_CACHE	0
+#endif
+
+/* Free objects are linked through their first word */
+typedef struct free_obj
+{
+    struct free_obj *next;
+} free_obj;
+
+struct pj_slab_t
+{
+    char	     obj_name[PJ_MAX_OBJ_NAME];
+    pj_pool_t	    *pool;
+    pj_mutex_t	    *mutex;
+
+    /* Number of allocated objects, plus one until the slab is destroyed */
+    pj_atomic_t	    *ref_cnt;
+
+    /* Unique number of this slab, see get_cache() */
+    unsigned	     gen;
+
+    /* Next slab in the list of slabs which haven't been released */
+    pj_slab_t	    *next;
+
+    pj_size_t	     obj_size;
+    unsigned	     obj_per_chunk;
+    unsigned	     capacity;
+    unsigned	     peak;
+    free_obj	    *free_list;
+};
+
+/* Generation counter to tell apart slabs created at the same address, and
+ * the slabs which haven't been released. Both are protected by the pjlib
+ * critical section.
+ */
+static unsigned slab_gen;
+static pj_slab_t *slab_list;
+
+/* Put an object to the free list. Slab mutex must be held. */
+static void put_free(pj_slab_t *slab, free_obj *obj)
+{
+    obj->next = slab->free_list;
+    slab->free_list = obj;
+}
+
+#if HAS_THREAD_CACHE
+typedef struct thread_cache
+{
+    unsigned	     gen;
+    unsigned	     cnt;
+    free_obj	    *obj[PJ_SLAB_THREAD_CACHE_SIZE];
+} thread_cache;
+
+static PJ_THREAD_LOCAL_SPECIFIER thread_cache tls_cache[
+						PJ_SLAB_THREAD_CACHE_SLOTS];
+
+/* TLS index to flush the caches of a thread when it exits. The caches are
+ * disabled if this can't be done on the platform.
+ */
+static long cache_tls_id = -1;
+static pj_bool_t cache_disabled;
+
+/* Give the objects in the cache back to their slab. Objects don't keep
+ * the slab alive, so the slab is looked up by its generation first; if it
+ * has been released, so have the objects.
+ */
+static void flush_cache(thread_cache *tc)
+{
+    pj_slab_t *slab;
+
+    if (tc->cnt == 0)
+	return;
+
+    pj_enter_critical_section();
+    for (slab = slab_list; slab; slab = slab->next) {
+	if (slab->gen == tc->gen)
+	    break;
+    }
+    if (slab) {
+	pj_mutex_lock(slab->mutex);
+	while (tc->cnt)
+	    put_free(slab, tc->obj[--tc->cnt]);
+	pj_mutex_unlock(slab->mutex);
+    }
+    pj_leave_critical_section();
+
+    tc->cnt = 0;
+}
+
+/* Called by a thread which exits */
+static void flush_thread_caches(void *value)
+{
+    thread_cache *caches = (thread_cache*) value;
+    unsigned i;
+
+    for (i=0; i<PJ_SLAB_THREAD_CACHE_SLOTS; ++i)
+	flush_cache(&caches[i]);
+}
+
+static void cache_tls_shutdown(void)
+{
+    pj_thread_local_free(cache_tls_id);
+    cache_tls_id = -1;
+    cache_disabled = PJ_FALSE;
+}
+
+/* Called when a slab is created */
+static void cache_tls_init(void)
+{
+    pj_status_t status;
+
+    if (cache_tls_id != -1 || cache_disabled)
+	return;
+
+    status = pj_thread_local_alloc2(&cache_tls_id, &flush_thread_caches);
+    if (status == PJ_SUCCESS) {
+	pj_atexit(&cache_tls_shutdown);
+    } else {
+	PJ_PERROR(4,(THIS_FILE, status, "Slab thread cache is disabled"));
+	cache_tls_id = -1;
+	cache_disabled = PJ_TRUE;
+    }
+}
+
+/* Get the cache of the calling thread for the slab, or NULL if the caches
+ * are disabled.
+ */
+static thread_cache *get_cache(pj_slab_t *slab)
+{
+    thread_cache *tc;
+
+    if (cache_disabled)
+	return NULL;
+
+    tc = &tls_cache[slab->gen % PJ_SLAB_THREAD_CACHE_SLOTS];
+    if (tc->gen != slab->gen) {
+	/* The slot was unused or used by another slab */
+	flush_cache(tc);
+	tc->gen = slab->gen;
+
+	if (!pj_thread_local_get(cache_tls_id))
+	    pj_thread_local_set(cache_tls_id, tls_cache);
+    }
+    return tc;
+}
+#endif	/* HAS_THREAD_CACHE */
+
+
+/* Memory allocation failure is reported by returning NULL */
+static void on_pool_error(pj_pool_t *pool, pj_size_t size)
+{
+    PJ_UNUSED_ARG(pool);
+    PJ_UNUSED_ARG(size);
+}
+
+/* Carve a new chunk into free objects. Slab mutex must be held. */
+static pj_status_t grow(pj_slab_t *slab)
+{
+    char *chunk;
+    unsigned i;
+
+    chunk = (char*) pj_pool_alloc(slab->pool, slab->obj_size *
+					      slab->obj_per_chunk + SLAB_ALIGN);
+    if (!chunk)
+	return PJ_ENOMEM;
+
+    chunk = (char*)(((pj_size_t)chunk + SLAB_ALIGN - 1) &
+		    ~(pj_size_t)(SLAB_ALIGN - 1));
+
+    for (i = slab->obj_per_chunk; i > 0; --i) {
+	free_obj *obj = (free_obj*)(chunk + (i-1) * slab->obj_size);
+	obj->next = slab->free_list;
+	slab->free_list = obj;
+    }
+    slab->capacity += slab->obj_per_chunk;
+
+    return PJ_SUCCESS;
+}
+
+/* Take an object from the free list. Slab mutex must be held. */
+static free_obj *get_free(pj_slab_t *slab)
+{
+    free_obj *obj;
+
+    if (!slab->free_list && grow(slab) != PJ_SUCCESS)
+	return NULL;
+
+    obj = slab->free_list;
+    slab->free_list = obj->next;
+    return obj;
+}
+
+/* Release the memory of the slab */
+static void slab_release(pj_slab_t *slab)
+{
+    pj_slab_t **p;
+
+    PJ_LOG(5,(slab->obj_name, "Slab released, %u objects of %u bytes",
+	      slab->capacity, (unsigned)slab->obj_size));
+
+    pj_enter_critical_section();
+    for (p = &slab_list; *p != slab; p = &(*p)->next)
+	;
+    *p = slab->next;
+    pj_leave_critical_section();
+
+    pj_atomic_destroy(slab->ref_cnt);
+    pj_mutex_destroy(slab->mutex);
+    pj_pool_release(slab->pool);
+}
+
+
+PJ_DEF(pj_status_t) pj_slab_create(pj_pool_factory *factory,
+				   const char *name,
+				   pj_size_t obj_size,
+				   unsigned obj_per_chunk,
+				   pj_slab_t **p_slab)
+{
+    pj_pool_t *pool;
+    pj_slab_t *slab;
+    pj_size_t chunk_size;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(factory && obj_size && p_slab, PJ_EINVAL);
+
+    if (!name)
+	name = "slab%p";
+    if (obj_per_chunk == 0)
+	obj_per_chunk = PJ_SLAB_OBJ_PER_CHUNK;
+
+    obj_size = (obj_size + SLAB_ALIGN - 1) & ~(pj_size_t)(SLAB_ALIGN - 1);
+    if (obj_size < sizeof(free_obj))
+	obj_size = sizeof(free_obj);
+
+    /* Each pool block holds exactly one chunk, and the first block also
+     * holds the slab itself.
+     */
+    chunk_size = obj_size * obj_per_chunk + SLAB_ALIGN +
+		 sizeof(pj_pool_block) + PJ_POOL_ALIGNMENT;
+    pool = pj_pool_create(factory, name, chunk_size + 512, chunk_size,
+			  &on_pool_error);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    slab = PJ_POOL_ZALLOC_T(pool, pj_slab_t);
+    slab->pool = pool;
+    slab->obj_size = obj_size;
+    slab->obj_per_chunk = obj_per_chunk;
+    pj_ansi_strncpy(slab->obj_name, pool->obj_name, sizeof(slab->obj_name));
+    slab->obj_name[sizeof(slab->obj_name)-1] = '\0';
+
+    status = pj_mutex_create_simple(pool, slab->obj_name, &slab->mutex);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = pj_atomic_create(pool, 1, &slab->ref_cnt);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    pj_enter_critical_section();
+#if HAS_THREAD_CACHE
+    cache_tls_init();
+#endif
+    /* Generation zero is for unused cache slots */
+    if (++slab_gen == 0)
+	++slab_gen;
+    slab->gen = slab_gen;
+    slab->next = slab_list;
+    slab_list = slab;
+    pj_leave_critical_section();
+
+    PJ_LOG(5,(slab->obj_name, "Slab created, object size=%u",
+	      (unsigned)obj_size));
+
+    *p_slab = slab;
+    return PJ_SUCCESS;
+
+on_error:
+    if (slab->mutex)
+	pj_mutex_destroy(slab->mutex);
+    pj_pool_release(pool);
+    return status;
+}
+
+
+PJ_DEF(void*) pj_slab_alloc(pj_slab_t *slab)
+{
+    free_obj *obj;
+    unsigned in_use;
+#if HAS_THREAD_CACHE
+    thread_cache *tc;
+#endif
+
+    PJ_ASSERT_RETURN(slab, NULL);
+
+#if HAS_THREAD_CACHE
+    tc = get_cache(slab);
+    if (tc && tc->cnt) {
+	obj = tc->obj[--tc->cnt];
+    } else {
+	/* Refill half of the cache while we have the lock */
+	pj_mutex_lock(slab->mutex);
+	obj = get_free(slab);
+	while (tc && obj && slab->free_list &&
+	       tc->cnt < PJ_SLAB_THREAD_CACHE_SIZE / 2)
+	{
+	    tc->obj[tc->cnt++] = slab->free_list;
+	    slab->free_list = slab->free_list->next;
+	}
+	pj_mutex_unlock(slab->mutex);
+    }
+#else
+    pj_mutex_lock(slab->mutex);
+    obj = get_free(slab);
+    pj_mutex_unlock(slab->mutex);
+#endif
+
+    if (!obj)
+	return NULL;
+
+    /* The peak is only written with the lock held, which is rarely needed
+     * once the slab has reached its working size.
+     */
+    in_use = (unsigned)pj_atomic_inc_and_get(slab->ref_cnt) - 1;
+    if (in_use > PJ_ATOMIC_LOAD_ACQUIRE(&slab->peak)) {
+	pj_mutex_lock(slab->mutex);
+	if (in_use > slab->peak)
+	    PJ_ATOMIC_STORE_RELEASE(&slab->peak, in_use);
+	pj_mutex_unlock(slab->mutex);
+    }
+
+    return obj;
+}
+
+
+PJ_DEF(void*) pj_slab_zalloc(pj_slab_t *slab)
+{
+    void *obj = pj_slab_alloc(slab);
+    if (obj)
+	pj_bzero(obj, slab->obj_size);
+    return obj;
+}
+
+
+PJ_DEF(void) pj_slab_free(pj_slab_t *slab, void *obj)
+{
+#if HAS_THREAD_CACHE
+    thread_cache *tc;
+#endif
+
+    PJ_ASSERT_ON_FAIL(slab && obj, return);
+
+#if HAS_THREAD_CACHE
+    tc = get_cache(slab);
+    if (tc && tc->cnt < PJ_SLAB_THREAD_CACHE_SIZE) {
+	tc->obj[tc->cnt++] = (free_obj*)obj;
+    } else {
+	/* Cache is full, give half of it back to the slab */
+	pj_mutex_lock(slab->mutex);
+	put_free(slab, (free_obj*)obj);
+	while (tc && tc->cnt > PJ_SLAB_THREAD_CACHE_SIZE / 2)
+	    put_free(slab, tc->obj[--tc->cnt]);
+	pj_mutex_unlock(slab->mutex);
+    }
+#else
+    pj_mutex_lock(slab->mutex);
+    put_free(slab, (free_obj*)obj);
+    pj_mutex_unlock(slab->mutex);
+#endif
+
+    if (pj_atomic_dec_and_get(slab->ref_cnt) == 0)
+	slab_release(slab);
+}
+
+
+PJ_DEF(void) pj_slab_get_stat(pj_slab_t *slab, pj_slab_stat *stat)
+{
+    PJ_ASSERT_ON_FAIL(slab && stat, return);
+
+    pj_mutex_lock(slab->mutex);
+    stat->obj_size = slab->obj_size;
+    stat->in_use = (unsigned)pj_atomic_get(slab->ref_cnt) - 1;
+    stat->peak = slab->peak;
+    stat->capacity = slab->capacity;
+    stat->mem_used = pj_pool_get_capacity(slab->pool);
+    pj_mutex_unlock(slab->mutex);
+}
+
+
+PJ_DEF(pj_status_t) pj_slab_destroy(pj_slab_t *slab)
+{
+    PJ_ASSERT_RETURN(slab, PJ_EINVAL);
+
+    if (pj_atomic_dec_and_get(slab->ref_cnt) == 0)
+	slab_release(slab);
+
+    return PJ_SUCCESS;
+}
+
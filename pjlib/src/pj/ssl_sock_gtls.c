@@ -1640,6 +1640,43 @@ static pj_status_t tls_try_handshake(pj_ssl_sock_t *ssock)
  *******************************************************************
  */
 
+/* Start reading from the active socket. With read slab, the active socket
+ * borrows a buffer from the slab whenever there is data, and the data is
+ * decrypted in place in that buffer (see asock_on_data_read()).
+ */
+static pj_status_t asock_start_read(pj_ssl_sock_t *ssock)
+{
+    unsigned int i;
+
+    if (ssock->param.read_slab) {
+        return pj_activesock_start_read(ssock->asock, ssock->pool,
+                                    (unsigned)ssock->param.read_buffer_size,
+                                    PJ_IOQUEUE_ALWAYS_ASYNC);
+    }
+
+    /* Prepare read buffer */
+    ssock->asock_rbuf = (void **)pj_pool_calloc(ssock->pool,
+                                                ssock->param.async_cnt,
+                                                sizeof(void *));
+    if (!ssock->asock_rbuf)
+        return PJ_ENOMEM;
+
+    for (i = 0; i < ssock->param.async_cnt; ++i) {
+        ssock->asock_rbuf[i] = (void *)pj_pool_alloc(
+                                            ssock->pool,
+                                            ssock->param.read_buffer_size +
+                                            sizeof(read_data_t *));
+        if (!ssock->asock_rbuf[i])
+            return PJ_ENOMEM;
+    }
+
+    return pj_activesock_start_read2(ssock->asock, ssock->pool,
+                                     (unsigned)ssock->param.read_buffer_size,
+                                     ssock->asock_rbuf,
+                                     PJ_IOQUEUE_ALWAYS_ASYNC);
+}
+
+
 /* PJ_TRUE asks the socket to read more data, PJ_FALSE takes it off the queue */
 static pj_bool_t asock_on_data_read(pj_activesock_t *asock, void *data,
                                     pj_size_t size, pj_status_t status,
@@ -1647,9 +1684,22 @@ static pj_bool_t asock_on_data_read(pj_activesock_t *asock, void *data,
 {
     pj_ssl_sock_t *ssock = (pj_ssl_sock_t *)
                            pj_activesock_get_user_data(asock);
+    read_data_t *slab_buf = NULL;
 
     pj_size_t app_remainder = 0;
 
+    /* With read slab, the buffer holds the decrypted data left by the
+     * application, followed by the newly received data.
+     */
+    if (ssock->param.read_slab && ssock->read_started) {
+        slab_buf = &ssock->ssock_rbuf[0];
+        /* No buffer is borrowed when only an error is reported */
+        slab_buf->data = size? data : NULL;
+        pj_assert(size >= slab_buf->len);
+        data = (pj_int8_t *)data + slab_buf->len;
+        size -= slab_buf->len;
+    }
+
     if (data && size > 0) {
         /* Push data into input circular buffer (for GnuTLS) */
         pj_lock_acquire(ssock->circ_buf_input_mutex);
@@ -1675,14 +1725,15 @@ static pj_bool_t asock_on_data_read(pj_activesock_t *asock, void *data,
     if (ssock->read_started) {
         do {
             /* Get read data structure at the end of the data */
-            read_data_t *app_read_data =
+            read_data_t *app_read_data = slab_buf? slab_buf :
             	*(OFFSET_OF_READ_DATA_PTR(ssock, data));
-            int app_data_size = (int)(ssock->read_size - app_read_data->len);
+            int app_data_size = app_read_data->data?
+                            (int)(ssock->read_size - app_read_data->len) : 0;
 
             /* Decrypt received data using GnuTLS (will read our input
              * circular buffer) */
             int decrypted_size = gnutls_record_recv(ssock->session,
-                                	((read_data_t *)app_read_data->data) +
+                                	(pj_int8_t *)app_read_data->data +
                                          app_read_data->len,
                                          app_data_size);
 
@@ -1719,11 +1770,10 @@ static pj_bool_t asock_on_data_read(pj_activesock_t *asock, void *data,
                 }
             } else if (decrypted_size == 0) {
                 /* Nothing more to read */
-
-                return PJ_TRUE;
+                break;
             } else if (decrypted_size == GNUTLS_E_AGAIN ||
                        decrypted_size == GNUTLS_E_INTERRUPTED) {
-                return PJ_TRUE;
+                break;
             } else if (decrypted_size == GNUTLS_E_REHANDSHAKE) {
                 /* Seems like we are renegotiating */
                 pj_status_t try_handshake_status = tls_try_handshake(ssock);
@@ -1747,6 +1797,10 @@ static pj_bool_t asock_on_data_read(pj_activesock_t *asock, void *data,
         } while (PJ_TRUE);
     }
 
+    /* Keep the decrypted data left by the application in the buffer */
+    if (slab_buf)
+        *remainder = slab_buf->len;
+
     return PJ_TRUE;
 }
 
@@ -1811,7 +1865,6 @@ static pj_bool_t asock_on_accept_complete(pj_activesock_t *asock,
     pj_ssl_sock_t *ssock;
     pj_activesock_cb asock_cb;
     pj_activesock_cfg asock_cfg;
-    unsigned int i;
     pj_status_t status;
 
     PJ_UNUSED_ARG(src_addr_len);
@@ -1860,27 +1913,12 @@ static pj_bool_t asock_on_accept_complete(pj_activesock_t *asock,
     if (status != PJ_SUCCESS)
         goto on_return;
 
-    /* Prepare read buffer */
-    ssock->asock_rbuf = (void **)pj_pool_calloc(ssock->pool,
-                                                ssock->param.async_cnt,
-                                                sizeof(void*));
-    if (!ssock->asock_rbuf)
-        return PJ_ENOMEM;
-
-    for (i = 0; i < ssock->param.async_cnt; ++i) {
-        ssock->asock_rbuf[i] = (void *)pj_pool_alloc(
-                                            ssock->pool,
-                                            ssock->param.read_buffer_size +
-                                            sizeof(read_data_t*));
-        if (!ssock->asock_rbuf[i])
-            return PJ_ENOMEM;
-    }
-
     /* Create active socket */
     pj_activesock_cfg_default(&asock_cfg);
     asock_cfg.async_cnt = ssock->param.async_cnt;
     asock_cfg.concurrency = ssock->param.concurrency;
     asock_cfg.whole_data = PJ_TRUE;
+    asock_cfg.read_slab = ssock->param.read_slab;
 
     pj_bzero(&asock_cb, sizeof(asock_cb));
     asock_cb.on_data_read = asock_on_data_read;
@@ -1899,10 +1937,7 @@ static pj_bool_t asock_on_accept_complete(pj_activesock_t *asock,
         goto on_return;
 
     /* Start reading */
-    status = pj_activesock_start_read2(ssock->asock, ssock->pool,
-                                       (unsigned)ssock->param.read_buffer_size,
-                                       ssock->asock_rbuf,
-                                       PJ_IOQUEUE_ALWAYS_ASYNC);
+    status = asock_start_read(ssock);
     if (status != PJ_SUCCESS)
         goto on_return;
 
@@ -1952,7 +1987,6 @@ static pj_bool_t asock_on_connect_complete (pj_activesock_t *asock,
     pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)
                            pj_activesock_get_user_data(asock);
 
-    unsigned int i;
     int ret;
 
     if (status != PJ_SUCCESS)
@@ -1970,27 +2004,8 @@ static pj_bool_t asock_on_connect_complete (pj_activesock_t *asock,
     if (status != PJ_SUCCESS)
         goto on_return;
 
-    /* Prepare read buffer */
-    ssock->asock_rbuf = (void **)pj_pool_calloc(ssock->pool,
-                                                ssock->param.async_cnt,
-                                                sizeof(void *));
-    if (!ssock->asock_rbuf)
-        return PJ_ENOMEM;
-
-    for (i = 0; i < ssock->param.async_cnt; ++i) {
-        ssock->asock_rbuf[i] = (void *)pj_pool_alloc(
-                                            ssock->pool,
-                                            ssock->param.read_buffer_size +
-                                            sizeof(read_data_t *));
-        if (!ssock->asock_rbuf[i])
-            return PJ_ENOMEM;
-    }
-
     /* Start read */
-    status = pj_activesock_start_read2(ssock->asock, ssock->pool,
-                                       (unsigned)ssock->param.read_buffer_size,
-                                       ssock->asock_rbuf,
-                                       PJ_IOQUEUE_ALWAYS_ASYNC);
+    status = asock_start_read(ssock);
     if (status != PJ_SUCCESS)
         goto on_return;
 
@@ -2372,6 +2387,21 @@ PJ_DEF(pj_status_t) pj_ssl_sock_start_read(pj_ssl_sock_t *ssock,
     PJ_ASSERT_RETURN(ssock->connection_state == TLS_STATE_ESTABLISHED,
                      PJ_EINVALIDOP);
 
+    if (ssock->param.read_slab) {
+        /* Data is decrypted in the buffer borrowed from the slab */
+        PJ_ASSERT_RETURN(buff_size <= ssock->param.read_buffer_size,
+                         PJ_ETOOBIG);
+
+        ssock->ssock_rbuf = PJ_POOL_ZALLOC_T(pool, read_data_t);
+        if (!ssock->ssock_rbuf)
+            return PJ_ENOMEM;
+
+        ssock->read_size = buff_size;
+        ssock->read_started = PJ_TRUE;
+        ssock->read_flags = flags;
+        return PJ_SUCCESS;
+    }
+
     readbuf = (void**) pj_pool_calloc(pool, ssock->param.async_cnt,
                                       sizeof(void *));
     if (!readbuf)
@@ -2401,6 +2431,7 @@ PJ_DEF(pj_status_t) pj_ssl_sock_start_read2 (pj_ssl_sock_t *ssock,
     unsigned int i;
 
     PJ_ASSERT_RETURN(ssock && pool && buff_size && readbuf, PJ_EINVAL);
+    PJ_ASSERT_RETURN(ssock->param.read_slab == NULL, PJ_EINVALIDOP);
     PJ_ASSERT_RETURN(ssock->connection_state == TLS_STATE_ESTABLISHED,
                      PJ_EINVALIDOP);
 
@@ -2810,6 +2841,7 @@ PJ_DEF(pj_status_t) pj_ssl_sock_start_connect( pj_ssl_sock_t *ssock,
     asock_cfg.async_cnt = ssock->param.async_cnt;
     asock_cfg.concurrency = ssock->param.concurrency;
     asock_cfg.whole_data = PJ_TRUE;
+    asock_cfg.read_slab = ssock->param.read_slab;
 
     pj_bzero(&asock_cb, sizeof(asock_cb));
     asock_cb.on_connect_complete = asock_on_connect_complete;
@@ -2030,6 +2030,37 @@ static void ssl_on_destroy(void *arg)
  *******************************************************************
  */
 
+/* Start reading from the active socket. With read slab, the active socket
+ * borrows a buffer from the slab whenever there is data, and the data is
+ * decrypted in place in that buffer (see asock_on_data_read()).
+ */
+static pj_status_t asock_start_read(pj_ssl_sock_t *ssock)
+{
+    unsigned i;
+
+    if (ssock->param.read_slab) {
+	return pj_activesock_start_read(ssock->asock, ssock->pool,
+				    (unsigned)ssock->param.read_buffer_size,
+				    PJ_IOQUEUE_ALWAYS_ASYNC);
+    }
+
+    /* Prepare read buffer */
+    ssock->asock_rbuf = (void**)pj_pool_calloc(ssock->pool, 
+					       ssock->param.async_cnt,
+					       sizeof(void*));
+    for (i = 0; i<ssock->param.async_cnt; ++i) {
+	ssock->asock_rbuf[i] = (void*) pj_pool_alloc(
+					    ssock->pool, 
+					    ssock->param.read_buffer_size + 
+					    sizeof(read_data_t*));
+    }
+
+    return pj_activesock_start_read2(ssock->asock, ssock->pool, 
+				     (unsigned)ssock->param.read_buffer_size,
+				     ssock->asock_rbuf,
+				     PJ_IOQUEUE_ALWAYS_ASYNC);
+}
+
 static pj_bool_t asock_on_data_read (pj_activesock_t *asock,
 				     void *data,
 				     pj_size_t size,
@@ -2038,8 +2069,21 @@ static pj_bool_t asock_on_data_read (pj_activesock_t *asock,
 {
     pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)
 			   pj_activesock_get_user_data(asock);
+    read_data_t *slab_buf = NULL;
     pj_size_t nwritten;
 
+    /* With read slab, the buffer holds the decrypted data left by the
+     * application, followed by the newly received data.
+     */
+    if (ssock->param.read_slab && ssock->read_started) {
+	slab_buf = &ssock->ssock_rbuf[0];
+	/* No buffer is borrowed when only an error is reported */
+	slab_buf->data = size? data : NULL;
+	pj_assert(size >= slab_buf->len);
+	data = (pj_int8_t*)data + slab_buf->len;
+	size -= slab_buf->len;
+    }
+
     /* Socket error or closed */
     if (data && size > 0) {
 	/* Consume the whole data */
@@ -2067,9 +2111,10 @@ static pj_bool_t asock_on_data_read (pj_activesock_t *asock,
     /* See if there is any decrypted data for the application */
     if (ssock->read_started) {
 	do {
-	    read_data_t *buf = *(OFFSET_OF_READ_DATA_PTR(ssock, data));
+	    read_data_t *buf = slab_buf? slab_buf :
+				*(OFFSET_OF_READ_DATA_PTR(ssock, data));
 	    void *data_ = (pj_int8_t*)buf->data + buf->len;
-	    int size_ = (int)(ssock->read_size - buf->len);
+	    int size_ = buf->data? (int)(ssock->read_size - buf->len) : 0;
 	    int len = size_;
 
 	    /* SSL_read() may write some data to BIO write when re-negotiation
@@ -2174,6 +2219,10 @@ static pj_bool_t asock_on_data_read (pj_activesock_t *asock,
 	} while (1);
     }
 
+    /* Keep the decrypted data left by the application in the buffer */
+    if (slab_buf)
+	*remainder = slab_buf->len;
+
     return PJ_TRUE;
 
 on_error:
@@ -2262,7 +2311,6 @@ static pj_bool_t asock_on_accept_complete (pj_activesock_t *asock,
     pj_ssl_sock_t *ssock;
     pj_activesock_cb asock_cb;
     pj_activesock_cfg asock_cfg;
-    unsigned i;
     pj_status_t status;
 
     /* Create new SSL socket instance */
@@ -2316,22 +2364,12 @@ static pj_bool_t asock_on_accept_complete (pj_activesock_t *asock,
     if (status != PJ_SUCCESS)
 	goto on_return;
 
-    /* Prepare read buffer */
-    ssock->asock_rbuf = (void**)pj_pool_calloc(ssock->pool, 
-					       ssock->param.async_cnt,
-					       sizeof(void*));
-    for (i = 0; i<ssock->param.async_cnt; ++i) {
-	ssock->asock_rbuf[i] = (void*) pj_pool_alloc(
-					    ssock->pool, 
-					    ssock->param.read_buffer_size + 
-					    sizeof(read_data_t*));
-    }
-
     /* Create active socket */
     pj_activesock_cfg_default(&asock_cfg);
     asock_cfg.async_cnt = ssock->param.async_cnt;
     asock_cfg.concurrency = ssock->param.concurrency;
     asock_cfg.whole_data = PJ_TRUE;
+    asock_cfg.read_slab = ssock->param.read_slab;
     
     /* If listener socket has group lock, automatically create group lock
      * for the new socket.
@@ -2366,10 +2404,7 @@ static pj_bool_t asock_on_accept_complete (pj_activesock_t *asock,
 	goto on_return;
 
     /* Start read */
-    status = pj_activesock_start_read2(ssock->asock, ssock->pool, 
-				       (unsigned)ssock->param.read_buffer_size,
-				       ssock->asock_rbuf,
-				       PJ_IOQUEUE_ALWAYS_ASYNC);
+    status = asock_start_read(ssock);
     if (status != PJ_SUCCESS)
 	goto on_return;
 
@@ -2419,7 +2454,6 @@ static pj_bool_t asock_on_connect_complete (pj_activesock_t *asock,
 {
     pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)
 			   pj_activesock_get_user_data(asock);
-    unsigned i;
 
     if (status != PJ_SUCCESS)
 	goto on_return;
@@ -2436,22 +2470,8 @@ static pj_bool_t asock_on_connect_complete (pj_activesock_t *asock,
     if (status != PJ_SUCCESS)
 	goto on_return;
 
-    /* Prepare read buffer */
-    ssock->asock_rbuf = (void**)pj_pool_calloc(ssock->pool, 
-					       ssock->param.async_cnt,
-					       sizeof(void*));
-    for (i = 0; i<ssock->param.async_cnt; ++i) {
-	ssock->asock_rbuf[i] = (void*) pj_pool_alloc(
-					    ssock->pool, 
-					    ssock->param.read_buffer_size + 
-					    sizeof(read_data_t*));
-    }
-
     /* Start read */
-    status = pj_activesock_start_read2(ssock->asock, ssock->pool, 
-				       (unsigned)ssock->param.read_buffer_size,
-				       ssock->asock_rbuf,
-				       PJ_IOQUEUE_ALWAYS_ASYNC);
+    status = asock_start_read(ssock);
     if (status != PJ_SUCCESS)
 	goto on_return;
 
@@ -2906,6 +2926,18 @@ PJ_DEF(pj_status_t) pj_ssl_sock_start_read (pj_ssl_sock_t *ssock,
     if (ssock->ssl_state != SSL_STATE_ESTABLISHED) 
 	return PJ_EINVALIDOP;
 
+    if (ssock->param.read_slab) {
+	/* Data is decrypted in the buffer borrowed from the slab */
+	PJ_ASSERT_RETURN(buff_size <= ssock->param.read_buffer_size,
+			 PJ_ETOOBIG);
+
+	ssock->ssock_rbuf = PJ_POOL_ZALLOC_T(pool, read_data_t);
+	ssock->read_size = buff_size;
+	ssock->read_started = PJ_TRUE;
+	ssock->read_flags = flags;
+	return PJ_SUCCESS;
+    }
+
     readbuf = (void**) pj_pool_calloc(pool, ssock->param.async_cnt, 
 				      sizeof(void*));
 
@@ -2932,6 +2964,7 @@ PJ_DEF(pj_status_t) pj_ssl_sock_start_read2 (pj_ssl_sock_t *ssock,
     unsigned i;
 
     PJ_ASSERT_RETURN(ssock && pool && buff_size && readbuf, PJ_EINVAL);
+    PJ_ASSERT_RETURN(ssock->param.read_slab == NULL, PJ_EINVALIDOP);
 
     if (ssock->ssl_state != SSL_STATE_ESTABLISHED) 
 	return PJ_EINVALIDOP;
@@ -3379,6 +3412,7 @@ PJ_DEF(pj_status_t) pj_ssl_sock_start_connect( pj_ssl_sock_t *ssock,
     asock_cfg.concurrency = ssock->param.concurrency;
     asock_cfg.whole_data = PJ_TRUE;
     asock_cfg.grp_lock = ssock->param.grp_lock;
+    asock_cfg.read_slab = ssock->param.read_slab;
 
     pj_bzero(&asock_cb, sizeof(asock_cb));
     asock_cb.on_connect_complete = asock_on_connect_complete;
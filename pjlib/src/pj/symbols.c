@@ -72,12 +72,15 @@ PJ_EXPORT_SYMBOL(pj_fifobuf_free)
  */
 PJ_EXPORT_SYMBOL(pj_generate_unique_string)
 PJ_EXPORT_SYMBOL(pj_create_unique_string)
+PJ_EXPORT_SYMBOL(pj_generate_unique_string_fast)
+PJ_EXPORT_SYMBOL(pj_create_unique_string_fast)
 
 /*
  * hash.h
  */
 PJ_EXPORT_SYMBOL(pj_hash_calc)
 PJ_EXPORT_SYMBOL(pj_hash_create)
+PJ_EXPORT_SYMBOL(pj_hash_create_resizable)
 PJ_EXPORT_SYMBOL(pj_hash_get)
 PJ_EXPORT_SYMBOL(pj_hash_set)
 PJ_EXPORT_SYMBOL(pj_hash_count)
@@ -95,6 +98,7 @@ PJ_EXPORT_SYMBOL(pj_ioqueue_register_sock)
 PJ_EXPORT_SYMBOL(pj_ioqueue_unregister)
 PJ_EXPORT_SYMBOL(pj_ioqueue_get_user_data)
 PJ_EXPORT_SYMBOL(pj_ioqueue_poll)
+PJ_EXPORT_SYMBOL(pj_ioqueue_post)
 PJ_EXPORT_SYMBOL(pj_ioqueue_read)
 PJ_EXPORT_SYMBOL(pj_ioqueue_recv)
 PJ_EXPORT_SYMBOL(pj_ioqueue_recvfrom)
@@ -158,6 +162,9 @@ PJ_EXPORT_SYMBOL(pj_thread_register)
 PJ_EXPORT_SYMBOL(pj_thread_create)
 PJ_EXPORT_SYMBOL(pj_thread_get_name)
 PJ_EXPORT_SYMBOL(pj_thread_resume)
+PJ_EXPORT_SYMBOL(pj_thread_set_sched)
+PJ_EXPORT_SYMBOL(pj_thread_set_affinity)
+PJ_EXPORT_SYMBOL(pj_get_numa_node_cpus)
 PJ_EXPORT_SYMBOL(pj_thread_this)
 PJ_EXPORT_SYMBOL(pj_thread_join)
 PJ_EXPORT_SYMBOL(pj_thread_destroy)
@@ -174,6 +181,7 @@ PJ_EXPORT_SYMBOL(pj_atomic_get)
 PJ_EXPORT_SYMBOL(pj_atomic_inc)
 PJ_EXPORT_SYMBOL(pj_atomic_dec)
 PJ_EXPORT_SYMBOL(pj_thread_local_alloc)
+PJ_EXPORT_SYMBOL(pj_thread_local_alloc2)
 PJ_EXPORT_SYMBOL(pj_thread_local_free)
 PJ_EXPORT_SYMBOL(pj_thread_local_set)
 PJ_EXPORT_SYMBOL(pj_thread_local_get)
@@ -198,6 +206,9 @@ PJ_EXPORT_SYMBOL(pj_gettimeofday)
 PJ_EXPORT_SYMBOL(pj_time_decode)
 #if defined(PJ_HAS_HIGH_RES_TIMER) && PJ_HAS_HIGH_RES_TIMER != 0
 PJ_EXPORT_SYMBOL(pj_gettickcount)
+PJ_EXPORT_SYMBOL(pj_gettickcount_coarse)
+PJ_EXPORT_SYMBOL(pj_gettickcount_cached)
+PJ_EXPORT_SYMBOL(pj_gettickcount_update_cache)
 PJ_EXPORT_SYMBOL(pj_get_timestamp)
 PJ_EXPORT_SYMBOL(pj_get_timestamp_freq)
 PJ_EXPORT_SYMBOL(pj_elapsed_time)
@@ -224,6 +235,29 @@ PJ_EXPORT_SYMBOL(pj_pool_init_int)
 PJ_EXPORT_SYMBOL(pj_pool_destroy_int)
 PJ_EXPORT_SYMBOL(pj_caching_pool_init)
 PJ_EXPORT_SYMBOL(pj_caching_pool_destroy)
+PJ_EXPORT_SYMBOL(pj_caching_pool_prof_start)
+PJ_EXPORT_SYMBOL(pj_caching_pool_prof_stop)
+PJ_EXPORT_SYMBOL(pj_caching_pool_prof_get_stat)
+PJ_EXPORT_SYMBOL(pj_caching_pool_prof_get_sites)
+PJ_EXPORT_SYMBOL(pj_caching_pool_prof_dump)
+
+/*
+ * mpsc_queue.h
+ */
+PJ_EXPORT_SYMBOL(pj_mpsc_queue_create)
+PJ_EXPORT_SYMBOL(pj_mpsc_queue_push)
+PJ_EXPORT_SYMBOL(pj_mpsc_queue_pop)
+PJ_EXPORT_SYMBOL(pj_mpsc_queue_destroy)
+
+/*
+ * slab.h
+ */
+PJ_EXPORT_SYMBOL(pj_slab_create)
+PJ_EXPORT_SYMBOL(pj_slab_alloc)
+PJ_EXPORT_SYMBOL(pj_slab_zalloc)
+PJ_EXPORT_SYMBOL(pj_slab_free)
+PJ_EXPORT_SYMBOL(pj_slab_get_stat)
+PJ_EXPORT_SYMBOL(pj_slab_destroy)
 
 /*
  * rand.h
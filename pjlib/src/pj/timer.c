@@ -623,6 +623,7 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
 
     count = 0;
     pj_gettickcount(&now);
+    pj_gettickcount_update_cache(&now);
 
     while ( ht->cur_size && 
 	    PJ_TIME_VAL_LTE(ht->heap[0]->_timer_value, now) &&
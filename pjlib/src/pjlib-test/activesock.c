@@ -494,6 +494,500 @@ on_return:
 
 
 
+/*******************************************************************
+ * Read slab test: many mostly idle TCP connections sharing a slab of
+ * read buffers.
+ */
+
+/* Number of connections in the read slab test. Only the receiving side
+ * is registered to the ioqueue, so raise PJ_IOQUEUE_MAX_HANDLES (and the
+ * open files limit) to run the test with many more connections, e.g.
+ * 100000 connections with the epoll ioqueue.
+ */
+#ifndef SLAB_TEST_CONN_CNT
+#   define SLAB_TEST_CONN_CNT	(PJ_IOQUEUE_MAX_HANDLES - 4)
+#endif
+
+/* Number of connections in the idle connections run of the read slab
+ * test, where only SLAB_TEST_ACTIVE_CNT connections have data at the same
+ * time. The connections are spread over several ioqueues. Each one takes
+ * two descriptors, which must stay below FD_SETSIZE with the select
+ * ioqueue.
+ */
+#ifndef SLAB_TEST_IDLE_CONN_CNT
+#   define SLAB_TEST_IDLE_CONN_CNT	400
+#endif
+
+#define SLAB_TEST_ACTIVE_CNT	8
+
+#define SLAB_TEST_BUF_SIZE	4000
+
+/* Application header in front of the read data in each slab buffer */
+#define SLAB_TEST_HDR_SIZE	64
+
+struct slab_conn
+{
+    pj_sock_t		 clt_sock;
+    pj_activesock_t	*asock;
+    unsigned		 rx_msg;
+    pj_bool_t		 has_remainder;
+    pj_bool_t		 eof;
+};
+
+/* Resident set size of this process in KB, or zero if unknown. */
+static unsigned long get_rss_kb(void)
+{
+#if defined(PJ_LINUX) && PJ_LINUX!=0
+    pj_oshandle_t fd;
+    char buf[64], *p;
+    pj_ssize_t size = sizeof(buf) - 1;
+    pj_str_t s;
+
+    if (pj_file_open(NULL, "/proc/self/statm", PJ_O_RDONLY, &fd) != 0)
+	return 0;
+    if (pj_file_read(fd, buf, &size) != 0 || size <= 0)
+	size = 0;
+    pj_file_close(fd);
+    buf[size] = '\0';
+
+    /* The second field is the resident pages, assume 4 KB pages */
+    p = pj_ansi_strchr(buf, ' ');
+    if (!p)
+	return 0;
+    return pj_strtoul(pj_cstr(&s, p + 1)) * 4;
+#else
+    return 0;
+#endif
+}
+
+/* Messages are terminated by newline; leave incomplete message in the
+ * buffer as remainder.
+ */
+static pj_bool_t slab_on_data_read(pj_activesock_t *asock,
+				   void *data,
+				   pj_size_t size,
+				   pj_status_t status,
+				   pj_size_t *remainder)
+{
+    struct slab_conn *conn = (struct slab_conn*)
+			     pj_activesock_get_user_data(asock);
+    char *p = (char*)data, *end = p + size, *last = p;
+
+    /* The header in front of the data belongs to the application */
+    if (status == PJ_SUCCESS)
+	pj_bzero(p - SLAB_TEST_HDR_SIZE, SLAB_TEST_HDR_SIZE);
+
+    if (status != PJ_SUCCESS) {
+	conn->eof = PJ_TRUE;
+	pj_activesock_close(asock);
+	conn->asock = NULL;
+	return PJ_FALSE;
+    }
+
+    for (; p != end; ++p) {
+	if (*p == '\n') {
+	    ++conn->rx_msg;
+	    last = p + 1;
+	}
+    }
+
+    conn->has_remainder = (last != end);
+    if (last != end) {
+	pj_memmove(data, last, end - last);
+	*remainder = end - last;
+    }
+
+    return PJ_TRUE;
+}
+
+static void slab_poll(pj_ioqueue_t *ioqueue[], unsigned ioq_cnt,
+		      struct slab_conn *conn, unsigned cnt,
+		      unsigned min_rx, pj_bool_t eof)
+{
+    pj_time_val timeout, now;
+    unsigned i;
+
+    pj_gettimeofday(&timeout);
+    timeout.sec += 5;
+
+    for (;;) {
+	pj_time_val delay = { 0, 10 };
+
+	for (i=0; i<cnt; ++i) {
+	    if (conn[i].rx_msg < min_rx || conn[i].eof != eof ||
+		(min_rx == 0 && !conn[i].has_remainder))
+	    {
+		break;
+	    }
+	}
+	if (i == cnt)
+	    return;
+
+	pj_gettimeofday(&now);
+	if (PJ_TIME_VAL_GTE(now, timeout))
+	    return;
+
+	for (i=0; i<ioq_cnt; ++i)
+	    pj_ioqueue_poll(ioqueue[i], &delay);
+    }
+}
+
+/* Create a connection whose receiving side is an active socket reading
+ * with the slab.
+ */
+static pj_status_t slab_connect(pj_pool_t *pool, pj_ioqueue_t *ioqueue,
+				const pj_activesock_cfg *cfg,
+				const pj_activesock_cb *cb,
+				struct slab_conn *conn)
+{
+    pj_sock_t srv_sock = PJ_INVALID_SOCKET;
+    pj_status_t status;
+
+    status = app_socketpair(pj_AF_INET(), pj_SOCK_STREAM(), 0,
+			    &srv_sock, &conn->clt_sock);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pj_activesock_create(pool, srv_sock, pj_SOCK_STREAM(), cfg,
+				  ioqueue, cb, conn, &conn->asock);
+    if (status != PJ_SUCCESS) {
+	pj_sock_close(srv_sock);
+	conn->asock = NULL;
+	return status;
+    }
+
+    return pj_activesock_start_read(conn->asock, pool, SLAB_TEST_BUF_SIZE, 0);
+}
+
+static void slab_close_all(struct slab_conn *conn, unsigned cnt)
+{
+    unsigned i;
+
+    for (i=0; i<cnt; ++i) {
+	if (conn[i].asock) {
+	    pj_activesock_close(conn[i].asock);
+	    conn[i].asock = NULL;
+	}
+	if (conn[i].clt_sock != PJ_INVALID_SOCKET) {
+	    pj_sock_close(conn[i].clt_sock);
+	    conn[i].clt_sock = PJ_INVALID_SOCKET;
+	}
+    }
+}
+
+static int slab_test(void)
+{
+    pj_pool_t *pool;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_activesock_slab *slab = NULL;
+    pj_activesock_slab_info info;
+    pj_activesock_cfg cfg;
+    pj_activesock_cb cb;
+    struct slab_conn *conn;
+    unsigned long rss0, rss1;
+    unsigned i, cnt = 0;
+    int rc = 0;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "slabtest", 4000, 4000, NULL);
+    conn = (struct slab_conn*)
+	   pj_pool_calloc(pool, SLAB_TEST_CONN_CNT, sizeof(*conn));
+    for (i=0; i<SLAB_TEST_CONN_CNT; ++i)
+	conn[i].clt_sock = PJ_INVALID_SOCKET;
+
+    status = pj_ioqueue_create(pool, SLAB_TEST_CONN_CNT, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	rc = -500; goto on_return;
+    }
+
+    status = pj_activesock_slab_create2(mem,
+					SLAB_TEST_HDR_SIZE+SLAB_TEST_BUF_SIZE,
+					SLAB_TEST_HDR_SIZE, &slab);
+    if (status != PJ_SUCCESS) {
+	rc = -510; goto on_return;
+    }
+
+    pj_activesock_cfg_default(&cfg);
+    cfg.read_slab = slab;
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_data_read = &slab_on_data_read;
+
+    rss0 = get_rss_kb();
+
+    for (cnt=0; cnt<SLAB_TEST_CONN_CNT; ++cnt) {
+	status = slab_connect(pool, ioqueue, &cfg, &cb, &conn[cnt]);
+	if (status != PJ_SUCCESS) {
+	    ++cnt;
+	    rc = -520; goto on_return;
+	}
+    }
+
+    rss1 = get_rss_kb();
+
+    /* Idle connections must not hold any buffer */
+    pj_activesock_slab_get_info(slab, &info);
+    if (info.total_cnt != 0) {
+	rc = -550; goto on_return;
+    }
+
+    /* Every connection receives a complete message, and every other
+     * connection also an incomplete one which must be kept.
+     */
+    for (i=0; i<cnt; ++i) {
+	const char *msg = (i & 1) ? "hello\nwor" : "hello\n";
+	pj_ssize_t len = pj_ansi_strlen(msg);
+
+	status = pj_sock_send(conn[i].clt_sock, msg, &len, 0);
+	if (status != PJ_SUCCESS) {
+	    rc = -560; goto on_return;
+	}
+    }
+    slab_poll(&ioqueue, 1, conn, cnt, 1, PJ_FALSE);
+
+    pj_activesock_slab_get_info(slab, &info);
+    for (i=0; i<cnt; ++i) {
+	if (conn[i].rx_msg != 1) {
+	    rc = -570; goto on_return;
+	}
+    }
+    if (info.used_cnt != cnt / 2) {
+	PJ_LOG(3,("", "   error: %d buffers used, expecting %d",
+		  info.used_cnt, cnt / 2));
+	rc = -580; goto on_return;
+    }
+
+    /* Complete the pending messages, all buffers must be released */
+    for (i=0; i<cnt; ++i) {
+	const char *msg = (i & 1) ? "ld\n" : "again\n";
+	pj_ssize_t len = pj_ansi_strlen(msg);
+
+	status = pj_sock_send(conn[i].clt_sock, msg, &len, 0);
+	if (status != PJ_SUCCESS) {
+	    rc = -590; goto on_return;
+	}
+    }
+    slab_poll(&ioqueue, 1, conn, cnt, 2, PJ_FALSE);
+
+    pj_activesock_slab_get_info(slab, &info);
+    for (i=0; i<cnt; ++i) {
+	if (conn[i].rx_msg != 2) {
+	    rc = -600; goto on_return;
+	}
+    }
+    if (info.used_cnt != 0 || info.peak_cnt > cnt / 2 + 1) {
+	rc = -610; goto on_return;
+    }
+
+    PJ_LOG(3,("", "...%d connections: %d read buffers allocated (%d KB), "
+		  "fixed buffers would need %d KB",
+	      cnt, info.total_cnt, info.total_cnt * info.buf_size / 1024,
+	      cnt * SLAB_TEST_BUF_SIZE / 1024));
+    if (rss0 && rss1) {
+	PJ_LOG(3,("", "...RSS growth with idle connections: %lu KB "
+		      "(%lu bytes per connection)",
+		  rss1 - rss0, (rss1 - rss0) * 1024 / cnt));
+    }
+
+    /* Leave an incomplete message in every connection */
+    for (i=0; i<cnt; ++i) {
+	pj_ssize_t len = 4;
+
+	status = pj_sock_send(conn[i].clt_sock, "part", &len, 0);
+	if (status != PJ_SUCCESS) {
+	    rc = -620; goto on_return;
+	}
+    }
+    slab_poll(&ioqueue, 1, conn, cnt, 0, PJ_FALSE);
+    pj_activesock_slab_get_info(slab, &info);
+    if (info.used_cnt != cnt) {
+	rc = -630; goto on_return;
+    }
+
+    /* Closing the socket returns its buffer */
+    for (i=0; i<cnt; i+=2) {
+	pj_activesock_close(conn[i].asock);
+	conn[i].asock = NULL;
+	conn[i].eof = PJ_TRUE;
+    }
+    pj_activesock_slab_get_info(slab, &info);
+    if (info.used_cnt != cnt / 2) {
+	rc = -640; goto on_return;
+    }
+
+    /* Closing the peer must report EOF, and the remaining sockets are
+     * closed in the callback while holding a buffer.
+     */
+    for (i=0; i<cnt; ++i) {
+	pj_sock_close(conn[i].clt_sock);
+	conn[i].clt_sock = PJ_INVALID_SOCKET;
+    }
+    slab_poll(&ioqueue, 1, conn, cnt, 2, PJ_TRUE);
+    for (i=0; i<cnt; ++i) {
+	if (!conn[i].eof) {
+	    rc = -650; goto on_return;
+	}
+    }
+    pj_activesock_slab_get_info(slab, &info);
+    if (info.used_cnt != 0) {
+	rc = -660; goto on_return;
+    }
+
+on_return:
+    slab_close_all(conn, cnt);
+    if (slab)
+	pj_activesock_slab_destroy(slab);
+    if (ioqueue)
+	pj_ioqueue_destroy(ioqueue);
+    pj_pool_release(pool);
+    return rc;
+}
+
+/* Many idle connections spread over several ioqueues, with only a few of
+ * them receiving data at a time: the slab must only grow to the number of
+ * connections with data.
+ */
+static int slab_idle_test(void)
+{
+    enum { IOQ_CONN_CNT = PJ_IOQUEUE_MAX_HANDLES - 4 };
+    pj_pool_t *pool;
+    pj_ioqueue_t **ioqueue;
+    unsigned ioq_cnt;
+    pj_activesock_slab *slab = NULL;
+    pj_activesock_slab_info info;
+    pj_activesock_cfg cfg;
+    pj_activesock_cb cb;
+    struct slab_conn *conn;
+    unsigned long rss0, rss1;
+    unsigned i, j, n, cnt = 0;
+    int rc = 0;
+    pj_status_t status;
+
+    ioq_cnt = (SLAB_TEST_IDLE_CONN_CNT + IOQ_CONN_CNT - 1) / IOQ_CONN_CNT;
+
+    pool = pj_pool_create(mem, "slabidle", 4000, 4000, NULL);
+    conn = (struct slab_conn*)
+	   pj_pool_calloc(pool, SLAB_TEST_IDLE_CONN_CNT, sizeof(*conn));
+    for (i=0; i<SLAB_TEST_IDLE_CONN_CNT; ++i)
+	conn[i].clt_sock = PJ_INVALID_SOCKET;
+    ioqueue = (pj_ioqueue_t**)
+	      pj_pool_calloc(pool, ioq_cnt, sizeof(pj_ioqueue_t*));
+
+    for (i=0; i<ioq_cnt; ++i) {
+	status = pj_ioqueue_create(pool, IOQ_CONN_CNT, &ioqueue[i]);
+	if (status != PJ_SUCCESS) {
+	    rc = -700; goto on_return;
+	}
+    }
+
+    status = pj_activesock_slab_create2(mem,
+					SLAB_TEST_HDR_SIZE+SLAB_TEST_BUF_SIZE,
+					SLAB_TEST_HDR_SIZE, &slab);
+    if (status != PJ_SUCCESS) {
+	rc = -710; goto on_return;
+    }
+
+    pj_activesock_cfg_default(&cfg);
+    cfg.read_slab = slab;
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_data_read = &slab_on_data_read;
+
+    rss0 = get_rss_kb();
+
+    for (cnt=0; cnt<SLAB_TEST_IDLE_CONN_CNT; ++cnt) {
+	status = slab_connect(pool, ioqueue[cnt / IOQ_CONN_CNT], &cfg, &cb,
+			      &conn[cnt]);
+	if (status != PJ_SUCCESS) {
+	    app_perror("...error: unable to create connection", status);
+	    ++cnt;
+	    rc = -720; goto on_return;
+	}
+    }
+
+    rss1 = get_rss_kb();
+
+    pj_activesock_slab_get_info(slab, &info);
+    if (info.total_cnt != 0) {
+	rc = -730; goto on_return;
+    }
+
+    /* Walk through the connections a few at a time: each gets an
+     * incomplete message which holds a buffer, then the rest of it.
+     */
+    for (i=0; i<cnt; i+=n) {
+	n = PJ_MIN(SLAB_TEST_ACTIVE_CNT, cnt - i);
+
+	for (j=i; j<i+n; ++j) {
+	    pj_ssize_t len = 3;
+
+	    status = pj_sock_send(conn[j].clt_sock, "wor", &len, 0);
+	    if (status != PJ_SUCCESS) {
+		rc = -740; goto on_return;
+	    }
+	}
+	slab_poll(ioqueue, ioq_cnt, &conn[i], n, 0, PJ_FALSE);
+
+	pj_activesock_slab_get_info(slab, &info);
+	if (info.used_cnt != n) {
+	    PJ_LOG(3,("", "   error: %d buffers used, expecting %d",
+		      info.used_cnt, n));
+	    rc = -750; goto on_return;
+	}
+
+	for (j=i; j<i+n; ++j) {
+	    pj_ssize_t len = 3;
+
+	    status = pj_sock_send(conn[j].clt_sock, "ld\n", &len, 0);
+	    if (status != PJ_SUCCESS) {
+		rc = -760; goto on_return;
+	    }
+	}
+	slab_poll(ioqueue, ioq_cnt, &conn[i], n, 1, PJ_FALSE);
+
+	pj_activesock_slab_get_info(slab, &info);
+	if (info.used_cnt != 0) {
+	    rc = -770; goto on_return;
+	}
+    }
+
+    for (i=0; i<cnt; ++i) {
+	if (conn[i].rx_msg != 1) {
+	    rc = -780; goto on_return;
+	}
+    }
+
+    pj_activesock_slab_get_info(slab, &info);
+    if (info.peak_cnt > SLAB_TEST_ACTIVE_CNT ||
+	info.total_cnt > SLAB_TEST_ACTIVE_CNT)
+    {
+	PJ_LOG(3,("", "   error: %d buffers allocated, peak %d, expecting "
+		      "at most %d", info.total_cnt, info.peak_cnt,
+		  SLAB_TEST_ACTIVE_CNT));
+	rc = -790; goto on_return;
+    }
+
+    PJ_LOG(3,("", "...%d connections over %d ioqueues, %d active at a time: "
+		  "%d read buffers allocated",
+	      cnt, ioq_cnt, SLAB_TEST_ACTIVE_CNT, info.total_cnt));
+    if (rss0 && rss1) {
+	PJ_LOG(3,("", "...RSS growth with idle connections: %lu KB "
+		      "(%lu bytes per connection)",
+		  rss1 - rss0, (rss1 - rss0) * 1024 / cnt));
+    }
+
+on_return:
+    slab_close_all(conn, cnt);
+    if (slab)
+	pj_activesock_slab_destroy(slab);
+    for (i=0; i<ioq_cnt; ++i) {
+	if (ioqueue[i])
+	    pj_ioqueue_destroy(ioqueue[i]);
+    }
+    pj_pool_release(pool);
+    return rc;
+}
+
 int activesock_test(void)
 {
     int ret;
@@ -508,6 +1002,16 @@ int activesock_test(void)
     if (ret != 0)
 	return ret;
 
+    PJ_LOG(3,("", "..tcp read slab test"));
+    ret = slab_test();
+    if (ret != 0)
+	return ret;
+
+    PJ_LOG(3,("", "..tcp read slab test with many idle connections"));
+    ret = slab_idle_test();
+    if (ret != 0)
+	return ret;
+
     return 0;
 }
 
@@ -20,12 +20,15 @@
 #include <pj/hash.h>
 #include <pj/rand.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/pool.h>
+#include <pj/string.h>
 #include "test.h"
 
 #if INCLUDE_HASH_TEST
 
 #define HASH_COUNT  31
+#define THIS_FILE   "hash_test.c"
 
 static int hash_test_with_key(pj_pool_t *pool, unsigned char key)
 {
@@ -130,6 +133,209 @@ static int hash_collision_test(pj_pool_t *pool)
 }
 
 
+static int hash_tolower_test(void)
+{
+    /* Include the characters around 'A' and 'Z', and non-ASCII */
+    char key_buf[] = "Call-ID@[Host]`AZaz{\xC0\xDA-12345678";
+    char lower_buf[] = "call-id@[host]`azaz{\xC0\xDA-12345678";
+    char result[sizeof(key_buf)];
+    pj_str_t key;
+    pj_uint32_t hval;
+    unsigned i;
+
+    /* Different lengths, to test partial words */
+    for (i=0; i<sizeof(key_buf); ++i) {
+	key.ptr = key_buf;
+	key.slen = i;
+
+	hval = pj_hash_calc_tolower(0, result, &key);
+	if (hval != pj_hash_calc(0, lower_buf, i))
+	    return -300;
+	if (pj_memcmp(result, lower_buf, i) != 0)
+	    return -310;
+    }
+
+    if (pj_hash_calc(0, key_buf, PJ_HASH_KEY_STRING) !=
+	pj_hash_calc(0, key_buf, (unsigned)pj_ansi_strlen(key_buf)))
+    {
+	return -320;
+    }
+
+    return 0;
+}
+
+static int hash_resize_test(pj_pool_t *pool)
+{
+    enum {
+	COUNT = 10000
+    };
+    pj_hash_table_t *ht;
+    pj_hash_iterator_t it_buf, *it;
+    unsigned *values;
+    unsigned i, cnt;
+
+    ht = pj_hash_create_resizable(pool, 7);
+    if (!ht)
+	return -400;
+
+    values = (unsigned*) pj_pool_alloc(pool, COUNT * sizeof(unsigned));
+
+    /* Keys added earlier must be found while the table is being resized */
+    for (i=0; i<COUNT; ++i) {
+	unsigned *entry;
+
+	values[i] = i;
+	pj_hash_set(pool, ht, &i, sizeof(i), 0, &values[i]);
+
+	entry = (unsigned*) pj_hash_get(ht, &values[i/2], sizeof(i), NULL);
+	if (!entry || *entry != i/2)
+	    return -410;
+    }
+
+    if (pj_hash_count(ht) != COUNT)
+	return -420;
+
+    for (i=0; i<COUNT; ++i) {
+	unsigned *entry;
+	entry = (unsigned*) pj_hash_get(ht, &i, sizeof(i), NULL);
+	if (!entry || *entry != i)
+	    return -430;
+    }
+
+    /* Delete the odd keys while iterating */
+    cnt = 0;
+    it = pj_hash_first(ht, &it_buf);
+    while (it) {
+	unsigned *entry = (unsigned*) pj_hash_this(ht, it);
+
+	it = pj_hash_next(ht, it);
+	if (*entry & 1)
+	    pj_hash_set(NULL, ht, entry, sizeof(*entry), 0, NULL);
+	++cnt;
+    }
+
+    if (cnt != COUNT || pj_hash_count(ht) != COUNT/2)
+	return -440;
+
+    for (i=0; i<COUNT; ++i) {
+	void *entry = pj_hash_get(ht, &i, sizeof(i), NULL);
+	if ((entry != NULL) != ((i & 1) == 0))
+	    return -450;
+    }
+
+    return 0;
+}
+
+/* The previous byte at a time hash function, for comparison */
+static pj_uint32_t bytewise_hash(pj_uint32_t hash, const void *key,
+				 unsigned keylen)
+{
+    const pj_uint8_t *p = (const pj_uint8_t*)key, *end = p + keylen;
+    for ( ; p!=end; ++p) {
+	hash = (hash * 33) + *p;
+    }
+    return hash;
+}
+
+/* Benchmark hash function and lookups in fixed and resizable table */
+static int hash_perf_test(void)
+{
+    enum {
+	HASH_LOOP = 200000,
+	KEY_COUNT = 10000,
+	LOOKUP_LOOP = 10
+    };
+    char key[] = "a84b4c76e66710@pc33.atlanta.com;z9hG4bK776asdhds";
+    pj_pool_t *pool;
+    pj_str_t *keys;
+    pj_timestamp t1, t2;
+    pj_uint32_t elapsed, sum = 0;
+    unsigned i, j, k;
+    int rc = 0;
+
+    /* Hash function */
+    pj_get_timestamp(&t1);
+    for (i=0; i<HASH_LOOP; ++i) {
+	key[0] = (char)i;
+	sum += bytewise_hash(0, key, sizeof(key)-1);
+    }
+    pj_get_timestamp(&t2);
+    elapsed = pj_elapsed_usec(&t1, &t2);
+    PJ_LOG(3,(THIS_FILE, "   bytewise hash: %u keys of %u bytes in %u usec",
+	      HASH_LOOP, (unsigned)sizeof(key)-1, elapsed));
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<HASH_LOOP; ++i) {
+	key[0] = (char)i;
+	sum += pj_hash_calc(0, key, sizeof(key)-1);
+    }
+    pj_get_timestamp(&t2);
+    elapsed = pj_elapsed_usec(&t1, &t2);
+    PJ_LOG(3,(THIS_FILE, "   pj_hash_calc:  %u keys of %u bytes in %u usec",
+	      HASH_LOOP, (unsigned)sizeof(key)-1, elapsed));
+
+    /* Large blocks, so that allocating the entries is cheap */
+    pool = pj_pool_create(mem, "hashperf", 64000, 64000, NULL);
+    if (!pool)
+	return -510;
+
+    keys = (pj_str_t*) pj_pool_alloc(pool, KEY_COUNT * sizeof(pj_str_t));
+    for (i=0; i<KEY_COUNT; ++i) {
+	char buf[32];
+	pj_ansi_snprintf(buf, sizeof(buf), "%08x-%u@atlanta.com",
+			 pj_rand(), i);
+	pj_strdup2(pool, &keys[i], buf);
+    }
+
+    /* Lookups in table which is too small, and in resizable table */
+    for (k=0; k<2; ++k) {
+	pj_hash_table_t *ht;
+	unsigned found = 0;
+
+	ht = k==0 ? pj_hash_create(pool, HASH_COUNT) :
+		    pj_hash_create_resizable(pool, HASH_COUNT);
+
+	pj_get_timestamp(&t1);
+	for (i=0; i<KEY_COUNT; ++i) {
+	    pj_hash_set(pool, ht, keys[i].ptr, (unsigned)keys[i].slen, 0,
+			&keys[i]);
+	}
+	pj_get_timestamp(&t2);
+	elapsed = pj_elapsed_usec(&t1, &t2);
+
+	pj_get_timestamp(&t1);
+	for (j=0; j<LOOKUP_LOOP; ++j) {
+	    for (i=0; i<KEY_COUNT; ++i) {
+		if (pj_hash_get(ht, keys[i].ptr, (unsigned)keys[i].slen,
+				NULL) == &keys[i])
+		{
+		    ++found;
+		}
+	    }
+	}
+	pj_get_timestamp(&t2);
+
+	PJ_LOG(3,(THIS_FILE, "   %s table: %u inserts in %u usec, %u lookups "
+		  "in %u usec", (k==0 ? "fixed" : "resizable"), KEY_COUNT,
+		  elapsed, KEY_COUNT * LOOKUP_LOOP,
+		  pj_elapsed_usec(&t1, &t2)));
+
+	if (found != KEY_COUNT * LOOKUP_LOOP) {
+	    rc = -500;
+	    break;
+	}
+    }
+
+    pj_pool_release(pool);
+
+    /* Prevent the hash loops from being optimized away */
+    if (sum == 0x12345678)
+	PJ_LOG(5,(THIS_FILE, "   hash sum: %u", sum));
+
+    return rc;
+}
+
+
 /*
  * Hash table test.
  */
@@ -155,6 +361,24 @@ int hash_test(void)
 	return rc;
     }
 
+    rc = hash_tolower_test();
+    if (rc != 0) {
+	pj_pool_release(pool);
+	return rc;
+    }
+
+    rc = hash_resize_test(pool);
+    if (rc != 0) {
+	pj_pool_release(pool);
+	return rc;
+    }
+
+    rc = hash_perf_test();
+    if (rc != 0) {
+	pj_pool_release(pool);
+	return rc;
+    }
+
     pj_pool_release(pool);
     return 0;
 }
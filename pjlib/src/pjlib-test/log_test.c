@@ -0,0 +1,347 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjlib.h>
+
+/**
+ * \page page_pjlib_log_test Test: Asynchronous Logging
+ *
+ * This file provides implementation of \b log_test(). It tests the
+ * asynchronous logging mode, with and without deferred formatting.
+ *
+ * \section log_test_sec Scope of the Test
+ *
+ * API tested:
+ *  - pj_log_async_start()
+ *  - pj_log_async_flush()
+ *  - pj_log_async_get_stat()
+ *  - pj_log_async_stop()
+ *  - pj_log_decode_file()
+ *
+ *
+ * This file is <b>pjlib-test/log_test.c</b>
+ *
+ * \include pjlib-test/log_test.c
+ */
+
+#if INCLUDE_LOG_TEST
+
+#define THIS_FILE   "log_test.c"
+#define THREAD_CNT  4
+#define MSG_CNT	    1000
+#define BIN_FILE    "logtest.bin"
+
+/* Last sequence number received from each thread, and total count */
+static int last_seq[THREAD_CNT+1];
+static unsigned recv_cnt;
+static int order_err;
+
+/* Last "fmt" and "dyn" lines received */
+static char fmt_line[PJ_LOG_MAX_SIZE];
+static char dyn_line[80];
+
+/* Log writer, parses the lines written by log_thread() */
+static void test_writer(int level, const char *data, int len)
+{
+    const char *p = data, *end = data + len;
+
+    PJ_UNUSED_ARG(level);
+
+    while (p < end) {
+	int id, seq;
+
+	if (sscanf(p, "logtest %d %d", &id, &seq) == 2 &&
+	    id >= 0 && id <= THREAD_CNT)
+	{
+	    if (seq <= last_seq[id])
+		order_err = 1;
+	    last_seq[id] = seq;
+	    ++recv_cnt;
+	} else if (pj_ansi_strncmp(p, "fmt ", 4) == 0 ||
+		   pj_ansi_strncmp(p, "dyn ", 4) == 0)
+	{
+	    char *dst = (*p == 'f') ? fmt_line : dyn_line;
+	    unsigned size = (*p == 'f') ? sizeof(fmt_line) : sizeof(dyn_line);
+	    unsigned i;
+
+	    for (i=0; i<size-1 && p+i < end && p[i] != '\n'; ++i)
+		dst[i] = p[i];
+	    dst[i] = '\0';
+	}
+
+	while (p < end && *p != '\n')
+	    ++p;
+	++p;
+    }
+}
+
+static int log_thread(void *arg)
+{
+    int id = (int)(pj_ssize_t)arg;
+    int i;
+
+    for (i=1; i<=MSG_CNT; ++i) {
+	PJ_LOG(3,(THIS_FILE, "logtest %d %d", id, i));
+    }
+
+    return 0;
+}
+
+static void reset_writer(void)
+{
+    pj_bzero(last_seq, sizeof(last_seq));
+    recv_cnt = 0;
+    order_err = 0;
+    fmt_line[0] = dyn_line[0] = '\0';
+}
+
+/* Log messages with various conversions, and put the expected line of
+ * the first one to buf.
+ */
+#define FMT "fmt %d|%5i|%-4u|%x|%#o|%hhd|%hu|%ld|%lld|%zu|%c|%.2f|%8.3e|" \
+	    "%s|%.3s|%.*s|%*d|%-*.*s|%p|%%|%s|"
+#define FMT_ARGS -12, 34, 5u, 0xabcu, 8u, 300, 70000, -123456789L, \
+		 (pj_int64_t)1 << 40, (pj_size_t)99, 'z', 3.14159, 12345.678, \
+		 "hello", "abcdef", 2, "xyz", 6, 7, 5, 2, "trunc", (void*)buf, \
+		 ""
+
+static void log_formats(char *buf, unsigned size)
+{
+    char dyn_fmt[16];
+
+    pj_ansi_snprintf(buf, size, FMT, FMT_ARGS);
+    PJ_LOG(3,(THIS_FILE, FMT, FMT_ARGS));
+
+    /* Format which is not a literal */
+    pj_ansi_strcpy(dyn_fmt, "dyn %d");
+    PJ_LOG(3,(THIS_FILE, dyn_fmt, 1));
+    pj_ansi_strcpy(dyn_fmt, "xxx %d");
+}
+
+static int check_formats(const char *expected)
+{
+    if (pj_ansi_strcmp(fmt_line, expected) != 0) {
+	PJ_LOG(3,(THIS_FILE, "...error: got \"%s\", expecting \"%s\"",
+		  fmt_line, expected));
+	return -1;
+    }
+    if (pj_ansi_strcmp(dyn_line, "dyn 1") != 0)
+	return -2;
+
+    return 0;
+}
+
+static int async_test(pj_pool_t *pool, pj_bool_t deferred)
+{
+    pj_thread_t *thread[THREAD_CNT];
+    pj_log_async_param param;
+    pj_log_async_stat stat;
+    pj_status_t status;
+    int i;
+
+    reset_writer();
+
+    /* Multiple threads, each with its own ring */
+    pj_log_async_param_default(&param);
+    param.deferred = deferred;
+    param.ring_size = 256 * 1024;
+    status = pj_log_async_start(mem, &param);
+    if (status != PJ_SUCCESS)
+	return -10;
+
+    if (pj_log_async_start(mem, NULL) != PJ_EEXISTS) {
+	pj_log_async_stop();
+	return -20;
+    }
+
+    for (i=0; i<THREAD_CNT; ++i) {
+	status = pj_thread_create(pool, "logtest", &log_thread,
+				  (void*)(pj_ssize_t)i, 0, 0, &thread[i]);
+	if (status != PJ_SUCCESS) {
+	    pj_log_async_stop();
+	    return -30;
+	}
+    }
+    for (i=0; i<THREAD_CNT; ++i) {
+	pj_thread_join(thread[i]);
+	pj_thread_destroy(thread[i]);
+    }
+
+    pj_log_async_flush();
+    pj_log_async_get_stat(&stat);
+    pj_log_async_stop();
+
+    if (stat.queued != THREAD_CNT * MSG_CNT || stat.dropped != 0 ||
+	stat.written != stat.queued)
+    {
+	return -40;
+    }
+    if (recv_cnt != THREAD_CNT * MSG_CNT)
+	return -50;
+    if (order_err)
+	return -60;
+
+    /* Small ring which is never drained until stopped, so messages must
+     * be dropped instead of blocking.
+     */
+    reset_writer();
+
+    pj_log_async_param_default(&param);
+    param.deferred = deferred;
+    param.ring_size = 4096;
+    param.flush_interval = 60000;
+    status = pj_log_async_start(mem, &param);
+    if (status != PJ_SUCCESS)
+	return -70;
+
+    log_thread((void*)(pj_ssize_t)THREAD_CNT);
+
+    pj_log_async_get_stat(&stat);
+    pj_log_async_stop();
+
+    if (stat.dropped == 0 || stat.queued + stat.dropped != MSG_CNT)
+	return -80;
+    if (recv_cnt != stat.queued)
+	return -90;
+    if (order_err)
+	return -100;
+
+    return 0;
+}
+
+/* Deferred formatting of the arguments */
+static int deferred_test(void)
+{
+    pj_log_async_param param;
+    char expected[PJ_LOG_MAX_SIZE];
+    pj_status_t status;
+
+    reset_writer();
+
+    pj_log_async_param_default(&param);
+    param.deferred = PJ_TRUE;
+    status = pj_log_async_start(mem, &param);
+    if (status != PJ_SUCCESS)
+	return -200;
+
+    log_formats(expected, sizeof(expected));
+    pj_log_async_stop();
+
+    if (check_formats(expected) != 0)
+	return -210;
+
+    return 0;
+}
+
+/* Binary log file */
+static int binary_test(void)
+{
+    pj_log_async_param param;
+    pj_log_async_stat stat;
+    char expected[PJ_LOG_MAX_SIZE];
+    pj_status_t status;
+    int rc = 0;
+
+    reset_writer();
+
+    pj_log_async_param_default(&param);
+    param.binary_file = pj_str(BIN_FILE);
+    param.ring_size = 256 * 1024;
+    status = pj_log_async_start(mem, &param);
+    if (status != PJ_SUCCESS)
+	return -300;
+
+    log_thread((void*)(pj_ssize_t)0);
+    log_formats(expected, sizeof(expected));
+
+    pj_log_async_get_stat(&stat);
+    pj_log_async_stop();
+
+    /* Nothing is written to the log until decoded */
+    if (recv_cnt != 0 || fmt_line[0]) {
+	rc = -310;
+	goto on_return;
+    }
+
+    status = pj_log_decode_file(BIN_FILE, &test_writer);
+    if (status != PJ_SUCCESS) {
+	rc = -320;
+	goto on_return;
+    }
+
+    if (stat.dropped != 0 || recv_cnt != MSG_CNT || order_err) {
+	rc = -330;
+	goto on_return;
+    }
+    if (check_formats(expected) != 0) {
+	rc = -340;
+	goto on_return;
+    }
+
+on_return:
+    pj_file_delete(BIN_FILE);
+    return rc;
+}
+
+int log_test(void)
+{
+    pj_log_func *saved_writer = pj_log_get_log_func();
+    unsigned saved_decor = pj_log_get_decor();
+    int saved_level = pj_log_get_level();
+    pj_pool_t *pool;
+    int rc;
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+	return -1;
+
+    pj_log_set_log_func(&test_writer);
+    pj_log_set_decor(PJ_LOG_HAS_NEWLINE);
+    pj_log_set_level(3);
+
+    rc = async_test(pool, PJ_FALSE);
+    if (rc == 0)
+	rc = async_test(pool, PJ_TRUE);
+    if (rc == 0)
+	rc = deferred_test();
+    if (rc == 0)
+	rc = binary_test();
+
+    pj_log_set_log_func(saved_writer);
+    pj_log_set_decor(saved_decor);
+    pj_log_set_level(saved_level);
+
+    pj_pool_release(pool);
+
+    if (rc != 0) {
+	PJ_LOG(3,(THIS_FILE, "...error: async log test failed, rc=%d "
+		  "(received %u messages)", rc, recv_cnt));
+    }
+
+    return rc;
+}
+
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_log_test;
+#endif  /* INCLUDE_LOG_TEST */
@@ -0,0 +1,341 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjlib.h>
+
+/**
+ * \page page_pjlib_mpsc_queue_test Test: MPSC Queue
+ *
+ * This file provides implementation of \b mpsc_queue_test(). It tests the
+ * multiple producer single consumer queue, and posting callbacks to the
+ * ioqueue.
+ *
+ * \section mpsc_queue_test_sec Scope of the Test
+ *
+ * API tested:
+ *  - pj_mpsc_queue_create()
+ *  - pj_mpsc_queue_push()
+ *  - pj_mpsc_queue_pop()
+ *  - pj_mpsc_queue_destroy()
+ *  - pj_ioqueue_post()
+ *
+ *
+ * This file is <b>pjlib-test/mpsc_queue.c</b>
+ *
+ * \include pjlib-test/mpsc_queue.c
+ */
+
+#if INCLUDE_MPSC_QUEUE_TEST
+
+#define THIS_FILE   "mpsc_queue.c"
+#define NODE_CNT    16
+#define THREAD_CNT  4
+#define ITEM_CNT    20000
+
+typedef struct item
+{
+    pj_mpsc_node    node;
+    int		    thread;
+    int		    seq;
+} item;
+
+static int basic_test(pj_pool_t *pool)
+{
+    pj_mpsc_queue *q;
+    item it[NODE_CNT];
+    item *p;
+    int i;
+
+    if (pj_mpsc_queue_create(pool, &q) != PJ_SUCCESS)
+	return -10;
+
+    if (pj_mpsc_queue_pop(q) != NULL)
+	return -20;
+
+    for (i=0; i<NODE_CNT; ++i) {
+	it[i].seq = i;
+	pj_mpsc_queue_push(q, &it[i].node);
+    }
+
+    /* Pop half of the nodes and push them again at the end */
+    for (i=0; i<NODE_CNT/2; ++i) {
+	p = (item*) pj_mpsc_queue_pop(q);
+	if (!p || p->seq != i)
+	    return -30;
+	pj_mpsc_queue_push(q, &p->node);
+    }
+    for (i=0; i<NODE_CNT; ++i) {
+	p = (item*) pj_mpsc_queue_pop(q);
+	if (!p || p->seq != (i + NODE_CNT/2) % NODE_CNT)
+	    return -40;
+    }
+    if (pj_mpsc_queue_pop(q) != NULL)
+	return -50;
+
+    /* Single node */
+    pj_mpsc_queue_push(q, &it[0].node);
+    if (pj_mpsc_queue_pop(q) != &it[0].node || pj_mpsc_queue_pop(q) != NULL)
+	return -60;
+
+    pj_mpsc_queue_destroy(q);
+    return 0;
+}
+
+static pj_mpsc_queue *mt_queue;
+static item *mt_items;
+
+static int producer_thread(void *arg)
+{
+    int id = (int)(pj_ssize_t)arg;
+    int i;
+
+    for (i=0; i<ITEM_CNT; ++i) {
+	item *it = &mt_items[id * ITEM_CNT + i];
+	it->thread = id;
+	it->seq = i;
+	pj_mpsc_queue_push(mt_queue, &it->node);
+    }
+    return 0;
+}
+
+/* Items of each producer must come out in order, and none may be lost */
+static int mt_test(pj_pool_t *pool)
+{
+    pj_thread_t *thread[THREAD_CNT];
+    int next[THREAD_CNT];
+    pj_timestamp t0, t1;
+    int i, cnt = 0, rc = 0;
+
+    if (pj_mpsc_queue_create(pool, &mt_queue) != PJ_SUCCESS)
+	return -100;
+
+    mt_items = (item*) pj_pool_calloc(pool, THREAD_CNT * ITEM_CNT,
+				      sizeof(item));
+    pj_bzero(next, sizeof(next));
+
+    pj_get_timestamp(&t0);
+
+    for (i=0; i<THREAD_CNT; ++i) {
+	if (pj_thread_create(pool, "mpsc", &producer_thread,
+			     (void*)(pj_ssize_t)i, 0, 0,
+			     &thread[i]) != PJ_SUCCESS)
+	{
+	    return -110;
+	}
+    }
+
+    while (cnt < THREAD_CNT * ITEM_CNT) {
+	item *it = (item*) pj_mpsc_queue_pop(mt_queue);
+
+	if (!it) {
+	    pj_thread_sleep(0);
+	    continue;
+	}
+	if (it->seq != next[it->thread]) {
+	    rc = -120;
+	    break;
+	}
+	++next[it->thread];
+	++cnt;
+    }
+
+    pj_get_timestamp(&t1);
+
+    for (i=0; i<THREAD_CNT; ++i) {
+	pj_thread_join(thread[i]);
+	pj_thread_destroy(thread[i]);
+    }
+
+    if (rc == 0 && pj_mpsc_queue_pop(mt_queue) != NULL)
+	rc = -130;
+
+    PJ_LOG(3,(THIS_FILE, "   %d threads x %d items: %u usec", THREAD_CNT,
+	      ITEM_CNT, pj_elapsed_usec(&t0, &t1)));
+
+    pj_mpsc_queue_destroy(mt_queue);
+    return rc;
+}
+
+static pj_ioqueue_t *post_ioq;
+static pj_thread_t *poll_thread;
+static int post_next[THREAD_CNT];
+static int post_cnt;
+static int post_err;
+
+static void on_post(void *arg)
+{
+    pj_ssize_t val = (pj_ssize_t)arg;
+    int thread = (int)(val / ITEM_CNT);
+    int seq = (int)(val % ITEM_CNT);
+
+    if (pj_thread_this() != poll_thread)
+	post_err = -200;
+    else if (seq != post_next[thread])
+	post_err = -210;
+
+    ++post_next[thread];
+    ++post_cnt;
+}
+
+static int post_thread(void *arg)
+{
+    int id = (int)(pj_ssize_t)arg;
+    int i;
+
+    for (i=0; i<ITEM_CNT; ++i) {
+	if (pj_ioqueue_post(post_ioq, &on_post,
+			    (void*)(pj_ssize_t)(id * ITEM_CNT + i)) != 0)
+	{
+	    post_err = -220;
+	    break;
+	}
+    }
+    return 0;
+}
+
+/* Callbacks posted from several threads are called by the polling thread */
+static int ioqueue_post_test(pj_pool_t *pool)
+{
+    pj_thread_t *thread[THREAD_CNT];
+    pj_time_val timeout = {1, 0};
+    pj_timestamp t0, t1;
+    pj_status_t status;
+    int i, rc = 0;
+
+    status = pj_ioqueue_create(pool, 4, &post_ioq);
+    if (status != PJ_SUCCESS)
+	return -300;
+
+    poll_thread = pj_thread_this();
+    pj_bzero(post_next, sizeof(post_next));
+    post_cnt = 0;
+    post_err = 0;
+
+    /* Callback posted before the poll */
+    status = pj_ioqueue_post(post_ioq, &on_post, (void*)0);
+    if (status == PJ_ENOTSUP) {
+	PJ_LOG(3,(THIS_FILE, "   pj_ioqueue_post() is not supported by %s",
+		  pj_ioqueue_name()));
+	pj_ioqueue_destroy(post_ioq);
+	return 0;
+    }
+    if (status != PJ_SUCCESS) {
+	rc = -310;
+	goto on_return;
+    }
+    if (pj_ioqueue_poll(post_ioq, &timeout) != 1 || post_cnt != 1) {
+	rc = -320;
+	goto on_return;
+    }
+
+    /* Post from other threads while polling. The poll is woken up as long
+     * as there are callbacks, so it must not time out. It may return zero
+     * when the callbacks of a wakeup were called by the previous poll.
+     */
+    pj_bzero(post_next, sizeof(post_next));
+    post_cnt = 0;
+
+    pj_get_timestamp(&t0);
+    for (i=0; i<THREAD_CNT; ++i) {
+	if (pj_thread_create(pool, "post", &post_thread,
+			     (void*)(pj_ssize_t)i, 0, 0,
+			     &thread[i]) != PJ_SUCCESS)
+	{
+	    rc = -330;
+	    goto on_return;
+	}
+    }
+
+    while (post_cnt < THREAD_CNT * ITEM_CNT && post_err == 0) {
+	pj_timestamp t2, t3;
+
+	pj_get_timestamp(&t2);
+	if (pj_ioqueue_poll(post_ioq, &timeout) == 0 &&
+	    post_cnt < THREAD_CNT * ITEM_CNT)
+	{
+	    pj_get_timestamp(&t3);
+	    if (pj_elapsed_msec(&t2, &t3) >= PJ_TIME_VAL_MSEC(timeout)) {
+		rc = -340;
+		break;
+	    }
+	}
+
+	pj_get_timestamp(&t2);
+	if (pj_elapsed_msec(&t0, &t2) > 10000) {
+	    rc = -350;
+	    break;
+	}
+    }
+    pj_get_timestamp(&t1);
+
+    for (i=0; i<THREAD_CNT; ++i) {
+	pj_thread_join(thread[i]);
+	pj_thread_destroy(thread[i]);
+    }
+
+    if (rc == 0)
+	rc = post_err;
+
+    PJ_LOG(3,(THIS_FILE, "   %d threads x %d posts: %u usec", THREAD_CNT,
+	      ITEM_CNT, pj_elapsed_usec(&t0, &t1)));
+
+    /* Pending callbacks are discarded on destroy */
+    if (rc == 0)
+	pj_ioqueue_post(post_ioq, &on_post, (void*)0);
+
+on_return:
+    pj_ioqueue_destroy(post_ioq);
+    return rc;
+}
+
+int mpsc_queue_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "...mpsc queue test"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+
+    rc = basic_test(pool);
+    if (rc != 0)
+	goto on_return;
+
+    rc = mt_test(pool);
+    if (rc != 0)
+	goto on_return;
+
+    rc = ioqueue_post_test(pool);
+
+on_return:
+    pj_pool_release(pool);
+    if (rc != 0)
+	PJ_LOG(3,(THIS_FILE, "...error: mpsc queue test failed, rc=%d", rc));
+    return rc;
+}
+
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_mpsc_queue_test;
+#endif  /* INCLUDE_MPSC_QUEUE_TEST */
+
@@ -201,6 +201,165 @@ static int semaphore_test(pj_pool_t *pool)
 }
 #endif	/* PJ_HAS_SEMAPHORE */
 
+#if PJ_HAS_THREADS
+/* Group lock in shared mode: readers must never see the two counters
+ * updated by the writer out of sync.
+ */
+#define GRP_READER_CNT	3
+#define GRP_WRITE_CNT	2000
+
+static struct grp_shared_data
+{
+    pj_grp_lock_t   *glock;
+    pj_atomic_t	    *active;
+    volatile int     a, b;
+    volatile int     quit;
+    volatile int     err;
+    int		     max_active;
+    unsigned	     read_cnt;
+} gsd;
+
+static int grp_reader_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    while (!gsd.quit) {
+	int a, active;
+
+	pj_grp_lock_acquire_shared(gsd.glock);
+	active = (int)pj_atomic_inc_and_get(gsd.active);
+	if (active > gsd.max_active)
+	    gsd.max_active = active;
+
+	a = gsd.a;
+	pj_thread_sleep(0);
+	if (a != gsd.a || a != gsd.b)
+	    gsd.err = 1;
+	++gsd.read_cnt;
+
+	pj_atomic_dec(gsd.active);
+	pj_grp_lock_release_shared(gsd.glock);
+    }
+
+    return 0;
+}
+
+static int grp_writer_thread(void *arg)
+{
+    int i;
+
+    PJ_UNUSED_ARG(arg);
+
+    for (i=0; i<GRP_WRITE_CNT; ++i) {
+	pj_grp_lock_acquire(gsd.glock);
+	if (pj_atomic_get(gsd.active) != 0)
+	    gsd.err = 2;
+	++gsd.a;
+	pj_thread_sleep(0);
+	++gsd.b;
+	pj_grp_lock_release(gsd.glock);
+    }
+
+    return 0;
+}
+
+static int grp_lock_shared_test(pj_pool_t *pool)
+{
+    pj_grp_lock_config cfg;
+    pj_thread_t *thread[GRP_READER_CNT+1];
+    pj_status_t status;
+    int i, rc = 0;
+
+    PJ_LOG(3,("", "...testing group lock in shared mode"));
+
+    pj_bzero(&gsd, sizeof(gsd));
+
+    pj_grp_lock_config_default(&cfg);
+    cfg.flags = PJ_GRP_LOCK_SHARED;
+    status = pj_grp_lock_create(pool, &cfg, &gsd.glock);
+    if (status != PJ_SUCCESS) {
+	app_perror("...error: pj_grp_lock_create()", status);
+	return -201;
+    }
+    pj_grp_lock_add_ref(gsd.glock);
+
+    status = pj_atomic_create(pool, 0, &gsd.active);
+    if (status != PJ_SUCCESS) {
+	pj_grp_lock_dec_ref(gsd.glock);
+	return -203;
+    }
+
+    /* Shared acquisition by the exclusive owner is recursive */
+    pj_grp_lock_acquire(gsd.glock);
+    pj_grp_lock_acquire_shared(gsd.glock);
+    if (pj_grp_lock_get_ref(gsd.glock) != 3)
+	rc = -205;
+    pj_grp_lock_release_shared(gsd.glock);
+    pj_grp_lock_release(gsd.glock);
+    if (rc == 0 && pj_grp_lock_get_ref(gsd.glock) != 1)
+	rc = -207;
+
+    /* Try-acquire doesn't wait for readers */
+    if (rc == 0) {
+	pj_grp_lock_acquire_shared(gsd.glock);
+	status = pj_grp_lock_tryacquire(gsd.glock);
+	pj_grp_lock_release_shared(gsd.glock);
+	if (status != PJ_EBUSY) {
+	    rc = -208;
+	} else if (pj_grp_lock_tryacquire(gsd.glock) != PJ_SUCCESS) {
+	    rc = -208;
+	} else {
+	    pj_grp_lock_release(gsd.glock);
+	    if (pj_grp_lock_get_ref(gsd.glock) != 1)
+		rc = -208;
+	}
+    }
+
+    /* Readers and a writer */
+    for (i=0; rc==0 && i<=GRP_READER_CNT; ++i) {
+	status = pj_thread_create(pool, "grpreader",
+				  (i==GRP_READER_CNT ? &grp_writer_thread :
+						       &grp_reader_thread),
+				  NULL, 0, 0, &thread[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror("...error: pj_thread_create()", status);
+	    gsd.quit = 1;
+	    while (i-- > 0)
+		pj_thread_join(thread[i]);
+	    rc = -209;
+	}
+    }
+
+    if (rc == 0) {
+	pj_thread_join(thread[GRP_READER_CNT]);
+	gsd.quit = 1;
+	for (i=0; i<=GRP_READER_CNT; ++i) {
+	    pj_thread_join(thread[i]);
+	    pj_thread_destroy(thread[i]);
+	}
+
+	PJ_LOG(3,("", "....%u reads, up to %d concurrent readers",
+		  gsd.read_cnt, gsd.max_active));
+
+	if (gsd.err) {
+	    PJ_LOG(3,("", "...error: inconsistent data in shared mode (%d)",
+		      gsd.err));
+	    rc = -211;
+	} else if (gsd.a != GRP_WRITE_CNT || gsd.b != GRP_WRITE_CNT) {
+	    rc = -213;
+	} else if (pj_grp_lock_get_ref(gsd.glock) != 1) {
+	    rc = -215;
+	}
+    }
+
+    pj_atomic_destroy(gsd.active);
+    if (pj_grp_lock_dec_ref(gsd.glock) != PJ_EGONE && rc == 0)
+	rc = -217;
+
+    return rc;
+}
+#endif	/* PJ_HAS_THREADS */
+
 
 int mutex_test(void)
 {
@@ -223,6 +382,12 @@ int mutex_test(void)
 	return rc;
 #endif
 
+#if PJ_HAS_THREADS
+    rc = grp_lock_shared_test(pool);
+    if (rc != 0)
+	return rc;
+#endif
+
     pj_pool_release(pool);
 
     return 0;
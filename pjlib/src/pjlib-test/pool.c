@@ -22,6 +22,8 @@
 #include <pj/rand.h>
 #include <pj/log.h>
 #include <pj/except.h>
+#include <pj/errno.h>
+#include <pj/string.h>
 #include "test.h"
 
 /**
@@ -278,6 +280,135 @@ static int pool_buf_test(void)
 }
 
 
+/* Find the profiler statistic of the pool name prefix */
+static pj_pool_prof_stat *find_prof_stat(pj_pool_prof_stat stat[],
+					 unsigned cnt, const char *name)
+{
+    unsigned i;
+    for (i=0; i<cnt; ++i) {
+	if (pj_ansi_strcmp(stat[i].name, name) == 0)
+	    return &stat[i];
+    }
+    return NULL;
+}
+
+/* Test the pool profiler of the caching pool */
+static int pool_prof_test(void)
+{
+    enum { POOL_CNT = 3 };
+    pj_caching_pool cp;
+    pj_pool_t *pool[POOL_CNT], *dlg_pool, *other;
+    pj_pool_prof_stat stat[8], *st;
+    pj_pool_prof_site site[4];
+    unsigned i, cnt;
+    int rc = 0;
+
+    PJ_LOG(3,("test", "...pool profiler test"));
+
+    pj_caching_pool_init(&cp, NULL, 0);
+
+    cnt = PJ_ARRAY_SIZE(stat);
+    if (pj_caching_pool_prof_get_stat(&cp, stat, &cnt) != PJ_EINVALIDOP) {
+	rc = -500;
+	goto on_return;
+    }
+
+    /* This pool is created before the profiler is started */
+    other = pj_pool_create(&cp.factory, "tsx%p", 512, 512, NULL);
+
+    if (pj_caching_pool_prof_start(&cp, PJ_TRUE) != PJ_SUCCESS) {
+	rc = -510;
+	goto on_return;
+    }
+
+    for (i=0; i<POOL_CNT; ++i) {
+	pool[i] = pj_pool_create(&cp.factory, "tsx%p", 512, 512, NULL);
+	pj_pool_alloc(pool[i], 100);
+    }
+    /* Make the last pool grow */
+    pj_pool_alloc(pool[POOL_CNT-1], 1000);
+    pj_pool_alloc(other, 100);
+
+    dlg_pool = pj_pool_create(&cp.factory, "dlg%p", 1000, 1000, NULL);
+    pj_pool_zalloc(dlg_pool, 200);
+
+    cnt = PJ_ARRAY_SIZE(stat);
+    if (pj_caching_pool_prof_get_stat(&cp, stat, &cnt) != PJ_SUCCESS ||
+	cnt != 2)
+    {
+	rc = -520;
+	goto on_release;
+    }
+    st = find_prof_stat(stat, cnt, "tsx");
+    if (!st || st->pool_cnt != POOL_CNT || st->created != POOL_CNT ||
+	st->alloc_cnt != POOL_CNT+1 || st->alloc_size != POOL_CNT*100+1000 ||
+	st->capacity <= POOL_CNT*512 || st->used < POOL_CNT*100+1000 ||
+	st->capacity < st->used)
+    {
+	rc = -530;
+	goto on_release;
+    }
+    st = find_prof_stat(stat, cnt, "dlg");
+    if (!st || st->pool_cnt != 1 || st->alloc_cnt != 1 ||
+	st->alloc_size != 200)
+    {
+	rc = -540;
+	goto on_release;
+    }
+
+    /* Both allocation sites in this function are recorded */
+    cnt = PJ_ARRAY_SIZE(site);
+    if (pj_caching_pool_prof_get_sites(&cp, site, &cnt) != PJ_SUCCESS ||
+	cnt < 2 || site[0].size < site[1].size || site[0].addr == NULL)
+    {
+	rc = -550;
+	goto on_release;
+    }
+
+    pj_pool_release(pool[0]);
+    pool[0] = NULL;
+
+    cnt = PJ_ARRAY_SIZE(stat);
+    pj_caching_pool_prof_get_stat(&cp, stat, &cnt);
+    st = find_prof_stat(stat, cnt, "tsx");
+    if (!st || st->pool_cnt != POOL_CNT-1 || st->peak_pool_cnt != POOL_CNT ||
+	st->peak_capacity <= st->capacity || st->max_pool_used < 100)
+    {
+	rc = -560;
+	goto on_release;
+    }
+
+    pj_caching_pool_prof_dump(&cp, PJ_TRUE);
+
+    /* Pools are not accounted anymore after the profiler is stopped */
+    pj_caching_pool_prof_stop(&cp);
+    pj_pool_alloc(pool[1], 100);
+    pj_pool_release(dlg_pool);
+    dlg_pool = NULL;
+
+    cnt = PJ_ARRAY_SIZE(stat);
+    pj_caching_pool_prof_get_stat(&cp, stat, &cnt);
+    st = find_prof_stat(stat, cnt, "dlg");
+    if (!st || st->pool_cnt != 1) {
+	rc = -570;
+	goto on_release;
+    }
+
+on_release:
+    for (i=0; i<POOL_CNT; ++i) {
+	if (pool[i])
+	    pj_pool_release(pool[i]);
+    }
+    if (dlg_pool)
+	pj_pool_release(dlg_pool);
+    pj_pool_release(other);
+
+on_return:
+    pj_caching_pool_destroy(&cp);
+    return rc;
+}
+
+
 int pool_test(void)
 {
     enum { LOOP = 2 };
@@ -309,6 +440,10 @@ int pool_test(void)
     if (rc != 0)
 	return rc;
 
+    rc = pool_prof_test();
+    if (rc != 0)
+	return rc;
+
 
     return 0;
 }
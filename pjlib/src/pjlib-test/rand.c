@@ -19,20 +19,149 @@
  */
 #include <pj/rand.h>
 #include <pj/log.h>
+#include <pjlib.h>
 #include "test.h"
 
 #if INCLUDE_RAND_TEST
 
-#define COUNT  1024
+#include <stdlib.h>
+
+#define THIS_FILE   "rand.c"
+#define COUNT	    1024
+#define GUID_THREAD 4
+#define GUID_CNT    20000
+#define BENCH_CNT   1000000
+
 static int values[COUNT];
 
+/* Fast unique strings generated by each thread */
+static char *guids;
+static unsigned guid_len;
+
+static int cmp_guid(const void *a, const void *b)
+{
+    return pj_memcmp(a, b, guid_len);
+}
+
+static int guid_thread(void *arg)
+{
+    char *p = guids + (pj_size_t)arg * GUID_CNT * guid_len;
+    unsigned i;
+
+    for (i=0; i<GUID_CNT; ++i, p+=guid_len) {
+	pj_str_t str;
+
+	str.ptr = p;
+	pj_generate_unique_string_fast(&str);
+	if (str.slen != (pj_ssize_t)guid_len)
+	    return -1;
+    }
+    return 0;
+}
+
+/*
+ * Generate unique strings in several threads and check that there's no
+ * duplicate.
+ */
+static int fast_guid_test(void)
+{
+    pj_pool_t *pool;
+    pj_thread_t *thread[GUID_THREAD];
+    unsigned i, total = GUID_THREAD * GUID_CNT;
+    int rc = 0;
+
+    guid_len = PJ_GUID_STRING_LENGTH;
+    pool = pj_pool_create(mem, "guid", total * guid_len + 4000, 4000, NULL);
+    if (!pool)
+	return -30;
+    guids = (char*)pj_pool_alloc(pool, total * guid_len);
+
+    for (i=0; i<GUID_THREAD; ++i) {
+	pj_status_t status;
+
+	status = pj_thread_create(pool, "guid", &guid_thread,
+				  (void*)(pj_size_t)i, 0, 0, &thread[i]);
+	if (status != PJ_SUCCESS) {
+	    while (i-- > 0)
+		pj_thread_join(thread[i]);
+	    pj_pool_release(pool);
+	    return -40;
+	}
+    }
+    for (i=0; i<GUID_THREAD; ++i) {
+	pj_thread_join(thread[i]);
+	pj_thread_destroy(thread[i]);
+    }
+
+    /* Only lowercase hex digits */
+    for (i=0; i<total * guid_len; ++i) {
+	if (!pj_isxdigit(guids[i]) || pj_isupper(guids[i])) {
+	    PJ_LOG(3,(THIS_FILE, "error: invalid character in unique string"));
+	    rc = -50;
+	    break;
+	}
+    }
+
+    qsort(guids, total, guid_len, &cmp_guid);
+    for (i=1; rc==0 && i<total; ++i) {
+	if (cmp_guid(guids + (i-1)*guid_len, guids + i*guid_len) == 0) {
+	    PJ_LOG(3,(THIS_FILE, "error: duplicate unique string %.*s",
+		      guid_len, guids + i*guid_len));
+	    rc = -60;
+	}
+    }
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+static void rand_bench(void)
+{
+    char buf[PJ_GUID_MAX_LENGTH];
+    pj_str_t str;
+    pj_timestamp t1, t2;
+    volatile int sum = 0;
+    unsigned i, elapsed[4];
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<BENCH_CNT; ++i)
+	sum += rand();
+    pj_get_timestamp(&t2);
+    elapsed[0] = pj_elapsed_usec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<BENCH_CNT; ++i)
+	sum += pj_rand();
+    pj_get_timestamp(&t2);
+    elapsed[1] = pj_elapsed_usec(&t1, &t2);
+
+    str.ptr = buf;
+    pj_get_timestamp(&t1);
+    for (i=0; i<BENCH_CNT/10; ++i)
+	pj_generate_unique_string(&str);
+    pj_get_timestamp(&t2);
+    elapsed[2] = pj_elapsed_usec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<BENCH_CNT/10; ++i)
+	pj_generate_unique_string_fast(&str);
+    pj_get_timestamp(&t2);
+    elapsed[3] = pj_elapsed_usec(&t1, &t2);
+
+    PJ_LOG(3,(THIS_FILE, "...%d calls: rand() %u usec, pj_rand() %u usec",
+	      BENCH_CNT, elapsed[0], elapsed[1]));
+    PJ_LOG(3,(THIS_FILE, "...%d calls: pj_generate_unique_string() %u usec, "
+			 "fast %u usec",
+	      BENCH_CNT/10, elapsed[2], elapsed[3]));
+}
+
 /*
  * rand_test(), simply generates COUNT number of random number and
  * check that there's no duplicate numbers.
  */
 int rand_test(void)
 {
-    int i;
+    int i, rc;
 
     for (i=0; i<COUNT; ++i) {
 	int j;
@@ -47,8 +176,23 @@ int rand_test(void)
 	}
     }
 
+    /* Same seed must give the same sequence */
+    pj_srand(1234);
+    for (i=0; i<16; ++i)
+	values[i] = pj_rand();
+    pj_srand(1234);
+    for (i=0; i<16; ++i) {
+	if (pj_rand() != values[i])
+	    return -20;
+    }
+
+    rc = fast_guid_test();
+    if (rc != 0)
+	return rc;
+
+    rand_bench();
+
     return 0;
 }
 
 #endif	/* INCLUDE_RAND_TEST */
-
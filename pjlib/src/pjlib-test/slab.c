@@ -0,0 +1,408 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjlib.h>
+
+/**
+ * \page page_pjlib_slab_test Test: Slab Allocator
+ *
+ * This file provides implementation of \b slab_alloc_test(). It tests the
+ * slab allocator, from single and multiple threads.
+ *
+ * \section slab_test_sec Scope of the Test
+ *
+ * API tested:
+ *  - pj_slab_create()
+ *  - pj_slab_alloc()
+ *  - pj_slab_zalloc()
+ *  - pj_slab_free()
+ *  - pj_slab_get_stat()
+ *  - pj_slab_destroy()
+ *
+ *
+ * This file is <b>pjlib-test/slab.c</b>
+ *
+ * \include pjlib-test/slab.c
+ */
+
+#if INCLUDE_SLAB_TEST
+
+#define THIS_FILE   "slab.c"
+#define OBJ_SIZE    100
+#define OBJ_CNT	    100
+#define THREAD_CNT  4
+#define LOOP	    2000
+#define BATCH	    24
+#define BENCH_CNT   100000
+
+static int basic_test(void)
+{
+    pj_slab_t *slab;
+    pj_slab_stat stat;
+    pj_size_t mem_used;
+    char *obj[OBJ_CNT];
+    int i, j, rc = 0;
+
+    if (pj_slab_create(mem, NULL, OBJ_SIZE, 0, &slab) != PJ_SUCCESS)
+	return -10;
+
+    for (i=0; i<OBJ_CNT; ++i) {
+	obj[i] = (char*) pj_slab_zalloc(slab);
+	if (!obj[i]) {
+	    rc = -20;
+	    goto on_return;
+	}
+	if (((pj_size_t)obj[i] & 7) != 0) {
+	    rc = -30;
+	    goto on_return;
+	}
+	for (j=0; j<OBJ_SIZE; ++j) {
+	    if (obj[i][j] != 0) {
+		rc = -40;
+		goto on_return;
+	    }
+	}
+	pj_memset(obj[i], i, OBJ_SIZE);
+    }
+
+    /* Objects must not overlap */
+    for (i=0; i<OBJ_CNT; ++i) {
+	for (j=0; j<OBJ_SIZE; ++j) {
+	    if (obj[i][j] != (char)i) {
+		rc = -50;
+		goto on_return;
+	    }
+	}
+    }
+
+    pj_slab_get_stat(slab, &stat);
+    if (stat.obj_size < OBJ_SIZE || stat.in_use != OBJ_CNT ||
+	stat.peak != OBJ_CNT || stat.capacity < OBJ_CNT)
+    {
+	rc = -60;
+	goto on_return;
+    }
+    mem_used = stat.mem_used;
+
+    for (i=0; i<OBJ_CNT; ++i)
+	pj_slab_free(slab, obj[i]);
+
+    pj_slab_get_stat(slab, &stat);
+    if (stat.in_use != 0) {
+	rc = -70;
+	goto on_return;
+    }
+
+    /* Freed objects must be reused */
+    for (i=0; i<OBJ_CNT; ++i) {
+	obj[i] = (char*) pj_slab_alloc(slab);
+	if (!obj[i]) {
+	    rc = -80;
+	    goto on_return;
+	}
+    }
+    pj_slab_get_stat(slab, &stat);
+    if (stat.mem_used != mem_used) {
+	rc = -90;
+	goto on_return;
+    }
+    for (i=0; i<OBJ_CNT; ++i)
+	pj_slab_free(slab, obj[i]);
+
+on_return:
+    pj_slab_destroy(slab);
+    return rc;
+}
+
+/* Objects which are still allocated when the slab is destroyed */
+static int destroy_test(void)
+{
+    pj_slab_t *slab;
+    char *obj1, *obj2;
+
+    if (pj_slab_create(mem, "slabdestroy", OBJ_SIZE, 4, &slab) != PJ_SUCCESS)
+	return -100;
+
+    obj1 = (char*) pj_slab_alloc(slab);
+    obj2 = (char*) pj_slab_alloc(slab);
+    if (!obj1 || !obj2)
+	return -110;
+
+    pj_slab_destroy(slab);
+
+    /* Still usable */
+    pj_memset(obj1, 1, OBJ_SIZE);
+    pj_memset(obj2, 2, OBJ_SIZE);
+
+    pj_slab_free(slab, obj1);
+    pj_slab_free(slab, obj2);
+
+    return 0;
+}
+
+/* Objects in the cache of a thread must go back to the slab when another
+ * slab takes over the cache slot, or when the thread exits, rather than
+ * making the slab grow.
+ */
+static pj_slab_t *cache_slab;
+
+static int cache_thread(void *arg)
+{
+    void *obj[4];
+    int i;
+
+    PJ_UNUSED_ARG(arg);
+
+    for (i=0; i<4; ++i)
+	obj[i] = pj_slab_alloc(cache_slab);
+    for (i=0; i<4; ++i) {
+	if (obj[i])
+	    pj_slab_free(cache_slab, obj[i]);
+    }
+    return 0;
+}
+
+static int cache_test(pj_pool_t *pool)
+{
+    pj_slab_t *other[PJ_SLAB_THREAD_CACHE_SLOTS];
+    pj_thread_t *thread;
+    pj_slab_stat stat;
+    void *obj[4];
+    int i, rc = 0;
+
+    if (pj_slab_create(mem, "slabcache", OBJ_SIZE, 4, &cache_slab) !=
+	PJ_SUCCESS)
+    {
+	return -400;
+    }
+
+    /* Another thread leaves its objects in its cache and exits */
+    if (pj_thread_create(pool, "slabcache", &cache_thread, NULL, 0, 0,
+			 &thread) != PJ_SUCCESS)
+    {
+	pj_slab_destroy(cache_slab);
+	return -410;
+    }
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+
+    /* This thread leaves its objects in the cache, then the next slabs
+     * take all the slots.
+     */
+    cache_thread(NULL);
+    for (i=0; i<PJ_SLAB_THREAD_CACHE_SLOTS; ++i) {
+	if (pj_slab_create(mem, "slabother", OBJ_SIZE, 4, &other[i]) !=
+	    PJ_SUCCESS)
+	{
+	    rc = -420;
+	    break;
+	}
+	pj_slab_free(other[i], pj_slab_alloc(other[i]));
+    }
+    while (i-- > 0)
+	pj_slab_destroy(other[i]);
+
+    for (i=0; i<4; ++i)
+	obj[i] = pj_slab_alloc(cache_slab);
+    pj_slab_get_stat(cache_slab, &stat);
+    for (i=0; i<4; ++i) {
+	if (obj[i])
+	    pj_slab_free(cache_slab, obj[i]);
+    }
+
+    if (rc == 0 && stat.capacity != 4) {
+	PJ_LOG(3,(THIS_FILE, "   error: cached objects were lost, "
+		  "capacity=%u", stat.capacity));
+	rc = -430;
+    }
+
+    pj_slab_destroy(cache_slab);
+    return rc;
+}
+
+static pj_slab_t *mt_slab;
+static char *shared_obj[THREAD_CNT][BATCH];
+static int mt_err;
+
+/* Allocate, check and free objects. Half of the objects are freed by the
+ * next thread.
+ */
+static int slab_thread(void *arg)
+{
+    int id = (int)(pj_ssize_t)arg;
+    int i, j, k;
+
+    for (i=0; i<LOOP; ++i) {
+	char *obj[BATCH];
+
+	for (j=0; j<BATCH; ++j) {
+	    obj[j] = (char*) pj_slab_alloc(mt_slab);
+	    if (!obj[j]) {
+		mt_err = -200;
+		return 0;
+	    }
+	    pj_memset(obj[j], id, OBJ_SIZE);
+	}
+	for (j=0; j<BATCH; ++j) {
+	    for (k=0; k<OBJ_SIZE; ++k) {
+		if (obj[j][k] != (char)id) {
+		    mt_err = -210;
+		    return 0;
+		}
+	    }
+	}
+	for (j=0; j<BATCH/2; ++j)
+	    pj_slab_free(mt_slab, obj[j]);
+
+	/* Swap the other half with the next thread */
+	pj_enter_critical_section();
+	for (j=BATCH/2; j<BATCH; ++j) {
+	    char *tmp = shared_obj[(id+1) % THREAD_CNT][j];
+	    shared_obj[(id+1) % THREAD_CNT][j] = obj[j];
+	    obj[j] = tmp;
+	}
+	pj_leave_critical_section();
+
+	for (j=BATCH/2; j<BATCH; ++j) {
+	    if (obj[j])
+		pj_slab_free(mt_slab, obj[j]);
+	}
+    }
+
+    return 0;
+}
+
+static int mt_test(pj_pool_t *pool)
+{
+    pj_thread_t *thread[THREAD_CNT];
+    pj_slab_stat stat;
+    int i, j, rc = 0;
+
+    if (pj_slab_create(mem, "slabmt", OBJ_SIZE, 0, &mt_slab) != PJ_SUCCESS)
+	return -300;
+
+    pj_bzero(shared_obj, sizeof(shared_obj));
+    mt_err = 0;
+
+    for (i=0; i<THREAD_CNT; ++i) {
+	if (pj_thread_create(pool, "slab", &slab_thread, (void*)(pj_ssize_t)i,
+			     0, 0, &thread[i]) != PJ_SUCCESS)
+	{
+	    rc = -310;
+	    break;
+	}
+    }
+    for (j=0; j<i; ++j) {
+	pj_thread_join(thread[j]);
+	pj_thread_destroy(thread[j]);
+    }
+    if (rc == 0)
+	rc = mt_err;
+
+    for (i=0; i<THREAD_CNT; ++i) {
+	for (j=0; j<BATCH; ++j) {
+	    if (shared_obj[i][j])
+		pj_slab_free(mt_slab, shared_obj[i][j]);
+	}
+    }
+
+    pj_slab_get_stat(mt_slab, &stat);
+    if (rc == 0 && stat.in_use != 0)
+	rc = -320;
+
+    PJ_LOG(3,(THIS_FILE, "   %u threads: peak %u objects, capacity %u, "
+	      "%u bytes", THREAD_CNT, stat.peak, stat.capacity,
+	      (unsigned)stat.mem_used));
+
+    pj_slab_destroy(mt_slab);
+    return rc;
+}
+
+/* Compare with creating a pool for each object */
+static int bench(void)
+{
+    pj_slab_t *slab;
+    pj_timestamp t0, t1, t2;
+    int i;
+
+    if (pj_slab_create(mem, NULL, OBJ_SIZE, 0, &slab) != PJ_SUCCESS)
+	return -400;
+
+    pj_get_timestamp(&t0);
+    for (i=0; i<BENCH_CNT; ++i) {
+	pj_pool_t *pool = pj_pool_create(mem, NULL, 512, 512, NULL);
+	pj_pool_alloc(pool, OBJ_SIZE);
+	pj_pool_release(pool);
+    }
+    pj_get_timestamp(&t1);
+    for (i=0; i<BENCH_CNT; ++i) {
+	void *obj = pj_slab_alloc(slab);
+	pj_slab_free(slab, obj);
+    }
+    pj_get_timestamp(&t2);
+
+    pj_slab_destroy(slab);
+
+    PJ_LOG(3,(THIS_FILE, "   %d objects: pool per object %u usec, slab %u usec",
+	      BENCH_CNT, pj_elapsed_usec(&t0, &t1),
+	      pj_elapsed_usec(&t1, &t2)));
+
+    return 0;
+}
+
+int slab_alloc_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "...slab allocator test"));
+
+    rc = basic_test();
+    if (rc != 0)
+	goto on_return;
+
+    rc = destroy_test();
+    if (rc != 0)
+	goto on_return;
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    rc = cache_test(pool);
+    if (rc == 0)
+	rc = mt_test(pool);
+    pj_pool_release(pool);
+    if (rc != 0)
+	goto on_return;
+
+    rc = bench();
+
+on_return:
+    if (rc != 0)
+	PJ_LOG(3,(THIS_FILE, "...error: slab test failed, rc=%d", rc));
+    return rc;
+}
+
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_slab_test;
+#endif  /* INCLUDE_SLAB_TEST */
+
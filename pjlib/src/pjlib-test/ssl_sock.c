@@ -76,6 +76,7 @@ struct test_state
     pj_size_t	    sent;	    /* bytes sent			    */
     pj_size_t	    recv;	    /* bytes received			    */
     pj_uint8_t	    read_buf[256];  /* read buffer			    */
+    pj_bool_t	    use_slab;	    /* read into buffers from read slab	    */
     pj_bool_t	    done;	    /* test done flag			    */
     char	   *send_str;	    /* data to send once connected	    */
     pj_size_t	    send_str_len;   /* send data length			    */
@@ -150,7 +151,10 @@ static pj_bool_t ssl_on_connect_complete(pj_ssl_sock_t *ssock,
 
     /* Start reading data */
     read_buf[0] = st->read_buf;
-    status = pj_ssl_sock_start_read2(ssock, st->pool, sizeof(st->read_buf), (void**)read_buf, 0);
+    if (st->use_slab)
+	status = pj_ssl_sock_start_read(ssock, st->pool, sizeof(st->read_buf), 0);
+    else
+	status = pj_ssl_sock_start_read2(ssock, st->pool, sizeof(st->read_buf), (void**)read_buf, 0);
     if (status != PJ_SUCCESS) {
 	app_perror("...ERROR pj_ssl_sock_start_read2()", status);
 	goto on_return;
@@ -221,7 +225,10 @@ static pj_bool_t ssl_on_accept_complete(pj_ssl_sock_t *ssock,
 
     /* Start reading data */
     read_buf[0] = st->read_buf;
-    status = pj_ssl_sock_start_read2(newsock, st->pool, sizeof(st->read_buf), (void**)read_buf, 0);
+    if (st->use_slab)
+	status = pj_ssl_sock_start_read(newsock, st->pool, sizeof(st->read_buf), 0);
+    else
+	status = pj_ssl_sock_start_read2(newsock, st->pool, sizeof(st->read_buf), (void**)read_buf, 0);
     if (status != PJ_SUCCESS) {
 	app_perror("...ERROR pj_ssl_sock_start_read2()", status);
 	goto on_return;
@@ -495,10 +502,12 @@ on_return:
 
 static int echo_test(pj_ssl_sock_proto srv_proto, pj_ssl_sock_proto cli_proto,
 		     pj_ssl_cipher srv_cipher, pj_ssl_cipher cli_cipher,
-		     pj_bool_t req_client_cert, pj_bool_t client_provide_cert)
+		     pj_bool_t req_client_cert, pj_bool_t client_provide_cert,
+		     pj_bool_t use_slab)
 {
     pj_pool_t *pool = NULL;
     pj_ioqueue_t *ioqueue = NULL;
+    pj_activesock_slab *slab = NULL;
     pj_ssl_sock_t *ssock_serv = NULL;
     pj_ssl_sock_t *ssock_cli = NULL;
     pj_ssl_sock_param param;
@@ -524,6 +533,16 @@ static int echo_test(pj_ssl_sock_proto srv_proto, pj_ssl_sock_proto cli_proto,
     param.ioqueue = ioqueue;
     param.ciphers = ciphers;
 
+    if (use_slab) {
+	/* The read buffer size is rounded up to a multiple of 8 */
+	status = pj_activesock_slab_create(mem,
+				(unsigned)(param.read_buffer_size + 7) & ~7,
+				&slab);
+	if (status != PJ_SUCCESS)
+	    goto on_return;
+	param.read_slab = slab;
+    }
+
     /* Init default bind address */
     {
 	pj_str_t tmp_st;
@@ -541,6 +560,7 @@ static int echo_test(pj_ssl_sock_proto srv_proto, pj_ssl_sock_proto cli_proto,
     state_serv.echo = PJ_TRUE;
     state_serv.is_server = PJ_TRUE;
     state_serv.is_verbose = PJ_TRUE;
+    state_serv.use_slab = use_slab;
 
     status = pj_ssl_sock_create(pool, &param, &ssock_serv);
     if (status != PJ_SUCCESS) {
@@ -589,6 +609,7 @@ static int echo_test(pj_ssl_sock_proto srv_proto, pj_ssl_sock_proto cli_proto,
     state_cli.pool = pool;
     state_cli.check_echo = PJ_TRUE;
     state_cli.is_verbose = PJ_TRUE;
+    state_cli.use_slab = use_slab;
 
     {
 	pj_time_val now;
@@ -669,11 +690,24 @@ static int echo_test(pj_ssl_sock_proto srv_proto, pj_ssl_sock_proto cli_proto,
     PJ_LOG(3, ("", "...Done!"));
     PJ_LOG(3, ("", ".....Sent/recv: %d/%d bytes", state_cli.sent, state_cli.recv));
 
+    /* Data has been read into slab buffers, and none is held when idle */
+    if (slab) {
+	pj_activesock_slab_info info;
+
+	pj_activesock_slab_get_info(slab, &info);
+	PJ_LOG(3, ("", ".....Read slab: %u buffer(s), %u used",
+		   info.total_cnt, info.used_cnt));
+	if (info.total_cnt == 0 || info.used_cnt != 0)
+	    status = PJ_EBUG;
+    }
+
 on_return:
     if (ssock_serv)
 	pj_ssl_sock_close(ssock_serv);
     if (ssock_cli && !state_cli.err && !state_cli.done) 
 	pj_ssl_sock_close(ssock_cli);
+    if (slab)
+	pj_activesock_slab_destroy(slab);
     if (ioqueue)
 	pj_ioqueue_destroy(ioqueue);
     if (pool)
@@ -1381,42 +1415,49 @@ int ssl_sock_test(void)
     PJ_LOG(3,("", "..echo test w/ TLSv1 and PJ_TLS_RSA_WITH_AES_256_CBC_SHA cipher"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1, PJ_SSL_SOCK_PROTO_TLS1, 
 		    PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA, 
-		    PJ_FALSE, PJ_FALSE);
+		    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret != 0)
 	return ret;
 
     PJ_LOG(3,("", "..echo test w/ SSLv23 and PJ_TLS_RSA_WITH_AES_256_CBC_SHA cipher"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_SSL23, PJ_SSL_SOCK_PROTO_SSL23, 
 		    PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-		    PJ_FALSE, PJ_FALSE);
+		    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret != 0)
 	return ret;
 
     PJ_LOG(3,("", "..echo test w/ incompatible proto"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1, PJ_SSL_SOCK_PROTO_SSL3, 
 		    PJ_TLS_RSA_WITH_DES_CBC_SHA, PJ_TLS_RSA_WITH_DES_CBC_SHA,
-		    PJ_FALSE, PJ_FALSE);
+		    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret == 0)
 	return PJ_EBUG;
 
     PJ_LOG(3,("", "..echo test w/ incompatible ciphers"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
 		    PJ_TLS_RSA_WITH_DES_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-		    PJ_FALSE, PJ_FALSE);
+		    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret == 0)
 	return PJ_EBUG;
 
     PJ_LOG(3,("", "..echo test w/ client cert required but not provided"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
 		    PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-		    PJ_TRUE, PJ_FALSE);
+		    PJ_TRUE, PJ_FALSE, PJ_FALSE);
     if (ret == 0)
 	return PJ_EBUG;
 
     PJ_LOG(3,("", "..echo test w/ client cert required and provided"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
 		    PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-		    PJ_TRUE, PJ_TRUE);
+		    PJ_TRUE, PJ_TRUE, PJ_FALSE);
+    if (ret != 0)
+	return ret;
+
+    PJ_LOG(3,("", "..echo test w/ read slab"));
+    ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
+		    PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
+		    PJ_FALSE, PJ_FALSE, PJ_TRUE);
     if (ret != 0)
 	return ret;
 
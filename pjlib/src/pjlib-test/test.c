@@ -95,6 +95,10 @@ int test_inner(void)
     DO_TEST( pool_perf_test() );
 #endif
 
+#if INCLUDE_SLAB_TEST
+    DO_TEST( slab_alloc_test() );
+#endif
+
 #if INCLUDE_STRING_TEST
     DO_TEST( string_test() );
 #endif
@@ -107,6 +111,10 @@ int test_inner(void)
     DO_TEST( rbtree_test() );
 #endif
 
+#if INCLUDE_MPSC_QUEUE_TEST
+    DO_TEST( mpsc_queue_test() );
+#endif
+
 #if INCLUDE_HASH_TEST
     DO_TEST( hash_test() );
 #endif
@@ -171,6 +179,10 @@ int test_inner(void)
     DO_TEST( file_test() );
 #endif
 
+#if INCLUDE_LOG_TEST
+    DO_TEST( log_test() );
+#endif
+
 #if INCLUDE_SSLSOCK_TEST
     DO_TEST( ssl_sock_test() );
 #endif
@@ -40,9 +40,11 @@
 #define INCLUDE_HASH_TEST	    GROUP_DATA_STRUCTURE
 #define INCLUDE_POOL_TEST	    GROUP_LIBC
 #define INCLUDE_POOL_PERF_TEST	    GROUP_LIBC
+#define INCLUDE_SLAB_TEST	    GROUP_LIBC
 #define INCLUDE_STRING_TEST	    GROUP_DATA_STRUCTURE
 #define INCLUDE_FIFOBUF_TEST	    0	// GROUP_DATA_STRUCTURE
 #define INCLUDE_RBTREE_TEST	    GROUP_DATA_STRUCTURE
+#define INCLUDE_MPSC_QUEUE_TEST	    (PJ_HAS_THREADS && GROUP_DATA_STRUCTURE)
 #define INCLUDE_TIMER_TEST	    GROUP_DATA_STRUCTURE
 #define INCLUDE_ATOMIC_TEST         GROUP_OS
 #define INCLUDE_MUTEX_TEST	    (PJ_HAS_THREADS && GROUP_OS)
@@ -59,6 +61,7 @@
 #define INCLUDE_IOQUEUE_PERF_TEST   (PJ_HAS_THREADS && GROUP_NETWORK)
 #define INCLUDE_IOQUEUE_UNREG_TEST  (PJ_HAS_THREADS && GROUP_NETWORK)
 #define INCLUDE_FILE_TEST           GROUP_FILE
+#define INCLUDE_LOG_TEST            (PJ_HAS_THREADS && GROUP_OS)
 
 #define INCLUDE_ECHO_SERVER         0
 #define INCLUDE_ECHO_CLIENT         0
@@ -82,10 +85,12 @@ extern int hash_test(void);
 extern int os_test(void);
 extern int pool_test(void);
 extern int pool_perf_test(void);
+extern int slab_alloc_test(void);
 extern int string_test(void);
 extern int fifobuf_test(void);
 extern int timer_test(void);
 extern int rbtree_test(void);
+extern int mpsc_queue_test(void);
 extern int atomic_test(void);
 extern int mutex_test(void);
 extern int sleep_test(void);
@@ -99,6 +104,7 @@ extern int tcp_ioqueue_test(void);
 extern int ioqueue_perf_test(void);
 extern int activesock_test(void);
 extern int file_test(void);
+extern int log_test(void);
 extern int ssl_sock_test(void);
 
 extern int echo_server(void);
@@ -30,6 +30,7 @@
  *  - whether multithreading works.
  *  - whether thread timeslicing works, and threads have equal
  *    time-slice proportion.
+ *  - whether thread affinity and scheduling can be set.
  *
  * APIs tested:
  *  - pj_thread_create()
@@ -41,6 +42,9 @@
  *  - pj_thread_sleep()
  *  - pj_thread_join()
  *  - pj_thread_destroy()
+ *  - pj_thread_set_affinity()
+ *  - pj_thread_set_sched()
+ *  - pj_get_numa_node_cpus()
  *
  *
  * This file is <b>pjlib-test/thread.c</b>
@@ -308,6 +312,157 @@ static int timeslice_test(void)
     return 0;
 }
 
+/*
+ * Set the affinity and scheduling of this thread. These may not be
+ * supported by the platform, but must not fail otherwise.
+ */
+static int affinity_test(void)
+{
+    pj_thread_t *this_thread = pj_thread_this();
+    unsigned cpu[64];
+    unsigned cnt;
+    pj_status_t rc;
+
+    PJ_LOG(3,(THIS_FILE, "..affinity test"));
+
+    cpu[0] = 0;
+    rc = pj_thread_set_affinity(this_thread, 1, cpu);
+    if (rc == PJ_ENOTSUP) {
+	PJ_LOG(3,(THIS_FILE, "...info: thread affinity is not supported"));
+    } else if (rc != PJ_SUCCESS) {
+	app_perror("...error: unable to pin thread", rc);
+	return -100;
+    } else {
+	/* Still running? */
+	pj_thread_sleep(10);
+
+	rc = pj_thread_set_affinity(this_thread, 0, NULL);
+	if (rc != PJ_SUCCESS) {
+	    app_perror("...error: unable to reset thread affinity", rc);
+	    return -110;
+	}
+    }
+
+    rc = pj_thread_set_sched(this_thread, PJ_THREAD_SCHED_DEFAULT,
+			     pj_thread_get_prio(this_thread));
+    if (rc != PJ_SUCCESS) {
+	app_perror("...error: unable to set thread scheduling", rc);
+	return -120;
+    }
+
+    cnt = PJ_ARRAY_SIZE(cpu);
+    rc = pj_get_numa_node_cpus(0, &cnt, cpu);
+    if (rc == PJ_SUCCESS) {
+	if (cnt == 0) {
+	    PJ_LOG(3,(THIS_FILE, "...error: NUMA node 0 has no CPU"));
+	    return -130;
+	}
+	PJ_LOG(3,(THIS_FILE, "...info: NUMA node 0 has %u CPU(s) starting "
+		  "at CPU %u", cnt, cpu[0]));
+    } else if (rc != PJ_ENOTSUP && rc != PJ_ENOTFOUND) {
+	app_perror("...error: unable to get NUMA node CPUs", rc);
+	return -140;
+    }
+
+    cnt = PJ_ARRAY_SIZE(cpu);
+    rc = pj_get_numa_node_cpus(100000, &cnt, cpu);
+    if ((rc != PJ_ENOTSUP && rc != PJ_ENOTFOUND) || cnt != 0) {
+	PJ_LOG(3,(THIS_FILE, "...error: unexpected NUMA node 100000"));
+	return -150;
+    }
+
+    return 0;
+}
+
+/*
+ * The destructor of thread local variable must be called with the value
+ * when a thread exits, or when it destroys its own handle.
+ */
+static long tls_dtor_id;
+static void *tls_dtor_value;
+static pj_bool_t tls_dtor_self_called;
+
+static void tls_dtor(void *value)
+{
+    tls_dtor_value = value;
+}
+
+static int tls_dtor_thread(void *arg)
+{
+    pj_thread_local_set(tls_dtor_id, arg);
+    return 0;
+}
+
+static int tls_dtor_self_thread(void *arg)
+{
+    pj_thread_local_set(tls_dtor_id, arg);
+    pj_thread_destroy(pj_thread_this());
+    tls_dtor_self_called = (tls_dtor_value == arg);
+    return 0;
+}
+
+static int tls_dtor_test(void)
+{
+    pj_pool_t *pool;
+    pj_thread_t *thread;
+    pj_status_t rc;
+
+    PJ_LOG(3,(THIS_FILE, "..thread local destructor test"));
+
+    rc = pj_thread_local_alloc2(&tls_dtor_id, &tls_dtor);
+    if (rc == PJ_ENOTSUP) {
+	PJ_LOG(3,(THIS_FILE, "...info: destructor is not supported"));
+	return 0;
+    } else if (rc != PJ_SUCCESS) {
+	app_perror("...error: unable to allocate thread local", rc);
+	return -200;
+    }
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    tls_dtor_value = NULL;
+    rc = pj_thread_create(pool, "tlsdtor", &tls_dtor_thread, &tls_dtor_id,
+			  0, 0, &thread);
+    if (rc != PJ_SUCCESS) {
+	app_perror("...error: unable to create thread", rc);
+	pj_thread_local_free(tls_dtor_id);
+	pj_pool_release(pool);
+	return -210;
+    }
+
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+
+    if (tls_dtor_value != &tls_dtor_id) {
+	PJ_LOG(3,(THIS_FILE, "...error: destructor was not called"));
+	pj_thread_local_free(tls_dtor_id);
+	pj_pool_release(pool);
+	return -220;
+    }
+
+    tls_dtor_value = NULL;
+    tls_dtor_self_called = PJ_FALSE;
+    rc = pj_thread_create(pool, "tlsdtor", &tls_dtor_self_thread,
+			  &tls_dtor_id, 0, 0, &thread);
+    if (rc != PJ_SUCCESS) {
+	app_perror("...error: unable to create thread", rc);
+	pj_thread_local_free(tls_dtor_id);
+	pj_pool_release(pool);
+	return -230;
+    }
+
+    pj_thread_join(thread);
+    pj_thread_local_free(tls_dtor_id);
+    pj_pool_release(pool);
+
+    if (!tls_dtor_self_called) {
+	PJ_LOG(3,(THIS_FILE, "...error: destructor was not called by "
+			     "pj_thread_destroy()"));
+	return -240;
+    }
+
+    return 0;
+}
+
 int thread_test(void)
 {
     int rc;
@@ -324,6 +479,14 @@ int thread_test(void)
     if (rc != PJ_SUCCESS)
 	return rc;
 
+    rc = affinity_test();
+    if (rc != PJ_SUCCESS)
+	return rc;
+
+    rc = tls_dtor_test();
+    if (rc != PJ_SUCCESS)
+	return rc;
+
     return rc;
 }
 
@@ -36,6 +36,8 @@
  *  - pj_get_timestamp_freq()
  *  - pj_get_timestamp()
  *  - pj_elapsed_usec()
+ *  - pj_gettickcount_coarse()
+ *  - pj_gettickcount_cached()
  *  - PJ_LOG()
  *
  *
@@ -108,6 +110,82 @@ static int timestamp_accuracy()
     return 0;
 }
 
+/* Coarse and cached clock must never be ahead of pj_gettickcount(), and
+ * must not lag too much behind.
+ */
+static int coarse_clock_test(void)
+{
+    enum { LOOP = 1000000, MAX_LAG = 50 };
+    pj_time_val tv, coarse, cached, last;
+    pj_timestamp t1, t2;
+    unsigned i, elapsed[3];
+
+    PJ_LOG(3,(THIS_FILE, "...testing coarse and cached clock"));
+
+    pj_gettickcount_update_cache(NULL);
+    last.sec = last.msec = 0;
+
+    for (i=0; i<100; ++i) {
+	pj_gettickcount_coarse(&coarse);
+	pj_gettickcount_cached(&cached);
+	pj_gettickcount(&tv);
+
+	if (PJ_TIME_VAL_GT(coarse, tv) || PJ_TIME_VAL_GT(cached, tv)) {
+	    PJ_LOG(3,(THIS_FILE, "....error: coarse/cached clock is ahead"));
+	    return -1100;
+	}
+	if (PJ_TIME_VAL_LT(cached, last)) {
+	    PJ_LOG(3,(THIS_FILE, "....error: cached clock runs backwards"));
+	    return -1110;
+	}
+	last = cached;
+
+	PJ_TIME_VAL_SUB(tv, coarse);
+	if (PJ_TIME_VAL_MSEC(tv) > MAX_LAG) {
+	    PJ_LOG(3,(THIS_FILE, "....error: coarse clock lags %ld msec",
+		      PJ_TIME_VAL_MSEC(tv)));
+	    return -1120;
+	}
+
+	pj_thread_sleep(pj_rand() % 5);
+	pj_gettickcount_update_cache(NULL);
+    }
+
+    /* A stale value must not move the cache backwards */
+    pj_gettickcount_cached(&cached);
+    tv = cached;
+    tv.sec -= 10;
+    pj_gettickcount_update_cache(&tv);
+    pj_gettickcount_cached(&tv);
+    if (PJ_TIME_VAL_LT(tv, cached))
+	return -1130;
+
+    /* Cost of each clock */
+    pj_get_timestamp(&t1);
+    for (i=0; i<LOOP; ++i)
+	pj_gettickcount(&tv);
+    pj_get_timestamp(&t2);
+    elapsed[0] = pj_elapsed_usec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<LOOP; ++i)
+	pj_gettickcount_coarse(&tv);
+    pj_get_timestamp(&t2);
+    elapsed[1] = pj_elapsed_usec(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<LOOP; ++i)
+	pj_gettickcount_cached(&tv);
+    pj_get_timestamp(&t2);
+    elapsed[2] = pj_elapsed_usec(&t1, &t2);
+
+    PJ_LOG(3,(THIS_FILE, "....%d calls: gettickcount %u usec, coarse %u "
+			 "usec, cached %u usec",
+	      LOOP, elapsed[0], elapsed[1], elapsed[2]));
+
+    return 0;
+}
+
 
 int timestamp_test(void)
 {
@@ -217,6 +295,10 @@ int timestamp_test(void)
 	return -1030;
     }
 
+    rc = coarse_clock_test();
+    if (rc != 0)
+	return rc;
+
     /* Testing time/timestamp accuracy */
     rc = timestamp_accuracy();
     if (rc != 0)
@@ -45,6 +45,7 @@
 #include <pjmedia/master_port.h>
 #include <pjmedia/mem_port.h>
 #include <pjmedia/null_port.h>
+#include <pjmedia/pcm_ops.h>
 #include <pjmedia/plc.h>
 #include <pjmedia/port.h>
 #include <pjmedia/resample.h>
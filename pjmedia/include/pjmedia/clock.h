@@ -25,6 +25,7 @@
  * @brief Media clock.
  */
 #include <pjmedia/types.h>
+#include <pj/os.h>
 
 
 /**
@@ -293,6 +294,41 @@ PJ_DECL(pj_status_t) pjmedia_clock_modify(pjmedia_clock *clock,
                                           const pjmedia_clock_param *param);
 
 
+/**
+ * Restrict the clock thread to the specified CPUs, see
+ * #pj_thread_set_affinity(). The setting is applied to the running
+ * thread, and to the thread created when the clock is started again.
+ *
+ * @param clock		    The media clock.
+ * @param cpu_cnt	    Number of CPUs, at most 64. Zero allows the
+ *			    thread to run on all CPUs.
+ * @param cpu		    Array of CPU indexes.
+ *
+ * @return		    PJ_SUCCES on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_clock_set_thread_affinity(pjmedia_clock *clock,
+						       unsigned cpu_cnt,
+						       const unsigned cpu[]);
+
+
+/**
+ * Set the scheduling policy and priority of the clock thread, see
+ * #pj_thread_set_sched(). When this is set, the clock thread is no longer
+ * set to the highest priority of its current policy. The setting is
+ * applied to the running thread, and to the thread created when the clock
+ * is started again.
+ *
+ * @param clock		    The media clock.
+ * @param policy	    The scheduling policy.
+ * @param prio		    The priority.
+ *
+ * @return		    PJ_SUCCES on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_clock_set_thread_sched(pjmedia_clock *clock,
+						    pj_thread_sched_policy policy,
+						    int prio);
+
+
 /**
  * Poll the media clock, and execute the callback when the clock tick has
  * elapsed. This operation is only valid if the clock is created with async
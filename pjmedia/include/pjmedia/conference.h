@@ -81,6 +81,20 @@ typedef struct pjmedia_conf_port_info
 } pjmedia_conf_port_info;
 
 
+/**
+ * Callback to be called when the removal of a port requested with
+ * #pjmedia_conf_remove_port2() has been completed, i.e. the bridge will
+ * not access the port anymore.
+ *
+ * @param conf		The conference bridge.
+ * @param slot		The slot of the port that has been removed.
+ * @param user_data	The user data passed to #pjmedia_conf_remove_port2().
+ */
+typedef void (*pjmedia_conf_remove_cb)(pjmedia_conf *conf,
+				       unsigned slot,
+				       void *user_data);
+
+
 /**
  * Conference port options. The values here can be combined in bitmask to
  * be specified when the conference bridge is created.
@@ -162,6 +176,107 @@ PJ_DECL(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
 					  pjmedia_conf **p_conf );
 
 
+/**
+ * Conference bridge settings, to be specified when the bridge is created
+ * with #pjmedia_conf_create2(). The format of port zero (the sound device
+ * or the master port) is given by sampling_rate, channel_count and
+ * samples_per_frame, as with #pjmedia_conf_create(). The bridge may mix
+ * in another format, e.g. at the highest clock rate of the ports to be
+ * added, or in stereo, in which case port zero is converted like any
+ * other port.
+ */
+typedef struct pjmedia_conf_param
+{
+    /**
+     * Maximum number of slots/ports to be created in the bridge,
+     * including port zero.
+     */
+    unsigned	max_slots;
+
+    /**
+     * Sampling rate of port zero.
+     *
+     * Default: 8000
+     */
+    unsigned	sampling_rate;
+
+    /**
+     * Number of channels of port zero.
+     *
+     * Default: 1
+     */
+    unsigned	channel_count;
+
+    /**
+     * Samples per frame of port zero, which also sets the ptime of the
+     * bridge.
+     *
+     * Default: 160
+     */
+    unsigned	samples_per_frame;
+
+    /**
+     * Bits per sample, currently only 16 is supported.
+     *
+     * Default: 16
+     */
+    unsigned	bits_per_sample;
+
+    /**
+     * Bitmask options, constructed from #pjmedia_conf_option enumeration.
+     *
+     * Default: 0
+     */
+    unsigned	options;
+
+    /**
+     * Sampling rate the bridge mixes at, or zero to use sampling_rate.
+     * Mixing at the highest clock rate of the ports keeps the wideband
+     * ports connected to each other from being resampled to a lower rate.
+     *
+     * Default: 0
+     */
+    unsigned	mix_clock_rate;
+
+    /**
+     * Number of channels the bridge mixes, or zero to use channel_count.
+     * When it differs from channel_count, one of them must be 1.
+     *
+     * Default: 0
+     */
+    unsigned	mix_channel_count;
+
+} pjmedia_conf_param;
+
+
+/**
+ * Initialize the conference bridge settings with default values.
+ *
+ * @param param		    The settings to be initialized.
+ */
+PJ_DECL(void) pjmedia_conf_param_default(pjmedia_conf_param *param);
+
+
+/**
+ * Create conference bridge with the specified settings. This works as
+ * #pjmedia_conf_create(), except that the bridge may mix in a different
+ * format than port zero.
+ *
+ * This is not supported by the switchboard implementation of the bridge
+ * when the mixing format differs from port zero.
+ *
+ * @param pool		    Pool to use to allocate the bridge and 
+ *			    additional buffers for the sound device.
+ * @param param		    The bridge settings.
+ * @param p_conf	    Pointer to receive the conference bridge instance.
+ *
+ * @return		    PJ_SUCCESS if conference bridge can be created.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_create2( pj_pool_t *pool,
+					   const pjmedia_conf_param *param,
+					   pjmedia_conf **p_conf );
+
+
 /**
  * Destroy conference bridge.
  *
@@ -298,6 +413,11 @@ PJ_DECL(pj_status_t) pjmedia_conf_configure_port( pjmedia_conf *conf,
  * Enable unidirectional audio from the specified source slot to the
  * specified sink slot.
  *
+ * This function doesn't wait for the bridge to finish mixing the current
+ * frame. If the bridge is busy mixing, the connection takes effect from
+ * the next frame. This applies to #pjmedia_conf_add_port() and
+ * #pjmedia_conf_disconnect_port() too.
+ *
  * @param conf		The conference bridge.
  * @param src_slot	Source slot.
  * @param sink_slot	Sink slot.
@@ -351,7 +471,12 @@ PJ_DECL(unsigned) pjmedia_conf_get_connect_count(pjmedia_conf *conf);
 
 
 /**
- * Remove the specified port from the conference bridge.
+ * Remove the specified port from the conference bridge. This function never
+ * waits for the bridge: if the bridge is busy mixing, the port is removed
+ * by the clock thread at the end of the current frame, and the port (as
+ * well as the pool given to #pjmedia_conf_add_port()) may still be used
+ * until then. Use #pjmedia_conf_remove_port2() to know when the port may
+ * be destroyed.
  *
  * @param conf		The conference bridge.
  * @param slot		The port index to be removed.
@@ -362,6 +487,36 @@ PJ_DECL(pj_status_t) pjmedia_conf_remove_port( pjmedia_conf *conf,
 					       unsigned slot );
 
 
+/**
+ * Remove the specified port from the conference bridge, and get notified
+ * when the removal has been completed. Like #pjmedia_conf_remove_port(),
+ * this function never waits for the bridge.
+ *
+ * The callback is called once the bridge has released the port, either
+ * before this function returns, or by the clock thread at the end of the
+ * frame being mixed, or by #pjmedia_conf_destroy(). It may be called with
+ * the bridge locks held, so it must not block nor call the bridge API, but
+ * it may destroy the port and release the pool given to
+ * #pjmedia_conf_add_port() (a passive port, i.e. one added with
+ * #pjmedia_conf_add_passive_port(), has been destroyed by the bridge).
+ *
+ * @param conf		The conference bridge.
+ * @param slot		The port index to be removed.
+ * @param user_data	Arbitrary user data to be passed to the callback.
+ * @param cb		Callback to be called when the port has been
+ *			removed, may be NULL.
+ *
+ * @return		PJ_SUCCESS if the removal has been completed (and
+ *			the callback called) before this function returns,
+ *			PJ_EPENDING if it will be completed by the clock
+ *			thread, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_remove_port2( pjmedia_conf *conf,
+						unsigned slot,
+						void *user_data,
+						pjmedia_conf_remove_cb cb);
+
+
 
 /**
  * Enumerate occupied ports in the bridge.
@@ -496,6 +651,73 @@ PJ_DECL(pj_status_t) pjmedia_conf_adjust_tx_level( pjmedia_conf *conf,
 						   int adj_level );
 
 
+/**
+ * Set the number of worker threads used by the bridge to process the
+ * ports. By default the bridge processes all ports in the thread which
+ * calls get_frame() of port zero (the sound device or master port thread).
+ * With worker threads, on each clock tick the bridge first reads the frames
+ * from all ports in parallel (this includes decoding, for stream ports),
+ * then mixes and writes the frames to all ports in parallel (this includes
+ * encoding), waiting for all ports to complete each step. The calling
+ * thread takes part in the work, so with \a cnt worker threads up to
+ * \a cnt+1 ports are processed at the same time.
+ *
+ * The mixed signal is the same as when the ports are processed serially.
+ *
+ * Note that with worker threads, get_frame() and put_frame() of the ports
+ * are called from the worker threads. Changes made to the bridge by these
+ * callbacks take effect at the end of the frame, as with serial
+ * processing. The callbacks must not call this function,
+ * #pjmedia_conf_set_active_speakers() or #pjmedia_conf_destroy(), which
+ * return PJ_EINVALIDOP in this case.
+ *
+ * This is not supported by the switchboard implementation of the bridge.
+ *
+ * @param conf		The conference bridge.
+ * @param cnt		Number of worker threads, or zero to process the
+ *			ports serially.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_set_mix_threads( pjmedia_conf *conf,
+						   unsigned cnt );
+
+
+/**
+ * Limit the mixing to the active speakers. By default the bridge mixes
+ * the signal of every transmitter into every listener, which costs in the
+ * order of the number of connections on each clock tick, even when only a
+ * few participants of a large conference are speaking.
+ *
+ * With this setting, on each clock tick the bridge selects up to
+ * \a max_cnt ports with the loudest signal (averaged over a few frames)
+ * as the active speakers, and only the signal of these ports is mixed.
+ * Ports which don't return audio frame, e.g. streams with silence
+ * suppressed by VAD, are never selected. The signal of the active
+ * speakers is mixed once, and it is shared by all listeners connected to
+ * all of the active speakers, and converted to 16bit once for listeners
+ * with the same TX level. An active speaker connected to all other active
+ * speakers gets the shared mix minus its own signal. Other listeners mix
+ * the active speakers they are connected to.
+ *
+ * Ports with a clock rate different from the bridge's are only resampled
+ * when they are selected as active speakers, and the shared mix is
+ * resampled once for all listeners with the same clock rate and TX level.
+ *
+ * This can be combined with #pjmedia_conf_set_mix_threads().
+ *
+ * This is not supported by the switchboard implementation of the bridge.
+ *
+ * @param conf		The conference bridge.
+ * @param max_cnt	Maximum number of active speakers to be mixed
+ *			(typically three), or zero to mix all transmitters.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_conf_set_active_speakers( pjmedia_conf *conf,
+						       unsigned max_cnt );
+
+
 
 PJ_END_DECL
 
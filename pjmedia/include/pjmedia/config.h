@@ -84,6 +84,28 @@
 #   define PJMEDIA_CONF_USE_AGC    	    1
 #endif
 
+/**
+ * Specify whether the PCM sample operations (see @ref PJMEDIA_PCM_OPS),
+ * which the conference bridge uses for mixing and for the signal level,
+ * may use SIMD instructions (SSE2 or AVX2 on x86, NEON on ARM). The best
+ * implementation supported by the CPU is selected at run-time.
+ *
+ * Default: 1 (enabled)
+ */
+#ifndef PJMEDIA_HAS_SIMD
+#   define PJMEDIA_HAS_SIMD		    1
+#endif
+
+/**
+ * Maximum number of media shards that can be created in the media
+ * endpoint, see #pjmedia_endpt_create_shards().
+ *
+ * Default: 64
+ */
+#ifndef PJMEDIA_ENDPT_MAX_SHARDS
+#   define PJMEDIA_ENDPT_MAX_SHARDS	    64
+#endif
+
 
 /*
  * Types of sound stream backends.
@@ -571,6 +593,42 @@
 #   define PJMEDIA_STREAM_VAD_SUSPEND_MSEC	600
 #endif
 
+/**
+ * Maximum number of encoders created by a stream encoding group for the
+ * streams with the same codec setting, i.e. the maximum number of
+ * different audio frames sent by these streams at the same time that
+ * are encoded once. A frame which doesn't get an encoder is encoded by
+ * the stream's own codec. See #pjmedia_stream_enc_group_create().
+ *
+ * Default: 8
+ */
+#ifndef PJMEDIA_STREAM_ENC_GROUP_MAX_LANES
+#   define PJMEDIA_STREAM_ENC_GROUP_MAX_LANES	8
+#endif
+
+/**
+ * Number of received RTP packets that can wait in the stream's RX queue.
+ * With the queue, the network thread only validates a received packet
+ * and queues it, without taking the jitter buffer mutex. The packets are
+ * parsed and put to the jitter buffer when the stream's port is asked
+ * for a frame, so the queue should hold the packets received during the
+ * longest expected interval between two get_frame() calls. Packets
+ * received when the queue is full are discarded.
+ *
+ * The default holds 640 msec of 20 msec packets, more than the default
+ * maximum jitter buffer delay, so the queue doesn't discard packets that
+ * the jitter buffer would keep.
+ *
+ * Specify zero to disable the queue, the network thread will then put the
+ * packets to the jitter buffer directly. The queue can also be set for a
+ * stream with \a rx_queue_pkt_cnt of #pjmedia_stream_info.
+ *
+ * Default: 32
+ */
+#ifndef PJMEDIA_STREAM_RX_QUEUE_PKT_CNT
+#   define PJMEDIA_STREAM_RX_QUEUE_PKT_CNT	32
+#endif
+
 /**
  * Perform RTP payload type checking in the stream. Normally the peer
  * MUST send RTP with payload type as we specified in our SDP. Certain
@@ -1384,6 +1442,18 @@
 #endif
 
 
+/**
+ * Minimum gap between two consecutive playout compressions requested by
+ * the jitter buffer time-scaling algorithm (PJMEDIA_JB_DISCARD_TIME_SCALE),
+ * in milliseconds.
+ *
+ * Default: 100 ms
+ */
+#ifndef PJMEDIA_JBUF_TIME_SCALE_MIN_GAP
+#   define PJMEDIA_JBUF_TIME_SCALE_MIN_GAP	    100
+#endif
+
+
 /**
  * Video stream will discard old picture from the jitter buffer as soon as
  * new picture is received, to reduce latency.
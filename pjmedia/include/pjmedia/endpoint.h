@@ -37,10 +37,12 @@
  * to create a media session (#pjmedia_session_create()).
  */
 
+#include <pjmedia/clock.h>
 #include <pjmedia/codec.h>
 #include <pjmedia/sdp.h>
 #include <pjmedia/transport.h>
 #include <pjmedia-audiodev/audiodev.h>
+#include <pj/math.h>
 
 
 PJ_BEGIN_DECL
@@ -219,6 +221,214 @@ PJ_DECL(pj_thread_t*) pjmedia_endpt_get_thread(pjmedia_endpt *endpt,
 PJ_DECL(pj_status_t) pjmedia_endpt_stop_threads(pjmedia_endpt *endpt);
 
 
+/**
+ * Media shard settings, see #pjmedia_endpt_create_shards().
+ */
+typedef struct pjmedia_endpt_shard_param
+{
+    /**
+     * Number of shards. Normally this is the number of CPUs available
+     * for media processing.
+     *
+     * Default: 1
+     */
+    unsigned	shard_cnt;
+
+    /**
+     * Maximum number of handles of each shard's ioqueue.
+     *
+     * Default: PJ_IOQUEUE_MAX_HANDLES
+     */
+    unsigned	max_handles;
+
+    /**
+     * Clock rate of the shard's media clock, which determines the
+     * timestamp given to the tick callbacks.
+     *
+     * Default: 8000
+     */
+    unsigned	clock_rate;
+
+    /**
+     * Interval of the shard's media clock ticks, in msec.
+     *
+     * Default: 20
+     */
+    unsigned	ptime;
+
+} pjmedia_endpt_shard_param;
+
+
+/**
+ * Statistics of a media shard, see #pjmedia_endpt_get_shard_stat().
+ */
+typedef struct pjmedia_endpt_shard_stat
+{
+    unsigned	    obj_cnt;	/**< Number of objects assigned.	    */
+    unsigned	    load;	/**< Total load of the objects assigned.    */
+    pj_uint32_t	    poll_cnt;	/**< Number of ioqueue polls.		    */
+    pj_uint32_t	    event_cnt;	/**< Number of ioqueue events processed.    */
+    pj_uint32_t	    tick_cnt;	/**< Number of clock ticks.		    */
+    pj_uint32_t	    late_cnt;	/**< Number of ticks which started one
+				     interval or more late.		    */
+    pj_math_stat    tick_usec;	/**< Time spent in the tick callbacks per
+				     tick, in usec.			    */
+} pjmedia_endpt_shard_stat;
+
+
+/**
+ * Initialize the media shard settings with the default values.
+ *
+ * @param param		The settings to be initialized.
+ */
+PJ_DECL(void) pjmedia_endpt_shard_param_default(
+					pjmedia_endpt_shard_param *param);
+
+
+/**
+ * Create media shards, so that the media processing can be spread across
+ * CPUs. Each shard has its own ioqueue, a thread polling the ioqueue, and
+ * a media clock which ticks on the same thread. Media transports created
+ * afterwards (currently the UDP transport) are assigned to the shard with
+ * the lowest load and register their sockets to the shard's ioqueue
+ * instead of the endpoint's ioqueue. The shards can only be created once,
+ * and are destroyed with the endpoint.
+ *
+ * Application may place the shard threads with #pj_thread_set_affinity(),
+ * see #pjmedia_endpt_get_shard_thread(), and clock its media ports on the
+ * shard where their streams are with #pjmedia_endpt_add_shard_tick(), so
+ * that the packets of a stream are received and processed by one thread.
+ *
+ * @param endpt		The media endpoint instance.
+ * @param param		The shard settings, or NULL for the default.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_endpt_create_shards(
+				    pjmedia_endpt *endpt,
+				    const pjmedia_endpt_shard_param *param);
+
+
+/**
+ * Get the number of media shards.
+ *
+ * @param endpt		The media endpoint instance.
+ *
+ * @return		The number of shards, zero if no shard has been
+ *			created.
+ */
+PJ_DECL(unsigned) pjmedia_endpt_get_shard_count(pjmedia_endpt *endpt);
+
+
+/**
+ * Assign an object, such as a media transport, to the shard with the
+ * lowest load, and add the load of the object to the shard. The object
+ * should be released with #pjmedia_endpt_release_shard() when it is
+ * destroyed.
+ *
+ * @param endpt		The media endpoint instance.
+ * @param load		The load of the object, e.g. one for a stream.
+ * @param p_shard	Pointer to receive the shard index.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_EINVALIDOP if no
+ *			shard has been created.
+ */
+PJ_DECL(pj_status_t) pjmedia_endpt_acquire_shard(pjmedia_endpt *endpt,
+						 unsigned load,
+						 unsigned *p_shard);
+
+
+/**
+ * Remove an object and its load from the shard, see
+ * #pjmedia_endpt_acquire_shard().
+ *
+ * @param endpt		The media endpoint instance.
+ * @param shard		The shard index.
+ * @param load		The load given when the object was assigned.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_endpt_release_shard(pjmedia_endpt *endpt,
+						 unsigned shard,
+						 unsigned load);
+
+
+/**
+ * Get the ioqueue of a media shard.
+ *
+ * @param endpt		The media endpoint instance.
+ * @param shard		The shard index.
+ *
+ * @return		The ioqueue, or NULL if the shard doesn't exist.
+ */
+PJ_DECL(pj_ioqueue_t*) pjmedia_endpt_get_shard_ioqueue(pjmedia_endpt *endpt,
+						       unsigned shard);
+
+
+/**
+ * Get the thread of a media shard.
+ *
+ * @param endpt		The media endpoint instance.
+ * @param shard		The shard index.
+ *
+ * @return		The thread, or NULL if the shard doesn't exist.
+ */
+PJ_DECL(pj_thread_t*) pjmedia_endpt_get_shard_thread(pjmedia_endpt *endpt,
+						     unsigned shard);
+
+
+/**
+ * Register a callback to be called on every tick of the shard's media
+ * clock. The callback is called by the shard thread, between the polls
+ * of the shard's ioqueue. The clock only runs while there is a callback.
+ *
+ * @param endpt		The media endpoint instance.
+ * @param shard		The shard index.
+ * @param cb		The callback.
+ * @param user_data	User data to be given to the callback.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_endpt_add_shard_tick(pjmedia_endpt *endpt,
+						  unsigned shard,
+						  pjmedia_clock_callback *cb,
+						  void *user_data);
+
+
+/**
+ * Unregister a tick callback of the shard's media clock. When this
+ * function returns the callback is not running and will not be called
+ * again, unless this is called from the callback itself.
+ *
+ * @param endpt		The media endpoint instance.
+ * @param shard		The shard index.
+ * @param cb		The callback.
+ * @param user_data	User data given when the callback was registered.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_ENOTFOUND.
+ */
+PJ_DECL(pj_status_t) pjmedia_endpt_remove_shard_tick(
+						  pjmedia_endpt *endpt,
+						  unsigned shard,
+						  pjmedia_clock_callback *cb,
+						  void *user_data);
+
+
+/**
+ * Get the statistics of a media shard.
+ *
+ * @param endpt		The media endpoint instance.
+ * @param shard		The shard index.
+ * @param stat		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_endpt_get_shard_stat(
+					    pjmedia_endpt *endpt,
+					    unsigned shard,
+					    pjmedia_endpt_shard_stat *stat);
+
+
 /**
  * Request the media endpoint to create pool.
  *
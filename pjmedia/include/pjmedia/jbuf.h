@@ -39,6 +39,16 @@
  * This section describes PJMEDIA's implementation of de-jitter buffer.
  * The de-jitter buffer may be set to operate in adaptive mode or fixed
  * delay mode.
+ *
+ * The jitter buffer is not thread safe, the application must serialize
+ * the calls, e.g: the stream uses its jitter buffer mutex. To keep the
+ * thread receiving RTP packets off that mutex, the audio stream queues
+ * the received packets in a lock-free single producer, single consumer
+ * queue, and the thread getting the frames puts them to the jitter buffer
+ * (see #PJMEDIA_STREAM_RX_QUEUE_PKT_CNT). The queue holds whole RTP
+ * packets rather than frames, because the frames must be parsed from the
+ * packets by the codec on the consumer side, as the parser may share its
+ * state with the decoder.
  */
 
 
@@ -88,7 +98,18 @@ typedef enum pjmedia_jb_discard_algo
      * a new frame arrives, one frame will be discarded to make space for the
      * new frame.
      */
-    PJMEDIA_JB_DISCARD_PROGRESSIVE
+    PJMEDIA_JB_DISCARD_PROGRESSIVE,
+
+    /**
+     * The latency is adjusted by time-scaling the playout instead of
+     * discarding frames: the jitter buffer asks the application, via
+     * #pjmedia_jbuf_get_time_scale(), to compress the playout when the
+     * latency is higher than the jitter level, and to stretch it when
+     * the buffer is about to run empty. When the jitter buffer is full and
+     * a new frame arrives, one frame will be discarded to make space for
+     * the new frame.
+     */
+    PJMEDIA_JB_DISCARD_TIME_SCALE
 
 } pjmedia_jb_discard_algo;
 
@@ -117,6 +138,10 @@ typedef struct pjmedia_jb_state
     unsigned	lost;		    /**< Number of lost frames.		    */
     unsigned	discard;	    /**< Number of discarded frames.	    */
     unsigned	empty;		    /**< Number of empty on GET events.	    */
+    unsigned	compress;	    /**< Number of playout compressions
+					 requested by time-scaling.	    */
+    unsigned	stretch;	    /**< Number of playout stretches
+					 requested by time-scaling.	    */
 } pjmedia_jb_state;
 
 
@@ -441,6 +466,26 @@ PJ_DECL(unsigned) pjmedia_jbuf_remove_frame(pjmedia_jbuf *jb,
 PJ_DECL(pj_bool_t) pjmedia_jbuf_is_full(const pjmedia_jbuf *jb);
 
 
+/**
+ * Get the playout time-scaling needed to keep the latency close to the
+ * jitter level, when the discard algorithm is
+ * PJMEDIA_JB_DISCARD_TIME_SCALE. Application should call this once
+ * before it gets the frames for a playout frame, and then:
+ *  - when the result is positive, compress the playout by about one
+ *    frame, e.g: by getting an extra frame and shortening the decoded
+ *    audio with #pjmedia_wsola_discard().
+ *  - when the result is negative, stretch the playout by one frame, i.e:
+ *    generate the frame, e.g: with #pjmedia_wsola_generate(), instead of
+ *    getting it from the jitter buffer.
+ *
+ * @param jb		The jitter buffer.
+ *
+ * @return		Positive to compress the playout, negative to
+ *			stretch it, or zero to play normally.
+ */
+PJ_DECL(int) pjmedia_jbuf_get_time_scale(pjmedia_jbuf *jb);
+
+
 /**
  * Get jitter buffer current state/settings.
  *
@@ -25,6 +25,7 @@
  * @file master_port.h
  * @brief Master port.
  */
+#include <pjmedia/clock.h>
 #include <pjmedia/port.h>
 
 /**
@@ -149,6 +150,17 @@ PJ_DECL(pj_status_t) pjmedia_master_port_set_uport(pjmedia_master_port *m,
 PJ_DECL(pjmedia_port*) pjmedia_master_port_get_uport(pjmedia_master_port*m);
 
 
+/**
+ * Get the media clock which drives the master port, for example to set
+ * the placement of the clock thread.
+ *
+ * @param m		The master port.
+ *
+ * @return		The media clock.
+ */
+PJ_DECL(pjmedia_clock*) pjmedia_master_port_get_clock(pjmedia_master_port *m);
+
+
 /**
  * Change the downstream port. Note that application is responsible to destroy
  * current downstream port (the one that is going to be replaced with the
@@ -0,0 +1,188 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJMEDIA_PCM_OPS_H__
+#define __PJMEDIA_PCM_OPS_H__
+
+/**
+ * @file pcm_ops.h
+ * @brief PCM sample operations.
+ */
+#include <pjmedia/types.h>
+
+/**
+ * @defgroup PJMEDIA_PCM_OPS PCM Sample Operations
+ * @ingroup PJMEDIA_FRAME_OP
+ * @brief Mixing, gain and signal level of 16bit PCM samples
+ * @{
+ *
+ * These are the per-sample loops of the conference bridge: accumulating
+ * frames into a 32bit mix buffer, converting the mix buffer back to 16bit
+ * samples with gain and clipping, and calculating the signal level.
+ *
+ * When #PJMEDIA_HAS_SIMD is enabled, the operations are implemented with
+ * SSE2 and AVX2 instructions on x86, and NEON instructions on ARM. The best
+ * implementation supported by the CPU is selected at run-time, and all
+ * implementations give the same results.
+ *
+ * The gain is a fixed point value where 128 means no adjustment, i.e.
+ * a sample is adjusted to <tt>(sample * gain) >> 7</tt> and then clipped
+ * to the 16bit range.
+ */
+
+PJ_BEGIN_DECL
+
+/**
+ * Implementations of the PCM sample operations.
+ */
+typedef enum pjmedia_pcm_impl
+{
+    /** The best implementation supported by the CPU. */
+    PJMEDIA_PCM_IMPL_AUTO,
+
+    /** Portable C implementation. */
+    PJMEDIA_PCM_IMPL_C,
+
+    /** SSE2 implementation. */
+    PJMEDIA_PCM_IMPL_SSE2,
+
+    /** AVX2 implementation. */
+    PJMEDIA_PCM_IMPL_AVX2,
+
+    /** NEON implementation. */
+    PJMEDIA_PCM_IMPL_NEON
+
+} pjmedia_pcm_impl;
+
+
+/**
+ * Select the implementation of the PCM sample operations. Normally
+ * application doesn't need to call this, it is mostly useful to compare
+ * the implementations.
+ *
+ * @param impl		The implementation.
+ *
+ * @return		PJ_SUCCESS, or PJ_ENOTSUP if the implementation is
+ *			not available in this build or on this CPU.
+ */
+PJ_DECL(pj_status_t) pjmedia_pcm_set_impl(pjmedia_pcm_impl impl);
+
+
+/**
+ * Get the implementation of the PCM sample operations in use.
+ *
+ * @return		The implementation, never PJMEDIA_PCM_IMPL_AUTO.
+ */
+PJ_DECL(pjmedia_pcm_impl) pjmedia_pcm_get_impl(void);
+
+
+/**
+ * Get the name of the implementation.
+ *
+ * @param impl		The implementation.
+ *
+ * @return		The name, e.g. "sse2".
+ */
+PJ_DECL(const char*) pjmedia_pcm_impl_name(pjmedia_pcm_impl impl);
+
+
+/**
+ * Add the samples to the mix buffer, and find the range of the mixed
+ * samples so that the caller can detect overflow.
+ *
+ * @param mix_buf	The 32bit mix buffer.
+ * @param samples	The samples to be added.
+ * @param count		Number of samples.
+ * @param p_min		Receives the lowest mixed sample, or zero if none
+ *			of the mixed samples is negative.
+ * @param p_max		Receives the highest mixed sample, or zero if none
+ *			of the mixed samples is positive.
+ */
+PJ_DECL(void) pjmedia_pcm_mix(pj_int32_t mix_buf[],
+			      const pj_int16_t samples[],
+			      unsigned count,
+			      pj_int32_t *p_min,
+			      pj_int32_t *p_max);
+
+
+/**
+ * Copy the samples to the 32bit mix buffer.
+ *
+ * @param mix_buf	The 32bit mix buffer.
+ * @param samples	The samples.
+ * @param count		Number of samples.
+ */
+PJ_DECL(void) pjmedia_pcm_widen(pj_int32_t mix_buf[],
+				const pj_int16_t samples[],
+				unsigned count);
+
+
+/**
+ * Convert the 32bit mix buffer to 16bit samples, applying the gain and
+ * clipping the result.
+ *
+ * @param dst		The 16bit samples. This may point to the mix
+ *			buffer itself, to convert the buffer in place.
+ * @param mix_buf	The 32bit mix buffer.
+ * @param count		Number of samples.
+ * @param gain		The gain, 128 for no adjustment.
+ *
+ * @return		Sum of the absolute value of the output samples.
+ */
+PJ_DECL(pj_uint32_t) pjmedia_pcm_narrow(pj_int16_t dst[],
+					const pj_int32_t mix_buf[],
+					unsigned count,
+					unsigned gain);
+
+
+/**
+ * Apply the gain to the samples in place, clipping the result.
+ *
+ * @param samples	The samples.
+ * @param count		Number of samples.
+ * @param gain		The gain, 128 for no adjustment.
+ *
+ * @return		Sum of the absolute value of the output samples.
+ */
+PJ_DECL(pj_uint32_t) pjmedia_pcm_adjust(pj_int16_t samples[],
+					unsigned count,
+					unsigned gain);
+
+
+/**
+ * Calculate the sum of the absolute value of the samples. Divide it by
+ * the number of samples to get the average signal level.
+ *
+ * @param samples	The samples.
+ * @param count		Number of samples.
+ *
+ * @return		The sum.
+ */
+PJ_DECL(pj_uint32_t) pjmedia_pcm_sum_abs(const pj_int16_t samples[],
+					 unsigned count);
+
+
+PJ_END_DECL
+
+/**
+ * @}
+ */
+
+
+#endif	/* __PJMEDIA_PCM_OPS_H__ */
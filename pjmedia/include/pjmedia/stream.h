@@ -134,6 +134,18 @@ typedef struct pjmedia_stream_info
     int			jb_max_pre; /**< Jitter buffer maximum prefetch
 					 delay in msec (-1 for default).    */
     int			jb_max;	    /**< Jitter buffer max delay in msec.   */
+    pj_bool_t		jb_time_scale;
+				    /**< Adjust the jitter buffer latency by
+					 time-scaling the playout with WSOLA
+					 instead of discarding frames (see
+					 PJMEDIA_JB_DISCARD_TIME_SCALE).
+					 Only for mono, linear PCM port.    */
+    int			rx_queue_pkt_cnt;
+				    /**< Number of received RTP packets that
+					 can wait in the stream's RX queue,
+					 zero to disable the queue, or -1 to
+					 use PJMEDIA_STREAM_RX_QUEUE_PKT_CNT.
+					 Default: -1			    */
 
 #if defined(PJMEDIA_STREAM_ENABLE_KA) && PJMEDIA_STREAM_ENABLE_KA!=0
     pj_bool_t		use_ka;	    /**< Stream keep-alive and NAT hole punch
@@ -454,6 +466,70 @@ pjmedia_stream_get_rtp_session_info(pjmedia_stream *stream,
 			           pjmedia_stream_rtp_sess_info *session_info);
 
 
+/**
+ * Opaque declaration for stream encoding group.
+ */
+typedef struct pjmedia_stream_enc_group pjmedia_stream_enc_group;
+
+
+/**
+ * Create an encoding group. Streams in the group which send the same
+ * audio frame with the same codec setting encode the frame only once,
+ * and the encoded payload is sent by each stream with its own RTP header
+ * (SSRC, sequence number, and timestamp). This is useful for large
+ * conferences, where the conference bridge gives the same mix to most of
+ * the participants (see #pjmedia_conf_set_active_speakers()).
+ *
+ * The group keeps an encoder for each different frame sent at the same
+ * time (up to #PJMEDIA_STREAM_ENC_GROUP_MAX_LANES for each codec setting).
+ * A stream is given an encoder when it sends its first frame and keeps it,
+ * so the state of stateful codecs stays consistent. When the stream sends
+ * another frame than the other users of its encoder, e.g. because it is
+ * an active speaker whose mix doesn't have its own voice, the frame is
+ * encoded with the stream's own codec. The frames are matched by their
+ * timestamp and content, thus the streams in a group should be clocked
+ * by the same source, e.g. they should be connected to the same
+ * conference bridge.
+ *
+ * @param endpt		The media endpoint.
+ * @param p_grp		Pointer to receive the group.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_stream_enc_group_create(pjmedia_endpt *endpt,
+				pjmedia_stream_enc_group **p_grp);
+
+
+/**
+ * Destroy the encoding group. All streams must have left the group or
+ * have been destroyed.
+ *
+ * @param grp		The encoding group.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_stream_enc_group_destroy(pjmedia_stream_enc_group *grp);
+
+
+/**
+ * Add the stream to an encoding group, or remove it from its group. The
+ * stream is removed from the group when it is destroyed. This should be
+ * called when the stream is not being clocked, e.g. before it is
+ * connected to the conference bridge.
+ *
+ * @param stream	The media stream.
+ * @param grp		The encoding group, or NULL to remove the stream
+ *			from its group.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t)
+pjmedia_stream_set_enc_group(pjmedia_stream *stream,
+			     pjmedia_stream_enc_group *grp);
+
+
 /**
  * @}
  */
@@ -107,6 +107,8 @@ pjmedia_clock_src_get_time_msec( const pjmedia_clock_src *clocksrc )
  * Implementation of media clock with OS thread.
  */
 
+#define MAX_CPUS	64
+
 struct pjmedia_clock
 {
     pj_pool_t		    *pool;
@@ -123,6 +125,13 @@ struct pjmedia_clock
     pj_bool_t		     running;
     pj_bool_t		     quitting;
     pj_lock_t		    *lock;
+
+    /* Thread placement, kept here as the pool is reset on stop */
+    unsigned		     cpu_cnt;
+    unsigned		     cpu[MAX_CPUS];
+    pj_bool_t		     has_sched;
+    pj_thread_sched_policy   sched_policy;
+    int			     sched_prio;
 };
 
 
@@ -186,6 +195,8 @@ PJ_DEF(pj_status_t) pjmedia_clock_create2(pj_pool_t *pool,
     clock->thread = NULL;
     clock->running = PJ_FALSE;
     clock->quitting = PJ_FALSE;
+    clock->cpu_cnt = 0;
+    clock->has_sched = PJ_FALSE;
     
     /* I don't think we need a mutex, so we'll use null. */
     status = pj_lock_create_null_mutex(pool, "clock", &clock->lock);
@@ -272,6 +283,47 @@ PJ_DEF(pj_status_t) pjmedia_clock_modify(pjmedia_clock *clock,
 }
 
 
+/*
+ * Set the CPUs of the clock thread.
+ */
+PJ_DEF(pj_status_t) pjmedia_clock_set_thread_affinity(pjmedia_clock *clock,
+						      unsigned cpu_cnt,
+						      const unsigned cpu[])
+{
+    PJ_ASSERT_RETURN(clock && (cpu_cnt == 0 || cpu), PJ_EINVAL);
+    PJ_ASSERT_RETURN(cpu_cnt <= MAX_CPUS, PJ_ETOOMANY);
+
+    if (cpu_cnt)
+	pj_memcpy(clock->cpu, cpu, cpu_cnt * sizeof(cpu[0]));
+    clock->cpu_cnt = cpu_cnt;
+
+    if (clock->thread)
+	return pj_thread_set_affinity(clock->thread, cpu_cnt, cpu);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Set the scheduling of the clock thread.
+ */
+PJ_DEF(pj_status_t) pjmedia_clock_set_thread_sched(pjmedia_clock *clock,
+						   pj_thread_sched_policy policy,
+						   int prio)
+{
+    PJ_ASSERT_RETURN(clock, PJ_EINVAL);
+
+    clock->has_sched = PJ_TRUE;
+    clock->sched_policy = policy;
+    clock->sched_prio = prio;
+
+    if (clock->thread)
+	return pj_thread_set_sched(clock->thread, policy, prio);
+
+    return PJ_SUCCESS;
+}
+
+
 /* Calculate next tick */
 PJ_INLINE(void) clock_calc_next_tick(pjmedia_clock *clock,
 				     pj_timestamp *now)
@@ -341,13 +393,21 @@ static int clock_thread(void *arg)
     pj_timestamp now;
     pjmedia_clock *clock = (pjmedia_clock*) arg;
 
-    /* Set thread priority to maximum unless not wanted. */
-    if ((clock->options & PJMEDIA_CLOCK_NO_HIGHEST_PRIO) == 0) {
+    /* Set thread priority to maximum unless not wanted, or unless the
+     * application has set the scheduling.
+     */
+    if (clock->has_sched) {
+	pj_thread_set_sched(pj_thread_this(), clock->sched_policy,
+			    clock->sched_prio);
+    } else if ((clock->options & PJMEDIA_CLOCK_NO_HIGHEST_PRIO) == 0) {
 	int max = pj_thread_get_prio_max(pj_thread_this());
 	if (max > 0)
 	    pj_thread_set_prio(pj_thread_this(), max);
     }
 
+    if (clock->cpu_cnt)
+	pj_thread_set_affinity(pj_thread_this(), clock->cpu_cnt, clock->cpu);
+
     /* Get the first tick */
     pj_get_timestamp(&clock->next_tick);
     clock->next_tick.u64 += clock->interval.u64;
@@ -277,6 +277,42 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
 }
 
 
+/*
+ * Initialize the bridge settings.
+ */
+PJ_DEF(void) pjmedia_conf_param_default(pjmedia_conf_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->max_slots = 16;
+    param->sampling_rate = 8000;
+    param->channel_count = 1;
+    param->samples_per_frame = 160;
+    param->bits_per_sample = 16;
+}
+
+/*
+ * Create conference bridge with the specified settings.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_create2( pj_pool_t *pool,
+					  const pjmedia_conf_param *param,
+					  pjmedia_conf **p_conf )
+{
+    PJ_ASSERT_RETURN(pool && param && p_conf, PJ_EINVAL);
+
+    /* Switchboard doesn't mix, it can't have another format */
+    if ((param->mix_clock_rate &&
+	 param->mix_clock_rate != param->sampling_rate) ||
+	(param->mix_channel_count &&
+	 param->mix_channel_count != param->channel_count))
+    {
+	return PJ_ENOTSUP;
+    }
+
+    return pjmedia_conf_create(pool, param->max_slots, param->sampling_rate,
+			       param->channel_count, param->samples_per_frame,
+			       param->bits_per_sample, param->options, p_conf);
+}
+
 /*
  * Pause sound device.
  */
@@ -812,6 +848,26 @@ PJ_DEF(pj_status_t) pjmedia_conf_remove_port( pjmedia_conf *conf,
 }
 
 
+/*
+ * Remove the specified port, and call cb when it has been removed. The
+ * switchboard removes the port under its mutex, so this is done before
+ * returning.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_remove_port2( pjmedia_conf *conf,
+					       unsigned port,
+					       void *user_data,
+					       pjmedia_conf_remove_cb cb)
+{
+    pj_status_t status;
+
+    status = pjmedia_conf_remove_port(conf, port);
+    if (status == PJ_SUCCESS && cb)
+	(*cb)(conf, port, user_data);
+
+    return status;
+}
+
+
 /*
  * Enum ports.
  */
@@ -1036,6 +1092,30 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_tx_level( pjmedia_conf *conf,
     return PJ_SUCCESS;
 }
 
+/*
+ * Set the number of mixing worker threads.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_set_mix_threads( pjmedia_conf *conf,
+						  unsigned cnt )
+{
+    PJ_ASSERT_RETURN(conf, PJ_EINVAL);
+
+    /* Switchboard only forwards the frames, there's nothing to spread */
+    return cnt ? PJ_ENOTSUP : PJ_SUCCESS;
+}
+
+/*
+ * Set the maximum number of active speakers to be mixed.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_set_active_speakers( pjmedia_conf *conf,
+						      unsigned max_cnt )
+{
+    PJ_ASSERT_RETURN(conf, PJ_EINVAL);
+
+    /* Switchboard doesn't mix */
+    return max_cnt ? PJ_ENOTSUP : PJ_SUCCESS;
+}
+
 /* Deliver frm_src to a listener port, eventually call  port's put_frame() 
  * when samples count in the frm_dst are equal to port's samples_per_frame.
  */
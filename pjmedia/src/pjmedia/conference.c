@@ -21,6 +21,7 @@
 #include <pjmedia/alaw_ulaw.h>
 #include <pjmedia/delaybuf.h>
 #include <pjmedia/errno.h>
+#include <pjmedia/pcm_ops.h>
 #include <pjmedia/port.h>
 #include <pjmedia/resample.h>
 #include <pjmedia/silencedet.h>
@@ -29,6 +30,8 @@
 #include <pj/array.h>
 #include <pj/assert.h>
 #include <pj/log.h>
+#include <pj/mpsc_queue.h>
+#include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/string.h>
 
@@ -70,6 +73,28 @@ static FILE *fhnd_rec;
 #define SLOT_TYPE	    unsigned
 #define INVALID_SLOT	    ((SLOT_TYPE)-1)
 
+/* Parallel mixing is only available when threads can be created */
+#if defined(PJ_HAS_THREADS) && PJ_HAS_THREADS!=0 && \
+    defined(PJ_HAS_SEMAPHORE) && PJ_HAS_SEMAPHORE!=0
+#   define CONF_HAS_MIX_THREADS	1
+#else
+#   define CONF_HAS_MIX_THREADS	0
+#endif
+
+/* Maximum number of mixing worker threads */
+#define MAX_MIX_THREADS	    64
+
+/* Maximum number of clock rates, other than the bridge's, to which the
+ * shared mix of the active speakers is resampled once for all listeners.
+ */
+#define MAX_SPK_RATES	    8
+
+/* With active speaker mixing, the head start given to the current speakers
+ * over the other ports (which is the averaged level, in 8bit complement
+ * ulaw, times four). This is about 3dB.
+ */
+#define SPEAKER_HOLD	    32
+
 
 /* These are settings to control the adaptivity of changes in the
  * signal level of the ports, so that sudden change in signal level
@@ -119,6 +144,18 @@ struct conf_port
     SLOT_TYPE		*listener_slots;/**< Array of listeners.	    */
     unsigned		 transmitter_cnt;/**<Number of transmitters.	    */
 
+    /* The connections as seen by the API. The API changes these under
+     * the conference mutex and queues the change, which is applied to
+     * the connections above by the clock thread, see apply_ops().
+     */
+    unsigned		 ctl_listener_cnt;  /**< Number of listeners.	    */
+    SLOT_TYPE		*ctl_listener_slots;/**< Array of listeners.	    */
+    unsigned		 ctl_transmitter_cnt;/**<Number of transmitters.   */
+    pjmedia_port_op	 ctl_rx_setting;    /**< rx_setting seen by API.    */
+    pjmedia_port_op	 ctl_tx_setting;    /**< tx_setting seen by API.    */
+    unsigned		 ctl_tx_adj_level;  /**< tx_adj_level seen by API.  */
+    unsigned		 ctl_rx_adj_level;  /**< rx_adj_level seen by API.  */
+
     /* Shortcut for port info. */
     unsigned		 clock_rate;	/**< Port's clock rate.		    */
     unsigned		 samples_per_frame; /**< Port's samples per frame.  */
@@ -154,6 +191,8 @@ struct conf_port
     pj_int16_t		*rx_buf;	/**< The RX buffer.		    */
     unsigned		 rx_buf_cap;	/**< Max size, in samples	    */
     unsigned		 rx_buf_count;	/**< # of samples in the buf.	    */
+    pj_bool_t		 rx_deferred;	/**< The frame is still in rx_buf,
+					     to be resampled if needed.	    */
 
     /* Mix buf is a temporary buffer used to mix all signal received
      * by this port from all other ports. The mixed signal will be 
@@ -218,6 +257,44 @@ struct conf_port
      * Burst and drift are handled by delay buffer.
      */
     pjmedia_delay_buf	*delay_buf;
+
+    /* When the ports are processed by worker threads, the frame read from
+     * the port is kept in rx_frame until all ports have been read, and
+     * then it is mixed by the worker of each listener. mix_src contains
+     * the slots of the ports to be mixed to this port on the current tick.
+     */
+    pj_int16_t		*rx_frame;	/**< Last frame read from the port. */
+    pj_bool_t		 rx_ok;		/**< rx_frame is to be mixed.	    */
+    SLOT_TYPE		*mix_src;	/**< Slots to be mixed to mix_buf.  */
+    unsigned		 mix_src_cnt;	/**< Number of slots in mix_src.    */
+    int			 mix_mode;	/**< How mix_buf is made, MIX_*.    */
+
+    /* Active speaker selection, see pjmedia_conf_set_active_speakers() */
+    unsigned		 spk_score;	/**< Averaged rx level.		    */
+    unsigned		 spk_rank;	/**< Score used in the selection.   */
+    pj_bool_t		 is_speaker;	/**< Is one of the active speakers. */
+
+    /* Resampling of the shared mix, see write_port() */
+    pj_bool_t		 tx_shared;	/**< Last frame could be shared.    */
+    pj_bool_t		 tx_stale;	/**< tx_resample skipped last frame.*/
+};
+
+
+/*
+ * The shared mix of the active speakers, resampled to the clock rate of
+ * some of the listeners, see write_port(). The resampler runs on every
+ * frame, so that its history is always the shared mix of the previous
+ * frame.
+ */
+struct spk_rate
+{
+    unsigned		 clock_rate;	/**< Listener's clock rate.	    */
+    pjmedia_resample	*resample;	/**< From the bridge's clock rate.  */
+    pj_int16_t		*buf;		/**< The resampled mix.		    */
+    pj_int16_t		*in;		/**< Input of the last run.	    */
+    pj_int16_t		*prev_in;	/**< Input of the run before.	    */
+    unsigned		 adj;		/**< Level used for in.		    */
+    pj_bool_t		 valid;		/**< buf is for this frame.	    */
 };
 
 
@@ -228,17 +305,103 @@ struct pjmedia_conf
 {
     unsigned		  options;	/**< Bitmask options.		    */
     unsigned		  max_ports;	/**< Maximum ports.		    */
-    unsigned		  port_cnt;	/**< Current number of ports.	    */
+    unsigned		  port_cnt;	/**< Number of ports being mixed.   */
     unsigned		  connect_cnt;	/**< Total number of connections    */
     pjmedia_snd_port	 *snd_dev_port;	/**< Sound device port.		    */
     pjmedia_port	 *master_port;	/**< Port zero's port.		    */
     char		  master_name_buf[80]; /**< Port0 name buffer.	    */
     pj_mutex_t		 *mutex;	/**< Conference mutex.		    */
-    struct conf_port	**ports;	/**< Array of ports.		    */
+    struct conf_port	**ports;	/**< Array of ports being mixed.    */
+
+    /* Port registry. The API works on ctl_ports under the conference
+     * mutex, and queues the changes to be applied to ports by whoever
+     * holds mix_mutex, which the clock thread holds while mixing.
+     */
+    struct conf_port	**ctl_ports;	/**< Array of ports seen by API.    */
+    unsigned		  ctl_port_cnt;	/**< Number of ports seen by API.   */
+    pj_mutex_t		 *mix_mutex;	/**< Held while mixing.		    */
+    long		  mix_tls;	/**< Set in threads mixing a frame. */
+    pj_pool_t		 *op_pool;	/**< Pool for the API allocations.  */
+    pj_mpsc_queue	 *op_queue;	/**< Changes to be applied.	    */
+    pj_mpsc_queue	 *op_free;	/**< Applied ops, for reuse.	    */
+    pj_atomic_t		 *op_cnt;	/**< Ops queued, not yet applied.   */
     unsigned		  clock_rate;	/**< Sampling rate.		    */
     unsigned		  channel_count;/**< Number of channels (1=mono).   */
     unsigned		  samples_per_frame;	/**< Samples per frame.	    */
     unsigned		  bits_per_sample;	/**< Bits per sample.	    */
+
+    /* Format of port zero, which may differ from the format the bridge
+     * mixes in, see pjmedia_conf_create2(). The buffers are only created
+     * when the formats differ.
+     */
+    unsigned		  master_clock_rate;	/**< Port zero's clock rate.*/
+    unsigned		  master_channel_count;	/**< Port zero's channels.  */
+    unsigned		  master_spf;	/**< Port zero's samples per frame. */
+    pj_int16_t		 *master_buf;	/**< Frame in the bridge's format.  */
+    pj_int16_t		 *master_tx_buf;/**< Channel converted mix.	    */
+    pj_int16_t		 *master_rx_buf;/**< Converted frame from port 0.  */
+    pjmedia_resample	 *master_tx_resample; /**< To port zero's rate.    */
+    pjmedia_resample	 *master_rx_resample; /**< From port zero's rate.  */
+
+    /* Parallel mixing, see pjmedia_conf_set_mix_threads() */
+    pj_pool_factory	 *pf;		/**< To create mix_pool.	    */
+    pj_pool_t		 *mix_pool;	/**< Pool for the worker threads.   */
+    unsigned		  thread_cnt;	/**< Number of worker threads.	    */
+    pj_thread_t		**threads;	/**< Worker threads.		    */
+    pj_bool_t		  quit_flag;	/**< Workers must quit.		    */
+    pj_sem_t		 *job_sem;	/**< Wakes up the workers.	    */
+    pj_sem_t		 *done_sem;	/**< All jobs have been done.	    */
+    pj_atomic_t		 *job_idx;	/**< Next job to be taken.	    */
+    pj_atomic_t		 *job_pending;	/**< Threads still taking jobs.	    */
+    int			  job_phase;	/**< Read or write phase.	    */
+    SLOT_TYPE		 *active;	/**< Slots of the ports in use.	    */
+    unsigned		  active_cnt;	/**< Number of slots in active.	    */
+    const pj_timestamp	 *timestamp;	/**< Timestamp of current frame.    */
+    pjmedia_frame_type	  spk_frame_type;/**<Frame type written to port 0. */
+
+    /* Active speaker mixing, see pjmedia_conf_set_active_speakers() */
+    unsigned		  spk_max;	/**< Max active speakers, 0=all.    */
+    SLOT_TYPE		 *spk;		/**< Slots of the active speakers.  */
+    unsigned		  spk_cnt;	/**< Number of active speakers.	    */
+    pj_int32_t		 *spk_mix;	/**< Mix of all active speakers.    */
+    int			  spk_mix_adj;	/**< Adjustment level for spk_mix.  */
+    pj_int16_t		 *spk_tx_buf;	/**< spk_mix converted to 16bit.    */
+    unsigned		  spk_tx_adj;	/**< Level used for spk_tx_buf.	    */
+    pj_uint32_t		  spk_tx_sum;	/**< Sum of abs. spk_tx_buf samples.*/
+    pj_bool_t		  spk_tx_valid;	/**< spk_tx_buf is for this frame.  */
+    struct spk_rate	  spk_rate[MAX_SPK_RATES]; /**< Resampled mixes.    */
+    unsigned		  spk_rate_cnt;	/**< Number of spk_rate in use.	    */
+    unsigned		  ctl_spk_rate_cnt; /**< spk_rate created by API.   */
+};
+
+
+/*
+ * Change to the ports being mixed, queued by the API.
+ */
+enum conf_op_type
+{
+    OP_ADD_PORT,
+    OP_REMOVE_PORT,
+    OP_CONNECT,
+    OP_DISCONNECT,
+    OP_ADD_SPK_RATE,
+    OP_CONFIGURE_PORT,
+    OP_ADJUST_RX_LEVEL,
+    OP_ADJUST_TX_LEVEL
+};
+
+struct conf_op
+{
+    pj_mpsc_node	 node;		/**< Must be the first member.	    */
+    int			 type;		/**< One of OP_*.		    */
+    SLOT_TYPE		 slot;		/**< The port, or the source port.  */
+    SLOT_TYPE		 sink;		/**< The sink port to (dis)connect. */
+    struct conf_port	*port;		/**< The port to add.		    */
+    pjmedia_port_op	 tx;		/**< New tx_setting.		    */
+    pjmedia_port_op	 rx;		/**< New rx_setting.		    */
+    unsigned		 level;		/**< New normalized adj. level.	    */
+    pjmedia_conf_remove_cb cb;		/**< Called when port is removed.   */
+    void		*user_data;	/**< Passed to cb.		    */
 };
 
 
@@ -251,6 +414,10 @@ static pj_status_t get_frame_pasv(pjmedia_port *this_port,
 				  pjmedia_frame *frame);
 static pj_status_t destroy_port(pjmedia_port *this_port);
 static pj_status_t destroy_port_pasv(pjmedia_port *this_port);
+#if CONF_HAS_MIX_THREADS
+static int mix_worker_thread(void *arg);
+static void stop_mix_threads(pjmedia_conf *conf);
+#endif
 
 
 /*
@@ -273,12 +440,12 @@ static pj_status_t create_conf_port( pj_pool_t *pool,
     pj_strdup_with_null(pool, &conf_port->name, name);
 
     /* Default has tx and rx enabled. */
-    conf_port->rx_setting = PJMEDIA_PORT_ENABLE;
-    conf_port->tx_setting = PJMEDIA_PORT_ENABLE;
+    conf_port->rx_setting = conf_port->ctl_rx_setting = PJMEDIA_PORT_ENABLE;
+    conf_port->tx_setting = conf_port->ctl_tx_setting = PJMEDIA_PORT_ENABLE;
 
     /* Default level adjustment is 128 (which means no adjustment) */
-    conf_port->tx_adj_level = NORMAL_LEVEL;
-    conf_port->rx_adj_level = NORMAL_LEVEL;
+    conf_port->tx_adj_level = conf_port->ctl_tx_adj_level = NORMAL_LEVEL;
+    conf_port->rx_adj_level = conf_port->ctl_rx_adj_level = NORMAL_LEVEL;
 
     /* Create transmit flag array */
     conf_port->listener_slots = (SLOT_TYPE*)
@@ -286,6 +453,24 @@ static pj_status_t create_conf_port( pj_pool_t *pool,
 					  conf->max_ports * sizeof(SLOT_TYPE));
     PJ_ASSERT_RETURN(conf_port->listener_slots, PJ_ENOMEM);
 
+    conf_port->ctl_listener_slots = (SLOT_TYPE*)
+				    pj_pool_zalloc(pool,
+					  conf->max_ports * sizeof(SLOT_TYPE));
+    PJ_ASSERT_RETURN(conf_port->ctl_listener_slots, PJ_ENOMEM);
+
+    /* Create the mixing source array and the rx frame for parallel
+     * mixing.
+     */
+    conf_port->mix_src = (SLOT_TYPE*)
+			 pj_pool_zalloc(pool,
+					conf->max_ports * sizeof(SLOT_TYPE));
+    PJ_ASSERT_RETURN(conf_port->mix_src, PJ_ENOMEM);
+
+    conf_port->rx_frame = (pj_int16_t*)
+			  pj_pool_zalloc(pool, conf->samples_per_frame *
+					       sizeof(conf_port->rx_frame[0]));
+    PJ_ASSERT_RETURN(conf_port->rx_frame, PJ_ENOMEM);
+
     /* Save some port's infos, for convenience. */
     if (port) {
 	pjmedia_audio_format_detail *afd;
@@ -479,17 +664,19 @@ static pj_status_t create_sound_port( pj_pool_t *pool,
 	 * Otherwise create bidirectional sound device port.
 	 */
 	if (conf->options & PJMEDIA_CONF_NO_MIC)  {
-	    status = pjmedia_snd_port_create_player(pool, -1, conf->clock_rate,
-						    conf->channel_count,
-						    conf->samples_per_frame,
+	    status = pjmedia_snd_port_create_player(pool, -1,
+						    conf->master_clock_rate,
+						    conf->master_channel_count,
+						    conf->master_spf,
 						    conf->bits_per_sample, 
 						    0,	/* options */
 						    &conf->snd_dev_port);
 
 	} else {
-	    status = pjmedia_snd_port_create( pool, -1, -1, conf->clock_rate, 
-					      conf->channel_count, 
-					      conf->samples_per_frame,
+	    status = pjmedia_snd_port_create( pool, -1, -1,
+					      conf->master_clock_rate,
+					      conf->master_channel_count,
+					      conf->master_spf,
 					      conf->bits_per_sample,
 					      0,    /* Options */
 					      &conf->snd_dev_port);
@@ -515,12 +702,131 @@ static pj_status_t create_sound_port( pj_pool_t *pool,
 
 
      /* Add the port to the bridge */
-    conf->ports[0] = conf_port;
+    conf->ports[0] = conf->ctl_ports[0] = conf_port;
     conf->port_cnt++;
+    conf->ctl_port_cnt++;
 
     return PJ_SUCCESS;
 }
 
+/*
+ * Create the conversion of port zero from/to the format of the bridge.
+ */
+static pj_status_t create_master_conv( pj_pool_t *pool,
+				       pjmedia_conf *conf )
+{
+    unsigned count;
+    pj_status_t status;
+
+    /* Samples per frame of the bridge, with the channels of port zero */
+    count = conf->samples_per_frame / conf->channel_count *
+	    conf->master_channel_count;
+    if (count < conf->samples_per_frame)
+	count = conf->samples_per_frame;
+
+    conf->master_buf = (pj_int16_t*)
+		       pj_pool_alloc(pool, conf->samples_per_frame *
+					   sizeof(conf->master_buf[0]));
+    conf->master_tx_buf = (pj_int16_t*)
+			  pj_pool_alloc(pool, count *
+					      sizeof(conf->master_tx_buf[0]));
+    conf->master_rx_buf = (pj_int16_t*)
+			  pj_pool_alloc(pool, count *
+					      sizeof(conf->master_rx_buf[0]));
+    PJ_ASSERT_RETURN(conf->master_buf && conf->master_tx_buf &&
+		     conf->master_rx_buf, PJ_ENOMEM);
+
+    if (conf->master_clock_rate == conf->clock_rate)
+	return PJ_SUCCESS;
+
+    status = pjmedia_resample_create(pool,
+				     (conf->options & PJMEDIA_CONF_USE_LINEAR)
+					== 0,
+				     (conf->options & PJMEDIA_CONF_SMALL_FILTER)
+					== 0,
+				     conf->master_channel_count,
+				     conf->clock_rate,		/* Rate in */
+				     conf->master_clock_rate,	/* Rate out */
+				     conf->samples_per_frame /
+					conf->channel_count *
+					conf->master_channel_count,
+				     &conf->master_tx_resample);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    return pjmedia_resample_create(pool,
+				   (conf->options & PJMEDIA_CONF_USE_LINEAR)
+					== 0,
+				   (conf->options & PJMEDIA_CONF_SMALL_FILTER)
+					== 0,
+				   conf->master_channel_count,
+				   conf->master_clock_rate,	/* Rate in */
+				   conf->clock_rate,		/* Rate out */
+				   conf->master_spf,
+				   &conf->master_rx_resample);
+}
+
+/*
+ * Convert a frame of port zero, in the format of the bridge, to the
+ * format of the master port.
+ */
+static void master_tx_convert( pjmedia_conf *conf,
+			       const pj_int16_t *src,
+			       pj_int16_t *dst )
+{
+    unsigned count = conf->samples_per_frame;
+
+    if (conf->master_channel_count != conf->channel_count) {
+	if (conf->master_channel_count == 1) {
+	    pjmedia_convert_channel_nto1(conf->master_tx_buf, src,
+					 conf->channel_count, count,
+					 PJMEDIA_STEREO_MIX, 0);
+	    count /= conf->channel_count;
+	} else {
+	    pjmedia_convert_channel_1ton(conf->master_tx_buf, src,
+					 conf->master_channel_count, count, 0);
+	    count *= conf->master_channel_count;
+	}
+	src = conf->master_tx_buf;
+    }
+
+    if (conf->master_tx_resample)
+	pjmedia_resample_run(conf->master_tx_resample, src, dst);
+    else
+	pjmedia_copy_samples(dst, src, count);
+}
+
+/*
+ * Convert a frame written to the master port to the format of the bridge,
+ * in master_rx_buf.
+ */
+static void master_rx_convert( pjmedia_conf *conf,
+			       const pj_int16_t *src )
+{
+    pj_int16_t *dst = conf->master_rx_buf;
+    unsigned count = conf->master_spf;
+
+    if (conf->master_rx_resample) {
+	pjmedia_resample_run(conf->master_rx_resample, src, dst);
+	count = conf->samples_per_frame / conf->channel_count *
+		conf->master_channel_count;
+    } else {
+	pjmedia_copy_samples(dst, src, count);
+    }
+
+    /* In place */
+    if (conf->master_channel_count != conf->channel_count) {
+	if (conf->channel_count == 1) {
+	    pjmedia_convert_channel_nto1(dst, dst,
+					 conf->master_channel_count, count,
+					 PJMEDIA_STEREO_MIX, 0);
+	} else {
+	    pjmedia_convert_channel_1ton(dst, dst, conf->channel_count,
+					 count, 0);
+	}
+    }
+}
+
 /*
  * Create conference bridge.
  */
@@ -532,31 +838,112 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
 					 unsigned bits_per_sample,
 					 unsigned options,
 					 pjmedia_conf **p_conf )
+{
+    pjmedia_conf_param param;
+
+    pjmedia_conf_param_default(&param);
+    param.max_slots = max_ports;
+    param.sampling_rate = clock_rate;
+    param.channel_count = channel_count;
+    param.samples_per_frame = samples_per_frame;
+    param.bits_per_sample = bits_per_sample;
+    param.options = options;
+
+    return pjmedia_conf_create2(pool, &param, p_conf);
+}
+
+/*
+ * Initialize the bridge settings.
+ */
+PJ_DEF(void) pjmedia_conf_param_default(pjmedia_conf_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->max_slots = 16;
+    param->sampling_rate = 8000;
+    param->channel_count = 1;
+    param->samples_per_frame = 160;
+    param->bits_per_sample = 16;
+}
+
+/*
+ * Create conference bridge with the specified settings.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_create2( pj_pool_t *pool,
+					  const pjmedia_conf_param *param,
+					  pjmedia_conf **p_conf )
 {
     pjmedia_conf *conf;
     const pj_str_t name = { "Conf", 4 };
+    unsigned max_ports, clock_rate, channel_count, samples_per_frame;
+    unsigned bits_per_sample, options;
     pj_status_t status;
 
+    PJ_ASSERT_RETURN(pool && param && p_conf, PJ_EINVAL);
+
+    max_ports = param->max_slots;
+    options = param->options;
+    bits_per_sample = param->bits_per_sample;
+
     /* Can only accept 16bits per sample, for now.. */
     PJ_ASSERT_RETURN(bits_per_sample == 16, PJ_EINVAL);
 
+    /* The mixing format, with the same ptime as port zero */
+    clock_rate = param->mix_clock_rate ? param->mix_clock_rate :
+					 param->sampling_rate;
+    channel_count = param->mix_channel_count ? param->mix_channel_count :
+					       param->channel_count;
+    PJ_ASSERT_RETURN(channel_count == param->channel_count ||
+		     channel_count == 1 || param->channel_count == 1,
+		     PJ_EINVAL);
+    PJ_ASSERT_RETURN(param->samples_per_frame / param->channel_count *
+		     clock_rate % param->sampling_rate == 0, PJ_EINVAL);
+    samples_per_frame = param->samples_per_frame / param->channel_count *
+			clock_rate / param->sampling_rate * channel_count;
+
     PJ_LOG(5,(THIS_FILE, "Creating conference bridge with %d ports",
 	      max_ports));
 
     /* Create and init conf structure. */
     conf = PJ_POOL_ZALLOC_T(pool, pjmedia_conf);
     PJ_ASSERT_RETURN(conf, PJ_ENOMEM);
+    conf->mix_tls = -1;
 
     conf->ports = (struct conf_port**) 
 		  pj_pool_zalloc(pool, max_ports*sizeof(void*));
     PJ_ASSERT_RETURN(conf->ports, PJ_ENOMEM);
 
+    conf->ctl_ports = (struct conf_port**)
+		      pj_pool_zalloc(pool, max_ports*sizeof(void*));
+    PJ_ASSERT_RETURN(conf->ctl_ports, PJ_ENOMEM);
+
     conf->options = options;
     conf->max_ports = max_ports;
     conf->clock_rate = clock_rate;
     conf->channel_count = channel_count;
     conf->samples_per_frame = samples_per_frame;
     conf->bits_per_sample = bits_per_sample;
+    conf->master_clock_rate = param->sampling_rate;
+    conf->master_channel_count = param->channel_count;
+    conf->master_spf = param->samples_per_frame;
+    conf->pf = pool->factory;
+
+    conf->active = (SLOT_TYPE*)
+		   pj_pool_zalloc(pool, max_ports*sizeof(SLOT_TYPE));
+    PJ_ASSERT_RETURN(conf->active, PJ_ENOMEM);
+
+    conf->spk = (SLOT_TYPE*)
+		pj_pool_zalloc(pool, max_ports*sizeof(SLOT_TYPE));
+    PJ_ASSERT_RETURN(conf->spk, PJ_ENOMEM);
+
+    conf->spk_mix = (pj_int32_t*)
+		    pj_pool_zalloc(pool, samples_per_frame *
+					 sizeof(conf->spk_mix[0]));
+    PJ_ASSERT_RETURN(conf->spk_mix, PJ_ENOMEM);
+
+    conf->spk_tx_buf = (pj_int16_t*)
+		       pj_pool_zalloc(pool, samples_per_frame *
+					    sizeof(conf->spk_tx_buf[0]));
+    PJ_ASSERT_RETURN(conf->spk_tx_buf, PJ_ENOMEM);
 
     
     /* Create and initialize the master port interface. */
@@ -564,8 +951,9 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
     PJ_ASSERT_RETURN(conf->master_port, PJ_ENOMEM);
     
     pjmedia_port_info_init(&conf->master_port->info, &name, SIGNATURE,
-			   clock_rate, channel_count, bits_per_sample,
-			   samples_per_frame);
+			   conf->master_clock_rate,
+			   conf->master_channel_count, bits_per_sample,
+			   conf->master_spf);
 
     conf->master_port->port_data.pdata = conf;
     conf->master_port->port_data.ldata = 0;
@@ -574,6 +962,15 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
     conf->master_port->put_frame = &put_frame;
     conf->master_port->on_destroy = &destroy_port;
 
+    /* Convert port zero if the bridge mixes in another format */
+    if (conf->master_clock_rate != conf->clock_rate ||
+	conf->master_channel_count != conf->channel_count)
+    {
+	status = create_master_conv(pool, conf);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+
 
     /* Create port zero for sound device. */
     status = create_sound_port(pool, conf);
@@ -589,6 +986,40 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool,
 	return status;
     }
 
+    /* Create the mixing mutex and the queues of changes. The thread
+     * local marks the threads mixing a frame, the changes they make to
+     * the bridge from the port callbacks are applied at the end of the
+     * frame.
+     */
+    status = pj_mutex_create_recursive(pool, "confmix", &conf->mix_mutex);
+    if (status != PJ_SUCCESS) {
+	pjmedia_conf_destroy(conf);
+	return status;
+    }
+
+    status = pj_thread_local_alloc(&conf->mix_tls);
+    if (status != PJ_SUCCESS) {
+	conf->mix_tls = -1;
+	pjmedia_conf_destroy(conf);
+	return status;
+    }
+
+    conf->op_pool = pj_pool_create(conf->pf, "confop%p", 256, 256, NULL);
+    if (!conf->op_pool) {
+	pjmedia_conf_destroy(conf);
+	return PJ_ENOMEM;
+    }
+
+    status = pj_atomic_create(conf->op_pool, 0, &conf->op_cnt);
+    if (status == PJ_SUCCESS)
+	status = pj_mpsc_queue_create(conf->op_pool, &conf->op_queue);
+    if (status == PJ_SUCCESS)
+	status = pj_mpsc_queue_create(conf->op_pool, &conf->op_free);
+    if (status != PJ_SUCCESS) {
+	pjmedia_conf_destroy(conf);
+	return status;
+    }
+
     /* If sound device was created, connect sound device to the
      * master port.
      */
@@ -631,6 +1062,262 @@ static pj_status_t resume_sound( pjmedia_conf *conf )
 }
 
 
+/*
+ * Get an op to be queued. Must be called with the conference mutex held,
+ * as it is the only consumer of the free list.
+ */
+static struct conf_op *alloc_op( pjmedia_conf *conf )
+{
+    struct conf_op *op;
+
+    op = (struct conf_op*) pj_mpsc_queue_pop(conf->op_free);
+    if (!op)
+	op = PJ_POOL_ZALLOC_T(conf->op_pool, struct conf_op);
+
+    return op;
+}
+
+/*
+ * Check if the calling thread is mixing a frame of this bridge, i.e. it is
+ * the clock thread in get_frame() or a mixing worker thread, and the call
+ * comes from a port callback.
+ */
+static pj_bool_t in_mix_thread( pjmedia_conf *conf )
+{
+    return conf->mix_tls != -1 && pj_thread_local_get(conf->mix_tls) == conf;
+}
+
+/*
+ * Apply the queued changes to the ports being mixed. Must be called with
+ * the mixing mutex held.
+ */
+static void apply_ops( pjmedia_conf *conf )
+{
+    pj_mpsc_node *node;
+
+    while ((node = pj_mpsc_queue_pop(conf->op_queue)) != NULL) {
+	struct conf_op *op = (struct conf_op*) node;
+	struct conf_port *src_port, *dst_port;
+	pjmedia_conf_remove_cb removed_cb = NULL;
+	void *removed_data = NULL;
+	unsigned slot = op->slot;
+	unsigned i, j;
+
+	switch (op->type) {
+	case OP_ADD_PORT:
+	    conf->ports[op->slot] = op->port;
+	    ++conf->port_cnt;
+	    break;
+
+	case OP_REMOVE_PORT:
+	    /* Remove this port from transmit array of other ports. */
+	    for (i=0; i<conf->max_ports; ++i) {
+		src_port = conf->ports[i];
+		if (!src_port)
+		    continue;
+
+		for (j=0; j<src_port->listener_cnt; ++j) {
+		    if (src_port->listener_slots[j] == op->slot) {
+			pj_array_erase(src_port->listener_slots,
+				       sizeof(SLOT_TYPE),
+				       src_port->listener_cnt, j);
+			--src_port->listener_cnt;
+			break;
+		    }
+		}
+	    }
+
+	    /* Update transmitter_cnt of ports we're transmitting to */
+	    src_port = conf->ports[op->slot];
+	    while (src_port->listener_cnt) {
+		j = src_port->listener_slots[--src_port->listener_cnt];
+		--conf->ports[j]->transmitter_cnt;
+	    }
+
+	    /* Destroy pjmedia port if this conf port is passive port,
+	     * i.e: has delay buf.
+	     */
+	    if (src_port->delay_buf) {
+		pjmedia_port_destroy(src_port->port);
+		src_port->port = NULL;
+	    }
+
+	    conf->ports[op->slot] = NULL;
+	    --conf->port_cnt;
+
+	    /* Notify once the op is back in the free list */
+	    removed_cb = op->cb;
+	    removed_data = op->user_data;
+	    break;
+
+	case OP_CONNECT:
+	    src_port = conf->ports[op->slot];
+	    dst_port = conf->ports[op->sink];
+	    src_port->listener_slots[src_port->listener_cnt++] = op->sink;
+	    ++dst_port->transmitter_cnt;
+	    break;
+
+	case OP_ADD_SPK_RATE:
+	    /* The spk_rate has been filled before the op was queued */
+	    ++conf->spk_rate_cnt;
+	    break;
+
+	case OP_DISCONNECT:
+	    src_port = conf->ports[op->slot];
+	    dst_port = conf->ports[op->sink];
+	    for (i=0; i<src_port->listener_cnt; ++i) {
+		if (src_port->listener_slots[i] == op->sink)
+		    break;
+	    }
+	    pj_assert(i != src_port->listener_cnt);
+	    pj_array_erase(src_port->listener_slots, sizeof(SLOT_TYPE),
+			   src_port->listener_cnt, i);
+	    --src_port->listener_cnt;
+	    --dst_port->transmitter_cnt;
+	    break;
+
+	case OP_CONFIGURE_PORT:
+	    if (op->tx != PJMEDIA_PORT_NO_CHANGE)
+		conf->ports[op->slot]->tx_setting = op->tx;
+	    if (op->rx != PJMEDIA_PORT_NO_CHANGE)
+		conf->ports[op->slot]->rx_setting = op->rx;
+	    break;
+
+	case OP_ADJUST_RX_LEVEL:
+	    conf->ports[op->slot]->rx_adj_level = op->level;
+	    break;
+
+	case OP_ADJUST_TX_LEVEL:
+	    conf->ports[op->slot]->tx_adj_level = op->level;
+	    break;
+	}
+
+	pj_mpsc_queue_push(conf->op_free, &op->node);
+	pj_atomic_dec(conf->op_cnt);
+
+	if (removed_cb)
+	    (*removed_cb)(conf, slot, removed_data);
+    }
+}
+
+/*
+ * Queue a change to the ports being mixed. Must be called with the
+ * conference mutex held. If the bridge is not mixing, the change is
+ * applied right away, otherwise the clock thread applies it at the end
+ * of the frame being mixed, or before the next one. This never waits for
+ * the mixing mutex, since the clock thread may be waiting for the
+ * conference mutex in a port callback. Returns PJ_TRUE if the change has
+ * been applied.
+ *
+ * The change may also have been queued while another API thread held
+ * the mixing mutex, after it had emptied the queue. That thread sees the
+ * count and applies it after unlocking, so that the change doesn't wait
+ * for the next frame, which never comes if the bridge is not clocked.
+ */
+static pj_bool_t post_op( pjmedia_conf *conf, struct conf_op *op )
+{
+    pj_bool_t applied = PJ_FALSE;
+
+    pj_mpsc_queue_push(conf->op_queue, &op->node);
+    pj_atomic_inc(conf->op_cnt);
+
+    if (in_mix_thread(conf))
+	return PJ_FALSE;
+
+    while (pj_atomic_get(conf->op_cnt) > 0 &&
+	   pj_mutex_trylock(conf->mix_mutex) == PJ_SUCCESS)
+    {
+	apply_ops(conf);
+	pj_mutex_unlock(conf->mix_mutex);
+	applied = PJ_TRUE;
+    }
+
+    return applied;
+}
+
+
+/*
+ * Resample the shared mix of the active speakers, as already converted to
+ * 16bit with the level adj. Must be called once per frame for each rate.
+ */
+static void run_spk_rate( pjmedia_conf *conf, struct spk_rate *rate,
+			  const pj_int16_t *buf, unsigned adj )
+{
+    pj_int16_t *in = rate->prev_in;
+
+    rate->prev_in = rate->in;
+    rate->in = in;
+    if (buf != in)
+	pjmedia_copy_samples(in, buf, conf->samples_per_frame);
+
+    pjmedia_resample_run(rate->resample, in, rate->buf);
+    rate->adj = adj;
+    rate->valid = PJ_TRUE;
+}
+
+/*
+ * Make sure the shared mix of the active speakers can be resampled to the
+ * clock rate of a new port. Must be called with the conference mutex
+ * held. Failure is not fatal, the port will just resample the shared mix
+ * by itself.
+ */
+static void add_spk_rate( pjmedia_conf *conf, unsigned clock_rate )
+{
+    struct spk_rate *rate;
+    struct conf_op *op;
+    unsigned i, count;
+    pj_status_t status;
+
+    if (clock_rate == conf->clock_rate)
+	return;
+
+    for (i=0; i<conf->ctl_spk_rate_cnt; ++i) {
+	if (conf->spk_rate[i].clock_rate == clock_rate)
+	    return;
+    }
+
+    if (conf->ctl_spk_rate_cnt == MAX_SPK_RATES)
+	return;
+
+    op = alloc_op(conf);
+    if (!op)
+	return;
+
+    rate = &conf->spk_rate[conf->ctl_spk_rate_cnt];
+    status = pjmedia_resample_create(conf->op_pool,
+				     (conf->options & PJMEDIA_CONF_USE_LINEAR)
+					== 0,
+				     (conf->options & PJMEDIA_CONF_SMALL_FILTER)
+					== 0,
+				     conf->channel_count,
+				     conf->clock_rate,	/* Rate in */
+				     clock_rate,	/* Rate out */
+				     conf->samples_per_frame,
+				     &rate->resample);
+    if (status != PJ_SUCCESS) {
+	pj_mpsc_queue_push(conf->op_free, &op->node);
+	return;
+    }
+
+    count = conf->samples_per_frame * clock_rate / conf->clock_rate + 1;
+    rate->buf = (pj_int16_t*)
+		pj_pool_zalloc(conf->op_pool, count * sizeof(rate->buf[0]));
+    rate->in = (pj_int16_t*)
+	       pj_pool_zalloc(conf->op_pool,
+			      conf->samples_per_frame * sizeof(rate->in[0]));
+    rate->prev_in = (pj_int16_t*)
+		    pj_pool_zalloc(conf->op_pool, conf->samples_per_frame *
+						  sizeof(rate->prev_in[0]));
+    rate->clock_rate = clock_rate;
+    rate->adj = NORMAL_LEVEL;
+    rate->valid = PJ_FALSE;
+    ++conf->ctl_spk_rate_cnt;
+
+    op->type = OP_ADD_SPK_RATE;
+    post_op(conf, op);
+}
+
+
 /**
  * Destroy conference bridge.
  */
@@ -639,6 +1326,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_destroy( pjmedia_conf *conf )
     unsigned i, ci;
 
     PJ_ASSERT_RETURN(conf != NULL, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!in_mix_thread(conf), PJ_EINVALIDOP);
 
     /* Destroy sound device port. */
     if (conf->snd_dev_port) {
@@ -646,6 +1334,17 @@ PJ_DEF(pj_status_t) pjmedia_conf_destroy( pjmedia_conf *conf )
 	conf->snd_dev_port = NULL;
     }
 
+#if CONF_HAS_MIX_THREADS
+    /* Stop mixing worker threads. */
+    stop_mix_threads(conf);
+#endif
+
+    /* Apply the pending changes, so that ports is up to date and the
+     * callbacks of the pending removals are called.
+     */
+    if (conf->op_free)
+	apply_ops(conf);
+
     /* Destroy delay buf of all (passive) ports. */
     for (i=0, ci=0; i<conf->max_ports && ci<conf->port_cnt; ++i) {
 	struct conf_port *cport;
@@ -664,6 +1363,20 @@ PJ_DEF(pj_status_t) pjmedia_conf_destroy( pjmedia_conf *conf )
     /* Destroy mutex */
     if (conf->mutex)
 	pj_mutex_destroy(conf->mutex);
+    if (conf->mix_mutex)
+	pj_mutex_destroy(conf->mix_mutex);
+    if (conf->mix_tls != -1)
+	pj_thread_local_free(conf->mix_tls);
+
+    /* Destroy the queues */
+    if (conf->op_queue)
+	pj_mpsc_queue_destroy(conf->op_queue);
+    if (conf->op_free)
+	pj_mpsc_queue_destroy(conf->op_free);
+    if (conf->op_cnt)
+	pj_atomic_destroy(conf->op_cnt);
+    if (conf->op_pool)
+	pj_pool_release(conf->op_pool);
 
     return PJ_SUCCESS;
 }
@@ -743,6 +1456,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_add_port( pjmedia_conf *conf,
 					   unsigned *p_port )
 {
     struct conf_port *conf_port;
+    struct conf_op *op;
     unsigned index;
     pj_status_t status;
 
@@ -766,7 +1480,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_add_port( pjmedia_conf *conf,
 
     pj_mutex_lock(conf->mutex);
 
-    if (conf->port_cnt >= conf->max_ports) {
+    if (conf->ctl_port_cnt >= conf->max_ports) {
 	pj_assert(!"Too many ports");
 	pj_mutex_unlock(conf->mutex);
 	return PJ_ETOOMANY;
@@ -774,22 +1488,35 @@ PJ_DEF(pj_status_t) pjmedia_conf_add_port( pjmedia_conf *conf,
 
     /* Find empty port in the conference bridge. */
     for (index=0; index < conf->max_ports; ++index) {
-	if (conf->ports[index] == NULL)
+	if (conf->ctl_ports[index] == NULL)
 	    break;
     }
 
     pj_assert(index != conf->max_ports);
 
+    op = alloc_op(conf);
+    if (!op) {
+	pj_mutex_unlock(conf->mutex);
+	return PJ_ENOMEM;
+    }
+
     /* Create conf port structure. */
     status = create_conf_port(pool, conf, strm_port, port_name, &conf_port);
     if (status != PJ_SUCCESS) {
+	pj_mpsc_queue_push(conf->op_free, &op->node);
 	pj_mutex_unlock(conf->mutex);
 	return status;
     }
 
     /* Put the port. */
-    conf->ports[index] = conf_port;
-    conf->port_cnt++;
+    conf->ctl_ports[index] = conf_port;
+    conf->ctl_port_cnt++;
+    add_spk_rate(conf, conf_port->clock_rate);
+
+    op->type = OP_ADD_PORT;
+    op->slot = index;
+    op->port = conf_port;
+    post_op(conf, op);
 
     /* Done. */
     if (p_port) {
@@ -817,6 +1544,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_add_passive_port( pjmedia_conf *conf,
 						   pjmedia_port **p_port )
 {
     struct conf_port *conf_port;
+    struct conf_op *op;
     pjmedia_port *port;
     unsigned index;
     pj_str_t tmp;
@@ -844,7 +1572,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_add_passive_port( pjmedia_conf *conf,
 
     pj_mutex_lock(conf->mutex);
 
-    if (conf->port_cnt >= conf->max_ports) {
+    if (conf->ctl_port_cnt >= conf->max_ports) {
 	pj_assert(!"Too many ports");
 	pj_mutex_unlock(conf->mutex);
 	return PJ_ETOOMANY;
@@ -852,7 +1580,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_add_passive_port( pjmedia_conf *conf,
 
     /* Find empty port in the conference bridge. */
     for (index=0; index < conf->max_ports; ++index) {
-	if (conf->ports[index] == NULL)
+	if (conf->ctl_ports[index] == NULL)
 	    break;
     }
 
@@ -881,17 +1609,30 @@ PJ_DEF(pj_status_t) pjmedia_conf_add_passive_port( pjmedia_conf *conf,
     port->on_destroy = &destroy_port_pasv;
 
     
+    op = alloc_op(conf);
+    if (!op) {
+	pj_mutex_unlock(conf->mutex);
+	return PJ_ENOMEM;
+    }
+
     /* Create conf port structure. */
     status = create_pasv_port(conf, pool, name, port, &conf_port);
     if (status != PJ_SUCCESS) {
+	pj_mpsc_queue_push(conf->op_free, &op->node);
 	pj_mutex_unlock(conf->mutex);
 	return status;
     }
 
 
     /* Put the port. */
-    conf->ports[index] = conf_port;
-    conf->port_cnt++;
+    conf->ctl_ports[index] = conf_port;
+    conf->ctl_port_cnt++;
+    add_spk_rate(conf, conf_port->clock_rate);
+
+    op->type = OP_ADD_PORT;
+    op->slot = index;
+    op->port = conf_port;
+    post_op(conf, op);
 
     /* Done. */
     if (p_slot)
@@ -915,6 +1656,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_configure_port( pjmedia_conf *conf,
 						  pjmedia_port_op rx)
 {
     struct conf_port *conf_port;
+    struct conf_op *op;
 
     /* Check arguments */
     PJ_ASSERT_RETURN(conf && slot<conf->max_ports, PJ_EINVAL);
@@ -922,19 +1664,29 @@ PJ_DEF(pj_status_t) pjmedia_conf_configure_port( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[slot];
+    conf_port = conf->ctl_ports[slot];
     if (conf_port == NULL) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
-    conf_port = conf->ports[slot];
+    op = alloc_op(conf);
+    if (!op) {
+	pj_mutex_unlock(conf->mutex);
+	return PJ_ENOMEM;
+    }
 
     if (tx != PJMEDIA_PORT_NO_CHANGE)
-	conf_port->tx_setting = tx;
+	conf_port->ctl_tx_setting = tx;
 
     if (rx != PJMEDIA_PORT_NO_CHANGE)
-	conf_port->rx_setting = rx;
+	conf_port->ctl_rx_setting = rx;
+
+    op->type = OP_CONFIGURE_PORT;
+    op->slot = slot;
+    op->tx = tx;
+    op->rx = rx;
+    post_op(conf, op);
 
     pj_mutex_unlock(conf->mutex);
 
@@ -964,24 +1716,37 @@ PJ_DEF(pj_status_t) pjmedia_conf_connect_port( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Ports must be valid. */
-    src_port = conf->ports[src_slot];
-    dst_port = conf->ports[sink_slot];
+    src_port = conf->ctl_ports[src_slot];
+    dst_port = conf->ctl_ports[sink_slot];
     if (!src_port || !dst_port) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
     /* Check if connection has been made */
-    for (i=0; i<src_port->listener_cnt; ++i) {
-	if (src_port->listener_slots[i] == sink_slot)
+    for (i=0; i<src_port->ctl_listener_cnt; ++i) {
+	if (src_port->ctl_listener_slots[i] == sink_slot)
 	    break;
     }
 
-    if (i == src_port->listener_cnt) {
-	src_port->listener_slots[src_port->listener_cnt] = sink_slot;
+    if (i == src_port->ctl_listener_cnt) {
+	struct conf_op *op;
+
+	op = alloc_op(conf);
+	if (!op) {
+	    pj_mutex_unlock(conf->mutex);
+	    return PJ_ENOMEM;
+	}
+
+	src_port->ctl_listener_slots[src_port->ctl_listener_cnt] = sink_slot;
 	++conf->connect_cnt;
-	++src_port->listener_cnt;
-	++dst_port->transmitter_cnt;
+	++src_port->ctl_listener_cnt;
+	++dst_port->ctl_transmitter_cnt;
+
+	op->type = OP_CONNECT;
+	op->slot = src_slot;
+	op->sink = sink_slot;
+	post_op(conf, op);
 
 	if (conf->connect_cnt == 1)
 	    start_sound = 1;
@@ -1024,29 +1789,42 @@ PJ_DEF(pj_status_t) pjmedia_conf_disconnect_port( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Ports must be valid. */
-    src_port = conf->ports[src_slot];
-    dst_port = conf->ports[sink_slot];
+    src_port = conf->ctl_ports[src_slot];
+    dst_port = conf->ctl_ports[sink_slot];
     if (!src_port || !dst_port) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
     /* Check if connection has been made */
-    for (i=0; i<src_port->listener_cnt; ++i) {
-	if (src_port->listener_slots[i] == sink_slot)
+    for (i=0; i<src_port->ctl_listener_cnt; ++i) {
+	if (src_port->ctl_listener_slots[i] == sink_slot)
 	    break;
     }
 
-    if (i != src_port->listener_cnt) {
-	pj_assert(src_port->listener_cnt > 0 && 
-		  src_port->listener_cnt < conf->max_ports);
-	pj_assert(dst_port->transmitter_cnt > 0 && 
-		  dst_port->transmitter_cnt < conf->max_ports);
-	pj_array_erase(src_port->listener_slots, sizeof(SLOT_TYPE), 
-		       src_port->listener_cnt, i);
+    if (i != src_port->ctl_listener_cnt) {
+	struct conf_op *op;
+
+	op = alloc_op(conf);
+	if (!op) {
+	    pj_mutex_unlock(conf->mutex);
+	    return PJ_ENOMEM;
+	}
+
+	pj_assert(src_port->ctl_listener_cnt > 0 && 
+		  src_port->ctl_listener_cnt < conf->max_ports);
+	pj_assert(dst_port->ctl_transmitter_cnt > 0 && 
+		  dst_port->ctl_transmitter_cnt < conf->max_ports);
+	pj_array_erase(src_port->ctl_listener_slots, sizeof(SLOT_TYPE), 
+		       src_port->ctl_listener_cnt, i);
 	--conf->connect_cnt;
-	--src_port->listener_cnt;
-	--dst_port->transmitter_cnt;
+	--src_port->ctl_listener_cnt;
+	--dst_port->ctl_transmitter_cnt;
+
+	op->type = OP_DISCONNECT;
+	op->slot = src_slot;
+	op->sink = sink_slot;
+	post_op(conf, op);
 
 	PJ_LOG(4,(THIS_FILE,
 		  "Port %d (%.*s) stop transmitting to port %d (%.*s)",
@@ -1058,7 +1836,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_disconnect_port( pjmedia_conf *conf,
 		  dst_port->name.ptr));
 
 	/* if source port is passive port and has no listener, reset delaybuf */
-	if (src_port->delay_buf && src_port->listener_cnt == 0)
+	if (src_port->delay_buf && src_port->ctl_listener_cnt == 0)
 	    pjmedia_delay_buf_reset(src_port->delay_buf);
     }
 
@@ -1076,7 +1854,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_disconnect_port( pjmedia_conf *conf,
  */
 PJ_DEF(unsigned) pjmedia_conf_get_port_count(pjmedia_conf *conf)
 {
-    return conf->port_cnt;
+    return conf->ctl_port_cnt;
 }
 
 /*
@@ -1093,89 +1871,111 @@ PJ_DEF(unsigned) pjmedia_conf_get_connect_count(pjmedia_conf *conf)
  */
 PJ_DEF(pj_status_t) pjmedia_conf_remove_port( pjmedia_conf *conf,
 					      unsigned port )
+{
+    pj_status_t status;
+
+    status = pjmedia_conf_remove_port2(conf, port, NULL, NULL);
+    return (status == PJ_EPENDING) ? PJ_SUCCESS : status;
+}
+
+
+/*
+ * Remove the specified port, and call cb when the bridge has released it.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_remove_port2( pjmedia_conf *conf,
+					       unsigned port,
+					       void *user_data,
+					       pjmedia_conf_remove_cb cb)
 {
     struct conf_port *conf_port;
+    struct conf_op *op;
+    pj_bool_t applied;
     unsigned i;
 
     /* Check arguments */
     PJ_ASSERT_RETURN(conf && port < conf->max_ports, PJ_EINVAL);
 
-    /* Suspend the sound devices.
-     * Don't want to remove port while port is being accessed by sound
-     * device's threads!
-     */
-
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[port];
+    conf_port = conf->ctl_ports[port];
     if (conf_port == NULL) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
-    conf_port->tx_setting = PJMEDIA_PORT_DISABLE;
-    conf_port->rx_setting = PJMEDIA_PORT_DISABLE;
+    op = alloc_op(conf);
+    if (!op) {
+	pj_mutex_unlock(conf->mutex);
+	return PJ_ENOMEM;
+    }
+
+    conf_port->ctl_tx_setting = PJMEDIA_PORT_DISABLE;
+    conf_port->ctl_rx_setting = PJMEDIA_PORT_DISABLE;
 
     /* Remove this port from transmit array of other ports. */
     for (i=0; i<conf->max_ports; ++i) {
 	unsigned j;
 	struct conf_port *src_port;
 
-	src_port = conf->ports[i];
+	src_port = conf->ctl_ports[i];
 
 	if (!src_port)
 	    continue;
 
-	if (src_port->listener_cnt == 0)
+	if (src_port->ctl_listener_cnt == 0)
 	    continue;
 
-	for (j=0; j<src_port->listener_cnt; ++j) {
-	    if (src_port->listener_slots[j] == port) {
-		pj_array_erase(src_port->listener_slots, sizeof(SLOT_TYPE),
-			       src_port->listener_cnt, j);
+	for (j=0; j<src_port->ctl_listener_cnt; ++j) {
+	    if (src_port->ctl_listener_slots[j] == port) {
+		pj_array_erase(src_port->ctl_listener_slots,
+			       sizeof(SLOT_TYPE),
+			       src_port->ctl_listener_cnt, j);
 		pj_assert(conf->connect_cnt > 0);
 		--conf->connect_cnt;
-		--src_port->listener_cnt;
+		--src_port->ctl_listener_cnt;
 		break;
 	    }
 	}
     }
 
     /* Update transmitter_cnt of ports we're transmitting to */
-    while (conf_port->listener_cnt) {
+    while (conf_port->ctl_listener_cnt) {
 	unsigned dst_slot;
 	struct conf_port *dst_port;
 
-	dst_slot = conf_port->listener_slots[conf_port->listener_cnt-1];
-	dst_port = conf->ports[dst_slot];
-	--dst_port->transmitter_cnt;
-	--conf_port->listener_cnt;
+	dst_slot = conf_port->ctl_listener_slots[conf_port->ctl_listener_cnt-1];
+	dst_port = conf->ctl_ports[dst_slot];
+	--dst_port->ctl_transmitter_cnt;
+	--conf_port->ctl_listener_cnt;
 	pj_assert(conf->connect_cnt > 0);
 	--conf->connect_cnt;
     }
 
-    /* Destroy pjmedia port if this conf port is passive port,
-     * i.e: has delay buf.
+    /* Remove the port. The slot may be reused right away, since the ops
+     * are applied in order.
      */
-    if (conf_port->delay_buf) {
-	pjmedia_port_destroy(conf_port->port);
-	conf_port->port = NULL;
-    }
+    conf->ctl_ports[port] = NULL;
+    --conf->ctl_port_cnt;
 
-    /* Remove the port. */
-    conf->ports[port] = NULL;
-    --conf->port_cnt;
+    /* The port is released, and the passive port destroyed, when the
+     * removal is applied. If the bridge is busy mixing, this is done by
+     * the clock thread at the end of the frame, which then calls cb.
+     */
+    op->type = OP_REMOVE_PORT;
+    op->slot = port;
+    op->cb = cb;
+    op->user_data = user_data;
+    applied = post_op(conf, op);
 
     pj_mutex_unlock(conf->mutex);
 
-
     /* Stop sound if there's no connection. */
     if (conf->connect_cnt == 0) {
 	pause_sound(conf);
     }
 
-    return PJ_SUCCESS;
+    return applied ? PJ_SUCCESS : PJ_EPENDING;
 }
 
 
@@ -1194,7 +1994,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_enum_ports( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     for (i=0; i<conf->max_ports && count<*p_count; ++i) {
-	if (!conf->ports[i])
+	if (!conf->ctl_ports[i])
 	    continue;
 
 	ports[count++] = i;
@@ -1223,7 +2023,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_get_port_info( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[slot];
+    conf_port = conf->ctl_ports[slot];
     if (conf_port == NULL) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
@@ -1231,17 +2031,17 @@ PJ_DEF(pj_status_t) pjmedia_conf_get_port_info( pjmedia_conf *conf,
 
     info->slot = slot;
     info->name = conf_port->name;
-    info->tx_setting = conf_port->tx_setting;
-    info->rx_setting = conf_port->rx_setting;
-    info->listener_cnt = conf_port->listener_cnt;
-    info->listener_slots = conf_port->listener_slots;
-    info->transmitter_cnt = conf_port->transmitter_cnt;
+    info->tx_setting = conf_port->ctl_tx_setting;
+    info->rx_setting = conf_port->ctl_rx_setting;
+    info->listener_cnt = conf_port->ctl_listener_cnt;
+    info->listener_slots = conf_port->ctl_listener_slots;
+    info->transmitter_cnt = conf_port->ctl_transmitter_cnt;
     info->clock_rate = conf_port->clock_rate;
     info->channel_count = conf_port->channel_count;
     info->samples_per_frame = conf_port->samples_per_frame;
     info->bits_per_sample = conf->bits_per_sample;
-    info->tx_adj_level = conf_port->tx_adj_level - NORMAL_LEVEL;
-    info->rx_adj_level = conf_port->rx_adj_level - NORMAL_LEVEL;
+    info->tx_adj_level = conf_port->ctl_tx_adj_level - NORMAL_LEVEL;
+    info->rx_adj_level = conf_port->ctl_rx_adj_level - NORMAL_LEVEL;
 
     /* Unlock mutex */
     pj_mutex_unlock(conf->mutex);
@@ -1262,7 +2062,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_get_ports_info(pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     for (i=0; i<conf->max_ports && count<*size; ++i) {
-	if (!conf->ports[i])
+	if (!conf->ctl_ports[i])
 	    continue;
 
 	pjmedia_conf_get_port_info(conf, i, &info[count]);
@@ -1294,7 +2094,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_get_signal_level( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[slot];
+    conf_port = conf->ctl_ports[slot];
     if (conf_port == NULL) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
@@ -1322,6 +2122,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_rx_level( pjmedia_conf *conf,
 						  int adj_level )
 {
     struct conf_port *conf_port;
+    struct conf_op *op;
 
     /* Check arguments */
     PJ_ASSERT_RETURN(conf && slot<conf->max_ports, PJ_EINVAL);
@@ -1336,14 +2137,25 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_rx_level( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[slot];
+    conf_port = conf->ctl_ports[slot];
     if (conf_port == NULL) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
+    op = alloc_op(conf);
+    if (!op) {
+	pj_mutex_unlock(conf->mutex);
+	return PJ_ENOMEM;
+    }
+
     /* Set normalized adjustment level. */
-    conf_port->rx_adj_level = adj_level + NORMAL_LEVEL;
+    conf_port->ctl_rx_adj_level = adj_level + NORMAL_LEVEL;
+
+    op->type = OP_ADJUST_RX_LEVEL;
+    op->slot = slot;
+    op->level = conf_port->ctl_rx_adj_level;
+    post_op(conf, op);
 
     /* Unlock mutex */
     pj_mutex_unlock(conf->mutex);
@@ -1360,6 +2172,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_tx_level( pjmedia_conf *conf,
 						  int adj_level )
 {
     struct conf_port *conf_port;
+    struct conf_op *op;
 
     /* Check arguments */
     PJ_ASSERT_RETURN(conf && slot<conf->max_ports, PJ_EINVAL);
@@ -1374,14 +2187,25 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_tx_level( pjmedia_conf *conf,
     pj_mutex_lock(conf->mutex);
 
     /* Port must be valid. */
-    conf_port = conf->ports[slot];
+    conf_port = conf->ctl_ports[slot];
     if (conf_port == NULL) {
 	pj_mutex_unlock(conf->mutex);
 	return PJ_EINVAL;
     }
 
+    op = alloc_op(conf);
+    if (!op) {
+	pj_mutex_unlock(conf->mutex);
+	return PJ_ENOMEM;
+    }
+
     /* Set normalized adjustment level. */
-    conf_port->tx_adj_level = adj_level + NORMAL_LEVEL;
+    conf_port->ctl_tx_adj_level = adj_level + NORMAL_LEVEL;
+
+    op->type = OP_ADJUST_TX_LEVEL;
+    op->slot = slot;
+    op->level = conf_port->ctl_tx_adj_level;
+    post_op(conf, op);
 
     /* Unlock mutex */
     pj_mutex_unlock(conf->mutex);
@@ -1390,12 +2214,177 @@ PJ_DEF(pj_status_t) pjmedia_conf_adjust_tx_level( pjmedia_conf *conf,
 }
 
 
+#if CONF_HAS_MIX_THREADS
 /*
- * Read from port.
+ * Stop the mixing worker threads and release their resources.
  */
-static pj_status_t read_port( pjmedia_conf *conf,
-			      struct conf_port *cport, pj_int16_t *frame,
-			      pj_size_t count, pjmedia_frame_type *type )
+static void stop_mix_threads(pjmedia_conf *conf)
+{
+    unsigned i;
+
+    if (conf->thread_cnt) {
+	conf->quit_flag = PJ_TRUE;
+	for (i=0; i<conf->thread_cnt; ++i)
+	    pj_sem_post(conf->job_sem);
+
+	for (i=0; i<conf->thread_cnt; ++i) {
+	    pj_thread_join(conf->threads[i]);
+	    pj_thread_destroy(conf->threads[i]);
+	}
+	conf->thread_cnt = 0;
+    }
+
+    if (conf->job_sem) {
+	pj_sem_destroy(conf->job_sem);
+	conf->job_sem = NULL;
+    }
+    if (conf->done_sem) {
+	pj_sem_destroy(conf->done_sem);
+	conf->done_sem = NULL;
+    }
+    if (conf->job_idx) {
+	pj_atomic_destroy(conf->job_idx);
+	conf->job_idx = NULL;
+    }
+    if (conf->job_pending) {
+	pj_atomic_destroy(conf->job_pending);
+	conf->job_pending = NULL;
+    }
+    if (conf->mix_pool) {
+	pj_pool_release(conf->mix_pool);
+	conf->mix_pool = NULL;
+    }
+}
+
+/*
+ * Start the mixing worker threads.
+ */
+static pj_status_t start_mix_threads(pjmedia_conf *conf, unsigned cnt)
+{
+    unsigned i;
+    pj_status_t status;
+
+    conf->mix_pool = pj_pool_create(conf->pf, "confmix%p", 512, 512, NULL);
+    if (!conf->mix_pool)
+	return PJ_ENOMEM;
+
+    conf->threads = (pj_thread_t**)
+		    pj_pool_zalloc(conf->mix_pool, cnt*sizeof(pj_thread_t*));
+
+    status = pj_sem_create(conf->mix_pool, "confjob", 0, cnt,
+			   &conf->job_sem);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pj_sem_create(conf->mix_pool, "confdone", 0, 1,
+			   &conf->done_sem);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pj_atomic_create(conf->mix_pool, 0, &conf->job_idx);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pj_atomic_create(conf->mix_pool, 0, &conf->job_pending);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    conf->quit_flag = PJ_FALSE;
+    for (i=0; i<cnt; ++i) {
+	status = pj_thread_create(conf->mix_pool, "confmix%p",
+				  &mix_worker_thread, conf, 0, 0,
+				  &conf->threads[i]);
+	if (status != PJ_SUCCESS)
+	    return status;
+
+	/* Count the thread now, so that it is stopped on failure */
+	conf->thread_cnt = i + 1;
+    }
+
+    return PJ_SUCCESS;
+}
+#endif	/* CONF_HAS_MIX_THREADS */
+
+/*
+ * Set the number of mixing worker threads.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_set_mix_threads( pjmedia_conf *conf,
+						  unsigned cnt )
+{
+#if CONF_HAS_MIX_THREADS
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(conf && cnt <= MAX_MIX_THREADS, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!in_mix_thread(conf), PJ_EINVALIDOP);
+
+    /* Lock mutex, so the bridge is not processing the ports. The
+     * conference mutex is not needed, as only the mixing state changes.
+     */
+    pj_mutex_lock(conf->mix_mutex);
+
+    stop_mix_threads(conf);
+
+    if (cnt) {
+	status = start_mix_threads(conf, cnt);
+	if (status != PJ_SUCCESS)
+	    stop_mix_threads(conf);
+    }
+
+    pj_mutex_unlock(conf->mix_mutex);
+
+    PJ_LOG(4,(THIS_FILE, "Conference bridge uses %u mixing worker threads",
+	      conf->thread_cnt));
+
+    return status;
+#else
+    PJ_ASSERT_RETURN(conf, PJ_EINVAL);
+    return cnt ? PJ_ENOTSUP : PJ_SUCCESS;
+#endif
+}
+
+
+/*
+ * Set the maximum number of active speakers to be mixed.
+ */
+PJ_DEF(pj_status_t) pjmedia_conf_set_active_speakers( pjmedia_conf *conf,
+						      unsigned max_cnt )
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(conf, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!in_mix_thread(conf), PJ_EINVALIDOP);
+
+    if (max_cnt > conf->max_ports)
+	max_cnt = conf->max_ports;
+
+    pj_mutex_lock(conf->mix_mutex);
+
+    conf->spk_max = max_cnt;
+    conf->spk_cnt = 0;
+    for (i=0; i<conf->max_ports; ++i) {
+	if (conf->ports[i])
+	    conf->ports[i]->is_speaker = PJ_FALSE;
+    }
+
+    pj_mutex_unlock(conf->mix_mutex);
+
+    PJ_LOG(4,(THIS_FILE, "Conference bridge mixes %u active speakers "
+	      "(0=all)", max_cnt));
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Read from port.
+ */
+static void take_rx_buf( pjmedia_conf *conf, struct conf_port *cport,
+			 pj_int16_t *frame, unsigned count );
+
+static pj_status_t read_port( pjmedia_conf *conf,
+			      struct conf_port *cport, pj_int16_t *frame,
+			      pj_size_t count, pj_bool_t defer,
+			      pjmedia_frame_type *type )
 {
 
     pj_assert(count == conf->samples_per_frame);
@@ -1502,42 +2491,63 @@ static pj_status_t read_port( pjmedia_conf *conf,
 	    pj_assert(cport->rx_buf_count <= cport->rx_buf_cap);
 	}
 
-	/*
-	 * If port's clock_rate is different, resample.
-	 * Otherwise just copy.
+	/* The caller may leave the frame in rx_buf until it knows
+	 * whether the frame is going to be mixed, to save resampling it
+	 * when it's not.
 	 */
-	if (cport->clock_rate != conf->clock_rate) {
-	    
-	    unsigned src_count;
+	if (defer && cport->clock_rate != conf->clock_rate) {
+	    cport->rx_deferred = PJ_TRUE;
+	    return PJ_SUCCESS;
+	}
 
-	    TRACE_((THIS_FILE, "  resample, input count=%d", 
-		    pjmedia_resample_get_input_size(cport->rx_resample)));
+	take_rx_buf(conf, cport, frame, (unsigned)count);
+    }
 
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Take a frame out of the RX buffer of the port. If port's clock_rate is
+ * different, resample, otherwise just copy. If frame is NULL, the samples
+ * are dropped.
+ */
+static void take_rx_buf( pjmedia_conf *conf, struct conf_port *cport,
+			 pj_int16_t *frame, unsigned count )
+{
+    if (cport->clock_rate != conf->clock_rate) {
+	
+	unsigned src_count;
+
+	TRACE_((THIS_FILE, "  resample, input count=%d", 
+		pjmedia_resample_get_input_size(cport->rx_resample)));
+
+	if (frame)
 	    pjmedia_resample_run( cport->rx_resample,cport->rx_buf, frame);
 
-	    src_count = (unsigned)(count * 1.0 * cport->clock_rate / 
-				   conf->clock_rate + 0.5);
-	    cport->rx_buf_count -= src_count;
-	    if (cport->rx_buf_count) {
-		pjmedia_move_samples(cport->rx_buf, cport->rx_buf+src_count,
-				     cport->rx_buf_count);
-	    }
+	src_count = (unsigned)(count * 1.0 * cport->clock_rate / 
+			       conf->clock_rate + 0.5);
+	cport->rx_buf_count -= src_count;
+	if (cport->rx_buf_count) {
+	    pjmedia_move_samples(cport->rx_buf, cport->rx_buf+src_count,
+				 cport->rx_buf_count);
+	}
 
-	    TRACE_((THIS_FILE, "  rx buffer size is now %d",
-		    cport->rx_buf_count));
+	TRACE_((THIS_FILE, "  rx buffer size is now %d",
+		cport->rx_buf_count));
 
-	} else {
+    } else {
 
-	    pjmedia_copy_samples(frame, cport->rx_buf, (unsigned)count);
-	    cport->rx_buf_count -= (unsigned)count;
-	    if (cport->rx_buf_count) {
-		pjmedia_move_samples(cport->rx_buf, cport->rx_buf+count,
-				     cport->rx_buf_count);
-	    }
+	if (frame)
+	    pjmedia_copy_samples(frame, cport->rx_buf, count);
+	cport->rx_buf_count -= count;
+	if (cport->rx_buf_count) {
+	    pjmedia_move_samples(cport->rx_buf, cport->rx_buf+count,
+				 cport->rx_buf_count);
 	}
     }
 
-    return PJ_SUCCESS;
+    cport->rx_deferred = PJ_FALSE;
 }
 
 
@@ -1545,11 +2555,12 @@ static pj_status_t read_port( pjmedia_conf *conf,
  * Write the mixed signal to the port.
  */
 static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
+			      const pj_int32_t *mix_buf,
 			      const pj_timestamp *timestamp, 
 			      pjmedia_frame_type *frm_type)
 {
     pj_int16_t *buf;
-    unsigned j, ts;
+    unsigned ts;
     pj_status_t status;
     pj_int32_t adj_level;
     pj_int32_t tx_level;
@@ -1634,29 +2645,28 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
     adj_level = cport->tx_adj_level * cport->mix_adj;
     adj_level >>= 7;
 
-    tx_level = 0;
-
-    if (adj_level != NORMAL_LEVEL) {
-	for (j=0; j<conf->samples_per_frame; ++j) {
-	    pj_int32_t itemp = cport->mix_buf[j];
-
-	    /* Adjust the level */
-	    /*itemp = itemp * adj_level / NORMAL_LEVEL;*/
-	    itemp = (itemp * adj_level) >> 7;
-
-	    /* Clip the signal if it's too loud */
-	    if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
-	    else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
-
-	    /* Put back in the buffer. */
-	    buf[j] = (pj_int16_t) itemp;
-
-	    tx_level += (buf[j]>=0? buf[j] : -buf[j]);
-	}
+    /* Adjust the level, clip the signal if it's too loud, and put it
+     * back in the buffer.
+     *
+     * The shared mix of the active speakers only needs to be converted
+     * once for all listeners with the same level. This is not done with
+     * worker threads, which would have to synchronize on it.
+     */
+    if (mix_buf == conf->spk_mix && conf->thread_cnt == 0 &&
+	conf->spk_tx_valid && conf->spk_tx_adj == (unsigned)adj_level)
+    {
+	pjmedia_copy_samples(buf, conf->spk_tx_buf, conf->samples_per_frame);
+	tx_level = conf->spk_tx_sum;
     } else {
-	for (j=0; j<conf->samples_per_frame; ++j) {
-	    buf[j] = (pj_int16_t) cport->mix_buf[j];
-	    tx_level += (buf[j]>=0? buf[j] : -buf[j]);
+	tx_level = pjmedia_pcm_narrow(buf, mix_buf,
+				      conf->samples_per_frame, adj_level);
+
+	if (mix_buf == conf->spk_mix && conf->thread_cnt == 0) {
+	    pjmedia_copy_samples(conf->spk_tx_buf, buf,
+				 conf->samples_per_frame);
+	    conf->spk_tx_adj = adj_level;
+	    conf->spk_tx_sum = tx_level;
+	    conf->spk_tx_valid = PJ_TRUE;
 	}
     }
 
@@ -1697,10 +2707,61 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
 
     /* If it has different clock_rate, must resample. */
     if (cport->clock_rate != conf->clock_rate) {
-	pjmedia_resample_run( cport->tx_resample, buf, 
-			      cport->tx_buf + cport->tx_buf_count );
+	struct spk_rate *rate = NULL;
+	pj_bool_t shared = PJ_FALSE;
+	unsigned i;
+
 	dst_count = (unsigned)(conf->samples_per_frame * 1.0 *
 			       cport->clock_rate / conf->clock_rate + 0.5);
+
+	/* The shared mix of the active speakers is resampled once for all
+	 * listeners with the same clock rate and level. As the resampler
+	 * keeps the history of its input, it can only run once per frame,
+	 * so listeners with other level resample by themselves.
+	 */
+	if (conf->spk_max) {
+	    for (i=0; i<conf->spk_rate_cnt; ++i) {
+		if (conf->spk_rate[i].clock_rate == cport->clock_rate) {
+		    rate = &conf->spk_rate[i];
+		    break;
+		}
+	    }
+	}
+
+	if (rate && mix_buf == conf->spk_mix && conf->thread_cnt == 0 &&
+	    (!rate->valid || rate->adj == (unsigned)adj_level))
+	{
+	    if (!rate->valid)
+		run_spk_rate(conf, rate, buf, adj_level);
+
+	    /* The output of the shared resampler only continues the signal
+	     * of this listener if it had the same input on the last frame,
+	     * otherwise switch to it on the next frame.
+	     */
+	    shared = cport->tx_shared;
+	    cport->tx_shared = PJ_TRUE;
+	} else {
+	    cport->tx_shared = PJ_FALSE;
+	}
+
+	if (shared) {
+	    pjmedia_copy_samples(cport->tx_buf + cport->tx_buf_count,
+				 rate->buf, dst_count);
+	    cport->tx_stale = PJ_TRUE;
+	} else {
+	    /* If the shared resampler was used on the last frame, give the
+	     * input of that frame to tx_resample first as its history.
+	     */
+	    if (cport->tx_stale && rate) {
+		pjmedia_resample_run(cport->tx_resample,
+				     rate->valid ? rate->prev_in : rate->in,
+				     cport->tx_buf + cport->tx_buf_count);
+	    }
+	    cport->tx_stale = PJ_FALSE;
+
+	    pjmedia_resample_run( cport->tx_resample, buf, 
+				  cport->tx_buf + cport->tx_buf_count );
+	}
     } else {
 	/* Same clock rate.
 	 * Just copy the samples to tx_buffer.
@@ -1782,28 +2843,228 @@ static pj_status_t write_port(pjmedia_conf *conf, struct conf_port *cport,
 
 
 /*
- * Player callback.
+ * Get frame from the port to be mixed to its listeners, adjust the RX
+ * level of the frame and calculate the average level at the same time.
+ * Returns PJ_FALSE if there is nothing to be mixed from the port.
+ *
+ * If defer is set, a frame which needs resampling is left in the RX
+ * buffer of the port, and its level is calculated at the port's clock
+ * rate. The frame must then be finished by finish_rx().
  */
-static pj_status_t get_frame(pjmedia_port *this_port, 
-			     pjmedia_frame *frame)
+static pj_bool_t get_rx_frame( pjmedia_conf *conf, unsigned slot,
+			       pj_int16_t *p_in, pj_bool_t defer )
 {
-    pjmedia_conf *conf = (pjmedia_conf*) this_port->port_data.pdata;
-    pjmedia_frame_type speaker_frame_type = PJMEDIA_FRAME_TYPE_NONE;
-    unsigned ci, cj, i, j;
-    pj_int16_t *p_in;
+    struct conf_port *conf_port = conf->ports[slot];
+    pj_int32_t level;
+
+    /* Skip if we're not allowed to receive from this port. */
+    if (conf_port->rx_setting == PJMEDIA_PORT_DISABLE) {
+	conf_port->rx_level = 0;
+	return PJ_FALSE;
+    }
+
+    /* Also skip if this port doesn't have listeners. */
+    if (conf_port->listener_cnt == 0) {
+	conf_port->rx_level = 0;
+	return PJ_FALSE;
+    }
+
+    /* Get frame from this port.
+     * For passive ports, get the frame from the delay_buf.
+     * For other ports, get the frame from the port. 
+     */
+    if (conf_port->delay_buf != NULL) {
+	pj_status_t status;
     
-    TRACE_((THIS_FILE, "- clock -"));
+	status = pjmedia_delay_buf_get(conf_port->delay_buf, p_in);
+	if (status != PJ_SUCCESS) {
+	    conf_port->rx_level = 0;
+	    return PJ_FALSE;
+	}		
 
-    /* Check that correct size is specified. */
-    pj_assert(frame->size == conf->samples_per_frame *
-			     conf->bits_per_sample / 8);
+    } else {
 
-    /* Must lock mutex */
-    pj_mutex_lock(conf->mutex);
+	pj_status_t status;
+	pjmedia_frame_type frame_type;
+
+	status = read_port(conf, conf_port, p_in, 
+			   conf->samples_per_frame, defer, &frame_type);
+	
+	if (status != PJ_SUCCESS) {
+	    /* bennylp: why do we need this????
+	     * Also see comments on similar issue with write_port().
+	    PJ_LOG(4,(THIS_FILE, "Port %.*s get_frame() returned %d. "
+				 "Port is now disabled",
+				 (int)conf_port->name.slen,
+				 conf_port->name.ptr,
+				 status));
+	    conf_port->rx_setting = PJMEDIA_PORT_DISABLE;
+	     */
+	    conf_port->rx_level = 0;
+	    return PJ_FALSE;
+	}
 
-    /* Reset port source count. We will only reset port's mix
-     * buffer when we have someone transmitting to it.
+	/* Check that the port is not removed when we call get_frame() */
+	if (conf->ports[slot] == NULL) {
+	    conf_port->rx_level = 0;
+	    return PJ_FALSE;
+	}
+	    
+
+	/* Ignore if we didn't get any frame */
+	if (frame_type != PJMEDIA_FRAME_TYPE_AUDIO) {
+	    conf_port->rx_level = 0;
+	    return PJ_FALSE;
+	}		
+    }
+
+    /* Adjust the RX level from this port
+     * and calculate the average level at the same time.
      */
+    if (conf_port->rx_deferred) {
+	unsigned src_count;
+
+	/* The level is the same at any clock rate, the adjustment is
+	 * done by finish_rx() after resampling.
+	 */
+	src_count = (unsigned)(conf->samples_per_frame * 1.0 *
+			       conf_port->clock_rate / conf->clock_rate + 0.5);
+	level = pjmedia_pcm_sum_abs(conf_port->rx_buf, src_count) / src_count;
+	level = (level * conf_port->rx_adj_level) >> 7;
+	if (level > MAX_LEVEL)
+	    level = MAX_LEVEL;
+    } else {
+	if (conf_port->rx_adj_level != NORMAL_LEVEL) {
+	    level = pjmedia_pcm_adjust(p_in, conf->samples_per_frame,
+				       conf_port->rx_adj_level);
+	} else {
+	    level = pjmedia_pcm_sum_abs(p_in, conf->samples_per_frame);
+	}
+
+	level /= conf->samples_per_frame;
+    }
+
+    /* Convert level to 8bit complement ulaw */
+    level = pjmedia_linear2ulaw(level) ^ 0xff;
+
+    /* Put this level to port's last RX level. */
+    conf_port->rx_level = level;
+
+    // Ticket #671: Skipping very low audio signal may cause noise 
+    // to be generated in the remote end by some hardphones.
+    /* Skip processing frame if level is zero */
+    //if (level == 0)
+    //    return PJ_FALSE;
+
+    return PJ_TRUE;
+}
+
+
+/*
+ * Lower the adjustment level of a mix buffer if the range of the mixed
+ * samples overflows.
+ */
+static void update_mix_adj( int *mix_adj, pj_int32_t mix_buf_min,
+			    pj_int32_t mix_buf_max )
+{
+    /* Check if normalization adjustment needed. */
+    if (mix_buf_min < MIN_LEVEL || mix_buf_max > MAX_LEVEL) {
+	int tmp_adj;
+
+	if (-mix_buf_min > mix_buf_max)
+	    mix_buf_max = -mix_buf_min;
+
+	/* NORMAL_LEVEL * MAX_LEVEL / mix_buf_max; */
+	tmp_adj = (MAX_LEVEL<<7) / mix_buf_max;
+	if (tmp_adj < *mix_adj)
+	    *mix_adj = tmp_adj;
+    }
+}
+
+
+/*
+ * Add the signal to the mix buffer of the listener.
+ */
+static void mix_signal( pjmedia_conf *conf, struct conf_port *listener,
+			const pj_int16_t *p_in )
+{
+    pj_int32_t *mix_buf = listener->mix_buf;
+
+    if (listener->transmitter_cnt > 1) {
+	/* Mixing signals,
+	 * and calculate appropriate level adjustment if there is
+	 * any overflowed level in the mixed signal.
+	 */
+	pj_int32_t mix_buf_min;
+	pj_int32_t mix_buf_max;
+
+	pjmedia_pcm_mix(mix_buf, p_in, conf->samples_per_frame,
+			&mix_buf_min, &mix_buf_max);
+	update_mix_adj(&listener->mix_adj, mix_buf_min, mix_buf_max);
+    } else {
+	/* Only 1 transmitter:
+	 * just copy the samples to the mix buffer
+	 * no mixing and level adjustment needed
+	 */
+	pjmedia_pcm_widen(mix_buf, p_in, conf->samples_per_frame);
+    }
+}
+
+
+/*
+ * Make the mix buffer of an active speaker from the mix of all active
+ * speakers, by removing the speaker's own signal.
+ */
+static void mix_minus_self( pjmedia_conf *conf, struct conf_port *speaker )
+{
+    const pj_int16_t *self = speaker->rx_frame;
+    pj_int32_t *mix_buf = speaker->mix_buf;
+    pj_int32_t mix_buf_min = 0, mix_buf_max = 0;
+    unsigned i;
+
+    for (i=0; i<conf->samples_per_frame; ++i) {
+	pj_int32_t s = conf->spk_mix[i] - self[i];
+
+	mix_buf[i] = s;
+	if (s < mix_buf_min)
+	    mix_buf_min = s;
+	else if (s > mix_buf_max)
+	    mix_buf_max = s;
+    }
+
+    update_mix_adj(&speaker->mix_adj, mix_buf_min, mix_buf_max);
+}
+
+
+/*
+ * Reset the mix buffer of the port. We will only reset port's mix
+ * buffer when we have someone transmitting to it.
+ */
+static void reset_mix_buf( pjmedia_conf *conf, struct conf_port *conf_port )
+{
+    /* Reset buffer (only necessary if the port has transmitter) and
+     * reset auto adjustment level for mixed signal.
+     */
+    conf_port->mix_adj = NORMAL_LEVEL;
+    if (conf_port->transmitter_cnt) {
+	pj_bzero(conf_port->mix_buf,
+		 conf->samples_per_frame*sizeof(conf_port->mix_buf[0]));
+    }
+}
+
+
+/*
+ * Process all ports in the calling thread. The frame is used as the
+ * temporary buffer. Returns the type of the frame written to port zero.
+ */
+static pjmedia_frame_type process_serial( pjmedia_conf *conf,
+					  pjmedia_frame *frame )
+{
+    pjmedia_frame_type speaker_frame_type = PJMEDIA_FRAME_TYPE_NONE;
+    unsigned ci, cj, i;
+    pj_int16_t *p_in;
+
+    /* Reset port source count. */
     for (i=0, ci=0; i<conf->max_ports && ci < conf->port_cnt; ++i) {
 	struct conf_port *conf_port = conf->ports[i];
 
@@ -1814,22 +3075,15 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	/* Var "ci" is to count how many ports have been visited so far. */
 	++ci;
 
-	/* Reset buffer (only necessary if the port has transmitter) and
-	 * reset auto adjustment level for mixed signal.
-	 */
-	conf_port->mix_adj = NORMAL_LEVEL;
-	if (conf_port->transmitter_cnt) {
-	    pj_bzero(conf_port->mix_buf,
-		     conf->samples_per_frame*sizeof(conf_port->mix_buf[0]));
-	}
+	reset_mix_buf(conf, conf_port);
     }
 
     /* Get frames from all ports, and "mix" the signal 
      * to mix_buf of all listeners of the port.
      */
+    p_in = (pj_int16_t*) frame->buf;
     for (i=0, ci=0; i < conf->max_ports && ci < conf->port_cnt; ++i) {
 	struct conf_port *conf_port = conf->ports[i];
-	pj_int32_t level = 0;
 
 	/* Skip empty port. */
 	if (!conf_port)
@@ -1838,121 +3092,13 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	/* Var "ci" is to count how many ports have been visited so far. */
 	++ci;
 
-	/* Skip if we're not allowed to receive from this port. */
-	if (conf_port->rx_setting == PJMEDIA_PORT_DISABLE) {
-	    conf_port->rx_level = 0;
+	if (!get_rx_frame(conf, i, p_in, PJ_FALSE))
 	    continue;
-	}
-
-	/* Also skip if this port doesn't have listeners. */
-	if (conf_port->listener_cnt == 0) {
-	    conf_port->rx_level = 0;
-	    continue;
-	}
-
-	/* Get frame from this port.
-	 * For passive ports, get the frame from the delay_buf.
-	 * For other ports, get the frame from the port. 
-	 */
-	if (conf_port->delay_buf != NULL) {
-	    pj_status_t status;
-	
-	    status = pjmedia_delay_buf_get(conf_port->delay_buf,
-				  (pj_int16_t*)frame->buf);
-	    if (status != PJ_SUCCESS) {
-		conf_port->rx_level = 0;
-		continue;
-	    }		
-
-	} else {
-
-	    pj_status_t status;
-	    pjmedia_frame_type frame_type;
-
-	    status = read_port(conf, conf_port, (pj_int16_t*)frame->buf, 
-			       conf->samples_per_frame, &frame_type);
-	    
-	    if (status != PJ_SUCCESS) {
-		/* bennylp: why do we need this????
-		 * Also see comments on similar issue with write_port().
-		PJ_LOG(4,(THIS_FILE, "Port %.*s get_frame() returned %d. "
-				     "Port is now disabled",
-				     (int)conf_port->name.slen,
-				     conf_port->name.ptr,
-				     status));
-		conf_port->rx_setting = PJMEDIA_PORT_DISABLE;
-		 */
-		conf_port->rx_level = 0;
-		continue;
-	    }
-
-	    /* Check that the port is not removed when we call get_frame() */
-	    if (conf->ports[i] == NULL) {
-		conf_port->rx_level = 0;
-		continue;
-	    }
-		
-
-	    /* Ignore if we didn't get any frame */
-	    if (frame_type != PJMEDIA_FRAME_TYPE_AUDIO) {
-		conf_port->rx_level = 0;
-		continue;
-	    }		
-	}
-
-	p_in = (pj_int16_t*) frame->buf;
-
-	/* Adjust the RX level from this port
-	 * and calculate the average level at the same time.
-	 */
-	if (conf_port->rx_adj_level != NORMAL_LEVEL) {
-	    for (j=0; j<conf->samples_per_frame; ++j) {
-		/* For the level adjustment, we need to store the sample to
-		 * a temporary 32bit integer value to avoid overflowing the
-		 * 16bit sample storage.
-		 */
-		pj_int32_t itemp;
-
-		itemp = p_in[j];
-		/*itemp = itemp * adj / NORMAL_LEVEL;*/
-		/* bad code (signed/unsigned badness):
-		 *  itemp = (itemp * conf_port->rx_adj_level) >> 7;
-		 */
-		itemp *= conf_port->rx_adj_level;
-		itemp >>= 7;
-
-		/* Clip the signal if it's too loud */
-		if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
-		else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
-
-		p_in[j] = (pj_int16_t) itemp;
-		level += (p_in[j]>=0? p_in[j] : -p_in[j]);
-	    }
-	} else {
-	    for (j=0; j<conf->samples_per_frame; ++j) {
-		level += (p_in[j]>=0? p_in[j] : -p_in[j]);
-	    }
-	}
-
-	level /= conf->samples_per_frame;
-
-	/* Convert level to 8bit complement ulaw */
-	level = pjmedia_linear2ulaw(level) ^ 0xff;
-
-	/* Put this level to port's last RX level. */
-	conf_port->rx_level = level;
-
-	// Ticket #671: Skipping very low audio signal may cause noise 
-	// to be generated in the remote end by some hardphones.
-	/* Skip processing frame if level is zero */
-	//if (level == 0)
-	//    continue;
 
 	/* Add the signal to all listeners. */
 	for (cj=0; cj < conf_port->listener_cnt; ++cj) 
 	{
 	    struct conf_port *listener;
-	    pj_int32_t *mix_buf;
 
 	    listener = conf->ports[conf_port->listener_slots[cj]];
 
@@ -1960,48 +3106,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	    if (listener->tx_setting != PJMEDIA_PORT_ENABLE)
 		continue;
 
-	    mix_buf = listener->mix_buf;
-
-	    if (listener->transmitter_cnt > 1) {
-		/* Mixing signals,
-		 * and calculate appropriate level adjustment if there is
-		 * any overflowed level in the mixed signal.
-		 */
-		unsigned k, samples_per_frame = conf->samples_per_frame;
-		pj_int32_t mix_buf_min = 0;
-		pj_int32_t mix_buf_max = 0;
-
-		for (k = 0; k < samples_per_frame; ++k) {
-		    mix_buf[k] += p_in[k];
-		    if (mix_buf[k] < mix_buf_min)
-			mix_buf_min = mix_buf[k];
-		    if (mix_buf[k] > mix_buf_max)
-			mix_buf_max = mix_buf[k];
-		}
-
-		/* Check if normalization adjustment needed. */
-		if (mix_buf_min < MIN_LEVEL || mix_buf_max > MAX_LEVEL) {
-		    int tmp_adj;
-
-		    if (-mix_buf_min > mix_buf_max)
-			mix_buf_max = -mix_buf_min;
-
-		    /* NORMAL_LEVEL * MAX_LEVEL / mix_buf_max; */
-		    tmp_adj = (MAX_LEVEL<<7) / mix_buf_max;
-		    if (tmp_adj < listener->mix_adj)
-			listener->mix_adj = tmp_adj;
-		}
-	    } else {
-		/* Only 1 transmitter:
-		 * just copy the samples to the mix buffer
-		 * no mixing and level adjustment needed
-		 */
-		unsigned k, samples_per_frame = conf->samples_per_frame;
-
-		for (k = 0; k < samples_per_frame; ++k) {
-		    mix_buf[k] = p_in[k];
-		}
-	    }
+	    mix_signal(conf, listener, p_in);
 	} /* loop the listeners of conf port */
     } /* loop of all conf ports */
 
@@ -2019,8 +3124,8 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	/* Var "ci" is to count how many ports have been visited. */
 	++ci;
 
-	status = write_port( conf, conf_port, &frame->timestamp,
-			     &frm_type);
+	status = write_port( conf, conf_port, conf_port->mix_buf,
+			     &frame->timestamp, &frm_type);
 	if (status != PJ_SUCCESS) {
 	    /* bennylp: why do we need this????
 	       One thing for sure, put_frame()/write_port() may return
@@ -2045,13 +3150,474 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	    speaker_frame_type = frm_type;
     }
 
+    return speaker_frame_type;
+}
+
+
+/* Phases of the processing in phases */
+enum
+{
+    JOB_READ,		/* Get frames from the ports.			    */
+    JOB_WRITE		/* Mix the frames and write them to the ports.	    */
+};
+
+/* How the mix buffer of a listener is made in the write phase */
+enum
+{
+    MIX_SOURCES,	/* Mix the frames of the ports in mix_src.	    */
+    MIX_SHARED,		/* Use the mix of all active speakers.		    */
+    MIX_MINUS_SELF	/* Mix of all active speakers minus its own frame.  */
+};
+
+/*
+ * Process one port in the current phase.
+ */
+static void run_job( pjmedia_conf *conf, unsigned idx )
+{
+    SLOT_TYPE slot = conf->active[idx];
+    struct conf_port *conf_port = conf->ports[slot];
+    const pj_int32_t *mix_buf;
+    pjmedia_frame_type frm_type;
+    unsigned k;
+
+    if (!conf_port)
+	return;
+
+    if (conf->job_phase == JOB_READ) {
+	/* With active speaker mixing, only the frames of the speakers are
+	 * mixed, so resampling can wait until they have been selected.
+	 */
+	conf_port->rx_ok = get_rx_frame(conf, slot, conf_port->rx_frame,
+					conf->spk_max != 0);
+	return;
+    }
+
+    mix_buf = conf_port->mix_buf;
+
+    switch (conf_port->mix_mode) {
+    case MIX_SHARED:
+	mix_buf = conf->spk_mix;
+	conf_port->mix_adj = conf->spk_mix_adj;
+	break;
+    case MIX_MINUS_SELF:
+	conf_port->mix_adj = NORMAL_LEVEL;
+	mix_minus_self(conf, conf_port);
+	break;
+    default:
+	reset_mix_buf(conf, conf_port);
+
+	/* Mix the frames of the transmitters in slot order, so the result
+	 * is the same as when the ports are processed serially.
+	 */
+	for (k=0; k<conf_port->mix_src_cnt; ++k) {
+	    struct conf_port *src = conf->ports[conf_port->mix_src[k]];
+	    if (src)
+		mix_signal(conf, conf_port, src->rx_frame);
+	}
+	break;
+    }
+
+    /* See process_serial() about write_port() failure */
+    if (write_port(conf, conf_port, mix_buf, conf->timestamp,
+		   &frm_type) == PJ_SUCCESS && slot == 0)
+    {
+	conf->spk_frame_type = frm_type;
+    }
+}
+
+#if CONF_HAS_MIX_THREADS
+
+/*
+ * Take jobs until there's none left. The last thread to finish signals
+ * done_sem.
+ */
+static void run_jobs( pjmedia_conf *conf )
+{
+    unsigned idx;
+
+    for (;;) {
+	idx = (unsigned)pj_atomic_inc_and_get(conf->job_idx) - 1;
+	if (idx >= conf->active_cnt)
+	    break;
+	run_job(conf, idx);
+    }
+
+    if (pj_atomic_dec_and_get(conf->job_pending) == 0)
+	pj_sem_post(conf->done_sem);
+}
+
+/*
+ * Mixing worker thread.
+ */
+static int mix_worker_thread( void *arg )
+{
+    pjmedia_conf *conf = (pjmedia_conf*) arg;
+
+    /* This thread only runs port callbacks while mixing */
+    pj_thread_local_set(conf->mix_tls, conf);
+
+    for (;;) {
+	pj_sem_wait(conf->job_sem);
+	if (conf->quit_flag)
+	    break;
+	run_jobs(conf);
+    }
+
+    return 0;
+}
+
+#endif	/* CONF_HAS_MIX_THREADS */
+
+/*
+ * Run a phase for all active ports, and wait until it completes.
+ */
+static void run_phase( pjmedia_conf *conf, int phase )
+{
+    unsigned i;
+
+    conf->job_phase = phase;
+
+#if CONF_HAS_MIX_THREADS
+    {
+	unsigned wake_cnt;
+
+	/* Don't wake up more workers than there are jobs for them, since
+	 * this thread takes part in the work too.
+	 */
+	wake_cnt = conf->active_cnt ? conf->active_cnt - 1 : 0;
+	if (wake_cnt > conf->thread_cnt)
+	    wake_cnt = conf->thread_cnt;
+
+	if (wake_cnt) {
+	    /* Every thread which is woken up decrements job_pending exactly
+	     * once, so all posts of this phase have been consumed once
+	     * done_sem is signalled.
+	     */
+	    pj_atomic_set(conf->job_idx, 0);
+	    pj_atomic_set(conf->job_pending, wake_cnt + 1);
+	    for (i=0; i<wake_cnt; ++i)
+		pj_sem_post(conf->job_sem);
+
+	    run_jobs(conf);
+	    pj_sem_wait(conf->done_sem);
+	    return;
+	}
+    }
+#endif
+
+    for (i=0; i<conf->active_cnt; ++i)
+	run_job(conf, i);
+}
+
+/*
+ * Tell each listener to mix the frames of all of its transmitters.
+ */
+static void assign_sources( pjmedia_conf *conf )
+{
+    unsigned i, j;
+
+    for (i=0; i<conf->active_cnt; ++i) {
+	struct conf_port *conf_port = conf->ports[conf->active[i]];
+	if (conf_port) {
+	    conf_port->mix_src_cnt = 0;
+	    conf_port->mix_mode = MIX_SOURCES;
+	}
+    }
+
+    for (i=0; i<conf->active_cnt; ++i) {
+	struct conf_port *conf_port = conf->ports[conf->active[i]];
+
+	if (!conf_port || !conf_port->rx_ok)
+	    continue;
+
+	for (j=0; j<conf_port->listener_cnt; ++j) {
+	    struct conf_port *listener;
+
+	    listener = conf->ports[conf_port->listener_slots[j]];
+
+	    /* Skip if this listener doesn't want to receive audio */
+	    if (listener->tx_setting != PJMEDIA_PORT_ENABLE)
+		continue;
+
+	    listener->mix_src[listener->mix_src_cnt++] = conf->active[i];
+	}
+    }
+}
+
+/*
+ * Select the ports with the loudest signal as the active speakers.
+ */
+static void select_speakers( pjmedia_conf *conf )
+{
+    unsigned i, j, cnt = 0;
+
+    for (i=0; i<conf->active_cnt; ++i) {
+	SLOT_TYPE slot = conf->active[i];
+	struct conf_port *conf_port = conf->ports[slot];
+	pj_bool_t was_speaker;
+	unsigned rank;
+
+	if (!conf_port)
+	    continue;
+
+	/* Average the level over a few frames, so that a speaker is not
+	 * dropped on the short pauses between words. Ports without frame
+	 * (e.g. muted, or silence suppressed by VAD) decay towards zero.
+	 */
+	conf_port->spk_score -= conf_port->spk_score >> 2;
+	if (conf_port->rx_ok)
+	    conf_port->spk_score += conf_port->rx_level;
+
+	was_speaker = conf_port->is_speaker;
+	conf_port->is_speaker = PJ_FALSE;
+
+	if (!conf_port->rx_ok)
+	    continue;
+
+	/* Current speakers get a head start, to avoid switching back and
+	 * forth between speakers with similar level.
+	 */
+	rank = conf_port->spk_score + (was_speaker ? SPEAKER_HOLD : 0);
+	conf_port->spk_rank = rank;
+
+	/* Insert to the list of speakers, sorted by rank */
+	if (cnt == conf->spk_max) {
+	    if (conf->ports[conf->spk[cnt-1]]->spk_rank >= rank)
+		continue;
+	    j = cnt - 1;
+	} else {
+	    j = cnt++;
+	}
+
+	while (j > 0 && conf->ports[conf->spk[j-1]]->spk_rank < rank) {
+	    conf->spk[j] = conf->spk[j-1];
+	    --j;
+	}
+	conf->spk[j] = slot;
+    }
+
+    for (i=0; i<cnt; ++i)
+	conf->ports[conf->spk[i]]->is_speaker = PJ_TRUE;
+
+    conf->spk_cnt = cnt;
+}
+
+/*
+ * Resample the deferred frames of the active speakers, and drop the
+ * deferred frames of the other ports, which are not going to be mixed.
+ * Skipping the resampler leaves its history behind, which only affects
+ * the first few samples when the port becomes a speaker.
+ */
+static void finish_rx( pjmedia_conf *conf )
+{
+    unsigned i;
+
+    for (i=0; i<conf->active_cnt; ++i) {
+	struct conf_port *conf_port = conf->ports[conf->active[i]];
+
+	if (!conf_port || !conf_port->rx_deferred)
+	    continue;
+
+	if (conf_port->is_speaker) {
+	    take_rx_buf(conf, conf_port, conf_port->rx_frame,
+			conf->samples_per_frame);
+	    if (conf_port->rx_adj_level != NORMAL_LEVEL) {
+		pjmedia_pcm_adjust(conf_port->rx_frame,
+				   conf->samples_per_frame,
+				   conf_port->rx_adj_level);
+	    }
+	} else {
+	    take_rx_buf(conf, conf_port, NULL, conf->samples_per_frame);
+	}
+    }
+}
+
+/*
+ * Mix the frames of the active speakers once, and tell each listener how
+ * to get its mix: the shared mix when it listens to all speakers, the
+ * shared mix minus its own frame when it is one of the speakers and
+ * listens to all others, or else by mixing the speakers it listens to.
+ */
+static void assign_speakers( pjmedia_conf *conf )
+{
+    unsigned i, j, k;
+
+    select_speakers(conf);
+    finish_rx(conf);
+
+    conf->spk_mix_adj = NORMAL_LEVEL;
+    conf->spk_tx_valid = PJ_FALSE;
+    for (i=0; i<conf->spk_rate_cnt; ++i)
+	conf->spk_rate[i].valid = PJ_FALSE;
+    pj_bzero(conf->spk_mix,
+	     conf->samples_per_frame * sizeof(conf->spk_mix[0]));
+
+    for (i=0; i<conf->active_cnt; ++i) {
+	struct conf_port *conf_port = conf->ports[conf->active[i]];
+	if (conf_port)
+	    conf_port->mix_src_cnt = 0;
+    }
+
+    for (k=0; k<conf->spk_cnt; ++k) {
+	struct conf_port *speaker = conf->ports[conf->spk[k]];
+	pj_int32_t mix_min, mix_max;
+
+	pjmedia_pcm_mix(conf->spk_mix, speaker->rx_frame,
+			conf->samples_per_frame, &mix_min, &mix_max);
+	update_mix_adj(&conf->spk_mix_adj, mix_min, mix_max);
+
+	for (j=0; j<speaker->listener_cnt; ++j) {
+	    struct conf_port *listener;
+
+	    listener = conf->ports[speaker->listener_slots[j]];
+
+	    /* Skip if this listener doesn't want to receive audio */
+	    if (listener->tx_setting != PJMEDIA_PORT_ENABLE)
+		continue;
+
+	    listener->mix_src[listener->mix_src_cnt++] = conf->spk[k];
+	}
+    }
+
+    for (i=0; i<conf->active_cnt; ++i) {
+	struct conf_port *conf_port = conf->ports[conf->active[i]];
+
+	if (!conf_port)
+	    continue;
+
+	conf_port->mix_mode = MIX_SOURCES;
+
+	if (conf->spk_cnt && conf_port->mix_src_cnt == conf->spk_cnt) {
+	    conf_port->mix_mode = MIX_SHARED;
+
+	} else if (conf_port->is_speaker && conf->spk_cnt > 1 &&
+		   conf_port->mix_src_cnt == conf->spk_cnt - 1)
+	{
+	    /* Only if the missing speaker is the port itself */
+	    for (k=0; k<conf_port->mix_src_cnt; ++k) {
+		if (conf_port->mix_src[k] == conf->active[i])
+		    break;
+	    }
+	    if (k == conf_port->mix_src_cnt)
+		conf_port->mix_mode = MIX_MINUS_SELF;
+	}
+    }
+}
+
+/*
+ * Process all ports in two phases, first reading from all ports, then
+ * mixing and writing to all ports. This is used when there are worker
+ * threads to process the phases, and with active speaker mixing. Returns
+ * the type of the frame written to port zero.
+ */
+static pjmedia_frame_type process_phases( pjmedia_conf *conf,
+					  const pj_timestamp *timestamp )
+{
+    unsigned ci, i;
+
+    /* Collect the slots in use, these are the jobs of both phases */
+    conf->active_cnt = 0;
+    for (i=0, ci=0; i<conf->max_ports && ci<conf->port_cnt; ++i) {
+	if (!conf->ports[i])
+	    continue;
+	++ci;
+	conf->active[conf->active_cnt++] = i;
+    }
+
+    /* Get frames from all ports */
+    run_phase(conf, JOB_READ);
+
+    /* Tell each listener which frames it has to mix */
+    if (conf->spk_max)
+	assign_speakers(conf);
+    else
+	assign_sources(conf);
+
+    /* Mix and transmit to all ports */
+    conf->timestamp = timestamp;
+    conf->spk_frame_type = PJMEDIA_FRAME_TYPE_NONE;
+    run_phase(conf, JOB_WRITE);
+
+    /* Keep the shared resamplers which no listener has used running, so
+     * that they don't have a stale history when they are used again.
+     */
+    if (conf->spk_max) {
+	for (i=0; i<conf->spk_rate_cnt; ++i) {
+	    struct spk_rate *rate = &conf->spk_rate[i];
+
+	    if (rate->valid)
+		continue;
+
+	    pjmedia_pcm_narrow(rate->prev_in, conf->spk_mix,
+			       conf->samples_per_frame, rate->adj);
+	    run_spk_rate(conf, rate, rate->prev_in, rate->adj);
+	}
+    }
+
+    return conf->spk_frame_type;
+}
+
+
+/*
+ * Player callback.
+ */
+static pj_status_t get_frame(pjmedia_port *this_port, 
+			     pjmedia_frame *frame)
+{
+    pjmedia_conf *conf = (pjmedia_conf*) this_port->port_data.pdata;
+    pjmedia_frame_type speaker_frame_type;
+    pjmedia_frame mix_frame, *mframe = frame;
+    void *prev_tls;
+    
+    TRACE_((THIS_FILE, "- clock -"));
+
+    /* Check that correct size is specified. */
+    pj_assert(frame->size == conf->master_spf *
+			     conf->bits_per_sample / 8);
+
+    /* Mix in the format of the bridge if port zero has another format */
+    if (conf->master_buf) {
+	mix_frame = *frame;
+	mix_frame.buf = conf->master_buf;
+	mix_frame.size = conf->samples_per_frame * BYTES_PER_SAMPLE;
+	mix_frame.timestamp.u64 = frame->timestamp.u64 * conf->clock_rate /
+				  conf->master_clock_rate;
+	mframe = &mix_frame;
+    }
+
+    /* The API doesn't hold the mixing mutex for longer than it takes
+     * to apply the changes, so this doesn't wait for the API.
+     */
+    pj_mutex_lock(conf->mix_mutex);
+
+    /* Apply the changes queued since the last frame */
+    apply_ops(conf);
+
+    /* Changes made by the port callbacks are deferred to the end of the
+     * frame. The previous value is kept, as this may be called in the
+     * callback of another bridge.
+     */
+    prev_tls = pj_thread_local_get(conf->mix_tls);
+    pj_thread_local_set(conf->mix_tls, conf);
+
+    if (conf->thread_cnt || conf->spk_max)
+	speaker_frame_type = process_phases(conf, &mframe->timestamp);
+    else
+	speaker_frame_type = process_serial(conf, mframe);
+
     /* Return sound playback frame. */
     if (conf->ports[0]->tx_level) {
 	TRACE_((THIS_FILE, "write to audio, count=%d", 
 			   conf->samples_per_frame));
-	pjmedia_copy_samples( (pj_int16_t*)frame->buf, 
-			      (const pj_int16_t*)conf->ports[0]->mix_buf, 
-			      conf->samples_per_frame);
+	if (conf->master_buf) {
+	    master_tx_convert(conf,
+			      (const pj_int16_t*)conf->ports[0]->mix_buf,
+			      (pj_int16_t*)frame->buf);
+	} else {
+	    pjmedia_copy_samples( (pj_int16_t*)frame->buf, 
+				  (const pj_int16_t*)conf->ports[0]->mix_buf,
+				  conf->samples_per_frame);
+	}
     } else {
 	/* Force frame type NONE */
 	speaker_frame_type = PJMEDIA_FRAME_TYPE_NONE;
@@ -2060,7 +3626,12 @@ static pj_status_t get_frame(pjmedia_port *this_port,
     /* MUST set frame type */
     frame->type = speaker_frame_type;
 
-    pj_mutex_unlock(conf->mutex);
+    pj_thread_local_set(conf->mix_tls, prev_tls);
+
+    /* Apply the changes made during this frame */
+    apply_ops(conf);
+
+    pj_mutex_unlock(conf->mix_mutex);
 
 #ifdef REC_FILE
     if (fhnd_rec == NULL)
@@ -2094,10 +3665,13 @@ static pj_status_t put_frame(pjmedia_port *this_port,
 {
     pjmedia_conf *conf = (pjmedia_conf*) this_port->port_data.pdata;
     struct conf_port *port = conf->ports[this_port->port_data.ldata];
+    pj_int16_t *samples = (pj_int16_t*) frame->buf;
     pj_status_t status;
 
     /* Check for correct size. */
-    PJ_ASSERT_RETURN( frame->size == conf->samples_per_frame *
+    PJ_ASSERT_RETURN( frame->size == (this_port == conf->master_port ?
+				      conf->master_spf :
+				      conf->samples_per_frame) *
 				     conf->bits_per_sample / 8,
 		      PJMEDIA_ENCSAMPLESPFRAME);
 
@@ -2114,7 +3688,13 @@ static pj_status_t put_frame(pjmedia_port *this_port,
 	return PJ_SUCCESS;
     }
 
-    status = pjmedia_delay_buf_put(port->delay_buf, (pj_int16_t*)frame->buf);
+    /* Port zero may have another format than the bridge */
+    if (this_port == conf->master_port && conf->master_buf) {
+	master_rx_convert(conf, samples);
+	samples = conf->master_rx_buf;
+    }
+
+    status = pjmedia_delay_buf_put(port->delay_buf, samples);
 
     return status;
 }
@@ -23,9 +23,11 @@
 #include <pjmedia/vid_codec.h>
 #include <pjmedia-audiodev/audiodev.h>
 #include <pj/assert.h>
+#include <pj/atomic.h>
 #include <pj/ioqueue.h>
 #include <pj/lock.h>
 #include <pj/log.h>
+#include <pj/math.h>
 #include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/sock.h>
@@ -68,6 +70,50 @@ typedef struct exit_cb
 } exit_cb;
 
 
+/* Tick callback of a media shard. */
+typedef struct shard_tick
+{
+    PJ_DECL_LIST_MEMBER		    (struct shard_tick);
+    pjmedia_clock_callback	   *cb;
+    void			   *user_data;
+} shard_tick;
+
+
+/* Media shard: an ioqueue, the thread polling it, and a media clock
+ * ticking on the same thread.
+ */
+typedef struct media_shard
+{
+    pjmedia_endpt	     *endpt;
+    pj_ioqueue_t	     *ioqueue;
+    pj_thread_t		     *thread;
+    pjmedia_clock	     *clock;
+
+    /* Set to signal the shard thread to quit */
+    pj_atomic_t		     *quit;
+
+    /* Protects the tick callbacks, the clock, and the statistics */
+    pj_mutex_t		     *mutex;
+    shard_tick		      tick_list;
+    shard_tick		      free_tick_list;
+    pj_bool_t		      in_tick;
+    pj_bool_t		      has_removed;
+    pj_bool_t		      ticking;
+    pj_bool_t		      no_post;
+
+    /* Schedule of the clock ticks, in timestamp units */
+    pj_timestamp	      interval;
+    pj_timestamp	      next_tick;
+    pj_timestamp	      freq;
+    pj_uint64_t		      max_jump;
+
+    /* The load is protected by the endpoint's shard mutex, the other
+     * counters by the shard's mutex.
+     */
+    pjmedia_endpt_shard_stat  stat;
+} media_shard;
+
+
 /** Concrete declaration of media endpoint. */
 struct pjmedia_endpt
 {
@@ -95,6 +141,15 @@ struct pjmedia_endpt
     /** To signal polling thread to quit. */
     pj_bool_t		  quit_flag;
 
+    /** Number of media shards. */
+    unsigned		  shard_cnt;
+
+    /** Media shards. */
+    media_shard		 *shard;
+
+    /** Protects the load of the media shards. */
+    pj_mutex_t		 *shard_mutex;
+
     /** Is telephone-event enable */
     pj_bool_t		  has_telephone_event;
 
@@ -102,6 +157,15 @@ struct pjmedia_endpt
     exit_cb		  exit_cb_list;
 };
 
+/* Media shard thread proc. */
+static int PJ_THREAD_FUNC shard_proc(void*);
+
+/* Stop the media shard thread. */
+static void stop_shard(media_shard *sh);
+
+/* Destroy the media shards. */
+static void destroy_shards(media_shard shard[], unsigned cnt);
+
 /**
  * Initialize and get the instance of media endpoint.
  */
@@ -215,6 +279,16 @@ PJ_DEF(pj_status_t) pjmedia_endpt_destroy2 (pjmedia_endpt *endpt)
 
     pjmedia_endpt_stop_threads(endpt);
 
+    /* Destroy media shards */
+    if (endpt->shard_cnt) {
+	destroy_shards(endpt->shard, endpt->shard_cnt);
+	endpt->shard_cnt = 0;
+    }
+    if (endpt->shard_mutex) {
+	pj_mutex_destroy(endpt->shard_mutex);
+	endpt->shard_mutex = NULL;
+    }
+
     /* Destroy internal ioqueue */
     if (endpt->ioqueue && endpt->own_ioqueue) {
 	pj_ioqueue_destroy(endpt->ioqueue);
@@ -324,6 +398,10 @@ PJ_DEF(pj_status_t) pjmedia_endpt_stop_threads(pjmedia_endpt *endpt)
 	}
     }
 
+    /* Stop the media shard threads */
+    for (i=0; i<endpt->shard_cnt; ++i)
+	stop_shard(&endpt->shard[i]);
+
     return PJ_SUCCESS;
 }
 
@@ -342,6 +420,497 @@ static int PJ_THREAD_FUNC worker_proc(void *arg)
     return 0;
 }
 
+/*
+ * Media shards.
+ */
+
+#define SHARD_MAX_JUMP_MSEC	500
+
+/* Call the tick callbacks, called by the shard's clock */
+static void shard_on_clock(const pj_timestamp *ts, void *user_data)
+{
+    media_shard *sh = (media_shard*) user_data;
+    shard_tick *t;
+
+    sh->in_tick = PJ_TRUE;
+    for (t=sh->tick_list.next; t!=&sh->tick_list; t=t->next) {
+	/* Callback removed during this tick has been cleared */
+	if (t->cb)
+	    (*t->cb)(ts, t->user_data);
+    }
+    sh->in_tick = PJ_FALSE;
+}
+
+/* Posted to the shard's ioqueue to wake up the shard thread */
+static void shard_wake_up(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+}
+
+/* Run the shard's clock tick which is due, called with the shard's
+ * mutex held.
+ */
+static void run_shard_tick(media_shard *sh, const pj_timestamp *now)
+{
+    if (sh->ticking && pjmedia_clock_wait(sh->clock, PJ_FALSE, NULL)) {
+	pj_timestamp end;
+
+	pj_get_timestamp(&end);
+
+	++sh->stat.tick_cnt;
+	if (now->u64 >= sh->next_tick.u64 + sh->interval.u64)
+	    ++sh->stat.late_cnt;
+	pj_math_stat_update(&sh->stat.tick_usec,
+			    pj_elapsed_usec(now, &end));
+
+	/* Calculate next tick the same way as the clock */
+	if (sh->next_tick.u64 + sh->max_jump < now->u64)
+	    sh->next_tick.u64 = now->u64;
+	sh->next_tick.u64 += sh->interval.u64;
+    }
+
+    /* Free the callbacks removed during the tick */
+    if (sh->has_removed) {
+	shard_tick *t = sh->tick_list.next;
+
+	while (t != &sh->tick_list) {
+	    shard_tick *next = t->next;
+
+	    if (t->cb == NULL) {
+		pj_list_erase(t);
+		pj_list_push_back(&sh->free_tick_list, t);
+	    }
+	    t = next;
+	}
+	sh->has_removed = PJ_FALSE;
+	if (pj_list_empty(&sh->tick_list)) {
+	    pjmedia_clock_stop(sh->clock);
+	    sh->ticking = PJ_FALSE;
+	}
+    }
+}
+
+/*
+ * Media shard thread proc. The shard's mutex is held except while polling
+ * the ioqueue.
+ */
+static int PJ_THREAD_FUNC shard_proc(void *arg)
+{
+    media_shard *sh = (media_shard*) arg;
+
+    pj_mutex_lock(sh->mutex);
+
+    while (!pj_atomic_get(sh->quit)) {
+	pj_time_val timeout = { 0, 500 };
+	int n;
+
+	/* Without pj_ioqueue_post() the thread isn't woken up when the
+	 * clock is started, so don't wait longer than a tick.
+	 */
+	if (sh->no_post)
+	    timeout.msec = (long)(sh->interval.u64 * 1000 / sh->freq.u64);
+
+	/* Run the clock tick when it is due, and wait for the next tick */
+	if (sh->ticking) {
+	    pj_timestamp now;
+
+	    pj_get_timestamp(&now);
+	    if (now.u64 >= sh->next_tick.u64) {
+		run_shard_tick(sh, &now);
+		pj_get_timestamp(&now);
+	    }
+
+	    if (now.u64 < sh->next_tick.u64) {
+		/* Round up, so that we don't wake up before the tick */
+		timeout.msec = (pj_elapsed_usec(&now, &sh->next_tick) + 999) /
+			       1000;
+	    } else {
+		timeout.msec = 0;
+	    }
+	}
+
+	pj_mutex_unlock(sh->mutex);
+	n = pj_ioqueue_poll(sh->ioqueue, &timeout);
+	pj_mutex_lock(sh->mutex);
+
+	++sh->stat.poll_cnt;
+	if (n > 0)
+	    sh->stat.event_cnt += n;
+    }
+
+    pj_mutex_unlock(sh->mutex);
+
+    return 0;
+}
+
+/* Stop the media shard thread. */
+static void stop_shard(media_shard *sh)
+{
+    if (!sh->thread)
+	return;
+
+    pj_atomic_set(sh->quit, 1);
+
+    /* Don't wait for the poll timeout, if possible */
+    pj_ioqueue_post(sh->ioqueue, &shard_wake_up, sh);
+
+    pj_thread_join(sh->thread);
+    pj_thread_destroy(sh->thread);
+    sh->thread = NULL;
+}
+
+/* Destroy the media shards. */
+static void destroy_shards(media_shard shard[], unsigned cnt)
+{
+    unsigned i;
+
+    for (i=0; i<cnt; ++i) {
+	media_shard *sh = &shard[i];
+
+	stop_shard(sh);
+	if (sh->clock) {
+	    pjmedia_clock_destroy(sh->clock);
+	    sh->clock = NULL;
+	}
+	if (sh->ioqueue) {
+	    pj_ioqueue_destroy(sh->ioqueue);
+	    sh->ioqueue = NULL;
+	}
+	if (sh->mutex) {
+	    pj_mutex_destroy(sh->mutex);
+	    sh->mutex = NULL;
+	}
+	if (sh->quit) {
+	    pj_atomic_destroy(sh->quit);
+	    sh->quit = NULL;
+	}
+    }
+}
+
+/**
+ * Initialize the media shard settings with the default values.
+ */
+PJ_DEF(void) pjmedia_endpt_shard_param_default(
+					pjmedia_endpt_shard_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->shard_cnt = 1;
+    param->max_handles = PJ_IOQUEUE_MAX_HANDLES;
+    param->clock_rate = 8000;
+    param->ptime = 20;
+}
+
+/**
+ * Create media shards.
+ */
+PJ_DEF(pj_status_t) pjmedia_endpt_create_shards(
+				    pjmedia_endpt *endpt,
+				    const pjmedia_endpt_shard_param *param)
+{
+    pjmedia_endpt_shard_param def_param;
+    pjmedia_clock_param clock_param;
+    media_shard *shard;
+    pj_timestamp freq;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt, PJ_EINVAL);
+
+    if (!param) {
+	pjmedia_endpt_shard_param_default(&def_param);
+	param = &def_param;
+    }
+
+    PJ_ASSERT_RETURN(param->shard_cnt > 0 &&
+		     param->shard_cnt <= PJMEDIA_ENDPT_MAX_SHARDS &&
+		     param->max_handles > 0 && param->clock_rate > 0 &&
+		     param->ptime > 0, PJ_EINVAL);
+    PJ_ASSERT_RETURN(endpt->shard_cnt == 0, PJ_EINVALIDOP);
+
+    status = pj_get_timestamp_freq(&freq);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    if (!endpt->shard_mutex) {
+	status = pj_mutex_create_simple(endpt->pool, "med-shard",
+					&endpt->shard_mutex);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+
+    shard = (media_shard*) pj_pool_calloc(endpt->pool, param->shard_cnt,
+					  sizeof(media_shard));
+
+    clock_param.usec_interval = param->ptime * 1000;
+    clock_param.clock_rate = param->clock_rate;
+
+    for (i=0; i<param->shard_cnt; ++i) {
+	media_shard *sh = &shard[i];
+	char name[PJ_MAX_OBJ_NAME];
+
+	sh->endpt = endpt;
+	pj_list_init(&sh->tick_list);
+	pj_list_init(&sh->free_tick_list);
+	pj_math_stat_init(&sh->stat.tick_usec);
+	sh->interval.u64 = clock_param.usec_interval * freq.u64 / 1000000;
+	sh->max_jump = SHARD_MAX_JUMP_MSEC * freq.u64 / 1000;
+	sh->freq = freq;
+
+	pj_ansi_snprintf(name, sizeof(name), "mshard%d", i);
+
+	status = pj_atomic_create(endpt->pool, 0, &sh->quit);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	status = pj_mutex_create_recursive(endpt->pool, name, &sh->mutex);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	status = pj_ioqueue_create(endpt->pool, param->max_handles,
+				   &sh->ioqueue);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	status = pjmedia_clock_create2(endpt->pool, &clock_param,
+				       PJMEDIA_CLOCK_NO_ASYNC,
+				       &shard_on_clock, sh, &sh->clock);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	status = pj_thread_create(endpt->pool, name, &shard_proc, sh,
+				  0, 0, &sh->thread);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
+    endpt->shard = shard;
+    endpt->shard_cnt = param->shard_cnt;
+
+    PJ_LOG(4,(THIS_FILE, "%d media shard(s) created", param->shard_cnt));
+
+    return PJ_SUCCESS;
+
+on_error:
+    destroy_shards(shard, param->shard_cnt);
+    return status;
+}
+
+/**
+ * Get the number of media shards.
+ */
+PJ_DEF(unsigned) pjmedia_endpt_get_shard_count(pjmedia_endpt *endpt)
+{
+    PJ_ASSERT_RETURN(endpt, 0);
+    return endpt->shard_cnt;
+}
+
+/**
+ * Assign an object to the shard with the lowest load.
+ */
+PJ_DEF(pj_status_t) pjmedia_endpt_acquire_shard(pjmedia_endpt *endpt,
+						unsigned load,
+						unsigned *p_shard)
+{
+    unsigned i, best = 0;
+
+    PJ_ASSERT_RETURN(endpt && p_shard, PJ_EINVAL);
+
+    if (endpt->shard_cnt == 0)
+	return PJ_EINVALIDOP;
+
+    pj_mutex_lock(endpt->shard_mutex);
+
+    for (i=1; i<endpt->shard_cnt; ++i) {
+	if (endpt->shard[i].stat.load < endpt->shard[best].stat.load)
+	    best = i;
+    }
+    ++endpt->shard[best].stat.obj_cnt;
+    endpt->shard[best].stat.load += load;
+
+    pj_mutex_unlock(endpt->shard_mutex);
+
+    *p_shard = best;
+    return PJ_SUCCESS;
+}
+
+/**
+ * Remove an object from the shard.
+ */
+PJ_DEF(pj_status_t) pjmedia_endpt_release_shard(pjmedia_endpt *endpt,
+						unsigned shard,
+						unsigned load)
+{
+    pjmedia_endpt_shard_stat *stat;
+
+    PJ_ASSERT_RETURN(endpt && shard < endpt->shard_cnt, PJ_EINVAL);
+
+    pj_mutex_lock(endpt->shard_mutex);
+
+    stat = &endpt->shard[shard].stat;
+    pj_assert(stat->obj_cnt > 0 && stat->load >= load);
+    if (stat->obj_cnt > 0)
+	--stat->obj_cnt;
+    stat->load = (stat->load > load) ? stat->load - load : 0;
+
+    pj_mutex_unlock(endpt->shard_mutex);
+
+    return PJ_SUCCESS;
+}
+
+/**
+ * Get the ioqueue of a media shard.
+ */
+PJ_DEF(pj_ioqueue_t*) pjmedia_endpt_get_shard_ioqueue(pjmedia_endpt *endpt,
+						      unsigned shard)
+{
+    PJ_ASSERT_RETURN(endpt && shard < endpt->shard_cnt, NULL);
+    return endpt->shard[shard].ioqueue;
+}
+
+/**
+ * Get the thread of a media shard.
+ */
+PJ_DEF(pj_thread_t*) pjmedia_endpt_get_shard_thread(pjmedia_endpt *endpt,
+						    unsigned shard)
+{
+    PJ_ASSERT_RETURN(endpt && shard < endpt->shard_cnt, NULL);
+    return endpt->shard[shard].thread;
+}
+
+/**
+ * Register a tick callback of the shard's media clock.
+ */
+PJ_DEF(pj_status_t) pjmedia_endpt_add_shard_tick(pjmedia_endpt *endpt,
+						 unsigned shard,
+						 pjmedia_clock_callback *cb,
+						 void *user_data)
+{
+    media_shard *sh;
+    shard_tick *t;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(endpt && shard < endpt->shard_cnt && cb, PJ_EINVAL);
+
+    sh = &endpt->shard[shard];
+
+    pj_mutex_lock(sh->mutex);
+
+    if (!pj_list_empty(&sh->free_tick_list)) {
+	t = sh->free_tick_list.next;
+	pj_list_erase(t);
+    } else {
+	t = PJ_POOL_ZALLOC_T(endpt->pool, shard_tick);
+    }
+    t->cb = cb;
+    t->user_data = user_data;
+    pj_list_push_back(&sh->tick_list, t);
+
+    /* Start the clock on the first callback */
+    if (!sh->ticking) {
+	status = pjmedia_clock_start(sh->clock);
+	if (status == PJ_SUCCESS) {
+	    pj_get_timestamp(&sh->next_tick);
+	    sh->next_tick.u64 += sh->interval.u64;
+	    sh->ticking = PJ_TRUE;
+
+	    /* The shard thread may be waiting for ioqueue events */
+	    if (!sh->no_post &&
+		pj_ioqueue_post(sh->ioqueue, &shard_wake_up, sh) != PJ_SUCCESS)
+	    {
+		sh->no_post = PJ_TRUE;
+	    }
+	} else {
+	    pj_list_erase(t);
+	    pj_list_push_back(&sh->free_tick_list, t);
+	}
+    }
+
+    pj_mutex_unlock(sh->mutex);
+
+    return status;
+}
+
+/**
+ * Unregister a tick callback of the shard's media clock.
+ */
+PJ_DEF(pj_status_t) pjmedia_endpt_remove_shard_tick(
+						 pjmedia_endpt *endpt,
+						 unsigned shard,
+						 pjmedia_clock_callback *cb,
+						 void *user_data)
+{
+    media_shard *sh;
+    shard_tick *t;
+    pj_status_t status = PJ_ENOTFOUND;
+
+    PJ_ASSERT_RETURN(endpt && shard < endpt->shard_cnt && cb, PJ_EINVAL);
+
+    sh = &endpt->shard[shard];
+
+    pj_mutex_lock(sh->mutex);
+
+    for (t=sh->tick_list.next; t!=&sh->tick_list; t=t->next) {
+	if (t->cb == cb && t->user_data == user_data)
+	    break;
+    }
+
+    if (t != &sh->tick_list) {
+	if (sh->in_tick) {
+	    /* Called from a tick callback, the list is being iterated,
+	     * so only clear the entry and let the shard free it.
+	     */
+	    t->cb = NULL;
+	    sh->has_removed = PJ_TRUE;
+	} else {
+	    pj_list_erase(t);
+	    pj_list_push_back(&sh->free_tick_list, t);
+	    if (pj_list_empty(&sh->tick_list)) {
+		pjmedia_clock_stop(sh->clock);
+		sh->ticking = PJ_FALSE;
+	    }
+	}
+	status = PJ_SUCCESS;
+    }
+
+    pj_mutex_unlock(sh->mutex);
+
+    return status;
+}
+
+/**
+ * Get the statistics of a media shard.
+ */
+PJ_DEF(pj_status_t) pjmedia_endpt_get_shard_stat(
+					    pjmedia_endpt *endpt,
+					    unsigned shard,
+					    pjmedia_endpt_shard_stat *stat)
+{
+    media_shard *sh;
+
+    PJ_ASSERT_RETURN(endpt && shard < endpt->shard_cnt && stat, PJ_EINVAL);
+
+    sh = &endpt->shard[shard];
+
+    /* The counters of the shard thread are updated together */
+    pj_mutex_lock(sh->mutex);
+    stat->poll_cnt = sh->stat.poll_cnt;
+    stat->event_cnt = sh->stat.event_cnt;
+    stat->tick_cnt = sh->stat.tick_cnt;
+    stat->late_cnt = sh->stat.late_cnt;
+    stat->tick_usec = sh->stat.tick_usec;
+    pj_mutex_unlock(sh->mutex);
+
+    /* The shard mutex isn't taken with the shard's mutex held, a tick
+     * callback may acquire or release a shard.
+     */
+    pj_mutex_lock(endpt->shard_mutex);
+    stat->obj_cnt = sh->stat.obj_cnt;
+    stat->load = sh->stat.load;
+    pj_mutex_unlock(endpt->shard_mutex);
+
+    return PJ_SUCCESS;
+}
+
 /**
  * Create pool.
  */
@@ -935,6 +1504,18 @@ PJ_DEF(pj_status_t) pjmedia_endpt_dump(pjmedia_endpt *endpt)
 		  (param.setting.penh ? " penh" : ""),
 		  (prio[i]==PJMEDIA_CODEC_PRIO_DISABLED?" disabled":"")));
     }
+
+    for (i=0; i<endpt->shard_cnt; ++i) {
+	pjmedia_endpt_shard_stat stat;
+
+	pjmedia_endpt_get_shard_stat(endpt, i, &stat);
+	PJ_LOG(3,(THIS_FILE,
+		  "  Media shard #%d: objects=%d load=%d polls=%u events=%u "
+		  "ticks=%u late=%u tick usec (avg/max)=%d/%d",
+		  i, stat.obj_cnt, stat.load, stat.poll_cnt, stat.event_cnt,
+		  stat.tick_cnt, stat.late_cnt, stat.tick_usec.mean,
+		  stat.tick_usec.max));
+    }
 #endif
 
     return PJ_SUCCESS;
@@ -52,21 +52,39 @@
 #define STA_DISC_SAFE_SHRINKING_DIFF	1
 
 
-/* Struct of JB internal buffer, represented in a circular buffer containing
- * frame content, frame type, frame length, and frame bit info.
+/* Minimal difference between JB size and burst-level to request playout
+ * compression in time-scaling algorithm.
+ */
+#define TS_SAFE_COMPRESS_DIFF		3
+
+
+/* Frame slot in the JB internal buffer. The frame content follows the
+ * slot header, so putting or getting a frame touches one contiguous block
+ * of memory.
+ */
+typedef struct jb_slot
+{
+    int		     type;		/**< frame type			    */
+    unsigned	     len;		/**< frame length		    */
+    pj_uint32_t	     bit_info;		/**< frame bit info		    */
+    pj_uint32_t	     ts;		/**< frame timestamp		    */
+} jb_slot;
+
+/* Struct of JB internal buffer, represented in a circular buffer of frame
+ * slots. The number of slots is a power of two so the slot position can
+ * be masked instead of divided. Slots outside the used part of the ring
+ * are always clear (missing frame with zero length).
  */
 typedef struct jb_framelist_t
 {
     /* Settings */
     unsigned	     frame_size;	/**< maximum size of frame	    */
     unsigned	     max_count;		/**< maximum number of frames	    */
+    unsigned	     ring_mask;		/**< number of slots - 1	    */
+    unsigned	     slot_size;		/**< slot header + frame content    */
 
     /* Buffers */
-    char	    *content;		/**< frame content array	    */
-    int		    *frame_type;	/**< frame type array		    */
-    pj_size_t	    *content_len;	/**< frame length array		    */
-    pj_uint32_t	    *bit_info;		/**< frame bit info array	    */
-    pj_uint32_t	    *ts;		/**< timestamp array		    */
+    char	    *slots;		/**< slot array			    */
 
     /* States */
     unsigned	     head;		/**< index of head, pointed frame
@@ -79,10 +97,16 @@ typedef struct jb_framelist_t
 
 } jb_framelist_t;
 
+/* Get the slot at position pos, and the content of a slot */
+#define JB_SLOT(fl, pos)	((jb_slot*)((fl)->slots + \
+				 ((pos) & (fl)->ring_mask) * (fl)->slot_size))
+#define JB_SLOT_CONTENT(slot)	((char*)(slot) + sizeof(jb_slot))
+
 
 typedef void (*discard_algo)(pjmedia_jbuf *jb);
 static void jbuf_discard_static(pjmedia_jbuf *jb);
 static void jbuf_discard_progressive(pjmedia_jbuf *jb);
+static void jbuf_time_scale(pjmedia_jbuf *jb);
 
 
 struct pjmedia_jbuf
@@ -101,6 +125,7 @@ struct pjmedia_jbuf
 					     won't be included in level
 					     calculation		    */
     int		    jb_min_shrink_gap;	/**< How often can we shrink	    */
+    int		    jb_min_ts_gap;	/**< How often can we compress	    */
     discard_algo    jb_discard_algo;	/**< Discard algorithm		    */
 
     /* Buffer */
@@ -134,6 +159,10 @@ struct pjmedia_jbuf
 					     discarded			    */
     unsigned	    jb_discard_dist;	/**< Distance from jb_discard_ref
 					     to perform discard (in frm)    */
+    int		    jb_ts_diff;		/**< Size exceeding burst level at
+					     the last PUT (time-scaling)    */
+    int		    jb_ts_gap;		/**< GETs until the next compress   */
+    pj_bool_t	    jb_ts_can_stretch;	/**< Last GET got a normal frame    */
 
     /* Statistics */
     pj_math_stat    jb_delay;		/**< Delay statistics of jitter buffer
@@ -143,6 +172,8 @@ struct pjmedia_jbuf
     unsigned	    jb_discard;		/**< Number of discarded frames.    */
     unsigned	    jb_empty;		/**< Number of empty/prefetching frame
 					     returned by GET. */
+    unsigned	    jb_compress;	/**< Number of compress requests.   */
+    unsigned	    jb_stretch;		/**< Number of stretch requests.    */
 };
 
 
@@ -177,37 +208,40 @@ static pj_status_t jb_framelist_reset(jb_framelist_t *framelist);
 static unsigned jb_framelist_remove_head(jb_framelist_t *framelist,
 					 unsigned count);
 
+PJ_INLINE(void) jb_slot_clear(jb_slot *slot)
+{
+    slot->type = PJMEDIA_JB_MISSING_FRAME;
+    slot->len = 0;
+    slot->bit_info = 0;
+    slot->ts = 0;
+}
+
 static pj_status_t jb_framelist_init( pj_pool_t *pool,
 				      jb_framelist_t *framelist,
 				      unsigned frame_size,
 				      unsigned max_count)
 {
+    unsigned slot_cnt, i;
+
     PJ_ASSERT_RETURN(pool && framelist, PJ_EINVAL);
 
     pj_bzero(framelist, sizeof(jb_framelist_t));
 
+    for (slot_cnt = 1; slot_cnt < max_count; slot_cnt <<= 1)
+	;
+
     framelist->frame_size   = frame_size;
     framelist->max_count    = max_count;
-    framelist->content	    = (char*)
-			      pj_pool_alloc(pool,
-					    framelist->frame_size*
-					    framelist->max_count);
-    framelist->frame_type   = (int*)
+    framelist->ring_mask    = slot_cnt - 1;
+    framelist->slot_size    = (sizeof(jb_slot) + frame_size + 7) & ~7;
+    framelist->slots	    = (char*)
 			      pj_pool_alloc(pool,
-					    sizeof(framelist->frame_type[0])*
-					    framelist->max_count);
-    framelist->content_len  = (pj_size_t*)
-			      pj_pool_alloc(pool,
-					    sizeof(framelist->content_len[0])*
-					    framelist->max_count);
-    framelist->bit_info	    = (pj_uint32_t*)
-			      pj_pool_alloc(pool,
-					    sizeof(framelist->bit_info[0])*
-					    framelist->max_count);
-    framelist->ts	    = (pj_uint32_t*)
-			      pj_pool_alloc(pool,
-					    sizeof(framelist->ts[0])*
-					    framelist->max_count);
+					    framelist->slot_size * slot_cnt);
+    if (!framelist->slots)
+	return PJ_ENOMEM;
+
+    for (i = 0; i < slot_cnt; ++i)
+	jb_slot_clear(JB_SLOT(framelist, i));
 
     return jb_framelist_reset(framelist);
 
@@ -221,29 +255,17 @@ static pj_status_t jb_framelist_destroy(jb_framelist_t *framelist)
 
 static pj_status_t jb_framelist_reset(jb_framelist_t *framelist)
 {
+    unsigned i;
+
+    /* Only the used slots need to be cleared */
+    for (i = 0; i < framelist->size; ++i)
+	jb_slot_clear(JB_SLOT(framelist, framelist->head + i));
+
     framelist->head = 0;
     framelist->origin = INVALID_OFFSET;
     framelist->size = 0;
     framelist->discarded_num = 0;
 
-
-    //pj_bzero(framelist->content,
-    //	     framelist->frame_size *
-    //	     framelist->max_count);
-
-    pj_memset(framelist->frame_type,
-	      PJMEDIA_JB_MISSING_FRAME,
-	      sizeof(framelist->frame_type[0]) *
-	      framelist->max_count);
-
-    pj_bzero(framelist->content_len,
-	     sizeof(framelist->content_len[0]) *
-	     framelist->max_count);
-
-    //pj_bzero(framelist->bit_info,
-    //	     sizeof(framelist->bit_info[0]) *
-    //	     framelist->max_count);
-
     return PJ_SUCCESS;
 }
 
@@ -274,12 +296,12 @@ static pj_bool_t jb_framelist_get(jb_framelist_t *framelist,
 {
     if (framelist->size) {
 	pj_bool_t prev_discarded = PJ_FALSE;
+	jb_slot *slot = JB_SLOT(framelist, framelist->head);
 
 	/* Skip discarded frames */
-	while (framelist->frame_type[framelist->head] ==
-	       PJMEDIA_JB_DISCARDED_FRAME)
-	{
+	while (slot->type == PJMEDIA_JB_DISCARDED_FRAME) {
 	    jb_framelist_remove_head(framelist, 1);
+	    slot = JB_SLOT(framelist, framelist->head);
 	    prev_discarded = PJ_TRUE;
 	}
 
@@ -295,32 +317,23 @@ static pj_bool_t jb_framelist_get(jb_framelist_t *framelist,
 		if (bit_info)
 		    *bit_info = 0;
 	    } else {
-		pj_memcpy(frame,
-			  framelist->content +
-			  framelist->head * framelist->frame_size,
-			  framelist->frame_size);
-		*p_type = (pjmedia_jb_frame_type)
-			  framelist->frame_type[framelist->head];
+		/* Only the valid part of the content is copied */
+		pj_memcpy(frame, JB_SLOT_CONTENT(slot), slot->len);
+		*p_type = (pjmedia_jb_frame_type)slot->type;
 		if (size)
-		    *size   = framelist->content_len[framelist->head];
+		    *size   = slot->len;
 		if (bit_info)
-		    *bit_info = framelist->bit_info[framelist->head];
+		    *bit_info = slot->bit_info;
 	    }
 	    if (ts)
-		*ts = framelist->ts[framelist->head];
+		*ts = slot->ts;
 	    if (seq)
 		*seq = framelist->origin;
 
-	    //pj_bzero(framelist->content +
-	    //	 framelist->head * framelist->frame_size,
-	    //	 framelist->frame_size);
-	    framelist->frame_type[framelist->head] = PJMEDIA_JB_MISSING_FRAME;
-	    framelist->content_len[framelist->head] = 0;
-	    framelist->bit_info[framelist->head] = 0;
-	    framelist->ts[framelist->head] = 0;
+	    jb_slot_clear(slot);
 
 	    framelist->origin++;
-	    framelist->head = (framelist->head + 1) % framelist->max_count;
+	    framelist->head = (framelist->head + 1) & framelist->ring_mask;
 	    framelist->size--;
 
 	    return PJ_TRUE;
@@ -344,6 +357,7 @@ static pj_bool_t jb_framelist_peek(jb_framelist_t *framelist,
 				   int *seq)
 {
     unsigned pos, idx;
+    jb_slot *slot;
 
     if (offset >= jb_framelist_eff_size(framelist))
 	return PJ_FALSE;
@@ -351,29 +365,34 @@ static pj_bool_t jb_framelist_peek(jb_framelist_t *framelist,
     pos = framelist->head;
     idx = offset;
 
-    /* Find actual peek position, note there may be discarded frames */
-    while (1) {
-	if (framelist->frame_type[pos] != PJMEDIA_JB_DISCARDED_FRAME) {
-	    if (idx == 0)
-		break;
-	    else
-		--idx;
+    if (framelist->discarded_num == 0) {
+	/* No discarded frames, the position is known */
+	pos += offset;
+    } else {
+	/* Find actual peek position, skipping discarded frames */
+	while (1) {
+	    if (JB_SLOT(framelist, pos)->type != PJMEDIA_JB_DISCARDED_FRAME) {
+		if (idx == 0)
+		    break;
+		else
+		    --idx;
+	    }
+	    ++pos;
 	}
-	pos = (pos + 1) % framelist->max_count;
     }
 
     /* Return the frame pointer */
+    slot = JB_SLOT(framelist, pos);
     if (frame)
-	*frame = framelist->content + pos*framelist->frame_size;
+	*frame = JB_SLOT_CONTENT(slot);
     if (type)
-	*type = (pjmedia_jb_frame_type)
-		framelist->frame_type[pos];
+	*type = (pjmedia_jb_frame_type)slot->type;
     if (size)
-	*size = framelist->content_len[pos];
+	*size = slot->len;
     if (bit_info)
-	*bit_info = framelist->bit_info[pos];
+	*bit_info = slot->bit_info;
     if (ts)
-	*ts = framelist->ts[pos];
+	*ts = slot->ts;
     if (seq)
 	*seq = framelist->origin + offset;
 
@@ -385,61 +404,26 @@ static pj_bool_t jb_framelist_peek(jb_framelist_t *framelist,
 static unsigned jb_framelist_remove_head(jb_framelist_t *framelist,
 					 unsigned count)
 {
+    unsigned i;
+
     if (count > framelist->size)
 	count = framelist->size;
 
-    if (count) {
-	/* may be done in two steps if overlapping */
-	unsigned step1,step2;
-	unsigned tmp = framelist->head+count;
-	unsigned i;
-
-	if (tmp > framelist->max_count) {
-	    step1 = framelist->max_count - framelist->head;
-	    step2 = count-step1;
-	} else {
-	    step1 = count;
-	    step2 = 0;
-	}
-
-	for (i = framelist->head; i < (framelist->head + step1); ++i) {
-	    if (framelist->frame_type[i] == PJMEDIA_JB_DISCARDED_FRAME) {
-		pj_assert(framelist->discarded_num > 0);
-		framelist->discarded_num--;
-	    }
-	}
+    for (i = 0; i < count; ++i) {
+	jb_slot *slot = JB_SLOT(framelist, framelist->head + i);
 
-	//pj_bzero(framelist->content +
-	//	    framelist->head * framelist->frame_size,
-	//          step1*framelist->frame_size);
-	pj_memset(framelist->frame_type+framelist->head,
-		  PJMEDIA_JB_MISSING_FRAME,
-		  step1*sizeof(framelist->frame_type[0]));
-	pj_bzero(framelist->content_len+framelist->head,
-		 step1*sizeof(framelist->content_len[0]));
-
-	if (step2) {
-	    for (i = 0; i < step2; ++i) {
-		if (framelist->frame_type[i] == PJMEDIA_JB_DISCARDED_FRAME) {
-		    pj_assert(framelist->discarded_num > 0);
-		    framelist->discarded_num--;
-		}
-	    }
-	    //pj_bzero( framelist->content,
-	    //	      step2*framelist->frame_size);
-	    pj_memset(framelist->frame_type,
-		      PJMEDIA_JB_MISSING_FRAME,
-		      step2*sizeof(framelist->frame_type[0]));
-	    pj_bzero (framelist->content_len,
-		      step2*sizeof(framelist->content_len[0]));
+	if (slot->type == PJMEDIA_JB_DISCARDED_FRAME) {
+	    pj_assert(framelist->discarded_num > 0);
+	    framelist->discarded_num--;
 	}
-
-	/* update states */
-	framelist->origin += count;
-	framelist->head = (framelist->head + count) % framelist->max_count;
-	framelist->size -= count;
+	jb_slot_clear(slot);
     }
 
+    /* update states */
+    framelist->origin += count;
+    framelist->head = (framelist->head + count) & framelist->ring_mask;
+    framelist->size -= count;
+
     return count;
 }
 
@@ -453,7 +437,7 @@ static pj_status_t jb_framelist_put_at(jb_framelist_t *framelist,
 				       unsigned frame_type)
 {
     int distance;
-    unsigned pos;
+    jb_slot *slot;
     enum { MAX_MISORDER = 100 };
     enum { MAX_DROPOUT = 3000 };
 
@@ -492,18 +476,18 @@ static pj_status_t jb_framelist_put_at(jb_framelist_t *framelist,
 	}
     }
 
-    /* get the slot position */
-    pos = (framelist->head + distance) % framelist->max_count;
+    /* get the slot */
+    slot = JB_SLOT(framelist, framelist->head + distance);
 
     /* if the slot is occupied, it must be duplicated frame, ignore it. */
-    if (framelist->frame_type[pos] != PJMEDIA_JB_MISSING_FRAME)
+    if (slot->type != PJMEDIA_JB_MISSING_FRAME)
 	return PJ_EEXISTS;
 
     /* put the frame into the slot */
-    framelist->frame_type[pos] = frame_type;
-    framelist->content_len[pos] = frame_size;
-    framelist->bit_info[pos] = bit_info;
-    framelist->ts[pos] = ts;
+    slot->type = frame_type;
+    slot->len = frame_size;
+    slot->bit_info = bit_info;
+    slot->ts = ts;
 
     /* update framelist size */
     if (framelist->origin + (int)framelist->size <= index)
@@ -511,8 +495,7 @@ static pj_status_t jb_framelist_put_at(jb_framelist_t *framelist,
 
     if(PJMEDIA_JB_NORMAL_FRAME == frame_type) {
 	/* copy frame content */
-	pj_memcpy(framelist->content + pos * framelist->frame_size,
-		  frame, frame_size);
+	pj_memcpy(JB_SLOT_CONTENT(slot), frame, frame_size);
     }
 
     return PJ_SUCCESS;
@@ -522,19 +505,21 @@ static pj_status_t jb_framelist_put_at(jb_framelist_t *framelist,
 static pj_status_t jb_framelist_discard(jb_framelist_t *framelist,
 				        int index)
 {
-    unsigned pos;
+    jb_slot *slot;
 
     PJ_ASSERT_RETURN(index >= framelist->origin &&
 		     index <  framelist->origin + (int)framelist->size,
 		     PJ_EINVAL);
 
-    /* Get the slot position */
-    pos = (framelist->head + (index - framelist->origin)) %
-	  framelist->max_count;
+    /* Get the slot */
+    slot = JB_SLOT(framelist,
+		   framelist->head + (index - framelist->origin));
 
     /* Discard the frame */
-    framelist->frame_type[pos] = PJMEDIA_JB_DISCARDED_FRAME;
-    framelist->discarded_num++;
+    if (slot->type != PJMEDIA_JB_DISCARDED_FRAME) {
+	slot->type = PJMEDIA_JB_DISCARDED_FRAME;
+	framelist->discarded_num++;
+    }
 
     return PJ_SUCCESS;
 }
@@ -572,6 +557,7 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_create(pj_pool_t *pool,
     jb->jb_max_prefetch  = max_count*4/5;
     jb->jb_max_count	 = max_count;
     jb->jb_min_shrink_gap= PJMEDIA_JBUF_DISC_MIN_GAP / ptime;
+    jb->jb_min_ts_gap	 = PJMEDIA_JBUF_TIME_SCALE_MIN_GAP / ptime;
     jb->jb_max_burst	 = PJ_MAX(MAX_BURST_MSEC / ptime, max_count*3/4);
 
     pj_math_stat_init(&jb->jb_delay);
@@ -592,6 +578,7 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_set_ptime( pjmedia_jbuf *jb,
 
     jb->jb_frame_ptime    = ptime;
     jb->jb_min_shrink_gap = PJMEDIA_JBUF_DISC_MIN_GAP / ptime;
+    jb->jb_min_ts_gap	  = PJMEDIA_JBUF_TIME_SCALE_MIN_GAP / ptime;
     jb->jb_max_burst	  = PJ_MAX(MAX_BURST_MSEC / ptime,
     				   jb->jb_max_count*3/4);
 
@@ -645,7 +632,7 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_set_discard( pjmedia_jbuf *jb,
 {
     PJ_ASSERT_RETURN(jb, PJ_EINVAL);
     PJ_ASSERT_RETURN(algo >= PJMEDIA_JB_DISCARD_NONE &&
-		     algo <= PJMEDIA_JB_DISCARD_PROGRESSIVE,
+		     algo <= PJMEDIA_JB_DISCARD_TIME_SCALE,
 		     PJ_EINVAL);
 
     switch(algo) {
@@ -655,6 +642,9 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_set_discard( pjmedia_jbuf *jb,
     case PJMEDIA_JB_DISCARD_STATIC:
 	jb->jb_discard_algo = &jbuf_discard_static;
 	break;
+    case PJMEDIA_JB_DISCARD_TIME_SCALE:
+	jb->jb_discard_algo = &jbuf_time_scale;
+	break;
     default:
 	jb->jb_discard_algo = NULL;
 	break;
@@ -674,6 +664,9 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_reset(pjmedia_jbuf *jb)
     jb->jb_max_hist_level= 0;
     jb->jb_prefetching   = (jb->jb_prefetch != 0);
     jb->jb_discard_dist  = 0;
+    jb->jb_ts_diff	 = 0;
+    jb->jb_ts_gap	 = 0;
+    jb->jb_ts_can_stretch= PJ_FALSE;
 
     jb_framelist_reset(&jb->jb_framelist);
 
@@ -688,7 +681,7 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_destroy(pjmedia_jbuf *jb)
 	       "  size=%d/eff=%d prefetch=%d level=%d\n"
 	       "  delay (min/max/avg/dev)=%d/%d/%d/%d ms\n"
 	       "  burst (min/max/avg/dev)=%d/%d/%d/%d frames\n"
-	       "  lost=%d discard=%d empty=%d",
+	       "  lost=%d discard=%d empty=%d compress=%d stretch=%d",
 	       jb_framelist_size(&jb->jb_framelist),
 	       jb_framelist_eff_size(&jb->jb_framelist),
 	       jb->jb_prefetch, jb->jb_eff_level,
@@ -696,7 +689,8 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_destroy(pjmedia_jbuf *jb)
 	       pj_math_stat_get_stddev(&jb->jb_delay),
 	       jb->jb_burst.min, jb->jb_burst.max, jb->jb_burst.mean,
 	       pj_math_stat_get_stddev(&jb->jb_burst),
-	       jb->jb_lost, jb->jb_discard, jb->jb_empty));
+	       jb->jb_lost, jb->jb_discard, jb->jb_empty,
+	       jb->jb_compress, jb->jb_stretch));
 
     return jb_framelist_destroy(&jb->jb_framelist);
 }
@@ -913,6 +907,24 @@ static void jbuf_discard_progressive(pjmedia_jbuf *jb)
 }
 
 
+/* Time-scaling algorithm, the latency is adjusted by the application
+ * compressing or stretching the playout as requested by
+ * pjmedia_jbuf_get_time_scale(), so here we only need to track how much
+ * the latency exceeds the burst level.
+ */
+static void jbuf_time_scale(pjmedia_jbuf *jb)
+{
+    int burst_level;
+
+    /* Should be done in PUT operation */
+    if (jb->jb_last_op != JB_OP_PUT)
+	return;
+
+    burst_level = PJ_MAX(jb->jb_eff_level, jb->jb_level);
+    jb->jb_ts_diff = jb_framelist_eff_size(&jb->jb_framelist) - burst_level;
+}
+
+
 PJ_INLINE(void) jbuf_update(pjmedia_jbuf *jb, int oper)
 {
     if(jb->jb_last_op != oper) {
@@ -1035,6 +1047,7 @@ PJ_DEF(void) pjmedia_jbuf_put_frame3(pjmedia_jbuf *jb,
 	jb->jb_discard++;
 }
 
+
 /*
  * Get frame from jitter buffer.
  */
@@ -1100,8 +1113,10 @@ PJ_DEF(void) pjmedia_jbuf_get_frame3(pjmedia_jbuf *jb,
 	     */
 	    if (ftype == PJMEDIA_JB_NORMAL_FRAME) {
 		*p_frame_type = PJMEDIA_JB_NORMAL_FRAME;
+		jb->jb_ts_can_stretch = PJ_TRUE;
 	    } else {
 		*p_frame_type = PJMEDIA_JB_MISSING_FRAME;
+		jb->jb_ts_can_stretch = PJ_FALSE;
 		jb->jb_lost++;
 	    }
 
@@ -1124,6 +1139,7 @@ PJ_DEF(void) pjmedia_jbuf_get_frame3(pjmedia_jbuf *jb,
 	    if (size)
 		*size = 0;
 
+	    jb->jb_ts_can_stretch = PJ_FALSE;
 	    jb->jb_empty++;
 	}
     }
@@ -1157,11 +1173,57 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_get_state( const pjmedia_jbuf *jb,
     state->empty = jb->jb_empty;
     state->discard = jb->jb_discard;
     state->lost = jb->jb_lost;
+    state->compress = jb->jb_compress;
+    state->stretch = jb->jb_stretch;
 
     return PJ_SUCCESS;
 }
 
 
+PJ_DEF(int) pjmedia_jbuf_get_time_scale(pjmedia_jbuf *jb)
+{
+    PJ_ASSERT_RETURN(jb, 0);
+
+    if (jb->jb_discard_algo != &jbuf_time_scale ||
+	jb->jb_status != JB_STATUS_PROCESSING || jb->jb_prefetching)
+    {
+	return 0;
+    }
+
+    if (jb->jb_ts_gap > 0)
+	jb->jb_ts_gap--;
+
+    /* Latency is higher than the burst level, compress the playout, but
+     * not more often than once per PJMEDIA_JBUF_TIME_SCALE_MIN_GAP ms.
+     */
+    if (jb->jb_ts_diff >= TS_SAFE_COMPRESS_DIFF && jb->jb_ts_gap == 0) {
+	jb->jb_ts_diff = 0;
+	jb->jb_ts_gap = jb->jb_min_ts_gap;
+	jb->jb_compress++;
+
+	TRACE__((jb->jb_name.ptr, "Time-scale: compress, size=%d burst=%d",
+		 jb_framelist_eff_size(&jb->jb_framelist), jb->jb_eff_level));
+	return 1;
+    }
+
+    /* The buffer has run dry, stretch the playout to give the next frame
+     * one more frame time to arrive. Only do it once after a normal frame,
+     * so a long gap (e.g: DTX) is not filled with synthetic audio.
+     */
+    if (jb->jb_ts_can_stretch && jb_framelist_eff_size(&jb->jb_framelist)==0)
+    {
+	jb->jb_ts_can_stretch = PJ_FALSE;
+	jb->jb_stretch++;
+
+	TRACE__((jb->jb_name.ptr, "Time-scale: stretch, burst=%d",
+		 jb->jb_eff_level));
+	return -1;
+    }
+
+    return 0;
+}
+
+
 PJ_DEF(void) pjmedia_jbuf_peek_frame( pjmedia_jbuf *jb,
 				      unsigned offset,
 				      const void **frame,
@@ -244,6 +244,16 @@ PJ_DEF(pjmedia_port*) pjmedia_master_port_get_uport(pjmedia_master_port*m)
 }
 
 
+/*
+ * Get the media clock.
+ */
+PJ_DEF(pjmedia_clock*) pjmedia_master_port_get_clock(pjmedia_master_port *m)
+{
+    PJ_ASSERT_RETURN(m, NULL);
+    return m->clock;
+}
+
+
 /*
  * Change the downstream port.
  */
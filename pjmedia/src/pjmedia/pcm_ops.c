@@ -0,0 +1,787 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/pcm_ops.h>
+#include <pjmedia/errno.h>
+#include <pj/assert.h>
+#include <pj/log.h>
+
+#define THIS_FILE	"pcm_ops.c"
+
+#define NORMAL_LEVEL	128
+#define MAX_LEVEL	(32767)
+#define MIN_LEVEL	(-32768)
+
+/*
+ * Which SIMD implementations can be built with this compiler. AVX2 is
+ * built into a function with a target attribute on GCC and clang, so the
+ * library does not need to be compiled with -mavx2; it is only used when
+ * the CPU supports it.
+ */
+#if defined(PJMEDIA_HAS_SIMD) && PJMEDIA_HAS_SIMD!=0
+#   if defined(__SSE2__) || defined(_M_X64) || \
+       (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define PCM_HAS_SSE2	1
+#	include <emmintrin.h>
+#   endif
+#   if PCM_HAS_SSE2 && (defined(__x86_64__) || defined(__i386__)) && \
+       ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+#	define PCM_HAS_AVX2	1
+#	define AVX2_FUNC	__attribute__((target("avx2")))
+#	include <immintrin.h>
+#   elif PCM_HAS_SSE2 && defined(_MSC_VER) && _MSC_VER >= 1800
+#	define PCM_HAS_AVX2	1
+#	define AVX2_FUNC
+#	include <immintrin.h>
+#	include <intrin.h>
+#   endif
+#   if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	define PCM_HAS_NEON	1
+#	include <arm_neon.h>
+#   endif
+#endif
+
+#ifndef PCM_HAS_SSE2
+#   define PCM_HAS_SSE2	0
+#endif
+#ifndef PCM_HAS_AVX2
+#   define PCM_HAS_AVX2	0
+#endif
+#ifndef PCM_HAS_NEON
+#   define PCM_HAS_NEON	0
+#endif
+
+
+/* An implementation of the operations */
+typedef struct pcm_ops
+{
+    pjmedia_pcm_impl impl;
+    void	   (*mix)(pj_int32_t mix_buf[], const pj_int16_t samples[],
+			  unsigned count, pj_int32_t *p_min,
+			  pj_int32_t *p_max);
+    void	   (*widen)(pj_int32_t mix_buf[], const pj_int16_t samples[],
+			    unsigned count);
+    pj_uint32_t	   (*narrow)(pj_int16_t dst[], const pj_int32_t mix_buf[],
+			     unsigned count, unsigned gain);
+    pj_uint32_t	   (*adjust)(pj_int16_t samples[], unsigned count,
+			     unsigned gain);
+    pj_uint32_t	   (*sum_abs)(const pj_int16_t samples[], unsigned count);
+} pcm_ops;
+
+
+/***************************************************************************
+ * C implementation. It also processes the samples left over by the SIMD
+ * implementations, so the mix range is passed in and out.
+ */
+static void mix_c(pj_int32_t mix_buf[], const pj_int16_t samples[],
+		  unsigned count, pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    pj_int32_t mix_buf_min = *p_min;
+    pj_int32_t mix_buf_max = *p_max;
+    unsigned i;
+
+    for (i=0; i<count; ++i) {
+	mix_buf[i] += samples[i];
+	if (mix_buf[i] < mix_buf_min)
+	    mix_buf_min = mix_buf[i];
+	if (mix_buf[i] > mix_buf_max)
+	    mix_buf_max = mix_buf[i];
+    }
+
+    *p_min = mix_buf_min;
+    *p_max = mix_buf_max;
+}
+
+static void widen_c(pj_int32_t mix_buf[], const pj_int16_t samples[],
+		    unsigned count)
+{
+    unsigned i;
+
+    for (i=0; i<count; ++i)
+	mix_buf[i] = samples[i];
+}
+
+static pj_uint32_t narrow_c(pj_int16_t dst[], const pj_int32_t mix_buf[],
+			    unsigned count, unsigned gain)
+{
+    pj_uint32_t sum = 0;
+    unsigned i;
+
+    /* Going forward, dst[i] never overwrites mix_buf[j] for j > i, so
+     * this works in place.
+     */
+    for (i=0; i<count; ++i) {
+	pj_int32_t itemp = mix_buf[i];
+
+	if (gain != NORMAL_LEVEL)
+	    itemp = (itemp * (pj_int32_t)gain) >> 7;
+
+	/* Clip the signal if it's too loud */
+	if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
+	else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
+
+	dst[i] = (pj_int16_t) itemp;
+	sum += (itemp >= 0 ? itemp : -itemp);
+    }
+
+    return sum;
+}
+
+static pj_uint32_t adjust_c(pj_int16_t samples[], unsigned count,
+			    unsigned gain)
+{
+    pj_uint32_t sum = 0;
+    unsigned i;
+
+    for (i=0; i<count; ++i) {
+	pj_int32_t itemp = samples[i];
+
+	itemp = (itemp * (pj_int32_t)gain) >> 7;
+
+	/* Clip the signal if it's too loud */
+	if (itemp > MAX_LEVEL) itemp = MAX_LEVEL;
+	else if (itemp < MIN_LEVEL) itemp = MIN_LEVEL;
+
+	samples[i] = (pj_int16_t) itemp;
+	sum += (itemp >= 0 ? itemp : -itemp);
+    }
+
+    return sum;
+}
+
+static pj_uint32_t sum_abs_c(const pj_int16_t samples[], unsigned count)
+{
+    pj_uint32_t sum = 0;
+    unsigned i;
+
+    for (i=0; i<count; ++i)
+	sum += (samples[i] >= 0 ? samples[i] : -samples[i]);
+
+    return sum;
+}
+
+static const pcm_ops c_ops =
+{
+    PJMEDIA_PCM_IMPL_C, &mix_c, &widen_c, &narrow_c, &adjust_c, &sum_abs_c
+};
+
+
+/***************************************************************************
+ * SSE2 implementation, 8 samples at a time.
+ */
+#if PCM_HAS_SSE2
+
+/* SSE2 has no 32bit multiply, the low halves of two 32x32 bit products
+ * are the same whether signed or not.
+ */
+static __m128i mullo_epi32_sse2(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+			      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+}
+
+/* Absolute value of 8 samples added to 4 sums. The absolute value of
+ * -32768 does not fit in 16bit signed, but it does as unsigned.
+ */
+static __m128i add_abs_sse2(__m128i sum, __m128i s)
+{
+    __m128i sign = _mm_srai_epi16(s, 15);
+    __m128i abs = _mm_sub_epi16(_mm_xor_si128(s, sign), sign);
+    __m128i zero = _mm_setzero_si128();
+
+    sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(abs, zero));
+    return _mm_add_epi32(sum, _mm_unpackhi_epi16(abs, zero));
+}
+
+static pj_uint32_t hsum_sse2(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2,3,0,1)));
+    return (pj_uint32_t)_mm_cvtsi128_si32(v);
+}
+
+static void mix_sse2(pj_int32_t mix_buf[], const pj_int16_t samples[],
+		     unsigned count, pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    __m128i vmin = _mm_set1_epi32(*p_min);
+    __m128i vmax = _mm_set1_epi32(*p_max);
+    pj_int32_t r[4];
+    unsigned i, j;
+
+    for (i=0; i+8 <= count; i+=8) {
+	__m128i s = _mm_loadu_si128((const __m128i*)(samples+i));
+	__m128i sign = _mm_srai_epi16(s, 15);
+	__m128i a0 = _mm_loadu_si128((const __m128i*)(mix_buf+i));
+	__m128i a1 = _mm_loadu_si128((const __m128i*)(mix_buf+i+4));
+	__m128i m;
+
+	a0 = _mm_add_epi32(a0, _mm_unpacklo_epi16(s, sign));
+	a1 = _mm_add_epi32(a1, _mm_unpackhi_epi16(s, sign));
+	_mm_storeu_si128((__m128i*)(mix_buf+i), a0);
+	_mm_storeu_si128((__m128i*)(mix_buf+i+4), a1);
+
+	/* No 32bit min/max before SSE4.1 */
+	m = _mm_cmplt_epi32(a0, vmin);
+	vmin = _mm_or_si128(_mm_and_si128(m, a0), _mm_andnot_si128(m, vmin));
+	m = _mm_cmplt_epi32(a1, vmin);
+	vmin = _mm_or_si128(_mm_and_si128(m, a1), _mm_andnot_si128(m, vmin));
+	m = _mm_cmpgt_epi32(a0, vmax);
+	vmax = _mm_or_si128(_mm_and_si128(m, a0), _mm_andnot_si128(m, vmax));
+	m = _mm_cmpgt_epi32(a1, vmax);
+	vmax = _mm_or_si128(_mm_and_si128(m, a1), _mm_andnot_si128(m, vmax));
+    }
+
+    _mm_storeu_si128((__m128i*)r, vmin);
+    for (j=0; j<4; ++j) {
+	if (r[j] < *p_min) *p_min = r[j];
+    }
+    _mm_storeu_si128((__m128i*)r, vmax);
+    for (j=0; j<4; ++j) {
+	if (r[j] > *p_max) *p_max = r[j];
+    }
+
+    mix_c(mix_buf+i, samples+i, count-i, p_min, p_max);
+}
+
+static void widen_sse2(pj_int32_t mix_buf[], const pj_int16_t samples[],
+		       unsigned count)
+{
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	__m128i s = _mm_loadu_si128((const __m128i*)(samples+i));
+	__m128i sign = _mm_srai_epi16(s, 15);
+
+	_mm_storeu_si128((__m128i*)(mix_buf+i), _mm_unpacklo_epi16(s, sign));
+	_mm_storeu_si128((__m128i*)(mix_buf+i+4), _mm_unpackhi_epi16(s, sign));
+    }
+
+    widen_c(mix_buf+i, samples+i, count-i);
+}
+
+static pj_uint32_t narrow_sse2(pj_int16_t dst[], const pj_int32_t mix_buf[],
+			       unsigned count, unsigned gain)
+{
+    __m128i vgain = _mm_set1_epi32((int)gain);
+    __m128i sum = _mm_setzero_si128();
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	/* Both loads must be done before the store, for in place use */
+	__m128i a0 = _mm_loadu_si128((const __m128i*)(mix_buf+i));
+	__m128i a1 = _mm_loadu_si128((const __m128i*)(mix_buf+i+4));
+	__m128i s;
+
+	if (gain != NORMAL_LEVEL) {
+	    a0 = _mm_srai_epi32(mullo_epi32_sse2(a0, vgain), 7);
+	    a1 = _mm_srai_epi32(mullo_epi32_sse2(a1, vgain), 7);
+	}
+	s = _mm_packs_epi32(a0, a1);
+	_mm_storeu_si128((__m128i*)(dst+i), s);
+	sum = add_abs_sse2(sum, s);
+    }
+
+    return hsum_sse2(sum) + narrow_c(dst+i, mix_buf+i, count-i, gain);
+}
+
+static pj_uint32_t adjust_sse2(pj_int16_t samples[], unsigned count,
+			       unsigned gain)
+{
+    __m128i vgain = _mm_set1_epi32((int)gain);
+    __m128i sum = _mm_setzero_si128();
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	__m128i s = _mm_loadu_si128((const __m128i*)(samples+i));
+	__m128i sign = _mm_srai_epi16(s, 15);
+	__m128i a0 = _mm_unpacklo_epi16(s, sign);
+	__m128i a1 = _mm_unpackhi_epi16(s, sign);
+
+	a0 = _mm_srai_epi32(mullo_epi32_sse2(a0, vgain), 7);
+	a1 = _mm_srai_epi32(mullo_epi32_sse2(a1, vgain), 7);
+	s = _mm_packs_epi32(a0, a1);
+	_mm_storeu_si128((__m128i*)(samples+i), s);
+	sum = add_abs_sse2(sum, s);
+    }
+
+    return hsum_sse2(sum) + adjust_c(samples+i, count-i, gain);
+}
+
+static pj_uint32_t sum_abs_sse2(const pj_int16_t samples[], unsigned count)
+{
+    __m128i sum = _mm_setzero_si128();
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	sum = add_abs_sse2(sum,
+			   _mm_loadu_si128((const __m128i*)(samples+i)));
+    }
+
+    return hsum_sse2(sum) + sum_abs_c(samples+i, count-i);
+}
+
+static const pcm_ops sse2_ops =
+{
+    PJMEDIA_PCM_IMPL_SSE2, &mix_sse2, &widen_sse2, &narrow_sse2,
+    &adjust_sse2, &sum_abs_sse2
+};
+
+#endif	/* PCM_HAS_SSE2 */
+
+
+/***************************************************************************
+ * AVX2 implementation, 16 samples at a time.
+ */
+#if PCM_HAS_AVX2
+
+AVX2_FUNC static __m256i add_abs_avx2(__m256i sum, __m256i s)
+{
+    /* _mm256_abs_epi16() of -32768 is 0x8000, which is right as unsigned */
+    __m256i abs = _mm256_abs_epi16(s);
+    __m256i zero = _mm256_setzero_si256();
+
+    sum = _mm256_add_epi32(sum, _mm256_unpacklo_epi16(abs, zero));
+    return _mm256_add_epi32(sum, _mm256_unpackhi_epi16(abs, zero));
+}
+
+AVX2_FUNC static pj_uint32_t hsum_avx2(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+			      _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1,0,3,2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2,3,0,1)));
+    return (pj_uint32_t)_mm_cvtsi128_si32(s);
+}
+
+/* Pack two vectors of 32bit values to 16bit with saturation, keeping the
+ * order of the samples (the AVX2 pack works within 128bit lanes).
+ */
+AVX2_FUNC static __m256i packs_avx2(__m256i a0, __m256i a1)
+{
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(a0, a1),
+				    _MM_SHUFFLE(3,1,2,0));
+}
+
+AVX2_FUNC static void mix_avx2(pj_int32_t mix_buf[],
+			       const pj_int16_t samples[],
+			       unsigned count, pj_int32_t *p_min,
+			       pj_int32_t *p_max)
+{
+    __m256i vmin = _mm256_set1_epi32(*p_min);
+    __m256i vmax = _mm256_set1_epi32(*p_max);
+    pj_int32_t r[8];
+    unsigned i, j;
+
+    for (i=0; i+16 <= count; i+=16) {
+	__m256i s0, s1, a0, a1;
+
+	s0 = _mm256_cvtepi16_epi32(
+		_mm_loadu_si128((const __m128i*)(samples+i)));
+	s1 = _mm256_cvtepi16_epi32(
+		_mm_loadu_si128((const __m128i*)(samples+i+8)));
+	a0 = _mm256_loadu_si256((const __m256i*)(mix_buf+i));
+	a1 = _mm256_loadu_si256((const __m256i*)(mix_buf+i+8));
+
+	a0 = _mm256_add_epi32(a0, s0);
+	a1 = _mm256_add_epi32(a1, s1);
+	_mm256_storeu_si256((__m256i*)(mix_buf+i), a0);
+	_mm256_storeu_si256((__m256i*)(mix_buf+i+8), a1);
+
+	vmin = _mm256_min_epi32(vmin, _mm256_min_epi32(a0, a1));
+	vmax = _mm256_max_epi32(vmax, _mm256_max_epi32(a0, a1));
+    }
+
+    _mm256_storeu_si256((__m256i*)r, vmin);
+    for (j=0; j<8; ++j) {
+	if (r[j] < *p_min) *p_min = r[j];
+    }
+    _mm256_storeu_si256((__m256i*)r, vmax);
+    for (j=0; j<8; ++j) {
+	if (r[j] > *p_max) *p_max = r[j];
+    }
+
+    mix_c(mix_buf+i, samples+i, count-i, p_min, p_max);
+}
+
+AVX2_FUNC static void widen_avx2(pj_int32_t mix_buf[],
+				 const pj_int16_t samples[],
+				 unsigned count)
+{
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	__m128i s = _mm_loadu_si128((const __m128i*)(samples+i));
+	_mm256_storeu_si256((__m256i*)(mix_buf+i), _mm256_cvtepi16_epi32(s));
+    }
+
+    widen_c(mix_buf+i, samples+i, count-i);
+}
+
+AVX2_FUNC static pj_uint32_t narrow_avx2(pj_int16_t dst[],
+					 const pj_int32_t mix_buf[],
+					 unsigned count, unsigned gain)
+{
+    __m256i vgain = _mm256_set1_epi32((int)gain);
+    __m256i sum = _mm256_setzero_si256();
+    unsigned i;
+
+    for (i=0; i+16 <= count; i+=16) {
+	/* Both loads must be done before the store, for in place use */
+	__m256i a0 = _mm256_loadu_si256((const __m256i*)(mix_buf+i));
+	__m256i a1 = _mm256_loadu_si256((const __m256i*)(mix_buf+i+8));
+	__m256i s;
+
+	if (gain != NORMAL_LEVEL) {
+	    a0 = _mm256_srai_epi32(_mm256_mullo_epi32(a0, vgain), 7);
+	    a1 = _mm256_srai_epi32(_mm256_mullo_epi32(a1, vgain), 7);
+	}
+	s = packs_avx2(a0, a1);
+	_mm256_storeu_si256((__m256i*)(dst+i), s);
+	sum = add_abs_avx2(sum, s);
+    }
+
+    return hsum_avx2(sum) + narrow_c(dst+i, mix_buf+i, count-i, gain);
+}
+
+AVX2_FUNC static pj_uint32_t adjust_avx2(pj_int16_t samples[],
+					 unsigned count, unsigned gain)
+{
+    __m256i vgain = _mm256_set1_epi32((int)gain);
+    __m256i sum = _mm256_setzero_si256();
+    unsigned i;
+
+    for (i=0; i+16 <= count; i+=16) {
+	__m256i a0, a1, s;
+
+	a0 = _mm256_cvtepi16_epi32(
+		_mm_loadu_si128((const __m128i*)(samples+i)));
+	a1 = _mm256_cvtepi16_epi32(
+		_mm_loadu_si128((const __m128i*)(samples+i+8)));
+
+	a0 = _mm256_srai_epi32(_mm256_mullo_epi32(a0, vgain), 7);
+	a1 = _mm256_srai_epi32(_mm256_mullo_epi32(a1, vgain), 7);
+	s = packs_avx2(a0, a1);
+	_mm256_storeu_si256((__m256i*)(samples+i), s);
+	sum = add_abs_avx2(sum, s);
+    }
+
+    return hsum_avx2(sum) + adjust_c(samples+i, count-i, gain);
+}
+
+AVX2_FUNC static pj_uint32_t sum_abs_avx2(const pj_int16_t samples[],
+					  unsigned count)
+{
+    __m256i sum = _mm256_setzero_si256();
+    unsigned i;
+
+    for (i=0; i+16 <= count; i+=16) {
+	sum = add_abs_avx2(sum,
+			   _mm256_loadu_si256((const __m256i*)(samples+i)));
+    }
+
+    return hsum_avx2(sum) + sum_abs_c(samples+i, count-i);
+}
+
+static const pcm_ops avx2_ops =
+{
+    PJMEDIA_PCM_IMPL_AVX2, &mix_avx2, &widen_avx2, &narrow_avx2,
+    &adjust_avx2, &sum_abs_avx2
+};
+
+/* Check that the CPU and the OS support AVX2 */
+static pj_bool_t cpu_has_avx2(void)
+{
+#if defined(_MSC_VER)
+    int r[4];
+
+    __cpuid(r, 0);
+    if (r[0] < 7)
+	return PJ_FALSE;
+
+    /* OSXSAVE and AVX, and the OS saves the YMM registers */
+    __cpuid(r, 1);
+    if ((r[2] & (1 << 27)) == 0 || (r[2] & (1 << 28)) == 0)
+	return PJ_FALSE;
+    if ((_xgetbv(0) & 6) != 6)
+	return PJ_FALSE;
+
+    __cpuidex(r, 7, 0);
+    return (r[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif	/* PCM_HAS_AVX2 */
+
+
+/***************************************************************************
+ * NEON implementation, 8 samples at a time.
+ */
+#if PCM_HAS_NEON
+
+/* vabsq_s16() of -32768 is 0x8000, which is right as unsigned */
+#define ADD_ABS_NEON(sum, s) \
+	    vpadalq_u16(sum, vreinterpretq_u16_s16(vabsq_s16(s)))
+
+static pj_uint32_t hsum_neon(uint32x4_t v)
+{
+    return vgetq_lane_u32(v, 0) + vgetq_lane_u32(v, 1) +
+	   vgetq_lane_u32(v, 2) + vgetq_lane_u32(v, 3);
+}
+
+static void mix_neon(pj_int32_t mix_buf[], const pj_int16_t samples[],
+		     unsigned count, pj_int32_t *p_min, pj_int32_t *p_max)
+{
+    int32x4_t vmin = vdupq_n_s32(*p_min);
+    int32x4_t vmax = vdupq_n_s32(*p_max);
+    pj_int32_t r[4];
+    unsigned i, j;
+
+    for (i=0; i+8 <= count; i+=8) {
+	int16x8_t s = vld1q_s16(samples+i);
+	int32x4_t a0 = vaddw_s16(vld1q_s32(mix_buf+i), vget_low_s16(s));
+	int32x4_t a1 = vaddw_s16(vld1q_s32(mix_buf+i+4), vget_high_s16(s));
+
+	vst1q_s32(mix_buf+i, a0);
+	vst1q_s32(mix_buf+i+4, a1);
+	vmin = vminq_s32(vmin, vminq_s32(a0, a1));
+	vmax = vmaxq_s32(vmax, vmaxq_s32(a0, a1));
+    }
+
+    vst1q_s32(r, vmin);
+    for (j=0; j<4; ++j) {
+	if (r[j] < *p_min) *p_min = r[j];
+    }
+    vst1q_s32(r, vmax);
+    for (j=0; j<4; ++j) {
+	if (r[j] > *p_max) *p_max = r[j];
+    }
+
+    mix_c(mix_buf+i, samples+i, count-i, p_min, p_max);
+}
+
+static void widen_neon(pj_int32_t mix_buf[], const pj_int16_t samples[],
+		       unsigned count)
+{
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	int16x8_t s = vld1q_s16(samples+i);
+
+	vst1q_s32(mix_buf+i, vmovl_s16(vget_low_s16(s)));
+	vst1q_s32(mix_buf+i+4, vmovl_s16(vget_high_s16(s)));
+    }
+
+    widen_c(mix_buf+i, samples+i, count-i);
+}
+
+static pj_uint32_t narrow_neon(pj_int16_t dst[], const pj_int32_t mix_buf[],
+			       unsigned count, unsigned gain)
+{
+    int32x4_t vgain = vdupq_n_s32((pj_int32_t)gain);
+    uint32x4_t sum = vdupq_n_u32(0);
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	/* Both loads must be done before the store, for in place use */
+	int32x4_t a0 = vld1q_s32(mix_buf+i);
+	int32x4_t a1 = vld1q_s32(mix_buf+i+4);
+	int16x8_t s;
+
+	if (gain != NORMAL_LEVEL) {
+	    a0 = vshrq_n_s32(vmulq_s32(a0, vgain), 7);
+	    a1 = vshrq_n_s32(vmulq_s32(a1, vgain), 7);
+	}
+	s = vcombine_s16(vqmovn_s32(a0), vqmovn_s32(a1));
+	vst1q_s16(dst+i, s);
+	sum = ADD_ABS_NEON(sum, s);
+    }
+
+    return hsum_neon(sum) + narrow_c(dst+i, mix_buf+i, count-i, gain);
+}
+
+static pj_uint32_t adjust_neon(pj_int16_t samples[], unsigned count,
+			       unsigned gain)
+{
+    int32x4_t vgain = vdupq_n_s32((pj_int32_t)gain);
+    uint32x4_t sum = vdupq_n_u32(0);
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8) {
+	int16x8_t s = vld1q_s16(samples+i);
+	int32x4_t a0 = vmovl_s16(vget_low_s16(s));
+	int32x4_t a1 = vmovl_s16(vget_high_s16(s));
+
+	a0 = vshrq_n_s32(vmulq_s32(a0, vgain), 7);
+	a1 = vshrq_n_s32(vmulq_s32(a1, vgain), 7);
+	s = vcombine_s16(vqmovn_s32(a0), vqmovn_s32(a1));
+	vst1q_s16(samples+i, s);
+	sum = ADD_ABS_NEON(sum, s);
+    }
+
+    return hsum_neon(sum) + adjust_c(samples+i, count-i, gain);
+}
+
+static pj_uint32_t sum_abs_neon(const pj_int16_t samples[], unsigned count)
+{
+    uint32x4_t sum = vdupq_n_u32(0);
+    unsigned i;
+
+    for (i=0; i+8 <= count; i+=8)
+	sum = ADD_ABS_NEON(sum, vld1q_s16(samples+i));
+
+    return hsum_neon(sum) + sum_abs_c(samples+i, count-i);
+}
+
+static const pcm_ops neon_ops =
+{
+    PJMEDIA_PCM_IMPL_NEON, &mix_neon, &widen_neon, &narrow_neon,
+    &adjust_neon, &sum_abs_neon
+};
+
+#endif	/* PCM_HAS_NEON */
+
+
+/***************************************************************************
+ * Selection of the implementation.
+ */
+
+/* The implementation in use. Selecting it more than once at start-up,
+ * from different threads, is harmless since they all select the same.
+ */
+static const pcm_ops *ops;
+
+static const pcm_ops *find_ops(pjmedia_pcm_impl impl)
+{
+    switch (impl) {
+    case PJMEDIA_PCM_IMPL_AUTO:
+#if PCM_HAS_AVX2
+	if (cpu_has_avx2())
+	    return &avx2_ops;
+#endif
+#if PCM_HAS_SSE2
+	return &sse2_ops;
+#elif PCM_HAS_NEON
+	return &neon_ops;
+#else
+	return &c_ops;
+#endif
+    case PJMEDIA_PCM_IMPL_C:
+	return &c_ops;
+#if PCM_HAS_SSE2
+    case PJMEDIA_PCM_IMPL_SSE2:
+	return &sse2_ops;
+#endif
+#if PCM_HAS_AVX2
+    case PJMEDIA_PCM_IMPL_AVX2:
+	return cpu_has_avx2() ? &avx2_ops : NULL;
+#endif
+#if PCM_HAS_NEON
+    case PJMEDIA_PCM_IMPL_NEON:
+	return &neon_ops;
+#endif
+    default:
+	return NULL;
+    }
+}
+
+static const pcm_ops *get_ops(void)
+{
+    if (ops == NULL) {
+	ops = find_ops(PJMEDIA_PCM_IMPL_AUTO);
+	PJ_LOG(5,(THIS_FILE, "Using %s PCM sample operations",
+		  pjmedia_pcm_impl_name(ops->impl)));
+    }
+    return ops;
+}
+
+
+PJ_DEF(pj_status_t) pjmedia_pcm_set_impl(pjmedia_pcm_impl impl)
+{
+    const pcm_ops *new_ops = find_ops(impl);
+
+    if (new_ops == NULL)
+	return PJ_ENOTSUP;
+
+    ops = new_ops;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pjmedia_pcm_impl) pjmedia_pcm_get_impl(void)
+{
+    return get_ops()->impl;
+}
+
+
+PJ_DEF(const char*) pjmedia_pcm_impl_name(pjmedia_pcm_impl impl)
+{
+    static const char *names[] = { "auto", "c", "sse2", "avx2", "neon" };
+
+    PJ_ASSERT_RETURN((unsigned)impl < PJ_ARRAY_SIZE(names), "?");
+    return names[impl];
+}
+
+
+PJ_DEF(void) pjmedia_pcm_mix(pj_int32_t mix_buf[],
+			     const pj_int16_t samples[],
+			     unsigned count,
+			     pj_int32_t *p_min,
+			     pj_int32_t *p_max)
+{
+    *p_min = *p_max = 0;
+    get_ops()->mix(mix_buf, samples, count, p_min, p_max);
+}
+
+
+PJ_DEF(void) pjmedia_pcm_widen(pj_int32_t mix_buf[],
+			       const pj_int16_t samples[],
+			       unsigned count)
+{
+    get_ops()->widen(mix_buf, samples, count);
+}
+
+
+PJ_DEF(pj_uint32_t) pjmedia_pcm_narrow(pj_int16_t dst[],
+				       const pj_int32_t mix_buf[],
+				       unsigned count,
+				       unsigned gain)
+{
+    return get_ops()->narrow(dst, mix_buf, count, gain);
+}
+
+
+PJ_DEF(pj_uint32_t) pjmedia_pcm_adjust(pj_int16_t samples[],
+				       unsigned count,
+				       unsigned gain)
+{
+    return get_ops()->adjust(samples, count, gain);
+}
+
+
+PJ_DEF(pj_uint32_t) pjmedia_pcm_sum_abs(const pj_int16_t samples[],
+					unsigned count)
+{
+    return get_ops()->sum_abs(samples, count);
+}
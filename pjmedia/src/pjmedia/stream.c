@@ -22,12 +22,15 @@
 #include <pjmedia/rtp.h>
 #include <pjmedia/rtcp.h>
 #include <pjmedia/jbuf.h>
+#include <pjmedia/wsola.h>
 #include <pj/array.h>
 #include <pj/assert.h>
+#include <pj/atomic.h>
 #include <pj/ctype.h>
 #include <pj/compat/socket.h>
 #include <pj/errno.h>
 #include <pj/ioqueue.h>
+#include <pj/list.h>
 #include <pj/log.h>
 #include <pj/os.h>
 #include <pj/pool.h>
@@ -75,6 +78,50 @@
 /* Number of DTMF E bit transmissions */
 #define DTMF_EBIT_RETRANSMIT_CNT	3
 
+/* The indexes of the RX queue are shared between the network thread
+ * (producer) and the thread getting frames from the stream (consumer).
+ * Where the compiler doesn't provide acquire/release accesses, the
+ * producer takes the jitter buffer mutex too.
+ */
+#define RX_QUEUE_NEEDS_LOCK	(!PJ_HAS_ATOMIC_ACQ_REL)
+
+/* Flags of a packet in the RX queue */
+#define RX_PKT_SKIP			1   /* Skip to the start of buffer  */
+#define RX_PKT_RESTART			2   /* RTP session was restarted    */
+
+/**
+ * A received RTP packet waiting in the RX queue, followed by the payload.
+ * The packets have variable size and are 8 bytes aligned.
+ */
+typedef struct rx_pkt
+{
+    unsigned		     rec_size;	    /**< Size including the payload
+						 and padding.		    */
+    unsigned		     flags;	    /**< RX_PKT_xxx flags.	    */
+    int			     seq_diff;	    /**< Sequence diff to previous
+						 packet.		    */
+    unsigned		     payloadlen;    /**< Payload length.	    */
+    pjmedia_rtp_hdr	     hdr;	    /**< RTP header.		    */
+} rx_pkt;
+
+#define RX_PKT_PAYLOAD(pkt)		((char*)(pkt) + sizeof(rx_pkt))
+
+/**
+ * Single producer single consumer queue of received RTP packets, which
+ * are put to the jitter buffer by the consumer.
+ */
+typedef struct rx_queue
+{
+    unsigned		     head;	    /**< Written by producer only.  */
+    char		     pad1[64];
+    unsigned		     tail;	    /**< Written by consumer only.  */
+    char		     pad2[64];
+    unsigned		     mask;	    /**< Buffer size - 1.	    */
+    char		    *buf;	    /**< The buffer.		    */
+    unsigned		     dropped;	    /**< # of packets dropped
+						 because queue was full.    */
+} rx_queue;
+
 /**
  * Media channel.
  */
@@ -98,6 +145,63 @@ struct dtmf
     int		    ebit_cnt;		    /**< # of E bit transmissions   */
 };
 
+/**
+ * An encoder of an encoding group, with its last input and output.
+ */
+struct enc_lane
+{
+    pjmedia_codec	    *codec;	    /**< The encoder.		    */
+    pj_mutex_t		    *mutex;	    /**< Held while encoding, and
+						 protects the fields below. */
+    unsigned		     user_cnt;	    /**< # of streams using it.	    */
+    unsigned		     solo_cnt;	    /**< # of them which are solo.  */
+    pj_bool_t		     has_frame;	    /**< Has encoded a frame.	    */
+    pj_timestamp	     ts;	    /**< Timestamp of last input.   */
+    pj_int16_t		    *in_buf;	    /**< Last input.		    */
+    pj_size_t		     in_size;	    /**< Size of last input.	    */
+    void		    *out_buf;	    /**< Output buffer.		    */
+    pjmedia_frame	     out;	    /**< Last output.		    */
+    pjmedia_stream	    *leader;	    /**< Stream which sent the last
+						 input, or NULL.	    */
+    unsigned		     match_cnt;	    /**< # of streams which sent the
+						 last input.		    */
+    unsigned		     mismatch_cnt;  /**< # of streams which sent
+						 another frame at that time.*/
+    pjmedia_stream	    *probe;	    /**< Solo stream which frame is
+						 in probe_buf, or NULL.	    */
+    pj_timestamp	     probe_ts;	    /**< Timestamp of probe_buf.    */
+    pj_int16_t		    *probe_buf;	    /**< Frame of the solo stream.  */
+    pj_size_t		     probe_size;    /**< Size of probe_buf.	    */
+};
+
+/**
+ * The encoders of an encoding group for the streams with the same codec
+ * setting.
+ */
+struct enc_share
+{
+    PJ_DECL_LIST_MEMBER(struct enc_share);
+    pjmedia_codec_mgr	    *codec_mgr;	    /**< Codec manager.		    */
+    pjmedia_codec_info	     ci;	    /**< Codec info.		    */
+    pjmedia_codec_param	    *param;	    /**< Codec param.		    */
+    unsigned		     member_cnt;    /**< # of streams.		    */
+    unsigned		     in_max;	    /**< Max input size, in bytes.  */
+    unsigned		     out_max;	    /**< Max output size, in bytes. */
+    unsigned		     lane_cnt;	    /**< # of encoders.		    */
+    struct enc_lane	     lane[PJMEDIA_STREAM_ENC_GROUP_MAX_LANES];
+};
+
+/**
+ * Encoding group.
+ */
+struct pjmedia_stream_enc_group
+{
+    pj_pool_t		    *pool;	    /**< Pool.			    */
+    pj_mutex_t		    *mutex;	    /**< Group mutex.		    */
+    struct enc_share	     share_list;    /**< List of enc_share.	    */
+};
+
+
 /**
  * This structure describes media stream.
  * A media stream is bidirectional media transmission between two endpoints.
@@ -124,6 +228,12 @@ struct pjmedia_stream
 
     pjmedia_codec	    *codec;	    /**< Codec instance being used. */
     pjmedia_codec_param	     codec_param;   /**< Codec param.		    */
+    pjmedia_stream_enc_group*enc_grp;	    /**< Encoding group, or NULL.   */
+    struct enc_share	    *enc_share;	    /**< Encoders in enc_grp.	    */
+    int			     enc_lane;	    /**< Encoder in enc_share, or
+						 -1.			    */
+    pj_bool_t		     enc_solo;	    /**< Sends another frame than
+						 most users of the encoder. */
     pj_int16_t		    *enc_buf;	    /**< Encoding buffer, when enc's
 						 ptime is different than dec.
 						 Otherwise it's NULL.	    */
@@ -159,8 +269,25 @@ struct pjmedia_stream
 
     pj_mutex_t		    *jb_mutex;
     pjmedia_jbuf	    *jb;	    /**< Jitter buffer.		    */
+    rx_queue		    *rx_queue;	    /**< Received packets waiting to
+						 be put to the jitter buffer,
+						 NULL if packets are put by
+						 the network thread.	    */
     char		     jb_last_frm;   /**< Last frame type from jb    */
     unsigned		     jb_last_frm_cnt;/**< Last JB frame type counter*/
+    pj_timestamp	     dec_ts;	    /**< Timestamp of the next
+						 decoded sample.	    */
+
+    pjmedia_wsola	    *ts_wsola;	    /**< WSOLA for playout time-scaling,
+						 NULL if it's not enabled.  */
+    pj_int16_t		    *ts_buf;	    /**< Decoded samples waiting to be
+						 played, for time-scaling.  */
+    unsigned		     ts_buf_cnt;    /**< Number of samples in ts_buf*/
+    unsigned		     ts_buf_in_cnt; /**< Number of decoded samples
+						 represented by ts_buf.	    */
+    pj_timestamp	     ts_buf_ts;	    /**< Decoded timestamp of the
+						 first sample in ts_buf.    */
+    pj_bool_t		     ts_prev_gen;   /**< Last frame was generated.  */
 
     pjmedia_rtcp_session     rtcp;	    /**< RTCP for incoming RTP.	    */
 
@@ -489,6 +616,269 @@ static void send_keep_alive_packet(pjmedia_stream *stream)
 }
 #endif	/* defined(PJMEDIA_STREAM_ENABLE_KA) */
 
+/*
+ * Put the frames of a received RTP packet to the jitter buffer, or reset
+ * the jitter buffer when RTP session is restarted. This must be called
+ * with the jitter buffer mutex held. Returns PJ_TRUE if the packet was
+ * discarded.
+ */
+static pj_bool_t put_rx_packet(pjmedia_stream *stream,
+			       const pjmedia_rtp_hdr *hdr,
+			       const void *payload,
+			       unsigned payloadlen,
+			       int seq_diff,
+			       pj_bool_t restart)
+{
+    pj_bool_t pkt_discarded = PJ_FALSE;
+    pj_status_t status;
+
+    if (restart) {
+	pjmedia_jbuf_reset(stream->jb);
+	PJ_LOG(4,(stream->port.info.name.ptr, "Jitter buffer reset"));
+	return PJ_FALSE;
+    }
+
+    /*
+     * Packets may contain more than one frames, while the jitter
+     * buffer can only take one frame per "put" operation. So we need
+     * to ask the codec to "parse" the payload into multiple frames.
+     */
+    enum { MAX = 16 };
+    pj_timestamp ts;
+    unsigned i, count = MAX;
+    unsigned ts_span;
+    pjmedia_frame frames[MAX];
+
+    /* Get the timestamp of the first sample */
+    ts.u64 = pj_ntohl(hdr->ts);
+
+    /* Parse the payload. */
+    status = pjmedia_codec_parse(stream->codec, (void*)payload,
+				 payloadlen, &ts, &count, frames);
+    if (status != PJ_SUCCESS) {
+	LOGERR_((stream->port.info.name.ptr,
+		 "Codec parse() error",
+		 status));
+	pkt_discarded = PJ_TRUE;
+	count = 0;
+    } else if (stream->detect_ptime_change &&
+	       frames[0].bit_info > 0xFFFF)
+    {
+	unsigned dec_ptime;
+
+	PJ_LOG(4, (stream->port.info.name.ptr, "codec decode "
+		   "ptime change detected"));
+	frames[0].bit_info &= 0xFFFF;
+	dec_ptime = frames[0].bit_info * 1000 /
+		    stream->codec_param.info.clock_rate;
+	stream->rtp_rx_ts_len_per_frame= stream->rtp_rx_ts_len_per_frame *
+					 dec_ptime / stream->dec_ptime;
+	stream->dec_ptime = dec_ptime;
+	pjmedia_jbuf_set_ptime(stream->jb, stream->dec_ptime);
+    }
+
+#if defined(PJMEDIA_HANDLE_G722_MPEG_BUG) && (PJMEDIA_HANDLE_G722_MPEG_BUG!=0)
+    /* This code is used to learn the samples per frame value that is put
+     * by remote endpoint, for codecs with inconsistent clock rate such
+     * as G.722 or MPEG audio. We need to learn the samples per frame
+     * value as it is used as divider when inserting frames into the
+     * jitter buffer.
+     */
+    if (stream->has_g722_mpeg_bug) {
+	if (stream->rtp_rx_check_cnt) {
+	    /* Make sure the detection performed only on two consecutive
+	     * packets with valid RTP sequence and no wrapped timestamp.
+	     */
+	    if (seq_diff == 1 && stream->rtp_rx_last_ts &&
+		ts.u64 > stream->rtp_rx_last_ts &&
+		stream->rtp_rx_last_cnt > 0)
+	    {
+		unsigned peer_frm_ts_diff;
+		unsigned frm_ts_span;
+
+		/* Calculate actual frame timestamp span */
+		frm_ts_span = PJMEDIA_PIA_SPF(&stream->port.info) /
+			      stream->codec_param.setting.frm_per_pkt/
+			      PJMEDIA_PIA_CCNT(&stream->port.info);
+
+		/* Get remote frame timestamp span */
+		peer_frm_ts_diff =
+		    ((pj_uint32_t)ts.u64-stream->rtp_rx_last_ts) /
+		    stream->rtp_rx_last_cnt;
+
+		/* Possibilities remote's samples per frame for G.722
+		 * are only (frm_ts_span) and (frm_ts_span/2), this
+		 * validation is needed to avoid wrong decision because
+		 * of silence frames.
+		 */
+		if (stream->codec_param.info.pt == PJMEDIA_RTP_PT_G722 &&
+		    (peer_frm_ts_diff == frm_ts_span ||
+		     peer_frm_ts_diff == (frm_ts_span>>1)))
+		{
+		    if (peer_frm_ts_diff < stream->rtp_rx_ts_len_per_frame)
+		    {
+			stream->rtp_rx_ts_len_per_frame = peer_frm_ts_diff;
+			/* Done, stop the check immediately */
+			stream->rtp_rx_check_cnt = 1;
+		    }
+
+		    if (--stream->rtp_rx_check_cnt == 0) {
+			PJ_LOG(4, (THIS_FILE, "G722 codec used, remote"
+				   " samples per frame detected = %d",
+				   stream->rtp_rx_ts_len_per_frame));
+
+			/* Reset jitter buffer once detection done */
+			pjmedia_jbuf_reset(stream->jb);
+		    }
+		}
+	    }
+
+	    stream->rtp_rx_last_ts = (pj_uint32_t)ts.u64;
+	    stream->rtp_rx_last_cnt = count;
+	}
+
+	ts_span = stream->rtp_rx_ts_len_per_frame;
+
+	/* Adjust the timestamp of the parsed frames */
+	for (i=0; i<count; ++i) {
+	    frames[i].timestamp.u64 = ts.u64 + ts_span * i;
+	}
+
+    } else {
+	ts_span = stream->dec_ptime *
+		  stream->codec_param.info.clock_rate /
+		  1000;
+    }
+#else
+    ts_span = stream->dec_ptime *
+	      stream->codec_param.info.clock_rate /
+	      1000;
+#endif
+
+    /* Put each frame to jitter buffer. */
+    for (i=0; i<count; ++i) {
+	unsigned ext_seq;
+	pj_bool_t discarded;
+
+	ext_seq = (unsigned)(frames[i].timestamp.u64 / ts_span);
+	pjmedia_jbuf_put_frame2(stream->jb, frames[i].buf, frames[i].size,
+				frames[i].bit_info, ext_seq, &discarded);
+	if (discarded)
+	    pkt_discarded = PJ_TRUE;
+    }
+
+#if TRACE_JB
+    trace_jb_put(stream, hdr, payloadlen, count);
+#endif
+
+
+    return pkt_discarded;
+}
+
+
+/*
+ * Queue a received RTP packet to be put to the jitter buffer by the
+ * consumer. This is called by the network thread. Returns PJ_FALSE if
+ * the queue is full.
+ */
+static pj_bool_t rx_queue_put(pjmedia_stream *stream,
+			      const pjmedia_rtp_hdr *hdr,
+			      const void *payload,
+			      unsigned payloadlen,
+			      int seq_diff,
+			      pj_bool_t restart)
+{
+    rx_queue *q = stream->rx_queue;
+    unsigned size = q->mask + 1;
+    unsigned head, pos, rec_size, need;
+    rx_pkt *pkt;
+    pj_bool_t queued = PJ_FALSE;
+
+    /* The payload is not needed when the jitter buffer is reset */
+    if (restart)
+	payloadlen = 0;
+
+    rec_size = (sizeof(rx_pkt) + payloadlen + 7) & ~7;
+
+#if RX_QUEUE_NEEDS_LOCK
+    pj_mutex_lock(stream->jb_mutex);
+#endif
+
+    head = q->head;
+    pos = head & q->mask;
+
+    /* Packet is never split, skip the rest of the buffer if it doesn't
+     * fit there.
+     */
+    need = rec_size;
+    if (size - pos < rec_size)
+	need += size - pos;
+
+    if (rec_size > (size >> 1) ||
+	size - (head - PJ_ATOMIC_LOAD_ACQUIRE(&q->tail)) < need)
+    {
+	PJ_ATOMIC_STORE_RELEASE(&q->dropped, q->dropped + 1);
+	goto on_return;
+    }
+
+    if (size - pos < rec_size) {
+	pkt = (rx_pkt*)(q->buf + pos);
+	pkt->rec_size = size - pos;
+	pkt->flags = RX_PKT_SKIP;
+	head += size - pos;
+	pos = 0;
+    }
+
+    pkt = (rx_pkt*)(q->buf + pos);
+    pkt->rec_size = rec_size;
+    pkt->flags = restart ? RX_PKT_RESTART : 0;
+    pkt->seq_diff = seq_diff;
+    pkt->payloadlen = payloadlen;
+    pj_memcpy(&pkt->hdr, hdr, sizeof(pjmedia_rtp_hdr));
+    if (payloadlen)
+	pj_memcpy(RX_PKT_PAYLOAD(pkt), payload, payloadlen);
+
+    PJ_ATOMIC_STORE_RELEASE(&q->head, head + rec_size);
+    queued = PJ_TRUE;
+
+on_return:
+#if RX_QUEUE_NEEDS_LOCK
+    pj_mutex_unlock(stream->jb_mutex);
+#endif
+    return queued;
+}
+
+
+/*
+ * Put the queued RTP packets to the jitter buffer. This is called by the
+ * consumer of the jitter buffer with the jitter buffer mutex held.
+ */
+static void rx_queue_get(pjmedia_stream *stream)
+{
+    rx_queue *q = stream->rx_queue;
+    unsigned head, tail;
+
+    if (!q)
+	return;
+
+    tail = q->tail;
+    head = PJ_ATOMIC_LOAD_ACQUIRE(&q->head);
+
+    while (tail != head) {
+	rx_pkt *pkt = (rx_pkt*)(q->buf + (tail & q->mask));
+
+	if ((pkt->flags & RX_PKT_SKIP) == 0) {
+	    put_rx_packet(stream, &pkt->hdr, RX_PKT_PAYLOAD(pkt),
+			  pkt->payloadlen, pkt->seq_diff,
+			  (pkt->flags & RX_PKT_RESTART) != 0);
+	}
+	tail += pkt->rec_size;
+    }
+
+    PJ_ATOMIC_STORE_RELEASE(&q->tail, tail);
+}
+
+
 /*
  * play_callback()
  *
@@ -517,6 +907,9 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
     /* Lock jitter buffer mutex first */
     pj_mutex_lock( stream->jb_mutex );
 
+    /* Put the received packets to the jitter buffer */
+    rx_queue_get(stream);
+
     samples_required = PJMEDIA_PIA_SPF(&stream->port.info);
     samples_per_frame = stream->dec_ptime *
 			stream->codec_param.info.clock_rate *
@@ -778,13 +1171,145 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
     } else {
 	frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
 	frame->size = samples_count * BYTES_PER_SAMPLE;
-	frame->timestamp.u64 = 0;
+	frame->timestamp = stream->dec_ts;
+	stream->dec_ts.u64 += samples_count;
     }
 
     return PJ_SUCCESS;
 }
 
 
+/* Get a frame with get_frame() and append it to the time-scaling buffer.
+ * Returns PJ_FALSE if there is no frame.
+ */
+static pj_bool_t ts_get_frame(pjmedia_port *port, unsigned samples_per_frame)
+{
+    pjmedia_stream *stream = (pjmedia_stream*) port->port_data.pdata;
+    pj_int16_t *samples = stream->ts_buf + stream->ts_buf_cnt;
+    pjmedia_frame frame;
+
+    frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame.buf = samples;
+    frame.size = samples_per_frame * BYTES_PER_SAMPLE;
+    get_frame(port, &frame);
+    if (frame.type != PJMEDIA_FRAME_TYPE_AUDIO || frame.size == 0)
+	return PJ_FALSE;
+
+    if (frame.size < samples_per_frame * BYTES_PER_SAMPLE) {
+	unsigned cnt = (unsigned)frame.size / BYTES_PER_SAMPLE;
+	pjmedia_zero_samples(samples + cnt, samples_per_frame - cnt);
+    }
+
+    pjmedia_wsola_save(stream->ts_wsola, samples, stream->ts_prev_gen);
+    stream->ts_prev_gen = PJ_FALSE;
+    stream->ts_buf_cnt += samples_per_frame;
+
+    /* The buffered samples follow the decoded ones, unless the buffer only
+     * has generated samples.
+     */
+    if (stream->ts_buf_in_cnt == 0)
+	stream->ts_buf_ts = frame.timestamp;
+    stream->ts_buf_in_cnt += samples_per_frame;
+
+    return PJ_TRUE;
+}
+
+
+/* The version of get_frame callback used when the jitter buffer latency
+ * is adjusted by time-scaling the playout. The decoded samples go through
+ * WSOLA, which compresses the playout by getting extra frames and
+ * shortening them, and stretches it by generating a frame instead of
+ * getting it, as requested by the jitter buffer. The timestamp of the
+ * frame is the timestamp of the decoded samples which it plays, scaled by
+ * the number of played samples over the number of decoded samples.
+ */
+static pj_status_t get_frame_time_scale(pjmedia_port *port,
+					pjmedia_frame *frame)
+{
+    pjmedia_stream *stream = (pjmedia_stream*) port->port_data.pdata;
+    unsigned samples_per_frame = PJMEDIA_PIA_SPF(&stream->port.info);
+    unsigned in_cnt;
+    int time_scale = 0;
+
+    /* Return no frame if channel is paused */
+    if (stream->dec->paused) {
+	frame->type = PJMEDIA_FRAME_TYPE_NONE;
+	return PJ_SUCCESS;
+    }
+
+    /* Only ask the jitter buffer when we need to get a frame from it */
+    if (stream->ts_buf_cnt < samples_per_frame) {
+	pj_mutex_lock(stream->jb_mutex);
+	rx_queue_get(stream);
+	time_scale = pjmedia_jbuf_get_time_scale(stream->jb);
+	pj_mutex_unlock(stream->jb_mutex);
+    }
+
+    if (time_scale < 0) {
+	/* Stretch, generate this frame */
+	pjmedia_wsola_generate(stream->ts_wsola,
+			       stream->ts_buf + stream->ts_buf_cnt);
+	stream->ts_buf_cnt += samples_per_frame;
+	stream->ts_prev_gen = PJ_TRUE;
+
+    } else if (time_scale > 0) {
+	/* Compress, get two more frames and erase about one frame. WSOLA
+	 * needs at least one frame after the erased samples to find the
+	 * best overlapping position.
+	 */
+	unsigned erase_cnt = samples_per_frame;
+
+	while (stream->ts_buf_cnt < samples_per_frame * 3 &&
+	       ts_get_frame(port, samples_per_frame))
+	{
+	}
+
+	if (stream->ts_buf_cnt > samples_per_frame * 2 &&
+	    pjmedia_wsola_discard(stream->ts_wsola, stream->ts_buf,
+				  stream->ts_buf_cnt, NULL, 0,
+				  &erase_cnt) == PJ_SUCCESS)
+	{
+	    stream->ts_buf_cnt -= erase_cnt;
+	}
+    }
+
+    while (stream->ts_buf_cnt < samples_per_frame &&
+	   ts_get_frame(port, samples_per_frame))
+    {
+    }
+
+    if (stream->ts_buf_cnt == 0) {
+	frame->type = PJMEDIA_FRAME_TYPE_NONE;
+	frame->size = 0;
+	return PJ_SUCCESS;
+    }
+
+    /* Play the samples, pad with silence if we have less than a frame */
+    if (stream->ts_buf_cnt < samples_per_frame) {
+	pjmedia_zero_samples(stream->ts_buf + stream->ts_buf_cnt,
+			     samples_per_frame - stream->ts_buf_cnt);
+	stream->ts_buf_cnt = samples_per_frame;
+    }
+
+    frame->timestamp = stream->ts_buf_ts;
+    in_cnt = (unsigned)((pj_uint64_t)stream->ts_buf_in_cnt *
+			samples_per_frame / stream->ts_buf_cnt);
+    stream->ts_buf_ts.u64 += in_cnt;
+    stream->ts_buf_in_cnt -= in_cnt;
+
+    pjmedia_copy_samples((pj_int16_t*)frame->buf, stream->ts_buf,
+			 samples_per_frame);
+    stream->ts_buf_cnt -= samples_per_frame;
+    pjmedia_move_samples(stream->ts_buf, stream->ts_buf + samples_per_frame,
+			 stream->ts_buf_cnt);
+
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame->size = samples_per_frame * BYTES_PER_SAMPLE;
+
+    return PJ_SUCCESS;
+}
+
+
 /* The other version of get_frame callback used when stream port format
  * is non linear PCM.
  */
@@ -823,6 +1348,9 @@ static pj_status_t get_frame_ext( pjmedia_port *port, pjmedia_frame *frame)
 	/* Lock jitter buffer mutex first */
 	pj_mutex_lock( stream->jb_mutex );
 
+	/* Put the received packets to the jitter buffer */
+	rx_queue_get(stream);
+
 	/* Get frame from jitter buffer. */
 	pjmedia_jbuf_get_frame2(stream->jb, channel->out_pkt, &frame_size,
 			        &frame_type, &bit_info);
@@ -1205,6 +1733,338 @@ static void rebuffer(pjmedia_stream *stream,
 }
 
 
+/*
+ * Check if the codec setting of the stream is the same as the setting of
+ * the encoders.
+ */
+static pj_bool_t enc_share_match(const struct enc_share *share,
+				 const pjmedia_stream *stream)
+{
+    const pjmedia_codec_param *p1 = share->param;
+    const pjmedia_codec_param *p2 = &stream->codec_param;
+    unsigned i;
+
+    if (pj_stricmp(&share->ci.encoding_name,
+		   &stream->si.fmt.encoding_name) != 0 ||
+	share->ci.clock_rate != stream->si.fmt.clock_rate ||
+	share->ci.channel_cnt != stream->si.fmt.channel_cnt ||
+	p1->info.clock_rate != p2->info.clock_rate ||
+	p1->info.channel_cnt != p2->info.channel_cnt ||
+	p1->info.avg_bps != p2->info.avg_bps ||
+	p1->info.frm_ptime != p2->info.frm_ptime ||
+	p1->info.enc_ptime != p2->info.enc_ptime ||
+	p1->setting.frm_per_pkt != p2->setting.frm_per_pkt ||
+	p1->setting.vad != p2->setting.vad ||
+	p1->setting.enc_fmtp.cnt != p2->setting.enc_fmtp.cnt)
+    {
+	return PJ_FALSE;
+    }
+
+    for (i=0; i<p1->setting.enc_fmtp.cnt; ++i) {
+	if (pj_stricmp(&p1->setting.enc_fmtp.param[i].name,
+		       &p2->setting.enc_fmtp.param[i].name) != 0 ||
+	    pj_strcmp(&p1->setting.enc_fmtp.param[i].val,
+		      &p2->setting.enc_fmtp.param[i].val) != 0)
+	{
+	    return PJ_FALSE;
+	}
+    }
+
+    return PJ_TRUE;
+}
+
+/*
+ * Add the stream to the encoders of the group with the same codec setting.
+ * The stream gets its encoder when it sends the first frame.
+ */
+static void enc_group_join(pjmedia_stream *stream,
+			   pjmedia_stream_enc_group *grp)
+{
+    struct enc_share *share;
+
+    pj_mutex_lock(grp->mutex);
+
+    share = grp->share_list.next;
+    while (share != &grp->share_list && !enc_share_match(share, stream))
+	share = share->next;
+
+    if (share == &grp->share_list) {
+	share = PJ_POOL_ZALLOC_T(grp->pool, struct enc_share);
+	share->codec_mgr = stream->codec_mgr;
+	share->ci = stream->si.fmt;
+	pj_strdup(grp->pool, &share->ci.encoding_name,
+		  &stream->si.fmt.encoding_name);
+	share->param = pjmedia_codec_param_clone(grp->pool,
+						 &stream->codec_param);
+	share->in_max = stream->enc_samples_per_pkt * BYTES_PER_SAMPLE;
+	share->out_max = stream->enc->out_pkt_size - sizeof(pjmedia_rtp_hdr);
+	pj_list_push_back(&grp->share_list, share);
+    }
+
+    ++share->member_cnt;
+    stream->enc_grp = grp;
+    stream->enc_share = share;
+    stream->enc_lane = -1;
+    stream->enc_solo = PJ_FALSE;
+
+    pj_mutex_unlock(grp->mutex);
+}
+
+/* Set or clear the solo flag of a user of the encoder. */
+static void enc_lane_set_solo(struct enc_lane *lane, pjmedia_stream *stream,
+			      pj_bool_t solo)
+{
+    if (stream->enc_solo == solo)
+	return;
+
+    stream->enc_solo = solo;
+    if (solo)
+	++lane->solo_cnt;
+    else
+	--lane->solo_cnt;
+}
+
+/*
+ * Remove the stream from its encoding group.
+ */
+static void enc_group_leave(pjmedia_stream *stream)
+{
+    pjmedia_stream_enc_group *grp = stream->enc_grp;
+
+    if (!grp)
+	return;
+
+    pj_mutex_lock(grp->mutex);
+
+    if (stream->enc_lane >= 0) {
+	struct enc_lane *lane = &stream->enc_share->lane[stream->enc_lane];
+
+	pj_mutex_lock(lane->mutex);
+	enc_lane_set_solo(lane, stream, PJ_FALSE);
+	--lane->user_cnt;
+	if (lane->leader == stream)
+	    lane->leader = NULL;
+	if (lane->probe == stream)
+	    lane->probe = NULL;
+	pj_mutex_unlock(lane->mutex);
+    }
+    --stream->enc_share->member_cnt;
+
+    stream->enc_grp = NULL;
+    stream->enc_share = NULL;
+    stream->enc_lane = -1;
+
+    pj_mutex_unlock(grp->mutex);
+}
+
+/*
+ * Create an encoder of the group.
+ */
+static pj_status_t enc_lane_create(pjmedia_stream_enc_group *grp,
+				   struct enc_share *share,
+				   struct enc_lane *lane)
+{
+    pjmedia_codec_param param;
+    pj_status_t status;
+
+    status = pj_mutex_create_simple(grp->pool, "enclane", &lane->mutex);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pjmedia_codec_mgr_alloc_codec(share->codec_mgr, &share->ci,
+					   &lane->codec);
+    if (status != PJ_SUCCESS) {
+	pj_mutex_destroy(lane->mutex);
+	lane->mutex = NULL;
+	return status;
+    }
+
+    /* Open may update the param, so give it a copy */
+    param = *share->param;
+    status = pjmedia_codec_init(lane->codec, grp->pool);
+    if (status == PJ_SUCCESS)
+	status = pjmedia_codec_open(lane->codec, &param);
+    if (status != PJ_SUCCESS) {
+	pjmedia_codec_mgr_dealloc_codec(share->codec_mgr, lane->codec);
+	lane->codec = NULL;
+	pj_mutex_destroy(lane->mutex);
+	lane->mutex = NULL;
+	return status;
+    }
+
+    lane->in_buf = (pj_int16_t*) pj_pool_alloc(grp->pool, share->in_max);
+    lane->probe_buf = (pj_int16_t*) pj_pool_alloc(grp->pool, share->in_max);
+    lane->out_buf = pj_pool_alloc(grp->pool, share->out_max);
+
+    return PJ_SUCCESS;
+}
+
+/* Check if the encoder hasn't encoded a frame at this time. */
+#define LANE_IS_FREE(lane, t)	(!(lane)->has_frame || \
+				 (lane)->ts.u64 != (t)->u64)
+
+/* Check if the encoder's last input is the frame. */
+#define LANE_HAS_INPUT(lane, f)	(!LANE_IS_FREE(lane, &(f)->timestamp) && \
+				 (lane)->in_size == (f)->size && \
+				 pj_memcmp((lane)->in_buf, (f)->buf, \
+					   (f)->size) == 0)
+
+/*
+ * Choose the encoder of the stream: the one which has just encoded the
+ * same frame, else one which isn't used, else a new one. The stream keeps
+ * the encoder until it leaves the group, so it never continues from the
+ * state of another encoder.
+ */
+static pj_status_t enc_lane_select(pjmedia_stream *stream,
+				   const pjmedia_frame *frame)
+{
+    pjmedia_stream_enc_group *grp = stream->enc_grp;
+    struct enc_share *share = stream->enc_share;
+    int i, idx = -1;
+
+    pj_mutex_lock(grp->mutex);
+
+    for (i=0; idx < 0 && i<(int)share->lane_cnt; ++i) {
+	struct enc_lane *lane = &share->lane[i];
+
+	pj_mutex_lock(lane->mutex);
+	if (LANE_HAS_INPUT(lane, frame))
+	    idx = i;
+	pj_mutex_unlock(lane->mutex);
+    }
+    for (i=0; idx < 0 && i<(int)share->lane_cnt; ++i) {
+	if (share->lane[i].user_cnt == 0)
+	    idx = i;
+    }
+    if (idx < 0 && share->lane_cnt < PJMEDIA_STREAM_ENC_GROUP_MAX_LANES &&
+	enc_lane_create(grp, share,
+			&share->lane[share->lane_cnt]) == PJ_SUCCESS)
+    {
+	idx = share->lane_cnt++;
+    }
+
+    if (idx >= 0) {
+	pj_mutex_lock(share->lane[idx].mutex);
+	++share->lane[idx].user_cnt;
+	pj_mutex_unlock(share->lane[idx].mutex);
+	stream->enc_lane = idx;
+    }
+
+    pj_mutex_unlock(grp->mutex);
+
+    return idx >= 0 ? PJ_SUCCESS : PJ_ETOOMANY;
+}
+
+/*
+ * Encode the frame with the stream's codec, or with the stream's encoder
+ * in the encoding group. The first user of the encoder which sends a
+ * frame at a given time encodes it, and the other users which send the
+ * same frame at that time copy the result. A user which sends another
+ * frame encodes it with its own codec, so the encoder state only follows
+ * one signal. Only the encoder's mutex is held while encoding.
+ */
+static pj_status_t encode_frame(pjmedia_stream *stream,
+				const pjmedia_frame *frame,
+				unsigned out_size,
+				pjmedia_frame *frame_out)
+{
+    struct enc_share *share = stream->enc_share;
+    struct enc_lane *lane;
+    pj_status_t status;
+
+    if (!stream->enc_grp || frame->type != PJMEDIA_FRAME_TYPE_AUDIO ||
+	frame->size > share->in_max || out_size < share->out_max ||
+	(stream->enc_lane < 0 &&
+	 enc_lane_select(stream, frame) != PJ_SUCCESS))
+    {
+	return pjmedia_codec_encode(stream->codec, frame, out_size,
+				    frame_out);
+    }
+
+    lane = &share->lane[stream->enc_lane];
+    pj_mutex_lock(lane->mutex);
+
+    if (LANE_IS_FREE(lane, &frame->timestamp)) {
+	if (stream->enc_solo && lane->user_cnt > lane->solo_cnt) {
+	    /* This stream has been sending another frame than most users
+	     * of the encoder, e.g. it's a speaker whose mix doesn't have its
+	     * own voice. Leave the encoder to them, but keep the frame to
+	     * see if the stream sends the same frame again.
+	     */
+	    if (!lane->probe ||
+		lane->probe_ts.u64 != frame->timestamp.u64)
+	    {
+		lane->probe = stream;
+		lane->probe_ts = frame->timestamp;
+		lane->probe_size = frame->size;
+		pj_memcpy(lane->probe_buf, frame->buf, frame->size);
+	    }
+	    goto on_own_codec;
+	}
+
+	/* Note that codecs may reset the output buffer on silence */
+	lane->out.buf = lane->out_buf;
+	status = pjmedia_codec_encode(lane->codec, frame, share->out_max,
+				      &lane->out);
+	if (status != PJ_SUCCESS) {
+	    lane->has_frame = PJ_FALSE;
+	    pj_mutex_unlock(lane->mutex);
+	    return status;
+	}
+
+	lane->has_frame = PJ_TRUE;
+	lane->ts = frame->timestamp;
+	lane->in_size = frame->size;
+	pj_memcpy(lane->in_buf, frame->buf, frame->size);
+	lane->leader = stream;
+	lane->match_cnt = 1;
+	lane->mismatch_cnt = 0;
+	enc_lane_set_solo(lane, stream, PJ_FALSE);
+
+	if (lane->probe && lane->probe_ts.u64 == frame->timestamp.u64 &&
+	    lane->probe_size == frame->size &&
+	    pj_memcmp(lane->probe_buf, frame->buf, frame->size) == 0)
+	{
+	    enc_lane_set_solo(lane, lane->probe, PJ_FALSE);
+	}
+	lane->probe = NULL;
+
+    } else if (LANE_HAS_INPUT(lane, frame)) {
+	++lane->match_cnt;
+	enc_lane_set_solo(lane, stream, PJ_FALSE);
+
+    } else {
+	/* If most users send another frame than the one which was
+	 * encoded, the stream which sent it should leave the encoder to
+	 * them from the next frame.
+	 */
+	if (++lane->mismatch_cnt > lane->match_cnt && lane->leader) {
+	    enc_lane_set_solo(lane, lane->leader, PJ_TRUE);
+	    lane->leader = NULL;
+	}
+	goto on_own_codec;
+    }
+
+    /* Copy the payload, to be sent after this stream's RTP header */
+    frame_out->type = lane->out.type;
+    frame_out->size = lane->out.size;
+    frame_out->timestamp = lane->out.timestamp;
+    frame_out->bit_info = lane->out.bit_info;
+    if (lane->out.buf && lane->out.size)
+	pj_memcpy(frame_out->buf, lane->out.buf, lane->out.size);
+    else
+	frame_out->size = 0;
+
+    pj_mutex_unlock(lane->mutex);
+
+    return PJ_SUCCESS;
+
+on_own_codec:
+    pj_mutex_unlock(lane->mutex);
+    return pjmedia_codec_encode(stream->codec, frame, out_size, frame_out);
+}
+
+
 /**
  * put_frame_imp()
  */
@@ -1358,10 +2218,10 @@ static pj_status_t put_frame_imp( pjmedia_port *port,
 	       (frame->type == PJMEDIA_FRAME_TYPE_EXTENDED))
     {
 	/* Encode! */
-	status = pjmedia_codec_encode( stream->codec, frame,
-				       channel->out_pkt_size -
-				       sizeof(pjmedia_rtp_hdr),
-				       &frame_out);
+	status = encode_frame( stream, frame,
+			       channel->out_pkt_size -
+			       sizeof(pjmedia_rtp_hdr),
+			       &frame_out);
 	if (status != PJ_SUCCESS) {
 	    LOGERR_((stream->port.info.name.ptr,
 		    "Codec encode() error", status));
@@ -1519,6 +2379,14 @@ static pj_status_t put_frame( pjmedia_port *port,
 	stream->codec_param.setting.vad = stream->vad_enabled;
 	pjmedia_codec_modify(stream->codec, &stream->codec_param);
 	PJ_LOG(4,(stream->port.info.name.ptr,"VAD re-enabled"));
+
+	/* Move to the encoders with VAD in the encoding group */
+	if (stream->enc_grp) {
+	    pjmedia_stream_enc_group *grp = stream->enc_grp;
+
+	    enc_group_leave(stream);
+	    enc_group_join(stream, grp);
+	}
     }
 
 
@@ -1833,147 +2701,25 @@ static void on_rx_rtp( pjmedia_tp_cb_param *param)
     }
 
     /* Put "good" packet to jitter buffer, or reset the jitter buffer
-     * when RTP session is restarted.
+     * when RTP session is restarted. When the RX queue is used, this is
+     * done later by the consumer of the jitter buffer, so that the network
+     * thread doesn't need to take the jitter buffer mutex.
      */
-    pj_mutex_lock( stream->jb_mutex );
-    if (seq_st.status.flag.restart) {
-	status = pjmedia_jbuf_reset(stream->jb);
-	PJ_LOG(4,(stream->port.info.name.ptr, "Jitter buffer reset"));
-    } else {
-	/*
-	 * Packets may contain more than one frames, while the jitter
-	 * buffer can only take one frame per "put" operation. So we need
-	 * to ask the codec to "parse" the payload into multiple frames.
-	 */
-	enum { MAX = 16 };
-	pj_timestamp ts;
-	unsigned i, count = MAX;
-	unsigned ts_span;
-	pjmedia_frame frames[MAX];
-
-	/* Get the timestamp of the first sample */
-	ts.u64 = pj_ntohl(hdr->ts);
-
-	/* Parse the payload. */
-	status = pjmedia_codec_parse(stream->codec, (void*)payload,
-				     payloadlen, &ts, &count, frames);
-	if (status != PJ_SUCCESS) {
-	    LOGERR_((stream->port.info.name.ptr,
-		     "Codec parse() error",
-		     status));
-	    count = 0;
-	} else if (stream->detect_ptime_change &&
-		   frames[0].bit_info > 0xFFFF)
+    if (stream->rx_queue) {
+	if (!rx_queue_put(stream, hdr, payload, payloadlen, seq_st.diff,
+			  seq_st.status.flag.restart))
 	{
-	    unsigned dec_ptime;
-	    
-	    PJ_LOG(4, (stream->port.info.name.ptr, "codec decode "
-	               "ptime change detected"));
-	    frames[0].bit_info &= 0xFFFF;
-	    dec_ptime = frames[0].bit_info * 1000 /
-	    		stream->codec_param.info.clock_rate;
-	    stream->rtp_rx_ts_len_per_frame= stream->rtp_rx_ts_len_per_frame *
-	    				     dec_ptime / stream->dec_ptime;
-	    stream->dec_ptime = dec_ptime;
-	    pjmedia_jbuf_set_ptime(stream->jb, stream->dec_ptime);
-	}
-
-#if defined(PJMEDIA_HANDLE_G722_MPEG_BUG) && (PJMEDIA_HANDLE_G722_MPEG_BUG!=0)
-	/* This code is used to learn the samples per frame value that is put
-	 * by remote endpoint, for codecs with inconsistent clock rate such
-	 * as G.722 or MPEG audio. We need to learn the samples per frame
-	 * value as it is used as divider when inserting frames into the
-	 * jitter buffer.
-	 */
-	if (stream->has_g722_mpeg_bug) {
-	    if (stream->rtp_rx_check_cnt) {
-		/* Make sure the detection performed only on two consecutive
-		 * packets with valid RTP sequence and no wrapped timestamp.
-		 */
-		if (seq_st.diff == 1 && stream->rtp_rx_last_ts &&
-		    ts.u64 > stream->rtp_rx_last_ts &&
-		    stream->rtp_rx_last_cnt > 0)
-		{
-		    unsigned peer_frm_ts_diff;
-		    unsigned frm_ts_span;
-
-		    /* Calculate actual frame timestamp span */
-		    frm_ts_span = PJMEDIA_PIA_SPF(&stream->port.info) /
-				  stream->codec_param.setting.frm_per_pkt/
-				  PJMEDIA_PIA_CCNT(&stream->port.info);
-
-		    /* Get remote frame timestamp span */
-		    peer_frm_ts_diff =
-			((pj_uint32_t)ts.u64-stream->rtp_rx_last_ts) /
-			stream->rtp_rx_last_cnt;
-
-		    /* Possibilities remote's samples per frame for G.722
-		     * are only (frm_ts_span) and (frm_ts_span/2), this
-		     * validation is needed to avoid wrong decision because
-		     * of silence frames.
-		     */
-		    if (stream->codec_param.info.pt == PJMEDIA_RTP_PT_G722 &&
-			(peer_frm_ts_diff == frm_ts_span ||
-			 peer_frm_ts_diff == (frm_ts_span>>1)))
-		    {
-			if (peer_frm_ts_diff < stream->rtp_rx_ts_len_per_frame)
-			{
-			    stream->rtp_rx_ts_len_per_frame = peer_frm_ts_diff;
-			    /* Done, stop the check immediately */
-			    stream->rtp_rx_check_cnt = 1;
-			}
-
-			if (--stream->rtp_rx_check_cnt == 0) {
-    			    PJ_LOG(4, (THIS_FILE, "G722 codec used, remote"
-				       " samples per frame detected = %d",
-				       stream->rtp_rx_ts_len_per_frame));
-
-			    /* Reset jitter buffer once detection done */
-			    pjmedia_jbuf_reset(stream->jb);
-			}
-		    }
-		}
-
-		stream->rtp_rx_last_ts = (pj_uint32_t)ts.u64;
-		stream->rtp_rx_last_cnt = count;
-	    }
-
-	    ts_span = stream->rtp_rx_ts_len_per_frame;
-
-	    /* Adjust the timestamp of the parsed frames */
-	    for (i=0; i<count; ++i) {
-		frames[i].timestamp.u64 = ts.u64 + ts_span * i;
-	    }
-
-	} else {
-	    ts_span = stream->dec_ptime *
-		      stream->codec_param.info.clock_rate /
-		      1000;
+	    pkt_discarded = PJ_TRUE;
 	}
-#else
-	ts_span = stream->dec_ptime *
-		  stream->codec_param.info.clock_rate /
-		  1000;
-#endif
-
-	/* Put each frame to jitter buffer. */
-	for (i=0; i<count; ++i) {
-	    unsigned ext_seq;
-	    pj_bool_t discarded;
-
-	    ext_seq = (unsigned)(frames[i].timestamp.u64 / ts_span);
-	    pjmedia_jbuf_put_frame2(stream->jb, frames[i].buf, frames[i].size,
-				    frames[i].bit_info, ext_seq, &discarded);
-	    if (discarded)
-		pkt_discarded = PJ_TRUE;
+    } else {
+	pj_mutex_lock( stream->jb_mutex );
+	if (put_rx_packet(stream, hdr, payload, payloadlen, seq_st.diff,
+			  seq_st.status.flag.restart))
+	{
+	    pkt_discarded = PJ_TRUE;
 	}
-
-#if TRACE_JB
-	trace_jb_put(stream, hdr, payloadlen, count);
-#endif
-
+	pj_mutex_unlock( stream->jb_mutex );
     }
-    pj_mutex_unlock( stream->jb_mutex );
 
 
     /* Check if now is the time to transmit RTCP SR/RR report.
@@ -1984,13 +2730,6 @@ static void on_rx_rtp( pjmedia_tp_cb_param *param)
 	check_tx_rtcp(stream, pj_ntohl(hdr->ts));
     }
 
-    if (status != 0) {
-	LOGERR_((stream->port.info.name.ptr, "Jitter buffer put() error",
-		status));
-	pkt_discarded = PJ_TRUE;
-	goto on_return;
-    }
-
 on_return:
     /* Update RTCP session */
     if (stream->rtcp.peer_ssrc == 0)
@@ -2121,6 +2860,7 @@ PJ_DEF(pj_status_t) pjmedia_stream_create( pjmedia_endpt *endpt,
     pjmedia_stream *stream;
     pj_str_t name;
     unsigned jb_init, jb_max, jb_min_pre, jb_max_pre;
+    unsigned rx_queue_pkt_cnt;
     pjmedia_audio_format_detail *afd;
     pj_pool_t *own_pool = NULL;
     char *p;
@@ -2421,6 +3161,49 @@ PJ_DEF(pj_status_t) pjmedia_stream_create( pjmedia_endpt *endpt,
     /* Set up jitter buffer */
     pjmedia_jbuf_set_adaptive( stream->jb, jb_init, jb_min_pre, jb_max_pre);
 
+    /* Create the queue of received RTP packets, big enough for the
+     * configured number of packets and at least two packets of MTU size.
+     */
+    rx_queue_pkt_cnt = info->rx_queue_pkt_cnt < 0 ?
+		       PJMEDIA_STREAM_RX_QUEUE_PKT_CNT : info->rx_queue_pkt_cnt;
+    if (rx_queue_pkt_cnt > 0) {
+	unsigned pkt_size, size = 64;
+
+	pkt_size = sizeof(rx_pkt) + stream->frame_size *
+		   stream->codec_param.setting.frm_per_pkt;
+	while (size < rx_queue_pkt_cnt * pkt_size ||
+	       size < 2 * (sizeof(rx_pkt) + PJMEDIA_MAX_MTU + 8))
+	{
+	    size <<= 1;
+	}
+
+	stream->rx_queue = PJ_POOL_ZALLOC_T(pool, rx_queue);
+	stream->rx_queue->buf = (char*) pj_pool_alloc(pool, size);
+	stream->rx_queue->mask = size - 1;
+    }
+
+    /* Adjust the jitter buffer latency by time-scaling the playout. This
+     * needs linear PCM and, as WSOLA works on mono audio, one channel.
+     */
+    if (info->jb_time_scale && stream->port.get_frame == &get_frame &&
+	stream->codec_param.info.channel_cnt == 1)
+    {
+	unsigned spf = PJMEDIA_PIA_SPF(&stream->port.info);
+
+	status = pjmedia_wsola_create(pool, afd->clock_rate, spf, 1,
+				      PJMEDIA_WSOLA_NO_FADING,
+				      &stream->ts_wsola);
+	if (status != PJ_SUCCESS)
+	    goto err_cleanup;
+
+	/* Room for the leftover and the frames got for compressing */
+	stream->ts_buf = (pj_int16_t*)
+			 pj_pool_alloc(pool, spf * 4 * BYTES_PER_SAMPLE);
+
+	pjmedia_jbuf_set_discard(stream->jb, PJMEDIA_JB_DISCARD_TIME_SCALE);
+	stream->port.get_frame = &get_frame_time_scale;
+    }
+
     /* Create decoder channel: */
 
     status = create_channel( pool, stream, PJMEDIA_DIR_DECODING,
@@ -2678,6 +3461,9 @@ PJ_DEF(pj_status_t) pjmedia_stream_destroy( pjmedia_stream *stream )
 	stream->transport = NULL;
     }
 
+    /* Leave the encoding group */
+    enc_group_leave(stream);
+
     /* This function may be called when stream is partly initialized. */
     if (stream->jb_mutex)
 	pj_mutex_lock(stream->jb_mutex);
@@ -2703,6 +3489,11 @@ PJ_DEF(pj_status_t) pjmedia_stream_destroy( pjmedia_stream *stream )
     if (stream->jb)
 	pjmedia_jbuf_destroy(stream->jb);
 
+    if (stream->ts_wsola) {
+	pjmedia_wsola_destroy(stream->ts_wsola);
+	stream->ts_wsola = NULL;
+    }
+
 #if TRACE_JB
     if (TRACE_JB_OPENED(stream)) {
 	pj_file_close(stream->trace_jb_fd);
@@ -2831,8 +3622,26 @@ PJ_DEF(pj_status_t) pjmedia_stream_get_stat_xr( const pjmedia_stream *stream,
 PJ_DEF(pj_status_t) pjmedia_stream_get_stat_jbuf(const pjmedia_stream *stream,
 						 pjmedia_jb_state *state)
 {
+    pj_status_t status;
+
     PJ_ASSERT_RETURN(stream && state, PJ_EINVAL);
-    return pjmedia_jbuf_get_state(stream->jb, state);
+
+    if (!stream->rx_queue)
+	return pjmedia_jbuf_get_state(stream->jb, state);
+
+    /* Put the queued packets to the jitter buffer first, so the state
+     * includes all the received packets.
+     */
+    pj_mutex_lock(stream->jb_mutex);
+    rx_queue_get((pjmedia_stream*)stream);
+    status = pjmedia_jbuf_get_state(stream->jb, state);
+    pj_mutex_unlock(stream->jb_mutex);
+
+    /* Packets dropped because the RX queue was full */
+    if (status == PJ_SUCCESS)
+	state->discard += PJ_ATOMIC_LOAD_ACQUIRE(&stream->rx_queue->dropped);
+
+    return status;
 }
 
 /*
@@ -2851,8 +3660,12 @@ PJ_DEF(pj_status_t) pjmedia_stream_pause( pjmedia_stream *stream,
     if ((dir & PJMEDIA_DIR_DECODING) && stream->dec) {
 	stream->dec->paused = 1;
 
-	/* Also reset jitter buffer */
+	/* Also reset jitter buffer, and discard the queued packets */
 	pj_mutex_lock( stream->jb_mutex );
+	if (stream->rx_queue) {
+	    PJ_ATOMIC_STORE_RELEASE(&stream->rx_queue->tail,
+			PJ_ATOMIC_LOAD_ACQUIRE(&stream->rx_queue->head));
+	}
 	pjmedia_jbuf_reset(stream->jb);
 	pj_mutex_unlock( stream->jb_mutex );
 
@@ -3072,3 +3885,96 @@ pjmedia_stream_get_rtp_session_info(pjmedia_stream *stream,
     session_info->rtcp = &stream->rtcp;
     return PJ_SUCCESS;
 }
+
+
+/*
+ * Create encoding group.
+ */
+PJ_DEF(pj_status_t)
+pjmedia_stream_enc_group_create(pjmedia_endpt *endpt,
+				pjmedia_stream_enc_group **p_grp)
+{
+    pj_pool_t *pool;
+    pjmedia_stream_enc_group *grp;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt && p_grp, PJ_EINVAL);
+
+    pool = pjmedia_endpt_create_pool(endpt, "encgrp%p", 1000, 1000);
+    PJ_ASSERT_RETURN(pool, PJ_ENOMEM);
+
+    grp = PJ_POOL_ZALLOC_T(pool, pjmedia_stream_enc_group);
+    grp->pool = pool;
+    pj_list_init(&grp->share_list);
+
+    status = pj_mutex_create_simple(pool, "encgrp%p", &grp->mutex);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+
+    *p_grp = grp;
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Destroy encoding group.
+ */
+PJ_DEF(pj_status_t)
+pjmedia_stream_enc_group_destroy(pjmedia_stream_enc_group *grp)
+{
+    struct enc_share *share;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(grp, PJ_EINVAL);
+
+    pj_mutex_lock(grp->mutex);
+
+    for (share=grp->share_list.next; share!=&grp->share_list;
+	 share=share->next)
+    {
+	if (share->member_cnt) {
+	    pj_mutex_unlock(grp->mutex);
+	    return PJ_EBUSY;
+	}
+    }
+
+    for (share=grp->share_list.next; share!=&grp->share_list;
+	 share=share->next)
+    {
+	for (i=0; i<share->lane_cnt; ++i) {
+	    pjmedia_codec_close(share->lane[i].codec);
+	    pjmedia_codec_mgr_dealloc_codec(share->codec_mgr,
+					    share->lane[i].codec);
+	    pj_mutex_destroy(share->lane[i].mutex);
+	}
+	share->lane_cnt = 0;
+    }
+
+    pj_mutex_unlock(grp->mutex);
+    pj_mutex_destroy(grp->mutex);
+    pj_pool_release(grp->pool);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Add the stream to an encoding group.
+ */
+PJ_DEF(pj_status_t)
+pjmedia_stream_set_enc_group(pjmedia_stream *stream,
+			     pjmedia_stream_enc_group *grp)
+{
+    PJ_ASSERT_RETURN(stream, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!grp || (stream->dir & PJMEDIA_DIR_ENCODING),
+		     PJ_EINVALIDOP);
+
+    enc_group_leave(stream);
+    if (grp)
+	enc_group_join(stream, grp);
+
+    return PJ_SUCCESS;
+}
@@ -601,6 +601,7 @@ PJ_DEF(pj_status_t) pjmedia_stream_info_from_sdp(
 
     /* Set default jitter buffer parameter. */
     si->jb_init = si->jb_max = si->jb_min_pre = si->jb_max_pre = -1;
+    si->rx_queue_pkt_cnt = -1;
 
     return status;
 }
@@ -35,6 +35,7 @@ struct user
     void  (*rtp_cb)(	void*,		/**< To report incoming RTP.	    */
 			void*,
 			pj_ssize_t);
+    void  (*rtp_cb2)(pjmedia_tp_cb_param*); /**< To report incoming RTP.    */
     void  (*rtcp_cb)(	void*,		/**< To report incoming RTCP.	    */
 			void*,
 			pj_ssize_t);
@@ -71,6 +72,9 @@ static pj_status_t transport_attach   (pjmedia_transport *tp,
 				       void (*rtcp_cb)(void*,
 						       void*,
 						       pj_ssize_t));
+static pj_status_t transport_attach2  (pjmedia_transport *tp,
+				       pjmedia_transport_attach_param
+				           *att_param);
 static void	   transport_detach   (pjmedia_transport *tp,
 				       void *strm);
 static pj_status_t transport_send_rtp( pjmedia_transport *tp,
@@ -119,7 +123,8 @@ static pjmedia_transport_op transport_udp_op =
     &transport_media_start,
     &transport_media_stop,
     &transport_simulate_lost,
-    &transport_destroy
+    &transport_destroy,
+    &transport_attach2
 };
 
 
@@ -200,8 +205,7 @@ static pj_status_t transport_get_info(pjmedia_transport *tp,
 }
 
 
-/* Called by application to initialize the transport */
-static pj_status_t transport_attach(   pjmedia_transport *tp,
+static pj_status_t tp_attach(   pjmedia_transport *tp,
 				       void *user_data,
 				       const pj_sockaddr_t *rem_addr,
 				       const pj_sockaddr_t *rem_rtcp,
@@ -209,6 +213,7 @@ static pj_status_t transport_attach(   pjmedia_transport *tp,
 				       void (*rtp_cb)(void*,
 						      void*,
 						      pj_ssize_t),
+				       void (*rtp_cb2)(pjmedia_tp_cb_param*),
 				       void (*rtcp_cb)(void*,
 						       void*,
 						       pj_ssize_t))
@@ -235,6 +240,7 @@ static pj_status_t transport_attach(   pjmedia_transport *tp,
 
     /* Save the new user */
     loop->users[loop->user_cnt].rtp_cb = rtp_cb;
+    loop->users[loop->user_cnt].rtp_cb2 = rtp_cb2;
     loop->users[loop->user_cnt].rtcp_cb = rtcp_cb;
     loop->users[loop->user_cnt].user_data = user_data;
     ++loop->user_cnt;
@@ -243,6 +249,36 @@ static pj_status_t transport_attach(   pjmedia_transport *tp,
 }
 
 
+/* Called by application to initialize the transport */
+static pj_status_t transport_attach(   pjmedia_transport *tp,
+				       void *user_data,
+				       const pj_sockaddr_t *rem_addr,
+				       const pj_sockaddr_t *rem_rtcp,
+				       unsigned addr_len,
+				       void (*rtp_cb)(void*,
+						      void*,
+						      pj_ssize_t),
+				       void (*rtcp_cb)(void*,
+						       void*,
+						       pj_ssize_t))
+{
+    return tp_attach(tp, user_data, rem_addr, rem_rtcp, addr_len,
+    		     rtp_cb, NULL, rtcp_cb);
+}
+
+
+static pj_status_t transport_attach2(pjmedia_transport *tp,
+				     pjmedia_transport_attach_param *att_param)
+{
+    return tp_attach(tp, att_param->user_data, 
+    		     (pj_sockaddr_t*)&att_param->rem_addr, 
+		     (pj_sockaddr_t*)&att_param->rem_rtcp, 
+		     att_param->addr_len, att_param->rtp_cb,
+		     att_param->rtp_cb2, 
+		     att_param->rtcp_cb);
+}
+
+
 /* Called by application when it no longer needs the transport */
 static void transport_detach( pjmedia_transport *tp,
 			      void *user_data)
@@ -296,9 +332,21 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
 
     /* Distribute to users */
     for (i=0; i<loop->user_cnt; ++i) {
-	if (!loop->users[i].rx_disabled && loop->users[i].rtp_cb)
+	if (loop->users[i].rx_disabled)
+	    continue;
+
+	if (loop->users[i].rtp_cb2) {
+	    pjmedia_tp_cb_param param;
+
+	    pj_bzero(&param, sizeof(param));
+	    param.user_data = loop->users[i].user_data;
+	    param.pkt = (void*)pkt;
+	    param.size = size;
+	    (*loop->users[i].rtp_cb2)(&param);
+	} else if (loop->users[i].rtp_cb) {
 	    (*loop->users[i].rtp_cb)(loop->users[i].user_data, (void*)pkt, 
 				     size);
+	}
     }
 
     return PJ_SUCCESS;
@@ -71,6 +71,8 @@ struct transport_udp
     unsigned		tx_drop_pct;	/**< Percent of tx pkts to drop.    */
     unsigned		rx_drop_pct;	/**< Percent of rx pkts to drop.    */
     pj_ioqueue_t	*ioqueue;	/**< Ioqueue instance.		    */
+    pjmedia_endpt      *endpt;		/**< Media endpoint.		    */
+    int			shard;		/**< Media shard, or -1.	    */
 
     pj_sock_t	        rtp_sock;	/**< RTP socket			    */
     pj_sockaddr		rtp_addr_name;	/**< Published RTP address.	    */
@@ -292,9 +294,6 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
     /* Sanity check */
     PJ_ASSERT_RETURN(endpt && si && p_tp, PJ_EINVAL);
 
-    /* Get ioqueue instance */
-    ioqueue = pjmedia_endpt_get_ioqueue(endpt);
-
     if (name==NULL)
 	name = "udp%p";
 
@@ -309,6 +308,25 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
     pj_memcpy(tp->base.name, pool->obj_name, PJ_MAX_OBJ_NAME);
     tp->base.op = &transport_udp_op;
     tp->base.type = PJMEDIA_TRANSPORT_TYPE_UDP;
+    tp->endpt = endpt;
+    tp->shard = -1;
+
+    /* Get ioqueue instance, from the media shard with the lowest load
+     * if the endpoint has media shards.
+     */
+    if (pjmedia_endpt_get_shard_count(endpt) > 0) {
+	unsigned shard;
+
+	status = pjmedia_endpt_acquire_shard(endpt, 1, &shard);
+	if (status != PJ_SUCCESS) {
+	    pj_pool_release(pool);
+	    return status;
+	}
+	tp->shard = shard;
+	ioqueue = pjmedia_endpt_get_shard_ioqueue(endpt, shard);
+    } else {
+	ioqueue = pjmedia_endpt_get_ioqueue(endpt);
+    }
 
     /* Copy socket infos */
     tp->rtp_sock = si->rtp_sock;
@@ -445,6 +463,11 @@ static pj_status_t transport_destroy(pjmedia_transport *tp)
 	udp->rtcp_sock = PJ_INVALID_SOCKET;
     }
 
+    if (udp->shard >= 0) {
+	pjmedia_endpt_release_shard(udp->endpt, udp->shard, 1);
+	udp->shard = -1;
+    }
+
     pj_pool_release(udp->pool);
 
     return PJ_SUCCESS;
@@ -0,0 +1,851 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "conf_test.c"
+
+#define CLOCK_RATE	8000
+#define SPF		80
+#define PORT_CNT	12		/* Test ports, in slots 1..PORT_CNT */
+#define MAX_PORTS	(PORT_CNT + 1)	/* Plus the master port	*/
+#define API_THREAD_CNT	3
+#define DURATION	500		/* Stress duration, in msec	*/
+
+/* Resampling test */
+#define RS_RATE		16000		/* Rate of the bridge		    */
+#define RS_SPF		320
+#define RS_PORT_CNT	6
+#define RS_FRAME_CNT	200
+
+/* Self removal state of a test port */
+enum
+{
+    RM_NONE,		/* Not requested			    */
+    RM_REQUESTED,	/* The port removes itself in put_frame()   */
+    RM_PENDING,		/* Waiting for the bridge to release it	    */
+    RM_DONE		/* The bridge has released the port	    */
+};
+
+/* A port returning frames with a constant sample value, and keeping the
+ * first sample of the last frame transmitted to it.
+ */
+typedef struct test_port
+{
+    pjmedia_port	 base;
+    pjmedia_conf	*conf;
+    pj_int16_t		 value;
+    int			 slot;		/* -1 if not in the bridge	    */
+    pj_int16_t		 last;
+    pj_atomic_t		*rm_state;
+} test_port;
+
+typedef struct test_prm
+{
+    pjmedia_conf	*conf;
+    pj_pool_t		*pool;
+    test_port		 ports[PORT_CNT];
+    pj_atomic_t		*frame_cnt;	/* Frames mixed by the clock	    */
+    pj_atomic_t		*err_cnt;	/* Failures in the threads	    */
+    pj_atomic_t		*quit_clock;
+    pj_atomic_t		*quit_api;
+} test_prm;
+
+typedef struct api_thread_prm
+{
+    test_prm		*prm;
+    unsigned		 idx;		/* Owns the ports idx, idx+N, ...   */
+} api_thread_prm;
+
+/* A port returning a deterministic signal, and recording the frames
+ * transmitted to it.
+ */
+typedef struct sig_port
+{
+    pjmedia_port	 base;
+    unsigned		 idx;		/* Selects the signal		    */
+    unsigned		 frame_cnt;	/* Frames returned so far	    */
+    pj_uint32_t		 seed;		/* Of the noise signal		    */
+    pj_int16_t		*rec;		/* Recorded frames		    */
+    unsigned		 rec_cnt;	/* Samples recorded		    */
+    unsigned		 rec_cap;
+} sig_port;
+
+
+static pj_status_t tp_get_frame(pjmedia_port *this_port,
+				pjmedia_frame *frame)
+{
+    test_port *tp = (test_port*) this_port;
+    pj_int16_t *samples = (pj_int16_t*) frame->buf;
+    unsigned i;
+
+    for (i=0; i<SPF; ++i)
+	samples[i] = tp->value;
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame->size = SPF * 2;
+
+    return PJ_SUCCESS;
+}
+
+/* The bridge has released the port */
+static void tp_removed(pjmedia_conf *conf, unsigned slot, void *user_data)
+{
+    test_port *tp = (test_port*) user_data;
+
+    PJ_UNUSED_ARG(conf);
+    PJ_UNUSED_ARG(slot);
+
+    if (pj_atomic_get(tp->rm_state) != RM_PENDING) {
+	test_prm *prm = (test_prm*) tp->base.port_data.pdata;
+	pj_atomic_inc(prm->err_cnt);
+    }
+    pj_atomic_set(tp->rm_state, RM_DONE);
+}
+
+/* Remove the port, without waiting for the bridge */
+static pj_status_t tp_remove(test_port *tp)
+{
+    pj_status_t status;
+
+    pj_atomic_set(tp->rm_state, RM_PENDING);
+    status = pjmedia_conf_remove_port2(tp->conf, tp->slot, tp, &tp_removed);
+    if (status == PJ_EPENDING)
+	status = PJ_SUCCESS;
+    else if (status != PJ_SUCCESS)
+	pj_atomic_set(tp->rm_state, RM_NONE);
+
+    return status;
+}
+
+static pj_status_t tp_put_frame(pjmedia_port *this_port,
+				pjmedia_frame *frame)
+{
+    test_port *tp = (test_port*) this_port;
+    test_prm *prm = (test_prm*) this_port->port_data.pdata;
+
+    if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO && frame->size)
+	tp->last = ((const pj_int16_t*)frame->buf)[0];
+    else
+	tp->last = 0;
+
+    /* Remove this port from the clock thread or a mixing worker, the
+     * removal is completed at the end of the frame.
+     */
+    if (pj_atomic_get(tp->rm_state) == RM_REQUESTED) {
+	if (tp_remove(tp) != PJ_SUCCESS)
+	    pj_atomic_inc(prm->err_cnt);
+    }
+
+    return PJ_SUCCESS;
+}
+
+/* Clock thread, mixing as fast as it can */
+static int clock_thread(void *arg)
+{
+    test_prm *prm = (test_prm*) arg;
+    pjmedia_port *master = pjmedia_conf_get_master_port(prm->conf);
+    pj_int16_t buf[SPF];
+    pjmedia_frame frame;
+    pj_timestamp ts;
+
+    ts.u64 = 0;
+    while (!pj_atomic_get(prm->quit_clock)) {
+	pj_bzero(&frame, sizeof(frame));
+	frame.buf = buf;
+	frame.size = sizeof(buf);
+	frame.timestamp = ts;
+
+	if (pjmedia_port_get_frame(master, &frame) != PJ_SUCCESS)
+	    pj_atomic_inc(prm->err_cnt);
+
+	ts.u64 += SPF;
+	pj_atomic_inc(prm->frame_cnt);
+    }
+
+    return 0;
+}
+
+/* Add, remove, connect and configure ports while the bridge is mixing */
+static int api_thread(void *arg)
+{
+    api_thread_prm *tprm = (api_thread_prm*) arg;
+    test_prm *prm = tprm->prm;
+    pjmedia_conf *conf = prm->conf;
+
+    while (!pj_atomic_get(prm->quit_api)) {
+	static const pjmedia_port_op ops[] =
+	{
+	    PJMEDIA_PORT_NO_CHANGE, PJMEDIA_PORT_ENABLE,
+	    PJMEDIA_PORT_DISABLE, PJMEDIA_PORT_MUTE
+	};
+	unsigned src = 1 + pj_rand() % PORT_CNT;
+	unsigned sink = 1 + pj_rand() % PORT_CNT;
+	unsigned r = pj_rand() % 100;
+
+	/* The slots may be changed by the other threads at any time, so
+	 * only the operations on its own ports must succeed.
+	 */
+	if (r < 30) {
+	    if (src != sink)
+		pjmedia_conf_connect_port(conf, src, sink, 0);
+	} else if (r < 50) {
+	    pjmedia_conf_disconnect_port(conf, src, sink);
+	} else if (r < 65) {
+	    pjmedia_conf_configure_port(conf, src, ops[pj_rand() % 4],
+					ops[pj_rand() % 4]);
+	} else if (r < 80) {
+	    int level = (int)(pj_rand() % 129) - 64;
+
+	    if (r & 1)
+		pjmedia_conf_adjust_rx_level(conf, src, level);
+	    else
+		pjmedia_conf_adjust_tx_level(conf, src, level);
+	} else {
+	    unsigned idx = tprm->idx + API_THREAD_CNT *
+			   (pj_rand() % (PORT_CNT / API_THREAD_CNT));
+	    test_port *tp = &prm->ports[idx];
+	    pj_status_t status = PJ_SUCCESS;
+
+	    if (tp->slot < 0) {
+		unsigned slot;
+
+		status = pjmedia_conf_add_port(conf, prm->pool, &tp->base,
+					       NULL, &slot);
+		if (status == PJ_SUCCESS)
+		    tp->slot = slot;
+	    } else if (pj_atomic_get(tp->rm_state) == RM_DONE) {
+		tp->slot = -1;
+		pj_atomic_set(tp->rm_state, RM_NONE);
+	    } else if (pj_atomic_get(tp->rm_state) == RM_NONE) {
+		if (r & 1) {
+		    pj_atomic_set(tp->rm_state, RM_REQUESTED);
+		} else {
+		    status = tp_remove(tp);
+		}
+	    }
+
+	    if (status != PJ_SUCCESS)
+		pj_atomic_inc(prm->err_cnt);
+	}
+    }
+
+    return 0;
+}
+
+/* Wait until the clock thread has mixed some frames. Everything done by
+ * the clock thread in these frames is visible after this returns.
+ */
+static int wait_frames(test_prm *prm, unsigned cnt)
+{
+    pj_atomic_value_t start = pj_atomic_get(prm->frame_cnt);
+    unsigned msec;
+
+    for (msec=0; pj_atomic_get(prm->frame_cnt) - start < (int)cnt; ++msec) {
+	if (msec == 2000)
+	    return -1;
+	pj_thread_sleep(1);
+    }
+    return 0;
+}
+
+/* Check the bridge against the ports, with the API threads stopped */
+static int check_bridge(test_prm *prm, pj_bool_t check_mix)
+{
+    pjmedia_conf *conf = prm->conf;
+    pj_int32_t expected[MAX_PORTS];
+    unsigned transmitter_cnt[MAX_PORTS];
+    unsigned i, j, port_cnt = 1;
+
+    /* Let the pending self removals complete with everything enabled */
+    for (i=0; i<PORT_CNT; ++i) {
+	test_port *tp = &prm->ports[i];
+
+	if (tp->slot < 0)
+	    continue;
+
+	/* The port may be removing itself meanwhile */
+	if ((pjmedia_conf_configure_port(conf, tp->slot, PJMEDIA_PORT_ENABLE,
+					 PJMEDIA_PORT_ENABLE) != PJ_SUCCESS ||
+	     pjmedia_conf_adjust_rx_level(conf, tp->slot, 0) != PJ_SUCCESS ||
+	     pjmedia_conf_adjust_tx_level(conf, tp->slot, 0) != PJ_SUCCESS) &&
+	    pj_atomic_get(tp->rm_state) == RM_NONE)
+	{
+	    return -10;
+	}
+    }
+
+    if (wait_frames(prm, 3) != 0)
+	return -20;
+
+    for (i=0; i<PORT_CNT; ++i) {
+	test_port *tp = &prm->ports[i];
+
+	if (pj_atomic_get(tp->rm_state) == RM_REQUESTED ||
+	    pj_atomic_get(tp->rm_state) == RM_PENDING)
+	{
+	    return -30;
+	}
+	if (pj_atomic_get(tp->rm_state) == RM_DONE) {
+	    tp->slot = -1;
+	    pj_atomic_set(tp->rm_state, RM_NONE);
+	}
+    }
+
+    if (wait_frames(prm, 3) != 0)
+	return -40;
+
+    pj_bzero(expected, sizeof(expected));
+    pj_bzero(transmitter_cnt, sizeof(transmitter_cnt));
+
+    for (i=0; i<PORT_CNT; ++i) {
+	test_port *tp = &prm->ports[i];
+	pjmedia_conf_port_info info;
+
+	if (tp->slot < 0)
+	    continue;
+
+	++port_cnt;
+	if (pjmedia_conf_get_port_info(conf, tp->slot, &info) != PJ_SUCCESS)
+	    return -50;
+	if (info.tx_setting != PJMEDIA_PORT_ENABLE ||
+	    info.rx_setting != PJMEDIA_PORT_ENABLE ||
+	    info.tx_adj_level != 0 || info.rx_adj_level != 0)
+	{
+	    return -60;
+	}
+
+	for (j=0; j<info.listener_cnt; ++j) {
+	    unsigned sink = info.listener_slots[j];
+
+	    if (sink == 0 || sink >= MAX_PORTS)
+		return -70;
+	    expected[sink] += tp->value;
+	    ++transmitter_cnt[sink];
+	}
+    }
+
+    if (pjmedia_conf_get_port_count(conf) != port_cnt)
+	return -80;
+
+    for (i=0; i<PORT_CNT; ++i) {
+	test_port *tp = &prm->ports[i];
+	pjmedia_conf_port_info info;
+
+	if (tp->slot < 0)
+	    continue;
+
+	pjmedia_conf_get_port_info(conf, tp->slot, &info);
+	if (info.transmitter_cnt != transmitter_cnt[tp->slot])
+	    return -90;
+
+	if (check_mix && tp->last != expected[tp->slot]) {
+	    PJ_LOG(3,(THIS_FILE, "  slot %d received %d, expecting %d",
+		      tp->slot, tp->last, expected[tp->slot]));
+	    return -100;
+	}
+    }
+
+    return 0;
+}
+
+/* With the clock stopped, the removals complete before returning */
+static int remove_test(test_prm *prm)
+{
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, "  removal without clock"));
+
+    for (i=0; i<PORT_CNT; ++i) {
+	test_port *tp = &prm->ports[i];
+	pj_status_t status;
+
+	if (tp->slot < 0)
+	    continue;
+
+	pj_atomic_set(tp->rm_state, RM_PENDING);
+	status = pjmedia_conf_remove_port2(prm->conf, tp->slot, tp,
+					   &tp_removed);
+	if (status != PJ_SUCCESS)
+	    return -340;
+	if (pj_atomic_get(tp->rm_state) != RM_DONE)
+	    return -350;
+
+	tp->slot = -1;
+	pj_atomic_set(tp->rm_state, RM_NONE);
+    }
+
+    if (pjmedia_conf_get_port_count(prm->conf) != 1 ||
+	pj_atomic_get(prm->err_cnt) != 0)
+    {
+	return -360;
+    }
+
+    return 0;
+}
+
+static int stress_test(test_prm *prm, unsigned thread_cnt, unsigned spk_max)
+{
+    pj_thread_t *threads[API_THREAD_CNT];
+    api_thread_prm tprm[API_THREAD_CNT];
+    pj_status_t status;
+    unsigned i;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "  stress: %u mixing threads, %u active speakers",
+	      thread_cnt, spk_max));
+
+    status = pjmedia_conf_set_mix_threads(prm->conf, thread_cnt);
+    if (status == PJ_ENOTSUP) {
+	PJ_LOG(3,(THIS_FILE, "  mixing threads not supported, skipped"));
+	return 0;
+    }
+    if (status != PJ_SUCCESS)
+	return -200;
+    if (pjmedia_conf_set_active_speakers(prm->conf, spk_max) != PJ_SUCCESS)
+	return -210;
+
+    pj_atomic_set(prm->quit_api, 0);
+    for (i=0; i<API_THREAD_CNT; ++i) {
+	tprm[i].prm = prm;
+	tprm[i].idx = i;
+	status = pj_thread_create(prm->pool, "confapi", &api_thread, &tprm[i],
+				  0, 0, &threads[i]);
+	if (status != PJ_SUCCESS) {
+	    pj_atomic_set(prm->quit_api, 1);
+	    while (i--) {
+		pj_thread_join(threads[i]);
+		pj_thread_destroy(threads[i]);
+	    }
+	    return -220;
+	}
+    }
+
+    pj_thread_sleep(DURATION);
+
+    pj_atomic_set(prm->quit_api, 1);
+    for (i=0; i<API_THREAD_CNT; ++i) {
+	pj_thread_join(threads[i]);
+	pj_thread_destroy(threads[i]);
+    }
+
+    if (pj_atomic_get(prm->err_cnt) != 0)
+	return -230;
+
+    /* The active speakers mix differs from the sum of the transmitters */
+    rc = check_bridge(prm, spk_max == 0);
+    if (rc != 0)
+	return rc - 200;
+
+    if (pj_atomic_get(prm->err_cnt) != 0)
+	return -240;
+
+    return 0;
+}
+
+static pj_status_t sp_get_frame(pjmedia_port *this_port,
+				pjmedia_frame *frame)
+{
+    sig_port *sp = (sig_port*) this_port;
+    pj_int16_t *samples = (pj_int16_t*) frame->buf;
+    unsigned i, count = PJMEDIA_PIA_SPF(&this_port->info);
+    unsigned period = 8 + sp->idx * 5;
+    int amp;
+
+    /* Triangle waves, with each port getting loud on its own turns, so
+     * that the active speakers keep changing.
+     */
+    amp = ((sp->frame_cnt / (5 + sp->idx * 2)) % 3 == 0) ? 12000 : 600;
+
+    for (i=0; i<count; ++i) {
+	unsigned ph = (sp->frame_cnt * count + i) % period;
+	int tri = (ph < period/2) ? (int)ph : (int)(period - ph);
+
+	samples[i] = (pj_int16_t)(amp * (4 * tri - (int)period) /
+				  (int)period);
+    }
+    ++sp->frame_cnt;
+
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame->size = count * 2;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t sp_get_noise(pjmedia_port *this_port,
+				pjmedia_frame *frame)
+{
+    sig_port *sp = (sig_port*) this_port;
+    pj_int16_t *samples = (pj_int16_t*) frame->buf;
+    unsigned i, count = PJMEDIA_PIA_SPF(&this_port->info);
+
+    for (i=0; i<count; ++i) {
+	sp->seed = sp->seed * 1103515245 + 12345;
+	samples[i] = (pj_int16_t)(sp->seed >> 16);
+    }
+
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame->size = count * 2;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t sp_put_frame(pjmedia_port *this_port,
+				pjmedia_frame *frame)
+{
+    sig_port *sp = (sig_port*) this_port;
+    unsigned count = PJMEDIA_PIA_SPF(&this_port->info);
+
+    if (sp->rec_cnt + count > sp->rec_cap)
+	return PJ_SUCCESS;
+
+    if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO && frame->size)
+	pjmedia_copy_samples(sp->rec + sp->rec_cnt,
+			     (const pj_int16_t*)frame->buf, count);
+    else
+	pjmedia_zero_samples(sp->rec + sp->rec_cnt, count);
+    sp->rec_cnt += count;
+
+    return PJ_SUCCESS;
+}
+
+static void sig_port_init(pj_pool_t *pool, sig_port *sp, unsigned idx,
+			  unsigned clock_rate, unsigned channel_count,
+			  unsigned frame_cnt)
+{
+    static const pj_str_t name = { "sig", 3 };
+    unsigned spf = clock_rate * 20 / 1000 * channel_count;
+
+    pj_bzero(sp, sizeof(*sp));
+    pjmedia_port_info_init(&sp->base.info, &name,
+			   PJMEDIA_SIG_CLASS_PORT_AUD('S','P'),
+			   clock_rate, channel_count, 16, spf);
+    sp->base.get_frame = &sp_get_frame;
+    sp->base.put_frame = &sp_put_frame;
+    sp->idx = idx;
+    sp->seed = idx;
+    sp->rec_cap = spf * frame_cnt;
+    sp->rec = (pj_int16_t*) pj_pool_zalloc(pool, sp->rec_cap * 2);
+}
+
+/* Run the bridge with active speakers, where the 8KHz listeners switch
+ * between the shared resampled mix and their own resampler, and record
+ * what they receive.
+ */
+static int run_resample(pj_pool_t *pool, unsigned thread_cnt,
+			sig_port ports[RS_PORT_CNT])
+{
+    pjmedia_conf *conf;
+    pjmedia_port *master;
+    pj_int16_t buf[RS_SPF];
+    unsigned slots[RS_PORT_CNT];
+    unsigned i, j;
+    pj_status_t status;
+    int rc = 0;
+
+    status = pjmedia_conf_create(pool, RS_PORT_CNT + 1, RS_RATE, 1, RS_SPF,
+				 16, PJMEDIA_CONF_NO_DEVICE, &conf);
+    if (status != PJ_SUCCESS)
+	return -400;
+
+    /* Two 16KHz ports, then 8KHz ports, one of them with another level */
+    for (i=0; i<RS_PORT_CNT; ++i) {
+	sig_port_init(pool, &ports[i], i, i < 2 ? RS_RATE : 8000, 1,
+		      RS_FRAME_CNT);
+	status = pjmedia_conf_add_port(conf, pool, &ports[i].base, NULL,
+				       &slots[i]);
+	if (status != PJ_SUCCESS) {
+	    rc = -410;
+	    goto on_return;
+	}
+    }
+    pjmedia_conf_adjust_tx_level(conf, slots[RS_PORT_CNT-1], 20);
+
+    for (i=0; i<RS_PORT_CNT; ++i) {
+	for (j=0; j<RS_PORT_CNT; ++j) {
+	    if (i != j)
+		pjmedia_conf_connect_port(conf, slots[i], slots[j], 0);
+	}
+    }
+
+    status = pjmedia_conf_set_mix_threads(conf, thread_cnt);
+    if (status != PJ_SUCCESS) {
+	rc = (status == PJ_ENOTSUP) ? PJ_ENOTSUP : -420;
+	goto on_return;
+    }
+    if (pjmedia_conf_set_active_speakers(conf, 2) != PJ_SUCCESS) {
+	rc = -425;
+	goto on_return;
+    }
+
+    master = pjmedia_conf_get_master_port(conf);
+    for (i=0; i<RS_FRAME_CNT; ++i) {
+	pjmedia_frame frame;
+
+	pj_bzero(&frame, sizeof(frame));
+	frame.buf = buf;
+	frame.size = sizeof(buf);
+	frame.timestamp.u64 = i * RS_SPF;
+	if (pjmedia_port_get_frame(master, &frame) != PJ_SUCCESS) {
+	    rc = -430;
+	    goto on_return;
+	}
+    }
+
+on_return:
+    pjmedia_conf_destroy(conf);
+    return rc;
+}
+
+/* Sharing the resampled mix of the active speakers must give the same
+ * signal as resampling it for each listener.
+ */
+static int resample_test(void)
+{
+    sig_port *shared, *own;
+    pj_pool_t *pool;
+    unsigned i;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "  shared resampling of the active speakers"));
+
+    pool = pj_pool_create(mem, "confrs", 4000, 4000, NULL);
+    shared = (sig_port*) pj_pool_zalloc(pool, RS_PORT_CNT * sizeof(sig_port));
+    own = (sig_port*) pj_pool_zalloc(pool, RS_PORT_CNT * sizeof(sig_port));
+
+    /* The resampled mix is not shared with worker threads */
+    rc = run_resample(pool, 0, shared);
+    if (rc == 0) {
+	rc = run_resample(pool, 1, own);
+	if (rc == PJ_ENOTSUP) {
+	    PJ_LOG(3,(THIS_FILE, "  mixing threads not supported, skipped"));
+	    rc = 0;
+	    goto on_return;
+	}
+    }
+
+    for (i=2; i<RS_PORT_CNT && rc==0; ++i) {
+	if (shared[i].rec_cnt != own[i].rec_cnt || shared[i].rec_cnt == 0 ||
+	    pj_memcmp(shared[i].rec, own[i].rec, shared[i].rec_cnt * 2) != 0)
+	{
+	    PJ_LOG(3,(THIS_FILE, "  8KHz listener %u has discontinuity", i));
+	    rc = -440;
+	}
+    }
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+/* Mix at 16KHz stereo with port zero at 8KHz mono, the stereo ports at
+ * 16KHz must get the signal as it is.
+ */
+static int mix_format_test(void)
+{
+    pjmedia_conf_param param;
+    pjmedia_conf *conf;
+    pjmedia_port *master;
+    sig_port *src, *dst;
+    pj_int16_t buf[160];
+    unsigned src_slot, dst_slot, i;
+    pj_pool_t *pool;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  mixing at 16KHz stereo, port zero 8KHz mono"));
+
+    pool = pj_pool_create(mem, "conffmt", 4000, 4000, NULL);
+
+    pjmedia_conf_param_default(&param);
+    param.max_slots = 4;
+    param.sampling_rate = 8000;
+    param.channel_count = 1;
+    param.samples_per_frame = 160;
+    param.options = PJMEDIA_CONF_NO_DEVICE;
+    param.mix_clock_rate = 16000;
+    param.mix_channel_count = 2;
+
+    status = pjmedia_conf_create2(pool, &param, &conf);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return -500;
+    }
+
+    master = pjmedia_conf_get_master_port(conf);
+    if (PJMEDIA_PIA_SRATE(&master->info) != 8000 ||
+	PJMEDIA_PIA_CCNT(&master->info) != 1 ||
+	PJMEDIA_PIA_SPF(&master->info) != 160)
+    {
+	rc = -510;
+	goto on_return;
+    }
+
+    src = PJ_POOL_ZALLOC_T(pool, sig_port);
+    dst = PJ_POOL_ZALLOC_T(pool, sig_port);
+    sig_port_init(pool, src, 1, 16000, 2, 50);
+    sig_port_init(pool, dst, 2, 16000, 2, 50);
+    src->base.get_frame = &sp_get_noise;
+
+    if (pjmedia_conf_add_port(conf, pool, &src->base, NULL,
+			      &src_slot) != PJ_SUCCESS ||
+	pjmedia_conf_add_port(conf, pool, &dst->base, NULL,
+			      &dst_slot) != PJ_SUCCESS ||
+	pjmedia_conf_connect_port(conf, src_slot, dst_slot, 0) != PJ_SUCCESS ||
+	pjmedia_conf_connect_port(conf, src_slot, 0, 0) != PJ_SUCCESS ||
+	pjmedia_conf_connect_port(conf, 0, dst_slot, 0) != PJ_SUCCESS)
+    {
+	rc = -520;
+	goto on_return;
+    }
+
+    for (i=0; i<50; ++i) {
+	pjmedia_frame frame;
+
+	/* What port zero receives, so it's mixed to dst too */
+	pj_bzero(buf, sizeof(buf));
+	pj_bzero(&frame, sizeof(frame));
+	frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+	frame.buf = buf;
+	frame.size = sizeof(buf);
+	frame.timestamp.u64 = i * 160;
+	if (pjmedia_port_put_frame(master, &frame) != PJ_SUCCESS) {
+	    rc = -530;
+	    goto on_return;
+	}
+
+	frame.size = sizeof(buf);
+	if (pjmedia_port_get_frame(master, &frame) != PJ_SUCCESS ||
+	    frame.size != sizeof(buf))
+	{
+	    rc = -540;
+	    goto on_return;
+	}
+	if (i > 5 && frame.type != PJMEDIA_FRAME_TYPE_AUDIO) {
+	    rc = -550;
+	    goto on_return;
+	}
+    }
+
+    /* Silence from port zero doesn't change the mix */
+    src->seed = 1;
+    for (i=0; i<dst->rec_cnt; ++i) {
+	src->seed = src->seed * 1103515245 + 12345;
+	if (dst->rec[i] != (pj_int16_t)(src->seed >> 16)) {
+	    PJ_LOG(3,(THIS_FILE, "  sample %u differs", i));
+	    rc = -560;
+	    break;
+	}
+    }
+    if (dst->rec_cnt == 0)
+	rc = -570;
+
+on_return:
+    pjmedia_conf_destroy(conf);
+    pj_pool_release(pool);
+    return rc;
+}
+
+static int stress_main(void)
+{
+    static const pj_str_t name = { "test", 4 };
+    test_prm *prm;
+    pj_pool_t *pool;
+    pj_thread_t *clock = NULL;
+    pj_status_t status;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "conftest", 4000, 4000, NULL);
+    prm = PJ_POOL_ZALLOC_T(pool, test_prm);
+    prm->pool = pool;
+
+    status = pjmedia_conf_create(pool, MAX_PORTS, CLOCK_RATE, 1, SPF, 16,
+				 PJMEDIA_CONF_NO_DEVICE, &prm->conf);
+    if (status != PJ_SUCCESS) {
+	app_perror(status, "Error creating conference bridge");
+	pj_pool_release(pool);
+	return -300;
+    }
+
+    if (pj_atomic_create(pool, 0, &prm->frame_cnt) != PJ_SUCCESS ||
+	pj_atomic_create(pool, 0, &prm->err_cnt) != PJ_SUCCESS ||
+	pj_atomic_create(pool, 0, &prm->quit_clock) != PJ_SUCCESS ||
+	pj_atomic_create(pool, 0, &prm->quit_api) != PJ_SUCCESS)
+    {
+	rc = -310;
+	goto on_return;
+    }
+
+    for (i=0; i<PORT_CNT; ++i) {
+	test_port *tp = &prm->ports[i];
+
+	pjmedia_port_info_init(&tp->base.info, &name,
+			       PJMEDIA_SIG_CLASS_PORT_AUD('T','P'),
+			       CLOCK_RATE, 1, 16, SPF);
+	tp->base.port_data.pdata = prm;
+	tp->base.get_frame = &tp_get_frame;
+	tp->base.put_frame = &tp_put_frame;
+	tp->conf = prm->conf;
+	tp->value = (pj_int16_t)(i + 1);
+	tp->slot = -1;
+	if (pj_atomic_create(pool, RM_NONE, &tp->rm_state) != PJ_SUCCESS) {
+	    rc = -320;
+	    goto on_return;
+	}
+    }
+
+    status = pj_thread_create(pool, "confclock", &clock_thread, prm, 0, 0,
+			      &clock);
+    if (status != PJ_SUCCESS) {
+	rc = -330;
+	goto on_return;
+    }
+
+    rc = stress_test(prm, 0, 0);
+    if (rc == 0)
+	rc = stress_test(prm, 2, 0);
+    if (rc == 0)
+	rc = stress_test(prm, 2, 3);
+    if (rc == 0)
+	rc = stress_test(prm, 0, 0);
+
+on_return:
+    if (clock) {
+	pj_atomic_set(prm->quit_clock, 1);
+	pj_thread_join(clock);
+	pj_thread_destroy(clock);
+    }
+    if (rc == 0)
+	rc = remove_test(prm);
+    pjmedia_conf_destroy(prm->conf);
+    pj_pool_release(pool);
+
+    return rc;
+}
+
+int conf_test(void)
+{
+    int rc;
+
+    rc = stress_main();
+    if (rc == 0)
+	rc = resample_test();
+    if (rc == 0)
+	rc = mix_format_test();
+
+    return rc;
+}
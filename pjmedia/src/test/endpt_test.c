@@ -0,0 +1,331 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "endpt_test.c"
+
+#define SHARD_CNT   3
+#define PTIME	    10
+#define RTP_PORT    46000
+
+/* Tick callback state */
+typedef struct tick_data
+{
+    pjmedia_endpt   *endpt;
+    unsigned	     shard;
+    unsigned	     cnt;
+    unsigned	     remove_at;
+    pj_bool_t	     bad_thread;
+} tick_data;
+
+/* RTP receiver state */
+typedef struct rx_data
+{
+    pjmedia_endpt   *endpt;
+    unsigned	     cnt;
+    pj_bool_t	     bad_thread;
+} rx_data;
+
+
+static void on_tick(const pj_timestamp *ts, void *user_data)
+{
+    tick_data *td = (tick_data*) user_data;
+
+    PJ_UNUSED_ARG(ts);
+
+    if (pj_thread_this() !=
+	pjmedia_endpt_get_shard_thread(td->endpt, td->shard))
+    {
+	td->bad_thread = PJ_TRUE;
+    }
+
+    if (++td->cnt == td->remove_at)
+	pjmedia_endpt_remove_shard_tick(td->endpt, td->shard, &on_tick, td);
+}
+
+static void on_rx_rtp(void *user_data, void *pkt, pj_ssize_t size)
+{
+    rx_data *rd = (rx_data*) user_data;
+    unsigned i;
+
+    PJ_UNUSED_ARG(pkt);
+
+    if (size <= 0)
+	return;
+
+    /* Must be called by one of the shard threads */
+    for (i=0; i<SHARD_CNT; ++i) {
+	if (pj_thread_this() == pjmedia_endpt_get_shard_thread(rd->endpt, i))
+	    break;
+    }
+    if (i == SHARD_CNT)
+	rd->bad_thread = PJ_TRUE;
+
+    ++rd->cnt;
+}
+
+static void on_rx_rtcp(void *user_data, void *pkt, pj_ssize_t size)
+{
+    PJ_UNUSED_ARG(user_data);
+    PJ_UNUSED_ARG(pkt);
+    PJ_UNUSED_ARG(size);
+}
+
+/* Assigning objects to the shard with the lowest load */
+static int load_test(pjmedia_endpt *endpt)
+{
+    pjmedia_endpt_shard_stat stat;
+    unsigned i, shard;
+
+    for (i=0; i<SHARD_CNT*2; ++i) {
+	if (pjmedia_endpt_acquire_shard(endpt, 1, &shard) != PJ_SUCCESS)
+	    return -110;
+	if (shard != i % SHARD_CNT)
+	    return -120;
+    }
+
+    /* Shard 1 becomes the least loaded */
+    pjmedia_endpt_release_shard(endpt, 1, 1);
+    pjmedia_endpt_get_shard_stat(endpt, 1, &stat);
+    if (stat.obj_cnt != 1 || stat.load != 1)
+	return -130;
+
+    pjmedia_endpt_acquire_shard(endpt, 5, &shard);
+    if (shard != 1)
+	return -140;
+    pjmedia_endpt_acquire_shard(endpt, 1, &shard);
+    if (shard != 0)
+	return -150;
+
+    /* Release everything */
+    pjmedia_endpt_release_shard(endpt, 0, 1);
+    pjmedia_endpt_release_shard(endpt, 0, 1);
+    pjmedia_endpt_release_shard(endpt, 0, 1);
+    pjmedia_endpt_release_shard(endpt, 1, 1);
+    pjmedia_endpt_release_shard(endpt, 1, 5);
+    pjmedia_endpt_release_shard(endpt, 2, 1);
+    pjmedia_endpt_release_shard(endpt, 2, 1);
+
+    for (i=0; i<SHARD_CNT; ++i) {
+	pjmedia_endpt_get_shard_stat(endpt, i, &stat);
+	if (stat.obj_cnt != 0 || stat.load != 0)
+	    return -160;
+    }
+
+    return 0;
+}
+
+/* Clock ticks on the shard thread */
+static int tick_test(pjmedia_endpt *endpt)
+{
+    pjmedia_endpt_shard_stat stat;
+    tick_data td1, td2;
+    unsigned i, cnt;
+
+    pj_bzero(&td1, sizeof(td1));
+    td1.endpt = endpt;
+    td1.shard = 2;
+    td2 = td1;
+    td2.remove_at = 3;
+
+    if (pjmedia_endpt_add_shard_tick(endpt, 2, &on_tick, &td1) != PJ_SUCCESS)
+	return -210;
+    if (pjmedia_endpt_add_shard_tick(endpt, 2, &on_tick, &td2) != PJ_SUCCESS)
+	return -220;
+
+    /* The statistics are read consistently while the shard is ticking */
+    for (i=0; i<20; ++i) {
+	pj_thread_sleep(PTIME);
+	pjmedia_endpt_get_shard_stat(endpt, 2, &stat);
+	if (stat.tick_usec.n != (int)stat.tick_cnt)
+	    return -225;
+    }
+
+    if (pjmedia_endpt_remove_shard_tick(endpt, 2, &on_tick, &td1) !=
+	PJ_SUCCESS)
+    {
+	return -230;
+    }
+
+    /* The second callback has removed itself */
+    if (pjmedia_endpt_remove_shard_tick(endpt, 2, &on_tick, &td2) !=
+	PJ_ENOTFOUND)
+    {
+	return -240;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "    %d ticks in %d ms", td1.cnt, PTIME * 20));
+
+    if (td1.cnt < 5 || td1.cnt > 25 || td2.cnt != 3)
+	return -250;
+    if (td1.bad_thread || td2.bad_thread)
+	return -260;
+
+    /* No more ticks */
+    cnt = td1.cnt;
+    pj_thread_sleep(PTIME * 3);
+    if (td1.cnt != cnt)
+	return -270;
+
+    pjmedia_endpt_get_shard_stat(endpt, 2, &stat);
+    if (stat.tick_cnt != cnt)
+	return -280;
+
+    return 0;
+}
+
+/* UDP transports are spread across the shards and receive packets on
+ * the shard threads.
+ */
+static int transport_test(pjmedia_endpt *endpt, pj_pool_t *pool)
+{
+    pj_str_t addr = pj_str("127.0.0.1");
+    pjmedia_transport *tp[SHARD_CNT+1];
+    pjmedia_transport_info info;
+    pjmedia_endpt_shard_stat stat;
+    rx_data rd;
+    char pkt[32];
+    unsigned i;
+    int rc = 0;
+
+    pj_bzero(tp, sizeof(tp));
+    pj_bzero(&rd, sizeof(rd));
+    pj_bzero(pkt, sizeof(pkt));
+    rd.endpt = endpt;
+
+    for (i=0; i<PJ_ARRAY_SIZE(tp); ++i) {
+	pj_status_t status;
+
+	status = pjmedia_transport_udp_create3(endpt, pj_AF_INET(), NULL,
+					       &addr, RTP_PORT + i*2, 0,
+					       &tp[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror(status, "Error creating UDP transport");
+	    rc = -310;
+	    goto on_return;
+	}
+    }
+
+    /* One transport on each shard, the last goes to the first shard */
+    for (i=0; i<SHARD_CNT; ++i) {
+	pjmedia_endpt_get_shard_stat(endpt, i, &stat);
+	if (stat.obj_cnt != (i==0 ? 2u : 1u)) {
+	    rc = -320;
+	    goto on_return;
+	}
+    }
+
+    /* Send from the first transport to the others */
+    for (i=1; i<PJ_ARRAY_SIZE(tp); ++i) {
+	pjmedia_transport_info_init(&info);
+	pjmedia_transport_get_info(tp[i], &info);
+
+	pjmedia_transport_attach(tp[i], &rd, &info.sock_info.rtp_addr_name,
+				 &info.sock_info.rtcp_addr_name,
+				 sizeof(pj_sockaddr_in), &on_rx_rtp,
+				 &on_rx_rtcp);
+	pjmedia_transport_media_start(tp[i], pool, NULL, NULL, 0);
+
+	pjmedia_transport_attach(tp[0], &rd, &info.sock_info.rtp_addr_name,
+				 &info.sock_info.rtcp_addr_name,
+				 sizeof(pj_sockaddr_in), &on_rx_rtp,
+				 &on_rx_rtcp);
+	pjmedia_transport_send_rtp(tp[0], pkt, sizeof(pkt));
+	pjmedia_transport_detach(tp[0], &rd);
+    }
+
+    for (i=0; i<50 && rd.cnt < SHARD_CNT; ++i)
+	pj_thread_sleep(10);
+
+    if (rd.cnt != SHARD_CNT) {
+	rc = -330;
+	goto on_return;
+    }
+    if (rd.bad_thread) {
+	rc = -340;
+	goto on_return;
+    }
+
+on_return:
+    for (i=0; i<PJ_ARRAY_SIZE(tp); ++i) {
+	if (tp[i]) {
+	    pjmedia_transport_detach(tp[i], &rd);
+	    pjmedia_transport_close(tp[i]);
+	}
+    }
+
+    /* The transports are released from the shards */
+    for (i=0; rc==0 && i<SHARD_CNT; ++i) {
+	pjmedia_endpt_get_shard_stat(endpt, i, &stat);
+	if (stat.obj_cnt != 0)
+	    rc = -350;
+    }
+
+    return rc;
+}
+
+int endpt_test(void)
+{
+    pjmedia_endpt *endpt;
+    pjmedia_endpt_shard_param param;
+    pj_pool_t *pool;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "  media shard test"));
+
+    if (pjmedia_endpt_create2(mem, NULL, 0, &endpt) != PJ_SUCCESS)
+	return -10;
+
+    pool = pj_pool_create(mem, "endpt_test", 1000, 1000, NULL);
+
+    pjmedia_endpt_shard_param_default(&param);
+    param.shard_cnt = SHARD_CNT;
+    param.ptime = PTIME;
+
+    if (pjmedia_endpt_create_shards(endpt, &param) != PJ_SUCCESS) {
+	rc = -20;
+	goto on_return;
+    }
+    if (pjmedia_endpt_get_shard_count(endpt) != SHARD_CNT) {
+	rc = -30;
+	goto on_return;
+    }
+
+    rc = load_test(endpt);
+    if (rc != 0)
+	goto on_return;
+
+    rc = tick_test(endpt);
+    if (rc != 0)
+	goto on_return;
+
+    rc = transport_test(endpt, pool);
+    if (rc != 0)
+	goto on_return;
+
+on_return:
+    if (rc != 0)
+	PJ_LOG(3,(THIS_FILE, "    error: rc=%d", rc));
+
+    pj_pool_release(pool);
+    pjmedia_endpt_destroy2(endpt);
+
+    return rc;
+}
@@ -165,6 +165,77 @@ static pj_bool_t process_test_data(char data, pjmedia_jbuf *jb,
     return PJ_TRUE;
 }
 
+/* With time-scaling, the latency above the burst level should be reduced
+ * by compressing the playout instead of discarding frames, and the playout
+ * should be stretched once when the buffer runs dry.
+ */
+static int time_scale_test(void)
+{
+    pj_str_t jb_name = {"JBTS", 4};
+    pj_pool_t *pool;
+    pjmedia_jbuf *jb;
+    pjmedia_jb_state state;
+    pj_uint32_t frame;
+    char f_type;
+    int seq = 0, i, time_scale, stretch_cnt = 0;
+    int rc = 0;
+
+    printf("\n\nTime-scaling the playout\n");
+
+    pool = pj_pool_create(mem, "JBTS", 4000, 4000, NULL);
+    pjmedia_jbuf_create(pool, &jb_name, sizeof(frame), JB_PTIME,
+			JB_BUF_SIZE, &jb);
+    pjmedia_jbuf_set_adaptive(jb, 0, 0, JB_BUF_SIZE);
+    pjmedia_jbuf_set_discard(jb, PJMEDIA_JB_DISCARD_TIME_SCALE);
+
+    for (i = 0; i < 600; ++i) {
+	/* Some frames arrive late in a burst, adding latency */
+	int put_cnt = (i == 100) ? 10 : (i >= 90 && i < 100) ? 0 : 1;
+
+	while (put_cnt--) {
+	    frame = seq;
+	    pjmedia_jbuf_put_frame(jb, &frame, sizeof(frame), seq++);
+	}
+
+	time_scale = pjmedia_jbuf_get_time_scale(jb);
+	if (time_scale < 0)
+	    continue;
+
+	pjmedia_jbuf_get_frame(jb, &frame, &f_type);
+	if (time_scale > 0)
+	    pjmedia_jbuf_get_frame(jb, &frame, &f_type);
+    }
+
+    pjmedia_jbuf_get_state(jb, &state);
+    printf("  size=%u burst=%u discard=%u compress=%u stretch=%u\n",
+	   state.size, state.burst, state.discard, state.compress,
+	   state.stretch);
+    if (state.compress == 0 || state.discard != 0 ||
+	state.size > state.burst + 2)
+    {
+	printf("! Latency was not reduced by compressing the playout\n");
+	rc = 256;
+    }
+
+    /* No more frame, should stretch once when the buffer is empty */
+    for (i = 0; i < 20; ++i) {
+	if (pjmedia_jbuf_get_time_scale(jb) < 0)
+	    ++stretch_cnt;
+	else
+	    pjmedia_jbuf_get_frame(jb, &frame, &f_type);
+    }
+    if (rc == 0 && stretch_cnt != 1) {
+	printf("! Playout was stretched %d times on empty buffer\n",
+	       stretch_cnt);
+	rc = 256;
+    }
+
+    pjmedia_jbuf_destroy(jb);
+    pj_pool_release(pool);
+
+    return rc;
+}
+
 int jbuf_main(void)
 {
     FILE *input;
@@ -345,6 +416,10 @@ int jbuf_main(void)
     }
 
     fclose(input);
+
+    if (rc == 0)
+	rc = time_scale_test();
+
     pj_log_set_level(old_log_level);
 
     return rc;
@@ -1672,6 +1672,133 @@ static pjmedia_port* create_tonegen2(pj_pool_t *pool,
 
 
 
+/***************************************************************************/
+/* PCM sample operations, as done by the conference bridge on each frame:
+ * mix several sources, convert the mix back to 16bit with level
+ * adjustment, and adjust and measure the RX level of a source.
+ */
+#define PCM_OPS_SRC_CNT	    8
+
+struct pcm_ops_port
+{
+    pjmedia_port     base;
+    pj_int32_t	    *mix_buf;
+    pj_int16_t	    *rx_buf;
+    pj_uint32_t	     level;	/* Kept like the bridge keeps it */
+};
+
+static pj_status_t pcm_ops_get_frame(struct pjmedia_port *this_port, 
+				     pjmedia_frame *frame)
+{
+    struct pcm_ops_port *pp = (struct pcm_ops_port*)this_port;
+    unsigned i, count = PJMEDIA_PIA_SPF(&this_port->info);
+    unsigned range = PJ_ARRAY_SIZE(ref_signal) - count;
+    pj_int32_t mix_min, mix_max;
+    pj_uint32_t level = 0;
+
+    pjmedia_pcm_widen(pp->mix_buf, ref_signal, count);
+    for (i=1; i<PCM_OPS_SRC_CNT; ++i) {
+	const pj_int16_t *src = ref_signal + (i * 229) % range;
+
+	pjmedia_copy_samples(pp->rx_buf, src, count);
+	level += pjmedia_pcm_adjust(pp->rx_buf, count, 100);
+	pjmedia_pcm_mix(pp->mix_buf, pp->rx_buf, count, &mix_min, &mix_max);
+    }
+    level += pjmedia_pcm_narrow((pj_int16_t*)frame->buf, pp->mix_buf,
+				count, 90);
+    level += pjmedia_pcm_sum_abs((pj_int16_t*)frame->buf, count);
+    pp->level = level / (count * (PCM_OPS_SRC_CNT + 1));
+
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    return PJ_SUCCESS;
+}
+
+static void pcm_ops_custom_deinit(struct test_entry *te)
+{
+    PJ_UNUSED_ARG(te);
+    pjmedia_pcm_set_impl(PJMEDIA_PCM_IMPL_AUTO);
+}
+
+static pjmedia_port* create_pcm_ops(pjmedia_pcm_impl impl,
+				    pj_pool_t *pool,
+				    unsigned clock_rate,
+				    unsigned channel_count,
+				    unsigned samples_per_frame,
+				    unsigned flags,
+				    struct test_entry *te)
+{
+    struct pcm_ops_port *pp;
+    pj_str_t name = pj_str("pcm_ops");
+
+    PJ_UNUSED_ARG(flags);
+
+    if (pjmedia_pcm_set_impl(impl) != PJ_SUCCESS) {
+	PJ_LOG(3,(THIS_FILE, "%s PCM operations are not supported",
+		  pjmedia_pcm_impl_name(impl)));
+	return NULL;
+    }
+
+    pp = PJ_POOL_ZALLOC_T(pool, struct pcm_ops_port);
+    pp->mix_buf = (pj_int32_t*)
+		  pj_pool_alloc(pool, samples_per_frame * sizeof(pj_int32_t));
+    pp->rx_buf = (pj_int16_t*)
+		 pj_pool_alloc(pool, samples_per_frame * sizeof(pj_int16_t));
+
+    pjmedia_port_info_init(&pp->base.info, &name, 0x1234, clock_rate,
+			   channel_count, 16, samples_per_frame);
+    pp->base.get_frame = &pcm_ops_get_frame;
+
+    te->custom_deinit = &pcm_ops_custom_deinit;
+
+    return &pp->base;
+}
+
+static pjmedia_port* pcm_ops_c(pj_pool_t *pool,
+			       unsigned clock_rate,
+			       unsigned channel_count,
+			       unsigned samples_per_frame,
+			       unsigned flags,
+			       struct test_entry *te)
+{
+    return create_pcm_ops(PJMEDIA_PCM_IMPL_C, pool, clock_rate,
+			  channel_count, samples_per_frame, flags, te);
+}
+
+static pjmedia_port* pcm_ops_sse2(pj_pool_t *pool,
+				  unsigned clock_rate,
+				  unsigned channel_count,
+				  unsigned samples_per_frame,
+				  unsigned flags,
+				  struct test_entry *te)
+{
+    return create_pcm_ops(PJMEDIA_PCM_IMPL_SSE2, pool, clock_rate,
+			  channel_count, samples_per_frame, flags, te);
+}
+
+static pjmedia_port* pcm_ops_avx2(pj_pool_t *pool,
+				  unsigned clock_rate,
+				  unsigned channel_count,
+				  unsigned samples_per_frame,
+				  unsigned flags,
+				  struct test_entry *te)
+{
+    return create_pcm_ops(PJMEDIA_PCM_IMPL_AVX2, pool, clock_rate,
+			  channel_count, samples_per_frame, flags, te);
+}
+
+static pjmedia_port* pcm_ops_neon(pj_pool_t *pool,
+				  unsigned clock_rate,
+				  unsigned channel_count,
+				  unsigned samples_per_frame,
+				  unsigned flags,
+				  struct test_entry *te)
+{
+    return create_pcm_ops(PJMEDIA_PCM_IMPL_NEON, pool, clock_rate,
+			  channel_count, samples_per_frame, flags, te);
+}
+
+
+
 /***************************************************************************/
 /* Stream */
 
@@ -2432,6 +2559,10 @@ int mips_test(void)
 	{ "echo suppressor 800ms tail len", OP_GET_PUT, K8|K16, &es_create_800},
 	{ "tone generator with single freq", OP_GET, K8|K16, &create_tonegen1},
 	{ "tone generator with dual freq", OP_GET, K8|K16, &create_tonegen2},
+	{ "PCM mixing ops, 8 sources - C", OP_GET, K8|K16|K32, &pcm_ops_c},
+	{ "PCM mixing ops, 8 sources - SSE2", OP_GET, K8|K16|K32, &pcm_ops_sse2},
+	{ "PCM mixing ops, 8 sources - AVX2", OP_GET, K8|K16|K32, &pcm_ops_avx2},
+	{ "PCM mixing ops, 8 sources - NEON", OP_GET, K8|K16|K32, &pcm_ops_neon},
 #if PJMEDIA_HAS_G711_CODEC
 	{ "codec encode/decode - G.711", OP_PUT, K8, &g711_encode_decode},
 #endif
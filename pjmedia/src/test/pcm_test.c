@@ -0,0 +1,224 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE   "pcm_test.c"
+
+/* Longest count tested, plus room to misalign the buffers */
+#define MAX_COUNT   (2*160 + 1)
+#define BUF_COUNT   (MAX_COUNT + 4)
+
+/* Sources mixed in the overflow test */
+#define MIX_SRC_CNT 64
+
+/* Sample patterns */
+enum pattern
+{
+    PAT_RANDOM,		/* Random samples over the whole range	*/
+    PAT_FULL_SCALE,	/* Only -32768 and 32767		*/
+    PAT_EDGES,		/* Samples around zero and the limits	*/
+    PAT_CNT
+};
+
+/* Input and output buffers of one implementation */
+typedef struct bufs
+{
+    pj_int16_t	samples[BUF_COUNT];
+    pj_int16_t	out[BUF_COUNT];
+    pj_int32_t	mix_buf[BUF_COUNT];
+    pj_int32_t	mix_min;
+    pj_int32_t	mix_max;
+    pj_uint32_t	level[4];
+} bufs;
+
+static const unsigned counts[] =
+{
+    0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 33, 63, 80, 160, MAX_COUNT
+};
+
+static const unsigned gains[] = { 0, 1, 64, 127, 128, 129, 200, 255 };
+
+
+static void fill(pj_int16_t samples[], unsigned count, enum pattern pat)
+{
+    static const pj_int16_t edges[] =
+    {
+	0, 1, -1, 2, -2, 255, -256, 16383, -16384, 32766, -32767,
+	32767, -32768
+    };
+    unsigned i;
+
+    for (i=0; i<count; ++i) {
+	switch (pat) {
+	case PAT_RANDOM:
+	    samples[i] = (pj_int16_t)(pj_rand() & 0xFFFF);
+	    break;
+	case PAT_FULL_SCALE:
+	    samples[i] = (pj_rand() & 1) ? 32767 : -32768;
+	    break;
+	default:
+	    samples[i] = edges[pj_rand() % PJ_ARRAY_SIZE(edges)];
+	    break;
+	}
+    }
+}
+
+/* Run all the operations with the current implementation. The mix buffer
+ * accumulates MIX_SRC_CNT sources, so it overflows the 16bit range.
+ */
+static void run_ops(bufs *b, unsigned off, unsigned count, unsigned gain,
+		    const pj_int16_t src[MIX_SRC_CNT][BUF_COUNT])
+{
+    pj_int16_t *samples = b->samples + off;
+    pj_int16_t *out = b->out + off;
+    pj_int32_t *mix_buf = b->mix_buf + off;
+    unsigned i;
+
+    pjmedia_pcm_widen(mix_buf, samples, count);
+    for (i=0; i<MIX_SRC_CNT; ++i) {
+	pj_int32_t mix_min, mix_max;
+
+	pjmedia_pcm_mix(mix_buf, src[i], count, &mix_min, &mix_max);
+	if (i == 0 || mix_min < b->mix_min) b->mix_min = mix_min;
+	if (i == 0 || mix_max > b->mix_max) b->mix_max = mix_max;
+    }
+
+    b->level[0] = pjmedia_pcm_narrow(out, mix_buf, count, gain);
+    b->level[1] = pjmedia_pcm_adjust(samples, count, gain);
+    b->level[2] = pjmedia_pcm_sum_abs(samples, count);
+
+    /* In place conversion */
+    b->level[3] = pjmedia_pcm_narrow((pj_int16_t*)mix_buf, mix_buf, count,
+				     gain);
+}
+
+static int compare(const bufs *ref, const bufs *b, unsigned off,
+		   unsigned count)
+{
+    if (pj_memcmp(ref->samples+off, b->samples+off, count*2) != 0)
+	return -10;
+    if (pj_memcmp(ref->out+off, b->out+off, count*2) != 0)
+	return -20;
+    if (pj_memcmp(ref->mix_buf+off, b->mix_buf+off, count*4) != 0)
+	return -30;
+    if (ref->mix_min != b->mix_min || ref->mix_max != b->mix_max)
+	return -40;
+    if (pj_memcmp(ref->level, b->level, sizeof(ref->level)) != 0)
+	return -50;
+    return 0;
+}
+
+static int test_impl(pj_pool_t *pool, pjmedia_pcm_impl impl)
+{
+    pj_int16_t (*src)[BUF_COUNT];
+    bufs *in, *ref, *b;
+    unsigned pat, ci, gi, off;
+
+    src = (pj_int16_t(*)[BUF_COUNT])
+	  pj_pool_alloc(pool, MIX_SRC_CNT * BUF_COUNT * sizeof(pj_int16_t));
+    in = PJ_POOL_ALLOC_T(pool, bufs);
+    ref = PJ_POOL_ALLOC_T(pool, bufs);
+    b = PJ_POOL_ALLOC_T(pool, bufs);
+
+    for (pat=0; pat<PAT_CNT; ++pat) {
+	for (ci=0; ci<PJ_ARRAY_SIZE(counts); ++ci) {
+	    for (gi=0; gi<PJ_ARRAY_SIZE(gains); ++gi) {
+		/* Unaligned buffers too */
+		for (off=0; off<3; ++off) {
+		    unsigned count = counts[ci];
+		    unsigned i;
+		    int rc;
+
+		    for (i=0; i<MIX_SRC_CNT; ++i)
+			fill(src[i], BUF_COUNT, (enum pattern)pat);
+		    fill(in->samples, BUF_COUNT, (enum pattern)pat);
+		    fill(in->out, BUF_COUNT, PAT_RANDOM);
+		    for (i=0; i<BUF_COUNT; ++i)
+			in->mix_buf[i] = (pj_int32_t)pj_rand();
+		    in->mix_min = in->mix_max = 0;
+		    pj_bzero(in->level, sizeof(in->level));
+
+		    pjmedia_pcm_set_impl(PJMEDIA_PCM_IMPL_C);
+		    pj_memcpy(ref, in, sizeof(bufs));
+		    run_ops(ref, off, count, gains[gi],
+			    (const pj_int16_t(*)[BUF_COUNT])src);
+
+		    pjmedia_pcm_set_impl(impl);
+		    pj_memcpy(b, in, sizeof(bufs));
+		    run_ops(b, off, count, gains[gi],
+			    (const pj_int16_t(*)[BUF_COUNT])src);
+
+		    rc = compare(ref, b, off, count);
+
+		    /* Samples outside the range must not be touched */
+		    if (rc == 0 &&
+			(pj_memcmp(b->out+off+count, in->out+off+count,
+				   (BUF_COUNT-off-count)*2) != 0 ||
+			 pj_memcmp(b->mix_buf+off+count,
+				   in->mix_buf+off+count,
+				   (BUF_COUNT-off-count)*4) != 0))
+		    {
+			rc = -60;
+		    }
+
+		    if (rc != 0) {
+			PJ_LOG(3,(THIS_FILE, "  %s differs from c: "
+				  "pattern=%u count=%u gain=%u offset=%u "
+				  "(rc=%d)", pjmedia_pcm_impl_name(impl),
+				  pat, count, gains[gi], off, rc));
+			return rc;
+		    }
+		}
+	    }
+	}
+    }
+
+    return 0;
+}
+
+int pcm_test(void)
+{
+    static const pjmedia_pcm_impl impls[] =
+    {
+	PJMEDIA_PCM_IMPL_SSE2, PJMEDIA_PCM_IMPL_AVX2, PJMEDIA_PCM_IMPL_NEON
+    };
+    pjmedia_pcm_impl old_impl = pjmedia_pcm_get_impl();
+    pj_pool_t *pool;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "pcmtest", 4000, 4000, NULL);
+
+    for (i=0; i<PJ_ARRAY_SIZE(impls) && rc==0; ++i) {
+	if (pjmedia_pcm_set_impl(impls[i]) != PJ_SUCCESS) {
+	    PJ_LOG(3,(THIS_FILE, "  %s: not available, skipped",
+		      pjmedia_pcm_impl_name(impls[i])));
+	    continue;
+	}
+
+	PJ_LOG(3,(THIS_FILE, "  %s vs c", pjmedia_pcm_impl_name(impls[i])));
+	rc = test_impl(pool, impls[i]);
+    }
+
+    pjmedia_pcm_set_impl(old_impl);
+    pj_pool_release(pool);
+
+    return rc;
+}
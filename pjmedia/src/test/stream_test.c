@@ -0,0 +1,643 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjmedia-codec.h>
+
+#define THIS_FILE   "stream_test.c"
+
+#define GRP_CNT	    4	    /* Streams in the encoding group		*/
+#define TICKS	    100	    /* Frames sent by each stream		*/
+#define DIV_START   30	    /* The last stream of the group sends	*/
+#define DIV_END	    50	    /* another signal in [DIV_START, DIV_END)	*/
+#define MAX_PAYLOAD 320
+
+/* Stream which sends RTP to a loop transport, and the sent payloads */
+typedef struct tx_stream
+{
+    pjmedia_transport	*tp;
+    pjmedia_stream	*stream;
+    pjmedia_port	*port;
+    unsigned		 pkt_cnt;
+    pj_uint8_t		 payload[TICKS][MAX_PAYLOAD];
+    unsigned		 size[TICKS];
+} tx_stream;
+
+
+static void on_tx_rtp(void *user_data, void *pkt, pj_ssize_t size)
+{
+    tx_stream *ts = (tx_stream*) user_data;
+
+    size -= sizeof(pjmedia_rtp_hdr);
+    if (size < 0 || size > MAX_PAYLOAD || ts->pkt_cnt == TICKS)
+	return;
+
+    pj_memcpy(ts->payload[ts->pkt_cnt], (char*)pkt + sizeof(pjmedia_rtp_hdr),
+	      size);
+    ts->size[ts->pkt_cnt++] = (unsigned)size;
+}
+
+static pj_status_t init_stream_info(pjmedia_endpt *endpt,
+				    const pjmedia_codec_info *ci,
+				    pjmedia_codec_param *param,
+				    pjmedia_stream_info *si)
+{
+    pj_status_t status;
+
+    status = pjmedia_codec_mgr_get_default_param(
+			pjmedia_endpt_get_codec_mgr(endpt), ci, param);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* Send every frame */
+    param->setting.vad = 0;
+
+    pj_bzero(si, sizeof(*si));
+    si->type = PJMEDIA_TYPE_AUDIO;
+    si->proto = PJMEDIA_TP_PROTO_RTP_AVP;
+    si->dir = PJMEDIA_DIR_ENCODING_DECODING;
+    pj_sockaddr_in_init(&si->rem_addr.ipv4, NULL, 4000);
+    pj_sockaddr_in_init(&si->rem_rtcp.ipv4, NULL, 4001);
+    pj_memcpy(&si->fmt, ci, sizeof(pjmedia_codec_info));
+    si->param = param;
+    si->tx_pt = ci->pt;
+    si->tx_event_pt = 101;
+    si->rx_event_pt = 101;
+    si->ssrc = pj_rand();
+    si->jb_init = si->jb_min_pre = si->jb_max_pre = si->jb_max = -1;
+    si->rx_queue_pkt_cnt = -1;
+
+    return PJ_SUCCESS;
+}
+
+static pj_status_t tx_stream_create(pjmedia_endpt *endpt, pj_pool_t *pool,
+				    const pjmedia_codec_info *ci,
+				    pjmedia_stream_enc_group *grp,
+				    tx_stream *ts)
+{
+    pjmedia_codec_param param;
+    pjmedia_stream_info si;
+    pj_status_t status;
+
+    pj_bzero(ts, sizeof(*ts));
+
+    status = init_stream_info(endpt, ci, &param, &si);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pjmedia_transport_loop_create(endpt, &ts->tp);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pjmedia_stream_create(endpt, pool, &si, ts->tp, NULL,
+				   &ts->stream);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* The stream doesn't receive its packets, we do */
+    pjmedia_transport_loop_disable_rx(ts->tp, ts->stream, PJ_TRUE);
+    status = pjmedia_transport_attach(ts->tp, ts, &si.rem_addr,
+				      &si.rem_rtcp, sizeof(pj_sockaddr_in),
+				      &on_tx_rtp, NULL);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    if (grp) {
+	status = pjmedia_stream_set_enc_group(ts->stream, grp);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+
+    status = pjmedia_stream_start(ts->stream);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    return pjmedia_stream_get_port(ts->stream, &ts->port);
+}
+
+static void tx_stream_destroy(tx_stream *ts)
+{
+    if (ts->stream)
+	pjmedia_stream_destroy(ts->stream);
+    if (ts->tp) {
+	pjmedia_transport_detach(ts->tp, ts);
+	pjmedia_transport_close(ts->tp);
+    }
+}
+
+/* Deterministic noise, so that every frame is different */
+static void gen_frame(pj_uint32_t *seed, pj_int16_t *buf, unsigned count)
+{
+    unsigned i;
+
+    for (i=0; i<count; ++i) {
+	*seed = *seed * 1103515245 + 12345;
+	buf[i] = (pj_int16_t)((*seed >> 16) & 0x3FFF) - 0x2000;
+    }
+}
+
+static pj_status_t send_frame(pjmedia_port *port, const pj_int16_t *samples,
+			      unsigned count, unsigned tick)
+{
+    pj_int16_t buf[MAX_PAYLOAD];
+    pjmedia_frame frame;
+
+    pj_memcpy(buf, samples, count * 2);
+
+    pj_bzero(&frame, sizeof(frame));
+    frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+    frame.buf = buf;
+    frame.size = count * 2;
+    frame.timestamp.u64 = (pj_uint64_t)tick * count;
+
+    return pjmedia_port_put_frame(port, &frame);
+}
+
+static pj_bool_t same_payload(const tx_stream *ts1, unsigned i1,
+			      const tx_stream *ts2, unsigned i2)
+{
+    return ts1->size[i1] == ts2->size[i2] &&
+	   pj_memcmp(ts1->payload[i1], ts2->payload[i2],
+		     ts1->size[i1]) == 0;
+}
+
+/*
+ * GRP_CNT streams of an encoding group and an ungrouped reference stream
+ * send the same frames, except that the last stream of the group sends
+ * another signal for a while, like a speaker whose mix doesn't have its
+ * own voice. That stream sends its frame first or last at each tick.
+ * More reference streams get the other signal, and the frames which the
+ * group's encoder gets when the last stream sends its frame first.
+ */
+static int enc_group_run(pjmedia_endpt *endpt, pj_pool_t *pool,
+			 const pjmedia_codec_info *ci, pj_bool_t div_first)
+{
+    pjmedia_stream_enc_group *grp = NULL;
+    tx_stream *ref, *ref_div, *ref_first, *st;
+    pj_int16_t sig[MAX_PAYLOAD], sig_div[MAX_PAYLOAD];
+    pj_uint32_t seed = 1, seed_div = 2;
+    unsigned i, t, spf;
+    int rc = 0;
+
+    ref = PJ_POOL_ZALLOC_T(pool, tx_stream);
+    ref_div = PJ_POOL_ZALLOC_T(pool, tx_stream);
+    ref_first = PJ_POOL_ZALLOC_T(pool, tx_stream);
+    st = (tx_stream*) pj_pool_zalloc(pool, GRP_CNT * sizeof(tx_stream));
+
+    if (pjmedia_stream_enc_group_create(endpt, &grp) != PJ_SUCCESS)
+	return -110;
+
+    if (tx_stream_create(endpt, pool, ci, NULL, ref) != PJ_SUCCESS ||
+	tx_stream_create(endpt, pool, ci, NULL, ref_div) != PJ_SUCCESS ||
+	tx_stream_create(endpt, pool, ci, NULL, ref_first) != PJ_SUCCESS)
+    {
+	rc = -120;
+	goto on_return;
+    }
+    for (i=0; i<GRP_CNT; ++i) {
+	if (tx_stream_create(endpt, pool, ci, grp, &st[i]) != PJ_SUCCESS) {
+	    rc = -130;
+	    goto on_return;
+	}
+    }
+
+    spf = PJMEDIA_PIA_SPF(&ref->port->info);
+    if (spf > MAX_PAYLOAD) {
+	rc = -140;
+	goto on_return;
+    }
+
+    for (t=0; t<TICKS; ++t) {
+	pj_bool_t div = (t >= DIV_START && t < DIV_END);
+	tx_stream *last = &st[GRP_CNT-1];
+
+	gen_frame(&seed, sig, spf);
+	if (div)
+	    gen_frame(&seed_div, sig_div, spf);
+
+	if (div_first)
+	    send_frame(last->port, div ? sig_div : sig, spf, t);
+	for (i=0; i<GRP_CNT-1; ++i)
+	    send_frame(st[i].port, sig, spf, t);
+	if (!div_first)
+	    send_frame(last->port, div ? sig_div : sig, spf, t);
+
+	send_frame(ref->port, sig, spf, t);
+	if (div)
+	    send_frame(ref_div->port, sig_div, spf, t);
+	send_frame(ref_first->port, t==DIV_START ? sig_div : sig, spf, t);
+    }
+
+    if (ref->pkt_cnt != TICKS || ref_div->pkt_cnt != DIV_END - DIV_START) {
+	rc = -150;
+	goto on_return;
+    }
+    for (i=0; i<GRP_CNT; ++i) {
+	if (st[i].pkt_cnt != TICKS) {
+	    rc = -160;
+	    goto on_return;
+	}
+    }
+
+    for (t=0; t<TICKS; ++t) {
+	pj_bool_t div = (t >= DIV_START && t < DIV_END);
+	tx_stream *last = &st[GRP_CNT-1];
+
+	/* The streams which send the same signal send the same payload */
+	for (i=1; i<GRP_CNT-1; ++i) {
+	    if (!same_payload(&st[i], t, &st[0], t)) {
+		rc = -210;
+		break;
+	    }
+	}
+
+	if (!div_first) {
+	    /* The encoder of the group is never disturbed, so the payload
+	     * is the same as the reference stream's. The other signal is
+	     * encoded by the stream's own codec.
+	     */
+	    if (!same_payload(&st[0], t, ref, t))
+		rc = -220;
+	    else if (!div && !same_payload(last, t, ref, t))
+		rc = -230;
+	    else if (div && !same_payload(last, t, ref_div, t - DIV_START))
+		rc = -240;
+	} else {
+	    /* The first stream disturbs the encoder at DIV_START, then it
+	     * leaves the encoder to the others until it sends the same
+	     * signal again. The others keep using the encoder.
+	     */
+	    if (t < DIV_START && !same_payload(&st[0], t, ref, t))
+		rc = -250;
+	    else if (t > DIV_START && !same_payload(&st[0], t, ref_first, t))
+		rc = -255;
+	    else if (t < DIV_START && !same_payload(last, t, ref, t))
+		rc = -260;
+	    else if (t > DIV_END && !same_payload(last, t, &st[0], t))
+		rc = -270;
+	}
+
+	if (rc != 0) {
+	    PJ_LOG(3,(THIS_FILE, "    error: payload mismatch at frame %u, "
+		      "rc=%d", t, rc));
+	    break;
+	}
+    }
+
+on_return:
+    tx_stream_destroy(ref);
+    tx_stream_destroy(ref_div);
+    tx_stream_destroy(ref_first);
+    for (i=0; i<GRP_CNT; ++i)
+	tx_stream_destroy(&st[i]);
+    if (grp && pjmedia_stream_enc_group_destroy(grp) != PJ_SUCCESS && !rc)
+	rc = -170;
+
+    return rc;
+}
+
+/* Find the first available codec of the list */
+static const pjmedia_codec_info *find_codec(pjmedia_endpt *endpt,
+					    const char *codec_ids[],
+					    unsigned id_cnt)
+{
+    const pjmedia_codec_info *ci[1];
+    unsigned i, count;
+
+    for (i=0; i<id_cnt; ++i) {
+	pj_str_t id = pj_str((char*)codec_ids[i]);
+
+	count = 1;
+	if (pjmedia_codec_mgr_find_codecs_by_id(
+			pjmedia_endpt_get_codec_mgr(endpt), &id, &count,
+			ci, NULL) == PJ_SUCCESS && count > 0)
+	{
+	    return ci[0];
+	}
+    }
+
+    return NULL;
+}
+
+static int enc_group_test(pjmedia_endpt *endpt, pj_pool_t *pool)
+{
+    static const char *codec_ids[] =
+    {
+	"speex/8000", "GSM/8000", "iLBC/8000", "G722/16000", "PCMU/8000"
+    };
+    const pjmedia_codec_info *ci;
+    int rc;
+
+    /* Prefer a codec with state */
+    ci = find_codec(endpt, codec_ids, PJ_ARRAY_SIZE(codec_ids));
+    if (!ci) {
+	PJ_LOG(3,(THIS_FILE, "  encoding group test: no codec, skipped"));
+	return 0;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "  encoding group test with %.*s",
+	      (int)ci->encoding_name.slen, ci->encoding_name.ptr));
+
+    rc = enc_group_run(endpt, pool, ci, PJ_FALSE);
+    if (rc == 0)
+	rc = enc_group_run(endpt, pool, ci, PJ_TRUE);
+
+    return rc;
+}
+
+/* Stream which receives what it sends through a loop transport */
+static pj_status_t loop_stream_create(pjmedia_endpt *endpt, pj_pool_t *pool,
+				      const pjmedia_codec_info *ci,
+				      pj_bool_t jb_time_scale,
+				      int rx_queue_pkt_cnt,
+				      pjmedia_transport **p_tp,
+				      pjmedia_stream **p_stream,
+				      pjmedia_port **p_port)
+{
+    pjmedia_codec_param param;
+    pjmedia_stream_info si;
+    pj_status_t status;
+
+    *p_tp = NULL;
+    *p_stream = NULL;
+
+    status = init_stream_info(endpt, ci, &param, &si);
+    if (status != PJ_SUCCESS)
+	return status;
+    si.jb_time_scale = jb_time_scale;
+    si.rx_queue_pkt_cnt = rx_queue_pkt_cnt;
+
+    status = pjmedia_transport_loop_create(endpt, p_tp);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pjmedia_stream_create(endpt, pool, &si, *p_tp, NULL, p_stream);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pjmedia_stream_start(*p_stream);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    return pjmedia_stream_get_port(*p_stream, p_port);
+}
+
+static void loop_stream_destroy(pjmedia_transport *tp,
+				pjmedia_stream *stream)
+{
+    if (stream)
+	pjmedia_stream_destroy(stream);
+    if (tp)
+	pjmedia_transport_close(tp);
+}
+
+/*
+ * The played frames of a time-scaled stream have the timestamp of the
+ * decoded samples, so a burst which makes the jitter buffer compress the
+ * playout makes the timestamp run faster than the played samples.
+ */
+#define TS_BURST    10
+#define TS_TICKS    200
+
+static int time_scale_test(pjmedia_endpt *endpt, pj_pool_t *pool)
+{
+    static const char *codec_ids[] = { "PCMU/8000", "PCMA/8000" };
+    const pjmedia_codec_info *ci;
+    pjmedia_transport *tp;
+    pjmedia_stream *stream;
+    pjmedia_port *port;
+    pj_int16_t sig[MAX_PAYLOAD], buf[MAX_PAYLOAD];
+    pj_uint32_t seed = 1;
+    pj_timestamp last_ts;
+    unsigned t, spf, sent = 0, played = 0, fast_cnt = 0;
+    int rc = 0;
+
+    ci = find_codec(endpt, codec_ids, PJ_ARRAY_SIZE(codec_ids));
+    if (!ci) {
+	PJ_LOG(3,(THIS_FILE, "  time-scaling test: no codec, skipped"));
+	return 0;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "  time-scaling timestamp test"));
+
+    if (loop_stream_create(endpt, pool, ci, PJ_TRUE, -1, &tp, &stream,
+			   &port) != PJ_SUCCESS)
+    {
+	rc = -310;
+	goto on_return;
+    }
+
+    spf = PJMEDIA_PIA_SPF(&port->info);
+    if (spf > MAX_PAYLOAD) {
+	rc = -320;
+	goto on_return;
+    }
+
+    last_ts.u64 = 0;
+    for (t=0; t<TS_TICKS; ++t) {
+	pjmedia_frame frame;
+	unsigned i, cnt = (t == 0) ? TS_BURST : 1;
+
+	for (i=0; i<cnt; ++i) {
+	    gen_frame(&seed, sig, spf);
+	    send_frame(port, sig, spf, sent++);
+	}
+
+	pj_bzero(&frame, sizeof(frame));
+	frame.buf = buf;
+	frame.size = spf * 2;
+	if (pjmedia_port_get_frame(port, &frame) != PJ_SUCCESS) {
+	    rc = -330;
+	    break;
+	}
+	if (frame.type != PJMEDIA_FRAME_TYPE_AUDIO)
+	    continue;
+
+	/* The timestamp never goes back nor passes the decoded samples */
+	if ((played && frame.timestamp.u64 < last_ts.u64) ||
+	    frame.timestamp.u64 + spf > (pj_uint64_t)sent * spf)
+	{
+	    PJ_LOG(3,(THIS_FILE, "    error: bad timestamp %u at frame %u",
+		      frame.timestamp.u32.lo, t));
+	    rc = -340;
+	    break;
+	}
+	if (played && frame.timestamp.u64 - last_ts.u64 > spf)
+	    ++fast_cnt;
+
+	last_ts = frame.timestamp;
+	++played;
+    }
+
+    if (rc == 0 && (played == 0 || fast_cnt == 0)) {
+	PJ_LOG(3,(THIS_FILE, "    error: played=%u compressed=%u",
+		  played, fast_cnt));
+	rc = -350;
+    }
+
+on_return:
+    loop_stream_destroy(tp, stream);
+    return rc;
+}
+
+/*
+ * A stream with the RX queue plays the same frames as a stream which puts
+ * the packets to the jitter buffer directly, its jitter buffer state
+ * includes the queued packets, and the packets received when the queue
+ * is full are counted as discarded.
+ */
+#define RXQ_PKT_CNT	8
+#define RXQ_TICKS	200
+
+static int rx_queue_test(pjmedia_endpt *endpt, pj_pool_t *pool)
+{
+    static const char *codec_ids[] = { "PCMU/8000", "PCMA/8000" };
+    const pjmedia_codec_info *ci;
+    pjmedia_transport *tp = NULL, *tp_q = NULL;
+    pjmedia_stream *stream = NULL, *stream_q = NULL;
+    pjmedia_port *port, *port_q;
+    pjmedia_jb_state state, state_q;
+    pj_int16_t sig[MAX_PAYLOAD], buf[MAX_PAYLOAD], buf_q[MAX_PAYLOAD];
+    pj_uint32_t seed = 1;
+    unsigned t, i, spf, sent = 0;
+    int rc = 0;
+
+    ci = find_codec(endpt, codec_ids, PJ_ARRAY_SIZE(codec_ids));
+    if (!ci) {
+	PJ_LOG(3,(THIS_FILE, "  RX queue test: no codec, skipped"));
+	return 0;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "  RX queue test"));
+
+    if (loop_stream_create(endpt, pool, ci, PJ_FALSE, 0, &tp, &stream,
+			   &port) != PJ_SUCCESS ||
+	loop_stream_create(endpt, pool, ci, PJ_FALSE, RXQ_PKT_CNT, &tp_q,
+			   &stream_q, &port_q) != PJ_SUCCESS)
+    {
+	rc = -410;
+	goto on_return;
+    }
+
+    spf = PJMEDIA_PIA_SPF(&port->info);
+    if (spf > MAX_PAYLOAD) {
+	rc = -420;
+	goto on_return;
+    }
+
+    for (t=0; t<RXQ_TICKS && rc==0; ++t) {
+	pjmedia_frame frame, frame_q;
+	/* Some packets arrive in a burst */
+	unsigned cnt = (t % 20 == 10) ? 3 : (t % 20 == 11 ||
+					     t % 20 == 12) ? 0 : 1;
+
+	for (i=0; i<cnt; ++i) {
+	    gen_frame(&seed, sig, spf);
+	    send_frame(port, sig, spf, sent);
+	    send_frame(port_q, sig, spf, sent);
+	    ++sent;
+	}
+
+	pj_bzero(&frame, sizeof(frame));
+	frame.buf = buf;
+	frame.size = spf * 2;
+	pj_memcpy(&frame_q, &frame, sizeof(frame));
+	frame_q.buf = buf_q;
+
+	if (pjmedia_port_get_frame(port, &frame) != PJ_SUCCESS ||
+	    pjmedia_port_get_frame(port_q, &frame_q) != PJ_SUCCESS)
+	{
+	    rc = -430;
+	} else if (frame.type != frame_q.type ||
+		   (frame.type == PJMEDIA_FRAME_TYPE_AUDIO &&
+		    (frame.size != frame_q.size ||
+		     pj_memcmp(buf, buf_q, frame.size) != 0)))
+	{
+	    PJ_LOG(3,(THIS_FILE, "    error: frame %u differs", t));
+	    rc = -440;
+	}
+    }
+    if (rc != 0)
+	goto on_return;
+
+    /* The state includes the packets which are still in the queue */
+    for (i=0; i<RXQ_PKT_CNT/2; ++i) {
+	gen_frame(&seed, sig, spf);
+	send_frame(port, sig, spf, sent);
+	send_frame(port_q, sig, spf, sent);
+	++sent;
+    }
+    pjmedia_stream_get_stat_jbuf(stream, &state);
+    pjmedia_stream_get_stat_jbuf(stream_q, &state_q);
+    if (state_q.size != state.size || state_q.discard != state.discard) {
+	PJ_LOG(3,(THIS_FILE, "    error: size=%u/%u discard=%u/%u",
+		  state_q.size, state.size, state_q.discard, state.discard));
+	rc = -450;
+	goto on_return;
+    }
+
+    /* Overflow the queue */
+    for (i=0; i<RXQ_PKT_CNT*8; ++i) {
+	gen_frame(&seed, sig, spf);
+	send_frame(port_q, sig, spf, sent++);
+    }
+    pjmedia_stream_get_stat_jbuf(stream_q, &state_q);
+    if (state_q.discard <= state.discard) {
+	PJ_LOG(3,(THIS_FILE, "    error: no discard on queue overflow"));
+	rc = -460;
+    }
+
+on_return:
+    loop_stream_destroy(tp, stream);
+    loop_stream_destroy(tp_q, stream_q);
+    return rc;
+}
+
+int stream_test(void)
+{
+    pjmedia_endpt *endpt;
+    pj_pool_t *pool;
+    int rc;
+
+    if (pjmedia_endpt_create(mem, NULL, 0, &endpt) != PJ_SUCCESS)
+	return -10;
+
+    pool = pj_pool_create(mem, "stream_test", 4000, 4000, NULL);
+
+    if (pjmedia_codec_register_audio_codecs(endpt, NULL) != PJ_SUCCESS) {
+	rc = -20;
+	goto on_return;
+    }
+
+    rc = enc_group_test(endpt, pool);
+    if (rc != 0)
+	goto on_return;
+
+    rc = time_scale_test(endpt, pool);
+    if (rc != 0)
+	goto on_return;
+
+    rc = rx_queue_test(endpt, pool);
+
+on_return:
+    pj_pool_release(pool);
+    pjmedia_endpt_destroy(endpt);
+
+    return rc;
+}
@@ -97,12 +97,24 @@ int test_main(void)
 #if HAS_JBUF_TEST
     DO_TEST(jbuf_main());
 #endif
+#if HAS_PCM_TEST
+    DO_TEST(pcm_test());
+#endif
+#if HAS_STREAM_TEST
+    DO_TEST(stream_test());
+#endif
+#if HAS_CONF_TEST
+    DO_TEST(conf_test());
+#endif
 #if HAS_MIPS_TEST
     DO_TEST(mips_test());
 #endif
 #if HAS_CODEC_VECTOR_TEST
     DO_TEST(codec_test_vectors());
 #endif
+#if HAS_ENDPT_TEST
+    DO_TEST(endpt_test());
+#endif
 
     PJ_LOG(3,(THIS_FILE," "));
 
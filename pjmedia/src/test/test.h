@@ -28,16 +28,24 @@
 #define HAS_VID_CODEC_TEST	PJMEDIA_HAS_VIDEO
 #define HAS_SDP_NEG_TEST	1
 #define HAS_JBUF_TEST		1
+#define HAS_PCM_TEST		1
+#define HAS_STREAM_TEST		1
+#define HAS_CONF_TEST		1
 #define HAS_MIPS_TEST		1
 #define HAS_CODEC_VECTOR_TEST	1
+#define HAS_ENDPT_TEST		1
 
 int session_test(void);
 int rtp_test(void);
 int sdp_test(void);
 int jbuf_main(void);
+int pcm_test(void);
+int stream_test(void);
+int conf_test(void);
 int sdp_neg_test(void);
 int mips_test(void);
 int codec_test_vectors(void);
+int endpt_test(void);
 int vid_codec_test(void);
 int vid_dev_test(void);
 int vid_port_test(void);
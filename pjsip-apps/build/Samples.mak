@@ -20,6 +20,7 @@ SAMPLES := auddemo \
 	   aviplay \
 	   aectest \
 	   clidemo \
+	   confbench \
 	   confsample \
 	   encdec \
 	   httpdemo \
@@ -27,6 +28,7 @@ SAMPLES := auddemo \
 	   jbsim \
 	   latency \
 	   level \
+	   logdecode \
 	   mix \
 	   pjsip-perf \
 	   pcaputil \
@@ -93,6 +93,8 @@
 #define CMD_CONFIG_DUMP_DETAIL	    ((CMD_CONFIG*10)+2)
 #define CMD_CONFIG_DUMP_CONF	    ((CMD_CONFIG*10)+3)
 #define CMD_CONFIG_WRITE_SETTING    ((CMD_CONFIG*10)+4)
+#define CMD_CONFIG_LATENCY	    ((CMD_CONFIG*10)+5)
+#define CMD_CONFIG_POOL_PROF	    ((CMD_CONFIG*10)+6)
 
 /* video level 2 command */
 #define CMD_VIDEO_ENABLE	    ((CMD_VIDEO*10)+1)
@@ -1439,6 +1441,64 @@ static pj_status_t cmd_write_config(pj_cli_cmd_val *cval)
     return PJ_SUCCESS;
 }
 
+/* Latency histograms */
+static pj_status_t cmd_latency(pj_cli_cmd_val *cval)
+{
+    static const char *usage = "Usage: dump_latency [on|off|reset|detail]\n";
+    pj_str_t action = pj_str("");
+
+    if (cval->argc > 1)
+	action = cval->argv[1];
+
+    if (action.slen == 0 || pj_stricmp2(&action, "detail") == 0) {
+	pjsip_lat_dump(action.slen != 0);
+    } else if (pj_stricmp2(&action, "on") == 0) {
+	pjsip_cfg()->endpt.latency_stats = PJ_TRUE;
+	PJ_LOG(3,(THIS_FILE, "Latency histograms enabled"));
+    } else if (pj_stricmp2(&action, "off") == 0) {
+	pjsip_cfg()->endpt.latency_stats = PJ_FALSE;
+	PJ_LOG(3,(THIS_FILE, "Latency histograms disabled"));
+    } else if (pj_stricmp2(&action, "reset") == 0) {
+	pjsip_lat_reset();
+	PJ_LOG(3,(THIS_FILE, "Latency histograms cleared"));
+    } else {
+	pj_cli_sess_write_msg(cval->sess, usage, pj_ansi_strlen(usage));
+    }
+
+    return PJ_SUCCESS;
+}
+
+/* Pool memory profiler */
+static pj_status_t cmd_pool_prof(pj_cli_cmd_val *cval)
+{
+    static const char *usage = "Usage: dump_pool [on|sites|off|detail]\n";
+    pj_caching_pool *cp = (pj_caching_pool*) pjsua_get_pool_factory();
+    pj_str_t action = pj_str("");
+
+    if (cval->argc > 1)
+	action = cval->argv[1];
+
+    if (action.slen == 0 || pj_stricmp2(&action, "detail") == 0) {
+	pj_caching_pool_prof_dump(cp, action.slen != 0);
+    } else if (pj_stricmp2(&action, "on") == 0 ||
+	       pj_stricmp2(&action, "sites") == 0)
+    {
+	pj_status_t status;
+
+	status = pj_caching_pool_prof_start(cp,
+					    pj_stricmp2(&action, "sites")==0);
+	if (status != PJ_SUCCESS)
+	    pjsua_perror(THIS_FILE, "Unable to start pool profiler", status);
+    } else if (pj_stricmp2(&action, "off") == 0) {
+	pj_caching_pool_prof_stop(cp);
+	PJ_LOG(3,(THIS_FILE, "Pool profiler stopped"));
+    } else {
+	pj_cli_sess_write_msg(cval->sess, usage, pj_ansi_strlen(usage));
+    }
+
+    return PJ_SUCCESS;
+}
+
 /* Status and config command handler */
 pj_status_t cmd_config_handler(pj_cli_cmd_val *cval)
 {
@@ -1459,6 +1519,12 @@ pj_status_t cmd_config_handler(pj_cli_cmd_val *cval)
     case CMD_CONFIG_WRITE_SETTING:
 	status = cmd_write_config(cval);
 	break;
+    case CMD_CONFIG_LATENCY:
+	status = cmd_latency(cval);
+	break;
+    case CMD_CONFIG_POOL_PROF:
+	status = cmd_pool_prof(cval);
+	break;
     }
 
     return status;
@@ -2905,6 +2971,16 @@ static pj_status_t add_config_command(pj_cli_t *c)
 	"   desc='Write current configuration file'>"
 	"    <ARG name='output_file' type='string' desc='Output filename'/>"
 	"  </CMD>"
+	"  <CMD name='dump_latency' id='5005' sc='dl' "
+	"   desc='Dump or control SIP latency histograms'>"
+	"    <ARG name='action' type='string' optional='1' "
+	"     desc='on, off, reset or detail'/>"
+	"  </CMD>"
+	"  <CMD name='dump_pool' id='5006' sc='dp' "
+	"   desc='Dump or control pool memory profiler'>"
+	"    <ARG name='action' type='string' optional='1' "
+	"     desc='on, sites, off or detail'/>"
+	"  </CMD>"
 	"</CMD>";
 
     pj_str_t xml = pj_str(config_command);
@@ -43,7 +43,8 @@ static void usage(void)
     puts  ("  --log-file=fname    Log to filename (default stderr)");
     puts  ("  --log-level=N       Set log max level to N (0(none) to 6(trace)) (default=5)");
     puts  ("  --app-log-level=N   Set log max level for stdout display (default=4)");
-    puts  ("  --log-append        Append instead of overwrite existing log file.\n");
+    puts  ("  --log-append        Append instead of overwrite existing log file.");
+    puts  ("  --log-async         Write log from background thread, drop if it can't keep up\n");
     puts  ("  --color             Use colorful logging (default yes on Win32)");
     puts  ("  --no-color          Disable colorful logging");
     puts  ("  --light-bg          Use dark colors for light background (default is dark bg)");
@@ -204,6 +205,14 @@ static void usage(void)
     puts  ("  --auto-answer=code  Automatically answer incoming calls with code (e.g. 200)");
     puts  ("  --max-calls=N       Maximum number of concurrent calls (default:4, max:255)");
     puts  ("  --thread-cnt=N      Number of worker threads (default:1)");
+    puts  ("  --thread-cpus=LIST  Pin SIP and media worker threads to the CPUs in the");
+    puts  ("                      comma separated LIST, one CPU per thread");
+    puts  ("  --clock-cpu=N       Pin the media clock thread of the null sound device");
+    puts  ("                      to CPU N");
+    puts  ("  --conf-threads=N    Number of conference bridge mixing threads (default:0)");
+    puts  ("  --conf-speakers=N   Only mix N active speakers in the conference bridge");
+    puts  ("  --conf-shared-enc   Encode the same audio only once for all calls");
+    puts  ("                      (default:0, mix all)");
     puts  ("  --duration=SEC      Set maximum call duration (default:no limit)");
     puts  ("  --norefersub        Suppress event subscription when transferring calls");
     puts  ("  --use-compact-form  Minimize SIP message size");
@@ -226,6 +235,28 @@ static void usage(void)
     fflush(stdout);
 }
 
+/* Parse comma separated list of CPUs */
+static int parse_cpu_list(const char *list, pjsua_thread_cfg *thread_cfg)
+{
+    const char *p = list;
+
+    thread_cfg->cpu_cnt = 0;
+    while (*p) {
+	if (*p < '0' || *p > '9' ||
+	    thread_cfg->cpu_cnt == PJ_ARRAY_SIZE(thread_cfg->cpu))
+	{
+	    return -1;
+	}
+	thread_cfg->cpu[thread_cfg->cpu_cnt++] = my_atoi(p);
+
+	while (*p >= '0' && *p <= '9')
+	    ++p;
+	if (*p == ',')
+	    ++p;
+    }
+    return thread_cfg->cpu_cnt ? 0 : -1;
+}
+
 static void log_writer_nobuf(int level, const char *buffer, int len)
 {
     pj_log_write(level, buffer, len);
@@ -346,7 +377,7 @@ static pj_status_t parse_args(int argc, char *argv[],
     int option_index;
     pjsua_app_config *cfg = &app_config;
     enum { OPT_CONFIG_FILE=127, OPT_LOG_FILE, OPT_LOG_LEVEL, OPT_APP_LOG_LEVEL,
-	   OPT_LOG_APPEND, OPT_COLOR, OPT_NO_COLOR, OPT_LIGHT_BG, OPT_NO_STDERR,
+	   OPT_LOG_APPEND, OPT_LOG_ASYNC, OPT_COLOR, OPT_NO_COLOR, OPT_LIGHT_BG, OPT_NO_STDERR,
 	   OPT_HELP, OPT_VERSION, OPT_NULL_AUDIO, OPT_SND_AUTO_CLOSE,
 	   OPT_LOCAL_PORT, OPT_IP_ADDR, OPT_PROXY, OPT_OUTBOUND_PROXY,
 	   OPT_REGISTRAR, OPT_REG_TIMEOUT, OPT_PUBLISH, OPT_ID, OPT_CONTACT,
@@ -366,6 +397,8 @@ static pj_status_t parse_args(int argc, char *argv[],
 	   OPT_RX_DROP_PCT, OPT_TX_DROP_PCT, OPT_EC_TAIL, OPT_EC_OPT,
 	   OPT_NEXT_ACCOUNT, OPT_NEXT_CRED, OPT_MAX_CALLS,
 	   OPT_DURATION, OPT_NO_TCP, OPT_NO_UDP, OPT_THREAD_CNT,
+	   OPT_THREAD_CPUS, OPT_CLOCK_CPU, OPT_CONF_THREADS,
+	   OPT_CONF_SPEAKERS, OPT_CONF_SHARED_ENC,
 	   OPT_NOREFERSUB, OPT_ACCEPT_REDIRECT,
 	   OPT_USE_TLS, OPT_TLS_CA_FILE, OPT_TLS_CERT_FILE, OPT_TLS_PRIV_FILE,
 	   OPT_TLS_PASSWORD, OPT_TLS_VERIFY_SERVER, OPT_TLS_VERIFY_CLIENT,
@@ -389,6 +422,7 @@ static pj_status_t parse_args(int argc, char *argv[],
 	{ "log-level",	1, 0, OPT_LOG_LEVEL},
 	{ "app-log-level",1,0,OPT_APP_LOG_LEVEL},
 	{ "log-append", 0, 0, OPT_LOG_APPEND},
+	{ "log-async",	0, 0, OPT_LOG_ASYNC},
 	{ "color",	0, 0, OPT_COLOR},
 	{ "no-color",	0, 0, OPT_NO_COLOR},
 	{ "light-bg",		0, 0, OPT_LIGHT_BG},
@@ -474,6 +508,11 @@ static pj_status_t parse_args(int argc, char *argv[],
 	{ "max-calls",	1, 0, OPT_MAX_CALLS},
 	{ "duration",	1, 0, OPT_DURATION},
 	{ "thread-cnt",	1, 0, OPT_THREAD_CNT},
+	{ "thread-cpus",1, 0, OPT_THREAD_CPUS},
+	{ "clock-cpu",	1, 0, OPT_CLOCK_CPU},
+	{ "conf-threads",1, 0, OPT_CONF_THREADS},
+	{ "conf-speakers",1, 0, OPT_CONF_SPEAKERS},
+	{ "conf-shared-enc",0, 0, OPT_CONF_SHARED_ENC},
 #if defined(PJSIP_HAS_TLS_TRANSPORT) && (PJSIP_HAS_TLS_TRANSPORT != 0)
 	{ "use-tls",	0, 0, OPT_USE_TLS},
 	{ "tls-ca-file",1, 0, OPT_TLS_CA_FILE},
@@ -589,6 +628,10 @@ static pj_status_t parse_args(int argc, char *argv[],
 	    cfg->log_cfg.log_file_flags |= PJ_O_APPEND;
 	    break;
 
+	case OPT_LOG_ASYNC:
+	    cfg->log_cfg.async = PJ_TRUE;
+	    break;
+
 	case OPT_COLOR:
 	    cfg->log_cfg.decor |= PJ_LOG_HAS_COLOR;
 	    break;
@@ -1120,6 +1163,37 @@ static pj_status_t parse_args(int argc, char *argv[],
 	    }
 	    break;
 
+	case OPT_THREAD_CPUS:
+	    if (parse_cpu_list(pj_optarg, &cfg->cfg.thread_cfg) != 0) {
+		PJ_LOG(1,(THIS_FILE,
+			  "Error: invalid --thread-cpus option"));
+		return -1;
+	    }
+	    cfg->media_cfg.thread_cfg = cfg->cfg.thread_cfg;
+	    break;
+
+	case OPT_CLOCK_CPU:
+	    cfg->media_cfg.clock_thread_cfg.cpu_cnt = 1;
+	    cfg->media_cfg.clock_thread_cfg.cpu[0] = my_atoi(pj_optarg);
+	    break;
+
+	case OPT_CONF_THREADS:
+	    cfg->media_cfg.conf_mix_threads = my_atoi(pj_optarg);
+	    if (cfg->media_cfg.conf_mix_threads > 64) {
+		PJ_LOG(1,(THIS_FILE,
+			  "Error: invalid --conf-threads option"));
+		return -1;
+	    }
+	    break;
+
+	case OPT_CONF_SPEAKERS:
+	    cfg->media_cfg.conf_active_speakers = my_atoi(pj_optarg);
+	    break;
+
+	case OPT_CONF_SHARED_ENC:
+	    cfg->media_cfg.conf_shared_encoding = PJ_TRUE;
+	    break;
+
 	case OPT_PTIME:
 	    cfg->media_cfg.ptime = my_atoi(pj_optarg);
 	    if (cfg->media_cfg.ptime < 10 || cfg->media_cfg.ptime > 1000) {
@@ -1798,6 +1872,10 @@ int write_settings(pjsua_app_config *config, char *buf, pj_size_t max)
 	pj_strcat2(&cfg, "--log-append\n");
     }
 
+    if (config->log_cfg.async) {
+	pj_strcat2(&cfg, "--log-async\n");
+    }
+
     /* Save account settings. */
     for (acc_index=0; acc_index < config->acc_cnt; ++acc_index) {
 
@@ -22,8 +22,19 @@
 /**
  * \page page_pjmedia_samples_confbench_c Samples: Benchmarking Conference Bridge
  *
- * Benchmarking pjmedia (conference bridge+resample). For my use only,
- * and it only works in Win32.
+ * Benchmarking pjmedia (conference bridge+resample). The bridge is clocked
+ * as fast as possible with an increasing number of mixing worker threads
+ * (see #pjmedia_conf_set_mix_threads()), and for each thread count the
+ * time to process one frame and the number of ports which each core can
+ * serve in real time are reported. The ports can be made to burn some CPU
+ * on every frame to simulate the cost of decoding and encoding, and the
+ * generators can be put in one large conference to measure active speaker
+ * mixing (see #pjmedia_conf_set_active_speakers()). The listeners can also
+ * be real streams which encode and send RTP to a loop transport, to measure
+ * encoding once for listeners which get the same mix (see
+ * #pjmedia_stream_enc_group_create()). Calls can also be added to and
+ * removed from the bridge by another thread while it is being clocked, to
+ * see how much this delays the frames.
  *
  * This file is pjsip-apps/src/samples/confbench.c
  *
@@ -32,14 +43,15 @@
 
 
 #include <pjmedia.h>
+#include <pjmedia-codec.h>
 #include <pjlib-util.h>	/* pj_getopt */
 #include <pjlib.h>
+#include <math.h>	/* sin()  */
 #include <stdlib.h>	/* atoi() */
 #include <stdio.h>
-#include <windows.h>
 
 /* For logging purpose. */
-#define THIS_FILE   "confsample.c"
+#define THIS_FILE   "confbench.c"
 
 
 /* Configurable:
@@ -64,12 +76,49 @@
 #  define SINE_CLOCK	    CLOCK_RATE
 #endif
 #define SINE_PTIME	    20
-#define DURATION	    10
 
 #define SINE_COUNT	    TEST_SET
 #define NULL_COUNT	    TEST_SET
 #define IDLE_COUNT	    32
 
+#define MAX_THREADS	    64
+
+/* Number of connections made in each direction by the churn thread */
+#define CHURN_CONNECT	    8
+
+
+static const char *desc = 
+ " confbench								\n"
+ "									\n"
+ " PURPOSE:								\n"
+ "  Measure how many ports per core the conference bridge can serve	\n"
+ "  with different number of mixing worker threads.			\n"
+ "									\n"
+ " USAGE:								\n"
+ "  confbench [options]							\n"
+ "									\n"
+ " Options:								\n"
+ "  -t THREADS   Maximum number of worker threads to test (default 3)	\n"
+ "  -n FRAMES    Number of frames to process per run (default 1000)	\n"
+ "  -l LOAD      CPU load per port per frame, in passes over the frame,	\n"
+ "               to simulate codec cost (default 0)			\n"
+ "  -r           Connect every generator to every listener, as in one	\n"
+ "               large conference					\n"
+ "  -s SPEAKERS  Only mix this many active speakers (default 0=all)	\n"
+ "  -c CODEC     Make the listeners streams with this codec, e.g.	\n"
+ "               speex/16000 (default: listeners are not streams)	\n"
+ "  -g           Put the streams in an encoding group			\n"
+ "  -x           Keep adding and removing calls in another thread	\n"
+ "  -p RATE      Clock rate of the generators and listeners, to have	\n"
+ "               them resampled (default: the bridge's, 16000)		\n";
+
+
+/* Number of passes over each frame, see burn() */
+static unsigned load;
+
+/* Prevent the compiler from optimizing burn() away */
+static volatile unsigned burn_sink;
+
 
 static void app_perror(const char *sender, const char *title, pj_status_t status)
 {
@@ -80,55 +129,206 @@ static void app_perror(const char *sender, const char *title, pj_status_t status
 }
 
 
-struct Times
+/* Simulate the work of a codec on the frame. */
+static void burn(const pj_int16_t *samples, unsigned count)
 {
-    FILETIME	    kernel_time;
-    ULARGE_INTEGER  u_kernel_time;
-    FILETIME	    user_time;
-    ULARGE_INTEGER  u_user_time;
-    ULARGE_INTEGER  u_total;
-};
-
-static void process(struct Times *t)
+    unsigned i, j, sum = 0;
+
+    for (j=0; j<load; ++j) {
+	for (i=0; i<count; ++i)
+	    sum += pjmedia_linear2ulaw(samples[i] + j);
+    }
+    burn_sink += sum;
+}
+
+
+/* Listener port which simulates encoding of the frames it receives. */
+static pj_status_t load_put_frame( pjmedia_port *port,
+				   pjmedia_frame *frame)
 {
-    pj_memcpy(&t->u_kernel_time, &t->kernel_time, sizeof(FILETIME));
-    pj_memcpy(&t->u_user_time, &t->user_time, sizeof(FILETIME));
-    t->u_total.QuadPart = t->u_kernel_time.QuadPart + t->u_user_time.QuadPart;
+    PJ_UNUSED_ARG(port);
+
+    if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO)
+	burn((const pj_int16_t*)frame->buf, (unsigned)frame->size / 2);
+    return PJ_SUCCESS;
 }
 
-static void benchmark(void)
+static pj_status_t load_get_frame( pjmedia_port *port,
+				   pjmedia_frame *frame)
 {
-    FILETIME creation_time, exit_time;
-    struct Times start, end;
-    DWORD ts, te;
-    LARGE_INTEGER elapsed;
-    BOOL rc;
-    int i;
-    double pct;
-
-    puts("Test started!"); fflush(stdout);
-
-    ts = GetTickCount();
-    rc = GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time,
-			 &start.kernel_time, &start.user_time);
-    for (i=DURATION; i>0; --i) {
-	printf("\r%d ", i); fflush(stdout);
-	pj_thread_sleep(1000);
+    PJ_UNUSED_ARG(port);
+
+    frame->type = PJMEDIA_FRAME_TYPE_NONE;
+    frame->size = 0;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t create_load_port(pj_pool_t *pool,
+				    unsigned clock_rate,
+				    unsigned samples_per_frame,
+				    pjmedia_port **p_port)
+{
+    pjmedia_port *port;
+    pj_str_t port_name = pj_str("load");
+
+    port = pj_pool_zalloc(pool, sizeof(pjmedia_port));
+    PJ_ASSERT_RETURN(port != NULL, PJ_ENOMEM);
+
+    pjmedia_port_info_init(&port->info, &port_name, 12346, clock_rate, 1,
+			   16, samples_per_frame);
+    port->get_frame = &load_get_frame;
+    port->put_frame = &load_put_frame;
+
+    *p_port = port;
+    return PJ_SUCCESS;
+}
+
+
+/* Listener stream which sends RTP to a loop transport. */
+typedef struct
+{
+    pjmedia_stream	*stream;
+    pjmedia_transport	*tp;
+} stream_listener;
+
+static pj_status_t create_stream_port(pjmedia_endpt *endpt,
+				      pj_pool_t *pool,
+				      const char *codec,
+				      pjmedia_stream_enc_group *grp,
+				      stream_listener *sl,
+				      pjmedia_port **p_port)
+{
+    pj_str_t codec_id = pj_str((char*)codec);
+    const pjmedia_codec_info *ci[1];
+    unsigned count = 1;
+    pjmedia_stream_info si;
+    pj_status_t status;
+
+    status = pjmedia_codec_mgr_find_codecs_by_id(
+			pjmedia_endpt_get_codec_mgr(endpt),
+			&codec_id, &count, ci, NULL);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pj_bzero(&si, sizeof(si));
+    si.type = PJMEDIA_TYPE_AUDIO;
+    si.proto = PJMEDIA_TP_PROTO_RTP_AVP;
+    si.dir = PJMEDIA_DIR_ENCODING_DECODING;
+    pj_sockaddr_in_init(&si.rem_addr.ipv4, NULL, 4000);
+    pj_sockaddr_in_init(&si.rem_rtcp.ipv4, NULL, 4001);
+    pj_memcpy(&si.fmt, ci[0], sizeof(pjmedia_codec_info));
+    si.tx_pt = ci[0]->pt;
+    si.tx_event_pt = 101;
+    si.rx_event_pt = 101;
+    si.ssrc = pj_rand();
+    si.jb_init = si.jb_min_pre = si.jb_max_pre = si.jb_max = -1;
+    si.rx_queue_pkt_cnt = -1;
+
+    status = pjmedia_transport_loop_create(endpt, &sl->tp);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pjmedia_stream_create(endpt, pool, &si, sl->tp, NULL,
+				   &sl->stream);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* Don't receive our own packets */
+    pjmedia_transport_loop_disable_rx(sl->tp, sl->stream, PJ_TRUE);
+
+    if (grp) {
+	status = pjmedia_stream_set_enc_group(sl->stream, grp);
+	if (status != PJ_SUCCESS)
+	    return status;
     }
-    rc = GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time,
-			 &end.kernel_time, &end.user_time);
-    te = GetTickCount();
 
-    process(&start);
-    process(&end);
+    status = pjmedia_stream_start(sl->stream);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    return pjmedia_stream_get_port(sl->stream, p_port);
+}
+
+
+/* Thread which keeps adding calls to the bridge and removing them, as
+ * in a busy server.
+ */
+typedef struct
+{
+    pjmedia_conf	*conf;
+    pj_pool_factory	*pf;
+    const unsigned	*src_slots;
+    const unsigned	*dst_slots;
+    unsigned		 slot_cnt;
+    volatile pj_bool_t	 quit;
+    unsigned		 call_cnt;
+} churn_data;
+
+/* A port of the churn thread, allocated from its own pool */
+typedef struct
+{
+    pjmedia_port	*port;
+    pj_pool_t		*pool;
+} churn_port;
 
-    elapsed.QuadPart = end.u_total.QuadPart - start.u_total.QuadPart;
+/* Called when the bridge has released the port, or from the churn thread
+ * if the port was not added.
+ */
+static void churn_port_removed(pjmedia_conf *conf, unsigned slot,
+			       void *user_data)
+{
+    churn_port *cp = (churn_port*) user_data;
+    pj_pool_t *pool = cp->pool;
 
-    pct = elapsed.QuadPart * 100.0 / ((te-ts)*10000.0);
+    PJ_UNUSED_ARG(conf);
+    PJ_UNUSED_ARG(slot);
 
-    printf("CPU usage=%6.4f%%\n", pct); fflush(stdout);
+    pjmedia_port_destroy(cp->port);
+    pj_pool_release(pool);
 }
 
+static int churn_thread(void *arg)
+{
+    churn_data *cd = (churn_data*) arg;
+
+    while (!cd->quit) {
+	pj_pool_t *pool;
+	churn_port *cp;
+	unsigned slot, i, j;
+	pj_status_t status;
+
+	pool = pj_pool_create(cd->pf, "churn", 4000, 4000, NULL);
+	cp = PJ_POOL_ZALLOC_T(pool, churn_port);
+	cp->pool = pool;
+
+	/* Use a different clock rate, so that the bridge has to create
+	 * resamplers for the port.
+	 */
+	status = pjmedia_null_port_create(pool, 8000, 1, 160, 16, &cp->port);
+	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
+
+	status = pjmedia_conf_add_port(cd->conf, pool, cp->port, NULL, &slot);
+	if (status == PJ_SUCCESS) {
+	    for (i=0; i<CHURN_CONNECT; ++i) {
+		j = (cd->call_cnt + i) % cd->slot_cnt;
+		pjmedia_conf_connect_port(cd->conf, cd->src_slots[j], slot, 0);
+		pjmedia_conf_connect_port(cd->conf, slot, cd->dst_slots[j], 0);
+	    }
+
+	    /* Don't wait for the clock, the port is destroyed by the
+	     * callback.
+	     */
+	    pjmedia_conf_remove_port2(cd->conf, slot, cp,
+				      &churn_port_removed);
+	} else {
+	    churn_port_removed(cd->conf, 0, cp);
+	}
+
+	++cd->call_cnt;
+    }
+
+    return 0;
+}
 
 
 /* Struct attached to sine generator */
@@ -165,6 +365,9 @@ static pj_status_t sine_get_frame( pjmedia_port *port,
 	}
     }
 
+    /* Simulate decoding */
+    burn(frame->buf, (unsigned)count);
+
     /* Must set frame->type correctly, otherwise the sound device
      * will refuse to play.
      */
@@ -226,19 +429,108 @@ static pj_status_t create_sine_port(pj_pool_t *pool,
     return PJ_SUCCESS;
 }
 
-int main()
+/*
+ * Clock the bridge for frame_cnt frames and return the average time
+ * to process one frame, in usec. The longest time is returned in max_usec.
+ */
+static double run(pjmedia_port *conf_port, unsigned frame_cnt,
+		  unsigned *max_usec)
+{
+    pj_int16_t buf[SAMPLES_PER_FRAME];
+    pjmedia_frame frame;
+    pj_timestamp t0, t1, t2;
+    unsigned i;
+
+    *max_usec = 0;
+    pj_bzero(&frame, sizeof(frame));
+    pj_get_timestamp(&t0);
+    t1 = t0;
+    for (i=0; i<frame_cnt; ++i) {
+	unsigned usec;
+
+	frame.buf = buf;
+	frame.size = sizeof(buf);
+	frame.timestamp.u64 = (pj_uint64_t)i * SAMPLES_PER_FRAME;
+	pjmedia_port_get_frame(conf_port, &frame);
+
+	pj_get_timestamp(&t2);
+	usec = pj_elapsed_usec(&t1, &t2);
+	if (usec > *max_usec)
+	    *max_usec = usec;
+	t1 = t2;
+    }
+
+    return pj_elapsed_usec(&t0, &t1) * 1.0 / frame_cnt;
+}
+
+int main(int argc, char *argv[])
 {
     pj_caching_pool cp;
     pjmedia_endpt *med_endpt;
     pj_pool_t *pool;
     pjmedia_conf *conf;
-    int i;
-    pjmedia_port *sine_port[SINE_COUNT], *null_port, *conf_port;
+    int i, c;
+    pjmedia_port *sine_port[SINE_COUNT], *conf_port;
     pjmedia_port *nulls[NULL_COUNT];
     unsigned null_slots[NULL_COUNT];
-    pjmedia_master_port *master_port;
+    unsigned sine_slots[SINE_COUNT];
+    unsigned max_threads = 3, frame_cnt = 1000, thread_cnt, port_cnt;
+    unsigned spk_cnt = 0;
+    pj_bool_t room = PJ_FALSE;
+    const char *codec = NULL;
+    pj_bool_t use_grp = PJ_FALSE;
+    pjmedia_stream_enc_group *grp = NULL;
+    stream_listener streams[NULL_COUNT];
+    pj_bool_t churn = PJ_FALSE;
+    churn_data cd;
+    pj_thread_t *churn_thd = NULL;
+    unsigned max_usec;
+    unsigned sine_rate = SINE_CLOCK, load_rate = CLOCK_RATE;
+    double base_usec = 0, ptime_usec;
     pj_status_t status;
 
+    while ((c=pj_getopt(argc, argv, "t:n:l:rs:c:gxp:h")) != -1) {
+	switch (c) {
+	case 't':
+	    max_threads = atoi(pj_optarg);
+	    if (max_threads > MAX_THREADS)
+		max_threads = MAX_THREADS;
+	    break;
+	case 'n':
+	    frame_cnt = atoi(pj_optarg);
+	    if (frame_cnt == 0)
+		frame_cnt = 1;
+	    break;
+	case 'l':
+	    load = atoi(pj_optarg);
+	    break;
+	case 'r':
+	    room = PJ_TRUE;
+	    break;
+	case 's':
+	    spk_cnt = atoi(pj_optarg);
+	    break;
+	case 'c':
+	    codec = pj_optarg;
+	    break;
+	case 'g':
+	    use_grp = PJ_TRUE;
+	    break;
+	case 'x':
+	    churn = PJ_TRUE;
+	    break;
+	case 'p':
+	    sine_rate = load_rate = atoi(pj_optarg);
+	    if (sine_rate < 8000 || sine_rate > 48000) {
+		puts(desc);
+		return 1;
+	    }
+	    break;
+	default:
+	    puts(desc);
+	    return 1;
+	}
+    }
 
     pj_log_set_level(3);
 
@@ -269,13 +561,35 @@ int main()
 	return 1;
     }
 
-    printf("Resampling is %s\n", (HAS_RESAMPLE?"active":"disabled"));
+    printf("Generators run at %u Hz, the bridge at %u Hz\n", sine_rate,
+	   CLOCK_RATE);
 
-    /* Create Null ports */
-    printf("Creating %d null ports..\n", NULL_COUNT);
-    for (i=0; i<NULL_COUNT; ++i) {
-	status = pjmedia_null_port_create(pool, CLOCK_RATE, 1, SAMPLES_PER_FRAME*2, 16, &nulls[i]);
+    if (codec) {
+	status = pjmedia_codec_register_audio_codecs(med_endpt, NULL);
+	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
+    }
+
+    if (codec && use_grp) {
+	status = pjmedia_stream_enc_group_create(med_endpt, &grp);
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
+    }
+
+    /* Create listener ports */
+    printf("Creating %d listener ports..\n", NULL_COUNT);
+    pj_bzero(streams, sizeof(streams));
+    for (i=0; i<NULL_COUNT; ++i) {
+	if (codec) {
+	    status = create_stream_port(med_endpt, pool, codec, grp,
+					&streams[i], &nulls[i]);
+	    if (status != PJ_SUCCESS) {
+		app_perror(THIS_FILE, "Unable to create stream", status);
+		return 1;
+	    }
+	} else {
+	    status = create_load_port(pool, load_rate, load_rate / 50,
+				      &nulls[i]);
+	    PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
+	}
 
 	status = pjmedia_conf_add_port(conf, pool, nulls[i], NULL, &null_slots[i]);
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
@@ -284,10 +598,10 @@ int main()
     /* Create sine ports. */
     printf("Creating %d sine generator ports..\n", SINE_COUNT);
     for (i=0; i<SINE_COUNT; ++i) {
-	unsigned j, slot;
+	unsigned slot;
 
 	/* Load the WAV file to file port. */
-	status = create_sine_port(pool, SINE_CLOCK, 1, &sine_port[i]);
+	status = create_sine_port(pool, sine_rate, 1, &sine_port[i]);
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
 
 	/* Add the file port to conference bridge */
@@ -301,14 +615,32 @@ int main()
 	    app_perror(THIS_FILE, "Unable to add conference port", status);
 	    return 1;
 	}
+	sine_slots[i] = slot;
 
 	status = pjmedia_conf_connect_port(conf, slot, 0, 0);
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
 
-	for (j=0; j<NULL_COUNT; ++j) {
-	    status = pjmedia_conf_connect_port(conf, slot, null_slots[j], 0);
-	    PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
+	if (room) {
+	    int j;
+
+	    /* Every listener hears all generators */
+	    for (j=0; j<NULL_COUNT; ++j) {
+		status = pjmedia_conf_connect_port(conf, slot,
+						   null_slots[j], 0);
+		PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
+	    }
+	    continue;
 	}
+
+	/* Each listener hears a few of the generators, like in a
+	 * number of small conferences.
+	 */
+	status = pjmedia_conf_connect_port(conf, slot,
+					   null_slots[i % NULL_COUNT], 0);
+	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
+	status = pjmedia_conf_connect_port(conf, slot,
+					   null_slots[(i+1) % NULL_COUNT], 0);
+	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
     }
 
     /* Create idle ports */
@@ -321,28 +653,83 @@ int main()
 	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
     }
 
-    /* Create null port */
-    status = pjmedia_null_port_create(pool, CLOCK_RATE, 1, SAMPLES_PER_FRAME, 16,
-				      &null_port);
-    PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
+    status = pjmedia_conf_set_active_speakers(conf, spk_cnt);
+    if (status != PJ_SUCCESS) {
+	app_perror(THIS_FILE, "Unable to set active speakers", status);
+	return 1;
+    }
 
     conf_port = pjmedia_conf_get_master_port(conf);
+    port_cnt = pjmedia_conf_get_port_count(conf);
+    ptime_usec = SAMPLES_PER_FRAME * 1000000.0 / CLOCK_RATE;
+
+    /* Warm up */
+    run(conf_port, frame_cnt / 10 + 1, &max_usec);
+
+    if (churn) {
+	pj_bzero(&cd, sizeof(cd));
+	cd.conf = conf;
+	cd.pf = &cp.factory;
+	cd.src_slots = sine_slots;
+	cd.dst_slots = null_slots;
+	cd.slot_cnt = PJ_MIN(SINE_COUNT, NULL_COUNT);
+
+	status = pj_thread_create(pool, "churn", &churn_thread, &cd, 0, 0,
+				  &churn_thd);
+	PJ_ASSERT_RETURN(status == PJ_SUCCESS, 1);
+    }
 
-    /* Create master port */
-    status = pjmedia_master_port_create(pool, null_port, conf_port, 0, &master_port);
-
-
-    pjmedia_master_port_start(master_port);
-
-    puts("Waiting to settle.."); fflush(stdout);
-    pj_thread_sleep(5000);
+    printf("%u ports, load %u, %u frames per run, %s, active speakers %u\n",
+	   port_cnt, load, frame_cnt,
+	   (room ? "one conference" : "small conferences"), spk_cnt);
+    if (codec) {
+	printf("Listeners are %s streams, %s encoding group\n", codec,
+	       (grp ? "with" : "without"));
+    }
+    printf("Threads  Usec/frame  Max usec  Speedup  Ports/core\n");
+    for (thread_cnt=0; thread_cnt<=max_threads; ++thread_cnt) {
+	double usec;
 
+	status = pjmedia_conf_set_mix_threads(conf, thread_cnt);
+	if (status != PJ_SUCCESS) {
+	    app_perror(THIS_FILE, "Unable to set mixing threads", status);
+	    break;
+	}
 
-    benchmark();
+	usec = run(conf_port, frame_cnt, &max_usec);
+	if (thread_cnt == 0)
+	    base_usec = usec;
+
+	/* The calling thread does its share of the work, so thread_cnt
+	 * workers keep thread_cnt+1 cores busy.
+	 */
+	printf("%7u  %10.1f  %8u  %6.2fx  %10.1f\n", thread_cnt, usec,
+	       max_usec, base_usec / usec,
+	       port_cnt * ptime_usec / usec / (thread_cnt + 1));
+	fflush(stdout);
+    }
 
+    if (churn_thd) {
+	cd.quit = PJ_TRUE;
+	pj_thread_join(churn_thd);
+	pj_thread_destroy(churn_thd);
+	printf("%u calls were added and removed\n", cd.call_cnt);
+    }
 
     /* Done. */
+    pjmedia_conf_destroy(conf);
+    for (i=0; i<NULL_COUNT; ++i) {
+	if (streams[i].stream)
+	    pjmedia_stream_destroy(streams[i].stream);
+	if (streams[i].tp)
+	    pjmedia_transport_close(streams[i].tp);
+    }
+    if (grp)
+	pjmedia_stream_enc_group_destroy(grp);
+    pjmedia_endpt_destroy(med_endpt);
+    pj_pool_release(pool);
+    pj_caching_pool_destroy(&cp);
+    pj_shutdown();
+
     return 0;
 }
-
-
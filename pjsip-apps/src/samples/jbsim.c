@@ -92,6 +92,8 @@ struct stream
 	/* RX stream state */
 	struct {
 	    pj_time_val	next_schedule;	/* Time to fetch next pkt   */
+	    unsigned	total_get;	/* # of GET so far	    */
+	    unsigned	total_null;	/* # of NULL frames so far  */
 	} rx;
     } state;
 };
@@ -139,6 +141,7 @@ struct test_cfg
     unsigned	     tx_min_lost_burst;	/* Min lost burst in #pkt   */
     unsigned	     tx_max_lost_burst;	/* Max lost burst in #pkt   */
     unsigned	     tx_pct_loss_corr;	/* Loss correlation in pct  */
+    const char	    *tx_trace;		/* Packet delay trace file  */
 
     /* Receiver setting */
     const char	    *rx_wav_out;	/* Output WAV file	    */
@@ -149,6 +152,16 @@ struct test_cfg
     int		     rx_jb_min_pre;	/* JB minimum prefetch (ms) */
     int		     rx_jb_max_pre;	/* JB maximum prefetch (ms) */
     int		     rx_jb_max;		/* JB maximum size (ms)	    */
+    pj_bool_t	     rx_jb_time_scale;	/* JB time-scaling enabled? */
+};
+
+/* Packet delay trace, a negative delay means the packet was lost */
+#define TRACE_LOST	-1
+
+struct trace
+{
+    unsigned	     count;		/* Number of packets	    */
+    int		    *delay;		/* Jitter of each packet, ms*/
 };
 
 /*
@@ -173,6 +186,8 @@ struct global_app
     pjmedia_port	*rx_wav;
 
     pj_time_val		 wall_clock;
+
+    struct trace	 trace;
 };
 
 static struct global_app g_app;
@@ -333,6 +348,7 @@ static pj_status_t stream_init(const struct stream_cfg *cfg, struct stream **p_s
 	si.jb_min_pre = g_app.cfg.rx_jb_min_pre;
 	si.jb_max_pre = g_app.cfg.rx_jb_max_pre;
 	si.jb_max = g_app.cfg.rx_jb_max;
+	si.jb_time_scale = g_app.cfg.rx_jb_time_scale;
     }
 
     /* Get the codec info and param */
@@ -432,6 +448,71 @@ static void test_destroy(void)
 }
 
 
+/* Load the packet delay trace. The file contains the network delay of
+ * each packet in msec, one packet per line, or "-" if the packet was lost.
+ * Empty lines and lines starting with '#' are ignored. The delay is
+ * converted to jitter by subtracting the minimum delay.
+ */
+static pj_status_t load_trace(const char *filename)
+{
+    FILE *f;
+    char line[80];
+    unsigned max_count = 1024, i;
+    int min_delay = -1;
+
+    f = fopen(filename, "r");
+    if (!f)
+	return PJ_ENOTFOUND;
+
+    g_app.trace.delay = (int*)
+			pj_pool_alloc(g_app.pool, max_count * sizeof(int));
+
+    while (fgets(line, sizeof(line), f)) {
+	char *p = line;
+	int delay;
+
+	while (pj_isspace(*p))
+	    ++p;
+	if (*p == '\0' || *p == '#')
+	    continue;
+
+	if (*p == '-') {
+	    delay = TRACE_LOST;
+	} else if (pj_isdigit(*p)) {
+	    delay = atoi(p);
+	    if (min_delay < 0 || delay < min_delay)
+		min_delay = delay;
+	} else {
+	    fclose(f);
+	    return PJ_EINVAL;
+	}
+
+	if (g_app.trace.count == max_count) {
+	    int *delay_buf;
+
+	    max_count *= 2;
+	    delay_buf = (int*)
+			pj_pool_alloc(g_app.pool, max_count * sizeof(int));
+	    pj_memcpy(delay_buf, g_app.trace.delay,
+		      g_app.trace.count * sizeof(int));
+	    g_app.trace.delay = delay_buf;
+	}
+	g_app.trace.delay[g_app.trace.count++] = delay;
+    }
+    fclose(f);
+
+    if (g_app.trace.count == 0)
+	return PJ_EINVAL;
+
+    for (i=0; i<g_app.trace.count; ++i) {
+	if (g_app.trace.delay[i] != TRACE_LOST)
+	    g_app.trace.delay[i] -= min_delay;
+    }
+
+    return PJ_SUCCESS;
+}
+
+
 static pj_status_t test_init(void)
 {
     struct stream_cfg strm_cfg;
@@ -447,6 +528,15 @@ static pj_status_t test_init(void)
     /* Pool */
     g_app.pool = pj_pool_create(&g_app.cp.factory, "g_app", 512, 512, NULL);
 
+    /* Packet delay trace */
+    if (g_app.cfg.tx_trace) {
+	status = load_trace(g_app.cfg.tx_trace);
+	if (status != PJ_SUCCESS) {
+	    jbsim_perror("Error reading trace file", status);
+	    goto on_error;
+	}
+    }
+
     /* Log file */
     if (g_app.cfg.log_file) {
 	status = pj_file_open(g_app.pool, g_app.cfg.log_file, 
@@ -609,6 +699,8 @@ static void tx_tick(const pj_time_val *t)
 
     while (PJ_TIME_VAL_GTE(*t, strm->state.tx.next_schedule)) {
 	struct log_entry entry;
+	pjmedia_rtcp_stat stat;
+	pjmedia_jb_state jstate;
 	pj_bool_t drop_this_pkt = PJ_FALSE;
 	int jitter;
 
@@ -619,7 +711,12 @@ static void tx_tick(const pj_time_val *t)
 	/* 
 	 * Determine whether to drop this packet 
 	 */
-	if (strm->state.tx.cur_lost_burst) {
+	if (g_app.trace.count) {
+	    /* Replay the trace */
+	    unsigned idx = strm->state.tx.total_tx % g_app.trace.count;
+	    drop_this_pkt = (g_app.trace.delay[idx] == TRACE_LOST);
+
+	} else if (strm->state.tx.cur_lost_burst) {
 	    /* We are currently dropping packet */
 
 	    /* Make it comply to minimum lost burst */
@@ -645,7 +742,7 @@ static void tx_tick(const pj_time_val *t)
 	}
 
 	/* If we're not dropping packet then use randomly distributed loss */
-	if (!drop_this_pkt &&
+	if (!drop_this_pkt && g_app.trace.count == 0 &&
 	    MAX(strm->state.tx.total_lost-LOSS_EXTRA,0) * 100 / MAX(strm->state.tx.total_tx,1) < g_app.cfg.tx_pct_avg_lost)
 	{
 	    strm->state.tx.drop_prob = pj_rand() % 100;
@@ -667,8 +764,6 @@ static void tx_tick(const pj_time_val *t)
 	    ++strm->state.tx.cur_lost_burst;
 
 	} else {
-	    pjmedia_rtcp_stat stat;
-	    pjmedia_jb_state jstate;
 	    unsigned last_discard;
 
 	    pjmedia_stream_get_stat_jbuf(g_app.rx->strm, &jstate);
@@ -684,6 +779,7 @@ static void tx_tick(const pj_time_val *t)
 	    entry.stat = &stat;
 	    entry.log = log_msg;
 
+	    log_msg[0] = '\0';
 	    if (jstate.discard > last_discard)
 		strcat(log_msg, "** Note: packet was discarded by jitter buffer **");
 
@@ -699,7 +795,12 @@ static void tx_tick(const pj_time_val *t)
 	strm->state.tx.next_schedule.msec = (strm->state.tx.total_tx + 1) * pkt_interval;
 
 	/* Apply jitter */
-	if (g_app.cfg.tx_max_jitter || g_app.cfg.tx_min_jitter) {
+	if (g_app.trace.count) {
+	    /* Jitter from the trace, lost packet is sent in time */
+	    unsigned idx = strm->state.tx.total_tx % g_app.trace.count;
+	    jitter = PJ_MAX(g_app.trace.delay[idx], 0);
+
+	} else if (g_app.cfg.tx_max_jitter || g_app.cfg.tx_min_jitter) {
 
 	    if (g_app.cfg.tx_max_jitter == g_app.cfg.tx_min_jitter) {
 		/* Fixed jitter */
@@ -798,8 +899,11 @@ static void rx_tick(const pj_time_val *t)
 
 	    if (jstate.empty > last_empty)
 		strcat(msg, "** JBUF was empty **");
-	    if (!has_frame)
+	    if (!has_frame) {
 		strcat(msg, "** NULL frame was returned **");
+		++strm->state.rx.total_null;
+	    }
+	    ++strm->state.rx.total_get;
 
 	    write_log(&entry, PJ_TRUE);
 
@@ -857,6 +961,8 @@ enum {
     OPT_MIN_LOST_BURST = 1,
     OPT_MAX_LOST_BURST,
     OPT_LOSS_CORR,
+    OPT_TRACE,
+    OPT_JB_TIME_SCALE,
 };
 
 
@@ -893,6 +999,10 @@ static void usage(void)
     printf("  --loss-corr PCT        Set the loss correlation to PCT percent. Default: 0\n");
     printf("  --min-lost-burst N     Set minimum packet lost burst (default:%d)\n", MIN_LOST_BURST);
     printf("  --max-lost-burst N     Set maximum packet lost burst (default:%d)\n", MAX_LOST_BURST);
+    printf("  --trace FILE           Replay the packet delay trace in FILE instead of\n");
+    printf("                         simulating loss and jitter. FILE contains the network\n");
+    printf("                         delay of each packet in msec, one packet per line,\n");
+    printf("                         or \"-\" for lost packet.\n");
     printf("  --min-jitter, -%c MSEC  Set minimum network jitter to MSEC\n", OPT_MIN_JITTER);
     printf("                         Default: 0\n");
     printf("  --max-jitter, -%c MSEC  Set maximum network jitter to MSEC\n", OPT_MAX_JITTER);
@@ -910,6 +1020,8 @@ static void usage(void)
     printf("  --jb-max-pre, -%c MSEC  Jitter buffer maximum prefetch delay in msec\n", OPT_JB_MAX_PRE);
     printf("  --jb-max, -%c MSEC      Set maximum delay that can be accomodated by the\n", OPT_JB_MAX);
     printf("                         jitter buffer msec.\n");
+    printf("  --jb-time-scale        Adjust jitter buffer latency by time-scaling the\n");
+    printf("                         playout (WSOLA) instead of discarding frames\n");
 }
 
 
@@ -925,6 +1037,7 @@ static int init_options(int argc, char *argv[])
 	{ "min-lost-burst", 1, 0, OPT_MIN_LOST_BURST},
 	{ "max-lost-burst", 1, 0, OPT_MAX_LOST_BURST},
 	{ "loss-corr",	    1, 0, OPT_LOSS_CORR},
+	{ "trace",	    1, 0, OPT_TRACE},
 	{ "min-jitter",	    1, 0, OPT_MIN_JITTER },
 	{ "max-jitter",	    1, 0, OPT_MAX_JITTER },
 	{ "snd-burst",	    1, 0, OPT_SND_BURST },
@@ -936,6 +1049,7 @@ static int init_options(int argc, char *argv[])
 	{ "jb-min-pre",     1, 0, OPT_JB_MIN_PRE },
 	{ "jb-max-pre",     1, 0, OPT_JB_MAX_PRE },
 	{ "jb-max",	    1, 0, OPT_JB_MAX },
+	{ "jb-time-scale",  0, 0, OPT_JB_TIME_SCALE },
 	{ "help",	    0, 0, OPT_HELP},
 	{ NULL, 0, 0, 0 },
     };
@@ -1025,6 +1139,9 @@ static int init_options(int argc, char *argv[])
 		return 1;
 	    }
 	    break;
+	case OPT_TRACE:
+	    g_app.cfg.tx_trace = pj_optarg;
+	    break;
 	case OPT_MIN_JITTER:
 	    g_app.cfg.tx_min_jitter = atoi(pj_optarg);
 	    break;
@@ -1058,6 +1175,9 @@ static int init_options(int argc, char *argv[])
 	case OPT_JB_MAX:
 	    g_app.cfg.rx_jb_max = atoi(pj_optarg);
 	    break;
+	case OPT_JB_TIME_SCALE:
+	    g_app.cfg.rx_jb_time_scale = PJ_TRUE;
+	    break;
 	case OPT_HELP:
 	    usage();
 	    return 1;
@@ -1084,6 +1204,28 @@ static int init_options(int argc, char *argv[])
     return 0;
 }
 
+/* Print the latency and quality of the receiver playout */
+static void print_rx_stat(void)
+{
+    struct stream *strm = g_app.rx;
+    pjmedia_jb_state jstate;
+
+    pjmedia_stream_get_stat_jbuf(strm->strm, &jstate);
+
+    PJ_LOG(3,(THIS_FILE, " RX frames=%u, null=%u/%5.1f%%",
+	      strm->state.rx.total_get,
+	      strm->state.rx.total_null,
+	      (float)(strm->state.rx.total_null * 100.0 /
+		      MAX(strm->state.rx.total_get, 1))));
+    PJ_LOG(3,(THIS_FILE, " JB delay min=%ums, avg=%ums, max=%ums, dev=%ums",
+	      jstate.min_delay, jstate.avg_delay, jstate.max_delay,
+	      jstate.dev_delay));
+    PJ_LOG(3,(THIS_FILE, " JB lost=%u, discard=%u, empty=%u, "
+	      "compress=%u, stretch=%u",
+	      jstate.lost, jstate.discard, jstate.empty,
+	      jstate.compress, jstate.stretch));
+}
+
 /*****************************************************************************
  * main()
  */
@@ -1114,11 +1256,17 @@ int main(int argc, char *argv[])
     PJ_LOG(3,(THIS_FILE, " TX jitter min=%dms, max=%dms",
 	      g_app.cfg.tx_min_jitter, 
 	      g_app.cfg.tx_max_jitter));
+    if (g_app.cfg.tx_trace) {
+	PJ_LOG(3,(THIS_FILE, " TX trace=%s (%u packets)",
+		  g_app.cfg.tx_trace, g_app.trace.count));
+    }
     PJ_LOG(3,(THIS_FILE, " RX jb init:%dms, min_pre=%dms, max_pre=%dms, max=%dms",
 	      g_app.cfg.rx_jb_init,
 	      g_app.cfg.rx_jb_min_pre,
 	      g_app.cfg.rx_jb_max_pre,
 	      g_app.cfg.rx_jb_max));
+    PJ_LOG(3,(THIS_FILE, " RX jb time-scale=%d",
+	      g_app.cfg.rx_jb_time_scale));
     PJ_LOG(3,(THIS_FILE, " RX sound burst:%d frames",
 	      g_app.cfg.rx_snd_burst));
     PJ_LOG(3,(THIS_FILE, " DTX=%d, PLC=%d",
@@ -1133,6 +1281,7 @@ int main(int argc, char *argv[])
 	      g_app.tx->state.tx.total_tx,
 	      g_app.tx->state.tx.total_lost,
 	      (float)(g_app.tx->state.tx.total_lost * 100.0 / g_app.tx->state.tx.total_tx)));
+    print_rx_stat();
 
     /* Done */
     test_destroy();
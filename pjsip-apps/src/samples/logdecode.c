@@ -0,0 +1,71 @@
+/* $Id$ */
+/* 
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
+ */
+
+/**
+ * \page page_logdecode_c Samples: Decode binary log file
+ *
+ * This sample decodes the binary log file written by asynchronous logging
+ * with \a binary_file setting (see #pj_log_async_start()), and prints the
+ * messages to stdout.
+ *
+ * This file is pjsip-apps/src/samples/logdecode.c
+ *
+ * \includelineno logdecode.c
+ */
+
+#include <pjlib.h>
+#include <stdio.h>
+
+static void print_msg(int level, const char *data, int len)
+{
+    PJ_UNUSED_ARG(level);
+    fwrite(data, 1, len, stdout);
+}
+
+/*
+ * main()
+ */
+int main(int argc, char *argv[])
+{
+    char errmsg[PJ_ERR_MSG_SIZE];
+    pj_status_t status;
+
+    if (argc != 2) {
+	puts("Usage: logdecode FILE");
+	return 1;
+    }
+
+    pj_log_set_level(3);
+
+    status = pj_init();
+    if (status != PJ_SUCCESS) {
+	puts("Error: pj_init() failed");
+	return 1;
+    }
+
+    status = pj_log_decode_file(argv[1], &print_msg);
+    if (status != PJ_SUCCESS) {
+	pj_strerror(status, errmsg, sizeof(errmsg));
+	fprintf(stderr, "Error decoding %s: %s\n", argv[1], errmsg);
+    }
+
+    pj_shutdown();
+    return status == PJ_SUCCESS ? 0 : 1;
+}
@@ -253,7 +253,7 @@ static pj_bool_t proxy_on_rx_request( pjsip_rx_data *rdata )
 	/* Find the UAS INVITE transaction */
 	pjsip_tsx_create_key(rdata->tp_info.pool, &key, PJSIP_UAS_ROLE,
 			     pjsip_get_invite_method(), rdata);
-	invite_uas = pjsip_tsx_layer_find_tsx(&key, PJ_TRUE);
+	invite_uas = pjsip_tsx_layer_find_tsx_shared(&key);
 	if (!invite_uas) {
 	    /* Invite transaction not found, respond CANCEL with 481 */
 	    pjsip_endpt_respond_stateless(global.endpt, rdata, 481, NULL,
@@ -282,8 +282,8 @@ static pj_bool_t proxy_on_rx_request( pjsip_rx_data *rdata )
 	    pj_grp_lock_release(uas_data2->uac_tsx->grp_lock);
 	}
 
-	/* Unlock UAS tsx because it is locked in find_tsx() */
-	pj_grp_lock_release(invite_uas->grp_lock);
+	/* Unlock UAS tsx because it is locked in find_tsx_shared() */
+	pj_grp_lock_release_shared(invite_uas->grp_lock);
     }
 
     return PJ_TRUE;
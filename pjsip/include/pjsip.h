@@ -36,6 +36,8 @@
 #include <pjsip/sip_module.h>
 #include <pjsip/sip_endpoint.h>
 #include <pjsip/sip_util.h>
+#include <pjsip/sip_latency.h>
+#include <pjsip/sip_capture.h>
 
 /* Transport layer */
 #include <pjsip/sip_transport.h>
@@ -43,6 +45,7 @@
 #include <pjsip/sip_transport_loop.h>
 #include <pjsip/sip_transport_tcp.h>
 #include <pjsip/sip_transport_tls.h>
+#include <pjsip/sip_transport_ws.h>
 #include <pjsip/sip_resolve.h>
 
 /* Authentication. */
@@ -0,0 +1,220 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJSIP_SIP_CAPTURE_H__
+#define __PJSIP_SIP_CAPTURE_H__
+
+/**
+ * @file sip_capture.h
+ * @brief SIP message capture.
+ */
+
+#include <pjsip/sip_types.h>
+#include <pj/sock.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJSIP_CAPTURE SIP Message Capture
+ * @ingroup PJSIP_CORE_CORE
+ * @brief Capture SIP packets to PCAP file or HEP collector.
+ * @{
+ *
+ * The capture registers a module which copies every incoming and outgoing
+ * SIP packet, together with its timestamp, addresses and transport type,
+ * into a ring buffer owned by the calling thread. The packets are not
+ * formatted and no lock is taken on this path, so the capture can be kept
+ * enabled on busy servers where logging the messages with pj_log would be
+ * too expensive. A background thread drains the rings and writes the
+ * packets to a PCAP file or sends them to a HEPv3 (Homer) collector.
+ *
+ * When a ring is full the packet is dropped and counted, so the overhead
+ * on the SIP threads stays bounded even if the output can't keep up.
+ *
+ * Packets to be captured can be selected with a filter expression, which
+ * is a list of space separated terms that must all match. Each term has
+ * the form \a key=value[,value...] and matches if any of the values
+ * matches, and may be prefixed with '!' to negate it. Supported keys:
+ *  - \a method: method name of the request, or of the CSeq of the response.
+ *  - \a dir: "rx" or "tx".
+ *  - \a tp: transport type name, e.g. "udp", "tcp", "tls" or "ws".
+ *  - \a host: remote IP address.
+ *  - \a port: remote port.
+ *
+ * For example "method=INVITE,BYE,CANCEL !tp=udp" captures INVITE, BYE and
+ * CANCEL transactions over connection oriented transports.
+ *
+ * In PCAP output each packet is written as a UDP datagram over Ethernet
+ * with the transport addresses of the message, regardless of the actual
+ * transport, so that packet analyzers can decode the SIP messages without
+ * stream reassembly.
+ */
+
+/**
+ * Capture output type.
+ */
+typedef enum pjsip_capture_output
+{
+    /** Write libpcap file. */
+    PJSIP_CAPTURE_PCAP,
+
+    /** Send HEPv3 packets to collector over UDP. */
+    PJSIP_CAPTURE_HEP
+
+} pjsip_capture_output;
+
+
+/**
+ * Capture settings.
+ */
+typedef struct pjsip_capture_cfg
+{
+    /**
+     * Output type.
+     *
+     * Default: PJSIP_CAPTURE_PCAP
+     */
+    pjsip_capture_output    output;
+
+    /**
+     * Path of the PCAP file, for PJSIP_CAPTURE_PCAP output. The file is
+     * overwritten.
+     */
+    pj_str_t		    pcap_file;
+
+    /**
+     * Address of the HEP collector, for PJSIP_CAPTURE_HEP output.
+     */
+    pj_sockaddr		    hep_addr;
+
+    /**
+     * Capture agent id to be put in HEP packets.
+     *
+     * Default: 0
+     */
+    pj_uint32_t		    hep_id;
+
+    /**
+     * Optional authentication key to be put in HEP packets.
+     */
+    pj_str_t		    hep_password;
+
+    /**
+     * Optional filter expression, see \ref PJSIP_CAPTURE. If empty, all
+     * packets are captured.
+     */
+    pj_str_t		    filter;
+
+    /**
+     * Size of the ring buffer of each thread, in bytes.
+     *
+     * Default: PJSIP_CAPTURE_RING_SIZE
+     */
+    unsigned		    ring_size;
+
+    /**
+     * Interval to drain the ring buffers, in milliseconds.
+     *
+     * Default: PJSIP_CAPTURE_DRAIN_INTERVAL
+     */
+    unsigned		    drain_interval;
+
+} pjsip_capture_cfg;
+
+
+/**
+ * Capture statistics.
+ */
+typedef struct pjsip_capture_stat
+{
+    /** Number of packets captured into the rings. */
+    pj_uint32_t		    captured;
+
+    /** Number of packets dropped because the ring was full or the packet
+     *  was too large. */
+    pj_uint32_t		    dropped;
+
+    /** Number of packets written to the output. */
+    pj_uint32_t		    written;
+
+    /** Number of threads which have their own ring. The ring of a thread
+     *  is given to another thread once the thread has exited and its
+     *  packets have been written. */
+    pj_uint32_t		    rings;
+
+} pjsip_capture_stat;
+
+
+/**
+ * Opaque declaration of capture instance.
+ */
+typedef struct pjsip_capture pjsip_capture;
+
+
+/**
+ * Initialize capture settings with default values.
+ *
+ * @param cfg	    The settings.
+ */
+PJ_DECL(void) pjsip_capture_cfg_default(pjsip_capture_cfg *cfg);
+
+/**
+ * Start capturing SIP packets. Only one capture may be active at a time.
+ *
+ * @param endpt	    The SIP endpoint.
+ * @param cfg	    Capture settings.
+ * @param p_cap	    Pointer to receive the capture instance.
+ *
+ * @return	    PJ_SUCCESS on success, PJ_EEXISTS if a capture is
+ *		    already active, PJ_EINVAL if the filter expression is
+ *		    invalid, or other error code.
+ */
+PJ_DECL(pj_status_t) pjsip_capture_create(pjsip_endpoint *endpt,
+					  const pjsip_capture_cfg *cfg,
+					  pjsip_capture **p_cap);
+
+/**
+ * Get capture statistics.
+ *
+ * @param cap	    The capture instance.
+ * @param stat	    Buffer to receive the statistics.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_capture_get_stat(pjsip_capture *cap,
+					    pjsip_capture_stat *stat);
+
+/**
+ * Stop capturing, write the packets which are still in the rings, and
+ * close the output.
+ *
+ * @param cap	    The capture instance.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_capture_destroy(pjsip_capture *cap);
+
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif	/* __PJSIP_SIP_CAPTURE_H__ */
@@ -170,6 +170,16 @@ typedef struct pjsip_cfg_t
 	 */
 	pj_bool_t use_compact_form;
 
+	/**
+	 * Record latency histograms of message parsing, module callbacks,
+	 * transaction creation and transport send. See
+	 * \ref PJSIP_LATENCY for details. This has no effect if
+	 * PJSIP_HAS_LATENCY_STATS is disabled.
+	 *
+	 * Default is PJSIP_LATENCY_STATS.
+	 */
+	pj_bool_t latency_stats;
+
     } endpt;
 
     /** Transaction layer settings. */
@@ -240,6 +250,24 @@ typedef struct pjsip_cfg_t
          */
         long keep_alive_interval;
 
+        /**
+         * Close TCP connections on which nothing has been received for
+         * this number of seconds. If the value is zero, idle connections
+         * will not be closed.
+         *
+         * Default is PJSIP_TCP_IDLE_TIMEOUT.
+         */
+        long idle_timeout;
+
+        /**
+         * Specify whether the connections of a TCP listener share a read
+         * buffer slab, see PJSIP_TCP_TLS_READ_SLAB. The value is read
+         * when the listener is started.
+         *
+         * Default is PJSIP_TCP_TLS_READ_SLAB.
+         */
+        pj_bool_t read_slab;
+
     } tcp;
 
     /** TLS transport settings */
@@ -252,8 +280,48 @@ typedef struct pjsip_cfg_t
          */
         long keep_alive_interval;
 
+        /**
+         * Close TLS connections on which nothing has been received for
+         * this number of seconds. If the value is zero, idle connections
+         * will not be closed.
+         *
+         * Default is PJSIP_TLS_IDLE_TIMEOUT.
+         */
+        long idle_timeout;
+
+        /**
+         * Specify whether the connections of a TLS listener share a read
+         * buffer slab, see PJSIP_TCP_TLS_READ_SLAB. The value is read
+         * when the listener is started.
+         *
+         * Default is PJSIP_TCP_TLS_READ_SLAB.
+         */
+        pj_bool_t read_slab;
+
     } tls;
 
+    /** WebSocket transport settings */
+    struct {
+        /**
+         * Set the interval to send WebSocket ping frames on WS/WSS
+         * transports. If the value is zero, keep-alive will be disabled
+         * for WebSocket.
+         *
+         * Default is PJSIP_WS_KEEP_ALIVE_INTERVAL.
+         */
+        long keep_alive_interval;
+
+        /**
+         * Close WebSocket connections on which nothing has been received
+         * for this number of seconds. If the value is zero, idle
+         * connections will not be closed.
+         *
+         * Default is PJSIP_WS_IDLE_TIMEOUT.
+         */
+        long idle_timeout;
+
+    } ws;
+
 } pjsip_cfg_t;
 
 
@@ -326,6 +394,19 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify whether the hash tables of the transport manager, transaction
+ * layer and dialogs grow with the number of entries (see
+ * #pj_hash_create_resizable()), so that the sizes above only need to match
+ * typical load instead of the peak load.
+ *
+ * Default: 1
+ */
+#ifndef PJSIP_HTABLE_RESIZABLE
+#   define PJSIP_HTABLE_RESIZABLE	1
+#endif
+
+
 /**
  * Specify maximum URL size.
  */
@@ -487,6 +568,66 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Include support for latency histograms (see \ref PJSIP_LATENCY). When
+ * this is enabled, the recording is still controlled at run-time by the
+ * \a latency_stats setting in pjsip_cfg_t, and costs a single branch per
+ * probe while switched off.
+ *
+ * Default is 1 (yes)
+ */
+#ifndef PJSIP_HAS_LATENCY_STATS
+#   define PJSIP_HAS_LATENCY_STATS	1
+#endif
+
+
+/**
+ * Start recording latency histograms on startup. This option can also be
+ * controlled at run-time by the \a latency_stats setting in pjsip_cfg_t.
+ *
+ * Default is 0 (no)
+ */
+#ifndef PJSIP_LATENCY_STATS
+#   define PJSIP_LATENCY_STATS		0
+#endif
+
+
+/**
+ * Default size of the per thread ring buffer of the SIP message capture
+ * (see \ref PJSIP_CAPTURE), in bytes. Packets which don't fit in the ring
+ * before the capture thread drains it are dropped. This can be changed in
+ * pjsip_capture_cfg.
+ *
+ * Default: 262144 (256 KB)
+ */
+#ifndef PJSIP_CAPTURE_RING_SIZE
+#   define PJSIP_CAPTURE_RING_SIZE	(256 * 1024)
+#endif
+
+
+/**
+ * Maximum number of threads which get their own capture ring buffer.
+ * Further threads share a single ring which is protected by a mutex.
+ * The ring of a thread which has exited is reused by the next thread.
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_CAPTURE_MAX_THREADS
+#   define PJSIP_CAPTURE_MAX_THREADS	16
+#endif
+
+
+/**
+ * Default interval of the SIP message capture thread to drain the ring
+ * buffers, in milliseconds. This can be changed in pjsip_capture_cfg.
+ *
+ * Default: 20
+ */
+#ifndef PJSIP_CAPTURE_DRAIN_INTERVAL
+#   define PJSIP_CAPTURE_DRAIN_INTERVAL	20
+#endif
+
+
 /**
  * Send Allow header in dialog establishing requests?
  * RFC 3261 Allow header SHOULD be included in dialog establishing
@@ -720,6 +861,39 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify whether the connections of a TCP or TLS transport listener
+ * share a read buffer slab (see pj_activesock_cfg.read_slab). The
+ * incoming packet and its rdata then live in a buffer borrowed from the
+ * slab only while there is data to process, so idle connections hold no
+ * receive buffer. When disabled, each connection keeps its own rdata.
+ *
+ * This only sets the default value of the \a read_slab setting of the
+ * \a tcp and \a tls part of pjsip_cfg_t, which is read when a listener
+ * is started.
+ *
+ * Default is FALSE.
+ */
+#ifndef PJSIP_TCP_TLS_READ_SLAB
+#   define PJSIP_TCP_TLS_READ_SLAB	0
+#endif
+
+
+/**
+ * Number of one second slots in the keep-alive scheduler of the transport
+ * manager, which drives keep-alive and idle timeout of all connection
+ * oriented transports with a single timer. Entries which are due further
+ * than this number of seconds in the future simply stay in their slot for
+ * more rounds, so this only needs to be larger than the common keep-alive
+ * interval to keep the per tick scan short.
+ *
+ * Default: 128
+ */
+#ifndef PJSIP_TP_KA_WHEEL_SIZE
+#   define PJSIP_TP_KA_WHEEL_SIZE	    128
+#endif
+
+
 /**
  * Set the interval to send keep-alive packet for TCP transports.
  * If the value is zero, keep-alive will be disabled for TCP.
@@ -736,6 +910,22 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Close TCP connections on which nothing (not even keep-alive) has been
+ * received for this number of seconds, to reap connections of clients
+ * which have gone away without closing them. If the value is zero, idle
+ * connections will not be closed.
+ *
+ * This option can be changed in run-time by settting
+ * \a tcp.idle_timeout field of pjsip_cfg().
+ *
+ * Default: 0 (disabled)
+ */
+#ifndef PJSIP_TCP_IDLE_TIMEOUT
+#   define PJSIP_TCP_IDLE_TIMEOUT	    0
+#endif
+
+
 /**
  * Set the payload of the TCP keep-alive packet.
  *
@@ -762,6 +952,20 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Close TLS connections on which nothing has been received for this number
+ * of seconds. If the value is zero, idle connections will not be closed.
+ *
+ * This option can be changed in run-time by settting
+ * \a tls.idle_timeout field of pjsip_cfg().
+ *
+ * Default: 0 (disabled)
+ */
+#ifndef PJSIP_TLS_IDLE_TIMEOUT
+#   define PJSIP_TLS_IDLE_TIMEOUT	    0
+#endif
+
+
 /**
  * Set the payload of the TLS keep-alive packet.
  *
@@ -854,6 +1058,70 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Enable SIP over WebSocket (RFC 7118) transport support. Secure WebSocket
+ * (WSS) additionally requires PJSIP_HAS_TLS_TRANSPORT.
+ *
+ * Default: follow PJ_HAS_TCP setting.
+ */
+#ifndef PJSIP_HAS_WS_TRANSPORT
+#   define PJSIP_HAS_WS_TRANSPORT	    PJ_HAS_TCP
+#endif
+
+
+/**
+ * The WebSocket incoming connection backlog number to be set in accept().
+ *
+ * Default: 5
+ *
+ * @see PJSIP_TCP_TRANSPORT_BACKLOG
+ */
+#ifndef PJSIP_WS_TRANSPORT_BACKLOG
+#   define PJSIP_WS_TRANSPORT_BACKLOG	    5
+#endif
+
+
+/**
+ * Set the interval to send WebSocket ping frames on WS/WSS transports.
+ * If the value is zero, keep-alive will be disabled for WebSocket.
+ *
+ * This option can be changed in run-time by settting
+ * \a ws.keep_alive_interval field of pjsip_cfg().
+ *
+ * Default: 90 (seconds)
+ */
+#ifndef PJSIP_WS_KEEP_ALIVE_INTERVAL
+#   define PJSIP_WS_KEEP_ALIVE_INTERVAL	    90
+#endif
+
+
+/**
+ * Close WebSocket connections on which nothing has been received for this
+ * number of seconds. If the value is zero, idle connections will not be
+ * closed.
+ *
+ * This option can be changed in run-time by settting
+ * \a ws.idle_timeout field of pjsip_cfg().
+ *
+ * Default: 0 (disabled)
+ */
+#ifndef PJSIP_WS_IDLE_TIMEOUT
+#   define PJSIP_WS_IDLE_TIMEOUT	    0
+#endif
+
+
+/**
+ * Maximum time to wait for the HTTP Upgrade request after a WebSocket
+ * connection has been accepted. Connections which don't complete the
+ * opening handshake within this time are closed.
+ *
+ * Default: 10 (seconds)
+ */
+#ifndef PJSIP_WS_HANDSHAKE_TIMEOUT
+#   define PJSIP_WS_HANDSHAKE_TIMEOUT	    10
+#endif
+
+
 /* Endpoint. */
 #define PJSIP_MAX_TIMER_COUNT		(2*pjsip_cfg()->tsx.max_count + \
 					 2*PJSIP_MAX_DIALOG_COUNT)
@@ -948,10 +1216,12 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 /**
- * Initial memory size for a SIP transaction object.
+ * Initial memory size for a SIP transaction object. The transaction
+ * structure itself is allocated from a slab, so the pool only needs to
+ * hold the transaction key, the lock and a few strings.
  */
 #ifndef PJSIP_POOL_TSX_LEN
-#   define PJSIP_POOL_TSX_LEN		1536 /* 768 */
+#   define PJSIP_POOL_TSX_LEN		768
 #endif
 
 /**
@@ -971,6 +1241,20 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_TSX_1XX_RETRANS_DELAY	60
 #endif
 
+/**
+ * Specify whether the group lock which the transaction creates for itself
+ * supports the shared (reader) mode (see PJ_GRP_LOCK_SHARED), so that
+ * #pjsip_tsx_layer_find_tsx_shared() and #pjsip_tsx_layer_get_tsx_state()
+ * callers don't serialize each other. This costs a semaphore for each
+ * transaction. When disabled, the shared mode falls back to exclusive
+ * locking.
+ *
+ * Default: 1
+ */
+#ifndef PJSIP_TSX_SHARED_LOCK
+#   define PJSIP_TSX_SHARED_LOCK	1
+#endif
+
 #define PJSIP_MAX_TSX_KEY_LEN		(PJSIP_MAX_URL_SIZE*2)
 
 /* User agent. */
@@ -32,6 +32,7 @@
 #include <pjsip/sip_transport.h>
 #include <pjsip/sip_util.h>
 #include <pj/sock.h>
+#include <pj/slab.h>
 #include <pj/assert.h>
 
 
@@ -141,6 +142,7 @@ struct pjsip_dialog
     /* Dialog's system properties. */
     char		obj_name[PJ_MAX_OBJ_NAME];  /**< Standard id.	    */
     pj_pool_t	       *pool;	    /**< Dialog's pool.			    */
+    pj_slab_t	       *slab;	    /**< Slab of this object.		    */
     pj_mutex_t	       *mutex_;	    /**< Dialog's mutex. Do not call!!
 					 Use pjsip_dlg_inc_lock() instead!  */
     pjsip_user_agent   *ua;	    /**< User agent instance.		    */
@@ -0,0 +1,238 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJSIP_SIP_LATENCY_H__
+#define __PJSIP_SIP_LATENCY_H__
+
+/**
+ * @file sip_latency.h
+ * @brief Latency histograms.
+ */
+
+#include <pjsip/sip_types.h>
+#include <pj/os.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJSIP_LATENCY Latency Histograms
+ * @ingroup PJSIP_CORE_CORE
+ * @brief Record where the time goes inside the SIP stack.
+ * @{
+ *
+ * When enabled with the \a latency_stats setting in pjsip_cfg_t, the stack
+ * records the duration of message parsing and transport send per transport
+ * type, of each module's \a on_rx_request() and \a on_rx_response()
+ * callbacks, and of transaction creation, into histograms with logarithmic
+ * buckets (each power of two is split into #PJSIP_LAT_HIST_SUB_CNT linear
+ * sub-buckets, similar to HDR histograms), so percentiles can be read with
+ * a bounded relative error without storing the samples.
+ *
+ * Histograms are global to the library and updated without locking, so a
+ * sample may occasionally be lost when two threads record the same
+ * histogram at the same time.
+ */
+
+/**
+ * Number of sub-buckets in each power of two of a histogram, as bits.
+ */
+#define PJSIP_LAT_HIST_SUB_BITS	3
+
+/**
+ * Number of sub-buckets in each power of two of a histogram.
+ */
+#define PJSIP_LAT_HIST_SUB_CNT	(1 << PJSIP_LAT_HIST_SUB_BITS)
+
+/**
+ * Number of buckets in a histogram, covering the full 32-bit range of
+ * microseconds.
+ */
+#define PJSIP_LAT_HIST_BUCKETS	((32 - PJSIP_LAT_HIST_SUB_BITS + 1) * \
+				 PJSIP_LAT_HIST_SUB_CNT)
+
+/**
+ * Number of transport types for which separate histograms are kept. IPv4
+ * and IPv6 variants of a transport share the same histogram, and types
+ * beyond this number are recorded as PJSIP_TRANSPORT_UNSPECIFIED.
+ */
+#define PJSIP_LAT_MAX_TP_TYPES	16
+
+
+/**
+ * Measured operations.
+ */
+typedef enum pjsip_lat_metric
+{
+    /** Parsing of incoming message, indexed by transport type. */
+    PJSIP_LAT_PARSE,
+
+    /** Sending outgoing message (printing and handing it over to the
+     *  transport), indexed by transport type. */
+    PJSIP_LAT_TX,
+
+    /** Transaction creation, indexed by pjsip_role_e. */
+    PJSIP_LAT_TSX_CREATE,
+
+    /** Module's on_rx_request() callback, indexed by module id. */
+    PJSIP_LAT_MOD_RX_REQ,
+
+    /** Module's on_rx_response() callback, indexed by module id. */
+    PJSIP_LAT_MOD_RX_RES,
+
+    /** Number of metrics. */
+    PJSIP_LAT_METRIC_CNT
+
+} pjsip_lat_metric;
+
+
+/**
+ * Latency histogram, with the durations in microseconds.
+ */
+typedef struct pjsip_lat_hist
+{
+    /** Number of samples. */
+    pj_uint32_t	    count;
+
+    /** Sum of all samples. */
+    pj_uint64_t	    total;
+
+    /** Smallest sample. */
+    pj_uint32_t	    min;
+
+    /** Largest sample. */
+    pj_uint32_t	    max;
+
+    /** Number of samples in each bucket. */
+    pj_uint32_t	    bucket[PJSIP_LAT_HIST_BUCKETS];
+
+} pjsip_lat_hist;
+
+
+/**
+ * Add a sample to a histogram.
+ *
+ * @param hist	    The histogram.
+ * @param usec	    The duration, in microseconds.
+ */
+PJ_DECL(void) pjsip_lat_hist_add(pjsip_lat_hist *hist, pj_uint32_t usec);
+
+/**
+ * Get the approximate value below which the specified percentage of the
+ * samples fall.
+ *
+ * @param hist	    The histogram.
+ * @param pct	    The percentile, 0-100.
+ *
+ * @return	    The upper bound of the bucket containing the percentile,
+ *		    in microseconds, or zero if the histogram is empty.
+ */
+PJ_DECL(pj_uint32_t) pjsip_lat_hist_percentile(const pjsip_lat_hist *hist,
+					       unsigned pct);
+
+/**
+ * Record a sample for a metric.
+ *
+ * @param metric    The metric.
+ * @param index	    Index in the metric, see #pjsip_lat_metric.
+ * @param usec	    The duration, in microseconds.
+ */
+PJ_DECL(void) pjsip_lat_record(pjsip_lat_metric metric, unsigned index,
+			       pj_uint32_t usec);
+
+/**
+ * Record the time elapsed since the specified timestamp for a metric.
+ *
+ * @param metric    The metric.
+ * @param index	    Index in the metric, see #pjsip_lat_metric.
+ * @param start	    Timestamp taken when the operation started.
+ */
+PJ_DECL(void) pjsip_lat_record_since(pjsip_lat_metric metric, unsigned index,
+				     const pj_timestamp *start);
+
+/**
+ * Record the duration of a module callback. Besides the sample, this
+ * remembers the name of the module for #pjsip_lat_dump().
+ *
+ * @param metric    PJSIP_LAT_MOD_RX_REQ or PJSIP_LAT_MOD_RX_RES.
+ * @param mod	    The module.
+ * @param start	    Timestamp taken before the callback was called.
+ */
+PJ_DECL(void) pjsip_lat_record_mod(pjsip_lat_metric metric,
+				   const pjsip_module *mod,
+				   const pj_timestamp *start);
+
+/**
+ * Get a copy of a histogram.
+ *
+ * @param metric    The metric.
+ * @param index	    Index in the metric, see #pjsip_lat_metric.
+ * @param hist	    Buffer to receive the histogram.
+ *
+ * @return	    PJ_SUCCESS, or PJ_EINVAL if the index is out of range.
+ */
+PJ_DECL(pj_status_t) pjsip_lat_get(pjsip_lat_metric metric, unsigned index,
+				   pjsip_lat_hist *hist);
+
+/**
+ * Clear all histograms.
+ */
+PJ_DECL(void) pjsip_lat_reset(void);
+
+/**
+ * Print the non-empty histograms to the log.
+ *
+ * @param detail    Also print the bucket distribution of each histogram.
+ */
+PJ_DECL(void) pjsip_lat_dump(pj_bool_t detail);
+
+
+/**
+ * @}
+ */
+
+/*
+ * Probes used inside the library.
+ */
+#if defined(PJSIP_HAS_LATENCY_STATS) && PJSIP_HAS_LATENCY_STATS!=0
+#   define PJSIP_LAT_BEGIN(ts) \
+	    do { \
+		if (pjsip_cfg()->endpt.latency_stats) \
+		    pj_get_timestamp(ts); \
+		else \
+		    (ts)->u64 = 0; \
+	    } while (0)
+#   define PJSIP_LAT_END(ts, metric, index) \
+	    do { \
+		if ((ts)->u64) \
+		    pjsip_lat_record_since(metric, index, ts); \
+	    } while (0)
+#   define PJSIP_LAT_END_MOD(ts, metric, mod) \
+	    do { \
+		if ((ts)->u64) \
+		    pjsip_lat_record_mod(metric, mod, ts); \
+	    } while (0)
+#else
+#   define PJSIP_LAT_BEGIN(ts)			((ts)->u64 = 0)
+#   define PJSIP_LAT_END(ts, metric, index)	PJ_UNUSED_ARG(ts)
+#   define PJSIP_LAT_END_MOD(ts, metric, mod)	PJ_UNUSED_ARG(ts)
+#endif
+
+PJ_END_DECL
+
+#endif	/* __PJSIP_SIP_LATENCY_H__ */
@@ -28,6 +28,7 @@
 #include <pjsip/sip_msg.h>
 #include <pjsip/sip_util.h>
 #include <pjsip/sip_transport.h>
+#include <pj/slab.h>
 #include <pj/timer.h>
 
 PJ_BEGIN_DECL
@@ -83,6 +84,7 @@ struct pjsip_transaction
      * Administrivia
      */
     pj_pool_t		       *pool;           /**< Pool owned by the tsx. */
+    pj_slab_t		       *slab;           /**< Slab of this object.   */
     pjsip_module	       *tsx_user;	/**< Transaction user.	    */
     pjsip_endpoint	       *endpt;          /**< Endpoint instance.     */
     pj_bool_t			terminating;	/**< terminate() was called */
@@ -209,6 +211,39 @@ PJ_DECL(pjsip_transaction*) pjsip_tsx_layer_find_tsx( const pj_str_t *key,
 PJ_DECL(pjsip_transaction*) pjsip_tsx_layer_find_tsx2( const pj_str_t *key,
 						       pj_bool_t add_ref );
 
+/**
+ * Find a transaction with the specified key and lock it in shared mode
+ * (see #pj_grp_lock_acquire_shared()), for callers which only read the
+ * transaction. Several threads may hold the same transaction this way at
+ * the same time, while state changes wait until they have released it.
+ * The caller must release the lock with #pj_grp_lock_release_shared(),
+ * and must not acquire the transaction's group lock again before that.
+ * See also PJSIP_TSX_SHARED_LOCK.
+ *
+ * @param key	    The key string to find the transaction.
+ *
+ * @return	    The matching transaction instance, or NULL if transaction
+ *		    can not be found.
+ */
+PJ_DECL(pjsip_transaction*) pjsip_tsx_layer_find_tsx_shared(
+							const pj_str_t *key);
+
+/**
+ * Get the state and the last status code of the transaction with the
+ * specified key. The transaction is held in shared mode while the values
+ * are read, see #pjsip_tsx_layer_find_tsx_shared().
+ *
+ * @param key	      The key string to find the transaction.
+ * @param state	      Optional pointer to receive the transaction state.
+ * @param status_code Optional pointer to receive the last status code.
+ *
+ * @return	      PJ_SUCCESS, or PJ_ENOTFOUND if transaction can not
+ *		      be found.
+ */
+PJ_DECL(pj_status_t) pjsip_tsx_layer_get_tsx_state( const pj_str_t *key,
+						    pjsip_tsx_state_e *state,
+						    int *status_code );
+
 /**
  * Create, initialize, and register a new transaction as UAC from the 
  * specified transmit data (\c tdata). The transmit data must have a valid
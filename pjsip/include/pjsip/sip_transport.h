@@ -71,9 +71,15 @@ enum pjsip_transport_flags_e
 {
     PJSIP_TRANSPORT_RELIABLE	    = 1,    /**< Transport is reliable.	    */
     PJSIP_TRANSPORT_SECURE	    = 2,    /**< Transport is secure.	    */
-    PJSIP_TRANSPORT_DATAGRAM	    = 4     /**< Datagram based transport.  
+    PJSIP_TRANSPORT_DATAGRAM	    = 4,    /**< Datagram based transport.  
 					         (it's also assumed to be 
 						 connectionless)	    */
+    PJSIP_TRANSPORT_MSG_FRAMED	    = 8     /**< Stream transport which
+						 delivers exactly one SIP
+						 message per packet (e.g.
+						 WebSocket), so message
+						 boundaries don't depend on
+						 Content-Length.	    */
 };
 
 /**
@@ -1593,6 +1599,107 @@ PJ_DECL(pj_status_t) pjsip_tpmgr_set_drop_data_cb(pjsip_tpmgr *mgr,
 						  pjsip_tp_on_rx_dropped_cb cb);
 
 
+/*****************************************************************************
+ *
+ * KEEP-ALIVE SCHEDULER.
+ *
+ *****************************************************************************/
+
+/**
+ * Forward declaration for keep-alive scheduler entry.
+ */
+typedef struct pjsip_tp_ka_entry pjsip_tp_ka_entry;
+
+/**
+ * Type of callback to be called by the keep-alive scheduler when an entry
+ * is due. Connection oriented transports would use this to check the
+ * activity of the connection, send keep-alive packet, or close the
+ * connection when it has been idle for too long.
+ *
+ * The callback is called from the timer thread without holding any lock of
+ * the scheduler, and the group lock of the entry is referenced during the
+ * call, so the transport may be shutdown from inside the callback.
+ *
+ * @param entry	    The keep-alive entry.
+ *
+ * @return	    Number of seconds until the entry is due again, or zero
+ *		    to remove the entry from the scheduler.
+ */
+typedef long (*pjsip_tp_ka_cb)(pjsip_tp_ka_entry *entry);
+
+/**
+ * Keep-alive scheduler entry, normally embedded in the transport
+ * instance. The transport manager keeps the entries in a timing wheel with
+ * one second resolution, driven by a single timer, so that servers with a
+ * very large number of connections don't need one timer heap entry per
+ * connection. Initialize with #pjsip_tp_ka_entry_init().
+ */
+struct pjsip_tp_ka_entry
+{
+    /** Standard list members, internal. */
+    PJ_DECL_LIST_MEMBER(struct pjsip_tp_ka_entry);
+
+    /** Group lock of the transport, to keep the transport alive while
+     *  the callback is running. */
+    pj_grp_lock_t   *grp_lock;
+
+    /** The callback. */
+    pjsip_tp_ka_cb   cb;
+
+    /** Application data. */
+    void	    *user_data;
+
+    /** Due time, in seconds of the monotonic clock, internal. */
+    long	     due;
+
+    /** Scheduling state, internal. */
+    int		     state;
+};
+
+
+/**
+ * Initialize keep-alive scheduler entry.
+ *
+ * @param entry	    The entry.
+ * @param grp_lock  Group lock of the transport. This must be set (here or
+ *		    later by setting the field) before the entry is
+ *		    scheduled.
+ * @param cb	    Callback to be called when the entry is due.
+ * @param user_data Application data.
+ */
+PJ_DECL(void) pjsip_tp_ka_entry_init(pjsip_tp_ka_entry *entry,
+				     pj_grp_lock_t *grp_lock,
+				     pjsip_tp_ka_cb cb,
+				     void *user_data);
+
+/**
+ * Schedule (or reschedule) keep-alive entry to be due after the specified
+ * delay.
+ *
+ * @param mgr	    The transport manager.
+ * @param entry	    The entry.
+ * @param delay	    Delay, in seconds. Must be greater than zero.
+ *
+ * @return	    PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_tpmgr_ka_schedule(pjsip_tpmgr *mgr,
+					     pjsip_tp_ka_entry *entry,
+					     long delay);
+
+/**
+ * Remove keep-alive entry from the scheduler. If the callback of the entry
+ * is currently running, the entry will not be rescheduled after the
+ * callback returns.
+ *
+ * @param mgr	    The transport manager.
+ * @param entry	    The entry.
+ *
+ * @return	    PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_tpmgr_ka_cancel(pjsip_tpmgr *mgr,
+					   pjsip_tp_ka_entry *entry);
+
+
 /**
  * @}
  */
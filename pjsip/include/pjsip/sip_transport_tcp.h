@@ -26,6 +26,7 @@
  */
 
 #include <pjsip/sip_transport.h>
+#include <pj/activesock.h>
 #include <pj/sock_qos.h>
 
 
@@ -225,6 +226,18 @@ PJ_DECL(pj_status_t) pjsip_tcp_transport_start3(
  */
 PJ_DECL(pj_sock_t) pjsip_tcp_transport_get_socket(pjsip_transport *transport);
 
+/**
+ * Get the read buffer slab shared by the connections of the TCP listener,
+ * e.g. to monitor its usage with #pj_activesock_slab_get_info(). See
+ * PJSIP_TCP_TLS_READ_SLAB.
+ *
+ * @param factory	The SIP TCP transport factory.
+ *
+ * @return		The slab, or NULL if the read slab is disabled.
+ */
+PJ_DECL(pj_activesock_slab*)
+pjsip_tcp_transport_get_read_slab(pjsip_tpfactory *factory);
+
 /**
  * Start the TCP listener, if the listener is not started yet. This is useful
  * to start the listener manually, if listener was not started when 
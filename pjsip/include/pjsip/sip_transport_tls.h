@@ -486,6 +486,18 @@ PJ_DECL(pj_status_t) pjsip_tls_transport_restart(pjsip_tpfactory *factory,
 						const pj_sockaddr *local,
 						const pjsip_host_port *a_name);
 
+/**
+ * Get the read buffer slab shared by the connections of the TLS listener,
+ * e.g. to monitor its usage with #pj_activesock_slab_get_info(). See
+ * PJSIP_TCP_TLS_READ_SLAB.
+ *
+ * @param factory	The SIP TLS transport factory.
+ *
+ * @return		The slab, or NULL if the read slab is disabled.
+ */
+PJ_DECL(pj_activesock_slab*)
+pjsip_tls_transport_get_read_slab(pjsip_tpfactory *factory);
+
 PJ_END_DECL
 
 /**
@@ -0,0 +1,187 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJSIP_TRANSPORT_WS_H__
+#define __PJSIP_TRANSPORT_WS_H__
+
+/**
+ * @file sip_transport_ws.h
+ * @brief SIP WebSocket Transport (RFC 7118).
+ */
+
+#include <pjsip/sip_transport.h>
+#include <pj/sock_qos.h>
+#include <pj/ssl_sock.h>
+
+
+/* Only declare the API if PJSIP_HAS_WS_TRANSPORT is true */
+#if defined(PJSIP_HAS_WS_TRANSPORT) && PJSIP_HAS_WS_TRANSPORT!=0
+
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJSIP_TRANSPORT_WS WebSocket Transport
+ * @ingroup PJSIP_TRANSPORT
+ * @brief API to create and register SIP over WebSocket transport.
+ * @{
+ * The functions below are used to create a WebSocket (WS) or secure
+ * WebSocket (WSS) listener and register it to the framework, so that
+ * WebRTC clients can connect to the endpoint directly as described in
+ * RFC 7118.
+ *
+ * The transport runs in server mode: it accepts incoming connections,
+ * performs the HTTP Upgrade handshake (accepting only the "sip"
+ * subprotocol), and then exchanges one SIP message per WebSocket message.
+ * Outgoing requests towards a WebSocket client must be sent over the
+ * connection the client has established (for example by selecting the
+ * transport with #pjsip_tpselector), since WebSocket clients can not
+ * accept incoming connections.
+ */
+
+/**
+ * Settings to be specified when creating the WebSocket transport.
+ * Application should initialize this structure with its default values
+ * by calling pjsip_ws_transport_cfg_default().
+ */
+typedef struct pjsip_ws_transport_cfg
+{
+    /**
+     * Address family to use. Valid values are pj_AF_INET() and
+     * pj_AF_INET6(). Default is pj_AF_INET().
+     */
+    int			af;
+
+    /**
+     * Optional address to bind the socket to. Default is to bind to
+     * PJ_INADDR_ANY and to any available port.
+     */
+    pj_sockaddr		bind_addr;
+
+    /**
+     * Should SO_REUSEADDR be used for the listener socket.
+     * Default value is PJSIP_TCP_TRANSPORT_REUSEADDR.
+     */
+    pj_bool_t		reuse_addr;
+
+    /**
+     * Optional published address, which is the address to be
+     * advertised as the address of this SIP transport.
+     * By default the bound address will be used as the published address.
+     */
+    pjsip_host_port	addr_name;
+
+    /**
+     * Number of simultaneous asynchronous accept() operations to be
+     * supported.
+     *
+     * Default: 1
+     */
+    unsigned		async_cnt;
+
+    /**
+     * Optional HTTP resource path which clients must request in the
+     * Upgrade request (for example "/ws"). If empty, any path is accepted.
+     *
+     * Default: empty.
+     */
+    pj_str_t		path;
+
+    /**
+     * Create a secure WebSocket (WSS) listener instead of plain WS. This
+     * requires PJSIP_HAS_TLS_TRANSPORT and the \a cert field to be set.
+     *
+     * Default: PJ_FALSE.
+     */
+    pj_bool_t		secure;
+
+#if defined(PJSIP_HAS_TLS_TRANSPORT) && PJSIP_HAS_TLS_TRANSPORT!=0
+    /**
+     * Server certificate for the WSS listener, e.g. as loaded with
+     * #pj_ssl_cert_load_from_files(). Only used when \a secure is set.
+     */
+    pj_ssl_cert_t      *cert;
+#endif
+
+    /**
+     * QoS traffic type to be set on this transport.
+     *
+     * Default is QoS not set.
+     */
+    pj_qos_type		qos_type;
+
+    /**
+     * Set the low level QoS parameters to the transport.
+     *
+     * Default is QoS not set.
+     */
+    pj_qos_params	qos_params;
+
+    /**
+     * Specify options to be set on the transport.
+     *
+     * By default there is no options.
+     */
+    pj_sockopt_params	sockopt_params;
+
+} pjsip_ws_transport_cfg;
+
+
+/**
+ * Initialize pjsip_ws_transport_cfg structure with default values for
+ * the specifed address family.
+ *
+ * @param cfg		The structure to initialize.
+ * @param af		Address family to be used.
+ */
+PJ_DECL(void) pjsip_ws_transport_cfg_default(pjsip_ws_transport_cfg *cfg,
+					     int af);
+
+
+/**
+ * Register support for SIP over WebSocket by creating a WS (or WSS)
+ * listener on the specified address and port. This function will create
+ * an instance of SIP WebSocket transport factory and register it to the
+ * transport manager.
+ *
+ * @param endpt		The SIP endpoint.
+ * @param cfg		WebSocket transport settings. Application should
+ *			initialize this setting with
+ *			#pjsip_ws_transport_cfg_default().
+ * @param p_factory	Optional pointer to receive the instance of the
+ *			SIP WebSocket transport factory just created.
+ *
+ * @return		PJ_SUCCESS when the transport has been successfully
+ *			started and registered to transport manager, or
+ *			the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_ws_transport_start(pjsip_endpoint *endpt,
+					      const pjsip_ws_transport_cfg *cfg,
+					      pjsip_tpfactory **p_factory);
+
+
+PJ_END_DECL
+
+/**
+ * @}
+ */
+
+#endif	/* PJSIP_HAS_WS_TRANSPORT */
+
+#endif	/* __PJSIP_TRANSPORT_WS_H__ */
@@ -85,6 +85,12 @@ typedef enum pjsip_transport_type_e
     /** Start of user defined transport */
     PJSIP_TRANSPORT_START_OTHER,
 
+    /** WebSocket (RFC 7118) */
+    PJSIP_TRANSPORT_WS,
+
+    /** Secure WebSocket (RFC 7118) */
+    PJSIP_TRANSPORT_WSS,
+
     /** Start of IPv6 transports */
     PJSIP_TRANSPORT_IPV6    = 128,
 
@@ -95,7 +101,13 @@ typedef enum pjsip_transport_type_e
     PJSIP_TRANSPORT_TCP6 = PJSIP_TRANSPORT_TCP + PJSIP_TRANSPORT_IPV6,
 
     /** TLS over IPv6 */
-    PJSIP_TRANSPORT_TLS6 = PJSIP_TRANSPORT_TLS + PJSIP_TRANSPORT_IPV6
+    PJSIP_TRANSPORT_TLS6 = PJSIP_TRANSPORT_TLS + PJSIP_TRANSPORT_IPV6,
+
+    /** WebSocket over IPv6 */
+    PJSIP_TRANSPORT_WS6 = PJSIP_TRANSPORT_WS + PJSIP_TRANSPORT_IPV6,
+
+    /** Secure WebSocket over IPv6 */
+    PJSIP_TRANSPORT_WSS6 = PJSIP_TRANSPORT_WSS + PJSIP_TRANSPORT_IPV6
 
 } pjsip_transport_type_e;
 
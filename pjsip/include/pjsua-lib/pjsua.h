@@ -367,6 +367,16 @@ typedef struct pj_stun_resolve_result pj_stun_resolve_result;
 #endif
 
 
+/**
+ * Maximum number of CPUs which can be specified in #pjsua_thread_cfg.
+ *
+ * Default: 16
+ */
+#ifndef PJSUA_MAX_THREAD_CPUS
+#   define PJSUA_MAX_THREAD_CPUS		16
+#endif
+
+
 /**
  * This enumeration represents pjsua state.
  */
@@ -454,6 +464,16 @@ typedef struct pjsua_logging_config
      */
     void       (*cb)(int level, const char *data, int len);
 
+    /**
+     * Write the log from a background thread, so that threads calling
+     * the logging functions don't block on the log file or the console.
+     * Messages are dropped, and counted, if the background thread can't
+     * keep up. See #pj_log_async_start() for more info. Once started,
+     * asynchronous logging stays active until #pjsua_destroy().
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t	async;
 
 } pjsua_logging_config;
 
@@ -1696,6 +1716,65 @@ typedef enum pjsua_100rel_use
 } pjsua_100rel_use;
 
 
+/**
+ * This structure describes where a group of library threads, such as the
+ * SIP worker threads, run and how they are scheduled. Pinning the threads
+ * to CPUs prevents the OS from migrating them, which otherwise shows up as
+ * media jitter. Application must call #pjsua_thread_cfg_default() to
+ * initialize this structure with the default values.
+ */
+typedef struct pjsua_thread_cfg
+{
+    /**
+     * Number of CPUs in \a cpu. When it is not zero, each thread of the
+     * group is pinned to one CPU: the first thread to cpu[0], the second
+     * to cpu[1], and so on, wrapping around when there are more threads
+     * than CPUs.
+     *
+     * Default: 0 (the threads are not pinned)
+     */
+    unsigned		    cpu_cnt;
+
+    /**
+     * Array of zero based CPU indexes.
+     */
+    unsigned		    cpu[PJSUA_MAX_THREAD_CPUS];
+
+    /**
+     * When \a cpu_cnt is zero, restrict the threads to the CPUs of this
+     * NUMA node. Currently this is only supported on Linux.
+     *
+     * Default: -1 (not used)
+     */
+    int			    numa_node;
+
+    /**
+     * Scheduling policy of the threads. The scheduling is only changed
+     * when this is not PJ_THREAD_SCHED_DEFAULT. Note that real-time
+     * policies normally need elevated privileges.
+     *
+     * Default: PJ_THREAD_SCHED_DEFAULT
+     */
+    pj_thread_sched_policy  sched_policy;
+
+    /**
+     * Priority of the threads, in the range of \a sched_policy.
+     *
+     * Default: 0
+     */
+    int			    sched_prio;
+
+} pjsua_thread_cfg;
+
+
+/**
+ * Initialize thread config with the default values.
+ *
+ * @param cfg		The thread config to be initialized.
+ */
+PJ_DECL(void) pjsua_thread_cfg_default(pjsua_thread_cfg *cfg);
+
+
 /**
  * This structure describes the settings to control the API and
  * user agent behavior, and can be specified when calling #pjsua_init().
@@ -1973,6 +2052,12 @@ typedef struct pjsua_config
      */
     pj_bool_t	     hangup_forked_call;
 
+    /**
+     * Placement and scheduling of the SIP worker threads (see
+     * \a thread_cnt). Failure to apply it is logged, but is not fatal.
+     */
+    pjsua_thread_cfg thread_cfg;
+
 } pjsua_config;
 
 
@@ -6165,6 +6250,41 @@ struct pjsua_media_config
      */
     unsigned		max_media_ports;
 
+    /**
+     * Number of worker threads used by the conference bridge to read
+     * from and write to its ports (which includes decoding and encoding
+     * the audio of the calls) in parallel, see
+     * #pjmedia_conf_set_mix_threads(). This is only worth setting when
+     * many calls are mixed on a multi-core machine. Failure to apply it
+     * is logged, but is not fatal.
+     *
+     * Default value: 0 (the ports are processed by the clock thread)
+     */
+    unsigned		conf_mix_threads;
+
+    /**
+     * Maximum number of active speakers to be mixed by the conference
+     * bridge, see #pjmedia_conf_set_active_speakers(). Limiting the
+     * mixing to the few loudest participants greatly reduces the mixing
+     * work in large conferences. Failure to apply it is logged, but is
+     * not fatal.
+     *
+     * Default value: 0 (all participants are mixed)
+     */
+    unsigned		conf_active_speakers;
+
+    /**
+     * Specify whether audio streams sending the same audio should share
+     * their encoder, so that the audio is only encoded once, see
+     * #pjmedia_stream_set_enc_group(). This saves a lot of encoding work
+     * when many calls listen to the same conference mix, e.g. when
+     * #conf_active_speakers is set. Failure to apply it is logged, but is
+     * not fatal.
+     *
+     * Default value: PJ_FALSE
+     */
+    pj_bool_t		conf_shared_encoding;
+
     /**
      * Specify whether the media manager should manage its own
      * ioqueue for the RTP/RTCP sockets. If yes, ioqueue will be created
@@ -6290,6 +6410,15 @@ struct pjsua_media_config
      */
     int			jb_max;
 
+    /**
+     * Adjust the jitter buffer latency by time-scaling the audio playout
+     * instead of discarding frames, see #PJMEDIA_JB_DISCARD_TIME_SCALE.
+     * This keeps the latency closer to the actual network jitter.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t		jb_time_scale;
+
     /**
      * Enable ICE
      */
@@ -6418,6 +6547,23 @@ struct pjsua_media_config
      *   will not work properly.
      */
     void (*on_aud_prev_rec_frame)(pjmedia_frame *frame);
+
+    /**
+     * Placement and scheduling of the media worker threads which handle
+     * incoming RTP packets (see \a thread_cnt). Failure to apply it is
+     * logged, but is not fatal.
+     */
+    pjsua_thread_cfg thread_cfg;
+
+    /**
+     * Placement and scheduling of the media clock thread which drives the
+     * conference bridge when the null sound device is used. When a sound
+     * device is used, the bridge is driven by the sound device threads,
+     * which are created by the audio backend and are not covered by this
+     * setting. When scheduling is set here, the clock thread is no longer
+     * set to the highest priority.
+     */
+    pjsua_thread_cfg clock_thread_cfg;
 };
 
 
@@ -6673,6 +6819,11 @@ PJ_DECL(pj_status_t) pjsua_conf_add_port(pj_pool_t *pool,
  * call this function if it registered the port manually with previous call
  * to #pjsua_conf_add_port().
  *
+ * If the bridge is busy mixing, this function waits until the bridge has
+ * released the port, so that the port may be destroyed as soon as this
+ * function returns. Because of this, it must not be called from the
+ * callbacks of the media ports in the bridge.
+ *
  * @param port_id	The slot id of the port to be removed.
  *
  * @return		PJ_SUCCESS on success, or the appropriate error code.
@@ -6860,7 +7011,9 @@ PJ_DECL(pj_status_t) pjsua_player_set_pos(pjsua_player_id id,
 
 /**
  * Close the file of playlist, remove the player from the bridge, and free
- * resources associated with the file player or playlist.
+ * resources associated with the file player or playlist. This does not
+ * wait for the bridge: if it is busy mixing, the file is closed when the
+ * bridge has released the player.
  *
  * @param id		The file player ID.
  *
@@ -499,6 +499,7 @@ struct pjsua_data
     pj_timer_entry	 snd_idle_timer;/**< Sound device idle timer.	*/
     pjmedia_master_port	*null_snd;  /**< Master port for null sound.	*/
     pjmedia_port	*null_port; /**< Null port.			*/
+    pjmedia_stream_enc_group *enc_grp; /**< Shared encoding group.	*/
     pj_bool_t		 snd_is_on; /**< Media flow is currently active */
     unsigned		 snd_mode;  /**< Sound device mode.		*/
 
@@ -617,6 +618,16 @@ PJ_INLINE(pj_bool_t) PJSUA_LOCK_IS_LOCKED()
 /* Core */
 void pjsua_set_state(pjsua_state new_state);
 
+/* Get the CPUs of the idx-th thread of a thread group. Returns the number
+ * of CPUs, or zero if the thread is not to be pinned.
+ */
+unsigned pjsua_thread_cfg_get_cpus(const pjsua_thread_cfg *cfg, unsigned idx,
+				   unsigned max_cnt, unsigned cpu[]);
+
+/* Apply the thread config to the idx-th thread of a thread group */
+void pjsua_apply_thread_cfg(const pjsua_thread_cfg *cfg, unsigned idx,
+			    pj_thread_t *thread);
+
 /******
  * STUN resolution
  */
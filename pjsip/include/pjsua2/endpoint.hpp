@@ -843,6 +843,14 @@ public:
      */
     int			jbMax;
 
+    /**
+     * Adjust the jitter buffer latency by time-scaling the audio playout
+     * instead of discarding frames.
+     *
+     * Default: false
+     */
+    bool		jbTimeScale;
+
     /**
      * Specify idle time of sound device before it is automatically closed,
      * in seconds. Use value -1 to disable the auto-close feature of sound
@@ -0,0 +1,950 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjsip/sip_capture.h>
+#include <pjsip/sip_endpoint.h>
+#include <pjsip/sip_module.h>
+#include <pjsip/sip_msg.h>
+#include <pjsip/sip_transport.h>
+#include <pj/assert.h>
+#include <pj/atomic.h>
+#include <pj/ctype.h>
+#include <pj/errno.h>
+#include <pj/file_io.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+#define THIS_FILE	"sip_capture.c"
+
+/* The ring indexes are shared between the SIP thread which owns the ring
+ * (producer) and the capture thread (consumer). Where the compiler doesn't
+ * provide acquire/release accesses, the rings are protected by a mutex.
+ */
+#define RING_NEEDS_LOCK	(!PJ_HAS_ATOMIC_ACQ_REL)
+
+#define REC_ALIGN	8
+#define MAX_PKT_LEN	65000
+#define OUT_BUF_SIZE	(128 * 1024)
+#define MAX_TERMS	8
+#define MAX_VALUES	8
+
+/* Record direction */
+enum
+{
+    CAP_RX,
+    CAP_TX,
+    CAP_PAD	    /* Padding until the end of the ring */
+};
+
+/* Ring state. The thread owning the ring retires it when it exits, then
+ * the capture thread frees it once it has been drained, so that the ring
+ * can be given to a new thread.
+ */
+enum
+{
+    RING_ACTIVE,
+    RING_RETIRED,
+    RING_FREE
+};
+
+/* Packet record in the ring, followed by the packet. */
+typedef struct cap_rec
+{
+    pj_uint32_t	    size;	/* Size of the record, including padding */
+    pj_uint16_t	    len;	/* Length of the packet */
+    pj_uint8_t	    dir;	/* CAP_RX, CAP_TX or CAP_PAD */
+    pj_uint8_t	    tp_type;	/* Transport type, without IPv6 flag */
+    pj_time_val	    ts;
+    pj_sockaddr	    src;
+    pj_sockaddr	    dst;
+} cap_rec;
+
+#define REC_HDR_LEN	((sizeof(cap_rec) + REC_ALIGN-1) & ~(REC_ALIGN-1))
+
+/* Single producer, single consumer ring. The indexes are free running and
+ * only masked when accessing the buffer.
+ */
+typedef struct cap_ring
+{
+    unsigned	    head;	/* Written by producer only */
+    char	    pad1[64];	/* Keep the indexes in separate cache lines */
+    unsigned	    tail;	/* Written by consumer only */
+    char	    pad2[64];
+    unsigned	    size;
+    char	   *buf;
+    pj_lock_t	   *lock;	/* Only for shared ring, or if required */
+    pjsip_capture  *cap;
+    unsigned	    state;	/* RING_ACTIVE, RING_RETIRED or RING_FREE */
+    pj_uint32_t	    captured;
+    pj_uint32_t	    dropped;
+} cap_ring;
+
+/* Filter keys */
+enum filter_key
+{
+    FK_METHOD,
+    FK_DIR,
+    FK_TP,
+    FK_HOST,
+    FK_PORT
+};
+
+/* Filter term */
+typedef struct filter_term
+{
+    int		    key;
+    pj_bool_t	    neg;
+    unsigned	    cnt;
+    pj_str_t	    str[MAX_VALUES];
+    int		    num[MAX_VALUES];
+    pj_sockaddr	    addr[MAX_VALUES];
+} filter_term;
+
+/* Capture instance */
+struct pjsip_capture
+{
+    pj_pool_t	       *pool;
+    pjsip_endpoint     *endpt;
+    pjsip_module	mod;
+    pjsip_capture_cfg	cfg;
+
+    unsigned		term_cnt;
+    filter_term		term[MAX_TERMS];
+
+    long		tls_id;
+    pj_lock_t	       *lock;
+    unsigned		ring_cnt;
+    cap_ring	       *ring[PJSIP_CAPTURE_MAX_THREADS];
+    cap_ring	       *shared;
+
+    pj_thread_t	       *thread;
+    pj_bool_t		quit;
+
+    pj_oshandle_t	fd;
+    pj_sock_t		hep_sock;
+    char	       *out_buf;
+    unsigned		out_len;
+    pj_uint32_t		written;
+};
+
+/* There can only be one capture, as module callbacks have no user data */
+static pjsip_capture *the_capture;
+
+static pj_bool_t mod_capture_on_rx(pjsip_rx_data *rdata);
+static pj_status_t mod_capture_on_tx(pjsip_tx_data *tdata);
+
+
+/*****************************************************************************
+ * Filter.
+ */
+
+/* Get built-in transport type from name. We don't use
+ * pjsip_transport_get_type_from_name() since it asserts on unknown names.
+ */
+static int get_tp_type(const pj_str_t *name)
+{
+    int type;
+
+    for (type=PJSIP_TRANSPORT_UDP; type<=PJSIP_TRANSPORT_WSS; ++type) {
+	const char *tp_name;
+
+	if (type == PJSIP_TRANSPORT_START_OTHER)
+	    continue;
+
+	tp_name = pjsip_transport_get_type_name((pjsip_transport_type_e)type);
+	if (pj_stricmp2(name, tp_name)==0)
+	    return type;
+    }
+
+    return PJSIP_TRANSPORT_UNSPECIFIED;
+}
+
+/* Parse filter expression */
+static pj_status_t parse_filter(pjsip_capture *cap, const pj_str_t *expr)
+{
+    char *p = expr->ptr, *end = expr->ptr + expr->slen;
+
+    cap->term_cnt = 0;
+
+    for (;;) {
+	filter_term *t;
+	pj_str_t key, val;
+	char *e;
+
+	while (p != end && pj_isspace(*p))
+	    ++p;
+	if (p == end)
+	    break;
+
+	if (cap->term_cnt == MAX_TERMS)
+	    return PJ_ETOOMANY;
+
+	t = &cap->term[cap->term_cnt++];
+	pj_bzero(t, sizeof(*t));
+
+	if (*p == '!') {
+	    t->neg = PJ_TRUE;
+	    ++p;
+	}
+
+	/* Key */
+	key.ptr = p;
+	while (p != end && *p != '=' && !pj_isspace(*p))
+	    ++p;
+	key.slen = p - key.ptr;
+	if (p == end || *p != '=')
+	    return PJ_EINVAL;
+	++p;
+
+	if (pj_stricmp2(&key, "method")==0)
+	    t->key = FK_METHOD;
+	else if (pj_stricmp2(&key, "dir")==0)
+	    t->key = FK_DIR;
+	else if (pj_stricmp2(&key, "tp")==0)
+	    t->key = FK_TP;
+	else if (pj_stricmp2(&key, "host")==0)
+	    t->key = FK_HOST;
+	else if (pj_stricmp2(&key, "port")==0)
+	    t->key = FK_PORT;
+	else
+	    return PJ_EINVAL;
+
+	/* Values */
+	e = p;
+	while (e != end && !pj_isspace(*e))
+	    ++e;
+
+	while (p < e) {
+	    val.ptr = p;
+	    while (p != e && *p != ',')
+		++p;
+	    val.slen = p - val.ptr;
+	    if (p != e)
+		++p;
+
+	    if (val.slen == 0)
+		return PJ_EINVAL;
+	    if (t->cnt == MAX_VALUES)
+		return PJ_ETOOMANY;
+
+	    switch (t->key) {
+	    case FK_METHOD:
+		pj_strdup(cap->pool, &t->str[t->cnt], &val);
+		break;
+	    case FK_DIR:
+		if (pj_stricmp2(&val, "rx")==0)
+		    t->num[t->cnt] = CAP_RX;
+		else if (pj_stricmp2(&val, "tx")==0)
+		    t->num[t->cnt] = CAP_TX;
+		else
+		    return PJ_EINVAL;
+		break;
+	    case FK_TP:
+		t->num[t->cnt] = get_tp_type(&val);
+		if (t->num[t->cnt] == PJSIP_TRANSPORT_UNSPECIFIED)
+		    return PJ_EINVAL;
+		break;
+	    case FK_HOST:
+		if (pj_sockaddr_parse(pj_AF_UNSPEC(), 0, &val,
+				      &t->addr[t->cnt]) != PJ_SUCCESS)
+		{
+		    return PJ_EINVAL;
+		}
+		break;
+	    case FK_PORT:
+		t->num[t->cnt] = (int)pj_strtoul(&val);
+		break;
+	    }
+	    ++t->cnt;
+	}
+
+	if (t->cnt == 0)
+	    return PJ_EINVAL;
+	p = e;
+    }
+
+    return PJ_SUCCESS;
+}
+
+/* Check whether the packet matches the filter */
+static pj_bool_t filter_match(const pjsip_capture *cap, int dir, int tp_type,
+			      const pj_str_t *method, const pj_sockaddr *rem)
+{
+    unsigned i, j;
+
+    for (i=0; i<cap->term_cnt; ++i) {
+	const filter_term *t = &cap->term[i];
+	pj_bool_t match = PJ_FALSE;
+
+	for (j=0; j<t->cnt && !match; ++j) {
+	    switch (t->key) {
+	    case FK_METHOD:
+		match = method && pj_stricmp(method, &t->str[j])==0;
+		break;
+	    case FK_DIR:
+		match = (dir == t->num[j]);
+		break;
+	    case FK_TP:
+		match = (tp_type == t->num[j]);
+		break;
+	    case FK_HOST:
+		match = rem->addr.sa_family == t->addr[j].addr.sa_family &&
+			pj_memcmp(pj_sockaddr_get_addr(rem),
+				  pj_sockaddr_get_addr(&t->addr[j]),
+				  pj_sockaddr_get_addr_len(rem))==0;
+		break;
+	    case FK_PORT:
+		match = (pj_sockaddr_get_port(rem) == t->num[j]);
+		break;
+	    }
+	}
+
+	if (match == t->neg)
+	    return PJ_FALSE;
+    }
+
+    return PJ_TRUE;
+}
+
+
+/*****************************************************************************
+ * Producer side.
+ */
+
+/* Create ring */
+static cap_ring *ring_create(pjsip_capture *cap, pj_bool_t shared)
+{
+    cap_ring *r;
+
+    r = PJ_POOL_ZALLOC_T(cap->pool, cap_ring);
+    r->cap = cap;
+    r->size = cap->cfg.ring_size;
+    r->buf = (char*) pj_pool_alloc(cap->pool, r->size);
+
+    if (shared || RING_NEEDS_LOCK) {
+	if (pj_lock_create_simple_mutex(cap->pool, "capring",
+					&r->lock) != PJ_SUCCESS)
+	{
+	    return NULL;
+	}
+    }
+
+    return r;
+}
+
+/* Called by a thread which exits while it has a ring */
+static void ring_retire(void *value)
+{
+    cap_ring *r = (cap_ring*) value;
+
+    /* Our last packet has been published already */
+    if (r != r->cap->shared)
+	PJ_ATOMIC_STORE_RELEASE(&r->state, RING_RETIRED);
+}
+
+/* Get the ring of the calling thread */
+static cap_ring *get_ring(pjsip_capture *cap)
+{
+    cap_ring *r;
+    unsigned i;
+
+    r = (cap_ring*) pj_thread_local_get(cap->tls_id);
+    if (r)
+	return r;
+
+    pj_lock_acquire(cap->lock);
+
+    /* Reuse the ring of a thread which has exited */
+    for (i=0; i<cap->ring_cnt; ++i) {
+	if (cap->ring[i]->state == RING_FREE) {
+	    r = cap->ring[i];
+	    r->state = RING_ACTIVE;
+	    break;
+	}
+    }
+
+    if (!r && cap->ring_cnt < PJ_ARRAY_SIZE(cap->ring)) {
+	r = ring_create(cap, PJ_FALSE);
+	if (r) {
+	    cap->ring[cap->ring_cnt] = r;
+	    PJ_ATOMIC_STORE_RELEASE(&cap->ring_cnt, cap->ring_cnt + 1);
+	}
+    }
+    if (!r)
+	r = cap->shared;
+
+    pj_lock_release(cap->lock);
+
+    pj_thread_local_set(cap->tls_id, r);
+    return r;
+}
+
+/* Copy packet to the ring */
+static void ring_put(cap_ring *r, int dir, int tp_type,
+		     const pj_sockaddr *src, const pj_sockaddr *dst,
+		     const char *pkt, pj_size_t len)
+{
+    unsigned head, tail, off, need, contig;
+    cap_rec *rec;
+
+    if (r->lock)
+	pj_lock_acquire(r->lock);
+
+    need = (unsigned)((REC_HDR_LEN + len + REC_ALIGN-1) & ~(REC_ALIGN-1));
+    head = r->head;
+    tail = PJ_ATOMIC_LOAD_ACQUIRE(&r->tail);
+    off = head & (r->size - 1);
+    contig = r->size - off;
+
+    /* Records don't wrap, pad the rest of the ring if necessary */
+    if (len > MAX_PKT_LEN || need > r->size / 4 ||
+	r->size - (head - tail) < (contig < need ? contig + need : need))
+    {
+	++r->dropped;
+	goto on_return;
+    }
+
+    if (contig < need) {
+	rec = (cap_rec*)(r->buf + off);
+	rec->size = contig;
+	rec->dir = CAP_PAD;
+	head += contig;
+	off = 0;
+    }
+
+    rec = (cap_rec*)(r->buf + off);
+    rec->size = need;
+    rec->len = (pj_uint16_t)len;
+    rec->dir = (pj_uint8_t)dir;
+    rec->tp_type = (pj_uint8_t)tp_type;
+    pj_gettimeofday(&rec->ts);
+    pj_sockaddr_cp(&rec->src, src);
+    pj_sockaddr_cp(&rec->dst, dst);
+    pj_memcpy(r->buf + off + REC_HDR_LEN, pkt, len);
+
+    PJ_ATOMIC_STORE_RELEASE(&r->head, head + need);
+    ++r->captured;
+
+on_return:
+    if (r->lock)
+	pj_lock_release(r->lock);
+}
+
+/* Capture a packet */
+static void capture(pjsip_capture *cap, int dir, pjsip_transport *tp,
+		    const pj_sockaddr *rem, const pj_str_t *method,
+		    const char *pkt, pj_size_t len)
+{
+    int tp_type = tp->key.type & ~PJSIP_TRANSPORT_IPV6;
+
+    if (cap->term_cnt && !filter_match(cap, dir, tp_type, method, rem))
+	return;
+
+    if (dir == CAP_RX)
+	ring_put(get_ring(cap), dir, tp_type, rem, &tp->local_addr, pkt, len);
+    else
+	ring_put(get_ring(cap), dir, tp_type, &tp->local_addr, rem, pkt, len);
+}
+
+static pj_bool_t mod_capture_on_rx(pjsip_rx_data *rdata)
+{
+    pjsip_capture *cap = the_capture;
+    pjsip_msg *msg = rdata->msg_info.msg;
+    const pj_str_t *method = NULL;
+
+    if (!cap)
+	return PJ_FALSE;
+
+    if (msg->type == PJSIP_REQUEST_MSG)
+	method = &msg->line.req.method.name;
+    else if (rdata->msg_info.cseq)
+	method = &rdata->msg_info.cseq->method.name;
+
+    capture(cap, CAP_RX, rdata->tp_info.transport, &rdata->pkt_info.src_addr,
+	    method, rdata->msg_info.msg_buf, rdata->msg_info.len);
+
+    return PJ_FALSE;
+}
+
+static pj_status_t mod_capture_on_tx(pjsip_tx_data *tdata)
+{
+    pjsip_capture *cap = the_capture;
+    pjsip_msg *msg = tdata->msg;
+    const pj_str_t *method = NULL;
+
+    if (!cap)
+	return PJ_SUCCESS;
+
+    if (msg->type == PJSIP_REQUEST_MSG) {
+	method = &msg->line.req.method.name;
+    } else {
+	pjsip_cseq_hdr *cseq;
+	cseq = (pjsip_cseq_hdr*) pjsip_msg_find_hdr(msg, PJSIP_H_CSEQ, NULL);
+	if (cseq)
+	    method = &cseq->method.name;
+    }
+
+    capture(cap, CAP_TX, tdata->tp_info.transport,
+	    (const pj_sockaddr*)&tdata->tp_info.dst_addr, method,
+	    tdata->buf.start, tdata->buf.cur - tdata->buf.start);
+
+    return PJ_SUCCESS;
+}
+
+
+/*****************************************************************************
+ * Consumer side.
+ */
+
+#define PUT8(p,v)   (*(p)++ = (pj_uint8_t)(v))
+#define PUT16(p,v)  (PUT8(p,(v)>>8), PUT8(p,v))
+#define PUT32(p,v)  (PUT16(p,(v)>>16), PUT16(p,v))
+
+static void flush_pcap(pjsip_capture *cap)
+{
+    pj_ssize_t size = cap->out_len;
+
+    if (size)
+	pj_file_write(cap->fd, cap->out_buf, &size);
+    cap->out_len = 0;
+}
+
+/* Get the address of the specified family, for building the headers */
+static const pj_uint8_t *rec_addr(const pj_sockaddr *addr, int af)
+{
+    static const pj_uint8_t zero[16];
+
+    if (addr->addr.sa_family != af)
+	return zero;
+    return (const pj_uint8_t*) pj_sockaddr_get_addr(addr);
+}
+
+/* Write a record to the pcap buffer, as UDP over Ethernet */
+static void write_pcap(pjsip_capture *cap, const cap_rec *rec,
+		       const char *pkt)
+{
+    int af = rec->dst.addr.sa_family;
+    unsigned ip_len = (af == pj_AF_INET6()) ? 40 : 20;
+    unsigned frame_len = 14 + ip_len + 8 + rec->len;
+    pj_uint32_t hdr[4];
+    pj_uint8_t *p, *ip;
+    unsigned i, sum;
+
+    if (cap->out_len + sizeof(hdr) + frame_len > OUT_BUF_SIZE)
+	flush_pcap(cap);
+
+    /* Record header, in host byte order */
+    hdr[0] = (pj_uint32_t)rec->ts.sec;
+    hdr[1] = (pj_uint32_t)rec->ts.msec * 1000;
+    hdr[2] = hdr[3] = frame_len;
+    pj_memcpy(cap->out_buf + cap->out_len, hdr, sizeof(hdr));
+    p = (pj_uint8_t*)cap->out_buf + cap->out_len + sizeof(hdr);
+
+    /* Ethernet */
+    pj_bzero(p, 12);
+    p += 12;
+    PUT16(p, (af == pj_AF_INET6()) ? 0x86DD : 0x0800);
+
+    /* IP */
+    ip = p;
+    if (af == pj_AF_INET6()) {
+	PUT32(p, 0x60000000);
+	PUT16(p, 8 + rec->len);
+	PUT8(p, 17);
+	PUT8(p, 64);
+	pj_memcpy(p, rec_addr(&rec->src, af), 16);
+	pj_memcpy(p+16, rec_addr(&rec->dst, af), 16);
+	p += 32;
+    } else {
+	PUT8(p, 0x45);
+	PUT8(p, 0);
+	PUT16(p, 20 + 8 + rec->len);
+	PUT32(p, 0);
+	PUT8(p, 64);
+	PUT8(p, 17);
+	PUT16(p, 0);
+	pj_memcpy(p, rec_addr(&rec->src, af), 4);
+	pj_memcpy(p+4, rec_addr(&rec->dst, af), 4);
+	p += 8;
+
+	for (i=0, sum=0; i<20; i+=2)
+	    sum += (ip[i] << 8) | ip[i+1];
+	while (sum >> 16)
+	    sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = ~sum & 0xFFFF;
+	ip[10] = (pj_uint8_t)(sum >> 8);
+	ip[11] = (pj_uint8_t)sum;
+    }
+
+    /* UDP, without checksum */
+    PUT16(p, pj_sockaddr_get_port(&rec->src));
+    PUT16(p, pj_sockaddr_get_port(&rec->dst));
+    PUT16(p, 8 + rec->len);
+    PUT16(p, 0);
+
+    pj_memcpy(p, pkt, rec->len);
+    cap->out_len += sizeof(hdr) + frame_len;
+}
+
+/* Put HEP chunk header */
+static pj_uint8_t *hep_chunk(pj_uint8_t *p, unsigned type, unsigned len)
+{
+    PUT16(p, 0);
+    PUT16(p, type);
+    PUT16(p, 6 + len);
+    return p;
+}
+
+/* Send a record to HEPv3 collector */
+static void send_hep(pjsip_capture *cap, const cap_rec *rec, const char *pkt)
+{
+    int af = rec->dst.addr.sa_family;
+    unsigned addr_len = (af == pj_AF_INET6()) ? 16 : 4;
+    pj_uint8_t *start = (pj_uint8_t*)cap->out_buf, *p = start;
+    pj_ssize_t size;
+
+    pj_memcpy(p, "HEP3", 4);
+    p += 6;
+
+    p = hep_chunk(p, 1, 1);
+    PUT8(p, (af == pj_AF_INET6()) ? 10 : 2);
+    p = hep_chunk(p, 2, 1);
+    PUT8(p, (rec->tp_type == PJSIP_TRANSPORT_UDP) ? 17 : 6);
+    p = hep_chunk(p, (af == pj_AF_INET6()) ? 5 : 3, addr_len);
+    pj_memcpy(p, rec_addr(&rec->src, af), addr_len);
+    p += addr_len;
+    p = hep_chunk(p, (af == pj_AF_INET6()) ? 6 : 4, addr_len);
+    pj_memcpy(p, rec_addr(&rec->dst, af), addr_len);
+    p += addr_len;
+    p = hep_chunk(p, 7, 2);
+    PUT16(p, pj_sockaddr_get_port(&rec->src));
+    p = hep_chunk(p, 8, 2);
+    PUT16(p, pj_sockaddr_get_port(&rec->dst));
+    p = hep_chunk(p, 9, 4);
+    PUT32(p, (pj_uint32_t)rec->ts.sec);
+    p = hep_chunk(p, 10, 4);
+    PUT32(p, (pj_uint32_t)rec->ts.msec * 1000);
+    p = hep_chunk(p, 11, 1);
+    PUT8(p, 1);	/* SIP */
+    p = hep_chunk(p, 12, 4);
+    PUT32(p, cap->cfg.hep_id);
+    if (cap->cfg.hep_password.slen) {
+	p = hep_chunk(p, 14, (unsigned)cap->cfg.hep_password.slen);
+	pj_memcpy(p, cap->cfg.hep_password.ptr, cap->cfg.hep_password.slen);
+	p += cap->cfg.hep_password.slen;
+    }
+    p = hep_chunk(p, 15, rec->len);
+    pj_memcpy(p, pkt, rec->len);
+    p += rec->len;
+
+    /* Total length */
+    size = p - start;
+    start[4] = (pj_uint8_t)(size >> 8);
+    start[5] = (pj_uint8_t)size;
+
+    pj_sock_sendto(cap->hep_sock, start, &size, 0, &cap->cfg.hep_addr,
+		   pj_sockaddr_get_len(&cap->cfg.hep_addr));
+}
+
+/* Write the records of a ring to the output */
+static void ring_drain(pjsip_capture *cap, cap_ring *r)
+{
+    unsigned head, tail;
+
+    if (r->lock)
+	pj_lock_acquire(r->lock);
+
+    head = PJ_ATOMIC_LOAD_ACQUIRE(&r->head);
+    tail = r->tail;
+
+    while (tail != head) {
+	const cap_rec *rec = (cap_rec*)(r->buf + (tail & (r->size - 1)));
+
+	if (rec->dir != CAP_PAD) {
+	    const char *pkt = (const char*)rec + REC_HDR_LEN;
+
+	    if (cap->cfg.output == PJSIP_CAPTURE_HEP)
+		send_hep(cap, rec, pkt);
+	    else
+		write_pcap(cap, rec, pkt);
+	    ++cap->written;
+	}
+	tail += rec->size;
+    }
+
+    PJ_ATOMIC_STORE_RELEASE(&r->tail, tail);
+
+    if (r->lock)
+	pj_lock_release(r->lock);
+}
+
+/* Drain all rings */
+static void drain(pjsip_capture *cap)
+{
+    unsigned i, cnt = PJ_ATOMIC_LOAD_ACQUIRE(&cap->ring_cnt);
+
+    for (i=0; i<cnt; ++i) {
+	cap_ring *r = cap->ring[i];
+
+	if (PJ_ATOMIC_LOAD_ACQUIRE(&r->state) == RING_RETIRED) {
+	    /* The owner has gone, this drains its last packets */
+	    ring_drain(cap, r);
+
+	    pj_lock_acquire(cap->lock);
+	    r->state = RING_FREE;
+	    pj_lock_release(cap->lock);
+	} else {
+	    ring_drain(cap, r);
+	}
+    }
+    ring_drain(cap, cap->shared);
+
+    if (cap->cfg.output == PJSIP_CAPTURE_PCAP)
+	flush_pcap(cap);
+}
+
+static int capture_thread(void *arg)
+{
+    pjsip_capture *cap = (pjsip_capture*) arg;
+
+    while (!cap->quit) {
+	drain(cap);
+	pj_thread_sleep(cap->cfg.drain_interval);
+    }
+
+    return 0;
+}
+
+
+/*****************************************************************************
+ * API.
+ */
+
+PJ_DEF(void) pjsip_capture_cfg_default(pjsip_capture_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->output = PJSIP_CAPTURE_PCAP;
+    cfg->ring_size = PJSIP_CAPTURE_RING_SIZE;
+    cfg->drain_interval = PJSIP_CAPTURE_DRAIN_INTERVAL;
+}
+
+/* Release resources */
+static void capture_release(pjsip_capture *cap)
+{
+    unsigned i;
+
+    if (cap->fd) {
+	pj_file_close(cap->fd);
+	cap->fd = NULL;
+    }
+    if (cap->hep_sock != PJ_INVALID_SOCKET) {
+	pj_sock_close(cap->hep_sock);
+	cap->hep_sock = PJ_INVALID_SOCKET;
+    }
+    if (cap->tls_id != -1) {
+	pj_thread_local_free(cap->tls_id);
+	cap->tls_id = -1;
+    }
+    for (i=0; i<cap->ring_cnt; ++i) {
+	if (cap->ring[i]->lock)
+	    pj_lock_destroy(cap->ring[i]->lock);
+    }
+    if (cap->shared && cap->shared->lock)
+	pj_lock_destroy(cap->shared->lock);
+    if (cap->lock)
+	pj_lock_destroy(cap->lock);
+
+    pjsip_endpt_release_pool(cap->endpt, cap->pool);
+}
+
+PJ_DEF(pj_status_t) pjsip_capture_create(pjsip_endpoint *endpt,
+					 const pjsip_capture_cfg *cfg,
+					 pjsip_capture **p_cap)
+{
+    pj_pool_t *pool;
+    pjsip_capture *cap;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt && cfg && p_cap, PJ_EINVAL);
+    /* Ring size must be power of two */
+    PJ_ASSERT_RETURN(cfg->ring_size >= 4096 &&
+		     (cfg->ring_size & (cfg->ring_size-1)) == 0, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cfg->output != PJSIP_CAPTURE_PCAP ||
+		     cfg->pcap_file.slen, PJ_EINVAL);
+
+    if (the_capture)
+	return PJ_EEXISTS;
+
+    pool = pjsip_endpt_create_pool(endpt, "capture%p", 4000, 4000);
+    PJ_ASSERT_RETURN(pool, PJ_ENOMEM);
+
+    cap = PJ_POOL_ZALLOC_T(pool, pjsip_capture);
+    cap->pool = pool;
+    cap->endpt = endpt;
+    cap->tls_id = -1;
+    cap->hep_sock = PJ_INVALID_SOCKET;
+    pj_memcpy(&cap->cfg, cfg, sizeof(*cfg));
+    pj_strdup_with_null(pool, &cap->cfg.pcap_file, &cfg->pcap_file);
+    pj_strdup(pool, &cap->cfg.hep_password, &cfg->hep_password);
+    pj_strdup(pool, &cap->cfg.filter, &cfg->filter);
+    if (cap->cfg.drain_interval == 0)
+	cap->cfg.drain_interval = PJSIP_CAPTURE_DRAIN_INTERVAL;
+
+    status = parse_filter(cap, &cap->cfg.filter);
+    if (status != PJ_SUCCESS) {
+	PJ_LOG(2,(THIS_FILE, "Invalid capture filter \"%.*s\"",
+		  (int)cfg->filter.slen, cfg->filter.ptr));
+	goto on_error;
+    }
+
+    cap->out_buf = (char*) pj_pool_alloc(pool, OUT_BUF_SIZE);
+
+    status = pj_lock_create_simple_mutex(pool, "capture", &cap->lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    cap->shared = ring_create(cap, PJ_TRUE);
+    if (!cap->shared) {
+	status = PJ_ENOMEM;
+	goto on_error;
+    }
+
+    /* Without thread exit notification, rings are never reused */
+    status = pj_thread_local_alloc2(&cap->tls_id, &ring_retire);
+    if (status == PJ_ENOTSUP)
+	status = pj_thread_local_alloc(&cap->tls_id);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Open output */
+    if (cfg->output == PJSIP_CAPTURE_HEP) {
+	status = pj_sock_socket(cfg->hep_addr.addr.sa_family, pj_SOCK_DGRAM(),
+				0, &cap->hep_sock);
+    } else {
+	pj_uint32_t hdr[6];
+	pj_ssize_t size = sizeof(hdr);
+
+	status = pj_file_open(pool, cap->cfg.pcap_file.ptr, PJ_O_WRONLY,
+			      &cap->fd);
+	if (status == PJ_SUCCESS) {
+	    /* Global header, in host byte order */
+	    hdr[0] = 0xa1b2c3d4;
+	    hdr[1] = 2 | (4 << 16);
+	    hdr[2] = 0;
+	    hdr[3] = 0;
+	    hdr[4] = 65535;
+	    hdr[5] = 1;	/* Ethernet */
+#if defined(PJ_IS_BIG_ENDIAN) && PJ_IS_BIG_ENDIAN!=0
+	    hdr[1] = 4 | (2 << 16);
+#endif
+	    status = pj_file_write(cap->fd, hdr, &size);
+	}
+    }
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(2,(THIS_FILE, status, "Unable to open capture output"));
+	goto on_error;
+    }
+
+    status = pj_thread_create(pool, "capture", &capture_thread, cap,
+			      0, 0, &cap->thread);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Register module, at the same level as the message logger, so that
+     * outgoing messages have been printed.
+     */
+    cap->mod.name = pj_str("mod-capture");
+    cap->mod.id = -1;
+    cap->mod.priority = PJSIP_MOD_PRIORITY_TRANSPORT_LAYER - 1;
+    cap->mod.on_rx_request = &mod_capture_on_rx;
+    cap->mod.on_rx_response = &mod_capture_on_rx;
+    cap->mod.on_tx_request = &mod_capture_on_tx;
+    cap->mod.on_tx_response = &mod_capture_on_tx;
+
+    the_capture = cap;
+    status = pjsip_endpt_register_module(endpt, &cap->mod);
+    if (status != PJ_SUCCESS) {
+	the_capture = NULL;
+	cap->quit = PJ_TRUE;
+	pj_thread_join(cap->thread);
+	pj_thread_destroy(cap->thread);
+	goto on_error;
+    }
+
+    PJ_LOG(4,(THIS_FILE, "SIP capture started to %s",
+	      (cfg->output == PJSIP_CAPTURE_HEP ? "HEP collector" :
+	       cap->cfg.pcap_file.ptr)));
+
+    *p_cap = cap;
+    return PJ_SUCCESS;
+
+on_error:
+    capture_release(cap);
+    return status;
+}
+
+PJ_DEF(pj_status_t) pjsip_capture_get_stat(pjsip_capture *cap,
+					   pjsip_capture_stat *stat)
+{
+    unsigned i, cnt;
+
+    PJ_ASSERT_RETURN(cap && stat, PJ_EINVAL);
+
+    pj_bzero(stat, sizeof(*stat));
+    cnt = PJ_ATOMIC_LOAD_ACQUIRE(&cap->ring_cnt);
+    for (i=0; i<cnt; ++i) {
+	stat->captured += cap->ring[i]->captured;
+	stat->dropped += cap->ring[i]->dropped;
+	if (PJ_ATOMIC_LOAD_ACQUIRE(&cap->ring[i]->state) != RING_FREE)
+	    ++stat->rings;
+    }
+    stat->captured += cap->shared->captured;
+    stat->dropped += cap->shared->dropped;
+    stat->written = cap->written;
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjsip_capture_destroy(pjsip_capture *cap)
+{
+    pjsip_capture_stat stat;
+
+    PJ_ASSERT_RETURN(cap, PJ_EINVAL);
+
+    /* No more packets are captured once the module is unregistered */
+    pjsip_endpt_unregister_module(cap->endpt, &cap->mod);
+    the_capture = NULL;
+
+    cap->quit = PJ_TRUE;
+    pj_thread_join(cap->thread);
+    pj_thread_destroy(cap->thread);
+
+    /* Write what's left */
+    drain(cap);
+
+    pjsip_capture_get_stat(cap, &stat);
+    PJ_LOG(4,(THIS_FILE, "SIP capture stopped: %u packets captured, "
+	      "%u dropped", stat.captured, stat.dropped));
+
+    capture_release(cap);
+    return PJ_SUCCESS;
+}
@@ -35,7 +35,8 @@ pjsip_cfg_t pjsip_sip_cfg_var =
        PJSIP_REQ_HAS_VIA_ALIAS,
        PJSIP_RESOLVE_HOSTNAME_TO_GET_INTERFACE,
        0,
-       PJSIP_ENCODE_SHORT_HNAME
+       PJSIP_ENCODE_SHORT_HNAME,
+       PJSIP_LATENCY_STATS
     },
 
     /* Transaction settings */
@@ -54,12 +55,22 @@ pjsip_cfg_t pjsip_sip_cfg_var =
 
     /* TCP transport settings */
     {
-        PJSIP_TCP_KEEP_ALIVE_INTERVAL
+        PJSIP_TCP_KEEP_ALIVE_INTERVAL,
+        PJSIP_TCP_IDLE_TIMEOUT,
+        PJSIP_TCP_TLS_READ_SLAB
     },
 
     /* TLS transport settings */
     {
-        PJSIP_TLS_KEEP_ALIVE_INTERVAL
+        PJSIP_TLS_KEEP_ALIVE_INTERVAL,
+        PJSIP_TLS_IDLE_TIMEOUT,
+        PJSIP_TCP_TLS_READ_SLAB
+    },
+
+    /* WebSocket transport settings */
+    {
+        PJSIP_WS_KEEP_ALIVE_INTERVAL,
+        PJSIP_WS_IDLE_TIMEOUT
     }
 };
 
@@ -40,6 +40,9 @@
 
 long pjsip_dlg_lock_tls_id;
 
+/* Slab for the dialog objects, created by sip_ua_layer.c */
+pj_slab_t *pjsip_dlg_slab;
+
 /* Config */
 pj_bool_t pjsip_include_allow_hdr_in_dlg = PJSIP_INCLUDE_ALLOW_HDR_IN_DLG;
 
@@ -73,16 +76,20 @@ static pj_status_t create_dialog( pjsip_user_agent *ua,
     if (!endpt)
 	return PJ_EINVALIDOP;
 
+    dlg = (pjsip_dialog*) pj_slab_zalloc(pjsip_dlg_slab);
+    if (!dlg)
+	return PJ_ENOMEM;
+
     pool = pjsip_endpt_create_pool(endpt, "dlg%p",
 				   PJSIP_POOL_LEN_DIALOG,
 				   PJSIP_POOL_INC_DIALOG);
-    if (!pool)
+    if (!pool) {
+	pj_slab_free(pjsip_dlg_slab, dlg);
 	return PJ_ENOMEM;
-
-    dlg = PJ_POOL_ZALLOC_T(pool, pjsip_dialog);
-    PJ_ASSERT_RETURN(dlg != NULL, PJ_ENOMEM);
+    }
 
     dlg->pool = pool;
+    dlg->slab = pjsip_dlg_slab;
     pj_ansi_snprintf(dlg->obj_name, sizeof(dlg->obj_name), "dlg%p", dlg);
     dlg->ua = ua;
     dlg->endpt = endpt;
@@ -111,6 +118,7 @@ on_error:
     if (dlg->mutex_)
 	pj_mutex_destroy(dlg->mutex_);
     pjsip_endpt_release_pool(endpt, pool);
+    pj_slab_free(dlg->slab, dlg);
     return status;
 }
 
@@ -127,6 +135,7 @@ static void destroy_dialog( pjsip_dialog *dlg, pj_bool_t unlock_mutex )
     }
     pjsip_auth_clt_deinit(&dlg->auth_sess);
     pjsip_endpt_release_pool(dlg->endpt, dlg->pool);
+    pj_slab_free(dlg->slab, dlg);
 }
 
 
@@ -213,7 +222,7 @@ PJ_DEF(pj_status_t) pjsip_dlg_create_uac( pjsip_user_agent *ua,
     }
 
     /* Generate local tag. */
-    pj_create_unique_string(dlg->pool, &dlg->local.info->tag);
+    pj_create_unique_string_fast(dlg->pool, &dlg->local.info->tag);
 
     /* Calculate hash value of local tag. */
     dlg->local.tag_hval = pj_hash_calc_tolower(0, NULL,
@@ -364,7 +373,7 @@ pj_status_t create_uas_dialog( pjsip_user_agent *ua,
     pjsip_fromto_hdr_set_from(dlg->local.info);
 
     /* Generate local tag. */
-    pj_create_unique_string(dlg->pool, &dlg->local.info->tag);
+    pj_create_unique_string_fast(dlg->pool, &dlg->local.info->tag);
 
 
     /* Print the local info. */
@@ -25,6 +25,7 @@
 #include <pjsip/sip_module.h>
 #include <pjsip/sip_util.h>
 #include <pjsip/sip_errno.h>
+#include <pjsip/sip_latency.h>
 #include <pj/except.h>
 #include <pj/log.h>
 #include <pj/string.h>
@@ -836,6 +837,7 @@ PJ_DEF(pj_status_t) pjsip_endpt_process_rx_data( pjsip_endpoint *endpt,
     pjsip_process_rdata_param def_prm;
     pjsip_module *mod;
     pj_bool_t handled = PJ_FALSE;
+    pj_timestamp ts;
     unsigned i;
     pj_status_t status;
 
@@ -889,16 +891,22 @@ PJ_DEF(pj_status_t) pjsip_endpt_process_rx_data( pjsip_endpoint *endpt,
     /* Distribute */
     if (msg->type == PJSIP_REQUEST_MSG) {
 	do {
-	    if (mod->on_rx_request)
+	    if (mod->on_rx_request) {
+		PJSIP_LAT_BEGIN(&ts);
 		handled = (*mod->on_rx_request)(rdata);
+		PJSIP_LAT_END_MOD(&ts, PJSIP_LAT_MOD_RX_REQ, mod);
+	    }
 	    if (handled)
 		break;
 	    mod = mod->next;
 	} while (mod != &endpt->module_list);
     } else {
 	do {
-	    if (mod->on_rx_response)
+	    if (mod->on_rx_response) {
+		PJSIP_LAT_BEGIN(&ts);
 		handled = (*mod->on_rx_response)(rdata);
+		PJSIP_LAT_END_MOD(&ts, PJSIP_LAT_MOD_RX_RES, mod);
+	    }
 	    if (handled)
 		break;
 	    mod = mod->next;
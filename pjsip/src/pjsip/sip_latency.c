@@ -0,0 +1,298 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjsip/sip_latency.h>
+#include <pjsip/sip_module.h>
+#include <pjsip/sip_transport.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/log.h>
+#include <pj/string.h>
+
+#define THIS_FILE	"sip_latency.c"
+
+#define MOD_NAME_LEN	24
+
+/* Number of histograms of each metric. */
+static const unsigned hist_cnt[PJSIP_LAT_METRIC_CNT] =
+{
+    PJSIP_LAT_MAX_TP_TYPES,	/* PJSIP_LAT_PARSE	*/
+    PJSIP_LAT_MAX_TP_TYPES,	/* PJSIP_LAT_TX		*/
+    2,				/* PJSIP_LAT_TSX_CREATE	*/
+    PJSIP_MAX_MODULE,		/* PJSIP_LAT_MOD_RX_REQ	*/
+    PJSIP_MAX_MODULE		/* PJSIP_LAT_MOD_RX_RES	*/
+};
+
+static const char *metric_names[PJSIP_LAT_METRIC_CNT] =
+{
+    "parse",
+    "tx",
+    "tsx create",
+    "on_rx_request",
+    "on_rx_response"
+};
+
+/* All histograms. */
+static struct lat_stats
+{
+    pjsip_lat_hist  parse[PJSIP_LAT_MAX_TP_TYPES];
+    pjsip_lat_hist  tx[PJSIP_LAT_MAX_TP_TYPES];
+    pjsip_lat_hist  tsx_create[2];
+    pjsip_lat_hist  mod_rx_req[PJSIP_MAX_MODULE];
+    pjsip_lat_hist  mod_rx_res[PJSIP_MAX_MODULE];
+    char	    mod_name[PJSIP_MAX_MODULE][MOD_NAME_LEN];
+} stats;
+
+
+/* Get the histogram of a metric. */
+static pjsip_lat_hist *get_hist(pjsip_lat_metric metric, unsigned index)
+{
+    switch (metric) {
+    case PJSIP_LAT_PARSE:
+    case PJSIP_LAT_TX:
+	/* Share IPv4 and IPv6 variants */
+	index &= ~PJSIP_TRANSPORT_IPV6;
+	if (index >= PJSIP_LAT_MAX_TP_TYPES)
+	    index = PJSIP_TRANSPORT_UNSPECIFIED;
+	return (metric==PJSIP_LAT_PARSE) ? &stats.parse[index] :
+					   &stats.tx[index];
+    case PJSIP_LAT_TSX_CREATE:
+	return (index < 2) ? &stats.tsx_create[index] : NULL;
+    case PJSIP_LAT_MOD_RX_REQ:
+	return (index < PJSIP_MAX_MODULE) ? &stats.mod_rx_req[index] : NULL;
+    case PJSIP_LAT_MOD_RX_RES:
+	return (index < PJSIP_MAX_MODULE) ? &stats.mod_rx_res[index] : NULL;
+    default:
+	return NULL;
+    }
+}
+
+
+/* Get the bucket index of a value. Values below PJSIP_LAT_HIST_SUB_CNT
+ * have their own bucket, above that each power of two is divided into
+ * PJSIP_LAT_HIST_SUB_CNT buckets.
+ */
+static unsigned bucket_index(pj_uint32_t v)
+{
+    unsigned msb = 0;
+    pj_uint32_t t = v;
+
+    if (v < PJSIP_LAT_HIST_SUB_CNT)
+	return v;
+
+    while (t >>= 1)
+	++msb;
+
+    return (msb - PJSIP_LAT_HIST_SUB_BITS + 1) * PJSIP_LAT_HIST_SUB_CNT +
+	   ((v >> (msb - PJSIP_LAT_HIST_SUB_BITS)) &
+	    (PJSIP_LAT_HIST_SUB_CNT - 1));
+}
+
+/* Get the largest value which falls into the bucket. */
+static pj_uint32_t bucket_upper(unsigned b)
+{
+    unsigned shift;
+    pj_uint64_t lo;
+
+    if (b < PJSIP_LAT_HIST_SUB_CNT)
+	return b;
+
+    shift = b / PJSIP_LAT_HIST_SUB_CNT - 1;
+    lo = (pj_uint64_t)(PJSIP_LAT_HIST_SUB_CNT +
+		       (b % PJSIP_LAT_HIST_SUB_CNT)) << shift;
+    lo += ((pj_uint64_t)1 << shift) - 1;
+
+    return (lo > 0xFFFFFFFFUL) ? 0xFFFFFFFFUL : (pj_uint32_t)lo;
+}
+
+
+PJ_DEF(void) pjsip_lat_hist_add(pjsip_lat_hist *hist, pj_uint32_t usec)
+{
+    if (hist->count == 0 || usec < hist->min)
+	hist->min = usec;
+    if (usec > hist->max)
+	hist->max = usec;
+    ++hist->count;
+    hist->total += usec;
+    ++hist->bucket[bucket_index(usec)];
+}
+
+
+PJ_DEF(pj_uint32_t) pjsip_lat_hist_percentile(const pjsip_lat_hist *hist,
+					      unsigned pct)
+{
+    pj_uint64_t target, seen = 0;
+    unsigned i;
+
+    if (hist->count == 0)
+	return 0;
+    if (pct >= 100)
+	return hist->max;
+
+    /* Rank of the sample, rounded up */
+    target = ((pj_uint64_t)hist->count * pct + 99) / 100;
+    if (target == 0)
+	target = 1;
+
+    for (i=0; i<PJSIP_LAT_HIST_BUCKETS; ++i) {
+	seen += hist->bucket[i];
+	if (seen >= target) {
+	    pj_uint32_t upper = bucket_upper(i);
+	    return (upper < hist->max) ? upper : hist->max;
+	}
+    }
+
+    return hist->max;
+}
+
+
+PJ_DEF(void) pjsip_lat_record(pjsip_lat_metric metric, unsigned index,
+			      pj_uint32_t usec)
+{
+    pjsip_lat_hist *hist = get_hist(metric, index);
+
+    if (hist)
+	pjsip_lat_hist_add(hist, usec);
+}
+
+
+PJ_DEF(void) pjsip_lat_record_since(pjsip_lat_metric metric, unsigned index,
+				    const pj_timestamp *start)
+{
+    pj_timestamp now;
+
+    pj_get_timestamp(&now);
+    pjsip_lat_record(metric, index, pj_elapsed_usec(start, &now));
+}
+
+
+PJ_DEF(void) pjsip_lat_record_mod(pjsip_lat_metric metric,
+				  const pjsip_module *mod,
+				  const pj_timestamp *start)
+{
+    pjsip_lat_hist *hist;
+    pj_timestamp now;
+    pj_ssize_t len;
+    char *name;
+
+    pj_get_timestamp(&now);
+
+    PJ_ASSERT_ON_FAIL(metric==PJSIP_LAT_MOD_RX_REQ ||
+		      metric==PJSIP_LAT_MOD_RX_RES, return);
+
+    hist = get_hist(metric, mod->id);
+    if (!hist)
+	return;
+
+    /* Module ids are reused after a module is unregistered, so start over
+     * when another module shows up in the slot.
+     */
+    name = stats.mod_name[mod->id];
+    len = (mod->name.slen < MOD_NAME_LEN) ? mod->name.slen : MOD_NAME_LEN-1;
+    if (name[len] != '\0' || pj_memcmp(name, mod->name.ptr, len) != 0) {
+	pj_bzero(&stats.mod_rx_req[mod->id], sizeof(pjsip_lat_hist));
+	pj_bzero(&stats.mod_rx_res[mod->id], sizeof(pjsip_lat_hist));
+	pj_bzero(name, MOD_NAME_LEN);
+	pj_memcpy(name, mod->name.ptr, len);
+    }
+
+    pjsip_lat_hist_add(hist, pj_elapsed_usec(start, &now));
+}
+
+
+PJ_DEF(pj_status_t) pjsip_lat_get(pjsip_lat_metric metric, unsigned index,
+				  pjsip_lat_hist *hist)
+{
+    pjsip_lat_hist *h;
+
+    PJ_ASSERT_RETURN(hist, PJ_EINVAL);
+
+    h = get_hist(metric, index);
+    if (!h)
+	return PJ_EINVAL;
+
+    pj_memcpy(hist, h, sizeof(*hist));
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(void) pjsip_lat_reset(void)
+{
+    pj_bzero(&stats, sizeof(stats));
+}
+
+
+/* Print one histogram. */
+static void dump_hist(const char *metric, const char *name,
+		      const pjsip_lat_hist *h, pj_bool_t detail)
+{
+    PJ_LOG(3,(THIS_FILE,
+	      " %-14s %-18s n=%u avg=%u p50=%u p90=%u p99=%u max=%u usec",
+	      metric, name, h->count, (unsigned)(h->total / h->count),
+	      pjsip_lat_hist_percentile(h, 50),
+	      pjsip_lat_hist_percentile(h, 90),
+	      pjsip_lat_hist_percentile(h, 99), h->max));
+
+    if (detail) {
+	unsigned i;
+
+	for (i=0; i<PJSIP_LAT_HIST_BUCKETS; ++i) {
+	    if (h->bucket[i] == 0)
+		continue;
+	    PJ_LOG(3,(THIS_FILE, "   <= %10u usec: %u (%u%%)",
+		      bucket_upper(i), h->bucket[i],
+		      (unsigned)((pj_uint64_t)h->bucket[i] * 100 / h->count)));
+	}
+    }
+}
+
+
+PJ_DEF(void) pjsip_lat_dump(pj_bool_t detail)
+{
+    unsigned m, i;
+
+    PJ_LOG(3,(THIS_FILE, "Latency histograms (%s):",
+	      (pjsip_cfg()->endpt.latency_stats ? "enabled" : "disabled")));
+
+    for (m=0; m<PJSIP_LAT_METRIC_CNT; ++m) {
+	for (i=0; i<hist_cnt[m]; ++i) {
+	    pjsip_lat_hist *h = get_hist((pjsip_lat_metric)m, i);
+	    const char *name;
+
+	    if (!h || h->count == 0)
+		continue;
+
+	    switch (m) {
+	    case PJSIP_LAT_PARSE:
+	    case PJSIP_LAT_TX:
+		name = pjsip_transport_get_type_name(
+				    (pjsip_transport_type_e)i);
+		break;
+	    case PJSIP_LAT_TSX_CREATE:
+		name = (i == PJSIP_ROLE_UAC) ? "UAC" : "UAS";
+		break;
+	    default:
+		name = stats.mod_name[i];
+		break;
+	    }
+
+	    dump_hist(metric_names[m], name, h, detail);
+	}
+    }
+}
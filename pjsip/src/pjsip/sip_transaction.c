@@ -23,9 +23,11 @@
 #include <pjsip/sip_endpoint.h>
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_event.h>
+#include <pjsip/sip_latency.h>
 #include <pjlib-util/errno.h>
 #include <pj/hash.h>
 #include <pj/pool.h>
+#include <pj/slab.h>
 #include <pj/os.h>
 #include <pj/rand.h>
 #include <pj/string.h>
@@ -75,6 +77,7 @@ static struct mod_tsx_layer
     pjsip_endpoint	*endpt;
     pj_mutex_t		*mutex;
     pj_hash_table_t	*htable;
+    pj_slab_t		*slab;
 } mod_tsx_layer = 
 {   {
 	NULL, NULL,			/* List's prev and next.    */
@@ -471,15 +474,29 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
 
 
     /* Create hash table. */
+#if PJSIP_HTABLE_RESIZABLE
+    mod_tsx_layer.htable = pj_hash_create_resizable(pool,
+						    pjsip_cfg()->tsx.max_count);
+#else
     mod_tsx_layer.htable = pj_hash_create( pool, pjsip_cfg()->tsx.max_count );
+#endif
     if (!mod_tsx_layer.htable) {
 	pjsip_endpt_release_pool(endpt, pool);
 	return PJ_ENOMEM;
     }
 
+    /* Create slab for the transaction objects. */
+    status = pj_slab_create(pool->factory, "tsxslab%p",
+			    sizeof(pjsip_transaction), 0, &mod_tsx_layer.slab);
+    if (status != PJ_SUCCESS) {
+	pjsip_endpt_release_pool(endpt, pool);
+	return status;
+    }
+
     /* Create group lock. */
     status = pj_mutex_create_recursive(pool, "tsxlayer", &mod_tsx_layer.mutex);
     if (status != PJ_SUCCESS) {
+	pj_slab_destroy(mod_tsx_layer.slab);
 	pjsip_endpt_release_pool(endpt, pool);
 	return status;
     }
@@ -490,6 +507,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
     status = pjsip_endpt_register_module( endpt, &mod_tsx_layer.mod );
     if (status != PJ_SUCCESS) {
 	pj_mutex_destroy(mod_tsx_layer.mutex);
+	pj_slab_destroy(mod_tsx_layer.slab);
 	pjsip_endpt_release_pool(endpt, pool);
 	return status;
     }
@@ -639,10 +657,19 @@ PJ_DEF(unsigned) pjsip_tsx_layer_get_tsx_count(void)
 }
 
 
+/* How find_tsx() locks the transaction it has found */
+enum find_tsx_lock
+{
+    FIND_TSX_NO_LOCK,
+    FIND_TSX_LOCK,
+    FIND_TSX_LOCK_SHARED
+};
+
 /*
  * Find a transaction.
  */
-static pjsip_transaction* find_tsx( const pj_str_t *key, pj_bool_t lock,
+static pjsip_transaction* find_tsx( const pj_str_t *key,
+				    enum find_tsx_lock lock,
 				    pj_bool_t add_ref )
 {
     pjsip_transaction *tsx;
@@ -668,8 +695,10 @@ static pjsip_transaction* find_tsx( const pj_str_t *key, pj_bool_t lock,
     PJ_RACE_ME(5);
 
     if (tsx) {
-	if (lock)
+	if (lock == FIND_TSX_LOCK)
 	    pj_grp_lock_acquire(tsx->grp_lock);
+	else if (lock == FIND_TSX_LOCK_SHARED)
+	    pj_grp_lock_acquire_shared(tsx->grp_lock);
 
         if (!add_ref)
             pj_grp_lock_dec_ref(tsx->grp_lock);
@@ -682,14 +711,44 @@ static pjsip_transaction* find_tsx( const pj_str_t *key, pj_bool_t lock,
 PJ_DEF(pjsip_transaction*) pjsip_tsx_layer_find_tsx( const pj_str_t *key,
 						     pj_bool_t lock )
 {
-    return find_tsx(key, lock, PJ_FALSE);
+    return find_tsx(key, (lock ? FIND_TSX_LOCK : FIND_TSX_NO_LOCK),
+		    PJ_FALSE);
 }
 
 
 PJ_DEF(pjsip_transaction*) pjsip_tsx_layer_find_tsx2( const pj_str_t *key,
 						      pj_bool_t add_ref )
 {
-    return find_tsx(key, PJ_FALSE, add_ref);
+    return find_tsx(key, FIND_TSX_NO_LOCK, add_ref);
+}
+
+
+PJ_DEF(pjsip_transaction*) pjsip_tsx_layer_find_tsx_shared(
+							const pj_str_t *key)
+{
+    return find_tsx(key, FIND_TSX_LOCK_SHARED, PJ_FALSE);
+}
+
+
+PJ_DEF(pj_status_t) pjsip_tsx_layer_get_tsx_state( const pj_str_t *key,
+						   pjsip_tsx_state_e *state,
+						   int *status_code )
+{
+    pjsip_transaction *tsx;
+
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+    tsx = find_tsx(key, FIND_TSX_LOCK_SHARED, PJ_FALSE);
+    if (!tsx)
+	return PJ_ENOTFOUND;
+
+    if (state)
+	*state = tsx->state;
+    if (status_code)
+	*status_code = tsx->status_code;
+
+    pj_grp_lock_release_shared(tsx->grp_lock);
+    return PJ_SUCCESS;
 }
 
 
@@ -753,6 +812,11 @@ static void tsx_layer_destroy(pjsip_endpoint *endpt)
     /* Destroy mutex. */
     pj_mutex_destroy(mod_tsx_layer.mutex);
 
+    /* Destroy slab. Transactions which are still referenced keep it
+     * until they are destroyed.
+     */
+    pj_slab_destroy(mod_tsx_layer.slab);
+
     /* Release pool. */
     pjsip_endpt_release_pool(mod_tsx_layer.endpt, mod_tsx_layer.pool);
 
@@ -915,6 +979,7 @@ PJ_DEF(void) pjsip_tsx_layer_dump(pj_bool_t detail)
 {
 #if PJ_LOG_MAX_LEVEL >= 3
     pj_hash_iterator_t itbuf, *it;
+    pj_slab_stat slab_stat;
 
     /* Lock mutex. */
     pj_mutex_lock(mod_tsx_layer.mutex);
@@ -923,6 +988,13 @@ PJ_DEF(void) pjsip_tsx_layer_dump(pj_bool_t detail)
     PJ_LOG(3, (THIS_FILE, " Total %d transactions", 
 			  pj_hash_count(mod_tsx_layer.htable)));
 
+    pj_slab_get_stat(mod_tsx_layer.slab, &slab_stat);
+    PJ_LOG(3, (THIS_FILE, " Slab: %u objects of %u bytes in use (peak %u), "
+			  "capacity %u, %u bytes",
+			  slab_stat.in_use, (unsigned)slab_stat.obj_size,
+			  slab_stat.peak, slab_stat.capacity,
+			  (unsigned)slab_stat.mem_used));
+
     if (detail) {
 	it = pj_hash_first(mod_tsx_layer.htable, &itbuf);
 	if (it == NULL) {
@@ -1004,13 +1076,19 @@ static pj_status_t tsx_create( pjsip_module *tsx_user,
     pjsip_transaction *tsx;
     pj_status_t status;
 
+    tsx = (pjsip_transaction*) pj_slab_zalloc(mod_tsx_layer.slab);
+    if (!tsx)
+	return PJ_ENOMEM;
+
     pool = pjsip_endpt_create_pool( mod_tsx_layer.endpt, "tsx", 
 				    PJSIP_POOL_TSX_LEN, PJSIP_POOL_TSX_INC );
-    if (!pool)
+    if (!pool) {
+	pj_slab_free(mod_tsx_layer.slab, tsx);
 	return PJ_ENOMEM;
+    }
 
-    tsx = PJ_POOL_ZALLOC_T(pool, pjsip_transaction);
     tsx->pool = pool;
+    tsx->slab = mod_tsx_layer.slab;
     tsx->tsx_user = tsx_user;
     tsx->endpt = mod_tsx_layer.endpt;
 
@@ -1032,10 +1110,17 @@ static pj_status_t tsx_create( pjsip_module *tsx_user,
         pj_grp_lock_add_ref(tsx->grp_lock);
         pj_grp_lock_add_handler(tsx->grp_lock, tsx->pool, tsx, &tsx_on_destroy);
     } else {
-	status = pj_grp_lock_create_w_handler(pool, NULL, tsx, &tsx_on_destroy,
+	pj_grp_lock_config cfg;
+
+	pj_grp_lock_config_default(&cfg);
+#if PJSIP_TSX_SHARED_LOCK
+	cfg.flags = PJ_GRP_LOCK_SHARED;
+#endif
+	status = pj_grp_lock_create_w_handler(pool, &cfg, tsx, &tsx_on_destroy,
 					      &tsx->grp_lock);
 	if (status != PJ_SUCCESS) {
 	    pjsip_endpt_release_pool(mod_tsx_layer.endpt, pool);
+	    pj_slab_free(tsx->slab, tsx);
 	    return status;
 	}
 	
@@ -1061,6 +1146,7 @@ static void tsx_on_destroy( void *arg )
 
     pj_mutex_destroy(tsx->mutex_b);
     pjsip_endpt_release_pool(tsx->endpt, tsx->pool);
+    pj_slab_free(tsx->slab, tsx);
 }
 
 /* Shutdown transaction. */
@@ -1334,6 +1420,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uac2(pjsip_module *tsx_user,
     pjsip_cseq_hdr *cseq;
     pjsip_via_hdr *via;
     pjsip_host_info dst_info;
+    pj_timestamp ts;
     pj_status_t status;
 
     /* Validate arguments. */
@@ -1345,6 +1432,8 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uac2(pjsip_module *tsx_user,
     PJ_ASSERT_RETURN(tdata->msg->line.req.method.id != PJSIP_ACK_METHOD,
 		     PJ_EINVALIDOP);
 
+    PJSIP_LAT_BEGIN(&ts);
+
     /* Keep shortcut */
     msg = tdata->msg;
 
@@ -1395,7 +1484,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uac2(pjsip_module *tsx_user,
 		  PJSIP_RFC3261_BRANCH_LEN);
 	tmp.ptr = via->branch_param.ptr + PJSIP_RFC3261_BRANCH_LEN + 2;
 	*(tmp.ptr-2) = 80; *(tmp.ptr-1) = 106;
-	pj_generate_unique_string( &tmp );
+	pj_generate_unique_string_fast( &tmp );
 
         /* Save branch parameter. */
         tsx->branch = via->branch_param;
@@ -1462,6 +1551,8 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uac2(pjsip_module *tsx_user,
 	      pjsip_tx_data_get_info(tdata)));
     pj_log_pop_indent();
 
+    PJSIP_LAT_END(&ts, PJSIP_LAT_TSX_CREATE, PJSIP_ROLE_UAC);
+
     *p_tsx = tsx;
     return PJ_SUCCESS;
 }
@@ -1486,6 +1577,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uas2(pjsip_module *tsx_user,
     pjsip_msg *msg;
     pj_str_t *branch;
     pjsip_cseq_hdr *cseq;
+    pj_timestamp ts;
     pj_status_t status;
 
     /* Validate arguments. */
@@ -1501,6 +1593,8 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uas2(pjsip_module *tsx_user,
     PJ_ASSERT_RETURN(msg->line.req.method.id != PJSIP_ACK_METHOD,
 		     PJ_EINVALIDOP);
 
+    PJSIP_LAT_BEGIN(&ts);
+
     /* Make sure CSeq header is present. */
     cseq = rdata->msg_info.cseq;
     if (!cseq)
@@ -1612,6 +1706,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uas2(pjsip_module *tsx_user,
 	      pjsip_rx_data_get_info(rdata)));
     pj_log_pop_indent();
 
+    PJSIP_LAT_END(&ts, PJSIP_LAT_TSX_CREATE, PJSIP_ROLE_UAS);
 
     *p_tsx = tsx;
     return PJ_SUCCESS;
@@ -24,6 +24,7 @@
 #include <pjsip/sip_private.h>
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_module.h>
+#include <pjsip/sip_latency.h>
 #include <pj/addr_resolv.h>
 #include <pj/except.h>
 #include <pj/os.h>
@@ -56,6 +57,7 @@ static const char *addr_string(const pj_sockaddr_t *addr)
 
 /* Prototype. */
 static pj_status_t mod_on_tx_msg(pjsip_tx_data *tdata);
+static void ka_wheel_on_timer(pj_timer_heap_t *th, pj_timer_entry *te);
 
 /* This module has sole purpose to print transmit data to contigous buffer
  * before actually transmitted to the wire. 
@@ -84,11 +86,33 @@ typedef struct transport
     pjsip_transport *tp;
 } transport;
 
+/* Keep-alive scheduler entry states */
+enum ka_state
+{
+    KA_IDLE,		/* Not scheduled.				    */
+    KA_SCHEDULED,	/* In the wheel.				    */
+    KA_RUNNING,		/* Callback is being called.			    */
+    KA_RESCHED,		/* Rescheduled while the callback is running.	    */
+    KA_CANCELLED	/* Cancelled while the callback is running.	    */
+};
+
+/* Keep-alive scheduler: timing wheel of one second slots. */
+typedef struct ka_wheel
+{
+    pj_lock_t	       *lock;
+    pj_timer_entry	timer;
+    pj_bool_t		timer_active;
+    long		last_tick;
+    unsigned		count;
+    pjsip_tp_ka_entry	slot[PJSIP_TP_KA_WHEEL_SIZE];
+} ka_wheel;
+
 /*
  * Transport manager.
  */
 struct pjsip_tpmgr 
 {
+    pj_pool_t	    *table_pool;    /* For the hash table to grow */
     pj_hash_table_t *table;
     pj_lock_t	    *lock;
     pjsip_endpoint  *endpt;
@@ -111,6 +135,9 @@ struct pjsip_tpmgr
      * is destroyed.
      */
     transport        tp_list;
+
+    /* Keep-alive scheduler for connection oriented transports. */
+    ka_wheel	     ka;
 };
 
 
@@ -152,7 +179,7 @@ static struct transport_names_t
     const char		  *description;	    /* Longer description   */
     unsigned		   flag;	    /* Flags		    */
     char		   name_buf[16];    /* For user's transport */
-} transport_names[16] = 
+} transport_names[20] = 
 {
     { 
 	PJSIP_TRANSPORT_UNSPECIFIED, 
@@ -203,6 +230,21 @@ static struct transport_names_t
 	"Loopback datagram transport", 
 	PJSIP_TRANSPORT_DATAGRAM
     },
+    {
+	PJSIP_TRANSPORT_WS,
+	80,
+	{"WS", 2},
+	"WebSocket transport",
+	PJSIP_TRANSPORT_RELIABLE | PJSIP_TRANSPORT_MSG_FRAMED
+    },
+    {
+	PJSIP_TRANSPORT_WSS,
+	443,
+	{"WSS", 3},
+	"Secure WebSocket transport",
+	PJSIP_TRANSPORT_RELIABLE | PJSIP_TRANSPORT_SECURE |
+	    PJSIP_TRANSPORT_MSG_FRAMED
+    },
     { 
 	PJSIP_TRANSPORT_UDP6, 
 	5060, 
@@ -224,6 +266,21 @@ static struct transport_names_t
 	"TLS IPv6 transport",
 	PJSIP_TRANSPORT_RELIABLE | PJSIP_TRANSPORT_SECURE
     },
+    {
+	PJSIP_TRANSPORT_WS6,
+	80,
+	{"WS", 2},
+	"WebSocket IPv6 transport",
+	PJSIP_TRANSPORT_RELIABLE | PJSIP_TRANSPORT_MSG_FRAMED
+    },
+    {
+	PJSIP_TRANSPORT_WSS6,
+	443,
+	{"WSS", 3},
+	"Secure WebSocket IPv6 transport",
+	PJSIP_TRANSPORT_RELIABLE | PJSIP_TRANSPORT_SECURE |
+	    PJSIP_TRANSPORT_MSG_FRAMED
+    },
 };
 
 static void tp_state_callback(pjsip_transport *tp,
@@ -797,6 +854,7 @@ PJ_DEF(pj_status_t) pjsip_transport_send(  pjsip_transport *tr,
 					   void *token,
 					   pjsip_tp_send_callback cb)
 {
+    pj_timestamp tx_ts;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(tr && tdata && addr, PJ_EINVAL);
@@ -829,6 +887,7 @@ PJ_DEF(pj_status_t) pjsip_transport_send(  pjsip_transport *tr,
      * When the message reach mod_msg_print, the contents of the message will
      * be "printed" to contiguous buffer.
      */
+    PJSIP_LAT_BEGIN(&tx_ts);
     if (tr->tpmgr->on_tx_msg) {
 	status = (*tr->tpmgr->on_tx_msg)(tr->endpt, tdata);
 	if (status != PJ_SUCCESS) {
@@ -850,6 +909,7 @@ PJ_DEF(pj_status_t) pjsip_transport_send(  pjsip_transport *tr,
     /* Send to transport. */
     status = (*tr->send_msg)(tr, tdata,  addr, addr_len, (void*)tdata, 
 			     &transport_send_callback);
+    PJSIP_LAT_END(&tx_ts, PJSIP_LAT_TX, tr->key.type);
 
     if (status != PJ_EPENDING) {
 	tdata->is_pending = 0;
@@ -1371,6 +1431,7 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
 					pjsip_tpmgr **p_mgr)
 {
     pjsip_tpmgr *mgr;
+    unsigned i;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(pool && endpt && rx_cb && p_mgr, PJ_EINVAL);
@@ -1389,7 +1450,18 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
     pj_list_init(&mgr->tdata_list);
     pj_list_init(&mgr->tp_list);
 
+#if PJSIP_HTABLE_RESIZABLE
+    /* The table may be resized when transports are added, which is done
+     * with the transport manager lock held, so it needs its own pool.
+     */
+    mgr->table_pool = pjsip_endpt_create_pool(endpt, "tpmgr%p", 512, 512);
+    if (!mgr->table_pool)
+	return PJ_ENOMEM;
+    mgr->table = pj_hash_create_resizable(mgr->table_pool,
+					  PJSIP_TPMGR_HTABLE_SIZE);
+#else
     mgr->table = pj_hash_create(pool, PJSIP_TPMGR_HTABLE_SIZE);
+#endif
     if (!mgr->table)
 	return PJ_ENOMEM;
 
@@ -1397,9 +1469,19 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
     if (status != PJ_SUCCESS)
 	return status;
 
+    status = pj_lock_create_simple_mutex(pool, "tmka%p", &mgr->ka.lock);
+    if (status != PJ_SUCCESS) {
+	pj_lock_destroy(mgr->lock);
+	return status;
+    }
+    for (i=0; i<PJ_ARRAY_SIZE(mgr->ka.slot); ++i)
+	pj_list_init(&mgr->ka.slot[i]);
+    pj_timer_entry_init(&mgr->ka.timer, 0, mgr, &ka_wheel_on_timer);
+
 #if defined(PJ_DEBUG) && PJ_DEBUG!=0
     status = pj_atomic_create(pool, 0, &mgr->tdata_counter);
     if (status != PJ_SUCCESS) {
+	pj_lock_destroy(mgr->ka.lock);
     	pj_lock_destroy(mgr->lock);
     	return status;
     }
@@ -1698,6 +1780,16 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_destroy( pjsip_tpmgr *mgr )
 
     pj_lock_release(mgr->lock);
 
+    /* Stop the keep-alive scheduler. All connection oriented transports
+     * have removed their entries by now.
+     */
+    pj_lock_acquire(mgr->ka.lock);
+    if (mgr->ka.timer_active) {
+	pjsip_endpt_cancel_timer(mgr->endpt, &mgr->ka.timer);
+	mgr->ka.timer_active = PJ_FALSE;
+    }
+    pj_lock_release(mgr->ka.lock);
+
 #if defined(PJ_DEBUG) && PJ_DEBUG!=0
     /* If you encounter assert error on this line, it means there are
      * leakings in transmit data (i.e. some transmit data have not been
@@ -1728,6 +1820,12 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_destroy( pjsip_tpmgr *mgr )
 #endif
 
     pj_lock_destroy(mgr->lock);
+    pj_lock_destroy(mgr->ka.lock);
+
+    if (mgr->table_pool) {
+	pjsip_endpt_release_pool(endpt, mgr->table_pool);
+	mgr->table_pool = NULL;
+    }
 
     /* Unregister mod_msg_print. */
     if (mod_msg_print.id != -1) {
@@ -1775,6 +1873,7 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
 	char *p, *end;
 	char saved;
 	pj_size_t msg_fragment_size;
+	pj_timestamp parse_ts;
 
 	/* Skip leading newlines as pjsip_find_msg() currently can't
 	 * handle leading newlines.
@@ -1816,8 +1915,13 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
 	rdata->msg_info.msg_buf = current_pkt;
 	rdata->msg_info.len = (int)remaining_len;
 
-	/* For TCP transport, check if the whole message has been received. */
-	if ((tr->flag & PJSIP_TRANSPORT_DATAGRAM) == 0) {
+	/* For TCP transport, check if the whole message has been received.
+	 * Message framed transports (e.g. WebSocket) always hand over one
+	 * complete message, which may legitimately lack Content-Length.
+	 */
+	if ((tr->flag & (PJSIP_TRANSPORT_DATAGRAM |
+			 PJSIP_TRANSPORT_MSG_FRAMED)) == 0)
+	{
 	    pj_status_t msg_status;
 	    msg_status = pjsip_find_msg(current_pkt, remaining_len, PJ_FALSE, 
                                         &msg_fragment_size);
@@ -1853,8 +1957,10 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
 	current_pkt[msg_fragment_size] = '\0';
 
 	/* Parse the message. */
+	PJSIP_LAT_BEGIN(&parse_ts);
 	rdata->msg_info.msg = msg = 
 	    pjsip_parse_rdata( current_pkt, msg_fragment_size, rdata);
+	PJSIP_LAT_END(&parse_ts, PJSIP_LAT_PARSE, tr->key.type);
 
 	/* Restore null termination */
 	current_pkt[msg_fragment_size] = saved;
@@ -2449,3 +2555,209 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_set_drop_data_cb(pjsip_tpmgr *mgr,
 
     return PJ_SUCCESS;
 }
+
+
+/*****************************************************************************
+ *
+ * Keep-alive scheduler.
+ *
+ * Connection oriented transports used to run one timer per connection for
+ * keep-alive, which means a very large timer heap on servers with many
+ * connections. Instead, the entries are kept in a timing wheel of one
+ * second slots, which is driven by a single timer that only runs while
+ * there are entries scheduled. Each tick collects the due entries of the
+ * elapsed slots in one pass and calls them in a batch.
+ *
+ *****************************************************************************/
+
+/* Current time of the scheduler, in seconds. The cached clock is accurate
+ * enough for the one second resolution of the wheel.
+ */
+static long ka_now(void)
+{
+    pj_time_val now;
+
+    pj_gettickcount_cached(&now);
+    return now.sec;
+}
+
+/* Start the scheduler timer, ka lock must be held. */
+static void ka_wheel_start_timer(pjsip_tpmgr *mgr)
+{
+    pj_time_val delay = {1, 0};
+
+    if (mgr->ka.timer_active || mgr->ka.count == 0)
+	return;
+
+    if (pjsip_endpt_schedule_timer(mgr->endpt, &mgr->ka.timer,
+				   &delay) == PJ_SUCCESS)
+    {
+	mgr->ka.timer_active = PJ_TRUE;
+    }
+}
+
+/* Insert entry to the wheel, ka lock must be held. */
+static void ka_wheel_insert(pjsip_tpmgr *mgr, pjsip_tp_ka_entry *e)
+{
+    if (mgr->ka.count == 0 && !mgr->ka.timer_active)
+	mgr->ka.last_tick = ka_now();
+
+    pj_list_push_back(&mgr->ka.slot[e->due % PJSIP_TP_KA_WHEEL_SIZE], e);
+    e->state = KA_SCHEDULED;
+    ++mgr->ka.count;
+
+    ka_wheel_start_timer(mgr);
+}
+
+/* Scheduler tick. */
+static void ka_wheel_on_timer(pj_timer_heap_t *th, pj_timer_entry *te)
+{
+    pjsip_tpmgr *mgr = (pjsip_tpmgr*) te->user_data;
+    pjsip_tp_ka_entry batch;
+    long now, tick, last;
+
+    PJ_UNUSED_ARG(th);
+
+    pj_list_init(&batch);
+    now = ka_now();
+
+    /* Collect the due entries of the elapsed slots */
+    pj_lock_acquire(mgr->ka.lock);
+    mgr->ka.timer_active = PJ_FALSE;
+
+    last = now;
+    if (now - mgr->ka.last_tick < PJSIP_TP_KA_WHEEL_SIZE)
+	tick = mgr->ka.last_tick + 1;
+    else
+	tick = now - PJSIP_TP_KA_WHEEL_SIZE + 1;
+
+    for (; tick <= last; ++tick) {
+	pjsip_tp_ka_entry *slot, *e;
+
+	slot = &mgr->ka.slot[tick % PJSIP_TP_KA_WHEEL_SIZE];
+	e = slot->next;
+	while (e != slot) {
+	    pjsip_tp_ka_entry *next = e->next;
+
+	    if (e->due <= now) {
+		pj_list_erase(e);
+		--mgr->ka.count;
+		e->state = KA_RUNNING;
+		pj_grp_lock_add_ref(e->grp_lock);
+		pj_list_push_back(&batch, e);
+	    }
+	    e = next;
+	}
+    }
+    mgr->ka.last_tick = now;
+    pj_lock_release(mgr->ka.lock);
+
+    /* Call the entries without holding the scheduler lock */
+    while (!pj_list_empty(&batch)) {
+	pjsip_tp_ka_entry *e = batch.next;
+	pj_grp_lock_t *grp_lock = e->grp_lock;
+	long delay;
+
+	pj_list_erase(e);
+
+	delay = (*e->cb)(e);
+
+	pj_lock_acquire(mgr->ka.lock);
+	if (e->state == KA_RUNNING && delay > 0) {
+	    e->due = now + delay;
+	    ka_wheel_insert(mgr, e);
+	} else if (e->state == KA_RESCHED) {
+	    ka_wheel_insert(mgr, e);
+	} else {
+	    e->state = KA_IDLE;
+	}
+	pj_lock_release(mgr->ka.lock);
+
+	pj_grp_lock_dec_ref(grp_lock);
+    }
+
+    pj_lock_acquire(mgr->ka.lock);
+    ka_wheel_start_timer(mgr);
+    pj_lock_release(mgr->ka.lock);
+}
+
+
+/*
+ * Initialize keep-alive scheduler entry.
+ */
+PJ_DEF(void) pjsip_tp_ka_entry_init(pjsip_tp_ka_entry *entry,
+				    pj_grp_lock_t *grp_lock,
+				    pjsip_tp_ka_cb cb,
+				    void *user_data)
+{
+    pj_bzero(entry, sizeof(*entry));
+    pj_list_init(entry);
+    entry->grp_lock = grp_lock;
+    entry->cb = cb;
+    entry->user_data = user_data;
+    entry->state = KA_IDLE;
+}
+
+
+/*
+ * Schedule keep-alive entry.
+ */
+PJ_DEF(pj_status_t) pjsip_tpmgr_ka_schedule(pjsip_tpmgr *mgr,
+					    pjsip_tp_ka_entry *entry,
+					    long delay)
+{
+    PJ_ASSERT_RETURN(mgr && entry && entry->cb && delay > 0, PJ_EINVAL);
+    PJ_ASSERT_RETURN(entry->grp_lock, PJ_EINVALIDOP);
+
+    pj_lock_acquire(mgr->ka.lock);
+
+    switch (entry->state) {
+    case KA_SCHEDULED:
+	pj_list_erase(entry);
+	--mgr->ka.count;
+	/* Fallthrough */
+    case KA_IDLE:
+	entry->due = ka_now() + delay;
+	ka_wheel_insert(mgr, entry);
+	break;
+    default:
+	/* Callback is running, it will be inserted after it returns */
+	entry->due = ka_now() + delay;
+	entry->state = KA_RESCHED;
+	break;
+    }
+
+    pj_lock_release(mgr->ka.lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * Cancel keep-alive entry.
+ */
+PJ_DEF(pj_status_t) pjsip_tpmgr_ka_cancel(pjsip_tpmgr *mgr,
+					  pjsip_tp_ka_entry *entry)
+{
+    PJ_ASSERT_RETURN(mgr && entry, PJ_EINVAL);
+
+    pj_lock_acquire(mgr->ka.lock);
+
+    switch (entry->state) {
+    case KA_SCHEDULED:
+	pj_list_erase(entry);
+	--mgr->ka.count;
+	entry->state = KA_IDLE;
+	break;
+    case KA_RUNNING:
+    case KA_RESCHED:
+	entry->state = KA_CANCELLED;
+	break;
+    default:
+	break;
+    }
+
+    pj_lock_release(mgr->ka.lock);
+
+    return PJ_SUCCESS;
+}
@@ -42,6 +42,9 @@
 #define POOL_TP_INIT	512
 #define POOL_TP_INC	512
 
+/* The rdata is kept in the read buffer, in front of the received packet */
+#define RDATA_PKT_OFFSET ((pj_size_t)((pjsip_rx_data*)0)->pkt_info.packet)
+
 struct tcp_listener;
 struct tcp_transport;
 
@@ -64,6 +67,9 @@ struct tcp_listener
     pj_bool_t		     reuse_addr;        
     unsigned		     async_cnt;    
 
+    /* Read buffers shared by the connections, see PJSIP_TCP_TLS_READ_SLAB */
+    pj_activesock_slab	    *read_slab;
+
     /* Group lock to be used by TCP listener and ioqueue key */
     pj_grp_lock_t	    *grp_lock;
 };
@@ -106,17 +112,21 @@ struct tcp_transport
     pj_activesock_t	    *asock;
     pj_bool_t		     has_pending_connect;
 
-    /* Keep-alive timer. */
-    pj_timer_entry	     ka_timer;
+    /* Keep-alive and idle timeout, in transport manager's scheduler. */
+    pjsip_tp_ka_entry	     ka_entry;
     pj_time_val		     last_activity;
+    pj_time_val		     last_rx;
     pjsip_tx_data_op_key     ka_op_key;
     pj_str_t		     ka_pkt;
 
     /* TCP transport can only have  one rdata!
      * Otherwise chunks of incoming PDU may be received on different
-     * buffer.
+     * buffer. The rdata is kept in the read buffer, which is borrowed
+     * from the listener's read slab while there is data to process.
+     * The rdata pool is created on demand.
      */
-    pjsip_rx_data	     rdata;
+    pj_activesock_slab	    *read_slab;
+    pj_pool_t		    *rdata_pool;
 
     /* Pending transmission list. */
     struct delayed_tdata     delayed_list;
@@ -411,6 +421,16 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
     pj_grp_lock_add_handler(listener->grp_lock, pool, listener,
 			    &lis_on_destroy);
 
+    /* Create read buffer slab, each buffer holds an rdata */
+    if (pjsip_cfg()->tcp.read_slab) {
+	status = pj_activesock_slab_create2(pool->factory,
+					    sizeof(pjsip_rx_data),
+					    RDATA_PKT_OFFSET,
+					    &listener->read_slab);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
     /* Register to transport manager */
     listener->endpt = endpt;
     listener->tpmgr = pjsip_endpt_get_tpmgr(endpt);
@@ -501,6 +521,12 @@ static void lis_on_destroy(void *arg)
 {
     struct tcp_listener *listener = (struct tcp_listener *)arg;
 
+    /* Transports which still use the slab keep it alive */
+    if (listener->read_slab) {
+	pj_activesock_slab_destroy(listener->read_slab);
+	listener->read_slab = NULL;
+    }
+
     if (listener->factory.lock) {
 	pj_lock_destroy(listener->factory.lock);
 	listener->factory.lock = NULL;
@@ -588,8 +614,11 @@ static pj_bool_t on_data_sent(pj_activesock_t *asock,
 static pj_bool_t on_connect_complete(pj_activesock_t *asock,
 				     pj_status_t status);
 
-/* TCP keep-alive timer callback */
-static void tcp_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e);
+/* TCP keep-alive scheduler callback */
+static long tcp_keep_alive_cb(pjsip_tp_ka_entry *e);
+
+/* Start keep-alive and idle timeout of the connection */
+static void tcp_start_keep_alive(struct tcp_transport *tcp);
 
 /* Clean up TCP resources */
 static void tcp_on_destroy(void *arg);
@@ -684,6 +713,7 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
     pj_activesock_cfg_default(&asock_cfg);
     asock_cfg.async_cnt = 1;
     asock_cfg.grp_lock = tcp->grp_lock;
+    asock_cfg.read_slab = listener->read_slab;
 
     pj_bzero(&tcp_callback, sizeof(tcp_callback));
     tcp_callback.on_data_read = &on_data_read;
@@ -696,6 +726,7 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
     if (status != PJ_SUCCESS) {
 	goto on_error;
     }
+    tcp->read_slab = listener->read_slab;
 
     /* Register transport to transport manager */
     status = pjsip_transport_register(listener->tpmgr, &tcp->base);
@@ -705,9 +736,9 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
 
     tcp->is_registered = PJ_TRUE;
 
-    /* Initialize keep-alive timer */
-    tcp->ka_timer.user_data = (void*)tcp;
-    tcp->ka_timer.cb = &tcp_keep_alive_timer;
+    /* Initialize keep-alive entry */
+    pjsip_tp_ka_entry_init(&tcp->ka_entry, tcp->grp_lock,
+			   &tcp_keep_alive_cb, tcp);
     pj_ioqueue_op_key_init(&tcp->ka_op_key.key, sizeof(pj_ioqueue_op_key_t));
     pj_strdup(tcp->base.pool, &tcp->ka_pkt, &ka_pkt);
 
@@ -803,10 +834,7 @@ static pj_status_t tcp_destroy(pjsip_transport *transport,
     tcp->is_closing = PJ_TRUE;
 
     /* Stop keep-alive timer. */
-    if (tcp->ka_timer.id) {
-	pjsip_endpt_cancel_timer(tcp->base.endpt, &tcp->ka_timer);
-	tcp->ka_timer.id = PJ_FALSE;
-    }
+    pjsip_tpmgr_ka_cancel(tcp->base.tpmgr, &tcp->ka_entry);
 
     /* Cancel all delayed transmits */
     while (!pj_list_empty(&tcp->delayed_list)) {
@@ -857,9 +885,9 @@ static void tcp_on_destroy(void *arg)
 	tcp->base.ref_cnt = NULL;
     }
 
-    if (tcp->rdata.tp_info.pool) {
-	pj_pool_release(tcp->rdata.tp_info.pool);
-	tcp->rdata.tp_info.pool = NULL;
+    if (tcp->rdata_pool) {
+	pj_pool_release(tcp->rdata_pool);
+	tcp->rdata_pool = NULL;
     }
 
     if (tcp->base.pool) {
@@ -893,41 +921,21 @@ static void tcp_on_destroy(void *arg)
  */
 static pj_status_t tcp_start_read(struct tcp_transport *tcp)
 {
-    pj_pool_t *pool;
-    pj_uint32_t size;
-    pj_sockaddr *rem_addr;
+    pjsip_rx_data *rdata;
     void *readbuf[1];
     pj_status_t status;
 
-    /* Init rdata */
-    pool = pjsip_endpt_create_pool(tcp->base.endpt,
-				   "rtd%p",
-				   PJSIP_POOL_RDATA_LEN,
-				   PJSIP_POOL_RDATA_INC);
-    if (!pool) {
-	tcp_perror(tcp->base.obj_name, "Unable to create pool", PJ_ENOMEM);
-	return PJ_ENOMEM;
+    if (tcp->read_slab) {
+	/* The buffer (and rdata) is borrowed from the slab when needed */
+	status = pj_activesock_start_read(tcp->asock, tcp->base.pool,
+					  PJSIP_MAX_PKT_LEN, 0);
+    } else {
+	rdata = PJ_POOL_ALLOC_T(tcp->base.pool, pjsip_rx_data);
+	readbuf[0] = rdata->pkt_info.packet;
+	status = pj_activesock_start_read2(tcp->asock, tcp->base.pool,
+					   sizeof(rdata->pkt_info.packet),
+					   readbuf, 0);
     }
-
-    tcp->rdata.tp_info.pool = pool;
-
-    tcp->rdata.tp_info.transport = &tcp->base;
-    tcp->rdata.tp_info.tp_data = tcp;
-    tcp->rdata.tp_info.op_key.rdata = &tcp->rdata;
-    pj_ioqueue_op_key_init(&tcp->rdata.tp_info.op_key.op_key, 
-			   sizeof(pj_ioqueue_op_key_t));
-
-    tcp->rdata.pkt_info.src_addr = tcp->base.key.rem_addr;
-    tcp->rdata.pkt_info.src_addr_len = sizeof(tcp->rdata.pkt_info.src_addr);
-    rem_addr = &tcp->base.key.rem_addr;
-    pj_sockaddr_print(rem_addr, tcp->rdata.pkt_info.src_name,
-                      sizeof(tcp->rdata.pkt_info.src_name), 0);
-    tcp->rdata.pkt_info.src_port = pj_sockaddr_get_port(rem_addr);
-
-    size = sizeof(tcp->rdata.pkt_info.packet);
-    readbuf[0] = tcp->rdata.pkt_info.packet;
-    status = pj_activesock_start_read2(tcp->asock, tcp->base.pool, size,
-				       readbuf, 0);
     if (status != PJ_SUCCESS && status != PJ_EPENDING) {
 	PJ_LOG(4, (tcp->base.obj_name, 
 		   "pj_activesock_start_read() error, status=%d", 
@@ -939,6 +947,40 @@ static pj_status_t tcp_start_read(struct tcp_transport *tcp)
 }
 
 
+/*
+ * Init the rdata in front of the received packet.
+ */
+static pj_status_t tcp_init_rdata(struct tcp_transport *tcp,
+				  pjsip_rx_data *rdata)
+{
+    pj_sockaddr *rem_addr = &tcp->base.key.rem_addr;
+
+    if (!tcp->rdata_pool) {
+	tcp->rdata_pool = pjsip_endpt_create_pool(tcp->base.endpt,
+						  "rtd%p",
+						  PJSIP_POOL_RDATA_LEN,
+						  PJSIP_POOL_RDATA_INC);
+	if (!tcp->rdata_pool)
+	    return PJ_ENOMEM;
+    }
+
+    rdata->tp_info.pool = tcp->rdata_pool;
+    rdata->tp_info.transport = &tcp->base;
+    rdata->tp_info.tp_data = tcp;
+    rdata->tp_info.op_key.rdata = rdata;
+    pj_ioqueue_op_key_init(&rdata->tp_info.op_key.op_key, 
+			   sizeof(pj_ioqueue_op_key_t));
+
+    rdata->pkt_info.src_addr = *rem_addr;
+    rdata->pkt_info.src_addr_len = sizeof(rdata->pkt_info.src_addr);
+    pj_sockaddr_print(rem_addr, rdata->pkt_info.src_name,
+                      sizeof(rdata->pkt_info.src_name), 0);
+    rdata->pkt_info.src_port = pj_sockaddr_get_port(rem_addr);
+
+    return PJ_SUCCESS;
+}
+
+
 /* This callback is called by transport manager for the TCP factory
  * to create outgoing transport to the specified destination.
  */
@@ -1140,15 +1182,7 @@ static pj_bool_t on_accept_complete(pj_activesock_t *asock,
 		return PJ_TRUE;
 	    }
 	    /* Start keep-alive timer */
-	    if (pjsip_cfg()->tcp.keep_alive_interval) {
-		pj_time_val delay = { 0 };
-		delay.sec = pjsip_cfg()->tcp.keep_alive_interval;
-		pjsip_endpt_schedule_timer(listener->endpt, 
-					   &tcp->ka_timer, 
-					   &delay);
-		tcp->ka_timer.id = PJ_TRUE;
-		pj_gettimeofday(&tcp->last_activity);
-	    }
+	    tcp_start_keep_alive(tcp);
 	    /* Notify application of transport state accepted */
 	    state_cb = pjsip_tpmgr_get_state_cb(tcp->base.tpmgr);
 	    if (state_cb) {
@@ -1327,10 +1361,7 @@ static pj_status_t tcp_shutdown(pjsip_transport *transport)
     struct tcp_transport *tcp = (struct tcp_transport*)transport;
     
     /* Stop keep-alive timer. */
-    if (tcp->ka_timer.id) {
-	pjsip_endpt_cancel_timer(tcp->base.endpt, &tcp->ka_timer);
-	tcp->ka_timer.id = PJ_FALSE;
-    }
+    pjsip_tpmgr_ka_cancel(tcp->base.tpmgr, &tcp->ka_entry);
 
     return PJ_SUCCESS;
 }
@@ -1349,10 +1380,7 @@ static pj_bool_t on_data_read(pj_activesock_t *asock,
     struct tcp_transport *tcp;
     pjsip_rx_data *rdata;
 
-    PJ_UNUSED_ARG(data);
-
     tcp = (struct tcp_transport*) pj_activesock_get_user_data(asock);
-    rdata = &tcp->rdata;
 
     /* Don't do anything if transport is closing. */
     if (tcp->is_closing) {
@@ -1368,8 +1396,15 @@ static pj_bool_t on_data_read(pj_activesock_t *asock,
 
 	/* Mark this as an activity */
 	pj_gettimeofday(&tcp->last_activity);
+	tcp->last_rx = tcp->last_activity;
 
-	pj_assert((void*)rdata->pkt_info.packet == data);
+	rdata = (pjsip_rx_data*)((char*)data - RDATA_PKT_OFFSET);
+	status = tcp_init_rdata(tcp, rdata);
+	if (status != PJ_SUCCESS) {
+	    tcp_perror(tcp->base.obj_name, "Unable to create pool", status);
+	    tcp_init_shutdown(tcp, status);
+	    return PJ_FALSE;
+	}
 
 	/* Init pkt_info part. */
 	rdata->pkt_info.len = size;
@@ -1405,8 +1440,13 @@ static pj_bool_t on_data_read(pj_activesock_t *asock,
 
     }
 
-    /* Reset pool. */
-    pj_pool_reset(rdata->tp_info.pool);
+    /* Reset pool, or release it together with the read buffer. */
+    if (tcp->read_slab && *remainder == 0) {
+	pj_pool_release(tcp->rdata_pool);
+	tcp->rdata_pool = NULL;
+    } else {
+	pj_pool_reset(tcp->rdata_pool);
+    }
 
     return PJ_TRUE;
 }
@@ -1508,43 +1548,76 @@ static pj_bool_t on_connect_complete(pj_activesock_t *asock,
     tcp_flush_pending_tx(tcp);
 
     /* Start keep-alive timer */
-    if (pjsip_cfg()->tcp.keep_alive_interval) {
-	pj_time_val delay = { 0 };
-	delay.sec = pjsip_cfg()->tcp.keep_alive_interval;
-	pjsip_endpt_schedule_timer(tcp->base.endpt, &tcp->ka_timer, 
-				   &delay);
-	tcp->ka_timer.id = PJ_TRUE;
-	pj_gettimeofday(&tcp->last_activity);
-    }
+    tcp_start_keep_alive(tcp);
 
     return PJ_TRUE;
 }
 
-/* Transport keep-alive timer callback */
-static void tcp_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e)
+/* Start keep-alive and idle timeout of the connection */
+static void tcp_start_keep_alive(struct tcp_transport *tcp)
+{
+    long ka_intv = pjsip_cfg()->tcp.keep_alive_interval;
+    long idle = pjsip_cfg()->tcp.idle_timeout;
+    long delay;
+
+    if (ka_intv <= 0 && idle <= 0)
+	return;
+
+    if (ka_intv <= 0 || (idle > 0 && idle < ka_intv))
+	delay = idle;
+    else
+	delay = ka_intv;
+
+    pj_gettimeofday(&tcp->last_activity);
+    tcp->last_rx = tcp->last_activity;
+    pjsip_tpmgr_ka_schedule(tcp->base.tpmgr, &tcp->ka_entry, delay);
+}
+
+/* Transport keep-alive scheduler callback. Returns the number of seconds
+ * until the connection needs to be checked again.
+ */
+static long tcp_keep_alive_cb(pjsip_tp_ka_entry *e)
 {
     struct tcp_transport *tcp = (struct tcp_transport*) e->user_data;
-    pj_time_val delay;
-    pj_time_val now;
+    long ka_intv = pjsip_cfg()->tcp.keep_alive_interval;
+    long idle = pjsip_cfg()->tcp.idle_timeout;
+    long next = 0;
+    pj_time_val now, elapsed;
     pj_ssize_t size;
     pj_status_t status;
 
-    PJ_UNUSED_ARG(th);
-
-    tcp->ka_timer.id = PJ_TRUE;
+    if (tcp->is_closing || tcp->base.is_shutdown || tcp->base.is_destroying)
+	return 0;
 
     pj_gettimeofday(&now);
-    PJ_TIME_VAL_SUB(now, tcp->last_activity);
 
-    if (now.sec > 0 && now.sec < pjsip_cfg()->tcp.keep_alive_interval) {
-	/* There has been activity, so don't send keep-alive */
-	delay.sec = pjsip_cfg()->tcp.keep_alive_interval - now.sec;
-	delay.msec = 0;
+    /* Close the connection if nothing has been received for too long */
+    if (idle > 0) {
+	elapsed = now;
+	PJ_TIME_VAL_SUB(elapsed, tcp->last_rx);
+
+	if (elapsed.sec >= idle) {
+	    PJ_LOG(4,(tcp->base.obj_name, "Closing idle connection to "
+		      "%.*s:%d (%ld seconds without data)",
+		      (int)tcp->base.remote_name.host.slen,
+		      tcp->base.remote_name.host.ptr,
+		      tcp->base.remote_name.port, elapsed.sec));
+	    tcp_init_shutdown(tcp, PJ_ETIMEDOUT);
+	    return 0;
+	}
+	next = idle - (elapsed.sec > 0 ? elapsed.sec : 0);
+    }
 
-	pjsip_endpt_schedule_timer(tcp->base.endpt, &tcp->ka_timer, 
-				   &delay);
-	tcp->ka_timer.id = PJ_TRUE;
-	return;
+    if (ka_intv <= 0)
+	return next;
+
+    elapsed = now;
+    PJ_TIME_VAL_SUB(elapsed, tcp->last_activity);
+
+    if (elapsed.sec >= 0 && elapsed.sec < ka_intv) {
+	/* There has been activity, so don't send keep-alive */
+	long remaining = ka_intv - elapsed.sec;
+	return (next > 0 && next < remaining) ? next : remaining;
     }
 
     PJ_LOG(5,(tcp->base.obj_name, "Sending %d byte(s) keep-alive to %.*s:%d", 
@@ -1561,16 +1634,11 @@ static void tcp_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e)
 	tcp_perror(tcp->base.obj_name, 
 		   "Error sending keep-alive packet", status);
 	tcp_init_shutdown(tcp, status);
-	return;
+	return 0;
     }
 
     /* Register next keep-alive */
-    delay.sec = pjsip_cfg()->tcp.keep_alive_interval;
-    delay.msec = 0;
-
-    pjsip_endpt_schedule_timer(tcp->base.endpt, &tcp->ka_timer, 
-			       &delay);
-    tcp->ka_timer.id = PJ_TRUE;
+    return (next > 0 && next < ka_intv) ? next : ka_intv;
 }
 
 
@@ -1583,6 +1651,19 @@ PJ_DEF(pj_sock_t) pjsip_tcp_transport_get_socket(pjsip_transport *transport)
 }
 
 
+/*
+ * Get the read buffer slab of the TCP listener.
+ */
+PJ_DEF(pj_activesock_slab*)
+pjsip_tcp_transport_get_read_slab(pjsip_tpfactory *factory)
+{
+    struct tcp_listener *listener = (struct tcp_listener *)factory;
+
+    PJ_ASSERT_RETURN(factory, NULL);
+    return listener->read_slab;
+}
+
+
 PJ_DEF(pj_status_t) pjsip_tcp_transport_lis_start(pjsip_tpfactory *factory,
 						 const pj_sockaddr *local,
 					         const pjsip_host_port *a_name)
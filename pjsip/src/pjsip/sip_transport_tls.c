@@ -41,6 +41,9 @@
 #define POOL_TP_INIT	512
 #define POOL_TP_INC	512
 
+/* The rdata is kept in the read buffer, in front of the received packet */
+#define RDATA_PKT_OFFSET ((pj_size_t)((pjsip_rx_data*)0)->pkt_info.packet)
+
 struct tls_listener;
 struct tls_transport;
 
@@ -60,6 +63,9 @@ struct tls_listener
     pjsip_tls_setting	     tls_setting;    
     unsigned		     async_cnt;    
 
+    /* Read buffers shared by the connections, see PJSIP_TCP_TLS_READ_SLAB */
+    pj_activesock_slab	    *read_slab;
+
     /* Group lock to be used by TLS transport and ioqueue key */
     pj_grp_lock_t	    *grp_lock;
 };
@@ -96,17 +102,21 @@ struct tls_transport
     pj_bool_t		     has_pending_connect;
     pj_bool_t		     verify_server;
 
-    /* Keep-alive timer. */
-    pj_timer_entry	     ka_timer;
+    /* Keep-alive and idle timeout, in transport manager's scheduler. */
+    pjsip_tp_ka_entry	     ka_entry;
     pj_time_val		     last_activity;
+    pj_time_val		     last_rx;
     pjsip_tx_data_op_key     ka_op_key;
     pj_str_t		     ka_pkt;
 
     /* TLS transport can only have  one rdata!
      * Otherwise chunks of incoming PDU may be received on different
-     * buffer.
+     * buffer. The rdata is kept in the read buffer, which is borrowed
+     * from the listener's read slab while there is data to process.
+     * The rdata pool is created on demand.
      */
-    pjsip_rx_data	     rdata;
+    pj_activesock_slab	    *read_slab;
+    pj_pool_t		    *rdata_pool;
 
     /* Pending transmission list. */
     struct delayed_tdata     delayed_list;
@@ -307,6 +317,7 @@ static void set_ssock_param(pj_ssl_sock_param *ssock_param,
 	ssock_param->send_buffer_size = PJSIP_MAX_PKT_LEN;
     if (ssock_param->read_buffer_size < PJSIP_MAX_PKT_LEN)
 	ssock_param->read_buffer_size = PJSIP_MAX_PKT_LEN;
+    ssock_param->read_slab = listener->read_slab;
     ssock_param->ciphers_num = listener->tls_setting.ciphers_num;
     ssock_param->ciphers = listener->tls_setting.ciphers;
     ssock_param->curves_num = listener->tls_setting.curves_num;
@@ -583,6 +594,16 @@ PJ_DEF(pj_status_t) pjsip_tls_transport_start2( pjsip_endpoint *endpt,
     pj_grp_lock_add_handler(listener->grp_lock, pool, listener,
 			    &lis_on_destroy);
 
+    /* Create read buffer slab, each buffer holds an rdata */
+    if (pjsip_cfg()->tls.read_slab) {
+	status = pj_activesock_slab_create2(pool->factory,
+					    sizeof(pjsip_rx_data),
+					    RDATA_PKT_OFFSET,
+					    &listener->read_slab);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
     /* Check if certificate/CA list for SSL socket is set */
     if (listener->tls_setting.cert_file.slen ||
 	listener->tls_setting.ca_list_file.slen ||
@@ -648,6 +669,12 @@ static void lis_on_destroy(void *arg)
 {
     struct tls_listener *listener = (struct tls_listener*)arg;
 
+    /* Transports which still use the slab keep it alive */
+    if (listener->read_slab) {
+	pj_activesock_slab_destroy(listener->read_slab);
+	listener->read_slab = NULL;
+    }
+
     if (listener->factory.lock) {
 	pj_lock_destroy(listener->factory.lock);
 	listener->factory.lock = NULL;
@@ -694,6 +721,19 @@ static pj_status_t lis_destroy(pjsip_tpfactory *factory)
 }
 
 
+/*
+ * Get the read buffer slab of the TLS listener.
+ */
+PJ_DEF(pj_activesock_slab*)
+pjsip_tls_transport_get_read_slab(pjsip_tpfactory *factory)
+{
+    struct tls_listener *listener = (struct tls_listener *)factory;
+
+    PJ_ASSERT_RETURN(factory, NULL);
+    return listener->read_slab;
+}
+
+
 PJ_DEF(pj_status_t) pjsip_tls_transport_restart(pjsip_tpfactory *factory,
 						const pj_sockaddr *local,
 						const pjsip_host_port *a_name)
@@ -756,8 +796,11 @@ static pj_status_t tls_destroy(pjsip_transport *transport,
 static pj_bool_t on_connect_complete(pj_ssl_sock_t *ssock,
 				     pj_status_t status);
 
-/* TLS keep-alive timer callback */
-static void tls_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e);
+/* TLS keep-alive scheduler callback */
+static long tls_keep_alive_cb(pjsip_tp_ka_entry *e);
+
+/* Start keep-alive and idle timeout of the connection */
+static void tls_start_keep_alive(struct tls_transport *tls);
 
 /*
  * Common function to create TLS transport, called when pending accept() and
@@ -792,6 +835,7 @@ static pj_status_t tls_create( struct tls_listener *listener,
      */
     tls = PJ_POOL_ZALLOC_T(pool, struct tls_transport);
     tls->is_server = is_server;
+    tls->read_slab = listener->read_slab;
     tls->verify_server = listener->tls_setting.verify_server;
     pj_list_init(&tls->delayed_list);
     tls->base.pool = pool;
@@ -862,9 +906,10 @@ static pj_status_t tls_create( struct tls_listener *listener,
 
     tls->is_registered = PJ_TRUE;
 
-    /* Initialize keep-alive timer */
-    tls->ka_timer.user_data = (void*)tls;
-    tls->ka_timer.cb = &tls_keep_alive_timer;
+    /* Initialize keep-alive entry. The group lock is set when the
+     * entry is scheduled, as it is not known yet for incoming connection.
+     */
+    pjsip_tp_ka_entry_init(&tls->ka_entry, NULL, &tls_keep_alive_cb, tls);
     pj_ioqueue_op_key_init(&tls->ka_op_key.key, sizeof(pj_ioqueue_op_key_t));
     pj_strdup(tls->base.pool, &tls->ka_pkt, &ka_pkt);
     
@@ -942,9 +987,9 @@ static void tls_on_destroy(void *arg)
 {
     struct tls_transport *tls = (struct tls_transport*)arg;
 
-    if (tls->rdata.tp_info.pool) {
-	pj_pool_release(tls->rdata.tp_info.pool);
-	tls->rdata.tp_info.pool = NULL;
+    if (tls->rdata_pool) {
+	pj_pool_release(tls->rdata_pool);
+	tls->rdata_pool = NULL;
     }
 
     if (tls->base.lock) {
@@ -1004,10 +1049,7 @@ static pj_status_t tls_destroy(pjsip_transport *transport,
     tls->is_closing = PJ_TRUE;
 
     /* Stop keep-alive timer. */
-    if (tls->ka_timer.id) {
-	pjsip_endpt_cancel_timer(tls->base.endpt, &tls->ka_timer);
-	tls->ka_timer.id = PJ_FALSE;
-    }
+    pjsip_tpmgr_ka_cancel(tls->base.tpmgr, &tls->ka_entry);
 
     /* Cancel all delayed transmits */
     while (!pj_list_empty(&tls->delayed_list)) {
@@ -1047,41 +1089,21 @@ static pj_status_t tls_destroy(pjsip_transport *transport,
  */
 static pj_status_t tls_start_read(struct tls_transport *tls)
 {
-    pj_pool_t *pool;
-    pj_uint32_t size;
-    pj_sockaddr *rem_addr;
+    pjsip_rx_data *rdata;
     void *readbuf[1];
     pj_status_t status;
 
-    /* Init rdata */
-    pool = pjsip_endpt_create_pool(tls->base.endpt,
-				   "rtd%p",
-				   PJSIP_POOL_RDATA_LEN,
-				   PJSIP_POOL_RDATA_INC);
-    if (!pool) {
-	tls_perror(tls->base.obj_name, "Unable to create pool", PJ_ENOMEM);
-	return PJ_ENOMEM;
+    if (tls->read_slab) {
+	/* The buffer (and rdata) is borrowed from the slab when needed */
+	status = pj_ssl_sock_start_read(tls->ssock, tls->base.pool,
+					PJSIP_MAX_PKT_LEN, 0);
+    } else {
+	rdata = PJ_POOL_ALLOC_T(tls->base.pool, pjsip_rx_data);
+	readbuf[0] = rdata->pkt_info.packet;
+	status = pj_ssl_sock_start_read2(tls->ssock, tls->base.pool,
+					 sizeof(rdata->pkt_info.packet),
+					 readbuf, 0);
     }
-
-    tls->rdata.tp_info.pool = pool;
-
-    tls->rdata.tp_info.transport = &tls->base;
-    tls->rdata.tp_info.tp_data = tls;
-    tls->rdata.tp_info.op_key.rdata = &tls->rdata;
-    pj_ioqueue_op_key_init(&tls->rdata.tp_info.op_key.op_key, 
-			   sizeof(pj_ioqueue_op_key_t));
-
-    tls->rdata.pkt_info.src_addr = tls->base.key.rem_addr;
-    tls->rdata.pkt_info.src_addr_len = sizeof(tls->rdata.pkt_info.src_addr);
-    rem_addr = &tls->base.key.rem_addr;
-    pj_sockaddr_print(rem_addr, tls->rdata.pkt_info.src_name,
-                          sizeof(tls->rdata.pkt_info.src_name), 0);
-    tls->rdata.pkt_info.src_port = pj_sockaddr_get_port(rem_addr);
-
-    size = sizeof(tls->rdata.pkt_info.packet);
-    readbuf[0] = tls->rdata.pkt_info.packet;
-    status = pj_ssl_sock_start_read2(tls->ssock, tls->base.pool, size,
-				     readbuf, 0);
     if (status != PJ_SUCCESS && status != PJ_EPENDING) {
 	PJ_LOG(4, (tls->base.obj_name, 
 		   "pj_ssl_sock_start_read() error, status=%d", 
@@ -1093,6 +1115,40 @@ static pj_status_t tls_start_read(struct tls_transport *tls)
 }
 
 
+/*
+ * Init the rdata in front of the received packet.
+ */
+static pj_status_t tls_init_rdata(struct tls_transport *tls,
+				  pjsip_rx_data *rdata)
+{
+    pj_sockaddr *rem_addr = &tls->base.key.rem_addr;
+
+    if (!tls->rdata_pool) {
+	tls->rdata_pool = pjsip_endpt_create_pool(tls->base.endpt,
+						  "rtd%p",
+						  PJSIP_POOL_RDATA_LEN,
+						  PJSIP_POOL_RDATA_INC);
+	if (!tls->rdata_pool)
+	    return PJ_ENOMEM;
+    }
+
+    rdata->tp_info.pool = tls->rdata_pool;
+    rdata->tp_info.transport = &tls->base;
+    rdata->tp_info.tp_data = tls;
+    rdata->tp_info.op_key.rdata = rdata;
+    pj_ioqueue_op_key_init(&rdata->tp_info.op_key.op_key, 
+			   sizeof(pj_ioqueue_op_key_t));
+
+    rdata->pkt_info.src_addr = *rem_addr;
+    rdata->pkt_info.src_addr_len = sizeof(rdata->pkt_info.src_addr);
+    pj_sockaddr_print(rem_addr, rdata->pkt_info.src_name,
+                      sizeof(rdata->pkt_info.src_name), 0);
+    rdata->pkt_info.src_port = pj_sockaddr_get_port(rem_addr);
+
+    return PJ_SUCCESS;
+}
+
+
 /* This callback is called by transport manager for the TLS factory
  * to create outgoing transport to the specified destination.
  */
@@ -1158,6 +1214,7 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
 	ssock_param.send_buffer_size = PJSIP_MAX_PKT_LEN;
     if (ssock_param.read_buffer_size < PJSIP_MAX_PKT_LEN)
 	ssock_param.read_buffer_size = PJSIP_MAX_PKT_LEN;
+    ssock_param.read_slab = listener->read_slab;
     ssock_param.ciphers_num = listener->tls_setting.ciphers_num;
     ssock_param.ciphers = listener->tls_setting.ciphers;
     ssock_param.curves_num = listener->tls_setting.curves_num;
@@ -1408,15 +1465,7 @@ static pj_bool_t on_accept_complete(pj_ssl_sock_t *ssock,
 	tls_destroy(&tls->base, status);
     } else {
 	/* Start keep-alive timer */
-	if (pjsip_cfg()->tls.keep_alive_interval) {
-	    pj_time_val delay = {0};	    
-	    delay.sec = pjsip_cfg()->tls.keep_alive_interval;
-	    pjsip_endpt_schedule_timer(listener->endpt, 
-				       &tls->ka_timer, 
-				       &delay);
-	    tls->ka_timer.id = PJ_TRUE;
-	    pj_gettimeofday(&tls->last_activity);
-	}
+	tls_start_keep_alive(tls);
     }
 
     return PJ_TRUE;
@@ -1586,10 +1635,7 @@ static pj_status_t tls_shutdown(pjsip_transport *transport)
     struct tls_transport *tls = (struct tls_transport*)transport;
     
     /* Stop keep-alive timer. */
-    if (tls->ka_timer.id) {
-	pjsip_endpt_cancel_timer(tls->base.endpt, &tls->ka_timer);
-	tls->ka_timer.id = PJ_FALSE;
-    }
+    pjsip_tpmgr_ka_cancel(tls->base.tpmgr, &tls->ka_entry);
 
     return PJ_SUCCESS;
 }
@@ -1608,10 +1654,7 @@ static pj_bool_t on_data_read(pj_ssl_sock_t *ssock,
     struct tls_transport *tls;
     pjsip_rx_data *rdata;
 
-    PJ_UNUSED_ARG(data);
-
     tls = (struct tls_transport*) pj_ssl_sock_get_user_data(ssock);
-    rdata = &tls->rdata;
 
     /* Don't do anything if transport is closing. */
     if (tls->is_closing) {
@@ -1627,8 +1670,15 @@ static pj_bool_t on_data_read(pj_ssl_sock_t *ssock,
 
 	/* Mark this as an activity */
 	pj_gettimeofday(&tls->last_activity);
+	tls->last_rx = tls->last_activity;
 
-	pj_assert((void*)rdata->pkt_info.packet == data);
+	rdata = (pjsip_rx_data*)((char*)data - RDATA_PKT_OFFSET);
+	status = tls_init_rdata(tls, rdata);
+	if (status != PJ_SUCCESS) {
+	    tls_perror(tls->base.obj_name, "Unable to create pool", status);
+	    tls_init_shutdown(tls, status);
+	    return PJ_FALSE;
+	}
 
 	/* Init pkt_info part. */
 	rdata->pkt_info.len = size;
@@ -1664,8 +1714,13 @@ static pj_bool_t on_data_read(pj_ssl_sock_t *ssock,
 
     }
 
-    /* Reset pool. */
-    pj_pool_reset(rdata->tp_info.pool);
+    /* Reset pool, or release it together with the read buffer. */
+    if (tls->read_slab && *remainder == 0) {
+	pj_pool_release(tls->rdata_pool);
+	tls->rdata_pool = NULL;
+    } else {
+	pj_pool_reset(tls->rdata_pool);
+    }
 
     return PJ_TRUE;
 }
@@ -1883,14 +1938,7 @@ static pj_bool_t on_connect_complete(pj_ssl_sock_t *ssock,
     tls_flush_pending_tx(tls);
 
     /* Start keep-alive timer */
-    if (pjsip_cfg()->tls.keep_alive_interval) {
-	pj_time_val delay = {0};	    
-	delay.sec = pjsip_cfg()->tls.keep_alive_interval;
-	pjsip_endpt_schedule_timer(tls->base.endpt, &tls->ka_timer, 
-				   &delay);
-	tls->ka_timer.id = PJ_TRUE;
-	pj_gettimeofday(&tls->last_activity);
-    }
+    tls_start_keep_alive(tls);
 
     return PJ_TRUE;
 
@@ -1901,31 +1949,74 @@ on_error:
 }
 
 
-/* Transport keep-alive timer callback */
-static void tls_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e)
+/* Start keep-alive and idle timeout of the connection */
+static void tls_start_keep_alive(struct tls_transport *tls)
+{
+    long ka_intv = pjsip_cfg()->tls.keep_alive_interval;
+    long idle = pjsip_cfg()->tls.idle_timeout;
+    long delay;
+
+    /* The scheduler needs the group lock to keep the transport alive */
+    if ((ka_intv <= 0 && idle <= 0) || tls->grp_lock == NULL)
+	return;
+
+    if (ka_intv <= 0 || (idle > 0 && idle < ka_intv))
+	delay = idle;
+    else
+	delay = ka_intv;
+
+    pj_gettimeofday(&tls->last_activity);
+    tls->last_rx = tls->last_activity;
+    tls->ka_entry.grp_lock = tls->grp_lock;
+    pjsip_tpmgr_ka_schedule(tls->base.tpmgr, &tls->ka_entry, delay);
+}
+
+
+/* Transport keep-alive scheduler callback. Returns the number of seconds
+ * until the connection needs to be checked again.
+ */
+static long tls_keep_alive_cb(pjsip_tp_ka_entry *e)
 {
     struct tls_transport *tls = (struct tls_transport*) e->user_data;
-    pj_time_val delay;
-    pj_time_val now;
+    long ka_intv = pjsip_cfg()->tls.keep_alive_interval;
+    long idle = pjsip_cfg()->tls.idle_timeout;
+    long next = 0;
+    pj_time_val now, elapsed;
     pj_ssize_t size;
     pj_status_t status;
 
-    PJ_UNUSED_ARG(th);
-
-    tls->ka_timer.id = PJ_TRUE;
+    if (tls->is_closing || tls->base.is_shutdown || tls->base.is_destroying)
+	return 0;
 
     pj_gettimeofday(&now);
-    PJ_TIME_VAL_SUB(now, tls->last_activity);
 
-    if (now.sec > 0 && now.sec < pjsip_cfg()->tls.keep_alive_interval) {
-	/* There has been activity, so don't send keep-alive */
-	delay.sec = pjsip_cfg()->tls.keep_alive_interval - now.sec;
-	delay.msec = 0;
+    /* Close the connection if nothing has been received for too long */
+    if (idle > 0) {
+	elapsed = now;
+	PJ_TIME_VAL_SUB(elapsed, tls->last_rx);
+
+	if (elapsed.sec >= idle) {
+	    PJ_LOG(4,(tls->base.obj_name, "Closing idle connection to "
+		      "%.*s:%d (%ld seconds without data)",
+		      (int)tls->base.remote_name.host.slen,
+		      tls->base.remote_name.host.ptr,
+		      tls->base.remote_name.port, elapsed.sec));
+	    tls_init_shutdown(tls, PJ_ETIMEDOUT);
+	    return 0;
+	}
+	next = idle - (elapsed.sec > 0 ? elapsed.sec : 0);
+    }
 
-	pjsip_endpt_schedule_timer(tls->base.endpt, &tls->ka_timer, 
-				   &delay);
-	tls->ka_timer.id = PJ_TRUE;
-	return;
+    if (ka_intv <= 0)
+	return next;
+
+    elapsed = now;
+    PJ_TIME_VAL_SUB(elapsed, tls->last_activity);
+
+    if (elapsed.sec >= 0 && elapsed.sec < ka_intv) {
+	/* There has been activity, so don't send keep-alive */
+	long remaining = ka_intv - elapsed.sec;
+	return (next > 0 && next < remaining) ? next : remaining;
     }
 
     PJ_LOG(5,(tls->base.obj_name, "Sending %d byte(s) keep-alive to %.*s:%d", 
@@ -1943,16 +2034,11 @@ static void tls_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e)
 		   "Error sending keep-alive packet", status);
 
 	tls_init_shutdown(tls, status);
-	return;
+	return 0;
     }
 
     /* Register next keep-alive */
-    delay.sec = pjsip_cfg()->tls.keep_alive_interval;
-    delay.msec = 0;
-
-    pjsip_endpt_schedule_timer(tls->base.endpt, &tls->ka_timer, 
-			       &delay);
-    tls->ka_timer.id = PJ_TRUE;
+    return (next > 0 && next < ka_intv) ? next : ka_intv;
 }
 
 #endif /* PJSIP_HAS_TLS_TRANSPORT */
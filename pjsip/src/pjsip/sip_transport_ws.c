@@ -0,0 +1,2089 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjsip/sip_transport_ws.h>
+#include <pjsip/sip_endpoint.h>
+#include <pjsip/sip_errno.h>
+#include <pjlib-util/base64.h>
+#include <pjlib-util/sha1.h>
+#include <pj/compat/socket.h>
+#include <pj/addr_resolv.h>
+#include <pj/activesock.h>
+#include <pj/assert.h>
+#include <pj/ctype.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+/* Only declare the API if PJSIP_HAS_WS_TRANSPORT is true */
+#if defined(PJSIP_HAS_WS_TRANSPORT) && PJSIP_HAS_WS_TRANSPORT!=0
+
+#if defined(PJSIP_HAS_TLS_TRANSPORT) && PJSIP_HAS_TLS_TRANSPORT!=0
+#   define WS_HAS_WSS	1
+#else
+#   define WS_HAS_WSS	0
+#endif
+
+
+#define THIS_FILE	"sip_transport_ws.c"
+
+#define MAX_ASYNC_CNT	16
+#define POOL_LIS_INIT	512
+#define POOL_LIS_INC	512
+#define POOL_TP_INIT	512
+#define POOL_TP_INC	512
+
+/* RFC 6455 opcodes */
+#define WS_OP_CONT	0x0
+#define WS_OP_TEXT	0x1
+#define WS_OP_BINARY	0x2
+#define WS_OP_CLOSE	0x8
+#define WS_OP_PING	0x9
+#define WS_OP_PONG	0xA
+
+/* RFC 6455 close status codes */
+#define WS_CLOSE_NORMAL		1000
+#define WS_CLOSE_PROTOCOL_ERR	1002
+#define WS_CLOSE_TOO_BIG	1009
+
+/* Maximum control frame payload, and the size of the buffer to build one */
+#define WS_MAX_CTL_PAYLOAD	125
+#define WS_CTL_BUF_LEN		(WS_MAX_CTL_PAYLOAD + 2)
+
+/* Buffer for the HTTP response of the opening handshake */
+#define WS_HS_BUF_LEN		256
+
+/* The GUID appended to Sec-WebSocket-Key (RFC 6455 section 1.3) */
+#define WS_GUID			"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+struct ws_listener;
+struct ws_transport;
+
+
+/*
+ * This is the WebSocket listener, which is a "descendant" of
+ * pjsip_tpfactory (the SIP transport factory).
+ */
+struct ws_listener
+{
+    pjsip_tpfactory	     factory;
+    pj_bool_t		     is_registered;
+    pjsip_endpoint	    *endpt;
+    pjsip_tpmgr		    *tpmgr;
+    pj_activesock_t	    *asock;
+#if WS_HAS_WSS
+    pj_ssl_sock_t	    *ssock;
+    pj_ssl_cert_t	    *cert;
+#endif
+    pj_sockaddr		     bound_addr;
+    pj_str_t		     path;
+    pj_qos_type		     qos_type;
+    pj_qos_params	     qos_params;
+    pj_sockopt_params	     sockopt_params;
+    pj_bool_t		     reuse_addr;
+    unsigned		     async_cnt;
+
+    /* Group lock to be used by WS listener and ioqueue key */
+    pj_grp_lock_t	    *grp_lock;
+};
+
+
+/*
+ * This structure describes the WebSocket transport, and it's descendant
+ * of pjsip_transport. Only incoming (server side) connections exist.
+ */
+struct ws_transport
+{
+    pjsip_transport	     base;
+
+    pj_bool_t		     is_registered;
+    pj_bool_t		     is_closing;
+    pj_status_t		     close_reason;
+    pj_sock_t		     sock;
+    pj_activesock_t	    *asock;
+#if WS_HAS_WSS
+    pj_ssl_sock_t	    *ssock;
+#endif
+
+    /* Requested resource path (copied from the listener) */
+    pj_str_t		     path;
+
+    /* Opening handshake has completed */
+    pj_bool_t		     upgraded;
+
+    /* Reassembly state: the first msg_len bytes of the read buffer hold
+     * the already unmasked payload of the message being received, and
+     * in_message is set while a fragmented message is not yet complete.
+     */
+    pj_size_t		     msg_len;
+    pj_bool_t		     in_message;
+
+    /* Handshake response */
+    pjsip_tx_data_op_key     hs_op_key;
+    char		     hs_buf[WS_HS_BUF_LEN];
+
+    /* Keep-alive (ping) and idle timeout, also used as handshake timeout,
+     * in transport manager's scheduler.
+     */
+    pjsip_tp_ka_entry	     ka_entry;
+    pj_time_val		     last_activity;
+    pj_time_val		     last_rx;
+    pjsip_tx_data_op_key     ka_op_key;
+    pj_bool_t		     ka_pending;
+    char		     ka_buf[2];
+
+    /* Pong and close frames: one is being sent in ctl_buf, and at most
+     * one more waits in ctl_next_buf until it completes.
+     */
+    pjsip_tx_data_op_key     ctl_op_key;
+    pj_bool_t		     ctl_pending;
+    char		     ctl_buf[WS_CTL_BUF_LEN];
+    char		     ctl_next_buf[WS_CTL_BUF_LEN];
+    pj_size_t		     ctl_next_len;
+
+    /* WebSocket transport can only have one rdata, since it is also the
+     * buffer in which frames are reassembled.
+     */
+    pjsip_rx_data	     rdata;
+
+    /* Group lock to be used by WS transport and ioqueue key */
+    pj_grp_lock_t	    *grp_lock;
+};
+
+
+/****************************************************************************
+ * PROTOTYPES
+ */
+
+/* This callback is called when pending accept() operation completes. */
+static pj_bool_t on_accept_complete(pj_activesock_t *asock,
+				    pj_sock_t newsock,
+				    const pj_sockaddr_t *src_addr,
+				    int src_addr_len);
+
+/* This callback is called by transport manager to destroy listener */
+static pj_status_t lis_destroy(pjsip_tpfactory *factory);
+
+/* Clean up listener resources (group lock handler) */
+static void lis_on_destroy(void *arg);
+
+/* This callback is called by transport manager to create transport */
+static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
+					pjsip_tpmgr *mgr,
+					pjsip_endpoint *endpt,
+					const pj_sockaddr *rem_addr,
+					int addr_len,
+					pjsip_transport **transport);
+
+/* Called by transport manager to send message */
+static pj_status_t ws_send_msg(pjsip_transport *transport,
+			       pjsip_tx_data *tdata,
+			       const pj_sockaddr_t *rem_addr,
+			       int addr_len,
+			       void *token,
+			       pjsip_transport_callback callback);
+
+/* Called by transport manager to shutdown */
+static pj_status_t ws_shutdown(pjsip_transport *transport);
+
+/* Called by transport manager to destroy transport */
+static pj_status_t ws_destroy_transport(pjsip_transport *transport);
+
+/* Utility to destroy transport */
+static pj_status_t ws_destroy(pjsip_transport *transport,
+			      pj_status_t reason);
+
+/* Clean up WS resources */
+static void ws_on_destroy(void *arg);
+
+/* Common handlers for incoming data and send completion */
+static pj_bool_t ws_on_data_read(struct ws_transport *ws,
+				 void *data,
+				 pj_size_t size,
+				 pj_status_t status,
+				 pj_size_t *remainder);
+static pj_bool_t ws_on_data_sent(struct ws_transport *ws,
+				 pj_ioqueue_op_key_t *op_key,
+				 pj_ssize_t bytes_sent);
+
+/* Active socket callbacks */
+static pj_bool_t asock_on_data_read(pj_activesock_t *asock,
+				    void *data,
+				    pj_size_t size,
+				    pj_status_t status,
+				    pj_size_t *remainder);
+static pj_bool_t asock_on_data_sent(pj_activesock_t *asock,
+				    pj_ioqueue_op_key_t *send_key,
+				    pj_ssize_t sent);
+
+#if WS_HAS_WSS
+/* SSL socket callbacks */
+static pj_bool_t ssock_on_accept_complete(pj_ssl_sock_t *ssock,
+					  pj_ssl_sock_t *new_ssock,
+					  const pj_sockaddr_t *src_addr,
+					  int src_addr_len);
+static pj_bool_t ssock_on_data_read(pj_ssl_sock_t *ssock,
+				    void *data,
+				    pj_size_t size,
+				    pj_status_t status,
+				    pj_size_t *remainder);
+static pj_bool_t ssock_on_data_sent(pj_ssl_sock_t *ssock,
+				    pj_ioqueue_op_key_t *send_key,
+				    pj_ssize_t sent);
+#endif
+
+/* Keep-alive and handshake timeout scheduler callback */
+static long ws_keep_alive_cb(pjsip_tp_ka_entry *e);
+
+
+static void ws_perror(const char *sender, const char *title,
+		      pj_status_t status)
+{
+    char errmsg[PJ_ERR_MSG_SIZE];
+
+    pj_strerror(status, errmsg, sizeof(errmsg));
+
+    PJ_LOG(3,(sender, "%s: %s [code=%d]", title, errmsg, status));
+}
+
+
+static void sockaddr_to_host_port( pj_pool_t *pool,
+				   pjsip_host_port *host_port,
+				   const pj_sockaddr *addr )
+{
+    host_port->host.ptr = (char*) pj_pool_alloc(pool, PJ_INET6_ADDRSTRLEN+4);
+    pj_sockaddr_print(addr, host_port->host.ptr, PJ_INET6_ADDRSTRLEN+4, 0);
+    host_port->host.slen = pj_ansi_strlen(host_port->host.ptr);
+    host_port->port = pj_sockaddr_get_port(addr);
+}
+
+
+static void ws_init_shutdown(struct ws_transport *ws, pj_status_t status)
+{
+    pjsip_tp_state_callback state_cb;
+
+    if (ws->close_reason == PJ_SUCCESS)
+	ws->close_reason = status;
+
+    if (ws->base.is_shutdown || ws->base.is_destroying)
+	return;
+
+    /* Prevent immediate transport destroy by application, as transport
+     * state notification callback may be stacked and transport instance
+     * must remain valid at any point in the callback.
+     */
+    pjsip_transport_add_ref(&ws->base);
+
+    /* Notify application of transport disconnected state */
+    state_cb = pjsip_tpmgr_get_state_cb(ws->base.tpmgr);
+    if (state_cb) {
+	pjsip_transport_state_info state_info;
+
+	pj_bzero(&state_info, sizeof(state_info));
+	state_info.status = ws->close_reason;
+	(*state_cb)(&ws->base, PJSIP_TP_STATE_DISCONNECTED, &state_info);
+    }
+
+    /* check again */
+    if (ws->base.is_shutdown || ws->base.is_destroying) {
+        pjsip_transport_dec_ref(&ws->base);
+	return;
+    }
+
+    /* We can not destroy the transport since high level objects may
+     * still keep reference to this transport. So we can only
+     * instruct transport manager to gracefully start the shutdown
+     * procedure for this transport.
+     */
+    pjsip_transport_shutdown(&ws->base);
+
+    /* Now, it is ok to destroy the transport. */
+    pjsip_transport_dec_ref(&ws->base);
+}
+
+
+/* Send raw bytes on the underlying (plain or secure) socket. */
+static pj_status_t ws_sock_send(struct ws_transport *ws,
+				pj_ioqueue_op_key_t *op_key,
+				const void *data,
+				pj_ssize_t *size)
+{
+#if WS_HAS_WSS
+    if (ws->ssock)
+	return pj_ssl_sock_send(ws->ssock, op_key, data, size, 0);
+#endif
+    return pj_activesock_send(ws->asock, op_key, data, size, 0);
+}
+
+
+/*
+ * Write a server-to-client (unmasked) frame header for the specified
+ * payload length. Returns the header length (2, 4, or 10 bytes).
+ */
+static unsigned ws_put_frame_hdr(pj_uint8_t *p, unsigned opcode,
+				 pj_size_t payload_len)
+{
+    p[0] = (pj_uint8_t)(0x80 | opcode);
+    if (payload_len < 126) {
+	p[1] = (pj_uint8_t)payload_len;
+	return 2;
+    } else if (payload_len <= 0xFFFF) {
+	p[1] = 126;
+	p[2] = (pj_uint8_t)(payload_len >> 8);
+	p[3] = (pj_uint8_t)(payload_len);
+	return 4;
+    } else {
+	pj_uint64_t len = payload_len;
+	int i;
+
+	p[1] = 127;
+	for (i=9; i>=2; --i) {
+	    p[i] = (pj_uint8_t)len;
+	    len >>= 8;
+	}
+	return 10;
+    }
+}
+
+
+/*
+ * Send a control frame (pong or close). If the previous control frame is
+ * still being sent, the new one is queued and sent when it completes. A
+ * newer pong replaces a queued pong (RFC 6455 section 5.5.3), but nothing
+ * replaces a queued close frame since it must be the last frame sent.
+ */
+static pj_status_t ws_send_ctl(struct ws_transport *ws, unsigned opcode,
+			       const void *payload, pj_size_t len)
+{
+    char frame[WS_CTL_BUF_LEN];
+    pj_ssize_t size;
+    unsigned hdr_len;
+    pj_status_t status;
+
+    if (len > WS_MAX_CTL_PAYLOAD)
+	len = WS_MAX_CTL_PAYLOAD;
+
+    hdr_len = ws_put_frame_hdr((pj_uint8_t*)frame, opcode, len);
+    if (len)
+	pj_memcpy(frame + hdr_len, payload, len);
+    size = hdr_len + len;
+
+    pj_lock_acquire(ws->base.lock);
+
+    if (ws->is_closing) {
+	pj_lock_release(ws->base.lock);
+	return PJ_EINVALIDOP;
+    }
+
+    if (ws->ctl_pending) {
+	if (ws->ctl_next_len &&
+	    (ws->ctl_next_buf[0] & 0x0F) == WS_OP_CLOSE)
+	{
+	    pj_lock_release(ws->base.lock);
+	    return PJ_EBUSY;
+	}
+	pj_memcpy(ws->ctl_next_buf, frame, size);
+	ws->ctl_next_len = size;
+	pj_lock_release(ws->base.lock);
+	return PJ_EPENDING;
+    }
+
+    pj_memcpy(ws->ctl_buf, frame, size);
+    ws->ctl_pending = PJ_TRUE;
+    status = ws_sock_send(ws, &ws->ctl_op_key.key, ws->ctl_buf, &size);
+    if (status != PJ_EPENDING)
+	ws->ctl_pending = PJ_FALSE;
+
+    pj_lock_release(ws->base.lock);
+    return status;
+}
+
+
+/* Send a close frame with the specified status code. */
+static pj_status_t ws_send_close(struct ws_transport *ws, unsigned code)
+{
+    pj_uint8_t payload[2];
+
+    payload[0] = (pj_uint8_t)(code >> 8);
+    payload[1] = (pj_uint8_t)code;
+    return ws_send_ctl(ws, WS_OP_CLOSE, payload, 2);
+}
+
+
+/*
+ * Initialize pjsip_ws_transport_cfg structure with default values.
+ */
+PJ_DEF(void) pjsip_ws_transport_cfg_default(pjsip_ws_transport_cfg *cfg,
+					    int af)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->af = af;
+    pj_sockaddr_init(cfg->af, &cfg->bind_addr, NULL, 0);
+    cfg->async_cnt = 1;
+    cfg->reuse_addr = PJSIP_TCP_TRANSPORT_REUSEADDR;
+}
+
+
+/****************************************************************************
+ * The WebSocket listener/transport factory.
+ */
+
+static pj_status_t update_factory_addr(struct ws_listener *listener,
+				       const pjsip_host_port *addr_name)
+{
+    pj_status_t status = PJ_SUCCESS;
+    pj_sockaddr *listener_addr = &listener->factory.local_addr;
+
+    /* If published host/IP is specified, then use that address as the
+     * listener advertised address.
+     */
+    if (addr_name && addr_name->host.slen) {
+	pj_sockaddr tmp;
+	int af = pjsip_transport_type_get_af(listener->factory.type);
+
+	/* Verify that address given in a_name (if any) is valid */
+	status = pj_sockaddr_init(af, &tmp, &addr_name->host,
+				  (pj_uint16_t)addr_name->port);
+	if (status != PJ_SUCCESS || !pj_sockaddr_has_addr(&tmp) ||
+	    (af == pj_AF_INET() && tmp.ipv4.sin_addr.s_addr == PJ_INADDR_NONE))
+	{
+	    /* Invalid address */
+	    return PJ_EINVAL;
+	}
+
+	/* Copy the address */
+	listener->factory.addr_name = *addr_name;
+	pj_strdup(listener->factory.pool, &listener->factory.addr_name.host,
+		  &addr_name->host);
+	listener->factory.addr_name.port = addr_name->port;
+
+    } else {
+	/* No published address is given, use the bound address */
+
+	/* If the address returns 0.0.0.0, use the default
+	 * interface address as the transport's address.
+	 */
+	if (!pj_sockaddr_has_addr(listener_addr)) {
+	    pj_sockaddr hostip;
+
+	    status = pj_gethostip(listener->bound_addr.addr.sa_family,
+				  &hostip);
+	    if (status != PJ_SUCCESS)
+		return status;
+
+	    pj_sockaddr_copy_addr(listener_addr, &hostip);
+	}
+
+	/* Save the address name */
+	sockaddr_to_host_port(listener->factory.pool,
+			      &listener->factory.addr_name,
+			      listener_addr);
+    }
+
+    /* If port is zero, get the bound port */
+    if (listener->factory.addr_name.port == 0) {
+	listener->factory.addr_name.port = pj_sockaddr_get_port(listener_addr);
+    }
+
+    pj_ansi_snprintf(listener->factory.obj_name,
+		     sizeof(listener->factory.obj_name),
+		     "%stp:%d",
+		     (listener->factory.flag & PJSIP_TRANSPORT_SECURE) ?
+			"wss" : "ws",
+		     listener->factory.addr_name.port);
+    return status;
+}
+
+static void update_transport_info(struct ws_listener *listener)
+{
+    enum { INFO_LEN = 100 };
+    char local_addr[PJ_INET6_ADDRSTRLEN + 10];
+    pj_sockaddr *listener_addr = &listener->factory.local_addr;
+
+    /* Set transport info. */
+    if (listener->factory.info == NULL) {
+	listener->factory.info = (char*)pj_pool_alloc(listener->factory.pool,
+						      INFO_LEN);
+    }
+    pj_sockaddr_print(listener_addr, local_addr, sizeof(local_addr), 3);
+    pj_ansi_snprintf(
+	    listener->factory.info, INFO_LEN, "%s %s [published as %.*s:%d]",
+	    (listener->factory.flag & PJSIP_TRANSPORT_SECURE) ? "wss" : "ws",
+	    local_addr,
+	    (int)listener->factory.addr_name.host.slen,
+	    listener->factory.addr_name.host.ptr,
+	    listener->factory.addr_name.port);
+
+    PJ_LOG(4, (listener->factory.obj_name,
+	       "SIP %s listener ready for incoming connections at %.*s:%d",
+	       listener->factory.type_name,
+	       (int)listener->factory.addr_name.host.slen,
+	       listener->factory.addr_name.host.ptr,
+	       listener->factory.addr_name.port));
+}
+
+
+/* Start plain WebSocket listener on activesock. */
+static pj_status_t lis_start_ws(struct ws_listener *listener)
+{
+    pj_activesock_cfg asock_cfg;
+    pj_activesock_cb listener_cb;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_sockaddr *listener_addr = &listener->factory.local_addr;
+    int addr_len, af;
+    pj_status_t status;
+
+    addr_len = pj_sockaddr_get_len(listener_addr);
+    af = pjsip_transport_type_get_af(listener->factory.type);
+
+    /* Create socket */
+    status = pj_sock_socket(af, pj_SOCK_STREAM(), 0, &sock);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* Apply QoS, if specified */
+    status = pj_sock_apply_qos2(sock, listener->qos_type,
+				&listener->qos_params, 2,
+				listener->factory.obj_name,
+				"SIP WS listener socket");
+
+    /* Apply SO_REUSEADDR */
+    if (listener->reuse_addr) {
+	int enabled = 1;
+	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEADDR(),
+				    &enabled, sizeof(enabled));
+	if (status != PJ_SUCCESS) {
+	    PJ_PERROR(4, (listener->factory.obj_name, status,
+		"Warning: error applying SO_REUSEADDR"));
+	}
+    }
+
+    /* Apply socket options, if specified */
+    if (listener->sockopt_params.cnt)
+	status = pj_sock_setsockopt_params(sock, &listener->sockopt_params);
+
+    status = pj_sock_bind(sock, listener_addr, addr_len);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Retrieve the bound address */
+    status = pj_sock_getsockname(sock, listener_addr, &addr_len);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Start listening to the address */
+    status = pj_sock_listen(sock, PJSIP_WS_TRANSPORT_BACKLOG);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Create active socket */
+    pj_activesock_cfg_default(&asock_cfg);
+    if (listener->async_cnt > MAX_ASYNC_CNT)
+	asock_cfg.async_cnt = MAX_ASYNC_CNT;
+    else
+	asock_cfg.async_cnt = listener->async_cnt;
+
+    asock_cfg.grp_lock = listener->grp_lock;
+    pj_bzero(&listener_cb, sizeof(listener_cb));
+    listener_cb.on_accept_complete = &on_accept_complete;
+
+    status = pj_activesock_create(listener->factory.pool, sock,
+				  pj_SOCK_STREAM(), &asock_cfg,
+				  pjsip_endpt_get_ioqueue(listener->endpt),
+				  &listener_cb, listener,
+				  &listener->asock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Start pending accept() operations */
+    return pj_activesock_start_accept(listener->asock,
+				      listener->factory.pool);
+
+on_error:
+    if (listener->asock == NULL && sock != PJ_INVALID_SOCKET)
+	pj_sock_close(sock);
+    return status;
+}
+
+
+#if WS_HAS_WSS
+/* Start secure WebSocket listener on SSL socket. */
+static pj_status_t lis_start_wss(struct ws_listener *listener)
+{
+    pj_ssl_sock_param ssock_param, newsock_param;
+    pj_sockaddr *listener_addr = &listener->factory.local_addr;
+    pj_ssl_sock_info info;
+    pj_status_t status;
+
+    pj_ssl_sock_param_default(&ssock_param);
+    ssock_param.sock_af = pjsip_transport_type_get_af(listener->factory.type);
+    ssock_param.cb.on_accept_complete = &ssock_on_accept_complete;
+    ssock_param.async_cnt = (listener->async_cnt > MAX_ASYNC_CNT) ?
+			    MAX_ASYNC_CNT : listener->async_cnt;
+    ssock_param.ioqueue = pjsip_endpt_get_ioqueue(listener->endpt);
+    ssock_param.timer_heap = pjsip_endpt_get_timer_heap(listener->endpt);
+    ssock_param.user_data = listener;
+    ssock_param.verify_peer = PJ_FALSE;
+    if (ssock_param.send_buffer_size < PJSIP_MAX_PKT_LEN)
+	ssock_param.send_buffer_size = PJSIP_MAX_PKT_LEN;
+    if (ssock_param.read_buffer_size < PJSIP_MAX_PKT_LEN)
+	ssock_param.read_buffer_size = PJSIP_MAX_PKT_LEN;
+    ssock_param.reuse_addr = listener->reuse_addr;
+    ssock_param.qos_type = listener->qos_type;
+    pj_memcpy(&ssock_param.qos_params, &listener->qos_params,
+	      sizeof(ssock_param.qos_params));
+    pj_memcpy(&ssock_param.sockopt_params, &listener->sockopt_params,
+	      sizeof(ssock_param.sockopt_params));
+    ssock_param.grp_lock = listener->grp_lock;
+
+    /* Create SSL socket */
+    status = pj_ssl_sock_create(listener->factory.pool, &ssock_param,
+				&listener->ssock);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pj_ssl_sock_set_certificate(listener->ssock,
+					 listener->factory.pool,
+					 listener->cert);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pj_memcpy(&newsock_param, &ssock_param, sizeof(newsock_param));
+    newsock_param.async_cnt = 1;
+    newsock_param.cb.on_data_read = &ssock_on_data_read;
+    newsock_param.cb.on_data_sent = &ssock_on_data_sent;
+    status = pj_ssl_sock_start_accept2(listener->ssock, listener->factory.pool,
+				       listener_addr,
+				       pj_sockaddr_get_len(listener_addr),
+				       &newsock_param);
+    if (status != PJ_SUCCESS && status != PJ_EPENDING)
+	return status;
+
+    /* Retrieve the bound address */
+    status = pj_ssl_sock_get_info(listener->ssock, &info);
+    if (status == PJ_SUCCESS)
+	pj_sockaddr_cp(listener_addr, &info.local_addr);
+
+    return status;
+}
+#endif	/* WS_HAS_WSS */
+
+
+/*
+ * This is the public API to create, initialize, register, and start the
+ * WebSocket listener.
+ */
+PJ_DEF(pj_status_t) pjsip_ws_transport_start(pjsip_endpoint *endpt,
+					     const pjsip_ws_transport_cfg *cfg,
+					     pjsip_tpfactory **p_factory)
+{
+    pj_pool_t *pool;
+    struct ws_listener *listener;
+    pj_bool_t is_ipv6;
+    pj_status_t status;
+
+    /* Sanity check */
+    PJ_ASSERT_RETURN(endpt && cfg && cfg->async_cnt, PJ_EINVAL);
+#if WS_HAS_WSS
+    PJ_ASSERT_RETURN(!cfg->secure || cfg->cert, PJ_EINVAL);
+#else
+    PJ_ASSERT_RETURN(!cfg->secure, PJ_ENOTSUP);
+#endif
+
+    is_ipv6 = (cfg->af == pj_AF_INET6());
+
+    pool = pjsip_endpt_create_pool(endpt, "wstp", POOL_LIS_INIT,
+				   POOL_LIS_INC);
+    PJ_ASSERT_RETURN(pool, PJ_ENOMEM);
+
+    listener = PJ_POOL_ZALLOC_T(pool, struct ws_listener);
+    listener->factory.pool = pool;
+    if (cfg->secure) {
+	listener->factory.type = is_ipv6 ? PJSIP_TRANSPORT_WSS6 :
+					   PJSIP_TRANSPORT_WSS;
+    } else {
+	listener->factory.type = is_ipv6 ? PJSIP_TRANSPORT_WS6 :
+					   PJSIP_TRANSPORT_WS;
+    }
+    listener->factory.type_name = (char*)
+			 pjsip_transport_get_type_name(listener->factory.type);
+    listener->factory.flag =
+		    pjsip_transport_get_flag_from_type(listener->factory.type);
+    listener->qos_type = cfg->qos_type;
+    listener->reuse_addr = cfg->reuse_addr;
+    listener->async_cnt = cfg->async_cnt;
+    pj_strdup(pool, &listener->path, &cfg->path);
+    pj_memcpy(&listener->qos_params, &cfg->qos_params,
+	      sizeof(cfg->qos_params));
+    pj_memcpy(&listener->sockopt_params, &cfg->sockopt_params,
+	      sizeof(cfg->sockopt_params));
+#if WS_HAS_WSS
+    listener->cert = cfg->cert;
+#endif
+
+    pj_ansi_strcpy(listener->factory.obj_name, cfg->secure ? "wsstp" :
+							     "wstp");
+    if (is_ipv6)
+	pj_ansi_strcat(listener->factory.obj_name, "6");
+
+    status = pj_lock_create_recursive_mutex(pool, listener->factory.obj_name,
+					    &listener->factory.lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Create group lock */
+    status = pj_grp_lock_create(pool, NULL, &listener->grp_lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    pj_grp_lock_add_ref(listener->grp_lock);
+    pj_grp_lock_add_handler(listener->grp_lock, pool, listener,
+			    &lis_on_destroy);
+
+    listener->endpt = endpt;
+    listener->tpmgr = pjsip_endpt_get_tpmgr(endpt);
+    listener->factory.create_transport = lis_create_transport;
+    listener->factory.destroy = lis_destroy;
+
+    /* Bind address may be different than factory.local_addr because
+     * factory.local_addr will be resolved.
+     */
+    pj_sockaddr_cp(&listener->bound_addr, &cfg->bind_addr);
+    pj_sockaddr_cp(&listener->factory.local_addr, &listener->bound_addr);
+
+    /* Start listener. */
+#if WS_HAS_WSS
+    if (cfg->secure)
+	status = lis_start_wss(listener);
+    else
+#endif
+	status = lis_start_ws(listener);
+    if (status != PJ_SUCCESS && status != PJ_EPENDING)
+	goto on_error;
+
+    status = update_factory_addr(listener, &cfg->addr_name);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    update_transport_info(listener);
+
+    /* Register to transport manager */
+    listener->is_registered = PJ_TRUE;
+    status = pjsip_tpmgr_register_tpfactory(listener->tpmgr,
+					    &listener->factory);
+    if (status != PJ_SUCCESS) {
+	listener->is_registered = PJ_FALSE;
+	goto on_error;
+    }
+
+    /* Return the pointer to user */
+    if (p_factory) *p_factory = &listener->factory;
+
+    return PJ_SUCCESS;
+
+on_error:
+    lis_destroy(&listener->factory);
+    return status;
+}
+
+
+/* Clean up listener resources */
+static void lis_on_destroy(void *arg)
+{
+    struct ws_listener *listener = (struct ws_listener *)arg;
+
+    if (listener->factory.lock) {
+	pj_lock_destroy(listener->factory.lock);
+	listener->factory.lock = NULL;
+    }
+
+    if (listener->factory.pool) {
+	PJ_LOG(4,(listener->factory.obj_name,  "SIP WS transport destroyed"));
+	pj_pool_safe_release(&listener->factory.pool);
+    }
+}
+
+/* This callback is called by transport manager to destroy listener */
+static pj_status_t lis_destroy(pjsip_tpfactory *factory)
+{
+    struct ws_listener *listener = (struct ws_listener *)factory;
+
+    if (listener->is_registered) {
+	pjsip_tpmgr_unregister_tpfactory(listener->tpmgr, &listener->factory);
+	listener->is_registered = PJ_FALSE;
+    }
+
+    if (listener->asock) {
+	pj_activesock_close(listener->asock);
+	listener->asock = NULL;
+    }
+
+#if WS_HAS_WSS
+    if (listener->ssock) {
+	pj_ssl_sock_close(listener->ssock);
+	listener->ssock = NULL;
+    }
+#endif
+
+    if (listener->grp_lock) {
+	pj_grp_lock_t *grp_lock = listener->grp_lock;
+	listener->grp_lock = NULL;
+	pj_grp_lock_dec_ref(grp_lock);
+	/* Listener may have been deleted at this point */
+    } else {
+	lis_on_destroy(listener);
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/* WebSocket clients can not accept connections, so outgoing transports
+ * can not be created. Requests towards WebSocket clients must be sent over
+ * the connection established by the client.
+ */
+static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
+					pjsip_tpmgr *mgr,
+					pjsip_endpoint *endpt,
+					const pj_sockaddr *rem_addr,
+					int addr_len,
+					pjsip_transport **p_transport)
+{
+    PJ_UNUSED_ARG(factory);
+    PJ_UNUSED_ARG(mgr);
+    PJ_UNUSED_ARG(endpt);
+    PJ_UNUSED_ARG(rem_addr);
+    PJ_UNUSED_ARG(addr_len);
+    PJ_UNUSED_ARG(p_transport);
+
+    return PJ_ENOTSUP;
+}
+
+
+/***************************************************************************/
+/*
+ * WebSocket Transport
+ */
+
+/*
+ * Common function to create WebSocket transport, called when pending
+ * accept() completes. Exactly one of sock and ssock is valid.
+ */
+static pj_status_t ws_create( struct ws_listener *listener,
+			      pj_sock_t sock,
+			      void *ssock,
+			      const pj_sockaddr *local,
+			      const pj_sockaddr *remote,
+			      struct ws_transport **p_ws)
+{
+    struct ws_transport *ws;
+    pj_pool_t *pool;
+    char print_addr[PJ_INET6_ADDRSTRLEN+10];
+    pj_status_t status;
+
+    pool = pjsip_endpt_create_pool(listener->endpt, "ws",
+				   POOL_TP_INIT, POOL_TP_INC);
+    PJ_ASSERT_RETURN(pool != NULL, PJ_ENOMEM);
+
+    /*
+     * Create and initialize basic transport structure.
+     */
+    ws = PJ_POOL_ZALLOC_T(pool, struct ws_transport);
+    ws->sock = sock;
+#if WS_HAS_WSS
+    ws->ssock = (pj_ssl_sock_t*)ssock;
+#else
+    PJ_UNUSED_ARG(ssock);
+#endif
+    ws->base.pool = pool;
+    pj_strdup(pool, &ws->path, &listener->path);
+
+    pj_ansi_snprintf(ws->base.obj_name, PJ_MAX_OBJ_NAME,
+		     (ssock ? "wss%p" : "ws%p"), ws);
+
+    status = pj_atomic_create(pool, 0, &ws->base.ref_cnt);
+    if (status != PJ_SUCCESS) {
+	goto on_error;
+    }
+
+    status = pj_lock_create_recursive_mutex(pool, "ws", &ws->base.lock);
+    if (status != PJ_SUCCESS) {
+	goto on_error;
+    }
+
+    ws->base.key.type = listener->factory.type;
+    pj_sockaddr_cp(&ws->base.key.rem_addr, remote);
+    ws->base.type_name = (char*)pjsip_transport_get_type_name(
+				(pjsip_transport_type_e)ws->base.key.type);
+    ws->base.flag = pjsip_transport_get_flag_from_type(
+				(pjsip_transport_type_e)ws->base.key.type);
+
+    ws->base.info = (char*) pj_pool_alloc(pool, 64);
+    pj_ansi_snprintf(ws->base.info, 64, "%s to %s",
+                     ws->base.type_name,
+                     pj_sockaddr_print(remote, print_addr,
+                                       sizeof(print_addr), 3));
+
+    ws->base.addr_len = pj_sockaddr_get_len(remote);
+    pj_sockaddr_cp(&ws->base.local_addr, local);
+    sockaddr_to_host_port(pool, &ws->base.local_name, local);
+    sockaddr_to_host_port(pool, &ws->base.remote_name, remote);
+    ws->base.dir = PJSIP_TP_DIR_INCOMING;
+
+    ws->base.endpt = listener->endpt;
+    ws->base.tpmgr = listener->tpmgr;
+    ws->base.send_msg = &ws_send_msg;
+    ws->base.do_shutdown = &ws_shutdown;
+    ws->base.destroy = &ws_destroy_transport;
+    ws->base.factory = &listener->factory;
+
+    if (sock != PJ_INVALID_SOCKET) {
+	pj_activesock_cfg asock_cfg;
+	pj_activesock_cb ws_callback;
+
+	/* Create group lock */
+	status = pj_grp_lock_create(pool, NULL, &ws->grp_lock);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	pj_grp_lock_add_ref(ws->grp_lock);
+	pj_grp_lock_add_handler(ws->grp_lock, pool, ws, &ws_on_destroy);
+
+	/* Create active socket */
+	pj_activesock_cfg_default(&asock_cfg);
+	asock_cfg.async_cnt = 1;
+	asock_cfg.grp_lock = ws->grp_lock;
+
+	pj_bzero(&ws_callback, sizeof(ws_callback));
+	ws_callback.on_data_read = &asock_on_data_read;
+	ws_callback.on_data_sent = &asock_on_data_sent;
+
+	status = pj_activesock_create(pool, sock, pj_SOCK_STREAM(), &asock_cfg,
+				      pjsip_endpt_get_ioqueue(listener->endpt),
+				      &ws_callback, ws, &ws->asock);
+	if (status != PJ_SUCCESS) {
+	    goto on_error;
+	}
+    }
+
+    /* Register transport to transport manager */
+    status = pjsip_transport_register(listener->tpmgr, &ws->base);
+    if (status != PJ_SUCCESS) {
+	goto on_error;
+    }
+
+    ws->is_registered = PJ_TRUE;
+
+    /* Initialize keep-alive entry and control op keys. The group lock is
+     * set when the entry is scheduled, as WSS connection only gets it
+     * after this function returns.
+     */
+    pjsip_tp_ka_entry_init(&ws->ka_entry, NULL, &ws_keep_alive_cb, ws);
+    pj_ioqueue_op_key_init(&ws->ka_op_key.key, sizeof(pj_ioqueue_op_key_t));
+    pj_ioqueue_op_key_init(&ws->hs_op_key.key, sizeof(pj_ioqueue_op_key_t));
+    pj_ioqueue_op_key_init(&ws->ctl_op_key.key, sizeof(pj_ioqueue_op_key_t));
+    ws_put_frame_hdr((pj_uint8_t*)ws->ka_buf, WS_OP_PING, 0);
+
+    /* Done setting up basic transport. */
+    *p_ws = ws;
+
+    PJ_LOG(4,(ws->base.obj_name, "%s server transport created",
+	      ws->base.type_name));
+
+    return PJ_SUCCESS;
+
+on_error:
+    ws_destroy(&ws->base, status);
+    return status;
+}
+
+
+/* Called by transport manager to destroy transport */
+static pj_status_t ws_destroy_transport(pjsip_transport *transport)
+{
+    struct ws_transport *ws = (struct ws_transport*)transport;
+
+    /* Transport would have been unregistered by now since this callback
+     * is called by transport manager.
+     */
+    ws->is_registered = PJ_FALSE;
+
+    return ws_destroy(transport, ws->close_reason);
+}
+
+
+/* Destroy WebSocket transport */
+static pj_status_t ws_destroy(pjsip_transport *transport,
+			      pj_status_t reason)
+{
+    struct ws_transport *ws = (struct ws_transport*)transport;
+
+    if (ws->close_reason == 0)
+	ws->close_reason = reason;
+
+    if (ws->is_registered) {
+	ws->is_registered = PJ_FALSE;
+	pjsip_transport_destroy(transport);
+
+	/* pjsip_transport_destroy will recursively call this function
+	 * again.
+	 */
+	return PJ_SUCCESS;
+    }
+
+    /* Mark transport as closing */
+    ws->is_closing = PJ_TRUE;
+
+    /* Stop keep-alive timer. */
+    pjsip_tpmgr_ka_cancel(ws->base.tpmgr, &ws->ka_entry);
+
+    if (ws->asock) {
+	pj_activesock_close(ws->asock);
+	ws->asock = NULL;
+	ws->sock = PJ_INVALID_SOCKET;
+    } else if (ws->sock != PJ_INVALID_SOCKET) {
+	pj_sock_close(ws->sock);
+	ws->sock = PJ_INVALID_SOCKET;
+    }
+
+#if WS_HAS_WSS
+    if (ws->ssock) {
+	pj_ssl_sock_close(ws->ssock);
+	ws->ssock = NULL;
+    }
+#endif
+
+    if (ws->grp_lock) {
+	pj_grp_lock_t *grp_lock = ws->grp_lock;
+	ws->grp_lock = NULL;
+	pj_grp_lock_dec_ref(grp_lock);
+	/* Transport may have been deleted at this point */
+    } else {
+	ws_on_destroy(ws);
+    }
+
+    return PJ_SUCCESS;
+}
+
+/* Clean up WebSocket resources */
+static void ws_on_destroy(void *arg)
+{
+    struct ws_transport *ws = (struct ws_transport*)arg;
+
+    if (ws->base.lock) {
+	pj_lock_destroy(ws->base.lock);
+	ws->base.lock = NULL;
+    }
+
+    if (ws->base.ref_cnt) {
+	pj_atomic_destroy(ws->base.ref_cnt);
+	ws->base.ref_cnt = NULL;
+    }
+
+    if (ws->rdata.tp_info.pool) {
+	pj_pool_release(ws->rdata.tp_info.pool);
+	ws->rdata.tp_info.pool = NULL;
+    }
+
+    if (ws->base.pool) {
+	pj_pool_t *pool;
+
+	if (ws->close_reason != PJ_SUCCESS) {
+	    char errmsg[PJ_ERR_MSG_SIZE];
+
+	    pj_strerror(ws->close_reason, errmsg, sizeof(errmsg));
+	    PJ_LOG(4,(ws->base.obj_name,
+		      "WS transport destroyed with reason %d: %s",
+		      ws->close_reason, errmsg));
+
+	} else {
+
+	    PJ_LOG(4,(ws->base.obj_name,
+		      "WS transport destroyed normally"));
+
+	}
+
+	pool = ws->base.pool;
+	ws->base.pool = NULL;
+	pj_pool_release(pool);
+    }
+}
+
+
+/* Schedule the keep-alive entry to be due after the specified seconds,
+ * or remove it if the value is zero.
+ */
+static void ws_schedule_timer(struct ws_transport *ws, long sec)
+{
+    if (sec <= 0 || ws->grp_lock == NULL) {
+	pjsip_tpmgr_ka_cancel(ws->base.tpmgr, &ws->ka_entry);
+	return;
+    }
+
+    ws->ka_entry.grp_lock = ws->grp_lock;
+    pjsip_tpmgr_ka_schedule(ws->base.tpmgr, &ws->ka_entry, sec);
+}
+
+
+/* Get the delay until the upgraded connection needs to be checked for
+ * keep-alive or idle timeout, zero if neither is enabled.
+ */
+static long ws_ka_delay(void)
+{
+    long ka_intv = pjsip_cfg()->ws.keep_alive_interval;
+    long idle = pjsip_cfg()->ws.idle_timeout;
+
+    if (ka_intv <= 0 || (idle > 0 && idle < ka_intv))
+	return idle > 0 ? idle : 0;
+    return ka_intv;
+}
+
+
+/*
+ * This utility function creates receive data buffers and start
+ * asynchronous recv() operations from the socket. It is called after
+ * accept() completes.
+ */
+static pj_status_t ws_start_read(struct ws_transport *ws)
+{
+    pj_pool_t *pool;
+    pj_uint32_t size;
+    pj_sockaddr *rem_addr;
+    void *readbuf[1];
+    pj_status_t status;
+
+    /* Init rdata */
+    pool = pjsip_endpt_create_pool(ws->base.endpt,
+				   "rtd%p",
+				   PJSIP_POOL_RDATA_LEN,
+				   PJSIP_POOL_RDATA_INC);
+    if (!pool) {
+	ws_perror(ws->base.obj_name, "Unable to create pool", PJ_ENOMEM);
+	return PJ_ENOMEM;
+    }
+
+    ws->rdata.tp_info.pool = pool;
+
+    ws->rdata.tp_info.transport = &ws->base;
+    ws->rdata.tp_info.tp_data = ws;
+    ws->rdata.tp_info.op_key.rdata = &ws->rdata;
+    pj_ioqueue_op_key_init(&ws->rdata.tp_info.op_key.op_key,
+			   sizeof(pj_ioqueue_op_key_t));
+
+    ws->rdata.pkt_info.src_addr = ws->base.key.rem_addr;
+    ws->rdata.pkt_info.src_addr_len = sizeof(ws->rdata.pkt_info.src_addr);
+    rem_addr = &ws->base.key.rem_addr;
+    pj_sockaddr_print(rem_addr, ws->rdata.pkt_info.src_name,
+                      sizeof(ws->rdata.pkt_info.src_name), 0);
+    ws->rdata.pkt_info.src_port = pj_sockaddr_get_port(rem_addr);
+
+    /* Keep one byte for the NULL terminator the parser requires. */
+    size = sizeof(ws->rdata.pkt_info.packet) - 1;
+    readbuf[0] = ws->rdata.pkt_info.packet;
+#if WS_HAS_WSS
+    if (ws->ssock) {
+	status = pj_ssl_sock_start_read2(ws->ssock, ws->base.pool, size,
+					 readbuf, 0);
+    } else
+#endif
+    {
+	status = pj_activesock_start_read2(ws->asock, ws->base.pool, size,
+					   readbuf, 0);
+    }
+    if (status != PJ_SUCCESS && status != PJ_EPENDING) {
+	PJ_LOG(4, (ws->base.obj_name,
+		   "Error starting read, status=%d",
+		   status));
+	return status;
+    }
+
+    /* Client must complete the opening handshake in time */
+    pj_gettimeofday(&ws->last_activity);
+    ws->last_rx = ws->last_activity;
+    ws_schedule_timer(ws, PJSIP_WS_HANDSHAKE_TIMEOUT);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Common processing after an incoming connection has been accepted. */
+static void ws_on_accepted(struct ws_transport *ws)
+{
+    pjsip_tp_state_callback state_cb;
+    pj_status_t status;
+
+    status = ws_start_read(ws);
+    if (status != PJ_SUCCESS) {
+	PJ_LOG(3,(ws->base.obj_name, "New transport cancelled"));
+	ws_destroy(&ws->base, status);
+	return;
+    }
+
+    if (ws->base.is_shutdown || ws->base.is_destroying)
+	return;
+
+    /* Notify application of transport state accepted */
+    state_cb = pjsip_tpmgr_get_state_cb(ws->base.tpmgr);
+    if (state_cb) {
+	pjsip_transport_state_info state_info;
+
+	pj_bzero(&state_info, sizeof(state_info));
+	(*state_cb)(&ws->base, PJSIP_TP_STATE_CONNECTED, &state_info);
+    }
+}
+
+
+/*
+ * This callback is called by active socket when pending accept() operation
+ * has completed.
+ */
+static pj_bool_t on_accept_complete(pj_activesock_t *asock,
+				    pj_sock_t sock,
+				    const pj_sockaddr_t *src_addr,
+				    int src_addr_len)
+{
+    struct ws_listener *listener;
+    struct ws_transport *ws;
+    char addr[PJ_INET6_ADDRSTRLEN+10];
+    pj_sockaddr tmp_src_addr, tmp_dst_addr;
+    int addr_len;
+    pj_status_t status;
+
+    PJ_UNUSED_ARG(src_addr_len);
+
+    listener = (struct ws_listener*) pj_activesock_get_user_data(asock);
+
+    PJ_ASSERT_RETURN(sock != PJ_INVALID_SOCKET, PJ_TRUE);
+
+    if (!listener->is_registered)
+	return PJ_FALSE;
+
+    PJ_LOG(4,(listener->factory.obj_name,
+	      "WS listener %.*s:%d: got incoming connection from %s, sock=%d",
+	      (int)listener->factory.addr_name.host.slen,
+	      listener->factory.addr_name.host.ptr,
+	      listener->factory.addr_name.port,
+	      pj_sockaddr_print(src_addr, addr, sizeof(addr), 3),
+	      sock));
+
+    /* Apply QoS, if specified */
+    status = pj_sock_apply_qos2(sock, listener->qos_type,
+				&listener->qos_params,
+				2, listener->factory.obj_name,
+				"incoming SIP WS socket");
+
+    /* Apply socket options, if specified */
+    if (listener->sockopt_params.cnt)
+	status = pj_sock_setsockopt_params(sock, &listener->sockopt_params);
+
+    pj_bzero(&tmp_src_addr, sizeof(tmp_src_addr));
+    pj_sockaddr_cp(&tmp_src_addr, src_addr);
+
+    /* Get local address */
+    addr_len = sizeof(tmp_dst_addr);
+    status = pj_sock_getsockname(sock, &tmp_dst_addr, &addr_len);
+    if (status != PJ_SUCCESS) {
+	pj_sockaddr_cp(&tmp_dst_addr, &listener->factory.local_addr);
+    }
+
+    status = ws_create(listener, sock, NULL, &tmp_dst_addr, &tmp_src_addr,
+		       &ws);
+    if (status == PJ_SUCCESS)
+	ws_on_accepted(ws);
+
+    return PJ_TRUE;
+}
+
+
+#if WS_HAS_WSS
+/*
+ * This callback is called by SSL socket when pending accept() operation
+ * has completed.
+ */
+static pj_bool_t ssock_on_accept_complete(pj_ssl_sock_t *ssock,
+					  pj_ssl_sock_t *new_ssock,
+					  const pj_sockaddr_t *src_addr,
+					  int src_addr_len)
+{
+    struct ws_listener *listener;
+    struct ws_transport *ws;
+    pj_ssl_sock_info ssl_info;
+    char addr[PJ_INET6_ADDRSTRLEN+10];
+    pj_sockaddr tmp_src_addr;
+    pj_status_t status;
+
+    PJ_UNUSED_ARG(src_addr_len);
+
+    listener = (struct ws_listener*) pj_ssl_sock_get_user_data(ssock);
+
+    PJ_ASSERT_RETURN(new_ssock, PJ_TRUE);
+
+    if (!listener->is_registered)
+	return PJ_FALSE;
+
+    PJ_LOG(4,(listener->factory.obj_name,
+	      "WSS listener %.*s:%d: got incoming connection from %s",
+	      (int)listener->factory.addr_name.host.slen,
+	      listener->factory.addr_name.host.ptr,
+	      listener->factory.addr_name.port,
+	      pj_sockaddr_print(src_addr, addr, sizeof(addr), 3)));
+
+    /* SSL socket info is required for the local address and group lock */
+    status = pj_ssl_sock_get_info(new_ssock, &ssl_info);
+    if (status != PJ_SUCCESS) {
+	pj_ssl_sock_close(new_ssock);
+	return PJ_TRUE;
+    }
+
+    pj_bzero(&tmp_src_addr, sizeof(tmp_src_addr));
+    pj_sockaddr_cp(&tmp_src_addr, src_addr);
+
+    status = ws_create(listener, PJ_INVALID_SOCKET, new_ssock,
+		       &ssl_info.local_addr, &tmp_src_addr, &ws);
+    if (status != PJ_SUCCESS)
+	return PJ_TRUE;
+
+    pj_ssl_sock_set_user_data(new_ssock, ws);
+
+    /* Set up the group lock */
+    if (ssl_info.grp_lock) {
+	ws->grp_lock = ssl_info.grp_lock;
+	pj_grp_lock_add_ref(ws->grp_lock);
+	pj_grp_lock_add_handler(ws->grp_lock, ws->base.pool, ws,
+				&ws_on_destroy);
+    }
+
+    ws_on_accepted(ws);
+
+    return PJ_TRUE;
+}
+#endif	/* WS_HAS_WSS */
+
+
+/*
+ * Common handler when data has been sent.
+ */
+static pj_bool_t ws_on_data_sent(struct ws_transport *ws,
+				 pj_ioqueue_op_key_t *op_key,
+				 pj_ssize_t bytes_sent)
+{
+    pjsip_tx_data_op_key *tdata_op_key = (pjsip_tx_data_op_key*)op_key;
+
+    if (op_key == &ws->ka_op_key.key) {
+	ws->ka_pending = PJ_FALSE;
+    } else if (op_key == &ws->ctl_op_key.key) {
+	pj_lock_acquire(ws->base.lock);
+	ws->ctl_pending = PJ_FALSE;
+
+	/* Send the queued control frame, if any */
+	if (ws->ctl_next_len && bytes_sent > 0 && !ws->is_closing) {
+	    pj_ssize_t size = (pj_ssize_t)ws->ctl_next_len;
+	    pj_status_t status;
+
+	    pj_memcpy(ws->ctl_buf, ws->ctl_next_buf, ws->ctl_next_len);
+	    ws->ctl_next_len = 0;
+	    ws->ctl_pending = PJ_TRUE;
+	    status = ws_sock_send(ws, &ws->ctl_op_key.key, ws->ctl_buf,
+				  &size);
+	    if (status != PJ_EPENDING)
+		ws->ctl_pending = PJ_FALSE;
+	}
+	pj_lock_release(ws->base.lock);
+    } else if (op_key == &ws->hs_op_key.key) {
+	/* Failed handshake: the error response has been flushed. */
+	if (!ws->upgraded && bytes_sent > 0) {
+	    ws_init_shutdown(ws, PJSIP_EINVALIDMSG);
+	    return PJ_FALSE;
+	}
+    } else {
+	tdata_op_key->tdata = NULL;
+
+	if (tdata_op_key->callback) {
+	    /*
+	     * Notify sip_transport.c that packet has been sent. Report
+	     * the size of the SIP message rather than the framed size.
+	     */
+	    pj_ssize_t msg_sent = bytes_sent;
+
+	    if (bytes_sent == 0)
+		msg_sent = -PJ_RETURN_OS_ERROR(OSERR_ENOTCONN);
+	    else if (bytes_sent > 0 && tdata_op_key->token)
+		msg_sent = ((pjsip_tx_data*)tdata_op_key->token)->buf.cur -
+			   ((pjsip_tx_data*)tdata_op_key->token)->buf.start;
+
+	    tdata_op_key->callback(&ws->base, tdata_op_key->token, msg_sent);
+
+	    /* Mark last activity time */
+	    pj_gettimeofday(&ws->last_activity);
+	}
+    }
+
+    /* Check for error/closure */
+    if (bytes_sent <= 0) {
+	pj_status_t status;
+
+	PJ_LOG(5,(ws->base.obj_name, "WS send() error, sent=%d",
+		  bytes_sent));
+
+	status = (bytes_sent == 0) ? PJ_RETURN_OS_ERROR(OSERR_ENOTCONN) :
+				     (pj_status_t)-bytes_sent;
+
+	ws_init_shutdown(ws, status);
+
+	return PJ_FALSE;
+    }
+
+    return PJ_TRUE;
+}
+
+
+/*
+ * This callback is called by transport manager to send SIP message.
+ * The message is sent as a single unmasked text frame.
+ */
+static pj_status_t ws_send_msg(pjsip_transport *transport,
+			       pjsip_tx_data *tdata,
+			       const pj_sockaddr_t *rem_addr,
+			       int addr_len,
+			       void *token,
+			       pjsip_transport_callback callback)
+{
+    struct ws_transport *ws = (struct ws_transport*)transport;
+    pj_size_t msg_len;
+    pj_ssize_t size;
+    pj_uint8_t *frame;
+    unsigned hdr_len;
+    pj_status_t status;
+
+    /* Sanity check */
+    PJ_ASSERT_RETURN(transport && tdata, PJ_EINVAL);
+
+    /* Check that there's no pending operation associated with the tdata */
+    PJ_ASSERT_RETURN(tdata->op_key.tdata == NULL, PJSIP_EPENDINGTX);
+
+    /* Check the address is supported */
+    PJ_ASSERT_RETURN(rem_addr && (addr_len==sizeof(pj_sockaddr_in) ||
+	                          addr_len==sizeof(pj_sockaddr_in6)),
+	             PJ_EINVAL);
+
+    /* Messages can only be sent once the connection is upgraded */
+    if (!ws->upgraded)
+	return PJSIP_ETPNOTAVAIL;
+
+    /* Build the frame in tdata's pool, which lives until the send
+     * callback has been called.
+     */
+    msg_len = tdata->buf.cur - tdata->buf.start;
+    frame = (pj_uint8_t*) pj_pool_alloc(tdata->pool, msg_len + 10);
+    hdr_len = ws_put_frame_hdr(frame, WS_OP_TEXT, msg_len);
+    pj_memcpy(frame + hdr_len, tdata->buf.start, msg_len);
+
+    /* Init op key. */
+    tdata->op_key.tdata = tdata;
+    tdata->op_key.token = token;
+    tdata->op_key.callback = callback;
+
+    size = hdr_len + msg_len;
+    status = ws_sock_send(ws, (pj_ioqueue_op_key_t*)&tdata->op_key,
+			  frame, &size);
+
+    if (status != PJ_EPENDING) {
+	/* Not pending (could be immediate success or error) */
+	tdata->op_key.tdata = NULL;
+
+	/* Shutdown transport on closure/errors */
+	if (size <= 0) {
+
+	    PJ_LOG(5,(ws->base.obj_name, "WS send() error, sent=%d",
+		      size));
+
+	    if (status == PJ_SUCCESS)
+		status = PJ_RETURN_OS_ERROR(OSERR_ENOTCONN);
+
+	    ws_init_shutdown(ws, status);
+	}
+    }
+
+    return status;
+}
+
+
+/*
+ * This callback is called by transport manager to shutdown transport.
+ */
+static pj_status_t ws_shutdown(pjsip_transport *transport)
+{
+    struct ws_transport *ws = (struct ws_transport*)transport;
+
+    /* Stop keep-alive timer. */
+    pjsip_tpmgr_ka_cancel(ws->base.tpmgr, &ws->ka_entry);
+
+    /* Tell the peer we're going away */
+    if (ws->upgraded)
+	ws_send_close(ws, WS_CLOSE_NORMAL);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Find a header in the HTTP request; returns NULL if not found. */
+static pj_bool_t http_find_hdr(const pj_str_t *req, const char *name,
+			       pj_str_t *value)
+{
+    const char *p = req->ptr, *end = req->ptr + req->slen;
+    pj_size_t name_len = pj_ansi_strlen(name);
+
+    /* Skip request line */
+    while (p < end && *p != '\n') ++p;
+
+    while (p < end) {
+	const char *line = ++p, *eol;
+
+	while (p < end && *p != '\n') ++p;
+	eol = p;
+	if (eol > line && *(eol-1) == '\r') --eol;
+
+	if ((pj_size_t)(eol - line) > name_len && line[name_len] == ':' &&
+	    pj_ansi_strnicmp(line, name, name_len) == 0)
+	{
+	    value->ptr = (char*)line + name_len + 1;
+	    value->slen = eol - value->ptr;
+	    pj_strtrim(value);
+	    return PJ_TRUE;
+	}
+    }
+
+    return PJ_FALSE;
+}
+
+/* Check if comma separated list contains the token (case insensitive). */
+static pj_bool_t http_has_token(const pj_str_t *list, const char *token)
+{
+    pj_str_t tok = pj_str((char*)token);
+    pj_str_t rem = *list;
+
+    while (rem.slen > 0) {
+	pj_str_t item;
+	char *comma = pj_strchr(&rem, ',');
+
+	item.ptr = rem.ptr;
+	item.slen = comma ? comma - rem.ptr : rem.slen;
+	rem.ptr += item.slen + (comma ? 1 : 0);
+	rem.slen -= item.slen + (comma ? 1 : 0);
+
+	pj_strtrim(&item);
+	if (pj_stricmp(&item, &tok) == 0)
+	    return PJ_TRUE;
+    }
+
+    return PJ_FALSE;
+}
+
+/*
+ * Validate the HTTP Upgrade request in req, and build the response in
+ * hs_buf. Returns PJ_SUCCESS if the connection may be upgraded.
+ */
+static pj_status_t ws_build_handshake_response(struct ws_transport *ws,
+					       const pj_str_t *req,
+					       pj_ssize_t *resp_len)
+{
+    static const char bad_req[] = "HTTP/1.1 400 Bad Request\r\n"
+				  "Connection: close\r\n"
+				  "Content-Length: 0\r\n\r\n";
+    static const char bad_ver[] = "HTTP/1.1 426 Upgrade Required\r\n"
+				  "Sec-WebSocket-Version: 13\r\n"
+				  "Connection: close\r\n"
+				  "Content-Length: 0\r\n\r\n";
+    pj_str_t val, key, path;
+    pj_sha1_context sha;
+    pj_uint8_t digest[PJ_SHA1_DIGEST_SIZE];
+    char accept[PJ_BASE256_TO_BASE64_LEN(PJ_SHA1_DIGEST_SIZE) + 1];
+    int accept_len = sizeof(accept);
+    char *p;
+
+    /* Request line: GET <path> HTTP/1.1 */
+    if (req->slen < 14 || pj_ansi_strncmp(req->ptr, "GET ", 4) != 0)
+	goto bad_request;
+
+    path.ptr = req->ptr + 4;
+    for (p=path.ptr; p < req->ptr + req->slen && *p != ' ' && *p != '?' &&
+		     *p != '\r'; ++p)
+	;
+    path.slen = p - path.ptr;
+    if (ws->path.slen && pj_strcmp(&path, &ws->path) != 0) {
+	PJ_LOG(4,(ws->base.obj_name, "WS upgrade rejected: unknown path %.*s",
+		  (int)path.slen, path.ptr));
+	goto bad_request;
+    }
+
+    if (!http_find_hdr(req, "Upgrade", &val) ||
+	!http_has_token(&val, "websocket") ||
+	!http_find_hdr(req, "Connection", &val) ||
+	!http_has_token(&val, "Upgrade") ||
+	!http_find_hdr(req, "Sec-WebSocket-Key", &key) || key.slen == 0)
+    {
+	goto bad_request;
+    }
+
+    if (!http_find_hdr(req, "Sec-WebSocket-Version", &val) ||
+	pj_strcmp2(&val, "13") != 0)
+    {
+	pj_ansi_strcpy(ws->hs_buf, bad_ver);
+	*resp_len = sizeof(bad_ver) - 1;
+	return PJ_ENOTSUP;
+    }
+
+    /* RFC 7118: the "sip" subprotocol must be negotiated */
+    if (!http_find_hdr(req, "Sec-WebSocket-Protocol", &val) ||
+	!http_has_token(&val, "sip"))
+    {
+	PJ_LOG(4,(ws->base.obj_name, "WS upgrade rejected: no sip "
+		  "subprotocol"));
+	goto bad_request;
+    }
+
+    /* Sec-WebSocket-Accept = base64(SHA1(key + GUID)) */
+    pj_sha1_init(&sha);
+    pj_sha1_update(&sha, (const pj_uint8_t*)key.ptr, key.slen);
+    pj_sha1_update(&sha, (const pj_uint8_t*)WS_GUID, sizeof(WS_GUID)-1);
+    pj_sha1_final(&sha, digest);
+    if (pj_base64_encode(digest, sizeof(digest), accept, &accept_len) !=
+	PJ_SUCCESS)
+    {
+	goto bad_request;
+    }
+
+    *resp_len = pj_ansi_snprintf(ws->hs_buf, sizeof(ws->hs_buf),
+				 "HTTP/1.1 101 Switching Protocols\r\n"
+				 "Upgrade: websocket\r\n"
+				 "Connection: Upgrade\r\n"
+				 "Sec-WebSocket-Accept: %.*s\r\n"
+				 "Sec-WebSocket-Protocol: sip\r\n\r\n",
+				 accept_len, accept);
+    return PJ_SUCCESS;
+
+bad_request:
+    pj_ansi_strcpy(ws->hs_buf, bad_req);
+    *resp_len = sizeof(bad_req) - 1;
+    return PJSIP_EINVALIDMSG;
+}
+
+/*
+ * Process the opening handshake. Returns the number of bytes consumed from
+ * buf, or zero if the request is not complete yet.
+ */
+static pj_size_t ws_handle_upgrade(struct ws_transport *ws,
+				   char *buf, pj_size_t size,
+				   pj_status_t *p_status)
+{
+    pj_str_t req;
+    pj_ssize_t resp_len;
+    pj_size_t i;
+    pj_status_t status;
+
+    *p_status = PJ_SUCCESS;
+
+    /* Wait for the complete request header */
+    for (i=3; i<size; ++i) {
+	if (buf[i] == '\n' && buf[i-1] == '\r' && buf[i-2] == '\n' &&
+	    buf[i-3] == '\r')
+	{
+	    break;
+	}
+    }
+    if (i >= size)
+	return 0;
+
+    req.ptr = buf;
+    req.slen = i + 1;
+
+    status = ws_build_handshake_response(ws, &req, &resp_len);
+    if (status == PJ_SUCCESS) {
+	PJ_LOG(4,(ws->base.obj_name, "WS connection upgraded"));
+	ws->upgraded = PJ_TRUE;
+	ws_schedule_timer(ws, ws_ka_delay());
+    }
+
+    *p_status = ws_sock_send(ws, &ws->hs_op_key.key, ws->hs_buf, &resp_len);
+    if (status != PJ_SUCCESS) {
+	/* Close after the error response has been flushed. */
+	if (*p_status != PJ_EPENDING)
+	    *p_status = status;
+	else
+	    *p_status = PJ_EPENDING;
+    } else if (*p_status == PJ_EPENDING) {
+	*p_status = PJ_SUCCESS;
+    }
+
+    return req.slen;
+}
+
+
+/* Unmask len bytes from src into dst. Since frames are compacted towards
+ * the start of the same buffer, dst is always at least the masking key
+ * size (4 bytes) before src, so reading and writing a 32bit word at a time
+ * never overwrites data not yet read.
+ */
+static void ws_unmask(pj_uint8_t *dst, const pj_uint8_t *src,
+		      pj_size_t len, const pj_uint8_t mask[4])
+{
+    pj_uint32_t mask32, w;
+    pj_size_t i = 0;
+
+    pj_memcpy(&mask32, mask, 4);
+    for (; i + 4 <= len; i += 4) {
+	pj_memcpy(&w, src + i, 4);
+	w ^= mask32;
+	pj_memcpy(dst + i, &w, 4);
+    }
+    for (; i < len; ++i)
+	dst[i] = (pj_uint8_t)(src[i] ^ mask[i & 3]);
+}
+
+/*
+ * Parse frames in buf. Payload of data frames is unmasked straight into
+ * its final position at the front of the buffer, so a complete SIP message
+ * can be handed over to the transport manager without any further copy.
+ * Returns the number of bytes to keep in the buffer, or -1 if the
+ * connection must be closed.
+ */
+static pj_ssize_t ws_process_frames(struct ws_transport *ws, char *buf,
+				    pj_size_t size)
+{
+    const pj_size_t capacity = sizeof(ws->rdata.pkt_info.packet) - 1;
+    pj_size_t pos = ws->msg_len;
+
+    while (size - pos >= 2) {
+	pj_uint8_t *p = (pj_uint8_t*)buf + pos;
+	pj_bool_t fin = (p[0] & 0x80) != 0;
+	unsigned opcode = p[0] & 0x0F;
+	pj_uint64_t plen = p[1] & 0x7F;
+	pj_size_t hdr_len = 2;
+
+	/* No extension is negotiated, and client frames must be masked */
+	if ((p[0] & 0x70) || (p[1] & 0x80) == 0) {
+	    PJ_LOG(3,(ws->base.obj_name, "Invalid WS frame header"));
+	    ws_send_close(ws, WS_CLOSE_PROTOCOL_ERR);
+	    return -1;
+	}
+
+	if (plen == 126) {
+	    if (size - pos < 4) break;
+	    plen = (p[2] << 8) | p[3];
+	    hdr_len = 4;
+	} else if (plen == 127) {
+	    unsigned i;
+	    if (size - pos < 10) break;
+	    plen = 0;
+	    for (i=2; i<10; ++i)
+		plen = (plen << 8) | p[i];
+	    hdr_len = 10;
+	}
+	hdr_len += 4;
+
+	if (opcode >= WS_OP_CLOSE) {
+	    /* Control frames must not be fragmented */
+	    if (!fin || plen > WS_MAX_CTL_PAYLOAD) {
+		ws_send_close(ws, WS_CLOSE_PROTOCOL_ERR);
+		return -1;
+	    }
+	} else if ((opcode == WS_OP_CONT) != (ws->in_message != 0)) {
+	    PJ_LOG(3,(ws->base.obj_name, "Unexpected WS frame opcode %d",
+		      opcode));
+	    ws_send_close(ws, WS_CLOSE_PROTOCOL_ERR);
+	    return -1;
+	}
+
+	/* The whole frame must fit in the buffer once it's compacted */
+	if (plen > capacity || ws->msg_len + hdr_len + plen > capacity) {
+	    PJ_LOG(3,(ws->base.obj_name, "WS message too big"));
+	    ws_send_close(ws, WS_CLOSE_TOO_BIG);
+	    return -1;
+	}
+
+	/* Wait for the rest of the frame */
+	if (size - pos < hdr_len + plen)
+	    break;
+
+	if (opcode >= WS_OP_CLOSE) {
+	    pj_uint8_t *payload = p + hdr_len;
+
+	    ws_unmask(payload, payload, (pj_size_t)plen, p + hdr_len - 4);
+	    pos += hdr_len + (pj_size_t)plen;
+
+	    if (opcode == WS_OP_PING) {
+		ws_send_ctl(ws, WS_OP_PONG, payload, (pj_size_t)plen);
+	    } else if (opcode == WS_OP_CLOSE) {
+		PJ_LOG(4,(ws->base.obj_name, "WS close frame received"));
+		ws_send_ctl(ws, WS_OP_CLOSE, payload, (plen >= 2 ? 2 : 0));
+		return -1;
+	    }
+	    continue;
+	}
+
+	/* Data frame */
+	ws_unmask((pj_uint8_t*)buf + ws->msg_len, p + hdr_len,
+		  (pj_size_t)plen, p + hdr_len - 4);
+	ws->msg_len += (pj_size_t)plen;
+	pos += hdr_len + (pj_size_t)plen;
+	ws->in_message = !fin;
+
+	if (fin) {
+	    pjsip_rx_data *rdata = &ws->rdata;
+
+	    /* The byte after the message belongs to a consumed frame
+	     * header, so the transport manager may NULL terminate it.
+	     */
+	    if (ws->msg_len > 0) {
+		rdata->pkt_info.len = ws->msg_len;
+		rdata->pkt_info.zero = 0;
+		pj_gettimeofday(&rdata->pkt_info.timestamp);
+
+		pjsip_tpmgr_receive_packet(rdata->tp_info.transport->tpmgr,
+					   rdata);
+
+		/* Reset pool. */
+		pj_pool_reset(rdata->tp_info.pool);
+	    }
+
+	    /* Move the following frames to the front of the buffer */
+	    size -= pos;
+	    if (size)
+		pj_memmove(buf, buf + pos, size);
+	    pos = 0;
+	    ws->msg_len = 0;
+
+	    if (ws->is_closing)
+		return -1;
+	}
+    }
+
+    /* Compact pending raw bytes right after the partial message */
+    if (pos != ws->msg_len) {
+	pj_memmove(buf + ws->msg_len, buf + pos, size - pos);
+	size = ws->msg_len + (size - pos);
+    }
+
+    return size;
+}
+
+
+/*
+ * Common handler for incoming data.
+ */
+static pj_bool_t ws_on_data_read(struct ws_transport *ws,
+				 void *data,
+				 pj_size_t size,
+				 pj_status_t status,
+				 pj_size_t *remainder)
+{
+    char *buf = (char*)data;
+    pj_ssize_t keep;
+
+    /* Don't do anything if transport is closing. */
+    if (ws->is_closing) {
+	ws->is_closing++;
+	return PJ_FALSE;
+    }
+
+    if (status != PJ_SUCCESS) {
+	/* Transport is closed */
+	PJ_LOG(4,(ws->base.obj_name, "WS connection closed"));
+	ws_init_shutdown(ws, status);
+	return PJ_FALSE;
+    }
+
+    pj_assert(buf == ws->rdata.pkt_info.packet);
+
+    /* Mark this as an activity */
+    pj_gettimeofday(&ws->last_activity);
+    ws->last_rx = ws->last_activity;
+
+    if (!ws->upgraded) {
+	pj_size_t eaten;
+
+	eaten = ws_handle_upgrade(ws, buf, size, &status);
+	if (status == PJ_EPENDING) {
+	    /* Rejected, close once the response has been sent */
+	    *remainder = 0;
+	    return PJ_TRUE;
+	} else if (status != PJ_SUCCESS) {
+	    ws_init_shutdown(ws, status);
+	    return PJ_FALSE;
+	}
+
+	if (eaten == 0) {
+	    if (size >= sizeof(ws->rdata.pkt_info.packet) - 1) {
+		PJ_LOG(3,(ws->base.obj_name, "WS upgrade request too long"));
+		ws_init_shutdown(ws, PJSIP_ERXOVERFLOW);
+		return PJ_FALSE;
+	    }
+	    *remainder = size;
+	    return PJ_TRUE;
+	}
+
+	size -= eaten;
+	if (size)
+	    pj_memmove(buf, buf + eaten, size);
+	ws->msg_len = 0;
+	ws->in_message = PJ_FALSE;
+    }
+
+    keep = ws_process_frames(ws, buf, size);
+    if (keep < 0) {
+	ws_init_shutdown(ws, PJSIP_EINVALIDMSG);
+	return PJ_FALSE;
+    }
+
+    *remainder = keep;
+    return PJ_TRUE;
+}
+
+
+/* Active socket callbacks */
+static pj_bool_t asock_on_data_read(pj_activesock_t *asock,
+				    void *data,
+				    pj_size_t size,
+				    pj_status_t status,
+				    pj_size_t *remainder)
+{
+    struct ws_transport *ws;
+
+    ws = (struct ws_transport*) pj_activesock_get_user_data(asock);
+    return ws_on_data_read(ws, data, size, status, remainder);
+}
+
+static pj_bool_t asock_on_data_sent(pj_activesock_t *asock,
+				    pj_ioqueue_op_key_t *send_key,
+				    pj_ssize_t sent)
+{
+    struct ws_transport *ws;
+
+    ws = (struct ws_transport*) pj_activesock_get_user_data(asock);
+    return ws_on_data_sent(ws, send_key, sent);
+}
+
+#if WS_HAS_WSS
+/* SSL socket callbacks */
+static pj_bool_t ssock_on_data_read(pj_ssl_sock_t *ssock,
+				    void *data,
+				    pj_size_t size,
+				    pj_status_t status,
+				    pj_size_t *remainder)
+{
+    struct ws_transport *ws;
+
+    ws = (struct ws_transport*) pj_ssl_sock_get_user_data(ssock);
+    return ws_on_data_read(ws, data, size, status, remainder);
+}
+
+static pj_bool_t ssock_on_data_sent(pj_ssl_sock_t *ssock,
+				    pj_ioqueue_op_key_t *send_key,
+				    pj_ssize_t sent)
+{
+    struct ws_transport *ws;
+
+    ws = (struct ws_transport*) pj_ssl_sock_get_user_data(ssock);
+    return ws_on_data_sent(ws, send_key, sent);
+}
+#endif	/* WS_HAS_WSS */
+
+
+/* Transport keep-alive scheduler callback. Before the connection is
+ * upgraded this is the handshake timeout. Returns the number of seconds
+ * until the connection needs to be checked again.
+ */
+static long ws_keep_alive_cb(pjsip_tp_ka_entry *e)
+{
+    struct ws_transport *ws = (struct ws_transport*) e->user_data;
+    long interval = pjsip_cfg()->ws.keep_alive_interval;
+    long idle = pjsip_cfg()->ws.idle_timeout;
+    long next = 0;
+    pj_time_val now, elapsed;
+    pj_ssize_t size;
+    pj_status_t status;
+
+    if (ws->is_closing || ws->base.is_shutdown || ws->base.is_destroying)
+	return 0;
+
+    if (!ws->upgraded) {
+	PJ_LOG(4,(ws->base.obj_name, "WS opening handshake timed out"));
+	ws_init_shutdown(ws, PJ_ETIMEDOUT);
+	return 0;
+    }
+
+    pj_gettimeofday(&now);
+
+    /* Close the connection if nothing has been received for too long */
+    if (idle > 0) {
+	elapsed = now;
+	PJ_TIME_VAL_SUB(elapsed, ws->last_rx);
+
+	if (elapsed.sec >= idle) {
+	    PJ_LOG(4,(ws->base.obj_name, "Closing idle WS connection to "
+		      "%.*s:%d (%ld seconds without data)",
+		      (int)ws->base.remote_name.host.slen,
+		      ws->base.remote_name.host.ptr,
+		      ws->base.remote_name.port, elapsed.sec));
+	    ws_init_shutdown(ws, PJ_ETIMEDOUT);
+	    return 0;
+	}
+	next = idle - (elapsed.sec > 0 ? elapsed.sec : 0);
+    }
+
+    if (interval <= 0)
+	return next;
+
+    elapsed = now;
+    PJ_TIME_VAL_SUB(elapsed, ws->last_activity);
+
+    if (elapsed.sec >= 0 && elapsed.sec < interval) {
+	/* There has been activity, so don't send keep-alive */
+	long remaining = interval - elapsed.sec;
+	return (next > 0 && next < remaining) ? next : remaining;
+    }
+
+    if (!ws->ka_pending) {
+	PJ_LOG(5,(ws->base.obj_name, "Sending WS ping to %.*s:%d",
+		  (int)ws->base.remote_name.host.slen,
+		  ws->base.remote_name.host.ptr,
+		  ws->base.remote_name.port));
+
+	ws->ka_pending = PJ_TRUE;
+	size = sizeof(ws->ka_buf);
+	status = ws_sock_send(ws, &ws->ka_op_key.key, ws->ka_buf, &size);
+	if (status != PJ_EPENDING)
+	    ws->ka_pending = PJ_FALSE;
+
+	if (status != PJ_SUCCESS && status != PJ_EPENDING) {
+	    ws_perror(ws->base.obj_name,
+		      "Error sending keep-alive packet", status);
+	    ws_init_shutdown(ws, status);
+	    return 0;
+	}
+    }
+
+    /* Register next keep-alive */
+    return (next > 0 && next < interval) ? next : interval;
+}
+
+
+#endif	/* PJSIP_HAS_WS_TRANSPORT */
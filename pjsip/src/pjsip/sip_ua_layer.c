@@ -28,6 +28,7 @@
 #include <pj/assert.h>
 #include <pj/string.h>
 #include <pj/pool.h>
+#include <pj/slab.h>
 #include <pj/log.h>
 
 
@@ -44,6 +45,7 @@ static void	   mod_ua_on_tsx_state(pjsip_transaction*, pjsip_event*);
 
 
 extern long pjsip_dlg_lock_tls_id;	/* defined in sip_dialog.c */
+extern pj_slab_t *pjsip_dlg_slab;	/* defined in sip_dialog.c */
 
 /* This struct is used to represent list of dialog inside a dialog set.
  * We don't want to use pjsip_dialog for this purpose, to save some
@@ -118,11 +120,24 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
     if (mod_ua.pool == NULL)
 	return PJ_ENOMEM;
 
-    status = pj_mutex_create_recursive(mod_ua.pool, " ua%p", &mod_ua.mutex);
+    status = pj_slab_create(mod_ua.pool->factory, "dlgslab%p",
+			    sizeof(pjsip_dialog), 0, &pjsip_dlg_slab);
     if (status != PJ_SUCCESS)
 	return status;
 
+    status = pj_mutex_create_recursive(mod_ua.pool, " ua%p", &mod_ua.mutex);
+    if (status != PJ_SUCCESS) {
+	pj_slab_destroy(pjsip_dlg_slab);
+	pjsip_dlg_slab = NULL;
+	return status;
+    }
+
+#if PJSIP_HTABLE_RESIZABLE
+    mod_ua.dlg_table = pj_hash_create_resizable(mod_ua.pool,
+						PJSIP_MAX_DIALOG_COUNT);
+#else
     mod_ua.dlg_table = pj_hash_create(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT);
+#endif
     if (mod_ua.dlg_table == NULL)
 	return PJ_ENOMEM;
 
@@ -149,6 +164,12 @@ static pj_status_t mod_ua_unload(void)
     pj_thread_local_free(pjsip_dlg_lock_tls_id);
     pj_mutex_destroy(mod_ua.mutex);
 
+    /* Dialogs which are still alive keep the slab until destroyed */
+    if (pjsip_dlg_slab) {
+	pj_slab_destroy(pjsip_dlg_slab);
+	pjsip_dlg_slab = NULL;
+    }
+
     /* Release pool */
     if (mod_ua.pool) {
 	pjsip_endpt_release_pool( mod_ua.endpt, mod_ua.pool );
@@ -952,6 +973,7 @@ PJ_DEF(void) pjsip_ua_dump(pj_bool_t detail)
 {
 #if PJ_LOG_MAX_LEVEL >= 3
     pj_hash_iterator_t itbuf, *it;
+    pj_slab_stat slab_stat;
     char dlginfo[128];
 
     pj_mutex_lock(mod_ua.mutex);
@@ -959,6 +981,13 @@ PJ_DEF(void) pjsip_ua_dump(pj_bool_t detail)
     PJ_LOG(3, (THIS_FILE, "Number of dialog sets: %u", 
 			  pj_hash_count(mod_ua.dlg_table)));
 
+    pj_slab_get_stat(pjsip_dlg_slab, &slab_stat);
+    PJ_LOG(3, (THIS_FILE, "Dialog slab: %u objects of %u bytes in use "
+			  "(peak %u), capacity %u, %u bytes",
+			  slab_stat.in_use, (unsigned)slab_stat.obj_size,
+			  slab_stat.peak, slab_stat.capacity,
+			  (unsigned)slab_stat.mem_used));
+
     if (detail && pj_hash_count(mod_ua.dlg_table)) {
 	PJ_LOG(3, (THIS_FILE, "Dumping dialog sets:"));
 	it = pj_hash_first(mod_ua.dlg_table, &itbuf);
@@ -226,7 +226,7 @@ static void init_request_throw( pjsip_endpoint *endpt,
 
     /* Add From header. */
     if (param_from->tag.slen == 0)
-	pj_create_unique_string(tdata->pool, &param_from->tag);
+	pj_create_unique_string_fast(tdata->pool, &param_from->tag);
     pjsip_msg_add_hdr(msg, (pjsip_hdr*)param_from);
 
     /* Add To header. */
@@ -335,7 +335,7 @@ PJ_DEF(pj_status_t) pjsip_endpt_create_request(  pjsip_endpoint *endpt,
 	    status = PJSIP_EINVALIDHDR;
 	    goto on_error;
 	}
-	pj_create_unique_string(tdata->pool, &from->tag);
+	pj_create_unique_string_fast(tdata->pool, &from->tag);
 
 	/* To */
 	to = pjsip_to_hdr_create(tdata->pool);
@@ -1210,7 +1210,7 @@ static void stateless_send_transport_cb( void *token,
 		      PJSIP_RFC3261_BRANCH_LEN);
 	    tmp.ptr = via->branch_param.ptr + PJSIP_RFC3261_BRANCH_LEN + 2;
 	    *(tmp.ptr-2) = 80; *(tmp.ptr-1) = 106;
-	    pj_generate_unique_string(&tmp);
+	    pj_generate_unique_string_fast(&tmp);
 	}
 
 	/* For CANCEL request, do not update the Via header since it needs
@@ -359,7 +359,7 @@ PJ_DEF(pj_str_t) pjsip_calculate_branch_id( pjsip_rx_data *rdata )
 	tmp.ptr = branch.ptr + PJSIP_RFC3261_BRANCH_LEN + 2;
 	*(tmp.ptr-2) = (pj_int8_t)(branch.slen+73); 
 	*(tmp.ptr-1) = (pj_int8_t)(branch.slen+99);
-	pj_generate_unique_string( &tmp );
+	pj_generate_unique_string_fast( &tmp );
 
 	branch.slen = PJSIP_MAX_BRANCH_LEN;
 	return branch;
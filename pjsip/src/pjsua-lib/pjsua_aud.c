@@ -361,6 +361,42 @@ pj_status_t pjsua_aud_subsys_init()
     pjsua_var.is_mswitch = pjmedia_conf_get_master_port(pjsua_var.mconf)
 			    ->info.signature == PJMEDIA_CONF_SWITCH_SIGNATURE;
 
+    /* Spread the processing of the bridge ports to worker threads */
+    if (pjsua_var.media_cfg.conf_mix_threads) {
+	pj_status_t st;
+
+	st = pjmedia_conf_set_mix_threads(pjsua_var.mconf,
+					  pjsua_var.media_cfg.conf_mix_threads);
+	if (st != PJ_SUCCESS) {
+	    pjsua_perror(THIS_FILE, "Unable to set conference bridge "
+			 "mixing threads", st);
+	}
+    }
+
+    /* Only mix the active speakers */
+    if (pjsua_var.media_cfg.conf_active_speakers) {
+	pj_status_t st;
+
+	st = pjmedia_conf_set_active_speakers(pjsua_var.mconf,
+				    pjsua_var.media_cfg.conf_active_speakers);
+	if (st != PJ_SUCCESS) {
+	    pjsua_perror(THIS_FILE, "Unable to set conference bridge "
+			 "active speakers", st);
+	}
+    }
+
+    /* Let the streams encode the same audio only once */
+    if (pjsua_var.media_cfg.conf_shared_encoding) {
+	pj_status_t st;
+
+	st = pjmedia_stream_enc_group_create(pjsua_var.med_endpt,
+					     &pjsua_var.enc_grp);
+	if (st != PJ_SUCCESS) {
+	    pjsua_perror(THIS_FILE, "Unable to create shared encoding group",
+			 st);
+	}
+    }
+
     /* Create null port just in case user wants to use null sound. */
     status = pjmedia_null_port_create(pjsua_var.pool,
 				      pjsua_var.media_cfg.clock_rate,
@@ -471,6 +507,11 @@ pj_status_t pjsua_aud_subsys_destroy()
 	pjsua_var.mconf = NULL;
     }
 
+    if (pjsua_var.enc_grp) {
+	pjmedia_stream_enc_group_destroy(pjsua_var.enc_grp);
+	pjsua_var.enc_grp = NULL;
+    }
+
     if (pjsua_var.null_port) {
 	pjmedia_port_destroy(pjsua_var.null_port);
 	pjsua_var.null_port = NULL;
@@ -602,6 +643,7 @@ pj_status_t pjsua_aud_channel_update(pjsua_call_media *call_med,
 	si->jb_min_pre = pjsua_var.media_cfg.jb_min_pre;
 	si->jb_max_pre = pjsua_var.media_cfg.jb_max_pre;
 	si->jb_max = pjsua_var.media_cfg.jb_max;
+	si->jb_time_scale = pjsua_var.media_cfg.jb_time_scale;
 
 	/* Set SSRC and CNAME */
 	si->ssrc = call_med->ssrc;
@@ -629,6 +671,16 @@ pj_status_t pjsua_aud_channel_update(pjsua_call_media *call_med,
 	    goto on_return;
 	}
 
+	/* Share the encoder with the other streams sending the same audio */
+	if (pjsua_var.enc_grp && (si->dir & PJMEDIA_DIR_ENCODING)) {
+	    status = pjmedia_stream_set_enc_group(call_med->strm.a.stream,
+						  pjsua_var.enc_grp);
+	    if (status != PJ_SUCCESS) {
+		pjsua_perror(THIS_FILE, "Unable to join shared encoding group",
+			     status);
+	    }
+	}
+
 	/* Start stream */
 	status = pjmedia_stream_start(call_med->strm.a.stream);
 	if (status != PJ_SUCCESS) {
@@ -805,14 +857,44 @@ PJ_DEF(pj_status_t) pjsua_conf_add_port( pj_pool_t *pool,
 }
 
 
+/* Wakes up pjsua_conf_remove_port() */
+static void conf_port_removed(pjmedia_conf *conf, unsigned slot,
+			      void *user_data)
+{
+    PJ_UNUSED_ARG(conf);
+    PJ_UNUSED_ARG(slot);
+
+    pj_sem_post((pj_sem_t*)user_data);
+}
+
 /*
  * Remove arbitrary slot from the conference bridge.
  */
 PJ_DEF(pj_status_t) pjsua_conf_remove_port(pjsua_conf_port_id id)
 {
+    pj_pool_t *pool;
+    pj_sem_t *sem = NULL;
     pj_status_t status;
 
-    status = pjmedia_conf_remove_port(pjsua_var.mconf, (unsigned)id);
+    /* The caller may destroy the port when this returns, so wait for the
+     * bridge to release it if it is busy mixing.
+     */
+    pool = pjsua_pool_create("rmport%p", 256, 256);
+    if (pool == NULL)
+	return PJ_ENOMEM;
+
+    status = pj_sem_create(pool, NULL, 0, 1, &sem);
+    if (status == PJ_SUCCESS) {
+	status = pjmedia_conf_remove_port2(pjsua_var.mconf, (unsigned)id,
+					   sem, &conf_port_removed);
+	if (status == PJ_EPENDING) {
+	    pj_sem_wait(sem);
+	    status = PJ_SUCCESS;
+	}
+	pj_sem_destroy(sem);
+    }
+    pj_pool_release(pool);
+
     pjsua_check_snd_dev_idle();
 
     return status;
@@ -1302,6 +1384,27 @@ PJ_DEF(pj_status_t) pjsua_player_set_pos( pjsua_player_id id,
 }
 
 
+/* A player being removed from the bridge, allocated from its pool */
+typedef struct removed_player
+{
+    pjmedia_port    *port;
+    pj_pool_t	    *pool;
+} removed_player;
+
+/* Destroy the player when the bridge has released it */
+static void player_removed(pjmedia_conf *conf, unsigned slot,
+			   void *user_data)
+{
+    removed_player *rp = (removed_player*)user_data;
+    pj_pool_t *pool = rp->pool;
+
+    PJ_UNUSED_ARG(conf);
+    PJ_UNUSED_ARG(slot);
+
+    pjmedia_port_destroy(rp->port);
+    pj_pool_release(pool);
+}
+
 /*
  * Close the file, remove the player from the bridge, and free
  * resources associated with the file player.
@@ -1317,11 +1420,23 @@ PJ_DEF(pj_status_t) pjsua_player_destroy(pjsua_player_id id)
     PJSUA_LOCK();
 
     if (pjsua_var.player[id].port) {
-	pjsua_conf_remove_port(pjsua_var.player[id].slot);
-	pjmedia_port_destroy(pjsua_var.player[id].port);
+	removed_player *rp;
+
+	/* The player is destroyed once the bridge has released it */
+	rp = PJ_POOL_ALLOC_T(pjsua_var.player[id].pool, removed_player);
+	rp->port = pjsua_var.player[id].port;
+	rp->pool = pjsua_var.player[id].pool;
+	if (pjmedia_conf_remove_port2(pjsua_var.mconf,
+				      pjsua_var.player[id].slot, rp,
+				      &player_removed) == PJ_EINVAL)
+	{
+	    /* Not in the bridge */
+	    player_removed(pjsua_var.mconf, 0, rp);
+	}
+	pjsua_check_snd_dev_idle();
+
 	pjsua_var.player[id].port = NULL;
 	pjsua_var.player[id].slot = 0xFFFF;
-	pj_pool_release(pjsua_var.player[id].pool);
 	pjsua_var.player[id].pool = NULL;
 	pjsua_var.player_cnt--;
     }
@@ -2113,6 +2228,29 @@ PJ_DEF(pj_status_t) pjsua_get_snd_dev(int *capture_dev,
 }
 
 
+/* Apply the clock thread config to the media clock */
+static void set_clock_thread_cfg(pjmedia_clock *clock)
+{
+    const pjsua_thread_cfg *cfg = &pjsua_var.media_cfg.clock_thread_cfg;
+    unsigned cpu[64];
+    unsigned cnt;
+    pj_status_t status;
+
+    cnt = pjsua_thread_cfg_get_cpus(cfg, 0, PJ_ARRAY_SIZE(cpu), cpu);
+    if (cnt) {
+	status = pjmedia_clock_set_thread_affinity(clock, cnt, cpu);
+	if (status != PJ_SUCCESS)
+	    pjsua_perror(THIS_FILE, "Unable to set clock affinity", status);
+    }
+
+    if (cfg->sched_policy != PJ_THREAD_SCHED_DEFAULT) {
+	status = pjmedia_clock_set_thread_sched(clock, cfg->sched_policy,
+						cfg->sched_prio);
+	if (status != PJ_SUCCESS)
+	    pjsua_perror(THIS_FILE, "Unable to set clock scheduling", status);
+    }
+}
+
 /*
  * Use null sound device.
  */
@@ -2160,6 +2298,9 @@ PJ_DEF(pj_status_t) pjsua_set_null_snd_dev(void)
 	return status;
     }
 
+    /* Place the clock thread */
+    set_clock_thread_cfg(pjmedia_master_port_get_clock(pjsua_var.null_snd));
+
     /* Start the master port */
     status = pjmedia_master_port_start(pjsua_var.null_snd);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
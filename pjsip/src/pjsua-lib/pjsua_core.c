@@ -98,6 +98,13 @@ PJ_DEF(void) pjsua_logging_config_dup(pj_pool_t *pool,
     pj_strdup_with_null(pool, &dst->log_filename, &src->log_filename);
 }
 
+PJ_DEF(void) pjsua_thread_cfg_default(pjsua_thread_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->numa_node = -1;
+    cfg->sched_policy = PJ_THREAD_SCHED_DEFAULT;
+}
+
 PJ_DEF(void) pjsua_config_default(pjsua_config *cfg)
 {
     pj_bzero(cfg, sizeof(*cfg));
@@ -115,6 +122,7 @@ PJ_DEF(void) pjsua_config_default(pjsua_config *cfg)
     cfg->use_timer = PJSUA_SIP_TIMER_OPTIONAL;
     pjsip_timer_setting_default(&cfg->timer_setting);
     pjsua_srtp_opt_default(&cfg->srtp_opt);
+    pjsua_thread_cfg_default(&cfg->thread_cfg);
 }
 
 PJ_DEF(void) pjsua_config_dup(pj_pool_t *pool,
@@ -364,6 +372,9 @@ PJ_DEF(void) pjsua_media_config_default(pjsua_media_config *cfg)
 
     cfg->turn_conn_type = PJ_TURN_TP_UDP;
     cfg->vid_preview_enable_native = PJ_TRUE;
+
+    pjsua_thread_cfg_default(&cfg->thread_cfg);
+    pjsua_thread_cfg_default(&cfg->clock_thread_cfg);
 }
 
 /*****************************************************************************
@@ -663,6 +674,7 @@ PJ_DEF(pj_status_t) pjsua_reconfigure_logging(const pjsua_logging_config *cfg)
 
     /* Close existing file, if any */
     if (pjsua_var.log_file) {
+	pj_log_async_flush();
 	pj_file_close(pjsua_var.log_file);
 	pjsua_var.log_file = NULL;
     }
@@ -682,6 +694,16 @@ PJ_DEF(pj_status_t) pjsua_reconfigure_logging(const pjsua_logging_config *cfg)
 	}
     }
 
+    /* Start writing log from background thread */
+    if (pjsua_var.log_cfg.async) {
+	status = pj_log_async_start(&pjsua_var.cp.factory, NULL);
+	if (status != PJ_SUCCESS && status != PJ_EEXISTS) {
+	    pjsua_perror(THIS_FILE, "Error starting asynchronous logging",
+			 status);
+	    return status;
+	}
+    }
+
     /* Unregister msg logging if it's previously registered */
     if (pjsua_msg_logger.id >= 0) {
 	pjsip_endpt_unregister_module(pjsua_var.endpt, &pjsua_msg_logger);
@@ -759,6 +781,62 @@ static int worker_thread_ioqueue(void *arg)
 }
 
 
+/*
+ * Get the CPUs of the idx-th thread of a thread group.
+ */
+unsigned pjsua_thread_cfg_get_cpus(const pjsua_thread_cfg *cfg, unsigned idx,
+				   unsigned max_cnt, unsigned cpu[])
+{
+    if (cfg->cpu_cnt) {
+	cpu[0] = cfg->cpu[idx % cfg->cpu_cnt];
+	return 1;
+    }
+
+    if (cfg->numa_node >= 0) {
+	unsigned cnt = max_cnt;
+	pj_status_t status;
+
+	status = pj_get_numa_node_cpus(cfg->numa_node, &cnt, cpu);
+	if (status != PJ_SUCCESS) {
+	    pjsua_perror(THIS_FILE, "Unable to get the CPUs of NUMA node",
+			 status);
+	    return 0;
+	}
+	return cnt;
+    }
+
+    return 0;
+}
+
+/*
+ * Apply the thread config to the idx-th thread of a thread group.
+ */
+void pjsua_apply_thread_cfg(const pjsua_thread_cfg *cfg, unsigned idx,
+			    pj_thread_t *thread)
+{
+    unsigned cpu[64];
+    unsigned cnt;
+    pj_status_t status;
+
+    cnt = pjsua_thread_cfg_get_cpus(cfg, idx, PJ_ARRAY_SIZE(cpu), cpu);
+    if (cnt) {
+	status = pj_thread_set_affinity(thread, cnt, cpu);
+	if (status != PJ_SUCCESS) {
+	    pjsua_perror(THIS_FILE, "Unable to set thread affinity", status);
+	} else {
+	    PJ_LOG(4,(THIS_FILE, "Thread %s pinned to %u CPU(s) starting "
+		      "at CPU %u", pj_thread_get_name(thread), cnt, cpu[0]));
+	}
+    }
+
+    if (cfg->sched_policy != PJ_THREAD_SCHED_DEFAULT) {
+	status = pj_thread_set_sched(thread, cfg->sched_policy,
+				     cfg->sched_prio);
+	if (status != PJ_SUCCESS)
+	    pjsua_perror(THIS_FILE, "Unable to set thread scheduling", status);
+    }
+}
+
 PJ_DEF(void) pjsua_stop_worker_threads(void)
 {
     unsigned i;
@@ -1187,6 +1265,9 @@ PJ_DEF(pj_status_t) pjsua_init( const pjsua_config *ua_cfg,
 #endif
 	    if (status != PJ_SUCCESS)
 		goto on_error;
+
+	    pjsua_apply_thread_cfg(&pjsua_var.ua_cfg.thread_cfg, ii,
+				   pjsua_var.thread[ii]);
 	}
 	PJ_LOG(4,(THIS_FILE, "%d SIP worker threads created", 
 		  pjsua_var.ua_cfg.thread_cnt));
@@ -1941,6 +2022,9 @@ PJ_DEF(pj_status_t) pjsua_destroy2(unsigned flags)
         pjsua_var.timer_mutex = NULL;
     }
 
+    /* Write the queued log messages and stop the log writer thread */
+    pj_log_async_stop();
+
     /* Destroy pool and pool factory. */
     if (pjsua_var.pool) {
 	pj_pool_release(pjsua_var.pool);
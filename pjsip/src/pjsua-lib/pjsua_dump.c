@@ -987,6 +987,34 @@ PJ_DEF(pj_status_t) pjsua_call_dump( pjsua_call_id call_id,
 	*p = '\0';
     }
 
+    /* Print SIP memory usage. The dialog object lives in the dialog slab,
+     * the rest in the dialog and invite session pools.
+     */
+    if (dlg->pool) {
+	pj_size_t dlg_pool = pj_pool_get_capacity(dlg->pool);
+	pj_size_t inv_pool = 0;
+
+	if (call->inv && call->inv->pool_prov)
+	    inv_pool += pj_pool_get_capacity(call->inv->pool_prov);
+	if (call->inv && call->inv->pool_active)
+	    inv_pool += pj_pool_get_capacity(call->inv->pool_active);
+
+	len = pj_ansi_snprintf(p, end-p,
+			       "%s  SIP memory: %u bytes (dialog object %u, "
+			       "dialog pool %u, invite pools %u)",
+			       indent,
+			       (unsigned)(sizeof(pjsip_dialog) + dlg_pool +
+					  inv_pool),
+			       (unsigned)sizeof(pjsip_dialog),
+			       (unsigned)dlg_pool, (unsigned)inv_pool);
+
+	if (len > 0 && len < end-p) {
+	    p += len;
+	    *p++ = '\n';
+	    *p = '\0';
+	}
+    }
+
     /* Dump session statistics */
     if (with_media)
 	dump_media_session(indent, p, (unsigned)(end-p), call);
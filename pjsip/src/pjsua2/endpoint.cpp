@@ -347,6 +347,7 @@ void MediaConfig::fromPj(const pjsua_media_config &mc)
     this->jbMinPre = mc.jb_min_pre;
     this->jbMaxPre = mc.jb_max_pre;
     this->jbMax = mc.jb_max;
+    this->jbTimeScale = PJ2BOOL(mc.jb_time_scale);
     this->sndAutoCloseTime = mc.snd_auto_close_time;
     this->vidPreviewEnableNative = PJ2BOOL(mc.vid_preview_enable_native);
 }
@@ -378,6 +379,7 @@ pjsua_media_config MediaConfig::toPj() const
     mcfg.jb_min_pre = this->jbMinPre;
     mcfg.jb_max_pre = this->jbMaxPre;
     mcfg.jb_max = this->jbMax;
+    mcfg.jb_time_scale = this->jbTimeScale;
     mcfg.snd_auto_close_time = this->sndAutoCloseTime;
     mcfg.vid_preview_enable_native = this->vidPreviewEnableNative;
 
@@ -409,6 +411,7 @@ void MediaConfig::readObject(const ContainerNode &node) throw(Error)
     NODE_READ_INT     ( this_node, jbMinPre);
     NODE_READ_INT     ( this_node, jbMaxPre);
     NODE_READ_INT     ( this_node, jbMax);
+    NODE_READ_BOOL    ( this_node, jbTimeScale);
     NODE_READ_INT     ( this_node, sndAutoCloseTime);
     NODE_READ_BOOL    ( this_node, vidPreviewEnableNative);
 }
@@ -438,6 +441,7 @@ void MediaConfig::writeObject(ContainerNode &node) const throw(Error)
     NODE_WRITE_INT     ( this_node, jbMinPre);
     NODE_WRITE_INT     ( this_node, jbMaxPre);
     NODE_WRITE_INT     ( this_node, jbMax);
+    NODE_WRITE_BOOL    ( this_node, jbTimeScale);
     NODE_WRITE_INT     ( this_node, sndAutoCloseTime);
     NODE_WRITE_BOOL    ( this_node, vidPreviewEnableNative);
 }
@@ -0,0 +1,230 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include <pjsip.h>
+#include <pjlib-util.h>
+#include <pjlib.h>
+
+#define THIS_FILE   "capture_test.c"
+#define PCAP_FILE   "capture_test.pcap"
+
+
+/* Send stateless request to ourself */
+static int send_request(const pjsip_method *method, int port)
+{
+    char target_buf[64];
+    pj_str_t target, from;
+    pjsip_tx_data *tdata;
+    pj_status_t status;
+
+    pj_ansi_snprintf(target_buf, sizeof(target_buf),
+		     "sip:capture@127.0.0.1:%d", port);
+    target = pj_str(target_buf);
+    from = pj_str("<sip:capture_test@127.0.0.1>");
+
+    status = pjsip_endpt_create_request(endpt, method, &target, &from,
+					&target, NULL, NULL, -1, NULL, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to create request", status);
+	return -10;
+    }
+
+    status = pjsip_endpt_send_request_stateless(endpt, tdata, NULL, NULL);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to send request", status);
+	return -20;
+    }
+
+    return 0;
+}
+
+/* Send a request from a thread which exits afterwards */
+static int sender_thread(void *arg)
+{
+    return send_request(&pjsip_options_method, *(int*)arg);
+}
+
+static int send_from_thread(int port)
+{
+    pj_pool_t *pool;
+    pj_thread_t *thread;
+    pj_status_t status;
+
+    pool = pjsip_endpt_create_pool(endpt, "capthread", 512, 512);
+    status = pj_thread_create(pool, "capthread", &sender_thread, &port,
+			      0, 0, &thread);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to create thread", status);
+	pjsip_endpt_release_pool(endpt, pool);
+	return -100;
+    }
+
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+    pjsip_endpt_release_pool(endpt, pool);
+    return 0;
+}
+
+/* Read the packets back from the PCAP file */
+static int check_pcap(unsigned expected)
+{
+    pj_pool_t *pool;
+    pj_pcap_file *file;
+    pj_uint8_t pkt[PJSIP_MAX_PKT_LEN+1];
+    pj_size_t len;
+    unsigned cnt = 0;
+    pj_status_t status;
+    int rc = 0;
+
+    pool = pjsip_endpt_create_pool(endpt, "capture", 512, 512);
+    status = pj_pcap_open(pool, PCAP_FILE, &file);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to open pcap file", status);
+	pjsip_endpt_release_pool(endpt, pool);
+	return -200;
+    }
+
+    for (;;) {
+	len = sizeof(pkt) - 1;
+	status = pj_pcap_read_udp(file, NULL, pkt, &len);
+	if (status != PJ_SUCCESS)
+	    break;
+
+	pkt[len] = '\0';
+	if (strstr((char*)pkt, "OPTIONS") == NULL) {
+	    PJ_LOG(3,(THIS_FILE, "   error: unexpected packet in pcap"));
+	    rc = -210;
+	    break;
+	}
+	++cnt;
+    }
+
+    if (rc == 0 && cnt != expected) {
+	PJ_LOG(3,(THIS_FILE, "   error: expecting %u packets in pcap, got %u",
+		  expected, cnt));
+	rc = -220;
+    }
+
+    pj_pcap_close(file);
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
+
+int capture_test(void)
+{
+    pjsip_transport *udp;
+    pjsip_capture_cfg cfg;
+    pjsip_capture *cap, *cap2;
+    pjsip_capture_stat stat;
+    pj_status_t status;
+    int port, rc;
+
+    PJ_LOG(3,(THIS_FILE, "  capture test"));
+
+    status = pjsip_udp_transport_start(endpt, NULL, NULL, 1, &udp);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to start UDP transport", status);
+	return -10;
+    }
+    port = udp->local_name.port;
+
+    pjsip_capture_cfg_default(&cfg);
+    cfg.pcap_file = pj_str(PCAP_FILE);
+
+    /* Invalid filters must be rejected */
+    cfg.filter = pj_str("method");
+    if (pjsip_capture_create(endpt, &cfg, &cap) != PJ_EINVAL) {
+	rc = -20;
+	goto on_return;
+    }
+    cfg.filter = pj_str("tp=foo");
+    if (pjsip_capture_create(endpt, &cfg, &cap) != PJ_EINVAL) {
+	rc = -30;
+	goto on_return;
+    }
+
+    cfg.filter = pj_str("method=OPTIONS dir=tx,rx !port=1");
+    status = pjsip_capture_create(endpt, &cfg, &cap);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to start capture", status);
+	rc = -40;
+	goto on_return;
+    }
+
+    /* Only one capture at a time */
+    if (pjsip_capture_create(endpt, &cfg, &cap2) != PJ_EEXISTS) {
+	pjsip_capture_destroy(cap);
+	rc = -50;
+	goto on_return;
+    }
+
+    /* One OPTIONS request out and in, and a MESSAGE which is filtered out.
+     * Nobody handles the requests, so no response is sent.
+     */
+    rc = send_request(&pjsip_options_method, port);
+    if (rc == 0) {
+	pjsip_method message;
+	pj_str_t name = pj_str("MESSAGE");
+
+	pjsip_method_init_np(&message, &name);
+	rc = send_request(&message, port);
+    }
+    flush_events(500);
+
+    /* Requests sent by threads which have exited. The ring of the first
+     * thread is drained and reused by the second thread, so only the
+     * ring of this thread is left in the end.
+     */
+    if (rc == 0)
+	rc = send_from_thread(port);
+    flush_events(500);
+    if (rc == 0)
+	rc = send_from_thread(port);
+    flush_events(500);
+
+    pjsip_capture_get_stat(cap, &stat);
+    pjsip_capture_destroy(cap);
+    if (rc != 0)
+	goto on_return;
+
+    if (stat.captured != 6 || stat.dropped != 0) {
+	PJ_LOG(3,(THIS_FILE, "   error: captured=%u dropped=%u",
+		  stat.captured, stat.dropped));
+	rc = -60;
+	goto on_return;
+    }
+
+    if (stat.rings != 1) {
+	PJ_LOG(3,(THIS_FILE, "   error: expecting 1 ring in use, got %u",
+		  stat.rings));
+	rc = -70;
+	goto on_return;
+    }
+
+    rc = check_pcap(stat.captured);
+
+on_return:
+    pj_file_delete(PCAP_FILE);
+    pjsip_transport_dec_ref(udp);
+    pjsip_transport_destroy(udp);
+    flush_events(500);
+    return rc;
+}
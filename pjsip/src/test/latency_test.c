@@ -0,0 +1,229 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include <pjsip.h>
+#include <pjlib.h>
+
+#define THIS_FILE   "latency_test.c"
+
+
+/* Values below PJSIP_LAT_HIST_SUB_CNT have a bucket each */
+static int small_values_test(void)
+{
+    pjsip_lat_hist h;
+    pj_uint32_t v;
+
+    pj_bzero(&h, sizeof(h));
+    if (pjsip_lat_hist_percentile(&h, 50) != 0)
+	return -10;
+
+    for (v=0; v<PJSIP_LAT_HIST_SUB_CNT; ++v)
+	pjsip_lat_hist_add(&h, v);
+
+    if (h.count != PJSIP_LAT_HIST_SUB_CNT || h.min != 0 ||
+	h.max != PJSIP_LAT_HIST_SUB_CNT-1 ||
+	h.total != PJSIP_LAT_HIST_SUB_CNT * (PJSIP_LAT_HIST_SUB_CNT-1) / 2)
+    {
+	return -20;
+    }
+
+    for (v=0; v<PJSIP_LAT_HIST_SUB_CNT; ++v) {
+	if (h.bucket[v] != 1) {
+	    PJ_LOG(3,(THIS_FILE, "   error: bucket %u has %u samples",
+		      v, h.bucket[v]));
+	    return -30;
+	}
+    }
+
+    /* Exact for these */
+    if (pjsip_lat_hist_percentile(&h, 50) != PJSIP_LAT_HIST_SUB_CNT/2 - 1 ||
+	pjsip_lat_hist_percentile(&h, 100) != PJSIP_LAT_HIST_SUB_CNT-1)
+    {
+	return -40;
+    }
+
+    return 0;
+}
+
+/* Larger values share a bucket with neighbours, percentiles report the
+ * upper bound of the bucket but never more than the largest sample.
+ */
+static int percentile_test(void)
+{
+    pjsip_lat_hist h;
+    pj_uint32_t p50, p90, p99;
+    unsigned i;
+
+    pj_bzero(&h, sizeof(h));
+
+    /* 100 usec falls into the 96-103 bucket, 1000 usec into 960-1023 */
+    for (i=0; i<90; ++i)
+	pjsip_lat_hist_add(&h, 100);
+    for (i=0; i<10; ++i)
+	pjsip_lat_hist_add(&h, 1000);
+
+    if (h.count != 100 || h.min != 100 || h.max != 1000 ||
+	h.total != 90*100 + 10*1000)
+    {
+	return -110;
+    }
+
+    if (h.bucket[36] != 90 || h.bucket[63] != 10) {
+	PJ_LOG(3,(THIS_FILE, "   error: buckets 36 and 63 have %u and %u "
+		  "samples, expecting 90 and 10",
+		  h.bucket[36], h.bucket[63]));
+	return -120;
+    }
+
+    p50 = pjsip_lat_hist_percentile(&h, 50);
+    p90 = pjsip_lat_hist_percentile(&h, 90);
+    p99 = pjsip_lat_hist_percentile(&h, 99);
+    if (p50 != 103 || p90 != 103 || p99 != 1000) {
+	PJ_LOG(3,(THIS_FILE, "   error: p50=%u p90=%u p99=%u, expecting "
+		  "103, 103 and 1000", p50, p90, p99));
+	return -130;
+    }
+
+    /* The 99th sample is now in the lower bucket */
+    pj_bzero(&h, sizeof(h));
+    for (i=0; i<99; ++i)
+	pjsip_lat_hist_add(&h, 100);
+    pjsip_lat_hist_add(&h, 1000);
+
+    if (pjsip_lat_hist_percentile(&h, 99) != 103 ||
+	pjsip_lat_hist_percentile(&h, 100) != 1000)
+    {
+	return -140;
+    }
+
+    return 0;
+}
+
+/* Values up to the full 32-bit range */
+static int overflow_test(void)
+{
+    pjsip_lat_hist h;
+
+    pj_bzero(&h, sizeof(h));
+
+    pjsip_lat_hist_add(&h, 0xFFFFFFFFUL);
+    pjsip_lat_hist_add(&h, 0xFFFFFFFFUL);
+    pjsip_lat_hist_add(&h, 0x80000000UL);
+
+    if (h.bucket[PJSIP_LAT_HIST_BUCKETS-1] != 2 ||
+	h.bucket[PJSIP_LAT_HIST_BUCKETS-PJSIP_LAT_HIST_SUB_CNT] != 1)
+    {
+	return -210;
+    }
+
+    /* The sum does not wrap */
+    if (h.total != (pj_uint64_t)0xFFFFFFFFUL * 2 + 0x80000000UL)
+	return -220;
+
+    if (pjsip_lat_hist_percentile(&h, 30) != 0x8FFFFFFFUL ||
+	pjsip_lat_hist_percentile(&h, 50) != 0xFFFFFFFFUL ||
+	pjsip_lat_hist_percentile(&h, 100) != 0xFFFFFFFFUL)
+    {
+	return -230;
+    }
+
+    return 0;
+}
+
+/* The library's histograms */
+static int record_test(void)
+{
+    pjsip_lat_hist h;
+
+    pjsip_lat_reset();
+
+    /* IPv6 shares the histogram of IPv4, unknown types are unspecified */
+    pjsip_lat_record(PJSIP_LAT_PARSE, PJSIP_TRANSPORT_UDP, 5);
+    pjsip_lat_record(PJSIP_LAT_PARSE, PJSIP_TRANSPORT_UDP6, 7);
+    pjsip_lat_record(PJSIP_LAT_TX, PJSIP_LAT_MAX_TP_TYPES + 1, 3);
+
+    if (pjsip_lat_get(PJSIP_LAT_PARSE, PJSIP_TRANSPORT_UDP, &h) !=
+	    PJ_SUCCESS ||
+	h.count != 2 || h.min != 5 || h.max != 7)
+    {
+	return -310;
+    }
+
+    if (pjsip_lat_get(PJSIP_LAT_TX, PJSIP_TRANSPORT_UNSPECIFIED, &h) !=
+	    PJ_SUCCESS ||
+	h.count != 1 || h.bucket[3] != 1)
+    {
+	return -320;
+    }
+
+    /* Out of range indexes */
+    pjsip_lat_record(PJSIP_LAT_TSX_CREATE, 2, 1);
+    if (pjsip_lat_get(PJSIP_LAT_TSX_CREATE, 2, &h) != PJ_EINVAL ||
+	pjsip_lat_get(PJSIP_LAT_MOD_RX_REQ, PJSIP_MAX_MODULE, &h) !=
+	    PJ_EINVAL)
+    {
+	return -330;
+    }
+
+    /* Reset clears everything */
+    pjsip_lat_reset();
+    if (pjsip_lat_get(PJSIP_LAT_PARSE, PJSIP_TRANSPORT_UDP, &h) !=
+	    PJ_SUCCESS ||
+	h.count != 0 || h.total != 0 || h.max != 0 ||
+	h.bucket[5] != 0 || h.bucket[7] != 0)
+    {
+	return -340;
+    }
+    if (pjsip_lat_get(PJSIP_LAT_TX, PJSIP_TRANSPORT_UNSPECIFIED, &h) !=
+	    PJ_SUCCESS || h.count != 0)
+    {
+	return -350;
+    }
+
+    return 0;
+}
+
+int latency_test(void)
+{
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "  small values"));
+    rc = small_values_test();
+    if (rc != 0)
+	return rc;
+
+    PJ_LOG(3,(THIS_FILE, "  percentiles"));
+    rc = percentile_test();
+    if (rc != 0)
+	return rc;
+
+    PJ_LOG(3,(THIS_FILE, "  32-bit range"));
+    rc = overflow_test();
+    if (rc != 0)
+	return rc;
+
+    PJ_LOG(3,(THIS_FILE, "  recording and reset"));
+    rc = record_test();
+    if (rc != 0)
+	return rc;
+
+    return 0;
+}
@@ -313,6 +313,10 @@ int test_main(void)
     DO_TEST(tsx_bench());
 #endif
 
+#if INCLUDE_LATENCY_TEST
+    DO_TEST(latency_test());
+#endif
+
 #if INCLUDE_UDP_TEST
     DO_TEST(transport_udp_test());
 #endif
@@ -325,6 +329,14 @@ int test_main(void)
     DO_TEST(transport_tcp_test());
 #endif
 
+#if INCLUDE_WS_TEST
+    DO_TEST(transport_ws_test());
+#endif
+
+#if INCLUDE_CAPTURE_TEST
+    DO_TEST(capture_test());
+#endif
+
 #if INCLUDE_RESOLVE_TEST
     DO_TEST(resolve_test());
 #endif
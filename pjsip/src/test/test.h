@@ -60,9 +60,12 @@ extern pj_caching_pool caching_pool;
 #define INCLUDE_MULTIPART_TEST	INCLUDE_MESSAGING_GROUP
 #define INCLUDE_TXDATA_TEST	INCLUDE_MESSAGING_GROUP
 #define INCLUDE_TSX_BENCH	INCLUDE_MESSAGING_GROUP
+#define INCLUDE_LATENCY_TEST	INCLUDE_MESSAGING_GROUP
 #define INCLUDE_UDP_TEST	INCLUDE_TRANSPORT_GROUP
 #define INCLUDE_LOOP_TEST	INCLUDE_TRANSPORT_GROUP
 #define INCLUDE_TCP_TEST	INCLUDE_TRANSPORT_GROUP
+#define INCLUDE_WS_TEST		INCLUDE_TRANSPORT_GROUP
+#define INCLUDE_CAPTURE_TEST	INCLUDE_TRANSPORT_GROUP
 #define INCLUDE_RESOLVE_TEST	INCLUDE_TRANSPORT_GROUP
 #define INCLUDE_TSX_TEST	INCLUDE_TSX_GROUP
 #define INCLUDE_TSX_DESTROY_TEST INCLUDE_TSX_GROUP
@@ -77,10 +80,13 @@ int msg_err_test(void);
 int multipart_test(void);
 int txdata_test(void);
 int tsx_bench(void);
+int latency_test(void);
 int tsx_destroy_test(void);
 int transport_udp_test(void);
 int transport_loop_test(void);
 int transport_tcp_test(void);
+int transport_ws_test(void);
+int capture_test(void);
 int resolve_test(void);
 int regc_test(void);
 
@@ -25,10 +25,168 @@
 #define THIS_FILE   "transport_tcp_test.c"
 
 
+#if PJ_HAS_TCP
+/*
+ * Check that the keep-alive scheduler closes connection which doesn't
+ * send anything within the idle timeout.
+ */
+static int tcp_idle_test(const pj_sockaddr_in *rem_addr)
+{
+    long old_idle = pjsip_cfg()->tcp.idle_timeout;
+    pj_sock_t sock;
+    pj_fd_set_t rset;
+    pj_time_val timeout = {0, 0};
+    char buf[16];
+    pj_ssize_t len;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "   idle connection reaping (3 seconds)"));
+
+    pjsip_cfg()->tcp.idle_timeout = 1;
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0, &sock);
+    if (status != PJ_SUCCESS) {
+	pjsip_cfg()->tcp.idle_timeout = old_idle;
+	return -100;
+    }
+
+    status = pj_sock_connect(sock, rem_addr, sizeof(*rem_addr));
+    if (status != PJ_SUCCESS) {
+	app_perror("   Error: connect() failed", status);
+	rc = -110;
+	goto on_return;
+    }
+
+    /* Nothing is sent, so the server must close the connection */
+    flush_events(3000);
+
+    PJ_FD_ZERO(&rset);
+    PJ_FD_SET(sock, &rset);
+    if (pj_sock_select((int)sock+1, &rset, NULL, NULL, &timeout) != 1) {
+	PJ_LOG(3,(THIS_FILE, "   error: idle connection is not closed"));
+	rc = -120;
+	goto on_return;
+    }
+
+    len = sizeof(buf);
+    status = pj_sock_recv(sock, buf, &len, 0);
+    if (status == PJ_SUCCESS && len > 0) {
+	PJ_LOG(3,(THIS_FILE, "   error: unexpected data on idle connection"));
+	rc = -130;
+    }
+
+on_return:
+    pj_sock_close(sock);
+    pjsip_cfg()->tcp.idle_timeout = old_idle;
+    return rc;
+}
+
+
+/*
+ * Check that idle connections hold no read buffer, and that a connection
+ * with a partial message holds one until it is closed. The read slab is
+ * off by default, so this starts its own listener with the slab enabled.
+ */
+static int tcp_slab_test(void)
+{
+    const char partial[] = "OPTIONS sip:bob@example.com SIP/2.0\r\n";
+    pj_bool_t old_read_slab = pjsip_cfg()->tcp.read_slab;
+    pjsip_tpfactory *tpfactory;
+    pj_activesock_slab *slab;
+    pj_activesock_slab_info info;
+    pj_sockaddr_in rem_addr;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_ssize_t len;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "   read buffer slab"));
+
+    pjsip_cfg()->tcp.read_slab = PJ_TRUE;
+    status = pjsip_tcp_transport_start(endpt, NULL, 1, &tpfactory);
+    pjsip_cfg()->tcp.read_slab = old_read_slab;
+    if (status != PJ_SUCCESS) {
+	app_perror("   Error: unable to start TCP transport", status);
+	return -150;
+    }
+
+    slab = pjsip_tcp_transport_get_read_slab(tpfactory);
+    if (!slab) {
+	rc = -151;
+	goto on_return;
+    }
+
+    status = pj_sockaddr_in_init(&rem_addr, &tpfactory->addr_name.host,
+				 (pj_uint16_t)tpfactory->addr_name.port);
+    if (status != PJ_SUCCESS) {
+	rc = -152;
+	goto on_return;
+    }
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0, &sock);
+    if (status != PJ_SUCCESS) {
+	sock = PJ_INVALID_SOCKET;
+	rc = -153;
+	goto on_return;
+    }
+
+    status = pj_sock_connect(sock, &rem_addr, sizeof(rem_addr));
+    if (status != PJ_SUCCESS) {
+	app_perror("   Error: connect() failed", status);
+	rc = -154;
+	goto on_return;
+    }
+
+    /* Idle incoming connection */
+    flush_events(500);
+    pj_activesock_slab_get_info(slab, &info);
+    if (info.used_cnt != 0) {
+	rc = -155;
+	goto on_return;
+    }
+
+    /* The partial message is kept in a buffer */
+    len = sizeof(partial) - 1;
+    status = pj_sock_send(sock, partial, &len, 0);
+    if (status != PJ_SUCCESS) {
+	rc = -156;
+	goto on_return;
+    }
+
+    flush_events(500);
+    pj_activesock_slab_get_info(slab, &info);
+    PJ_LOG(3,(THIS_FILE, "   slab: %u buffer(s) of %u bytes, %u used",
+	      info.total_cnt, info.buf_size, info.used_cnt));
+    if (info.used_cnt != 1) {
+	PJ_LOG(3,(THIS_FILE, "   error: %u buffer(s) used, expecting 1",
+		  info.used_cnt));
+	rc = -157;
+	goto on_return;
+    }
+
+    /* Closing the connection gives the buffer back */
+    pj_sock_close(sock);
+    sock = PJ_INVALID_SOCKET;
+
+    flush_events(500);
+    pj_activesock_slab_get_info(slab, &info);
+    if (info.used_cnt != 0)
+	rc = -158;
+
+on_return:
+    if (sock != PJ_INVALID_SOCKET)
+	pj_sock_close(sock);
+    pjsip_tpmgr_unregister_tpfactory(pjsip_endpt_get_tpmgr(endpt),
+				     tpfactory);
+    flush_events(500);
+    return rc;
+}
+
+
 /*
  * TCP transport test.
  */
-#if PJ_HAS_TCP
 int transport_tcp_test(void)
 {
     enum { SEND_RECV_LOOP = 8 };
@@ -136,6 +294,11 @@ int transport_tcp_test(void)
     if (status != PJ_SUCCESS)
 	return -90;
 
+    /* Idle connection reaping */
+    status = tcp_idle_test(&rem_addr);
+    if (status != 0)
+	return status;
+
     /* Unregister factory */
     status = pjsip_tpmgr_unregister_tpfactory(pjsip_endpt_get_tpmgr(endpt), 
 					      tpfactory);
@@ -146,6 +309,11 @@ int transport_tcp_test(void)
     PJ_LOG(3,(THIS_FILE, "   Flushing events, 1 second..."));
     flush_events(1000);
 
+    /* Read buffer slab */
+    status = tcp_slab_test();
+    if (status != 0)
+	return status;
+
     /* Done */
     return 0;
 }
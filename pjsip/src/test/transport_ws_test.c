@@ -0,0 +1,359 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include <pjsip.h>
+#include <pjlib.h>
+
+#define THIS_FILE   "transport_ws_test.c"
+
+/*
+ * WebSocket transport test. A raw socket plays the role of the WebSocket
+ * client (e.g. a browser): it performs the opening handshake, then sends
+ * masked (and fragmented) frames, and checks the frames sent back by the
+ * transport.
+ */
+#if defined(PJSIP_HAS_WS_TRANSPORT) && PJSIP_HAS_WS_TRANSPORT!=0
+
+/* Sample key and the expected accept value from RFC 6455 section 1.3 */
+#define WS_KEY		"dGhlIHNhbXBsZSBub25jZQ=="
+#define WS_ACCEPT	"s3pPLMBiTxaQ9kYGzzhZRbK+xOo="
+
+static const pj_uint8_t mask_key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+static pj_bool_t on_rx_request(pjsip_rx_data *rdata);
+
+static pjsip_module ws_test_mod =
+{
+    NULL, NULL,				/* prev and next		*/
+    { "ws-test", 7},			/* Name.			*/
+    -1,					/* Id				*/
+    PJSIP_MOD_PRIORITY_APPLICATION-1,	/* Priority			*/
+    NULL,				/* load()			*/
+    NULL,				/* start()			*/
+    NULL,				/* stop()			*/
+    NULL,				/* unload()			*/
+    &on_rx_request,			/* on_rx_request()		*/
+    NULL,				/* on_rx_response()		*/
+    NULL,				/* tx_request()			*/
+    NULL,				/* tx_response()		*/
+    NULL,				/* on_tsx_state()		*/
+};
+
+static int rx_request_cnt;
+
+/* Answer OPTIONS received over WebSocket statelessly. */
+static pj_bool_t on_rx_request(pjsip_rx_data *rdata)
+{
+    if (rdata->tp_info.transport->key.type != PJSIP_TRANSPORT_WS ||
+	rdata->msg_info.msg->line.req.method.id != PJSIP_OPTIONS_METHOD)
+    {
+	return PJ_FALSE;
+    }
+
+    ++rx_request_cnt;
+    pjsip_endpt_respond_stateless(endpt, rdata, 200, NULL, NULL, NULL);
+    return PJ_TRUE;
+}
+
+/* Build a masked client frame, returns the frame length. */
+static int build_frame(pj_uint8_t *frame, unsigned opcode, pj_bool_t fin,
+		       const char *payload, unsigned len)
+{
+    unsigned i, hdr_len;
+
+    frame[0] = (pj_uint8_t)((fin ? 0x80 : 0) | opcode);
+    if (len < 126) {
+	frame[1] = (pj_uint8_t)(0x80 | len);
+	hdr_len = 2;
+    } else {
+	frame[1] = 0x80 | 126;
+	frame[2] = (pj_uint8_t)(len >> 8);
+	frame[3] = (pj_uint8_t)len;
+	hdr_len = 4;
+    }
+    pj_memcpy(frame + hdr_len, mask_key, 4);
+    hdr_len += 4;
+
+    for (i=0; i<len; ++i)
+	frame[hdr_len + i] = (pj_uint8_t)(payload[i] ^ mask_key[i & 3]);
+
+    return hdr_len + len;
+}
+
+static pj_status_t send_all(pj_sock_t sock, const void *data, int len)
+{
+    pj_ssize_t sent = len;
+    pj_status_t status;
+
+    status = pj_sock_send(sock, data, &sent, 0);
+    if (status == PJ_SUCCESS && sent != len)
+	status = PJ_ETOOSMALL;
+    return status;
+}
+
+/* Returns the length of the complete unmasked server frame at the start
+ * of buf, or zero if it's not complete yet.
+ */
+static int frame_complete(const pj_uint8_t *buf, int len)
+{
+    int hdr_len = 2, plen;
+
+    if (len < 2)
+	return 0;
+    plen = buf[1] & 0x7F;
+    if (plen == 126) {
+	if (len < 4)
+	    return 0;
+	plen = (buf[2] << 8) | buf[3];
+	hdr_len = 4;
+    }
+    return (len >= hdr_len + plen) ? hdr_len + plen : 0;
+}
+
+/* Poll the endpoint and read from the client socket until the handshake
+ * response (is_http) or a complete frame is received.
+ */
+static int recv_reply(pj_sock_t sock, char *buf, int size, pj_bool_t is_http)
+{
+    pj_time_val timeout, now;
+    int len = 0;
+
+    pj_gettimeofday(&timeout);
+    timeout.sec += 5;
+
+    for (;;) {
+	pj_fd_set_t rset;
+	pj_time_val zero = { 0, 0 };
+
+	flush_events(10);
+
+	PJ_FD_ZERO(&rset);
+	PJ_FD_SET(sock, &rset);
+	if (pj_sock_select((int)sock+1, &rset, NULL, NULL, &zero) > 0) {
+	    pj_ssize_t received = size - len - 1;
+	    pj_status_t status;
+
+	    status = pj_sock_recv(sock, buf + len, &received, 0);
+	    if (status != PJ_SUCCESS || received <= 0)
+		return len;
+	    len += (int)received;
+	    buf[len] = '\0';
+	}
+
+	if (is_http && pj_ansi_strstr(buf, "\r\n\r\n"))
+	    return len;
+	if (!is_http && frame_complete((pj_uint8_t*)buf, len))
+	    return len;
+
+	pj_gettimeofday(&now);
+	if (PJ_TIME_VAL_GTE(now, timeout))
+	    return len;
+    }
+}
+
+static pj_status_t client_connect(const pj_sockaddr *addr, pj_sock_t *p_sock)
+{
+    pj_status_t status;
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0, p_sock);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    status = pj_sock_connect(*p_sock, addr, pj_sockaddr_get_len(addr));
+    if (status != PJ_SUCCESS) {
+	pj_sock_close(*p_sock);
+	*p_sock = PJ_INVALID_SOCKET;
+    }
+    return status;
+}
+
+static int ws_test_run(const pj_sockaddr *addr)
+{
+    static const char upgrade[] =
+	"GET /ws HTTP/1.1\r\n"
+	"Host: 127.0.0.1\r\n"
+	"Upgrade: websocket\r\n"
+	"Connection: keep-alive, Upgrade\r\n"
+	"Sec-WebSocket-Key: " WS_KEY "\r\n"
+	"Sec-WebSocket-Protocol: sip\r\n"
+	"Sec-WebSocket-Version: 13\r\n\r\n";
+    static const char bad_upgrade[] =
+	"GET /ws HTTP/1.1\r\n"
+	"Host: 127.0.0.1\r\n"
+	"Upgrade: websocket\r\n"
+	"Connection: Upgrade\r\n"
+	"Sec-WebSocket-Key: " WS_KEY "\r\n"
+	"Sec-WebSocket-Version: 13\r\n\r\n";
+    /* No Content-Length: message boundary comes from WebSocket framing */
+    static const char options[] =
+	"OPTIONS sip:alice@127.0.0.1;transport=ws SIP/2.0\r\n"
+	"Via: SIP/2.0/WS df7jal23ls0d.invalid;branch=z9hG4bKwstest01\r\n"
+	"From: <sip:bob@example.com>;tag=ws1\r\n"
+	"To: <sip:alice@127.0.0.1>\r\n"
+	"Call-ID: wstest-call-id\r\n"
+	"CSeq: 1 OPTIONS\r\n"
+	"Max-Forwards: 70\r\n"
+	"\r\n";
+    pj_uint8_t frame[1024];
+    char buf[2048], *p;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    unsigned split;
+    int len, len2, rc = 0;
+    pj_status_t status;
+
+    /* Handshake without the "sip" subprotocol must be rejected */
+    status = client_connect(addr, &sock);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: connect() failed", status);
+	return -20;
+    }
+    send_all(sock, bad_upgrade, sizeof(bad_upgrade)-1);
+    len = recv_reply(sock, buf, sizeof(buf), PJ_TRUE);
+    pj_sock_close(sock);
+    sock = PJ_INVALID_SOCKET;
+    if (len < 12 || pj_ansi_strncmp(buf, "HTTP/1.1 400", 12) != 0) {
+	PJ_LOG(3,(THIS_FILE, "   error: expecting 400 response"));
+	return -30;
+    }
+
+    /* Valid handshake */
+    status = client_connect(addr, &sock);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: connect() failed", status);
+	return -40;
+    }
+    send_all(sock, upgrade, sizeof(upgrade)-1);
+    len = recv_reply(sock, buf, sizeof(buf), PJ_TRUE);
+    if (len < 12 || pj_ansi_strncmp(buf, "HTTP/1.1 101", 12) != 0 ||
+	!pj_ansi_strstr(buf, "Sec-WebSocket-Accept: " WS_ACCEPT "\r\n") ||
+	!pj_ansi_strstr(buf, "Sec-WebSocket-Protocol: sip\r\n"))
+    {
+	PJ_LOG(3,(THIS_FILE, "   error: invalid handshake response"));
+	rc = -50; goto on_return;
+    }
+
+    /* Ping must be answered with pong carrying the same payload */
+    len = build_frame(frame, 0x9, PJ_TRUE, "hello", 5);
+    send_all(sock, frame, len);
+    len = recv_reply(sock, buf, sizeof(buf), PJ_FALSE);
+    if (len != 7 || (pj_uint8_t)buf[0] != 0x8A || buf[1] != 5 ||
+	pj_memcmp(buf+2, "hello", 5) != 0)
+    {
+	PJ_LOG(3,(THIS_FILE, "   error: invalid pong"));
+	rc = -60; goto on_return;
+    }
+
+    /* Send OPTIONS in two fragments, with a ping interleaved and the
+     * second fragment split across two writes.
+     */
+    split = 40;
+    len = build_frame(frame, 0x1, PJ_FALSE, options, split);
+    len += build_frame(frame + len, 0x9, PJ_TRUE, "x", 1);
+    send_all(sock, frame, len);
+
+    len = recv_reply(sock, buf, sizeof(buf), PJ_FALSE);
+    if (len != 3 || (pj_uint8_t)buf[0] != 0x8A) {
+	PJ_LOG(3,(THIS_FILE, "   error: invalid pong in fragmented message"));
+	rc = -70; goto on_return;
+    }
+
+    len = build_frame(frame, 0x0, PJ_TRUE, options + split,
+		      sizeof(options) - 1 - split);
+    len2 = len / 2;
+    send_all(sock, frame, len2);
+    flush_events(50);
+    send_all(sock, frame + len2, len - len2);
+
+    len = recv_reply(sock, buf, sizeof(buf), PJ_FALSE);
+    len2 = frame_complete((pj_uint8_t*)buf, len);
+    if (len2 == 0 || (pj_uint8_t)buf[0] != 0x81) {
+	PJ_LOG(3,(THIS_FILE, "   error: no response frame received"));
+	rc = -80; goto on_return;
+    }
+    /* Skip the frame header to get to the SIP message */
+    p = buf + (((buf[1] & 0x7F) == 126) ? 4 : 2);
+    if (rx_request_cnt != 1 || pj_ansi_strncmp(p, "SIP/2.0 200", 11) ||
+	!pj_ansi_strstr(p, "Call-ID: wstest-call-id"))
+    {
+	PJ_LOG(3,(THIS_FILE, "   error: invalid response frame"));
+	rc = -90; goto on_return;
+    }
+
+    /* Close handshake */
+    len = build_frame(frame, 0x8, PJ_TRUE, "\x03\xe8", 2);
+    send_all(sock, frame, len);
+    len = recv_reply(sock, buf, sizeof(buf), PJ_FALSE);
+    if (len < 2 || (pj_uint8_t)buf[0] != 0x88) {
+	PJ_LOG(3,(THIS_FILE, "   error: expecting close frame"));
+	rc = -100; goto on_return;
+    }
+
+on_return:
+    if (sock != PJ_INVALID_SOCKET)
+	pj_sock_close(sock);
+    flush_events(100);
+    return rc;
+}
+
+int transport_ws_test(void)
+{
+    pjsip_ws_transport_cfg cfg;
+    pjsip_tpfactory *tpfactory;
+    pj_sockaddr addr;
+    pj_str_t s;
+    int rc;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  WebSocket transport test"));
+
+    status = pjsip_endpt_register_module(endpt, &ws_test_mod);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to register module", status);
+	return -10;
+    }
+
+    /* Start WS listener on arbitrary port. */
+    pjsip_ws_transport_cfg_default(&cfg, pj_AF_INET());
+    pj_sockaddr_init(pj_AF_INET(), &cfg.bind_addr,
+		     pj_cstr(&s, "127.0.0.1"), 0);
+    cfg.path = pj_str("/ws");
+    status = pjsip_ws_transport_start(endpt, &cfg, &tpfactory);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to start WS transport", status);
+	pjsip_endpt_unregister_module(endpt, &ws_test_mod);
+	return -15;
+    }
+
+    pj_sockaddr_cp(&addr, &tpfactory->local_addr);
+    rx_request_cnt = 0;
+    rc = ws_test_run(&addr);
+
+    tpfactory->destroy(tpfactory);
+    pjsip_endpt_unregister_module(endpt, &ws_test_mod);
+
+    return rc;
+}
+#else	/* PJSIP_HAS_WS_TRANSPORT */
+int transport_ws_test(void)
+{
+    return 0;
+}
+#endif	/* PJSIP_HAS_WS_TRANSPORT */
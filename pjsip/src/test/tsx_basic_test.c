@@ -136,6 +136,165 @@ static int double_terminate(void)
     return PJ_SUCCESS;
 }
 
+/* Shared lock contention test: several threads query a transaction while
+ * another one keeps locking it exclusively.
+ */
+#define SHARED_READER_CNT   4
+#define SHARED_TEST_MSEC    300
+
+static struct shared_test_data
+{
+    pj_str_t	     tsx_key;
+    pj_atomic_t	    *active;
+    volatile int     quit;
+    volatile int     err;
+    int		     max_active;
+    unsigned	     query_cnt[SHARED_READER_CNT];
+    unsigned	     write_cnt;
+} sdata;
+
+static int shared_reader_thread(void *arg)
+{
+    unsigned *cnt = (unsigned*)arg;
+
+    while (!sdata.quit) {
+	pjsip_transaction *tsx;
+	pjsip_tsx_state_e state;
+	int active;
+
+	if (pjsip_tsx_layer_get_tsx_state(&sdata.tsx_key, &state, NULL) !=
+		PJ_SUCCESS || state != PJSIP_TSX_STATE_NULL)
+	{
+	    sdata.err = 1;
+	    break;
+	}
+
+	tsx = pjsip_tsx_layer_find_tsx_shared(&sdata.tsx_key);
+	if (!tsx) {
+	    sdata.err = 2;
+	    break;
+	}
+	active = (int)pj_atomic_inc_and_get(sdata.active);
+	if (active > sdata.max_active)
+	    sdata.max_active = active;
+	pj_thread_sleep(0);
+	pj_atomic_dec(sdata.active);
+	pj_grp_lock_release_shared(tsx->grp_lock);
+
+	++*cnt;
+    }
+
+    return 0;
+}
+
+static int shared_lock_test(void)
+{
+    pj_str_t target, from;
+    pjsip_tx_data *tdata;
+    pjsip_transaction *tsx;
+    pj_thread_t *thread[SHARED_READER_CNT];
+    pj_pool_t *pool;
+    pj_time_val end, now;
+    pj_status_t status;
+    unsigned query_cnt = 0;
+    int i, rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  shared lock contention test"));
+
+    pj_bzero(&sdata, sizeof(sdata));
+
+    target = pj_str(TARGET_URI);
+    from = pj_str(FROM_URI);
+
+    status = pjsip_endpt_create_request(endpt, &pjsip_invite_method, &target,
+					&from, &target, NULL, NULL, -1, NULL,
+					&tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("  error: unable to create request", status);
+	return -310;
+    }
+
+    status = pjsip_tsx_create_uac(NULL, tdata, &tsx);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to create transaction", status);
+	pjsip_tx_data_dec_ref(tdata);
+	return -320;
+    }
+
+    pool = pjsip_endpt_create_pool(endpt, "sharedtest", 512, 512);
+    pj_strdup(pool, &sdata.tsx_key, &tsx->transaction_key);
+    pj_atomic_create(pool, 0, &sdata.active);
+
+    for (i=0; i<SHARED_READER_CNT; ++i) {
+	status = pj_thread_create(pool, "tsxreader", &shared_reader_thread,
+				  &sdata.query_cnt[i], 0, 0, &thread[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror("   error: unable to create thread", status);
+	    sdata.quit = 1;
+	    while (i-- > 0)
+		pj_thread_join(thread[i]);
+	    rc = -330;
+	    goto on_return;
+	}
+    }
+
+    /* Exclusive lockers must get their turn and keep the readers out */
+    pj_gettimeofday(&end);
+    end.msec += SHARED_TEST_MSEC;
+    pj_time_val_normalize(&end);
+    do {
+	pjsip_transaction *found;
+
+	found = pjsip_tsx_layer_find_tsx(&sdata.tsx_key, PJ_TRUE);
+	if (found != tsx) {
+	    rc = -340;
+	    break;
+	}
+	if (pj_atomic_get(sdata.active) != 0)
+	    sdata.err = 3;
+	pj_thread_sleep(0);
+	pj_grp_lock_release(tsx->grp_lock);
+	++sdata.write_cnt;
+
+	pj_gettimeofday(&now);
+    } while (PJ_TIME_VAL_LT(now, end));
+
+    sdata.quit = 1;
+    for (i=0; i<SHARED_READER_CNT; ++i) {
+	pj_thread_join(thread[i]);
+	pj_thread_destroy(thread[i]);
+	query_cnt += sdata.query_cnt[i];
+    }
+
+    PJ_LOG(3,(THIS_FILE, "   %u queries, %u exclusive locks, up to %d "
+	      "concurrent readers",
+	      query_cnt, sdata.write_cnt, sdata.max_active));
+
+    if (rc == 0 && sdata.err) {
+	PJ_LOG(3,(THIS_FILE, "   error: shared lock test failed (%d)",
+		  sdata.err));
+	rc = -350;
+    }
+
+on_return:
+    pjsip_tsx_terminate(tsx, PJSIP_SC_REQUEST_TERMINATED);
+    flush_events(500);
+
+    if (pjsip_tsx_layer_get_tsx_state(&sdata.tsx_key, NULL, NULL) !=
+	    PJ_ENOTFOUND && rc == 0)
+    {
+	rc = -360;
+    }
+
+    if (pjsip_tx_data_dec_ref(tdata) != PJSIP_EBUFDESTROYED && rc == 0)
+	rc = -370;
+
+    pj_atomic_destroy(sdata.active);
+    pjsip_endpt_release_pool(endpt, pool);
+
+    return rc;
+}
+
 int tsx_basic_test(struct tsx_test_param *param)
 {
     int status;
@@ -153,6 +312,10 @@ int tsx_basic_test(struct tsx_test_param *param)
     if (status != 0)
 	return status;
 
+    status = shared_lock_test();
+    if (status != 0)
+	return status;
+
     return 0;
 }
 